@@ -234,6 +234,7 @@ do
             sample_build "PC" "linux" "build_pc_linux" "Debug"
             exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample"
             exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample-pnp"
+            exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample-fleet"
 
             rm -rf build_pc_linux
 
@@ -242,10 +243,45 @@ do
             exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample"
             exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample-pnp"
             exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample-adu"
+            exit_if_binary_does_not_exist "build_pc_linux" "iot-middleware-sample-fleet"
+            exit_if_binary_does_not_exist "build_pc_linux" "benchmarks"
 
             echo -e "::group::Running CA Recovery Unit Tests"
             ./build_pc_linux/demos/projects/PC/linux/test_ca_recovery
 
+            echo -e "::group::Running Trust Bundle Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_trust_bundle
+
+            echo -e "::group::Running HTTP Range Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_http_range
+
+            echo -e "::group::Running ADU Resume Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_resume
+
+            echo -e "::group::Running ADU Flash Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_flash
+
+            echo -e "::group::Running ADU Coalesce Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_coalesce
+
+            echo -e "::group::Running Adaptive Chunk Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adaptive_chunk
+
+            echo -e "::group::Running Bandwidth Shaper Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_bandwidth_shaper
+
+            echo -e "::group::Running ADU Compressed Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_compressed
+
+            echo -e "::group::Running ADU Delta Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_delta
+
+            echo -e "::group::Running ADU Deployment Unit Tests"
+            ./build_pc_linux/demos/projects/PC/linux/test_adu_deployment
+
+            echo -e "::group::Running Benchmarks"
+            ./build_pc_linux/demos/projects/PC/linux/benchmarks
+
             ;;
         * )
             echo "build for $arg not found";;
@@ -3,6 +3,8 @@
 
 #include "azure_ca_recovery_rsa_verify.h"
 
+#include <string.h>
+
 #include "azure_iot_config.h"
 #include "azure/core/az_base64.h"
 
@@ -13,6 +15,25 @@
 #include "mbedtls/entropy.h"
 #include "mbedtls/cipher.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @brief Time in microseconds read for the timing counters of the verifiers.
+ *
+ * ESP32 reads the high resolution timer, and the Linux port defines it in
+ * FreeRTOSConfig.h. Other ports define it in azure_iot_config.h, or fall back
+ * to the scheduler tick, which counts a verification as zero or a whole tick.
+ */
+#ifndef azureiotrsaverifyGET_TIME_US
+    #ifdef ESP_PLATFORM
+        #include "esp_timer.h"
+        #define azureiotrsaverifyGET_TIME_US()    ( ( uint64_t ) esp_timer_get_time() )
+    #else
+        #define azureiotrsaverifyGET_TIME_US()    ( ( uint64_t ) xTaskGetTickCount() * portTICK_PERIOD_MS * 1000U )
+    #endif
+#endif
+
 /**
  * @brief Calculate the SHA256 over a buffer of bytes
  *
@@ -38,50 +59,38 @@ static AzureIoTResult_t prvSHA256Calculate( const uint8_t * pucInput,
     return eAzureIoTSuccess;
 }
 
-AzureIoTResult_t AzureIoTSample_RS256Verify( uint8_t * pucInput,
-                                             uint32_t ulInputLength,
-                                             uint8_t * pucSignature,
-                                             uint32_t ulSignatureLength,
-                                             uint8_t * pucN,
-                                             uint32_t ulNLength,
-                                             uint8_t * pucE,
-                                             uint32_t ulELength,
-                                             uint8_t * pucBuffer,
-                                             uint32_t ulBufferLength )
+AzureIoTResult_t AzureIoTSample_RS256VerifierInit( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                   uint8_t * pucN,
+                                                   uint32_t ulNLength,
+                                                   uint8_t * pucE,
+                                                   uint32_t ulELength )
 {
-    AzureIoTResult_t xResult;
     int32_t lMbedTLSResult;
-    int32_t outDecodeSize;
-    mbedtls_rsa_context ctx;
-    uint8_t * ucSignatureBase64Decoded;
+    uint64_t ullStartTimeUs;
 
-    if( ulBufferLength < azureiotrsaverifySHA_CALCULATION_SCRATCH_SIZE )
+    if( ( pxVerifier == NULL ) || ( pucN == NULL ) || ( pucE == NULL ) )
     {
-        AZLogError( ( "[RSA] Buffer not large enough" ) );
-        return eAzureIoTErrorOutOfMemory;
+        AZLogError( ( "[RSA] Invalid verifier arguments" ) );
+        return eAzureIoTErrorInvalidArgument;
     }
 
-    ucSignatureBase64Decoded = pucBuffer + azureiotrsaverifySHA256_SIZE_BYTES;
+    memset( pxVerifier, 0, sizeof( *pxVerifier ) );
 
-    az_result xCoreResult = az_base64_decode( az_span_create( ucSignatureBase64Decoded, azureiotrsaverifyRSA3072_SIZE_BYTES ),
-                                              az_span_create( pucSignature, ulSignatureLength ),
-                                              &outDecodeSize );
+    #if MBEDTLS_VERSION_NUMBER >= 0x03000000
+        mbedtls_rsa_init( &pxVerifier->xRSAContext );
+    #else
+        mbedtls_rsa_init( &pxVerifier->xRSAContext, MBEDTLS_RSA_PKCS_V15, 0 );
+    #endif
 
-    if( az_result_failed( xCoreResult ) )
+    if( ulNLength > azureiotrsaverifyRSA3072_SIZE_BYTES )
     {
-        AZLogError( ( "[RSA] Base64 decode failed: 0x%08x", xCoreResult ) );
-        return eAzureIoTErrorFailed;
+        AZLogError( ( "[RSA] Key larger than %u bits", azureiotrsaverifyRSA3072_SIZE_BYTES * 8U ) );
+        return eAzureIoTErrorInvalidArgument;
     }
 
-    /* The signature is signed using the input key. We compare the signature to */
-    /* the SHA256 of the input. */
-    #if MBEDTLS_VERSION_NUMBER >= 0x03000000
-        mbedtls_rsa_init( &ctx );
-    #else
-        mbedtls_rsa_init( &ctx, MBEDTLS_RSA_PKCS_V15, 0 );
-    #endif
+    ullStartTimeUs = azureiotrsaverifyGET_TIME_US();
 
-    lMbedTLSResult = mbedtls_rsa_import_raw( &ctx,
+    lMbedTLSResult = mbedtls_rsa_import_raw( &pxVerifier->xRSAContext,
                                              pucN, ulNLength,
                                              NULL, 0,
                                              NULL, 0,
@@ -91,56 +100,282 @@ AzureIoTResult_t AzureIoTSample_RS256Verify( uint8_t * pucInput,
     if( lMbedTLSResult != 0 )
     {
         AZLogError( ( "[RSA] mbedtls_rsa_import_raw failed, res: %08x", ( uint16_t ) lMbedTLSResult ) );
-        mbedtls_rsa_free( &ctx );
         return eAzureIoTErrorFailed;
     }
 
-    lMbedTLSResult = mbedtls_rsa_complete( &ctx );
+    lMbedTLSResult = mbedtls_rsa_complete( &pxVerifier->xRSAContext );
 
     if( lMbedTLSResult != 0 )
     {
         AZLogError( ( "[RSA] mbedtls_rsa_complete failed, res: %08x", ( uint16_t ) lMbedTLSResult ) );
-        mbedtls_rsa_free( &ctx );
         return eAzureIoTErrorFailed;
     }
 
-    lMbedTLSResult = mbedtls_rsa_check_pubkey( &ctx );
+    lMbedTLSResult = mbedtls_rsa_check_pubkey( &pxVerifier->xRSAContext );
 
     if( lMbedTLSResult != 0 )
     {
         AZLogError( ( "[RSA] mbedtls_rsa_check_pubkey failed, res: %08x", ( uint16_t ) lMbedTLSResult ) );
-        mbedtls_rsa_free( &ctx );
         return eAzureIoTErrorFailed;
     }
 
-    /* RSA */
-    xResult = prvSHA256Calculate( pucInput, ulInputLength,
-                                  pucBuffer );
+    pxVerifier->ulSetupTimeUs = ( uint32_t ) ( azureiotrsaverifyGET_TIME_US() - ullStartTimeUs );
 
-    if( xResult != eAzureIoTSuccess )
+    return eAzureIoTSuccess;
+}
+
+/**
+ * @brief Verify a signature without updating the timing counters.
+ */
+static AzureIoTResult_t prvVerifierVerifyHash( AzureIoTSample_RS256Verifier * pxVerifier,
+                                               const uint8_t * pucHash,
+                                               uint8_t * pucSignature,
+                                               uint32_t ulSignatureLength,
+                                               uint8_t * pucBuffer,
+                                               uint32_t ulBufferLength )
+{
+    int32_t lMbedTLSResult;
+    int32_t outDecodeSize;
+    uint32_t ulKeyLength = ( uint32_t ) mbedtls_rsa_get_len( &pxVerifier->xRSAContext );
+    uint8_t * ucSignatureBase64Decoded;
+
+    if( ulBufferLength < ulKeyLength )
     {
-        AZLogError( ( "[RSA] prvSHA256Calculate failed" ) );
-        mbedtls_rsa_free( &ctx );
-        return xResult;
+        AZLogError( ( "[RSA] Buffer not large enough" ) );
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    ucSignatureBase64Decoded = pucBuffer;
+
+    az_result xCoreResult = az_base64_decode( az_span_create( ucSignatureBase64Decoded, ( int32_t ) ulBufferLength ),
+                                              az_span_create( pucSignature, ( int32_t ) ulSignatureLength ),
+                                              &outDecodeSize );
+
+    if( az_result_failed( xCoreResult ) )
+    {
+        AZLogError( ( "[RSA] Base64 decode failed: 0x%08x", xCoreResult ) );
+        return eAzureIoTErrorFailed;
     }
 
+    /* mbedTLS reads as many bytes as the key is long. */
+    if( ( uint32_t ) outDecodeSize != ulKeyLength )
+    {
+        AZLogError( ( "[RSA] Signature of %d bytes for a key of %u bytes", ( int ) outDecodeSize, ( unsigned ) ulKeyLength ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    /* The signature is signed using the input key. We compare the signature to */
+    /* the SHA256 of the input. */
     #if MBEDTLS_VERSION_NUMBER >= 0x03000000
-        lMbedTLSResult = mbedtls_rsa_pkcs1_verify( &ctx, MBEDTLS_MD_SHA256, azureiotjwsSHA256_SIZE, pucBuffer, ucSignatureBase64Decoded );
+        lMbedTLSResult = mbedtls_rsa_pkcs1_verify( &pxVerifier->xRSAContext, MBEDTLS_MD_SHA256, azureiotrsaverifySHA256_SIZE_BYTES, pucHash, ucSignatureBase64Decoded );
     #else
-        lMbedTLSResult = mbedtls_rsa_pkcs1_verify( &ctx, NULL, NULL, MBEDTLS_RSA_PUBLIC, MBEDTLS_MD_SHA256, azureiotrsaverifySHA256_SIZE_BYTES, pucBuffer, ucSignatureBase64Decoded );
+        lMbedTLSResult = mbedtls_rsa_pkcs1_verify( &pxVerifier->xRSAContext, NULL, NULL, MBEDTLS_RSA_PUBLIC, MBEDTLS_MD_SHA256, azureiotrsaverifySHA256_SIZE_BYTES, pucHash, ucSignatureBase64Decoded );
     #endif
 
     if( lMbedTLSResult != 0 )
     {
         AZLogError( ( "[RSA] SHA of JWK does NOT match (0x%08x)", ( uint16_t ) lMbedTLSResult ) );
-        xResult = eAzureIoTErrorFailed;
+        return eAzureIoTErrorFailed;
     }
-    else
+
+    return eAzureIoTSuccess;
+}
+
+/**
+ * @brief Verify a signature over an input or its hash, without updating the timing counters.
+ */
+static AzureIoTResult_t prvVerifierVerifyItem( AzureIoTSample_RS256Verifier * pxVerifier,
+                                               AzureIoTSample_RS256VerifyItem * pxItem,
+                                               uint8_t * pucBuffer,
+                                               uint32_t ulBufferLength )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxItem->pucHash != NULL )
+    {
+        return prvVerifierVerifyHash( pxVerifier, pxItem->pucHash,
+                                      pxItem->pucSignature, pxItem->ulSignatureLength,
+                                      pucBuffer, ulBufferLength );
+    }
+
+    if( ulBufferLength < azureiotrsaverifySHA256_SIZE_BYTES )
     {
-        xResult = eAzureIoTSuccess;
+        AZLogError( ( "[RSA] Buffer not large enough" ) );
+        return eAzureIoTErrorOutOfMemory;
     }
 
-    mbedtls_rsa_free( &ctx );
+    xResult = prvSHA256Calculate( pxItem->pucInput, pxItem->ulInputLength,
+                                  pucBuffer );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        AZLogError( ( "[RSA] prvSHA256Calculate failed" ) );
+        return xResult;
+    }
+
+    return prvVerifierVerifyHash( pxVerifier, pucBuffer,
+                                  pxItem->pucSignature, pxItem->ulSignatureLength,
+                                  pucBuffer + azureiotrsaverifySHA256_SIZE_BYTES,
+                                  ulBufferLength - azureiotrsaverifySHA256_SIZE_BYTES );
+}
+
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerifyBatch( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                          AzureIoTSample_RS256VerifyItem * pxItems,
+                                                          uint32_t ulItemCount,
+                                                          uint8_t * pucBuffer,
+                                                          uint32_t ulBufferLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint64_t ullStartTimeUs;
+    uint32_t ulIndex;
+
+    if( ( pxVerifier == NULL ) || ( ( pxItems == NULL ) && ( ulItemCount > 0U ) ) || ( pucBuffer == NULL ) )
+    {
+        AZLogError( ( "[RSA] Invalid verifier arguments" ) );
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    ullStartTimeUs = azureiotrsaverifyGET_TIME_US();
+
+    for( ulIndex = 0; ulIndex < ulItemCount; ulIndex++ )
+    {
+        pxItems[ ulIndex ].xResult = prvVerifierVerifyItem( pxVerifier, &pxItems[ ulIndex ],
+                                                            pucBuffer, ulBufferLength );
+
+        if( pxItems[ ulIndex ].xResult != eAzureIoTSuccess )
+        {
+            pxVerifier->ulFailures++;
+            xResult = eAzureIoTErrorFailed;
+        }
+    }
+
+    pxVerifier->ulVerifications += ulItemCount;
+    pxVerifier->ulLastVerifyTimeUs = ( uint32_t ) ( azureiotrsaverifyGET_TIME_US() - ullStartTimeUs );
+    pxVerifier->ullVerifyTimeUs += pxVerifier->ulLastVerifyTimeUs;
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerifyHash( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                         const uint8_t * pucHash,
+                                                         uint8_t * pucSignature,
+                                                         uint32_t ulSignatureLength,
+                                                         uint8_t * pucBuffer,
+                                                         uint32_t ulBufferLength )
+{
+    AzureIoTSample_RS256VerifyItem xItem = { 0 };
+    AzureIoTResult_t xResult;
+
+    if( pucHash == NULL )
+    {
+        AZLogError( ( "[RSA] Invalid verifier arguments" ) );
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    xItem.pucHash = pucHash;
+    xItem.pucSignature = pucSignature;
+    xItem.ulSignatureLength = ulSignatureLength;
+
+    xResult = AzureIoTSample_RS256VerifierVerifyBatch( pxVerifier, &xItem, 1, pucBuffer, ulBufferLength );
+
+    return ( xResult == eAzureIoTSuccess ) ? xResult : xItem.xResult;
+}
+
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerify( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                     const uint8_t * pucInput,
+                                                     uint32_t ulInputLength,
+                                                     uint8_t * pucSignature,
+                                                     uint32_t ulSignatureLength,
+                                                     uint8_t * pucBuffer,
+                                                     uint32_t ulBufferLength )
+{
+    AzureIoTSample_RS256VerifyItem xItem = { 0 };
+    AzureIoTResult_t xResult;
+
+    xItem.pucInput = pucInput;
+    xItem.ulInputLength = ulInputLength;
+    xItem.pucSignature = pucSignature;
+    xItem.ulSignatureLength = ulSignatureLength;
+
+    xResult = AzureIoTSample_RS256VerifierVerifyBatch( pxVerifier, &xItem, 1, pucBuffer, ulBufferLength );
+
+    return ( xResult == eAzureIoTSuccess ) ? xResult : xItem.xResult;
+}
+
+void AzureIoTSample_RS256VerifierDeinit( AzureIoTSample_RS256Verifier * pxVerifier )
+{
+    if( pxVerifier != NULL )
+    {
+        mbedtls_rsa_free( &pxVerifier->xRSAContext );
+    }
+}
+
+AzureIoTResult_t AzureIoTSample_RS256VerifyHash( const uint8_t * pucHash,
+                                                 uint8_t * pucSignature,
+                                                 uint32_t ulSignatureLength,
+                                                 uint8_t * pucN,
+                                                 uint32_t ulNLength,
+                                                 uint8_t * pucE,
+                                                 uint32_t ulELength,
+                                                 uint8_t * pucBuffer,
+                                                 uint32_t ulBufferLength )
+{
+    AzureIoTSample_RS256Verifier xVerifier;
+    AzureIoTResult_t xResult;
+
+    if( ulBufferLength < azureiotrsaverifyRSA3072_SIZE_BYTES )
+    {
+        AZLogError( ( "[RSA] Buffer not large enough" ) );
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    xResult = AzureIoTSample_RS256VerifierInit( &xVerifier, pucN, ulNLength, pucE, ulELength );
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTSample_RS256VerifierVerifyHash( &xVerifier, pucHash,
+                                                          pucSignature, ulSignatureLength,
+                                                          pucBuffer, ulBufferLength );
+    }
+
+    AzureIoTSample_RS256VerifierDeinit( &xVerifier );
 
     return xResult;
 }
+
+AzureIoTResult_t AzureIoTSample_RS256Verify( uint8_t * pucInput,
+                                             uint32_t ulInputLength,
+                                             uint8_t * pucSignature,
+                                             uint32_t ulSignatureLength,
+                                             uint8_t * pucN,
+                                             uint32_t ulNLength,
+                                             uint8_t * pucE,
+                                             uint32_t ulELength,
+                                             uint8_t * pucBuffer,
+                                             uint32_t ulBufferLength )
+{
+    AzureIoTResult_t xResult;
+
+    if( ulBufferLength < azureiotrsaverifySHA_CALCULATION_SCRATCH_SIZE )
+    {
+        AZLogError( ( "[RSA] Buffer not large enough" ) );
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    /* RSA */
+    xResult = prvSHA256Calculate( pucInput, ulInputLength,
+                                  pucBuffer );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        AZLogError( ( "[RSA] prvSHA256Calculate failed" ) );
+        return xResult;
+    }
+
+    return AzureIoTSample_RS256VerifyHash( pucBuffer,
+                                           pucSignature, ulSignatureLength,
+                                           pucN, ulNLength,
+                                           pucE, ulELength,
+                                           pucBuffer + azureiotrsaverifySHA256_SIZE_BYTES,
+                                           ulBufferLength - azureiotrsaverifySHA256_SIZE_BYTES );
+}
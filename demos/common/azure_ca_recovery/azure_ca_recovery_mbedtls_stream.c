@@ -0,0 +1,665 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "azure_ca_recovery_stream.h"
+
+#include <string.h>
+
+#include "azure_iot_config.h"
+
+#define azureiotcarecoverySIGNATURE_NAME            "signature"
+#define azureiotcarecoveryCERT_TRUST_BUNDLE_NAME    "certTrustBundle"
+#define azureiotcarecoveryVERSION_NAME              "version"
+#define azureiotcarecoveryEXPIRY_TIME_NAME          "expiryTime"
+#define azureiotcarecoveryCERTS_NAME                "certs"
+
+#define azureiotcarecoveryUNESCAPE_ERROR            ( -1 )
+#define azureiotcarecoveryUNESCAPE_PENDING          0
+#define azureiotcarecoveryUNESCAPE_BYTE             1
+#define azureiotcarecoveryUNESCAPE_END              2
+
+/* The members read, the others are skipped. */
+typedef enum AzureIoTCARecovery_StreamMember
+{
+    eStreamMemberNone = 0,
+    eStreamMemberSignature,
+    eStreamMemberCertTrustBundle,
+    eStreamMemberVersion,
+    eStreamMemberExpiryTime,
+    eStreamMemberCerts
+} AzureIoTCARecovery_StreamMember;
+
+#define azureiotcarecoveryREQUIRED_MEMBERS                                       \
+    ( ( 1U << eStreamMemberSignature ) | ( 1U << eStreamMemberCertTrustBundle ) | \
+      ( 1U << eStreamMemberCerts ) )
+
+typedef enum AzureIoTCARecovery_StreamState
+{
+    eStreamStateObject = 0, /* Before the '{'. */
+    eStreamStateFirstKey,   /* After the '{', a key or the '}'. */
+    eStreamStateKey,        /* After a ',', a key. */
+    eStreamStateKeyText,
+    eStreamStateColon,
+    eStreamStateValue,
+    eStreamStateString,
+    eStreamStateNumber,
+    eStreamStateSkip,       /* Number or literal of a member not read. */
+    eStreamStateNested,     /* Object or array of a member not read. */
+    eStreamStateNestedString,
+    eStreamStateNext,       /* After a value, a ',' or the '}'. */
+    eStreamStateDone
+} AzureIoTCARecovery_StreamState;
+
+static AzureIoTResult_t prvObjectFeed( AzureIoTCARecovery_StreamParser * pxParser,
+                                       AzureIoTCARecovery_StreamObject * pxObject,
+                                       uint8_t ucChar );
+
+static uint32_t prvIsWhitespace( uint8_t ucChar )
+{
+    return ( ucChar == ' ' ) || ( ucChar == '\t' ) || ( ucChar == '\r' ) || ( ucChar == '\n' );
+}
+
+static int32_t prvHexValue( uint8_t ucChar )
+{
+    if( ( ucChar >= '0' ) && ( ucChar <= '9' ) )
+    {
+        return ucChar - '0';
+    }
+    else if( ( ucChar >= 'a' ) && ( ucChar <= 'f' ) )
+    {
+        return ucChar - 'a' + 10;
+    }
+    else if( ( ucChar >= 'A' ) && ( ucChar <= 'F' ) )
+    {
+        return ucChar - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Unescape the next character of a JSON string.
+ *
+ * Only \u escapes of ASCII characters are accepted, neither the signed text
+ * nor the certificates have others.
+ *
+ * @return One of the azureiotcarecoveryUNESCAPE_ values, with the byte in
+ * \p pucByte for azureiotcarecoveryUNESCAPE_BYTE.
+ */
+static int32_t prvUnescape( AzureIoTCARecovery_StreamObject * pxObject,
+                            uint8_t ucChar,
+                            uint8_t * pucByte )
+{
+    int32_t lValue;
+
+    if( pxObject->ucEscape == 0U )
+    {
+        if( ucChar == '"' )
+        {
+            return azureiotcarecoveryUNESCAPE_END;
+        }
+        else if( ucChar == '\\' )
+        {
+            pxObject->ucEscape = 1;
+            return azureiotcarecoveryUNESCAPE_PENDING;
+        }
+        else if( ucChar < 0x20U )
+        {
+            return azureiotcarecoveryUNESCAPE_ERROR;
+        }
+
+        *pucByte = ucChar;
+        return azureiotcarecoveryUNESCAPE_BYTE;
+    }
+
+    if( pxObject->ucEscape == 1U )
+    {
+        pxObject->ucEscape = 0;
+
+        switch( ucChar )
+        {
+            case '"':
+            case '\\':
+            case '/':
+                *pucByte = ucChar;
+                break;
+
+            case 'b':
+                *pucByte = '\b';
+                break;
+
+            case 'f':
+                *pucByte = '\f';
+                break;
+
+            case 'n':
+                *pucByte = '\n';
+                break;
+
+            case 'r':
+                *pucByte = '\r';
+                break;
+
+            case 't':
+                *pucByte = '\t';
+                break;
+
+            case 'u':
+                pxObject->ucEscape = 2;
+                pxObject->usUnicode = 0;
+                return azureiotcarecoveryUNESCAPE_PENDING;
+
+            default:
+                return azureiotcarecoveryUNESCAPE_ERROR;
+        }
+
+        return azureiotcarecoveryUNESCAPE_BYTE;
+    }
+
+    /* The four digits of a \u escape, ucEscape counting from 2. */
+    lValue = prvHexValue( ucChar );
+
+    if( lValue < 0 )
+    {
+        return azureiotcarecoveryUNESCAPE_ERROR;
+    }
+
+    pxObject->usUnicode = ( uint16_t ) ( ( pxObject->usUnicode << 4 ) | ( uint16_t ) lValue );
+
+    if( ++pxObject->ucEscape < 6U )
+    {
+        return azureiotcarecoveryUNESCAPE_PENDING;
+    }
+
+    pxObject->ucEscape = 0;
+
+    if( pxObject->usUnicode >= 0x80U )
+    {
+        return azureiotcarecoveryUNESCAPE_ERROR;
+    }
+
+    *pucByte = ( uint8_t ) pxObject->usUnicode;
+
+    return azureiotcarecoveryUNESCAPE_BYTE;
+}
+
+static uint32_t prvKeyIs( const AzureIoTCARecovery_StreamObject * pxObject,
+                          const char * pcName )
+{
+    size_t xNameLength = strlen( pcName );
+
+    return ( pxObject->ucKeyLength == xNameLength ) &&
+           ( memcmp( pxObject->cKey, pcName, xNameLength ) == 0 );
+}
+
+static uint8_t prvFindMember( AzureIoTCARecovery_StreamParser * pxParser,
+                              const AzureIoTCARecovery_StreamObject * pxObject )
+{
+    if( pxObject == &pxParser->xPayload )
+    {
+        if( prvKeyIs( pxObject, azureiotcarecoverySIGNATURE_NAME ) )
+        {
+            return eStreamMemberSignature;
+        }
+        else if( prvKeyIs( pxObject, azureiotcarecoveryCERT_TRUST_BUNDLE_NAME ) )
+        {
+            return eStreamMemberCertTrustBundle;
+        }
+    }
+    else
+    {
+        if( prvKeyIs( pxObject, azureiotcarecoveryVERSION_NAME ) )
+        {
+            return eStreamMemberVersion;
+        }
+        else if( prvKeyIs( pxObject, azureiotcarecoveryEXPIRY_TIME_NAME ) )
+        {
+            return eStreamMemberExpiryTime;
+        }
+        else if( prvKeyIs( pxObject, azureiotcarecoveryCERTS_NAME ) )
+        {
+            return eStreamMemberCerts;
+        }
+    }
+
+    return eStreamMemberNone;
+}
+
+static AzureIoTResult_t prvFlushSignedText( AzureIoTCARecovery_StreamParser * pxParser )
+{
+    int32_t lMbedTLSResult = 0;
+
+    if( pxParser->ulSignedChunkLength > 0U )
+    {
+        lMbedTLSResult = mbedtls_md_update( &pxParser->xSHA256Context,
+                                            pxParser->ucSignedChunk,
+                                            pxParser->ulSignedChunkLength );
+        pxParser->ulSignedChunkLength = 0;
+    }
+
+    return lMbedTLSResult == 0 ? eAzureIoTSuccess : eAzureIoTErrorFailed;
+}
+
+static AzureIoTResult_t prvFlushCertificates( AzureIoTCARecovery_StreamParser * pxParser )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+
+    if( pxParser->ulChunkLength > 0U )
+    {
+        xResult = pxParser->xCertificatesWrite( pxParser->pvCertificatesWriteContext,
+                                                pxParser->ulCertificatesLength,
+                                                pxParser->ucChunk,
+                                                pxParser->ulChunkLength );
+        pxParser->ulCertificatesLength += pxParser->ulChunkLength;
+        pxParser->ulChunkLength = 0;
+    }
+
+    return xResult;
+}
+
+static AzureIoTResult_t prvStringByte( AzureIoTCARecovery_StreamParser * pxParser,
+                                       uint8_t ucMember,
+                                       uint8_t ucByte )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+
+    switch( ucMember )
+    {
+        case eStreamMemberSignature:
+
+            if( pxParser->ulSignatureLength >= sizeof( pxParser->ucSignature ) )
+            {
+                return eAzureIoTErrorOutOfMemory;
+            }
+
+            pxParser->ucSignature[ pxParser->ulSignatureLength++ ] = ucByte;
+            break;
+
+        /* The signed text is hashed as it is, and parsed in turn. */
+        case eStreamMemberCertTrustBundle:
+            pxParser->ucSignedChunk[ pxParser->ulSignedChunkLength++ ] = ucByte;
+
+            if( pxParser->ulSignedChunkLength == sizeof( pxParser->ucSignedChunk ) )
+            {
+                xResult = prvFlushSignedText( pxParser );
+            }
+
+            if( xResult == eAzureIoTSuccess )
+            {
+                xResult = prvObjectFeed( pxParser, &pxParser->xTrustBundle, ucByte );
+            }
+
+            break;
+
+        case eStreamMemberCerts:
+            pxParser->ucChunk[ pxParser->ulChunkLength++ ] = ucByte;
+
+            if( pxParser->ulChunkLength == sizeof( pxParser->ucChunk ) )
+            {
+                xResult = prvFlushCertificates( pxParser );
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    return xResult;
+}
+
+static AzureIoTResult_t prvStringEnd( AzureIoTCARecovery_StreamParser * pxParser,
+                                      uint8_t ucMember )
+{
+    if( ucMember == eStreamMemberCertTrustBundle )
+    {
+        if( pxParser->xTrustBundle.ucState != eStreamStateDone )
+        {
+            return eAzureIoTErrorFailed;
+        }
+
+        return prvFlushSignedText( pxParser );
+    }
+    else if( ucMember == eStreamMemberCerts )
+    {
+        return prvFlushCertificates( pxParser );
+    }
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t prvNumber( AzureIoTCARecovery_StreamParser * pxParser,
+                                   uint8_t ucMember,
+                                   uint64_t ullNumber )
+{
+    if( ucMember == eStreamMemberVersion )
+    {
+        if( ullNumber > UINT32_MAX )
+        {
+            return eAzureIoTErrorFailed;
+        }
+
+        pxParser->ulVersion = ( uint32_t ) ullNumber;
+    }
+    else if( ucMember == eStreamMemberExpiryTime )
+    {
+        pxParser->ullExpiryTimeSecs = ullNumber;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/**
+ * @brief Read the next character of a JSON object, the payload or the trust
+ * bundle inside of its certTrustBundle string.
+ */
+static AzureIoTResult_t prvObjectFeed( AzureIoTCARecovery_StreamParser * pxParser,
+                                       AzureIoTCARecovery_StreamObject * pxObject,
+                                       uint8_t ucChar )
+{
+    AzureIoTResult_t xResult;
+    uint8_t ucByte;
+    int32_t lUnescape;
+
+    switch( pxObject->ucState )
+    {
+        case eStreamStateString:
+            lUnescape = prvUnescape( pxObject, ucChar, &ucByte );
+
+            if( lUnescape == azureiotcarecoveryUNESCAPE_BYTE )
+            {
+                return prvStringByte( pxParser, pxObject->ucMember, ucByte );
+            }
+            else if( lUnescape == azureiotcarecoveryUNESCAPE_END )
+            {
+                pxObject->ucState = eStreamStateNext;
+                return prvStringEnd( pxParser, pxObject->ucMember );
+            }
+
+            return lUnescape == azureiotcarecoveryUNESCAPE_PENDING ? eAzureIoTSuccess : eAzureIoTErrorFailed;
+
+        case eStreamStateKeyText:
+            lUnescape = prvUnescape( pxObject, ucChar, &ucByte );
+
+            if( lUnescape == azureiotcarecoveryUNESCAPE_BYTE )
+            {
+                /* A key too long is no member read, and is left one byte longer
+                 * than the buffer to never match. */
+                if( pxObject->ucKeyLength < sizeof( pxObject->cKey ) )
+                {
+                    pxObject->cKey[ pxObject->ucKeyLength++ ] = ( char ) ucByte;
+                }
+                else
+                {
+                    pxObject->ucKeyLength = sizeof( pxObject->cKey ) + 1U;
+                }
+            }
+            else if( lUnescape == azureiotcarecoveryUNESCAPE_END )
+            {
+                pxObject->ucMember = prvFindMember( pxParser, pxObject );
+                pxObject->ucState = eStreamStateColon;
+            }
+
+            return lUnescape == azureiotcarecoveryUNESCAPE_ERROR ? eAzureIoTErrorFailed : eAzureIoTSuccess;
+
+        case eStreamStateNumber:
+
+            if( ( ucChar >= '0' ) && ( ucChar <= '9' ) )
+            {
+                if( pxObject->ullNumber > ( UINT64_MAX - ( uint64_t ) ( ucChar - '0' ) ) / 10U )
+                {
+                    return eAzureIoTErrorFailed;
+                }
+
+                pxObject->ullNumber = pxObject->ullNumber * 10U + ( uint64_t ) ( ucChar - '0' );
+                return eAzureIoTSuccess;
+            }
+
+            xResult = prvNumber( pxParser, pxObject->ucMember, pxObject->ullNumber );
+
+            if( xResult != eAzureIoTSuccess )
+            {
+                return xResult;
+            }
+
+            /* The character after the number is read as the one after a value. */
+            pxObject->ucState = eStreamStateNext;
+            return prvObjectFeed( pxParser, pxObject, ucChar );
+
+        case eStreamStateSkip:
+
+            if( prvIsWhitespace( ucChar ) || ( ucChar == ',' ) || ( ucChar == '}' ) )
+            {
+                pxObject->ucState = eStreamStateNext;
+                return prvObjectFeed( pxParser, pxObject, ucChar );
+            }
+
+            return eAzureIoTSuccess;
+
+        case eStreamStateNested:
+
+            if( ucChar == '"' )
+            {
+                pxObject->ucState = eStreamStateNestedString;
+            }
+            else if( ( ucChar == '{' ) || ( ucChar == '[' ) )
+            {
+                pxObject->ulDepth++;
+            }
+            else if( ( ( ucChar == '}' ) || ( ucChar == ']' ) ) && ( --pxObject->ulDepth == 0U ) )
+            {
+                pxObject->ucState = eStreamStateNext;
+            }
+
+            return eAzureIoTSuccess;
+
+        case eStreamStateNestedString:
+
+            if( pxObject->ucEscape != 0U )
+            {
+                pxObject->ucEscape = 0;
+            }
+            else if( ucChar == '\\' )
+            {
+                pxObject->ucEscape = 1;
+            }
+            else if( ucChar == '"' )
+            {
+                pxObject->ucState = eStreamStateNested;
+            }
+
+            return eAzureIoTSuccess;
+
+        default:
+            break;
+    }
+
+    /* The other states are between tokens. */
+    if( prvIsWhitespace( ucChar ) )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    switch( pxObject->ucState )
+    {
+        case eStreamStateObject:
+
+            if( ucChar != '{' )
+            {
+                return eAzureIoTErrorFailed;
+            }
+
+            pxObject->ucState = eStreamStateFirstKey;
+            break;
+
+        case eStreamStateFirstKey:
+        case eStreamStateKey:
+
+            if( ( ucChar == '}' ) && ( pxObject->ucState == eStreamStateFirstKey ) )
+            {
+                pxObject->ucState = eStreamStateDone;
+            }
+            else if( ucChar == '"' )
+            {
+                pxObject->ucKeyLength = 0;
+                pxObject->ucState = eStreamStateKeyText;
+            }
+            else
+            {
+                return eAzureIoTErrorFailed;
+            }
+
+            break;
+
+        case eStreamStateColon:
+
+            if( ucChar != ':' )
+            {
+                return eAzureIoTErrorFailed;
+            }
+
+            pxObject->ucState = eStreamStateValue;
+            break;
+
+        case eStreamStateValue:
+
+            /* Each member is read once. */
+            if( pxObject->ucMember != eStreamMemberNone )
+            {
+                if( ( pxParser->ulMembersFound & ( 1U << pxObject->ucMember ) ) != 0U )
+                {
+                    return eAzureIoTErrorFailed;
+                }
+
+                pxParser->ulMembersFound |= 1U << pxObject->ucMember;
+            }
+
+            if( ucChar == '"' )
+            {
+                if( ( pxObject->ucMember == eStreamMemberVersion ) ||
+                    ( pxObject->ucMember == eStreamMemberExpiryTime ) )
+                {
+                    return eAzureIoTErrorFailed;
+                }
+
+                pxObject->ucState = eStreamStateString;
+            }
+            else if( ( ucChar >= '0' ) && ( ucChar <= '9' ) &&
+                     ( ( pxObject->ucMember == eStreamMemberVersion ) ||
+                       ( pxObject->ucMember == eStreamMemberExpiryTime ) ) )
+            {
+                pxObject->ullNumber = ( uint64_t ) ( ucChar - '0' );
+                pxObject->ucState = eStreamStateNumber;
+            }
+            else if( pxObject->ucMember != eStreamMemberNone )
+            {
+                return eAzureIoTErrorFailed;
+            }
+            else if( ( ucChar == '{' ) || ( ucChar == '[' ) )
+            {
+                pxObject->ulDepth = 1;
+                pxObject->ucState = eStreamStateNested;
+            }
+            else
+            {
+                pxObject->ucState = eStreamStateSkip;
+            }
+
+            break;
+
+        case eStreamStateNext:
+
+            if( ucChar == ',' )
+            {
+                pxObject->ucState = eStreamStateKey;
+            }
+            else if( ucChar == '}' )
+            {
+                pxObject->ucState = eStreamStateDone;
+            }
+            else
+            {
+                return eAzureIoTErrorFailed;
+            }
+
+            break;
+
+        default:
+            /* Anything but whitespace after the object. */
+            return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTCARecovery_StreamInit( AzureIoTCARecovery_StreamParser * pxParser,
+                                                AzureIoTCARecovery_CertificatesWrite xCertificatesWrite,
+                                                void * pvContext )
+{
+    if( ( pxParser == NULL ) || ( xCertificatesWrite == NULL ) )
+    {
+        AZLogError( ( "[CA] Invalid recovery payload parser" ) );
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    memset( pxParser, 0, sizeof( *pxParser ) );
+    pxParser->xCertificatesWrite = xCertificatesWrite;
+    pxParser->pvCertificatesWriteContext = pvContext;
+
+    mbedtls_md_init( &pxParser->xSHA256Context );
+
+    if( ( mbedtls_md_setup( &pxParser->xSHA256Context, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 ) != 0 ) ||
+        ( mbedtls_md_starts( &pxParser->xSHA256Context ) != 0 ) )
+    {
+        AZLogError( ( "[CA] Failed to start the SHA256 of the recovery payload" ) );
+        mbedtls_md_free( &pxParser->xSHA256Context );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTCARecovery_StreamFeed( AzureIoTCARecovery_StreamParser * pxParser,
+                                                const uint8_t * pucData,
+                                                uint32_t ulLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulLength; ulIndex++ )
+    {
+        xResult = prvObjectFeed( pxParser, &pxParser->xPayload, pucData[ ulIndex ] );
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            AZLogError( ( "[CA] Recovery payload failed to parse at '%c', res: %d",
+                          pucData[ ulIndex ], xResult ) );
+            return xResult;
+        }
+    }
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTCARecovery_StreamFinish( AzureIoTCARecovery_StreamParser * pxParser )
+{
+    if( ( pxParser->xPayload.ucState != eStreamStateDone ) ||
+        ( ( pxParser->ulMembersFound & azureiotcarecoveryREQUIRED_MEMBERS ) != azureiotcarecoveryREQUIRED_MEMBERS ) )
+    {
+        AZLogError( ( "[CA] Recovery payload incomplete" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( mbedtls_md_finish( &pxParser->xSHA256Context, pxParser->ucTrustBundleHash ) != 0 )
+    {
+        AZLogError( ( "[CA] Failed to finish the SHA256 of the recovery payload" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+void AzureIoTCARecovery_StreamDeinit( AzureIoTCARecovery_StreamParser * pxParser )
+{
+    mbedtls_md_free( &pxParser->xSHA256Context );
+}
@@ -0,0 +1,248 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "azure_ca_recovery_trust_bundle.h"
+
+#include <string.h>
+
+#include "azure_iot_config.h"
+
+#include "transport_tls_trust_bundle.h"
+
+#include "mbedtls/x509_crt.h"
+
+#define azureiotcarecoveryPEM_BEGIN    "-----BEGIN CERTIFICATE-----"
+#define azureiotcarecoveryPEM_END      "-----END CERTIFICATE-----"
+
+/**
+ * @brief Find a marker in a buffer.
+ *
+ * @return A pointer to the marker, or NULL when it is not between \p pucStart and \p pucEnd.
+ */
+static const uint8_t * prvFind( const uint8_t * pucStart,
+                                const uint8_t * pucEnd,
+                                const char * pcMarker )
+{
+    size_t xMarkerLength = strlen( pcMarker );
+
+    while( ( size_t ) ( pucEnd - pucStart ) >= xMarkerLength )
+    {
+        if( memcmp( pucStart, pcMarker, xMarkerLength ) == 0 )
+        {
+            return pucStart;
+        }
+
+        pucStart++;
+    }
+
+    return NULL;
+}
+
+static int32_t prvBase64Value( uint8_t ucChar )
+{
+    if( ( ucChar >= 'A' ) && ( ucChar <= 'Z' ) )
+    {
+        return ucChar - 'A';
+    }
+    else if( ( ucChar >= 'a' ) && ( ucChar <= 'z' ) )
+    {
+        return ucChar - 'a' + 26;
+    }
+    else if( ( ucChar >= '0' ) && ( ucChar <= '9' ) )
+    {
+        return ucChar - '0' + 52;
+    }
+    else if( ucChar == '+' )
+    {
+        return 62;
+    }
+    else if( ucChar == '/' )
+    {
+        return 63;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Decode the base64 body of a PEM certificate, skipping the line breaks.
+ *
+ * A byte is written only after the characters it is decoded from are read, so
+ * \p pucOutput may be \p pucInput or any place before it.
+ */
+static AzureIoTResult_t prvDecodeBase64( const uint8_t * pucInput,
+                                         uint32_t ulInputLength,
+                                         uint8_t * pucOutput,
+                                         uint32_t * pulOutputLength )
+{
+    uint32_t ulBits = 0;
+    uint32_t ulBitCount = 0;
+    uint32_t ulPadding = 0;
+    uint32_t ulLength = 0;
+    uint32_t ulIndex;
+    int32_t lValue;
+
+    for( ulIndex = 0; ulIndex < ulInputLength; ulIndex++ )
+    {
+        if( ( pucInput[ ulIndex ] == '\r' ) || ( pucInput[ ulIndex ] == '\n' ) ||
+            ( pucInput[ ulIndex ] == ' ' ) || ( pucInput[ ulIndex ] == '\t' ) )
+        {
+            continue;
+        }
+
+        if( pucInput[ ulIndex ] == '=' )
+        {
+            ulPadding++;
+            continue;
+        }
+
+        lValue = prvBase64Value( pucInput[ ulIndex ] );
+
+        if( ( lValue < 0 ) || ( ulPadding > 0U ) )
+        {
+            return eAzureIoTErrorFailed;
+        }
+
+        ulBits = ( ( ulBits << 6 ) | ( uint32_t ) lValue ) & 0x3FFFU;
+        ulBitCount += 6;
+
+        if( ulBitCount >= 8U )
+        {
+            ulBitCount -= 8;
+            pucOutput[ ulLength++ ] = ( uint8_t ) ( ulBits >> ulBitCount );
+        }
+    }
+
+    /* A single character left over holds less than a byte. */
+    if( ( ulPadding > 2U ) || ( ulBitCount >= 6U ) || ( ulLength == 0U ) )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    *pulOutputLength = ulLength;
+
+    return eAzureIoTSuccess;
+}
+
+static void prvWriteUint32( uint8_t * pucBytes,
+                            uint32_t ulValue )
+{
+    pucBytes[ 0 ] = ( uint8_t ) ulValue;
+    pucBytes[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucBytes[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucBytes[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+
+AzureIoTResult_t AzureIoTCARecovery_ConvertTrustBundle( uint8_t * pucBuffer,
+                                                        uint32_t ulBufferLength,
+                                                        uint32_t ulPemLength,
+                                                        uint32_t * pulBundleLength )
+{
+    const uint8_t * pucPemEnd = pucBuffer + ulPemLength;
+    const uint8_t * pucCursor = pucBuffer;
+    const uint8_t * pucBegin;
+    const uint8_t * pucEnd;
+    uint8_t * pucEntry;
+    uint32_t ulCount = 0;
+    uint32_t ulDerLength = 0;
+    uint32_t ulCertificateLength;
+    uint32_t ulIndexLength;
+    uint32_t ulOffset;
+    uint32_t ulIndex;
+    int32_t lMbedTLSResult;
+    mbedtls_x509_crt xCertificate;
+
+    if( ( pucBuffer == NULL ) || ( pulBundleLength == NULL ) || ( ulPemLength > ulBufferLength ) )
+    {
+        AZLogError( ( "[CA] Invalid trust bundle buffer" ) );
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    /* Decode the certificates one after the other to the start of the buffer.
+     * The DER is shorter than the PEM it comes from, so it never reaches the
+     * text still to be decoded. */
+    while( ( pucBegin = prvFind( pucCursor, pucPemEnd, azureiotcarecoveryPEM_BEGIN ) ) != NULL )
+    {
+        pucBegin += sizeof( azureiotcarecoveryPEM_BEGIN ) - 1;
+        pucEnd = prvFind( pucBegin, pucPemEnd, azureiotcarecoveryPEM_END );
+
+        if( pucEnd == NULL )
+        {
+            AZLogError( ( "[CA] Certificate %u of the trust bundle is not terminated", ( unsigned ) ulCount ) );
+            return eAzureIoTErrorFailed;
+        }
+
+        if( prvDecodeBase64( pucBegin, ( uint32_t ) ( pucEnd - pucBegin ),
+                             pucBuffer + ulDerLength, &ulCertificateLength ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "[CA] Certificate %u of the trust bundle is not valid base64", ( unsigned ) ulCount ) );
+            return eAzureIoTErrorFailed;
+        }
+
+        ulDerLength += ulCertificateLength;
+        ulCount++;
+        pucCursor = pucEnd + sizeof( azureiotcarecoveryPEM_END ) - 1;
+    }
+
+    if( ulCount == 0U )
+    {
+        AZLogError( ( "[CA] No certificate in the trust bundle" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    ulIndexLength = transporttlsTRUST_BUNDLE_INDEX_SIZE( ulCount );
+
+    if( ulIndexLength + ulDerLength > ulBufferLength )
+    {
+        AZLogError( ( "[CA] Buffer not large enough for the trust bundle" ) );
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    memmove( pucBuffer + ulIndexLength, pucBuffer, ulDerLength );
+
+    /* Parse the certificates to check them, and to find where each ends and
+     * its subject. */
+    ulOffset = ulIndexLength;
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        mbedtls_x509_crt_init( &xCertificate );
+        lMbedTLSResult = mbedtls_x509_crt_parse_der( &xCertificate,
+                                                     pucBuffer + ulOffset,
+                                                     ulIndexLength + ulDerLength - ulOffset );
+
+        if( lMbedTLSResult == 0 )
+        {
+            pucEntry = pucBuffer + transporttlsTRUST_BUNDLE_INDEX_SIZE( ulIndex );
+            prvWriteUint32( pucEntry, ulOffset );
+            prvWriteUint32( pucEntry + 4, ( uint32_t ) xCertificate.raw.len );
+            lMbedTLSResult = TLS_TrustBundle_HashSubject( xCertificate.subject_raw.p,
+                                                          xCertificate.subject_raw.len,
+                                                          pucEntry + 8 );
+            ulOffset += ( uint32_t ) xCertificate.raw.len;
+        }
+
+        mbedtls_x509_crt_free( &xCertificate );
+
+        if( lMbedTLSResult != 0 )
+        {
+            AZLogError( ( "[CA] Certificate %u of the trust bundle failed to parse, res: %08x",
+                          ( unsigned ) ulIndex, ( uint16_t ) lMbedTLSResult ) );
+            return eAzureIoTErrorFailed;
+        }
+    }
+
+    /* Data after a certificate in its PEM block. */
+    if( ulOffset != ulIndexLength + ulDerLength )
+    {
+        AZLogError( ( "[CA] Trailing data in the trust bundle" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    memcpy( pucBuffer, transporttlsTRUST_BUNDLE_MAGIC, sizeof( transporttlsTRUST_BUNDLE_MAGIC ) - 1 );
+    prvWriteUint32( pucBuffer + 4, ulCount );
+
+    *pulBundleLength = ulOffset;
+
+    return eAzureIoTSuccess;
+}
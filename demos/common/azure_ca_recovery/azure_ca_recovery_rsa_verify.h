@@ -1,8 +1,12 @@
 /* Copyright (c) Microsoft Corporation.
  * Licensed under the MIT License. */
 
+#include <stdint.h>
+
 #include "azure_iot_result.h"
 
+#include "mbedtls/rsa.h"
+
 #define azureiotrsaverifySHA256_SIZE_BYTES               32                                                                       /**< Size of the SHA256 hash. */
 #define azureiotrsaverifyRSA3072_SIZE_BYTES              384                                                                      /**< Size of the RSA 3072 key. */
 #define azureiotrsaverifySHA_CALCULATION_SCRATCH_SIZE    azureiotrsaverifyRSA3072_SIZE_BYTES + azureiotrsaverifySHA256_SIZE_BYTES /**< Size of the sha calculation scratch space. */
@@ -34,3 +38,145 @@ AzureIoTResult_t AzureIoTSample_RS256Verify( uint8_t * pucInput,
                                              uint32_t ulELength,
                                              uint8_t * pucBuffer,
                                              uint32_t ulBufferLength );
+
+/**
+ * @brief Verify an RS256 signature over a SHA256 computed by the caller, as
+ * the one of a payload hashed as it is received.
+ *
+ * @param pucHash The SHA256, `azureiotrsaverifySHA256_SIZE_BYTES` in bytes.
+ * @param pucSignature The base64 encoded signature which will be decrypted by \p pucN and \p pucE.
+ * @param ulSignatureLength The length of \p pucSignature.
+ * @param pucN The key's modulus which is used to decrypt \p signature.
+ * @param ulNLength The length of \p pucN.
+ * @param pucE The exponent used for the key.
+ * @param ulELength The length of \p pucE.
+ * @param pucBuffer The buffer used as scratch space to decode the signature. It should be at least
+ * `azureiotrsaverifyRSA3072_SIZE_BYTES` in bytes.
+ * @param ulBufferLength The length of \p pucBuffer.
+ * @return AzureIoTResult_t The result of the operation.
+ */
+AzureIoTResult_t AzureIoTSample_RS256VerifyHash( const uint8_t * pucHash,
+                                                 uint8_t * pucSignature,
+                                                 uint32_t ulSignatureLength,
+                                                 uint8_t * pucN,
+                                                 uint32_t ulNLength,
+                                                 uint8_t * pucE,
+                                                 uint32_t ulELength,
+                                                 uint8_t * pucBuffer,
+                                                 uint32_t ulBufferLength );
+
+/**
+ * @brief An RSA public key imported and checked once, to verify RS256
+ * signatures with it again and again.
+ *
+ * mbedTLS also keeps the Montgomery constant of the modulus in the context
+ * after the first verification, so later ones skip computing it.
+ */
+typedef struct AzureIoTSample_RS256Verifier
+{
+    mbedtls_rsa_context xRSAContext;
+
+    uint32_t ulSetupTimeUs;      /* Time spent importing and checking the key */
+    uint32_t ulVerifications;    /* Signatures checked */
+    uint32_t ulFailures;         /* Signatures checked which did not verify */
+    uint64_t ullVerifyTimeUs;    /* Time spent checking signatures */
+    uint32_t ulLastVerifyTimeUs; /* Time spent on the last signature or batch */
+} AzureIoTSample_RS256Verifier;
+
+/**
+ * @brief A signature of a batch given to AzureIoTSample_RS256VerifierVerifyBatch().
+ */
+typedef struct AzureIoTSample_RS256VerifyItem
+{
+    const uint8_t * pucInput;   /* The input signed, hashed when pucHash is NULL */
+    uint32_t ulInputLength;
+    const uint8_t * pucHash;    /* The SHA256 of the input, when already computed */
+    uint8_t * pucSignature;     /* The base64 encoded signature */
+    uint32_t ulSignatureLength;
+
+    AzureIoTResult_t xResult;   /* Set to the result of the verification */
+} AzureIoTSample_RS256VerifyItem;
+
+/**
+ * @brief Import and check the public key of a verifier.
+ *
+ * @param pxVerifier The verifier, freed with AzureIoTSample_RS256VerifierDeinit() even on failure.
+ * @param pucN The key's modulus.
+ * @param ulNLength The length of \p pucN, at most `azureiotrsaverifyRSA3072_SIZE_BYTES`.
+ * @param pucE The exponent used for the key.
+ * @param ulELength The length of \p pucE.
+ * @return AzureIoTResult_t The result of the operation.
+ */
+AzureIoTResult_t AzureIoTSample_RS256VerifierInit( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                   uint8_t * pucN,
+                                                   uint32_t ulNLength,
+                                                   uint8_t * pucE,
+                                                   uint32_t ulELength );
+
+/**
+ * @brief Verify an RS256 signature over a SHA256 with the key of a verifier.
+ *
+ * @param pxVerifier The verifier.
+ * @param pucHash The SHA256, `azureiotrsaverifySHA256_SIZE_BYTES` in bytes.
+ * @param pucSignature The base64 encoded signature.
+ * @param ulSignatureLength The length of \p pucSignature.
+ * @param pucBuffer The buffer used as scratch space to decode the signature. It should be as large
+ * as the base64 decoder asks, a few bytes more than the size of the key, and
+ * `azureiotrsaverifyRSA3072_SIZE_BYTES` for any key supported.
+ * @param ulBufferLength The length of \p pucBuffer.
+ * @return AzureIoTResult_t The result of the operation.
+ */
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerifyHash( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                         const uint8_t * pucHash,
+                                                         uint8_t * pucSignature,
+                                                         uint32_t ulSignatureLength,
+                                                         uint8_t * pucBuffer,
+                                                         uint32_t ulBufferLength );
+
+/**
+ * @brief Verify an RS256 signature over an input with the key of a verifier.
+ *
+ * @param pxVerifier The verifier.
+ * @param pucInput The input over which the RS256 will be verified.
+ * @param ulInputLength The length of \p pucInput.
+ * @param pucSignature The base64 encoded signature.
+ * @param ulSignatureLength The length of \p pucSignature.
+ * @param pucBuffer The buffer used as scratch space to make the calculations. It should be at least
+ * `azureiotrsaverifySHA256_SIZE_BYTES` more than the size of the key,
+ * `azureiotrsaverifySHA_CALCULATION_SCRATCH_SIZE` for any key supported.
+ * @param ulBufferLength The length of \p pucBuffer.
+ * @return AzureIoTResult_t The result of the operation.
+ */
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerify( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                     const uint8_t * pucInput,
+                                                     uint32_t ulInputLength,
+                                                     uint8_t * pucSignature,
+                                                     uint32_t ulSignatureLength,
+                                                     uint8_t * pucBuffer,
+                                                     uint32_t ulBufferLength );
+
+/**
+ * @brief Verify a batch of RS256 signatures with the key of a verifier.
+ *
+ * Every signature is checked, even after one failed, and its result is set
+ * in its item.
+ *
+ * @param pxVerifier The verifier.
+ * @param pxItems The signatures.
+ * @param ulItemCount The number of \p pxItems.
+ * @param pucBuffer The buffer used as scratch space, as for AzureIoTSample_RS256VerifierVerify().
+ * @param ulBufferLength The length of \p pucBuffer.
+ * @return AzureIoTResult_t eAzureIoTSuccess when all the signatures verified.
+ */
+AzureIoTResult_t AzureIoTSample_RS256VerifierVerifyBatch( AzureIoTSample_RS256Verifier * pxVerifier,
+                                                          AzureIoTSample_RS256VerifyItem * pxItems,
+                                                          uint32_t ulItemCount,
+                                                          uint8_t * pucBuffer,
+                                                          uint32_t ulBufferLength );
+
+/**
+ * @brief Free the key of a verifier.
+ *
+ * @param pxVerifier The verifier.
+ */
+void AzureIoTSample_RS256VerifierDeinit( AzureIoTSample_RS256Verifier * pxVerifier );
@@ -0,0 +1,115 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+
+#include "mbedtls/md.h"
+
+#define azureiotcarecoverySTREAM_SIGNATURE_MAX_LENGTH    512 /**< Base64 length of an RSA 3072 signature. */
+#define azureiotcarecoverySTREAM_KEY_MAX_LENGTH          16  /**< Longest member name told apart, longer ones are skipped. */
+#define azureiotcarecoverySTREAM_CHUNK_SIZE              64  /**< Bytes gathered before they are hashed or written. */
+#define azureiotcarecoverySTREAM_HASH_SIZE               32  /**< Size of the SHA256 of the signed text. */
+
+/**
+ * @brief Write a piece of the unescaped certificates of the trust bundle.
+ *
+ * @param[in] pvContext The context given to AzureIoTCARecovery_StreamInit().
+ * @param[in] ulOffset The offset of \p pucData in the certificates.
+ * @param[in] pucData The certificates text.
+ * @param[in] ulLength The length of \p pucData.
+ * @return AzureIoTResult_t Any failure stops the parsing.
+ */
+typedef AzureIoTResult_t ( * AzureIoTCARecovery_CertificatesWrite )( void * pvContext,
+                                                                    uint32_t ulOffset,
+                                                                    const uint8_t * pucData,
+                                                                    uint32_t ulLength );
+
+/**
+ * @brief State of a JSON object read one character at a time.
+ *
+ * @note The fields are internal to the stream parser.
+ */
+typedef struct AzureIoTCARecovery_StreamObject
+{
+    uint8_t ucState;
+    uint8_t ucMember;
+    uint8_t ucEscape;
+    uint8_t ucKeyLength;
+    char cKey[ azureiotcarecoverySTREAM_KEY_MAX_LENGTH ];
+    uint16_t usUnicode;
+    uint32_t ulDepth;
+    uint64_t ullNumber;
+} AzureIoTCARecovery_StreamObject;
+
+/**
+ * @brief Parser of a CA recovery payload given in pieces.
+ *
+ * The certTrustBundle text is hashed as it is unescaped, and the certificates
+ * are handed to an AzureIoTCARecovery_CertificatesWrite as they are unescaped
+ * a second time, so the payload does not have to be held whole. Only the
+ * signature is kept.
+ */
+typedef struct AzureIoTCARecovery_StreamParser
+{
+    uint32_t ulVersion;
+    uint64_t ullExpiryTimeSecs;            /* Given as time since epoch */
+
+    uint8_t ucSignature[ azureiotcarecoverySTREAM_SIGNATURE_MAX_LENGTH ];
+    uint32_t ulSignatureLength;
+
+    uint8_t ucTrustBundleHash[ azureiotcarecoverySTREAM_HASH_SIZE ]; /* SHA256 of the unescaped certTrustBundle, set by AzureIoTCARecovery_StreamFinish() */
+    uint32_t ulCertificatesLength;
+
+    /* Internal */
+    AzureIoTCARecovery_StreamObject xPayload;
+    AzureIoTCARecovery_StreamObject xTrustBundle;
+    mbedtls_md_context_t xSHA256Context;
+    AzureIoTCARecovery_CertificatesWrite xCertificatesWrite;
+    void * pvCertificatesWriteContext;
+    uint8_t ucChunk[ azureiotcarecoverySTREAM_CHUNK_SIZE ];
+    uint32_t ulChunkLength;
+    uint8_t ucSignedChunk[ azureiotcarecoverySTREAM_CHUNK_SIZE ];
+    uint32_t ulSignedChunkLength;
+    uint32_t ulMembersFound;
+} AzureIoTCARecovery_StreamParser;
+
+/**
+ * @brief Start parsing a CA recovery payload.
+ *
+ * @param[out] pxParser The parser.
+ * @param[in] xCertificatesWrite Receives the unescaped certificates.
+ * @param[in] pvContext The context given to \p xCertificatesWrite.
+ * @return AzureIoTResult_t
+ */
+AzureIoTResult_t AzureIoTCARecovery_StreamInit( AzureIoTCARecovery_StreamParser * pxParser,
+                                                AzureIoTCARecovery_CertificatesWrite xCertificatesWrite,
+                                                void * pvContext );
+
+/**
+ * @brief Parse the next piece of the payload.
+ *
+ * @param[in,out] pxParser The parser.
+ * @param[in] pucData The piece, which may end anywhere, even inside an escape.
+ * @param[in] ulLength The length of \p pucData.
+ * @return AzureIoTResult_t The parser must not be fed again after a failure.
+ */
+AzureIoTResult_t AzureIoTCARecovery_StreamFeed( AzureIoTCARecovery_StreamParser * pxParser,
+                                                const uint8_t * pucData,
+                                                uint32_t ulLength );
+
+/**
+ * @brief Check the payload is complete and compute the hash of the signed text.
+ *
+ * @param[in,out] pxParser The parser, whose fields are set on success.
+ * @return AzureIoTResult_t
+ */
+AzureIoTResult_t AzureIoTCARecovery_StreamFinish( AzureIoTCARecovery_StreamParser * pxParser );
+
+/**
+ * @brief Free the resources of the parser, after it succeeded or failed.
+ *
+ * @param[in] pxParser The parser.
+ */
+void AzureIoTCARecovery_StreamDeinit( AzureIoTCARecovery_StreamParser * pxParser );
@@ -0,0 +1,26 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+
+/**
+ * @brief Convert the unescaped PEM certificates of a trust bundle into the
+ * indexed DER bundle of transport_tls_trust_bundle.h, in place.
+ *
+ * The certificates are decoded, checked by parsing them and indexed by their
+ * subject. The bundle is about a quarter smaller than the PEM, and the TLS
+ * transports load it without decoding base64.
+ *
+ * @param[in,out] pucBuffer The buffer holding the PEM, which receives the bundle.
+ * @param[in] ulBufferLength The size of \p pucBuffer, which may be more than the PEM.
+ * @param[in] ulPemLength The length of the PEM at the start of \p pucBuffer.
+ * @param[out] pulBundleLength The length of the bundle written.
+ * @return AzureIoTResult_t The result of the operation. The buffer is left
+ * undefined on failure.
+ */
+AzureIoTResult_t AzureIoTCARecovery_ConvertTrustBundle( uint8_t * pucBuffer,
+                                                        uint32_t ulBufferLength,
+                                                        uint32_t ulPemLength,
+                                                        uint32_t * pulBundleLength );
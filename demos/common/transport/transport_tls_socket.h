@@ -10,10 +10,31 @@
 /* SSL Context Handle */
 typedef void * SSLContextHandle;
 
+/**
+ * @brief Handshake counters of a TlsTransportParams_t, kept across connections.
+ */
+typedef struct TlsTransportStats
+{
+    uint32_t ulHandshakes;         /**< Handshakes completed. */
+    uint32_t ulFailedHandshakes;   /**< Handshakes which failed. */
+    uint32_t ulResumptionsOffered; /**< Handshakes which offered a saved session, the server may still do a full handshake. */
+    uint32_t ulLastHandshakeMs;    /**< Time of the last handshake completed. */
+    uint32_t ulMinHandshakeMs;
+    uint32_t ulMaxHandshakeMs;
+    uint32_t ulTotalHandshakeMs;   /**< Sum of the handshake times, divide by ulHandshakes for the mean. */
+    uint32_t ulCryptoSlices;       /**< Times a handshake stopped between two slices of an ECC operation, to yield. */
+    uint32_t ulLastMaxSliceUs;     /**< Longest the last handshake ran without a socket call or a yield. */
+    uint32_t ulMaxSliceUs;         /**< Longest of the ulLastMaxSliceUs. */
+    uint32_t ulInBufferBytes;      /**< Input record buffer of the last connection, after its handshake. */
+    uint32_t ulOutBufferBytes;     /**< Output record buffer of the last connection, after its handshake. */
+} TlsTransportStats_t;
+
 typedef struct TlsTransportParams
 {
     SocketHandle xTCPSocket;
     SSLContextHandle xSSLContext;
+    TlsTransportStats_t xStats; /**< Updated by TLS_Socket_Connect(). */
+    void * pvSession;           /**< Session saved for resumption, freed by TLS_Socket_ForgetSession(). */
 } TlsTransportParams_t;
 
 /**
@@ -32,12 +53,38 @@ typedef struct NetworkCredentials
      */
     BaseType_t xDisableSni;
 
-    const uint8_t * pucRootCa;     /**< @brief String representing a trusted server root certificate. */
+    const uint8_t * pucRootCa;     /**< @brief String representing a trusted server root certificate, or a trust bundle of transport_tls_trust_bundle.h kept for the connection. */
     size_t xRootCaSize;            /**< @brief Size associated with #NetworkCredentials.pRootCa. */
     const uint8_t * pucClientCert; /**< @brief String representing the client certificate. */
     size_t xClientCertSize;        /**< @brief Size associated with #NetworkCredentials.pClientCert. */
     const uint8_t * pucPrivateKey; /**< @brief String representing the client certificate's private key. */
     size_t xPrivateKeySize;        /**< @brief Size associated with #NetworkCredentials.pPrivateKey. */
+
+    /**
+     * @brief Save the session in the TlsTransportParams_t and offer it on the
+     * next connection, to skip the certificates and the key exchange when
+     * the server accepts it.
+     */
+    BaseType_t xEnableSessionResumption;
+
+    /**
+     * @brief Budget of the slices of the ECC operations of the handshake, in
+     * the basic operations of mbedtls_ecp_set_max_ops(). The handshake yields
+     * between two slices, so a key exchange or a signature does not hold the
+     * CPU whole. 0 runs each operation whole. Needs MBEDTLS_ECP_RESTARTABLE,
+     * with which mbed TLS slices the TLS 1.2 ECDHE-ECDSA suites only. The
+     * budget is global to mbed TLS, the last handshake sets it.
+     */
+    uint32_t ulCryptoSliceMaxOps;
+
+    /**
+     * @brief Longest record the connection asks the server for, 512, 1024,
+     * 2048 or 4096 bytes, 0 does not ask. With
+     * MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH, mbed TLS shrinks the record buffers
+     * to it after the handshake when the ServerHello agrees to it, and keeps
+     * them full size otherwise. Longer payloads take several records.
+     */
+    uint32_t ulMaxFragmentLength;
 } NetworkCredentials_t;
 
 /**
@@ -80,6 +127,14 @@ TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pxNetworkContext,
  */
 void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext );
 
+/**
+ * @brief Free the session saved for resumption, so the next connection does a
+ * full handshake.
+ *
+ * @param[in] pxNetworkContext Pointer to the Network context.
+ */
+void TLS_Socket_ForgetSession( NetworkContext_t * pxNetworkContext );
+
 /**
  * @brief Receive data from TLS.
  *
@@ -40,9 +40,11 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 /* TLS transport header. */
 #include "transport_tls_socket.h"
+#include "transport_tls_trust_bundle.h"
 
 /* FreeRTOS Socket wrapper include. */
 #include "sockets_wrapper.h"
@@ -52,9 +54,74 @@ extern void vLoggingPrintf( const char * pcFormatString,
 #include "mbedtls/entropy.h"
 #include "mbedtls/ssl.h"
 #include "mbedtls/threading.h"
+#include "mbedtls/version.h"
 #include "mbedtls/x509.h"
 #include "mbedtls/error.h"
 
+#if defined( MBEDTLS_ECP_RESTARTABLE )
+    #include "mbedtls/ecp.h"
+#endif
+
+/* Spans of the trace export of the Linux port, empty elsewhere. */
+#include "azure_sample_trace_span.h"
+
+/* Clock of the handshake times of TlsTransportStats_t. */
+#ifndef transporttlsGET_TIME_MS
+    #define transporttlsGET_TIME_MS()    ( ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ) )
+#endif
+
+/* Clock of the slices of the handshake, ports with a finer clock than the
+ * tick define it in FreeRTOSConfig.h. */
+#ifndef transporttlsGET_TIME_US
+    #define transporttlsGET_TIME_US()    ( ( uint64_t ) xTaskGetTickCount() * portTICK_PERIOD_MS * 1000U )
+#endif
+
+/* Ticks the handshake sleeps between two slices of an ECC operation. A
+ * delay, unlike taskYIELD(), also lets the tasks of lower priority run. */
+#ifndef transporttlsCRYPTO_SLICE_DELAY_TICKS
+    #define transporttlsCRYPTO_SLICE_DELAY_TICKS    ( 1U )
+#endif
+
+/* Gives the CPU to the other tasks between two slices of an ECC operation of
+ * the handshake. */
+#ifndef transporttlsCRYPTO_SLICE_YIELD
+    #define transporttlsCRYPTO_SLICE_YIELD()    vTaskDelay( transporttlsCRYPTO_SLICE_DELAY_TICKS )
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Field of the ServerHello read by readServerHello().
+ */
+typedef enum ServerHelloField
+{
+    eServerHelloType,             /**< Handshake message type. */
+    eServerHelloLength,           /**< Handshake message length. */
+    eServerHelloRandom,           /**< Version and random, skipped. */
+    eServerHelloSessionIdLength,  /**< Session id length. */
+    eServerHelloSuite,            /**< Session id, cipher suite and compression, skipped. */
+    eServerHelloExtensionsLength, /**< Length of the extensions. */
+    eServerHelloExtensionType,    /**< Type of an extension. */
+    eServerHelloExtensionLength,  /**< Length of an extension. */
+    eServerHelloExtensionData,    /**< Data of an extension, skipped. */
+    eServerHelloDone              /**< Not reading. */
+} ServerHelloField_t;
+
+/**
+ * @brief Reader of the ServerHello in the bytes received by the handshake,
+ * which tells whether the server agreed to the maximum fragment length.
+ */
+typedef struct ServerHelloReader
+{
+    ServerHelloField_t xField;    /**< @brief Field being read, eServerHelloDone when not reading. */
+    uint32_t ulRecordHeaderBytes; /**< @brief Bytes of the record header read. */
+    uint32_t ulRecordLeft;        /**< @brief Bytes left in the record. */
+    uint32_t ulOffset;            /**< @brief Bytes of the message read. */
+    uint32_t ulFieldEnd;          /**< @brief Offset after the field being read. */
+    uint32_t ulMessageEnd;        /**< @brief Offset after the message. */
+    uint32_t ulValue;             /**< @brief Big endian value of the field being read. */
+} ServerHelloReader_t;
+
 /*-----------------------------------------------------------*/
 
 /* Each transport defines the same NetworkContext. The user then passes their respective transport */
@@ -75,10 +142,18 @@ typedef struct MbedSSLContext
     mbedtls_ssl_context context;             /**< @brief SSL connection context */
     mbedtls_x509_crt_profile certProfile;    /**< @brief Certificate security profile for this connection. */
     mbedtls_x509_crt rootCa;                 /**< @brief Root CA certificate context. */
+    #if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+        TlsTrustBundle_t trustBundle;        /**< @brief Root CA trust bundle looked up by the CA callback. */
+    #endif
     mbedtls_x509_crt clientCert;             /**< @brief Client certificate context. */
     mbedtls_pk_context privKey;              /**< @brief Client private key context. */
     mbedtls_entropy_context entropyContext;  /**< @brief Entropy context for random number generation. */
     mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief CTR DRBG context for random number generation. */
+    BaseType_t xKeepSession;                 /**< @brief Save the session for resumption, see #NetworkCredentials.xEnableSessionResumption. */
+    ServerHelloReader_t xServerHello;        /**< @brief Reads whether the server agreed to the fragment length asked. */
+    SocketHandle xSocket;                    /**< @brief Socket of the handshake, behind the slice timing. */
+    uint64_t ullSliceStartUs;                /**< @brief Start of the slice the handshake is running. */
+    uint32_t ulMaxSliceUs;                   /**< @brief Longest slice of the handshake. */
 } MbedSSLContext_t;
 
 /*-----------------------------------------------------------*/
@@ -113,6 +188,71 @@ static const char * pcNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
 
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Cipher suites offered with an EC device key, ECDSA first.
+ *
+ * The authentication of a suite is the one of the server certificate. In TLS
+ * 1.2 the client signs its CertificateVerify with the device key whatever the
+ * suite, so the suite does not change the cost of that signature. The
+ * ECDHE-ECDSA suites need an ECDSA server certificate, which IoT Hub does not
+ * serve: against IoT Hub this list only narrows the offered suites to the
+ * ECDHE-RSA ones below, and an ECDSA suite is never selected.
+ */
+static const int pxEcdsaCiphersuites[] =
+{
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    0
+};
+
+/**
+ * @brief Curves of the key exchange with an EC device key, P-256 first.
+ *
+ * The default order of mbed TLS 2 starts with the largest curve, whose
+ * exchange costs several times the one of P-256.
+ */
+#if MBEDTLS_VERSION_NUMBER >= 0x03010000
+    static const uint16_t pusEcdsaGroups[] =
+    {
+        #if defined( MBEDTLS_ECP_DP_SECP256R1_ENABLED )
+            MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_SECP384R1_ENABLED )
+            MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_SECP521R1_ENABLED )
+            MBEDTLS_SSL_IANA_TLS_GROUP_SECP521R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_CURVE25519_ENABLED )
+            MBEDTLS_SSL_IANA_TLS_GROUP_X25519,
+        #endif
+        MBEDTLS_SSL_IANA_TLS_GROUP_NONE
+    };
+#else
+    static const mbedtls_ecp_group_id pxEcdsaCurves[] =
+    {
+        #if defined( MBEDTLS_ECP_DP_SECP256R1_ENABLED )
+            MBEDTLS_ECP_DP_SECP256R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_SECP384R1_ENABLED )
+            MBEDTLS_ECP_DP_SECP384R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_SECP521R1_ENABLED )
+            MBEDTLS_ECP_DP_SECP521R1,
+        #endif
+        #if defined( MBEDTLS_ECP_DP_CURVE25519_ENABLED )
+            MBEDTLS_ECP_DP_CURVE25519,
+        #endif
+        MBEDTLS_ECP_DP_NONE
+    };
+#endif /* MBEDTLS_VERSION_NUMBER >= 0x03010000 */
+
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Initialize the mbed TLS structures in a network connection.
  *
@@ -135,7 +275,8 @@ static void sslContextFree( MbedSSLContext_t * pxSslContext );
  * root certificate.
  *
  * @param[out] pxSslContext SSL context to which the trusted server root CA is to be added.
- * @param[in] pucRootCa PEM-encoded string of the trusted server root CA.
+ * @param[in] pucRootCa PEM-encoded string of the trusted server root CA, or
+ * a trust bundle of transport_tls_trust_bundle.h.
  * @param[in] xRootCaSize Size of the trusted server root CA.
  *
  * @return 0 on success; otherwise, failure;
@@ -170,6 +311,14 @@ static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
                               const uint8_t * pucPrivateKey,
                               size_t xPrivateKeySize );
 
+/**
+ * @brief Offer the ECDHE suites, ECDSA first, and the P-256 curve first when
+ * the private key is an EC key, as a P-256 device key.
+ *
+ * @param[in] pxSslContext SSL context whose private key is set.
+ */
+static void setEcdsaConfigurations( MbedSSLContext_t * pxSslContext );
+
 /**
  * @brief Passes TLS credentials to the OpenSSL library.
  *
@@ -198,6 +347,110 @@ static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
                                        const char * pcHostName,
                                        const NetworkCredentials_t * pxNetworkCredentials );
 
+/**
+ * @brief Ask the server for the maximum fragment length of the connection,
+ * when the credentials set one.
+ *
+ * @param[in] pxSslContext SSL context to which the fragment length is to be set.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ */
+static void setMaxFragmentLength( MbedSSLContext_t * pxSslContext,
+                                  const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Read the ServerHello in the bytes received by the handshake, and
+ * stop asking for the maximum fragment length when the server does not agree
+ * to it. mbed TLS would otherwise size the record buffers by it.
+ *
+ * @param[in] pxSslContext SSL context of the handshake.
+ * @param[in] pucData The bytes received.
+ * @param[in] xLength The length of \p pucData.
+ */
+static void readServerHello( MbedSSLContext_t * pxSslContext,
+                             const unsigned char * pucData,
+                             size_t xLength );
+
+/**
+ * @brief Record the size of the record buffers of a connection whose
+ * handshake is complete.
+ *
+ * @param[in] pxTlsTransportParams The transport parameters keeping the statistics.
+ * @param[in] pxSslContext SSL context of the connection.
+ */
+static void updateBufferStats( TlsTransportParams_t * pxTlsTransportParams,
+                               MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Choose whether the session of the connection is kept for the next
+ * one.
+ *
+ * The session is a TLS 1.2 one, resumed with its ticket or its ID. mbed TLS
+ * 2.28 has no TLS 1.3 client, so TLS 1.3 PSK resumption is not offered.
+ *
+ * @param[in] pxSslContext SSL context of the connection.
+ * @param[in] pxNetworkCredentials TLS setup parameters.
+ */
+static void setSessionResumption( MbedSSLContext_t * pxSslContext,
+                                  const NetworkCredentials_t * pxNetworkCredentials );
+
+/**
+ * @brief Save the session of a connection in its TlsTransportParams_t, for
+ * the next connection to offer it.
+ *
+ * @param[in] pxTlsTransportParams The transport parameters keeping the session.
+ * @param[in] pxSslContext SSL context whose handshake is complete.
+ */
+static void saveSession( TlsTransportParams_t * pxTlsTransportParams,
+                         MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Count a handshake in the statistics of the transport.
+ *
+ * @param[in] pxTlsTransportParams The transport parameters keeping the statistics.
+ * @param[in] pxSslContext SSL context of the handshake.
+ * @param[in] ulHandshakeMs Time of the handshake.
+ * @param[in] lMbedtlsError Result of the handshake.
+ */
+static void updateHandshakeStats( TlsTransportParams_t * pxTlsTransportParams,
+                                  MbedSSLContext_t * pxSslContext,
+                                  uint32_t ulHandshakeMs,
+                                  int32_t lMbedtlsError );
+
+/**
+ * @brief Account for the slice of the handshake ending, at a socket call or
+ * when mbedtls_ssl_handshake() returns.
+ *
+ * @param[in] pxSslContext SSL context of the handshake.
+ */
+static void endSlice( MbedSSLContext_t * pxSslContext );
+
+/**
+ * @brief Send of the handshake, a socket call ends a slice.
+ *
+ * @param[in] pvContext The SSL context of the handshake.
+ * @param[in] pucData The data to send.
+ * @param[in] xLength The length of \p pucData.
+ *
+ * @return The result of mbedtls_platform_send().
+ */
+static int sliceSend( void * pvContext,
+                      const unsigned char * pucData,
+                      size_t xLength );
+
+/**
+ * @brief Receive of the handshake, the wait for the server is not part of a
+ * slice.
+ *
+ * @param[in] pvContext The SSL context of the handshake.
+ * @param[out] pucData The buffer receiving the data.
+ * @param[in] xLength The length of \p pucData.
+ *
+ * @return The result of mbedtls_platform_recv().
+ */
+static int sliceRecv( void * pvContext,
+                      unsigned char * pucData,
+                      size_t xLength );
+
 /**
  * @brief Setup TLS by initializing contexts and setting configurations.
  *
@@ -245,6 +498,7 @@ static void sslContextInit( MbedSSLContext_t * pxSslContext )
     mbedtls_pk_init( &( pxSslContext->privKey ) );
     mbedtls_x509_crt_init( &( pxSslContext->clientCert ) );
     mbedtls_ssl_init( &( pxSslContext->context ) );
+    pxSslContext->xKeepSession = pdFALSE;
 }
 /*-----------------------------------------------------------*/
 
@@ -271,10 +525,36 @@ static int32_t setRootCa( MbedSSLContext_t * pxSslContext,
     configASSERT( pxSslContext != NULL );
     configASSERT( pucRootCa != NULL );
 
-    /* Parse the server root CA certificate into the SSL context. */
-    lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->rootCa ),
-                                            pucRootCa,
-                                            xRootCaSize );
+    #if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+        pxSslContext->trustBundle.ulCount = TLS_TrustBundle_GetCount( pucRootCa, xRootCaSize );
+
+        if( pxSslContext->trustBundle.ulCount > 0U )
+        {
+            /* The CAs of a trust bundle are found through its index, and
+             * parsed only while the chain of the server is verified. */
+            pxSslContext->trustBundle.pucBundle = pucRootCa;
+            mbedtls_ssl_conf_ca_cb( &( pxSslContext->config ),
+                                    TLS_TrustBundle_CaCallback,
+                                    &( pxSslContext->trustBundle ) );
+
+            return 0;
+        }
+    #endif
+
+    /* Parse the server root CA certificate into the SSL context. A trust
+     * bundle is already decoded from base64. */
+    if( TLS_TrustBundle_GetCount( pucRootCa, xRootCaSize ) > 0U )
+    {
+        lMbedtlsError = TLS_TrustBundle_Parse( &( pxSslContext->rootCa ),
+                                               pucRootCa,
+                                               xRootCaSize );
+    }
+    else
+    {
+        lMbedtlsError = mbedtls_x509_crt_parse( &( pxSslContext->rootCa ),
+                                                pucRootCa,
+                                                xRootCaSize );
+    }
 
     if( lMbedtlsError != 0 )
     {
@@ -345,6 +625,29 @@ static int32_t setPrivateKey( MbedSSLContext_t * pxSslContext,
 }
 /*-----------------------------------------------------------*/
 
+static void setEcdsaConfigurations( MbedSSLContext_t * pxSslContext )
+{
+    configASSERT( pxSslContext != NULL );
+
+    if( mbedtls_pk_get_type( &( pxSslContext->privKey ) ) == MBEDTLS_PK_ECKEY )
+    {
+        LogDebug( ( "EC client key of %u bits, offering the ECDHE cipher suites and P-256 first.",
+                    ( unsigned int ) mbedtls_pk_get_bitlen( &( pxSslContext->privKey ) ) ) );
+
+        mbedtls_ssl_conf_ciphersuites( &( pxSslContext->config ),
+                                       pxEcdsaCiphersuites );
+
+        #if MBEDTLS_VERSION_NUMBER >= 0x03010000
+            mbedtls_ssl_conf_groups( &( pxSslContext->config ),
+                                     pusEcdsaGroups );
+        #else
+            mbedtls_ssl_conf_curves( &( pxSslContext->config ),
+                                     pxEcdsaCurves );
+        #endif
+    }
+}
+/*-----------------------------------------------------------*/
+
 static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
                                const NetworkCredentials_t * pxNetworkCredentials )
 {
@@ -392,6 +695,11 @@ static int32_t setCredentials( MbedSSLContext_t * pxSslContext,
                                                        &( pxSslContext->clientCert ),
                                                        &( pxSslContext->privKey ) );
         }
+
+        if( lMbedtlsError == 0 )
+        {
+            setEcdsaConfigurations( pxSslContext );
+        }
     }
 
     return lMbedtlsError;
@@ -436,27 +744,364 @@ static void setOptionalConfigurations( MbedSSLContext_t * pxSslContext,
                         mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
         }
     }
+}
+/*-----------------------------------------------------------*/
 
-    /* Set Maximum Fragment Length if enabled. */
+static void setMaxFragmentLength( MbedSSLContext_t * pxSslContext,
+                                  const NetworkCredentials_t * pxNetworkCredentials )
+{
     #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+        int32_t lMbedtlsError = 0;
+        unsigned char ucMflCode = MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+    #endif
 
-        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
-         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
-         *
-         * Smaller values can be found in "mbedtls/include/ssl.h".
-         */
-        lMbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+    configASSERT( pxSslContext != NULL );
+    configASSERT( pxNetworkCredentials != NULL );
 
-        if( lMbedtlsError != 0 )
+    ( void ) memset( &( pxSslContext->xServerHello ), 0, sizeof( pxSslContext->xServerHello ) );
+    pxSslContext->xServerHello.xField = eServerHelloDone;
+
+    /* Set Maximum Fragment Length if enabled. */
+    #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+        if( pxNetworkCredentials->ulMaxFragmentLength != 0U )
         {
-            LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
-                        lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
+             * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
+             */
+            switch( pxNetworkCredentials->ulMaxFragmentLength )
+            {
+                case 512U:
+                    ucMflCode = MBEDTLS_SSL_MAX_FRAG_LEN_512;
+                    break;
+
+                case 1024U:
+                    ucMflCode = MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+                    break;
+
+                case 2048U:
+                    ucMflCode = MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+                    break;
+
+                case 4096U:
+                    break;
+
+                default:
+                    LogWarn( ( "No maximum fragment length of %u bytes, asking for 4096.",
+                               ( unsigned int ) pxNetworkCredentials->ulMaxFragmentLength ) );
+                    break;
+            }
+
+            lMbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), ucMflCode );
+
+            if( lMbedtlsError != 0 )
+            {
+                LogError( ( "Failed to maximum fragment length extension: lMbedtlsError[%d]= %s : %s.",
+                            lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                            mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            }
+            else
+            {
+                pxSslContext->xServerHello.xField = eServerHelloType;
+            }
         }
     #endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 }
 /*-----------------------------------------------------------*/
 
+static void readServerHello( MbedSSLContext_t * pxSslContext,
+                             const unsigned char * pucData,
+                             size_t xLength )
+{
+    ServerHelloReader_t * pxReader = &( pxSslContext->xServerHello );
+    BaseType_t xAgreed = pdFALSE;
+    size_t xIndex;
+
+    /* The fragment length is not asked, or the ServerHello was read. */
+    if( pxReader->xField == eServerHelloDone )
+    {
+        return;
+    }
+
+    for( xIndex = 0; ( xIndex < xLength ) && ( pxReader->xField != eServerHelloDone ); xIndex++ )
+    {
+        /* The record header: content type, version and length. The
+         * ServerHello is the first message of the first handshake record. */
+        if( pxReader->ulRecordLeft == 0U )
+        {
+            if( ( pxReader->ulRecordHeaderBytes == 0U ) && ( pucData[ xIndex ] != MBEDTLS_SSL_MSG_HANDSHAKE ) )
+            {
+                pxReader->xField = eServerHelloDone;
+            }
+            else if( pxReader->ulRecordHeaderBytes >= 3U )
+            {
+                pxReader->ulValue = ( pxReader->ulValue << 8 ) | pucData[ xIndex ];
+            }
+
+            pxReader->ulRecordHeaderBytes = ( pxReader->ulRecordHeaderBytes + 1U ) % 5U;
+
+            if( pxReader->ulRecordHeaderBytes == 0U )
+            {
+                pxReader->ulRecordLeft = pxReader->ulValue & 0xFFFFU;
+                pxReader->ulValue = 0;
+            }
+
+            continue;
+        }
+
+        pxReader->ulRecordLeft--;
+        pxReader->ulValue = ( pxReader->ulValue << 8 ) | pucData[ xIndex ];
+        pxReader->ulOffset++;
+
+        if( pxReader->ulOffset < pxReader->ulFieldEnd )
+        {
+            continue;
+        }
+
+        /* The field is read, set the next one. */
+        switch( pxReader->xField )
+        {
+            case eServerHelloType:
+                pxReader->xField = ( pxReader->ulValue == MBEDTLS_SSL_HS_SERVER_HELLO ) ? eServerHelloLength : eServerHelloDone;
+                pxReader->ulFieldEnd = 4U;
+                pxReader->ulMessageEnd = 4U;
+                break;
+
+            case eServerHelloLength:
+                pxReader->ulMessageEnd = 4U + ( pxReader->ulValue & 0xFFFFFFU );
+                pxReader->xField = eServerHelloRandom;
+                pxReader->ulFieldEnd = pxReader->ulOffset + 34U;
+                break;
+
+            case eServerHelloRandom:
+                pxReader->xField = eServerHelloSessionIdLength;
+                pxReader->ulFieldEnd = pxReader->ulOffset + 1U;
+                break;
+
+            case eServerHelloSessionIdLength:
+                pxReader->xField = eServerHelloSuite;
+                pxReader->ulFieldEnd = pxReader->ulOffset + ( pxReader->ulValue & 0xFFU ) + 3U;
+                break;
+
+            case eServerHelloSuite:
+                pxReader->xField = eServerHelloExtensionsLength;
+                pxReader->ulFieldEnd = pxReader->ulOffset + 2U;
+                break;
+
+            case eServerHelloExtensionsLength:
+            case eServerHelloExtensionData:
+                pxReader->xField = eServerHelloExtensionType;
+                pxReader->ulFieldEnd = pxReader->ulOffset + 2U;
+                break;
+
+            case eServerHelloExtensionType:
+
+                if( ( pxReader->ulValue & 0xFFFFU ) == MBEDTLS_TLS_EXT_MAX_FRAGMENT_LENGTH )
+                {
+                    xAgreed = pdTRUE;
+                    pxReader->xField = eServerHelloDone;
+                }
+                else
+                {
+                    pxReader->xField = eServerHelloExtensionLength;
+                    pxReader->ulFieldEnd = pxReader->ulOffset + 2U;
+                }
+
+                break;
+
+            case eServerHelloExtensionLength:
+
+                if( ( pxReader->ulValue & 0xFFFFU ) == 0U )
+                {
+                    pxReader->xField = eServerHelloExtensionType;
+                    pxReader->ulFieldEnd = pxReader->ulOffset + 2U;
+                }
+                else
+                {
+                    pxReader->xField = eServerHelloExtensionData;
+                    pxReader->ulFieldEnd = pxReader->ulOffset + ( pxReader->ulValue & 0xFFFFU );
+                }
+
+                break;
+
+            default:
+                pxReader->xField = eServerHelloDone;
+                break;
+        }
+
+        pxReader->ulValue = 0;
+
+        /* The message ends without the extension. */
+        if( pxReader->ulFieldEnd > pxReader->ulMessageEnd )
+        {
+            pxReader->xField = eServerHelloDone;
+        }
+    }
+
+    #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+
+        /* mbed TLS sizes the buffers of a client by the fragment length asked,
+         * whether the server agreed to it or not. Not asking for it anymore
+         * keeps them full size. */
+        if( ( pxReader->xField == eServerHelloDone ) && ( xAgreed == pdFALSE ) )
+        {
+            LogWarn( ( "The server did not agree to the maximum fragment length, keeping full record buffers." ) );
+            ( void ) mbedtls_ssl_conf_max_frag_len( &( pxSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_NONE );
+        }
+    #else
+        ( void ) xAgreed;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+static void updateBufferStats( TlsTransportParams_t * pxTlsTransportParams,
+                               MbedSSLContext_t * pxSslContext )
+{
+    size_t xInLength = MBEDTLS_SSL_IN_CONTENT_LEN;
+    size_t xOutLength = MBEDTLS_SSL_OUT_CONTENT_LEN;
+    int lExpansion = mbedtls_ssl_get_record_expansion( &( pxSslContext->context ) );
+
+    /* mbed TLS sizes variable buffers by the fragment length asked once the
+     * handshake is over, and the others at compile time. */
+    #if defined( MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH ) && defined( MBEDTLS_SSL_MAX_FRAGMENT_LENGTH )
+        xInLength = mbedtls_ssl_get_input_max_frag_len( &( pxSslContext->context ) );
+        xOutLength = mbedtls_ssl_get_output_max_frag_len( &( pxSslContext->context ) );
+    #endif
+
+    /* The expansion of the record header, IV, MAC and padding is an estimate
+     * of the overhead mbed TLS allocates, it is not known before the cipher
+     * suite is. */
+    if( lExpansion < 0 )
+    {
+        lExpansion = 0;
+    }
+
+    pxTlsTransportParams->xStats.ulInBufferBytes = ( uint32_t ) ( xInLength + ( size_t ) lExpansion );
+    pxTlsTransportParams->xStats.ulOutBufferBytes = ( uint32_t ) ( xOutLength + ( size_t ) lExpansion );
+}
+/*-----------------------------------------------------------*/
+
+static void setSessionResumption( MbedSSLContext_t * pxSslContext,
+                                  const NetworkCredentials_t * pxNetworkCredentials )
+{
+    configASSERT( pxSslContext != NULL );
+    configASSERT( pxNetworkCredentials != NULL );
+
+    pxSslContext->xKeepSession = ( pxNetworkCredentials->xEnableSessionResumption != pdFALSE ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static void saveSession( TlsTransportParams_t * pxTlsTransportParams,
+                         MbedSSLContext_t * pxSslContext )
+{
+    mbedtls_ssl_session * pxSession = ( mbedtls_ssl_session * ) pxTlsTransportParams->pvSession;
+    int32_t lMbedtlsError;
+
+    if( pxSession == NULL )
+    {
+        pxSession = pvPortMalloc( sizeof( mbedtls_ssl_session ) );
+
+        if( pxSession == NULL )
+        {
+            LogWarn( ( "No memory to save the TLS session, the next handshake is a full one." ) );
+            return;
+        }
+    }
+    else
+    {
+        mbedtls_ssl_session_free( pxSession );
+    }
+
+    mbedtls_ssl_session_init( pxSession );
+
+    lMbedtlsError = mbedtls_ssl_get_session( &( pxSslContext->context ), pxSession );
+
+    if( lMbedtlsError != 0 )
+    {
+        LogWarn( ( "Failed to save the TLS session: lMbedtlsError[%d]= %s : %s.",
+                   lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                   mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+
+        mbedtls_ssl_session_free( pxSession );
+        vPortFree( pxSession );
+        pxSession = NULL;
+    }
+
+    pxTlsTransportParams->pvSession = pxSession;
+}
+/*-----------------------------------------------------------*/
+
+static void updateHandshakeStats( TlsTransportParams_t * pxTlsTransportParams,
+                                  MbedSSLContext_t * pxSslContext,
+                                  uint32_t ulHandshakeMs,
+                                  int32_t lMbedtlsError )
+{
+    TlsTransportStats_t * pxStats = &( pxTlsTransportParams->xStats );
+
+    pxStats->ulLastMaxSliceUs = pxSslContext->ulMaxSliceUs;
+    pxStats->ulMaxSliceUs = ( pxSslContext->ulMaxSliceUs > pxStats->ulMaxSliceUs ) ?
+                            pxSslContext->ulMaxSliceUs : pxStats->ulMaxSliceUs;
+
+    if( lMbedtlsError != 0 )
+    {
+        pxStats->ulFailedHandshakes++;
+        return;
+    }
+
+    pxStats->ulLastHandshakeMs = ulHandshakeMs;
+    pxStats->ulMinHandshakeMs = ( ( pxStats->ulHandshakes == 0U ) || ( ulHandshakeMs < pxStats->ulMinHandshakeMs ) ) ?
+                                ulHandshakeMs : pxStats->ulMinHandshakeMs;
+    pxStats->ulMaxHandshakeMs = ( ulHandshakeMs > pxStats->ulMaxHandshakeMs ) ? ulHandshakeMs : pxStats->ulMaxHandshakeMs;
+    pxStats->ulTotalHandshakeMs += ulHandshakeMs;
+    pxStats->ulHandshakes++;
+}
+/*-----------------------------------------------------------*/
+
+static void endSlice( MbedSSLContext_t * pxSslContext )
+{
+    uint32_t ulSliceUs = ( uint32_t ) ( transporttlsGET_TIME_US() - pxSslContext->ullSliceStartUs );
+
+    if( ulSliceUs > pxSslContext->ulMaxSliceUs )
+    {
+        pxSslContext->ulMaxSliceUs = ulSliceUs;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int sliceSend( void * pvContext,
+                      const unsigned char * pucData,
+                      size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    int lRet;
+
+    endSlice( pxSslContext );
+    lRet = mbedtls_platform_send( ( void * ) pxSslContext->xSocket, pucData, xLength );
+    pxSslContext->ullSliceStartUs = transporttlsGET_TIME_US();
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
+
+static int sliceRecv( void * pvContext,
+                      unsigned char * pucData,
+                      size_t xLength )
+{
+    MbedSSLContext_t * pxSslContext = ( MbedSSLContext_t * ) pvContext;
+    int lRet;
+
+    endSlice( pxSslContext );
+    lRet = mbedtls_platform_recv( ( void * ) pxSslContext->xSocket, pucData, xLength );
+    pxSslContext->ullSliceStartUs = transporttlsGET_TIME_US();
+
+    if( lRet > 0 )
+    {
+        readServerHello( pxSslContext, pucData, ( size_t ) lRet );
+    }
+
+    return lRet;
+}
+/*-----------------------------------------------------------*/
+
 static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
                                       const char * pcHostName,
                                       const NetworkCredentials_t * pxNetworkCredentials )
@@ -506,6 +1151,12 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pxNetworkContext,
         }
         else
         {
+            setSessionResumption( pxSSLContext,
+                                  pxNetworkCredentials );
+
+            setMaxFragmentLength( pxSSLContext,
+                                  pxNetworkCredentials );
+
             /* Optionally set SNI and ALPN protocols. */
             setOptionalConfigurations( pxSSLContext,
                                        pcHostName,
@@ -524,6 +1175,7 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
     TlsTransportStatus_t xRetVal = eTLSTransportSuccess;
     int32_t lMbedtlsError = 0;
     MbedSSLContext_t * pxSSLContext = NULL;
+    uint32_t ulStartMs;
 
     configASSERT( pxNetworkContext != NULL );
     configASSERT( pxNetworkContext->pParams != NULL );
@@ -548,35 +1200,98 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
     }
     else
     {
-        /* Set the underlying IO for the TLS connection. */
-
-        /* MISRA Rule 11.2 flags the following line for casting the second
-         * parameter to void *. This rule is suppressed because
-         * #mbedtls_ssl_set_bio requires the second parameter as void *.
-         */
-        /* coverity[misra_c_2012_rule_11_2_violation] */
+        /* Set the underlying IO for the handshake, which times the slices
+         * between the socket calls. */
+        pxSSLContext->xSocket = pxTlsTransportParams->xTCPSocket;
         mbedtls_ssl_set_bio( &( pxSSLContext->context ),
-                             ( void * ) pxTlsTransportParams->xTCPSocket,
-                             mbedtls_platform_send,
-                             mbedtls_platform_recv,
+                             pxSSLContext,
+                             sliceSend,
+                             sliceRecv,
                              NULL );
+
+        /* Offer the session of the last connection. The server does a full
+         * handshake when it does not know it anymore. */
+        if( ( pxSSLContext->xKeepSession == pdTRUE ) &&
+            ( pxTlsTransportParams->pvSession != NULL ) )
+        {
+            lMbedtlsError = mbedtls_ssl_set_session( &( pxSSLContext->context ),
+                                                     ( const mbedtls_ssl_session * ) pxTlsTransportParams->pvSession );
+
+            if( lMbedtlsError == 0 )
+            {
+                pxTlsTransportParams->xStats.ulResumptionsOffered++;
+            }
+            else
+            {
+                LogWarn( ( "Failed to offer the saved TLS session: lMbedtlsError[%d]= %s : %s.",
+                           lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
+                           mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
+            }
+        }
     }
 
     if( xRetVal == eTLSTransportSuccess )
     {
-        /* Perform the TLS handshake. */
+        #if defined( MBEDTLS_ECP_RESTARTABLE )
+            mbedtls_ecp_set_max_ops( pxNetworkCredentials->ulCryptoSliceMaxOps );
+        #endif
+
+        ulStartMs = transporttlsGET_TIME_MS();
+        pxSSLContext->ulMaxSliceUs = 0;
+
+        /* Perform the TLS handshake. With restartable ECC, a step of the
+         * handshake returns once its operation budget is spent and is
+         * resumed by the next call, after the other tasks ran. */
         do
         {
+            pxSSLContext->ullSliceStartUs = transporttlsGET_TIME_US();
             lMbedtlsError = mbedtls_ssl_handshake( &( pxSSLContext->context ) );
+            endSlice( pxSSLContext );
+
+            #if defined( MBEDTLS_ECP_RESTARTABLE )
+                if( lMbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS )
+                {
+                    pxTlsTransportParams->xStats.ulCryptoSlices++;
+
+                    if( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING )
+                    {
+                        transporttlsCRYPTO_SLICE_YIELD();
+                    }
+                }
+            #endif
         } while( ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                 #if defined( MBEDTLS_ECP_RESTARTABLE )
+                     ( lMbedtlsError == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS ) ||
+                 #endif
                  ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
 
+        updateHandshakeStats( pxTlsTransportParams,
+                              pxSSLContext,
+                              transporttlsGET_TIME_MS() - ulStartMs,
+                              lMbedtlsError );
+
+        /* Set the underlying IO of the records, which are not timed. */
+
+        /* MISRA Rule 11.2 flags the following line for casting the second
+         * parameter to void *. This rule is suppressed because
+         * #mbedtls_ssl_set_bio requires the second parameter as void *.
+         */
+        /* coverity[misra_c_2012_rule_11_2_violation] */
+        mbedtls_ssl_set_bio( &( pxSSLContext->context ),
+                             ( void * ) pxTlsTransportParams->xTCPSocket,
+                             mbedtls_platform_send,
+                             mbedtls_platform_recv,
+                             NULL );
+
         if( lMbedtlsError != 0 )
         {
             LogError( ( "Failed to perform TLS handshake: lMbedtlsError[%d]= %s : %s.",
                         lMbedtlsError, mbedtlsHighLevelCodeOrDefault( lMbedtlsError ),
                         mbedtlsLowLevelCodeOrDefault( lMbedtlsError ) ) );
 
+            /* A session which failed is not offered again. */
+            TLS_Socket_ForgetSession( pxNetworkContext );
+
             if( lMbedtlsError == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED )
             {
                 xRetVal = eTLSTransportCAVerifyFailed;
@@ -588,8 +1303,22 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pxNetworkContext,
         }
         else
         {
-            LogInfo( ( "(Network connection %p) TLS handshake successful.",
-                       pxNetworkContext ) );
+            updateBufferStats( pxTlsTransportParams, pxSSLContext );
+
+            LogInfo( ( "(Network connection %p) %s handshake successful in %u ms, longest slice %u us.",
+                       pxNetworkContext,
+                       mbedtls_ssl_get_version( &( pxSSLContext->context ) ),
+                       ( unsigned int ) pxTlsTransportParams->xStats.ulLastHandshakeMs,
+                       ( unsigned int ) pxTlsTransportParams->xStats.ulLastMaxSliceUs ) );
+            LogInfo( ( "(Network connection %p) Record buffers of %u bytes in and %u bytes out.",
+                       pxNetworkContext,
+                       ( unsigned int ) pxTlsTransportParams->xStats.ulInBufferBytes,
+                       ( unsigned int ) pxTlsTransportParams->xStats.ulOutBufferBytes ) );
+
+            if( pxSSLContext->xKeepSession == pdTRUE )
+            {
+                saveSession( pxTlsTransportParams, pxSSLContext );
+            }
         }
     }
 
@@ -841,6 +1570,24 @@ void TLS_Socket_Disconnect( NetworkContext_t * pxNetworkContext )
 }
 /*-----------------------------------------------------------*/
 
+void TLS_Socket_ForgetSession( NetworkContext_t * pxNetworkContext )
+{
+    TlsTransportParams_t * pxTlsTransportParams;
+
+    configASSERT( ( pxNetworkContext != NULL ) &&
+                  ( pxNetworkContext->pParams != NULL ) );
+
+    pxTlsTransportParams = ( TlsTransportParams_t * ) pxNetworkContext->pParams;
+
+    if( pxTlsTransportParams->pvSession != NULL )
+    {
+        mbedtls_ssl_session_free( ( mbedtls_ssl_session * ) pxTlsTransportParams->pvSession );
+        vPortFree( pxTlsTransportParams->pvSession );
+        pxTlsTransportParams->pvSession = NULL;
+    }
+}
+/*-----------------------------------------------------------*/
+
 int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
                          void * pvBuffer,
                          size_t xBytesToRecv )
@@ -857,9 +1604,11 @@ int32_t TLS_Socket_Recv( NetworkContext_t * pxNetworkContext,
     configASSERT( pxTlsTransportParams->xSSLContext != NULL );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    traceSAMPLE_SPAN_BEGIN( "TLS_Socket_Recv" );
     lMbedtlsError = ( int32_t ) mbedtls_ssl_read( &( pxSSLContext->context ),
                                                   pvBuffer,
                                                   xBytesToRecv );
+    traceSAMPLE_SPAN_END( "TLS_Socket_Recv" );
 
     if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
         ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
@@ -905,9 +1654,11 @@ int32_t TLS_Socket_Send( NetworkContext_t * pxNetworkContext,
     configASSERT( pxTlsTransportParams->xSSLContext != NULL );
 
     pxSSLContext = ( MbedSSLContext_t * ) pxTlsTransportParams->xSSLContext;
+    traceSAMPLE_SPAN_BEGIN( "TLS_Socket_Send" );
     lMbedtlsError = ( int32_t ) mbedtls_ssl_write( &( pxSSLContext->context ),
                                                    pvBuffer,
                                                    xBytesToSend );
+    traceSAMPLE_SPAN_END( "TLS_Socket_Send" );
 
     if( ( lMbedtlsError == MBEDTLS_ERR_SSL_TIMEOUT ) ||
         ( lMbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
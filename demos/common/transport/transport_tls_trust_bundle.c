@@ -0,0 +1,209 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_trust_bundle.c
+ * @brief Reads the trust bundles of transport_tls_trust_bundle.h.
+ */
+
+#include <string.h>
+
+#include "transport_tls_trust_bundle.h"
+
+#include "mbedtls/md.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/x509.h"
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadUint32( const uint8_t * pucBytes )
+{
+    return ( uint32_t ) pucBytes[ 0 ] |
+           ( ( uint32_t ) pucBytes[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucBytes[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucBytes[ 3 ] << 24 );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t TLS_TrustBundle_GetCount( const uint8_t * pucBundle,
+                                   size_t xBundleSize )
+{
+    const uint8_t * pucEntry;
+    uint32_t ulCount;
+    uint32_t ulIndex;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( pucBundle == NULL ) ||
+        ( xBundleSize < transporttlsTRUST_BUNDLE_HEADER_SIZE ) ||
+        ( memcmp( pucBundle, transporttlsTRUST_BUNDLE_MAGIC, sizeof( transporttlsTRUST_BUNDLE_MAGIC ) - 1 ) != 0 ) )
+    {
+        return 0;
+    }
+
+    ulCount = prvReadUint32( pucBundle + 4 );
+
+    /* The count is checked against the size first, so the size of the index
+     * does not overflow. */
+    if( ( ulCount == 0U ) ||
+        ( ulCount > ( xBundleSize - transporttlsTRUST_BUNDLE_HEADER_SIZE ) / transporttlsTRUST_BUNDLE_ENTRY_SIZE ) )
+    {
+        return 0;
+    }
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        pucEntry = pucBundle + transporttlsTRUST_BUNDLE_INDEX_SIZE( ulIndex );
+        ulOffset = prvReadUint32( pucEntry );
+        ulLength = prvReadUint32( pucEntry + 4 );
+
+        if( ( ulOffset < transporttlsTRUST_BUNDLE_INDEX_SIZE( ulCount ) ) ||
+            ( ulOffset > xBundleSize ) ||
+            ( ulLength == 0U ) ||
+            ( ulLength > xBundleSize - ulOffset ) )
+        {
+            return 0;
+        }
+    }
+
+    return ulCount;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_TrustBundle_GetEntry( const uint8_t * pucBundle,
+                               uint32_t ulIndex,
+                               TlsTrustBundleEntry_t * pxEntry )
+{
+    const uint8_t * pucEntry = pucBundle + transporttlsTRUST_BUNDLE_INDEX_SIZE( ulIndex );
+
+    pxEntry->pucCertificate = pucBundle + prvReadUint32( pucEntry );
+    pxEntry->ulCertificateLength = prvReadUint32( pucEntry + 4 );
+    pxEntry->pucSubjectHash = pucEntry + 8;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_TrustBundle_HashSubject( const uint8_t * pucSubject,
+                                     size_t xSubjectLength,
+                                     uint8_t * pucHash )
+{
+    uint8_t ucDigest[ 32 ];
+    int32_t lMbedtlsError;
+
+    lMbedtlsError = mbedtls_md( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
+                                pucSubject, xSubjectLength, ucDigest );
+
+    if( lMbedtlsError == 0 )
+    {
+        memcpy( pucHash, ucDigest, transporttlsTRUST_BUNDLE_HASH_SIZE );
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_TrustBundle_Parse( mbedtls_x509_crt * pxChain,
+                               const uint8_t * pucBundle,
+                               size_t xBundleSize )
+{
+    TlsTrustBundleEntry_t xEntry;
+    uint32_t ulCount = TLS_TrustBundle_GetCount( pucBundle, xBundleSize );
+    uint32_t ulIndex;
+    int32_t lMbedtlsError = MBEDTLS_ERR_X509_INVALID_FORMAT;
+
+    for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+    {
+        TLS_TrustBundle_GetEntry( pucBundle, ulIndex, &xEntry );
+
+        lMbedtlsError = mbedtls_x509_crt_parse_der( pxChain,
+                                                    xEntry.pucCertificate,
+                                                    xEntry.ulCertificateLength );
+
+        if( lMbedtlsError != 0 )
+        {
+            break;
+        }
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_TrustBundle_Find( mbedtls_x509_crt * pxChain,
+                              const TlsTrustBundle_t * pxTrustBundle,
+                              const uint8_t * pucSubject,
+                              size_t xSubjectLength,
+                              uint32_t * pulFound )
+{
+    TlsTrustBundleEntry_t xEntry;
+    uint8_t ucHash[ transporttlsTRUST_BUNDLE_HASH_SIZE ];
+    uint32_t ulIndex;
+    int32_t lMbedtlsError;
+
+    *pulFound = 0;
+
+    lMbedtlsError = TLS_TrustBundle_HashSubject( pucSubject, xSubjectLength, ucHash );
+
+    for( ulIndex = 0; ( lMbedtlsError == 0 ) && ( ulIndex < pxTrustBundle->ulCount ); ulIndex++ )
+    {
+        TLS_TrustBundle_GetEntry( pxTrustBundle->pucBundle, ulIndex, &xEntry );
+
+        if( memcmp( xEntry.pucSubjectHash, ucHash, sizeof( ucHash ) ) == 0 )
+        {
+            lMbedtlsError = mbedtls_x509_crt_parse_der( pxChain,
+                                                        xEntry.pucCertificate,
+                                                        xEntry.ulCertificateLength );
+
+            if( lMbedtlsError == 0 )
+            {
+                ( *pulFound )++;
+            }
+        }
+    }
+
+    return lMbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+#if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+
+    int TLS_TrustBundle_CaCallback( void * pvTrustBundle,
+                                    mbedtls_x509_crt const * pxChild,
+                                    mbedtls_x509_crt ** ppxCandidates )
+    {
+        mbedtls_x509_crt * pxCandidates;
+        uint32_t ulFound;
+        int32_t lMbedtlsError;
+
+        *ppxCandidates = NULL;
+
+        pxCandidates = mbedtls_calloc( 1, sizeof( mbedtls_x509_crt ) );
+
+        if( pxCandidates == NULL )
+        {
+            return MBEDTLS_ERR_X509_ALLOC_FAILED;
+        }
+
+        mbedtls_x509_crt_init( pxCandidates );
+
+        lMbedtlsError = TLS_TrustBundle_Find( pxCandidates,
+                                              ( const TlsTrustBundle_t * ) pvTrustBundle,
+                                              pxChild->issuer_raw.p,
+                                              pxChild->issuer_raw.len,
+                                              &ulFound );
+
+        /* mbedTLS frees the candidates once it has checked them. */
+        if( ( lMbedtlsError == 0 ) && ( ulFound > 0U ) )
+        {
+            *ppxCandidates = pxCandidates;
+        }
+        else
+        {
+            mbedtls_x509_crt_free( pxCandidates );
+            mbedtls_free( pxCandidates );
+        }
+
+        return lMbedtlsError;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
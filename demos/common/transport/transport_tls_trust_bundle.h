@@ -0,0 +1,151 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file transport_tls_trust_bundle.h
+ * @brief Trust bundle of DER certificates behind an index.
+ *
+ * A PEM bundle is decoded from base64 every time a connection is set up, and
+ * is a third larger than the certificates it holds. The trust bundle stores
+ * the certificates decoded instead, after an index, with the integers in
+ * little endian:
+ *
+ *     "AZTB" | count (4) | count times: offset (4), length (4), subject hash (8) | DER certificates
+ *
+ * The offsets are from the start of the bundle. The subject hash is the start
+ * of the SHA-256 of the DER subject of the certificate, so a certificate can
+ * be looked up without parsing the others.
+ *
+ * A PEM bundle starts with '-', so the transports load both kinds of root CA,
+ * told apart by the magic.
+ *
+ * With MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK, the trusted CAs are looked
+ * up in the index by TLS_TrustBundle_CaCallback() while a chain is verified.
+ * Only the certificates whose subject hash matches the issuer of the chain are
+ * parsed, and only for the verification, instead of the whole bundle being
+ * kept parsed for the connection.
+ */
+
+#ifndef TRANSPORT_TLS_TRUST_BUNDLE_H
+#define TRANSPORT_TLS_TRUST_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbedtls/x509_crt.h"
+
+#define transporttlsTRUST_BUNDLE_MAGIC            "AZTB" /**< First bytes of a trust bundle. */
+#define transporttlsTRUST_BUNDLE_HEADER_SIZE      8U     /**< Magic and count. */
+#define transporttlsTRUST_BUNDLE_ENTRY_SIZE       16U    /**< Offset, length and subject hash of a certificate. */
+#define transporttlsTRUST_BUNDLE_HASH_SIZE        8U     /**< Bytes of the SHA-256 kept as the subject hash. */
+
+/**
+ * @brief Size of the index of a bundle of @p count certificates.
+ */
+#define transporttlsTRUST_BUNDLE_INDEX_SIZE( count ) \
+    ( transporttlsTRUST_BUNDLE_HEADER_SIZE + ( count ) * transporttlsTRUST_BUNDLE_ENTRY_SIZE )
+
+/**
+ * @brief A certificate of a trust bundle, pointing into the bundle.
+ */
+typedef struct TlsTrustBundleEntry
+{
+    const uint8_t * pucCertificate;  /**< The DER certificate. */
+    uint32_t ulCertificateLength;    /**< Length of the certificate. */
+    const uint8_t * pucSubjectHash;  /**< #transporttlsTRUST_BUNDLE_HASH_SIZE bytes. */
+} TlsTrustBundleEntry_t;
+
+/**
+ * @brief A trust bundle looked up by TLS_TrustBundle_CaCallback().
+ */
+typedef struct TlsTrustBundle
+{
+    const uint8_t * pucBundle; /**< The trust bundle, kept in memory for the connection. */
+    uint32_t ulCount;          /**< Its number of certificates, from TLS_TrustBundle_GetCount(). */
+} TlsTrustBundle_t;
+
+/**
+ * @brief Get the number of certificates of a trust bundle.
+ *
+ * @param[in] pucBundle The root CA, a trust bundle or PEM.
+ * @param[in] xBundleSize Size of @p pucBundle.
+ * @return The number of certificates, 0 when @p pucBundle is not a trust
+ * bundle or its index points outside of it.
+ */
+uint32_t TLS_TrustBundle_GetCount( const uint8_t * pucBundle,
+                                   size_t xBundleSize );
+
+/**
+ * @brief Get a certificate of a trust bundle.
+ *
+ * @param[in] pucBundle The trust bundle, checked with TLS_TrustBundle_GetCount().
+ * @param[in] ulIndex Index of the certificate, less than the count.
+ * @param[out] pxEntry The certificate.
+ */
+void TLS_TrustBundle_GetEntry( const uint8_t * pucBundle,
+                               uint32_t ulIndex,
+                               TlsTrustBundleEntry_t * pxEntry );
+
+/**
+ * @brief Compute the subject hash of a DER subject.
+ *
+ * @param[in] pucSubject The DER subject, as the subject_raw of a certificate.
+ * @param[in] xSubjectLength Length of @p pucSubject.
+ * @param[out] pucHash #transporttlsTRUST_BUNDLE_HASH_SIZE bytes.
+ * @return 0 on success, or an mbedTLS error code.
+ */
+int32_t TLS_TrustBundle_HashSubject( const uint8_t * pucSubject,
+                                     size_t xSubjectLength,
+                                     uint8_t * pucHash );
+
+/**
+ * @brief Parse the certificates of a trust bundle into a chain.
+ *
+ * @param[in,out] pxChain The chain the certificates are added to.
+ * @param[in] pucBundle The trust bundle.
+ * @param[in] xBundleSize Size of @p pucBundle.
+ * @return 0 on success, or an mbedTLS error code.
+ */
+int32_t TLS_TrustBundle_Parse( mbedtls_x509_crt * pxChain,
+                               const uint8_t * pucBundle,
+                               size_t xBundleSize );
+
+/**
+ * @brief Parse the certificates of a trust bundle with a subject into a chain.
+ *
+ * The subject hashes of the index are compared, so the other certificates are
+ * not read.
+ *
+ * @param[in,out] pxChain The chain the certificates are added to.
+ * @param[in] pxTrustBundle The trust bundle.
+ * @param[in] pucSubject The DER subject, as the issuer_raw of the certificate
+ * whose issuer is looked for.
+ * @param[in] xSubjectLength Length of @p pucSubject.
+ * @param[out] pulFound The number of certificates added.
+ * @return 0 on success, or an mbedTLS error code.
+ */
+int32_t TLS_TrustBundle_Find( mbedtls_x509_crt * pxChain,
+                              const TlsTrustBundle_t * pxTrustBundle,
+                              const uint8_t * pucSubject,
+                              size_t xSubjectLength,
+                              uint32_t * pulFound );
+
+#if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+
+/**
+ * @brief Trusted CA callback of mbedtls_ssl_conf_ca_cb(), looking the issuer
+ * of a certificate up in a trust bundle.
+ *
+ * @param[in] pvTrustBundle The #TlsTrustBundle_t.
+ * @param[in] pxChild The certificate whose issuer is looked for.
+ * @param[out] ppxCandidates The chain of the certificates found, allocated
+ * for mbedTLS to free, or NULL when there is none.
+ * @return 0 on success, or an mbedTLS error code.
+ */
+    int TLS_TrustBundle_CaCallback( void * pvTrustBundle,
+                                    mbedtls_x509_crt const * pxChild,
+                                    mbedtls_x509_crt ** ppxCandidates );
+
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+
+#endif /* TRANSPORT_TLS_TRUST_BUNDLE_H */
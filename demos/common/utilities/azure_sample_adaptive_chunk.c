@@ -0,0 +1,162 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_adaptive_chunk.c
+ * @brief Implements the chunk size controller of azure_sample_adaptive_chunk.h.
+ */
+
+#include "azure_sample_adaptive_chunk.h"
+
+/*-----------------------------------------------------------*/
+
+static void prvSetSize( AdaptiveChunk_t * pxChunk,
+                        uint32_t ulSize )
+{
+    /* A multiple of the smallest size, within the limits. */
+    ulSize -= ulSize % pxChunk->ulMinSize;
+
+    if( ulSize < pxChunk->ulMinSize )
+    {
+        ulSize = pxChunk->ulMinSize;
+    }
+    else if( ulSize > pxChunk->ulMaxSize )
+    {
+        ulSize = pxChunk->ulMaxSize;
+    }
+
+    pxChunk->ulSize = ulSize;
+    pxChunk->ulChunksAtSize = 0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvShrink( AdaptiveChunk_t * pxChunk,
+                       uint32_t ulHoldChunks )
+{
+    if( pxChunk->ulSize > pxChunk->ulMinSize )
+    {
+        prvSetSize( pxChunk, pxChunk->ulSize / 2U );
+        pxChunk->ulShrinks++;
+    }
+
+    pxChunk->ulBaselineGoodput = 0;
+    pxChunk->ulHoldChunks = ulHoldChunks;
+}
+/*-----------------------------------------------------------*/
+
+void AdaptiveChunk_Init( AdaptiveChunk_t * pxChunk,
+                         uint32_t ulMinSize,
+                         uint32_t ulMaxSize,
+                         uint32_t ulTargetTimeMs )
+{
+    pxChunk->ulMinSize = ( ulMinSize > 0U ) ? ulMinSize : 1U;
+    pxChunk->ulMaxSize = ulMaxSize - ( ulMaxSize % pxChunk->ulMinSize );
+
+    if( pxChunk->ulMaxSize < pxChunk->ulMinSize )
+    {
+        pxChunk->ulMaxSize = pxChunk->ulMinSize;
+    }
+
+    pxChunk->ulTargetTimeMs = ulTargetTimeMs;
+    pxChunk->ulGoodput = 0;
+    pxChunk->ulBaselineGoodput = 0;
+    pxChunk->ulHoldChunks = 0;
+    pxChunk->ulGrowths = 0;
+    pxChunk->ulShrinks = 0;
+    pxChunk->ulFailures = 0;
+
+    prvSetSize( pxChunk, pxChunk->ulMinSize );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AdaptiveChunk_OnSuccess( AdaptiveChunk_t * pxChunk,
+                                  uint32_t ulBytes,
+                                  uint32_t ulElapsedMs,
+                                  uint32_t ulRttMs,
+                                  uint32_t ulFreeHeap )
+{
+    uint64_t ullGoodput;
+    uint32_t ulNextSize;
+
+    if( ulElapsedMs == 0U )
+    {
+        ulElapsedMs = 1U;
+    }
+
+    ullGoodput = ( ( uint64_t ) ulBytes * 1000U ) / ulElapsedMs;
+    ullGoodput = ( ullGoodput > UINT32_MAX ) ? UINT32_MAX : ullGoodput;
+
+    /* The first chunk at a size sets its goodput. */
+    if( pxChunk->ulChunksAtSize == 0U )
+    {
+        pxChunk->ulGoodput = ( uint32_t ) ullGoodput;
+    }
+    else
+    {
+        pxChunk->ulGoodput = ( uint32_t ) ( ( ( uint64_t ) pxChunk->ulGoodput * 3U + ullGoodput ) / 4U );
+    }
+
+    pxChunk->ulChunksAtSize++;
+
+    if( ( ulElapsedMs > pxChunk->ulTargetTimeMs ) || ( ulRttMs > pxChunk->ulTargetTimeMs ) )
+    {
+        prvShrink( pxChunk, adaptivechunkHOLD_AFTER_SHRINK );
+    }
+    else if( pxChunk->ulChunksAtSize < adaptivechunkPROBE_CHUNKS )
+    {
+        /* Not enough chunks at this size yet. */
+    }
+    else if( pxChunk->ulBaselineGoodput != 0U )
+    {
+        /* Keep the larger size only if it paid off. */
+        if( ( ( uint64_t ) pxChunk->ulGoodput * 100U ) <
+            ( ( uint64_t ) pxChunk->ulBaselineGoodput * ( 100U + adaptivechunkMIN_GAIN_PERCENT ) ) )
+        {
+            prvShrink( pxChunk, adaptivechunkHOLD_AFTER_REVERT );
+        }
+
+        pxChunk->ulBaselineGoodput = 0;
+    }
+    else if( pxChunk->ulHoldChunks > 0U )
+    {
+        pxChunk->ulHoldChunks--;
+    }
+    else
+    {
+        ulNextSize = ( pxChunk->ulSize > ( pxChunk->ulMaxSize / 2U ) ) ? pxChunk->ulMaxSize : pxChunk->ulSize * 2U;
+
+        /* Grow while a chunk twice as large still fits in the target time. */
+        if( ( ulNextSize > pxChunk->ulSize ) &&
+            ( ( ( uint64_t ) ulElapsedMs * ulNextSize ) <= ( ( uint64_t ) pxChunk->ulTargetTimeMs * pxChunk->ulSize ) ) &&
+            ( ulNextSize <= ulFreeHeap ) )
+        {
+            pxChunk->ulBaselineGoodput = ( pxChunk->ulGoodput > 0U ) ? pxChunk->ulGoodput : 1U;
+            prvSetSize( pxChunk, ulNextSize );
+            pxChunk->ulGrowths++;
+        }
+    }
+
+    return pxChunk->ulSize;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AdaptiveChunk_OnFailure( AdaptiveChunk_t * pxChunk )
+{
+    pxChunk->ulFailures++;
+    prvShrink( pxChunk, adaptivechunkHOLD_AFTER_SHRINK );
+
+    return pxChunk->ulSize;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AdaptiveChunk_GetSize( const AdaptiveChunk_t * pxChunk )
+{
+    return pxChunk->ulSize;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AdaptiveChunk_GetGoodput( const AdaptiveChunk_t * pxChunk )
+{
+    return pxChunk->ulGoodput;
+}
+/*-----------------------------------------------------------*/
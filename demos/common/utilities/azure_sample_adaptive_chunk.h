@@ -0,0 +1,122 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_adaptive_chunk.h
+ * @brief Chooses the size of the ranges of a download from its goodput.
+ *
+ * The download starts with the smallest chunks. The size is doubled while the
+ * chunks arrive well within the target time, and kept only when the goodput
+ * grows by at least adaptivechunkMIN_GAIN_PERCENT. It is halved after a
+ * failure, or when a chunk or its round trip takes longer than the target
+ * time, and is not grown again for a while.
+ *
+ * The sizes are multiples of the smallest one, so the chunks stay aligned to
+ * it.
+ */
+
+#ifndef AZURE_SAMPLE_ADAPTIVE_CHUNK_H
+#define AZURE_SAMPLE_ADAPTIVE_CHUNK_H
+
+#include <stdint.h>
+
+/**
+ * @brief Chunks read at a new size before its goodput is compared.
+ */
+#ifndef adaptivechunkPROBE_CHUNKS
+    #define adaptivechunkPROBE_CHUNKS          ( 2U )
+#endif
+
+/**
+ * @brief Goodput gain, in percent, for a larger size to be kept.
+ */
+#ifndef adaptivechunkMIN_GAIN_PERCENT
+    #define adaptivechunkMIN_GAIN_PERCENT      ( 10U )
+#endif
+
+/**
+ * @brief Chunks read before growing again after a failure or a slow chunk.
+ */
+#ifndef adaptivechunkHOLD_AFTER_SHRINK
+    #define adaptivechunkHOLD_AFTER_SHRINK     ( 8U )
+#endif
+
+/**
+ * @brief Chunks read before growing again after a size brought no gain.
+ */
+#ifndef adaptivechunkHOLD_AFTER_REVERT
+    #define adaptivechunkHOLD_AFTER_REVERT     ( 32U )
+#endif
+
+/**
+ * @brief State of the controller. Its fields are private.
+ */
+typedef struct AdaptiveChunk
+{
+    uint32_t ulMinSize;
+    uint32_t ulMaxSize;
+    uint32_t ulSize;
+    uint32_t ulTargetTimeMs;
+    uint32_t ulGoodput;         /**< Bytes per second at the current size, averaged. */
+    uint32_t ulChunksAtSize;
+    uint32_t ulBaselineGoodput; /**< Goodput before the last growth, 0 once it is settled. */
+    uint32_t ulHoldChunks;
+    uint32_t ulGrowths;
+    uint32_t ulShrinks;
+    uint32_t ulFailures;
+} AdaptiveChunk_t;
+
+/**
+ * @brief Initialize the controller.
+ *
+ * @param[out] pxChunk The controller.
+ * @param[in] ulMinSize Smallest size, and the first one.
+ * @param[in] ulMaxSize Largest size, rounded down to a multiple of the smallest.
+ * @param[in] ulTargetTimeMs Longest time a chunk should take.
+ */
+void AdaptiveChunk_Init( AdaptiveChunk_t * pxChunk,
+                         uint32_t ulMinSize,
+                         uint32_t ulMaxSize,
+                         uint32_t ulTargetTimeMs );
+
+/**
+ * @brief Account a chunk read.
+ *
+ * @param[in] pxChunk The controller.
+ * @param[in] ulBytes Length of the chunk.
+ * @param[in] ulElapsedMs Time the chunk took.
+ * @param[in] ulRttMs Round trip of its request.
+ * @param[in] ulFreeHeap Free heap, the size is not grown past it.
+ * @return The size of the next chunks.
+ */
+uint32_t AdaptiveChunk_OnSuccess( AdaptiveChunk_t * pxChunk,
+                                  uint32_t ulBytes,
+                                  uint32_t ulElapsedMs,
+                                  uint32_t ulRttMs,
+                                  uint32_t ulFreeHeap );
+
+/**
+ * @brief Account a chunk which could not be read.
+ *
+ * @param[in] pxChunk The controller.
+ * @return The size of the next chunks.
+ */
+uint32_t AdaptiveChunk_OnFailure( AdaptiveChunk_t * pxChunk );
+
+/**
+ * @brief Size of the next chunks.
+ *
+ * @param[in] pxChunk The controller.
+ * @return The size.
+ */
+uint32_t AdaptiveChunk_GetSize( const AdaptiveChunk_t * pxChunk );
+
+/**
+ * @brief Goodput at the current size.
+ *
+ * @param[in] pxChunk The controller.
+ * @return Bytes per second.
+ */
+uint32_t AdaptiveChunk_GetGoodput( const AdaptiveChunk_t * pxChunk );
+
+#endif /* AZURE_SAMPLE_ADAPTIVE_CHUNK_H */
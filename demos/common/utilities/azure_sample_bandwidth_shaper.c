@@ -0,0 +1,73 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_bandwidth_shaper.c
+ * @brief Implements the token bucket of azure_sample_bandwidth_shaper.h.
+ */
+
+#include "azure_sample_bandwidth_shaper.h"
+
+/*-----------------------------------------------------------*/
+
+void BandwidthShaper_Init( BandwidthShaper_t * pxShaper,
+                           uint32_t ulBytesPerSecond,
+                           uint32_t ulBurstBytes,
+                           uint32_t ulNowMs )
+{
+    pxShaper->ulBytesPerSecond = ulBytesPerSecond;
+    pxShaper->ulBurstBytes = ulBurstBytes;
+    pxShaper->llTokens = ( int64_t ) ulBurstBytes * 1000;
+    pxShaper->ulLastMs = ulNowMs;
+    pxShaper->ulDelays = 0;
+    pxShaper->ulTotalDelayMs = 0;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t BandwidthShaper_GetDelayMs( BandwidthShaper_t * pxShaper,
+                                     uint32_t ulBytes,
+                                     uint32_t ulNowMs )
+{
+    int64_t llBurst = ( int64_t ) pxShaper->ulBurstBytes * 1000;
+    uint64_t ullDelayMs;
+
+    if( pxShaper->ulBytesPerSecond == 0U )
+    {
+        return 0;
+    }
+
+    /* A byte per second is a thousandth of a byte per millisecond. The
+     * difference of the times is right across a wrap around. */
+    pxShaper->llTokens += ( int64_t ) ( uint32_t ) ( ulNowMs - pxShaper->ulLastMs ) *
+                          ( int64_t ) pxShaper->ulBytesPerSecond;
+    pxShaper->ulLastMs = ulNowMs;
+
+    if( pxShaper->llTokens > llBurst )
+    {
+        pxShaper->llTokens = llBurst;
+    }
+
+    pxShaper->llTokens -= ( int64_t ) ulBytes * 1000;
+
+    if( pxShaper->llTokens >= 0 )
+    {
+        return 0;
+    }
+
+    /* The time for the bucket to pay the debt back, rounded up. */
+    ullDelayMs = ( ( uint64_t ) -pxShaper->llTokens + pxShaper->ulBytesPerSecond - 1U ) / pxShaper->ulBytesPerSecond;
+
+    if( ullDelayMs > bandwidthshaperMAX_DELAY_MS )
+    {
+        /* The rest of the debt is forgiven rather than carried to the next
+         * chunks. */
+        ullDelayMs = bandwidthshaperMAX_DELAY_MS;
+        pxShaper->llTokens = -( int64_t ) ullDelayMs * ( int64_t ) pxShaper->ulBytesPerSecond;
+    }
+
+    pxShaper->ulDelays++;
+    pxShaper->ulTotalDelayMs += ( uint32_t ) ullDelayMs;
+
+    return ( uint32_t ) ullDelayMs;
+}
+/*-----------------------------------------------------------*/
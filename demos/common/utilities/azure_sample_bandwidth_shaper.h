@@ -0,0 +1,69 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_bandwidth_shaper.h
+ * @brief Limits the rate of a download with a token bucket.
+ *
+ * The bucket fills at the rate allowed, up to a burst. Each chunk read takes
+ * its length from the bucket, and when the bucket runs short the download
+ * waits for it to fill again. A download within the rate is never delayed,
+ * and one which exceeds it is slowed down to it, so the link is left to the
+ * rest of the application.
+ *
+ * The time is passed in milliseconds, from any clock which may wrap around.
+ */
+
+#ifndef AZURE_SAMPLE_BANDWIDTH_SHAPER_H
+#define AZURE_SAMPLE_BANDWIDTH_SHAPER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Longest delay returned, so a huge chunk at a low rate does not stop
+ * the download for long.
+ */
+#ifndef bandwidthshaperMAX_DELAY_MS
+    #define bandwidthshaperMAX_DELAY_MS    ( 10000U )
+#endif
+
+/**
+ * @brief State of the shaper. Its fields are private, but for the counters.
+ */
+typedef struct BandwidthShaper
+{
+    uint32_t ulBytesPerSecond; /**< Rate allowed, 0 for no limit. */
+    uint32_t ulBurstBytes;     /**< Size of the bucket. */
+    int64_t llTokens;          /**< Bytes allowed, in thousandths of a byte, negative for a debt. */
+    uint32_t ulLastMs;         /**< Time of the last update. */
+    uint32_t ulDelays;         /**< Chunks delayed. */
+    uint32_t ulTotalDelayMs;   /**< Sum of the delays. */
+} BandwidthShaper_t;
+
+/**
+ * @brief Initialize the shaper, with a full bucket.
+ *
+ * @param[out] pxShaper The shaper.
+ * @param[in] ulBytesPerSecond Rate allowed, 0 for no limit.
+ * @param[in] ulBurstBytes Bytes read at once without a delay, at least a
+ * chunk.
+ * @param[in] ulNowMs Current time.
+ */
+void BandwidthShaper_Init( BandwidthShaper_t * pxShaper,
+                           uint32_t ulBytesPerSecond,
+                           uint32_t ulBurstBytes,
+                           uint32_t ulNowMs );
+
+/**
+ * @brief Account a chunk read, and get the time to wait before the next one.
+ *
+ * @param[in] pxShaper The shaper.
+ * @param[in] ulBytes Length of the chunk.
+ * @param[in] ulNowMs Current time.
+ * @return The delay in milliseconds, 0 when the download is within the rate.
+ */
+uint32_t BandwidthShaper_GetDelayMs( BandwidthShaper_t * pxShaper,
+                                     uint32_t ulBytes,
+                                     uint32_t ulNowMs );
+
+#endif /* AZURE_SAMPLE_BANDWIDTH_SHAPER_H */
@@ -3,9 +3,35 @@
 
 #include <stdint.h>
 
+/* mbed TLS includes. */
+#include "mbedtls/md.h"
+
+/**
+ * @brief HMAC SHA256 key with its padded key blocks already hashed.
+ *
+ * HMAC hashes a block derived from the key before the data, and another one
+ * before the inner hash. The state of SHA256 after each block only depends on
+ * the key, so it is computed once, and a signature only hashes the data and
+ * the inner hash from copies of those states.
+ *
+ * The caller holds one for each key it signs with, and frees it with
+ * Crypto_HMACKeyFree(), which clears the states.
+ *
+ * @note The states are as secret as the key. A key is used by one task at a time.
+ */
+typedef struct CryptoHMACKey
+{
+    mbedtls_md_context_t xInner; /* SHA256 after the key XOR ipad block. */
+    mbedtls_md_context_t xOuter; /* SHA256 after the key XOR opad block. */
+    mbedtls_md_context_t xWork;  /* Copy of a state a signature is computed in. */
+} CryptoHMACKey_t;
+
 /**
  * @brief Initialize crypto
  *
+ * The ESP32 implementation checks the HMAC SHA256 against the RFC 4231 test
+ * vectors, and fails if it does not give the known answers.
+ *
  * @return An #uint32_t with result of operation.
  */
 uint32_t Crypto_Init();
@@ -13,6 +39,9 @@ uint32_t Crypto_Init();
 /**
  * @brief Compute HMAC SHA256
  *
+ * Nothing of the key is kept after the call. A caller signing many times with
+ * the same key holds a key from Crypto_HMACKeyInit() instead.
+ *
  * @param[in] pucKey Pointer to key.
  * @param[in] ulKeyLength Length of Key.
  * @param[in] pucData Pointer to data for HMAC
@@ -29,3 +58,40 @@ uint32_t Crypto_HMAC( const uint8_t * pucKey,
                       uint8_t * pucOutput,
                       uint32_t ulOutputLength,
                       uint32_t * pulBytesCopied );
+
+/**
+ * @brief Hash the padded key blocks of an HMAC SHA256 key.
+ *
+ * @param[out] pxKey The key, freed with Crypto_HMACKeyFree() even on failure.
+ * @param[in] pucKey Pointer to key.
+ * @param[in] ulKeyLength Length of Key.
+ * @return An #uint32_t with result of operation.
+ */
+uint32_t Crypto_HMACKeyInit( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucKey,
+                             uint32_t ulKeyLength );
+
+/**
+ * @brief Compute HMAC SHA256 with a key from Crypto_HMACKeyInit()
+ *
+ * @param[in] pxKey The key.
+ * @param[in] pucData Pointer to data for HMAC
+ * @param[in] ulDataLength Length of data.
+ * @param[in,out] pucOutput Buffer to place computed HMAC.
+ * @param[in] ulOutputLength Length of output buffer.
+ * @param[out] pulBytesCopied Number of bytes copied to out buffer.
+ * @return An #uint32_t with result of operation.
+ */
+uint32_t Crypto_HMACKeySign( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucData,
+                             uint32_t ulDataLength,
+                             uint8_t * pucOutput,
+                             uint32_t ulOutputLength,
+                             uint32_t * pulBytesCopied );
+
+/**
+ * @brief Free an HMAC SHA256 key.
+ *
+ * @param[in] pxKey The key.
+ */
+void Crypto_HMACKeyFree( CryptoHMACKey_t * pxKey );
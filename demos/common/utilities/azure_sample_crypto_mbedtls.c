@@ -3,12 +3,20 @@
 
 #include "azure_sample_crypto.h"
 
+#include <string.h>
+
 #include "threading_alt.h"
 
 /* mbed TLS includes. */
 #include "mbedtls/md.h"
+#include "mbedtls/platform_util.h"
 #include "mbedtls/threading.h"
 
+#define cryptoHMAC_SIZE          32   /**< Size of an HMAC SHA256. */
+#define cryptoHMAC_BLOCK_SIZE    64   /**< Size of a SHA256 block, and of the padded key. */
+#define cryptoHMAC_IPAD          0x36
+#define cryptoHMAC_OPAD          0x5C
+
 /*-----------------------------------------------------------*/
 
 uint32_t Crypto_Init()
@@ -23,6 +31,112 @@ uint32_t Crypto_Init()
 }
 /*-----------------------------------------------------------*/
 
+uint32_t Crypto_HMACKeyInit( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucKey,
+                             uint32_t ulKeyLength )
+{
+    uint32_t ulRet;
+    uint32_t ulIndex;
+    uint8_t ucBlock[ cryptoHMAC_BLOCK_SIZE ];
+    uint8_t ucKeyHash[ cryptoHMAC_SIZE ];
+    const mbedtls_md_info_t * pxMDInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+
+    mbedtls_md_init( &pxKey->xInner );
+    mbedtls_md_init( &pxKey->xOuter );
+    mbedtls_md_init( &pxKey->xWork );
+
+    if( mbedtls_md_setup( &pxKey->xInner, pxMDInfo, 0 ) ||
+        mbedtls_md_setup( &pxKey->xOuter, pxMDInfo, 0 ) ||
+        mbedtls_md_setup( &pxKey->xWork, pxMDInfo, 0 ) )
+    {
+        return 1;
+    }
+
+    /* Keys longer than a block are replaced by their hash. */
+    if( ulKeyLength > sizeof( ucBlock ) )
+    {
+        if( mbedtls_md( pxMDInfo, pucKey, ulKeyLength, ucKeyHash ) )
+        {
+            return 1;
+        }
+
+        pucKey = ucKeyHash;
+        ulKeyLength = sizeof( ucKeyHash );
+    }
+
+    memset( ucBlock, cryptoHMAC_IPAD, sizeof( ucBlock ) );
+
+    for( ulIndex = 0; ulIndex < ulKeyLength; ulIndex++ )
+    {
+        ucBlock[ ulIndex ] ^= pucKey[ ulIndex ];
+    }
+
+    ulRet = ( mbedtls_md_starts( &pxKey->xInner ) ||
+              mbedtls_md_update( &pxKey->xInner, ucBlock, sizeof( ucBlock ) ) ) ? 1 : 0;
+
+    for( ulIndex = 0; ulIndex < sizeof( ucBlock ); ulIndex++ )
+    {
+        ucBlock[ ulIndex ] ^= cryptoHMAC_IPAD ^ cryptoHMAC_OPAD;
+    }
+
+    if( ( ulRet == 0 ) &&
+        ( mbedtls_md_starts( &pxKey->xOuter ) ||
+          mbedtls_md_update( &pxKey->xOuter, ucBlock, sizeof( ucBlock ) ) ) )
+    {
+        ulRet = 1;
+    }
+
+    mbedtls_platform_zeroize( ucBlock, sizeof( ucBlock ) );
+    mbedtls_platform_zeroize( ucKeyHash, sizeof( ucKeyHash ) );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_HMACKeySign( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucData,
+                             uint32_t ulDataLength,
+                             uint8_t * pucOutput,
+                             uint32_t ulOutputLength,
+                             uint32_t * pulBytesCopied )
+{
+    uint32_t ulRet;
+    uint8_t ucInnerHash[ cryptoHMAC_SIZE ];
+
+    if( ulOutputLength < cryptoHMAC_SIZE )
+    {
+        return 1;
+    }
+
+    if( mbedtls_md_clone( &pxKey->xWork, &pxKey->xInner ) ||
+        mbedtls_md_update( &pxKey->xWork, pucData, ulDataLength ) ||
+        mbedtls_md_finish( &pxKey->xWork, ucInnerHash ) ||
+        mbedtls_md_clone( &pxKey->xWork, &pxKey->xOuter ) ||
+        mbedtls_md_update( &pxKey->xWork, ucInnerHash, sizeof( ucInnerHash ) ) ||
+        mbedtls_md_finish( &pxKey->xWork, pucOutput ) )
+    {
+        ulRet = 1;
+    }
+    else
+    {
+        ulRet = 0;
+        *pulBytesCopied = cryptoHMAC_SIZE;
+    }
+
+    mbedtls_platform_zeroize( ucInnerHash, sizeof( ucInnerHash ) );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+void Crypto_HMACKeyFree( CryptoHMACKey_t * pxKey )
+{
+    mbedtls_md_free( &pxKey->xInner );
+    mbedtls_md_free( &pxKey->xOuter );
+    mbedtls_md_free( &pxKey->xWork );
+}
+/*-----------------------------------------------------------*/
+
 uint32_t Crypto_HMAC( const uint8_t * pucKey,
                       uint32_t ulKeyLength,
                       const uint8_t * pucData,
@@ -35,7 +149,7 @@ uint32_t Crypto_HMAC( const uint8_t * pucKey,
     mbedtls_md_context_t xCtx;
     mbedtls_md_type_t xMDType = MBEDTLS_MD_SHA256;
 
-    if( ulOutputLength < 32 )
+    if( ulOutputLength < cryptoHMAC_SIZE )
     {
         return 1;
     }
@@ -52,7 +166,7 @@ uint32_t Crypto_HMAC( const uint8_t * pucKey,
     else
     {
         ulRet = 0;
-        *pulBytesCopied = 32;
+        *pulBytesCopied = cryptoHMAC_SIZE;
     }
 
     mbedtls_md_free( &xCtx );
@@ -0,0 +1,853 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_deferred_log.c
+ * @brief Implements the deferred logging backend.
+ *
+ * Each log is a record in a byte ring buffer: a header holding the length of
+ * the record, its state and the address of the format string, followed by the
+ * raw arguments in the order of the format. Producers reserve space by moving
+ * the head with a compare and swap, write their record and then publish it by
+ * setting its state. The formatting task is the only consumer, it walks the
+ * committed records from the tail and gives the space back once formatted.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "azure_sample_deferred_log.h"
+
+/*-----------------------------------------------------------*/
+
+#if ( ( deferredlogRING_BUFFER_SIZE & ( deferredlogRING_BUFFER_SIZE - 1U ) ) != 0U )
+    #error "deferredlogRING_BUFFER_SIZE must be a power of two"
+#endif
+
+/* Records are aligned so any space left at the end of the ring can hold the
+ * header of a padding record. */
+#define deferredlogRECORD_ALIGNMENT           ( 16U )
+#define deferredlogRING_MASK                  ( deferredlogRING_BUFFER_SIZE - 1U )
+
+/* Larger records would keep the ring from holding anything else. */
+#define deferredlogMAX_RECORD_SIZE            ( deferredlogRING_BUFFER_SIZE / 2U )
+
+#define deferredlogRECORD_STATE_EMPTY         ( 0U )
+#define deferredlogRECORD_STATE_COMMITTED     ( 1U )
+#define deferredlogRECORD_STATE_PADDING       ( 2U )
+
+/* Arguments up to this size are encoded once, on the stack of the caller. */
+#define deferredlogSCRATCH_SIZE               ( 192U )
+
+/* Longest conversion specification which can be formatted, once the '*' have
+ * been replaced by their values. */
+#define deferredlogMAX_SPECIFICATION_LENGTH   ( 32U )
+
+#define deferredlogALIGN_UP( x )              ( ( ( x ) + deferredlogRECORD_ALIGNMENT - 1U ) & ~( deferredlogRECORD_ALIGNMENT - 1U ) )
+
+/*-----------------------------------------------------------*/
+
+typedef struct DeferredLogRecordHeader
+{
+    uint32_t ulLength;     /**< Size of the record in bytes, header included. */
+    uint32_t ulState;      /**< One of the deferredlogRECORD_STATE_ values. */
+    const char * pcFormat; /**< Format string, NULL for padding records. */
+} DeferredLogRecordHeader_t;
+
+/**
+ * @brief How an argument is stored in a record.
+ */
+typedef enum DeferredLogArgumentType
+{
+    eDeferredLogArgumentPercent = 0, /**< "%%", no argument. */
+    eDeferredLogArgumentInvalid,     /**< Unsupported conversion, written as is. */
+    eDeferredLogArgumentInt,
+    eDeferredLogArgumentLong,
+    eDeferredLogArgumentLongLong,
+    eDeferredLogArgumentSize,
+    eDeferredLogArgumentIntMax,
+    eDeferredLogArgumentPtrDiff,
+    eDeferredLogArgumentDouble,
+    eDeferredLogArgumentLongDouble,
+    eDeferredLogArgumentPointer,
+    eDeferredLogArgumentString,   /**< Length, characters and a NULL terminator. */
+    eDeferredLogArgumentWriteBack /**< "%n", the pointer is consumed and not stored. */
+} DeferredLogArgumentType_t;
+
+typedef struct DeferredLogSpecification
+{
+    size_t xLength;                  /**< Length of the specification, '%' included. */
+    BaseType_t xHasWidth;            /**< A width is given, as digits or '*'. */
+    BaseType_t xStarWidth;           /**< The width is an int argument. */
+    BaseType_t xStarPrecision;       /**< The precision is an int argument. */
+    int32_t lPrecision;              /**< Precision given as digits, -1 if none. */
+    DeferredLogArgumentType_t xType; /**< How the argument is stored. */
+} DeferredLogSpecification_t;
+
+/*-----------------------------------------------------------*/
+
+/* uint64_t keeps the headers aligned for the pointer they hold. */
+static uint64_t ullRing[ deferredlogRING_BUFFER_SIZE / sizeof( uint64_t ) ];
+static uint8_t * const pucRing = ( uint8_t * ) ullRing;
+
+/* Free running indexes, only their low bits are offsets in the ring. */
+static uint32_t ulHeadIndex = 0;
+static uint32_t ulTailIndex = 0;
+
+static uint32_t ulDroppedCount = 0;
+static uint32_t ulReportedDroppedCount = 0;
+
+static DeferredLogWriter_t xLogWriter = NULL;
+static TaskHandle_t xLogTask = NULL;
+
+/* Set while a consumer walks the ring, the task or DeferredLog_Flush(). */
+static uint32_t ulConsumerBusy = 0;
+
+static char cLineBuffer[ deferredlogLINE_BUFFER_SIZE ];
+static size_t xLineLength = 0;
+
+/*-----------------------------------------------------------*/
+
+static const char * prvParseSpecification( const char * pcSpecification,
+                                           DeferredLogSpecification_t * pxSpecification )
+{
+    const char * pcCurrent = pcSpecification + 1;
+    uint32_t ulLongCount = 0;
+    char cModifier = '\0';
+
+    memset( pxSpecification, 0, sizeof( *pxSpecification ) );
+    pxSpecification->lPrecision = -1;
+
+    /* Flags */
+    while( ( *pcCurrent == '-' ) || ( *pcCurrent == '+' ) || ( *pcCurrent == ' ' ) ||
+           ( *pcCurrent == '#' ) || ( *pcCurrent == '0' ) )
+    {
+        pcCurrent++;
+    }
+
+    /* Width */
+    if( *pcCurrent == '*' )
+    {
+        pxSpecification->xHasWidth = pdTRUE;
+        pxSpecification->xStarWidth = pdTRUE;
+        pcCurrent++;
+    }
+    else
+    {
+        while( ( *pcCurrent >= '0' ) && ( *pcCurrent <= '9' ) )
+        {
+            pxSpecification->xHasWidth = pdTRUE;
+            pcCurrent++;
+        }
+    }
+
+    /* Precision */
+    if( *pcCurrent == '.' )
+    {
+        pcCurrent++;
+
+        if( *pcCurrent == '*' )
+        {
+            pxSpecification->xStarPrecision = pdTRUE;
+            pcCurrent++;
+        }
+        else
+        {
+            pxSpecification->lPrecision = 0;
+
+            while( ( *pcCurrent >= '0' ) && ( *pcCurrent <= '9' ) )
+            {
+                pxSpecification->lPrecision = ( pxSpecification->lPrecision * 10 ) + ( *pcCurrent - '0' );
+                pcCurrent++;
+            }
+        }
+    }
+
+    /* Length modifier */
+    while( ( *pcCurrent == 'l' ) || ( *pcCurrent == 'h' ) )
+    {
+        /* char and short are promoted to int, only longs change the size. */
+        if( *pcCurrent == 'l' )
+        {
+            ulLongCount++;
+        }
+
+        pcCurrent++;
+    }
+
+    if( ( *pcCurrent == 'z' ) || ( *pcCurrent == 'j' ) || ( *pcCurrent == 't' ) || ( *pcCurrent == 'L' ) )
+    {
+        cModifier = *pcCurrent;
+        pcCurrent++;
+    }
+
+    /* Conversion */
+    switch( *pcCurrent )
+    {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+
+            if( cModifier == 'z' )
+            {
+                pxSpecification->xType = eDeferredLogArgumentSize;
+            }
+            else if( cModifier == 'j' )
+            {
+                pxSpecification->xType = eDeferredLogArgumentIntMax;
+            }
+            else if( cModifier == 't' )
+            {
+                pxSpecification->xType = eDeferredLogArgumentPtrDiff;
+            }
+            else if( ulLongCount > 1 )
+            {
+                pxSpecification->xType = eDeferredLogArgumentLongLong;
+            }
+            else if( ulLongCount == 1 )
+            {
+                pxSpecification->xType = eDeferredLogArgumentLong;
+            }
+            else
+            {
+                pxSpecification->xType = eDeferredLogArgumentInt;
+            }
+
+            break;
+
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            pxSpecification->xType = ( cModifier == 'L' ) ? eDeferredLogArgumentLongDouble : eDeferredLogArgumentDouble;
+            break;
+
+        case 'p':
+            pxSpecification->xType = eDeferredLogArgumentPointer;
+            break;
+
+        case 's':
+            pxSpecification->xType = eDeferredLogArgumentString;
+            break;
+
+        case 'n':
+            pxSpecification->xType = eDeferredLogArgumentWriteBack;
+            break;
+
+        case '%':
+            pxSpecification->xType = eDeferredLogArgumentPercent;
+            break;
+
+        default:
+            pxSpecification->xType = eDeferredLogArgumentInvalid;
+            break;
+    }
+
+    if( *pcCurrent != '\0' )
+    {
+        pcCurrent++;
+    }
+
+    pxSpecification->xLength = ( size_t ) ( pcCurrent - pcSpecification );
+
+    return pcCurrent;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPut( uint8_t * pucOutput,
+                    size_t xOutputSize,
+                    size_t * pxOffset,
+                    const void * pvData,
+                    size_t xLength )
+{
+    /* Past the end of the output only the length is counted. */
+    if( ( *pxOffset + xLength ) <= xOutputSize )
+    {
+        memcpy( &pucOutput[ *pxOffset ], pvData, xLength );
+    }
+
+    *pxOffset += xLength;
+}
+/*-----------------------------------------------------------*/
+
+#define deferredlogPUT_ARGUMENT( xType )                                    \
+    do {                                                                    \
+        xType xValue = va_arg( *pxArgs, xType );                            \
+        prvPut( pucOutput, xOutputSize, &xOffset, &xValue, sizeof( xValue ) ); \
+    } while( 0 )
+
+/**
+ * @brief Store the arguments of a format string.
+ *
+ * @return Number of bytes of the arguments, only the first xOutputSize of
+ * them are written if larger.
+ */
+static size_t prvEncodeArguments( const char * pcFormat,
+                                  va_list * pxArgs,
+                                  uint8_t * pucOutput,
+                                  size_t xOutputSize )
+{
+    DeferredLogSpecification_t xSpecification;
+    const char * pcCurrent = pcFormat;
+    const char * pcString;
+    size_t xOffset = 0;
+    uint32_t ulStringLength;
+    uint32_t ulMaxStringLength;
+    int lValue;
+
+    while( ( pcCurrent = strchr( pcCurrent, '%' ) ) != NULL )
+    {
+        pcCurrent = prvParseSpecification( pcCurrent, &xSpecification );
+
+        if( xSpecification.xStarWidth )
+        {
+            deferredlogPUT_ARGUMENT( int );
+        }
+
+        if( xSpecification.xStarPrecision )
+        {
+            lValue = va_arg( *pxArgs, int );
+            prvPut( pucOutput, xOutputSize, &xOffset, &lValue, sizeof( lValue ) );
+            xSpecification.lPrecision = ( int32_t ) lValue;
+        }
+
+        switch( xSpecification.xType )
+        {
+            case eDeferredLogArgumentInt:
+                deferredlogPUT_ARGUMENT( int );
+                break;
+
+            case eDeferredLogArgumentLong:
+                deferredlogPUT_ARGUMENT( long );
+                break;
+
+            case eDeferredLogArgumentLongLong:
+                deferredlogPUT_ARGUMENT( long long );
+                break;
+
+            case eDeferredLogArgumentSize:
+                deferredlogPUT_ARGUMENT( size_t );
+                break;
+
+            case eDeferredLogArgumentIntMax:
+                deferredlogPUT_ARGUMENT( intmax_t );
+                break;
+
+            case eDeferredLogArgumentPtrDiff:
+                deferredlogPUT_ARGUMENT( ptrdiff_t );
+                break;
+
+            case eDeferredLogArgumentDouble:
+                deferredlogPUT_ARGUMENT( double );
+                break;
+
+            case eDeferredLogArgumentLongDouble:
+                deferredlogPUT_ARGUMENT( long double );
+                break;
+
+            case eDeferredLogArgumentPointer:
+                deferredlogPUT_ARGUMENT( void * );
+                break;
+
+            case eDeferredLogArgumentString:
+                pcString = va_arg( *pxArgs, const char * );
+
+                if( pcString == NULL )
+                {
+                    pcString = "(null)";
+                }
+
+                ulMaxStringLength = deferredlogMAX_STRING_LENGTH;
+
+                if( ( xSpecification.lPrecision >= 0 ) &&
+                    ( ( uint32_t ) xSpecification.lPrecision < ulMaxStringLength ) )
+                {
+                    ulMaxStringLength = ( uint32_t ) xSpecification.lPrecision;
+                }
+
+                ulStringLength = ( uint32_t ) strnlen( pcString, ulMaxStringLength );
+
+                prvPut( pucOutput, xOutputSize, &xOffset, &ulStringLength, sizeof( ulStringLength ) );
+                prvPut( pucOutput, xOutputSize, &xOffset, pcString, ulStringLength );
+                prvPut( pucOutput, xOutputSize, &xOffset, "", 1 );
+                break;
+
+            case eDeferredLogArgumentWriteBack:
+                ( void ) va_arg( *pxArgs, void * );
+                break;
+
+            case eDeferredLogArgumentPercent:
+            case eDeferredLogArgumentInvalid:
+            default:
+                break;
+        }
+    }
+
+    return xOffset;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reserve space for a record at the head of the ring.
+ *
+ * @return The reserved space, NULL if the ring is full.
+ */
+static DeferredLogRecordHeader_t * prvReserve( uint32_t ulLength )
+{
+    DeferredLogRecordHeader_t * pxPadding;
+    uint32_t ulHead;
+    uint32_t ulTail;
+    uint32_t ulOffset;
+    uint32_t ulPadding;
+
+    ulHead = __atomic_load_n( &ulHeadIndex, __ATOMIC_RELAXED );
+
+    do
+    {
+        /* Acquire, the space given back by the consumer must be cleared
+         * before it is reused. */
+        ulTail = __atomic_load_n( &ulTailIndex, __ATOMIC_ACQUIRE );
+        ulOffset = ulHead & deferredlogRING_MASK;
+
+        /* Records are contiguous, skip the end of the ring if it is too short. */
+        ulPadding = ( ( ulOffset + ulLength ) > deferredlogRING_BUFFER_SIZE ) ?
+                    ( deferredlogRING_BUFFER_SIZE - ulOffset ) : 0U;
+
+        if( ( ( ulHead - ulTail ) + ulPadding + ulLength ) > deferredlogRING_BUFFER_SIZE )
+        {
+            return NULL;
+        }
+    } while( !__atomic_compare_exchange_n( &ulHeadIndex, &ulHead, ulHead + ulPadding + ulLength,
+                                           pdTRUE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) );
+
+    if( ulPadding != 0U )
+    {
+        pxPadding = ( DeferredLogRecordHeader_t * ) &pucRing[ ulOffset ];
+        pxPadding->ulLength = ulPadding;
+        pxPadding->pcFormat = NULL;
+        __atomic_store_n( &pxPadding->ulState, deferredlogRECORD_STATE_PADDING, __ATOMIC_RELEASE );
+        ulOffset = 0;
+    }
+
+    return ( DeferredLogRecordHeader_t * ) &pucRing[ ulOffset ];
+}
+/*-----------------------------------------------------------*/
+
+int DeferredLog_VPrintf( const char * pcFormat,
+                         va_list xArgs )
+{
+    DeferredLogRecordHeader_t * pxRecord;
+    va_list xArgsCopy;
+    uint8_t ucScratch[ deferredlogSCRATCH_SIZE ];
+    size_t xArgumentsLength;
+    uint32_t ulLength;
+
+    if( pcFormat == NULL )
+    {
+        return 0;
+    }
+
+    /* Encode on the stack first, which sizes the record at the same time. */
+    va_copy( xArgsCopy, xArgs );
+    xArgumentsLength = prvEncodeArguments( pcFormat, &xArgsCopy, ucScratch, sizeof( ucScratch ) );
+    va_end( xArgsCopy );
+
+    ulLength = ( uint32_t ) deferredlogALIGN_UP( sizeof( DeferredLogRecordHeader_t ) + xArgumentsLength );
+
+    if( ( ulLength > deferredlogMAX_RECORD_SIZE ) ||
+        ( ( pxRecord = prvReserve( ulLength ) ) == NULL ) )
+    {
+        ( void ) __atomic_add_fetch( &ulDroppedCount, 1U, __ATOMIC_RELAXED );
+        return 0;
+    }
+
+    if( xArgumentsLength <= sizeof( ucScratch ) )
+    {
+        memcpy( pxRecord + 1, ucScratch, xArgumentsLength );
+    }
+    else
+    {
+        /* Long strings, encode again straight into the record. */
+        va_copy( xArgsCopy, xArgs );
+        ( void ) prvEncodeArguments( pcFormat, &xArgsCopy, ( uint8_t * ) ( pxRecord + 1 ), xArgumentsLength );
+        va_end( xArgsCopy );
+    }
+
+    pxRecord->ulLength = ulLength;
+    pxRecord->pcFormat = pcFormat;
+    __atomic_store_n( &pxRecord->ulState, deferredlogRECORD_STATE_COMMITTED, __ATOMIC_RELEASE );
+
+    return ( int ) ulLength;
+}
+/*-----------------------------------------------------------*/
+
+static void prvFlushLine( void )
+{
+    if( ( xLineLength > 0 ) && ( xLogWriter != NULL ) )
+    {
+        xLogWriter( cLineBuffer, xLineLength );
+    }
+
+    xLineLength = 0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvEmit( const char * pcText,
+                     size_t xLength )
+{
+    if( ( xLineLength + xLength ) > sizeof( cLineBuffer ) )
+    {
+        prvFlushLine();
+    }
+
+    if( xLength > sizeof( cLineBuffer ) )
+    {
+        if( xLogWriter != NULL )
+        {
+            xLogWriter( pcText, xLength );
+        }
+    }
+    else if( xLength > 0 )
+    {
+        memcpy( &cLineBuffer[ xLineLength ], pcText, xLength );
+        xLineLength += xLength;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvEmitFormatted( const char * pcSpecification,
+                              ... )
+{
+    va_list xArgs;
+    size_t xRemaining = sizeof( cLineBuffer ) - xLineLength;
+    int lLength;
+
+    va_start( xArgs, pcSpecification );
+    lLength = vsnprintf( &cLineBuffer[ xLineLength ], xRemaining, pcSpecification, xArgs );
+    va_end( xArgs );
+
+    if( lLength < 0 )
+    {
+        return;
+    }
+
+    if( ( size_t ) lLength < xRemaining )
+    {
+        xLineLength += ( size_t ) lLength;
+        return;
+    }
+
+    /* Did not fit, retry on an empty buffer and truncate if still too long. */
+    prvFlushLine();
+
+    va_start( xArgs, pcSpecification );
+    lLength = vsnprintf( cLineBuffer, sizeof( cLineBuffer ), pcSpecification, xArgs );
+    va_end( xArgs );
+
+    if( lLength > 0 )
+    {
+        xLineLength = ( ( size_t ) lLength < sizeof( cLineBuffer ) ) ? ( size_t ) lLength : ( sizeof( cLineBuffer ) - 1 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#define deferredlogGET_ARGUMENT( xType, xValue )          \
+    do {                                                  \
+        memcpy( &( xValue ), *ppucArgs, sizeof( xType ) ); \
+        *ppucArgs += sizeof( xType );                     \
+    } while( 0 )
+
+static void prvFormatArgument( const char * pcSpecificationText,
+                               const DeferredLogSpecification_t * pxSpecification,
+                               const uint8_t ** ppucArgs )
+{
+    char cSpecification[ deferredlogMAX_SPECIFICATION_LENGTH ];
+    size_t xSpecificationLength = 0;
+    size_t xIndex;
+    int lStarValues[ 2 ];
+    uint32_t ulStarCount = 0;
+    uint32_t ulStarUsed = 0;
+    uint32_t ulStringLength;
+    int lLength;
+
+    union
+    {
+        int lInt;
+        long lLong;
+        long long llLongLong;
+        size_t xSize;
+        intmax_t xIntMax;
+        ptrdiff_t xPtrDiff;
+        double xDouble;
+        long double xLongDouble;
+        void * pvPointer;
+    } xValue;
+
+    if( pxSpecification->xType == eDeferredLogArgumentPercent )
+    {
+        prvEmit( "%", 1 );
+        return;
+    }
+
+    if( pxSpecification->xType == eDeferredLogArgumentInvalid )
+    {
+        prvEmit( pcSpecificationText, pxSpecification->xLength );
+        return;
+    }
+
+    if( pxSpecification->xStarWidth )
+    {
+        deferredlogGET_ARGUMENT( int, lStarValues[ ulStarCount ] );
+        ulStarCount++;
+    }
+
+    if( pxSpecification->xStarPrecision )
+    {
+        deferredlogGET_ARGUMENT( int, lStarValues[ ulStarCount ] );
+        ulStarCount++;
+    }
+
+    /* Rebuild a NULL terminated specification with the '*' replaced by their
+     * values, so a single call formats it whatever the stars. */
+    for( xIndex = 0; xIndex < pxSpecification->xLength; xIndex++ )
+    {
+        if( pcSpecificationText[ xIndex ] == '*' )
+        {
+            lLength = snprintf( &cSpecification[ xSpecificationLength ],
+                                sizeof( cSpecification ) - xSpecificationLength,
+                                "%d", lStarValues[ ulStarUsed++ ] );
+        }
+        else
+        {
+            cSpecification[ xSpecificationLength ] = pcSpecificationText[ xIndex ];
+            lLength = ( ( xSpecificationLength + 1 ) < sizeof( cSpecification ) ) ? 1 : -1;
+        }
+
+        if( ( lLength < 0 ) || ( ( xSpecificationLength + ( size_t ) lLength ) >= sizeof( cSpecification ) ) )
+        {
+            /* The arguments of this specification are still skipped below. */
+            xSpecificationLength = 0;
+            break;
+        }
+
+        xSpecificationLength += ( size_t ) lLength;
+    }
+
+    cSpecification[ xSpecificationLength ] = '\0';
+
+    switch( pxSpecification->xType )
+    {
+        case eDeferredLogArgumentInt:
+            deferredlogGET_ARGUMENT( int, xValue.lInt );
+            prvEmitFormatted( cSpecification, xValue.lInt );
+            break;
+
+        case eDeferredLogArgumentLong:
+            deferredlogGET_ARGUMENT( long, xValue.lLong );
+            prvEmitFormatted( cSpecification, xValue.lLong );
+            break;
+
+        case eDeferredLogArgumentLongLong:
+            deferredlogGET_ARGUMENT( long long, xValue.llLongLong );
+            prvEmitFormatted( cSpecification, xValue.llLongLong );
+            break;
+
+        case eDeferredLogArgumentSize:
+            deferredlogGET_ARGUMENT( size_t, xValue.xSize );
+            prvEmitFormatted( cSpecification, xValue.xSize );
+            break;
+
+        case eDeferredLogArgumentIntMax:
+            deferredlogGET_ARGUMENT( intmax_t, xValue.xIntMax );
+            prvEmitFormatted( cSpecification, xValue.xIntMax );
+            break;
+
+        case eDeferredLogArgumentPtrDiff:
+            deferredlogGET_ARGUMENT( ptrdiff_t, xValue.xPtrDiff );
+            prvEmitFormatted( cSpecification, xValue.xPtrDiff );
+            break;
+
+        case eDeferredLogArgumentDouble:
+            deferredlogGET_ARGUMENT( double, xValue.xDouble );
+            prvEmitFormatted( cSpecification, xValue.xDouble );
+            break;
+
+        case eDeferredLogArgumentLongDouble:
+            deferredlogGET_ARGUMENT( long double, xValue.xLongDouble );
+            prvEmitFormatted( cSpecification, xValue.xLongDouble );
+            break;
+
+        case eDeferredLogArgumentPointer:
+            deferredlogGET_ARGUMENT( void *, xValue.pvPointer );
+            prvEmitFormatted( cSpecification, xValue.pvPointer );
+            break;
+
+        case eDeferredLogArgumentString:
+            deferredlogGET_ARGUMENT( uint32_t, ulStringLength );
+
+            /* Already cut to the precision when recorded, only a width needs
+             * formatting. */
+            if( pxSpecification->xHasWidth )
+            {
+                prvEmitFormatted( cSpecification, ( const char * ) *ppucArgs );
+            }
+            else
+            {
+                prvEmit( ( const char * ) *ppucArgs, ulStringLength );
+            }
+
+            *ppucArgs += ulStringLength + 1;
+            break;
+
+        case eDeferredLogArgumentWriteBack:
+        default:
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvFormatRecord( const DeferredLogRecordHeader_t * pxRecord )
+{
+    DeferredLogSpecification_t xSpecification;
+    const uint8_t * pucArgs = ( const uint8_t * ) ( pxRecord + 1 );
+    const char * pcLiteral = pxRecord->pcFormat;
+    const char * pcCurrent = pxRecord->pcFormat;
+    const char * pcNext;
+
+    while( *pcCurrent != '\0' )
+    {
+        if( *pcCurrent != '%' )
+        {
+            pcCurrent++;
+            continue;
+        }
+
+        prvEmit( pcLiteral, ( size_t ) ( pcCurrent - pcLiteral ) );
+
+        pcNext = prvParseSpecification( pcCurrent, &xSpecification );
+        prvFormatArgument( pcCurrent, &xSpecification, &pucArgs );
+
+        pcCurrent = pcNext;
+        pcLiteral = pcCurrent;
+    }
+
+    prvEmit( pcLiteral, ( size_t ) ( pcCurrent - pcLiteral ) );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t DeferredLog_Flush( void )
+{
+    DeferredLogRecordHeader_t * pxRecord;
+    uint32_t ulTail;
+    uint32_t ulState;
+    uint32_t ulLength;
+    uint32_t ulDropped;
+    uint32_t ulWritten = 0;
+
+    if( ( xLogWriter == NULL ) ||
+        ( __atomic_exchange_n( &ulConsumerBusy, 1U, __ATOMIC_ACQUIRE ) != 0U ) )
+    {
+        return 0;
+    }
+
+    ulTail = __atomic_load_n( &ulTailIndex, __ATOMIC_RELAXED );
+
+    while( ulTail != __atomic_load_n( &ulHeadIndex, __ATOMIC_ACQUIRE ) )
+    {
+        pxRecord = ( DeferredLogRecordHeader_t * ) &pucRing[ ulTail & deferredlogRING_MASK ];
+        ulState = __atomic_load_n( &pxRecord->ulState, __ATOMIC_ACQUIRE );
+
+        if( ulState == deferredlogRECORD_STATE_EMPTY )
+        {
+            /* Reserved but not committed yet, keep the order and wait. */
+            break;
+        }
+
+        ulLength = pxRecord->ulLength;
+
+        if( ulState == deferredlogRECORD_STATE_COMMITTED )
+        {
+            prvFormatRecord( pxRecord );
+            ulWritten++;
+        }
+
+        /* Records do not start at fixed offsets, clear the whole record so
+         * no stale state is found when its space is reused. */
+        memset( pxRecord, 0, ulLength );
+        ulTail += ulLength;
+        __atomic_store_n( &ulTailIndex, ulTail, __ATOMIC_RELEASE );
+    }
+
+    ulDropped = __atomic_load_n( &ulDroppedCount, __ATOMIC_RELAXED );
+
+    if( ulDropped != ulReportedDroppedCount )
+    {
+        prvEmitFormatted( "[deferred log] %u logs dropped\r\n", ( unsigned int ) ( ulDropped - ulReportedDroppedCount ) );
+        ulReportedDroppedCount = ulDropped;
+    }
+
+    prvFlushLine();
+
+    __atomic_store_n( &ulConsumerBusy, 0U, __ATOMIC_RELEASE );
+
+    return ulWritten;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeferredLogTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) DeferredLog_Flush();
+        vTaskDelay( pdMS_TO_TICKS( deferredlogPOLL_PERIOD_MS ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+DeferredLogStatus_t DeferredLog_Init( DeferredLogWriter_t xWriter,
+                                      UBaseType_t uxPriority )
+{
+    if( xWriter == NULL )
+    {
+        return eDeferredLogInvalidParameter;
+    }
+
+    if( xLogTask != NULL )
+    {
+        return eDeferredLogAlreadyInitialized;
+    }
+
+    xLogWriter = xWriter;
+
+    if( xTaskCreate( prvDeferredLogTask, "DeferredLog", deferredlogTASK_STACK_SIZE,
+                     NULL, uxPriority, &xLogTask ) != pdPASS )
+    {
+        xLogWriter = NULL;
+        return eDeferredLogTaskCreateFailed;
+    }
+
+    return eDeferredLogSuccess;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t DeferredLog_GetDroppedCount( void )
+{
+    return __atomic_load_n( &ulDroppedCount, __ATOMIC_RELAXED );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,127 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_deferred_log.h
+ * @brief Deferred logging backend.
+ *
+ * Log calls only record the address of their format string and the raw
+ * values of their arguments into a lock-free ring buffer. The formatting and
+ * the write to the console are done later by a low priority task.
+ *
+ * @note Format strings must stay valid for the lifetime of the application,
+ * which is the case of the string literals used by the logging macros.
+ * String arguments are copied into the record.
+ */
+
+#ifndef AZURE_SAMPLE_DEFERRED_LOG_H
+#define AZURE_SAMPLE_DEFERRED_LOG_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Size in bytes of the ring buffer, must be a power of two.
+ */
+#ifndef deferredlogRING_BUFFER_SIZE
+    #define deferredlogRING_BUFFER_SIZE    ( 8192U )
+#endif
+
+/**
+ * @brief Maximum number of bytes copied for a string argument, longer strings
+ * are truncated.
+ */
+#ifndef deferredlogMAX_STRING_LENGTH
+    #define deferredlogMAX_STRING_LENGTH    ( 512U )
+#endif
+
+/**
+ * @brief Size of the buffer the formatting task writes to before calling the
+ * writer.
+ */
+#ifndef deferredlogLINE_BUFFER_SIZE
+    #define deferredlogLINE_BUFFER_SIZE    ( 512U )
+#endif
+
+/**
+ * @brief Period at which the formatting task looks for new records.
+ */
+#ifndef deferredlogPOLL_PERIOD_MS
+    #define deferredlogPOLL_PERIOD_MS    ( 20U )
+#endif
+
+/**
+ * @brief Stack size of the formatting task.
+ */
+#ifndef deferredlogTASK_STACK_SIZE
+    #define deferredlogTASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 4 )
+#endif
+
+/**
+ * @brief Writes formatted log text to the console.
+ *
+ * @param[in] pcText Text to write, not NULL terminated.
+ * @param[in] xLength Length of the text.
+ */
+typedef void (* DeferredLogWriter_t)( const char * pcText,
+                                      size_t xLength );
+
+/**
+ * @brief Deferred logging return status.
+ */
+typedef enum DeferredLogStatus
+{
+    eDeferredLogSuccess = 0,        /**< Function successfully completed. */
+    eDeferredLogInvalidParameter,   /**< At least one parameter was invalid. */
+    eDeferredLogAlreadyInitialized, /**< The formatting task is already running. */
+    eDeferredLogTaskCreateFailed    /**< The formatting task could not be created. */
+} DeferredLogStatus_t;
+
+/**
+ * @brief Start the task which formats the recorded logs.
+ *
+ * Logs recorded before this call are kept and written once the task runs.
+ *
+ * @param[in] xWriter Function the formatted text is written with.
+ * @param[in] uxPriority Priority of the formatting task.
+ * @return A #DeferredLogStatus_t with the result of the operation.
+ */
+DeferredLogStatus_t DeferredLog_Init( DeferredLogWriter_t xWriter,
+                                      UBaseType_t uxPriority );
+
+/**
+ * @brief Record a log, printf style.
+ *
+ * Never blocks: when the ring buffer is full the log is dropped and counted.
+ * The signature matches vprintf so it can be installed with
+ * esp_log_set_vprintf().
+ *
+ * @param[in] pcFormat Format string, must stay valid for the lifetime of the application.
+ * @param[in] xArgs Arguments of the format string.
+ * @return Number of bytes recorded, 0 if the log was dropped.
+ */
+int DeferredLog_VPrintf( const char * pcFormat,
+                         va_list xArgs );
+
+/**
+ * @brief Format and write the recorded logs from the calling task.
+ *
+ * Used before halting, e.g. in an assert handler. Does nothing if the
+ * formatting task is writing at the time of the call.
+ *
+ * @return Number of logs written.
+ */
+uint32_t DeferredLog_Flush( void );
+
+/**
+ * @brief Get the number of logs dropped because the ring buffer was full.
+ *
+ * @return Number of dropped logs since boot.
+ */
+uint32_t DeferredLog_GetDroppedCount( void );
+
+#endif /* AZURE_SAMPLE_DEFERRED_LOG_H */
@@ -0,0 +1,180 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_heatshrink.c
+ * @brief Implements the streaming decoder of azure_sample_heatshrink.h.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_sample_heatshrink.h"
+
+/* Fields of the stream the decoder is reading. */
+#define heatshrinkSTATE_TAG         ( 0U )
+#define heatshrinkSTATE_LITERAL     ( 1U )
+#define heatshrinkSTATE_DISTANCE    ( 2U )
+#define heatshrinkSTATE_LENGTH      ( 3U )
+#define heatshrinkSTATE_COPY        ( 4U )
+
+#define heatshrinkMIN_WINDOW_BITS       ( 4U )
+#define heatshrinkMIN_LOOKAHEAD_BITS    ( 3U )
+
+/*-----------------------------------------------------------*/
+
+/* Reads a field of ucCount bits, which can span several calls. Returns false
+ * when the input ends before the field. */
+static bool prvReadBits( HeatshrinkDecoder_t * pxDecoder,
+                         uint8_t ucCount,
+                         const uint8_t * pucInput,
+                         uint32_t ulInputLength,
+                         uint32_t * pulConsumed,
+                         uint16_t * pusValue )
+{
+    while( pxDecoder->ucBitsRead < ucCount )
+    {
+        if( pxDecoder->ucInputMask == 0U )
+        {
+            if( *pulConsumed == ulInputLength )
+            {
+                return false;
+            }
+
+            pxDecoder->ucInputByte = pucInput[ ( *pulConsumed )++ ];
+            pxDecoder->ucInputMask = 0x80U;
+        }
+
+        pxDecoder->usBits = ( uint16_t ) ( ( pxDecoder->usBits << 1 ) |
+                                           ( ( ( pxDecoder->ucInputByte & pxDecoder->ucInputMask ) != 0U ) ? 1U : 0U ) );
+        pxDecoder->ucInputMask >>= 1;
+        pxDecoder->ucBitsRead++;
+    }
+
+    *pusValue = pxDecoder->usBits;
+    pxDecoder->usBits = 0;
+    pxDecoder->ucBitsRead = 0;
+
+    return true;
+}
+/*-----------------------------------------------------------*/
+
+static void prvEmit( HeatshrinkDecoder_t * pxDecoder,
+                     uint8_t ucByte,
+                     uint8_t * pucOutput,
+                     uint32_t * pulProduced )
+{
+    pxDecoder->ucWindow[ pxDecoder->ulHead & ( ( 1UL << pxDecoder->ucWindowBits ) - 1U ) ] = ucByte;
+    pxDecoder->ulHead++;
+    pucOutput[ ( *pulProduced )++ ] = ucByte;
+}
+/*-----------------------------------------------------------*/
+
+HeatshrinkResult_t Heatshrink_Init( HeatshrinkDecoder_t * pxDecoder,
+                                    uint8_t ucWindowBits,
+                                    uint8_t ucLookaheadBits )
+{
+    if( ( pxDecoder == NULL ) ||
+        ( ucWindowBits < heatshrinkMIN_WINDOW_BITS ) || ( ucWindowBits > heatshrinkMAX_WINDOW_BITS ) ||
+        ( ucLookaheadBits < heatshrinkMIN_LOOKAHEAD_BITS ) || ( ucLookaheadBits >= ucWindowBits ) )
+    {
+        return eHeatshrinkInvalidParameter;
+    }
+
+    /* The references before the start of the stream read zeros. */
+    ( void ) memset( pxDecoder, 0, sizeof( *pxDecoder ) );
+    pxDecoder->ucWindowBits = ucWindowBits;
+    pxDecoder->ucLookaheadBits = ucLookaheadBits;
+    pxDecoder->ucState = heatshrinkSTATE_TAG;
+
+    return eHeatshrinkSuccess;
+}
+/*-----------------------------------------------------------*/
+
+HeatshrinkResult_t Heatshrink_Decode( HeatshrinkDecoder_t * pxDecoder,
+                                      const uint8_t * pucInput,
+                                      uint32_t ulInputLength,
+                                      uint32_t * pulConsumed,
+                                      uint8_t * pucOutput,
+                                      uint32_t ulOutputSize,
+                                      uint32_t * pulProduced )
+{
+    uint32_t ulMask;
+    uint16_t usValue;
+    bool xMoreInput = true;
+
+    if( ( pxDecoder == NULL ) || ( ( pucInput == NULL ) && ( ulInputLength != 0U ) ) ||
+        ( pulConsumed == NULL ) || ( pucOutput == NULL ) || ( pulProduced == NULL ) )
+    {
+        return eHeatshrinkInvalidParameter;
+    }
+
+    ulMask = ( 1UL << pxDecoder->ucWindowBits ) - 1U;
+    *pulConsumed = 0;
+    *pulProduced = 0;
+
+    while( xMoreInput && ( *pulProduced < ulOutputSize ) )
+    {
+        switch( pxDecoder->ucState )
+        {
+            case heatshrinkSTATE_TAG:
+
+                if( ( xMoreInput = prvReadBits( pxDecoder, 1, pucInput, ulInputLength, pulConsumed, &usValue ) ) )
+                {
+                    pxDecoder->ucState = ( usValue != 0U ) ? heatshrinkSTATE_LITERAL : heatshrinkSTATE_DISTANCE;
+                }
+
+                break;
+
+            case heatshrinkSTATE_LITERAL:
+
+                if( ( xMoreInput = prvReadBits( pxDecoder, 8, pucInput, ulInputLength, pulConsumed, &usValue ) ) )
+                {
+                    prvEmit( pxDecoder, ( uint8_t ) usValue, pucOutput, pulProduced );
+                    pxDecoder->ucState = heatshrinkSTATE_TAG;
+                }
+
+                break;
+
+            case heatshrinkSTATE_DISTANCE:
+
+                if( ( xMoreInput = prvReadBits( pxDecoder, pxDecoder->ucWindowBits, pucInput, ulInputLength, pulConsumed, &usValue ) ) )
+                {
+                    pxDecoder->usDistance = ( uint16_t ) ( usValue + 1U );
+                    pxDecoder->ucState = heatshrinkSTATE_LENGTH;
+                }
+
+                break;
+
+            case heatshrinkSTATE_LENGTH:
+
+                if( ( xMoreInput = prvReadBits( pxDecoder, pxDecoder->ucLookaheadBits, pucInput, ulInputLength, pulConsumed, &usValue ) ) )
+                {
+                    pxDecoder->usCopyLength = ( uint16_t ) ( usValue + 1U );
+                    pxDecoder->ucState = heatshrinkSTATE_COPY;
+                }
+
+                break;
+
+            default:
+
+                /* A reference can overlap the bytes it produces. */
+                while( ( pxDecoder->usCopyLength > 0U ) && ( *pulProduced < ulOutputSize ) )
+                {
+                    prvEmit( pxDecoder, pxDecoder->ucWindow[ ( pxDecoder->ulHead - pxDecoder->usDistance ) & ulMask ],
+                             pucOutput, pulProduced );
+                    pxDecoder->usCopyLength--;
+                }
+
+                if( pxDecoder->usCopyLength == 0U )
+                {
+                    pxDecoder->ucState = heatshrinkSTATE_TAG;
+                }
+
+                break;
+        }
+    }
+
+    return eHeatshrinkSuccess;
+}
+/*-----------------------------------------------------------*/
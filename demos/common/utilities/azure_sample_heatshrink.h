@@ -0,0 +1,94 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_heatshrink.h
+ * @brief Streaming decoder of the heatshrink LZSS format.
+ *
+ * The stream is a sequence of bits, most significant first. A 1 bit is
+ * followed by a literal byte. A 0 bit is followed by a back-reference: the
+ * distance minus one on window bits, then the length minus one on lookahead
+ * bits, copied from the bytes already decoded. The decoder keeps the last
+ * 2^window bytes decoded, so its memory is fixed by
+ * #heatshrinkMAX_WINDOW_BITS whatever the size of the data.
+ *
+ * Streams produced by the heatshrink tool, "heatshrink -e -w <window> -l
+ * <lookahead>", are decoded with the same window and lookahead.
+ */
+
+#ifndef AZURE_SAMPLE_HEATSHRINK_H
+#define AZURE_SAMPLE_HEATSHRINK_H
+
+#include <stdint.h>
+
+/**
+ * @brief Largest window, in bits, of the streams which can be decoded. The
+ * decoder holds 2^heatshrinkMAX_WINDOW_BITS bytes.
+ */
+#ifndef heatshrinkMAX_WINDOW_BITS
+    #define heatshrinkMAX_WINDOW_BITS    ( 11U )
+#endif
+
+/**
+ * @brief Heatshrink return status.
+ */
+typedef enum HeatshrinkResult
+{
+    eHeatshrinkSuccess = 0,     /**< Function successfully completed. */
+    eHeatshrinkInvalidParameter /**< At least one parameter was invalid. */
+} HeatshrinkResult_t;
+
+/**
+ * @brief State of a decoder. Its fields are private.
+ */
+typedef struct HeatshrinkDecoder
+{
+    uint8_t ucWindowBits;
+    uint8_t ucLookaheadBits;
+    uint8_t ucState;
+    uint8_t ucInputByte;     /**< Byte the next bits are read from. */
+    uint8_t ucInputMask;     /**< Next bit of the input byte, 0 once it is read. */
+    uint8_t ucBitsRead;      /**< Bits of the field being read. */
+    uint16_t usBits;         /**< Value of the field being read. */
+    uint16_t usDistance;     /**< Distance of the back-reference. */
+    uint16_t usCopyLength;   /**< Bytes of the back-reference left to copy. */
+    uint32_t ulHead;         /**< Bytes decoded. */
+    uint8_t ucWindow[ 1U << heatshrinkMAX_WINDOW_BITS ];
+} HeatshrinkDecoder_t;
+
+/**
+ * @brief Initialize a decoder.
+ *
+ * @param[out] pxDecoder The decoder.
+ * @param[in] ucWindowBits Window of the stream, from 4 to #heatshrinkMAX_WINDOW_BITS.
+ * @param[in] ucLookaheadBits Lookahead of the stream, from 3 to ucWindowBits - 1.
+ * @return eHeatshrinkSuccess, or eHeatshrinkInvalidParameter.
+ */
+HeatshrinkResult_t Heatshrink_Init( HeatshrinkDecoder_t * pxDecoder,
+                                    uint8_t ucWindowBits,
+                                    uint8_t ucLookaheadBits );
+
+/**
+ * @brief Decode part of a stream.
+ *
+ * Decodes until the input is consumed or the output is full. A field cut by
+ * the end of the input is completed by the next call.
+ *
+ * @param[in] pxDecoder The decoder.
+ * @param[in] pucInput Next bytes of the stream.
+ * @param[in] ulInputLength Length of the input.
+ * @param[out] pulConsumed Bytes of the input consumed.
+ * @param[out] pucOutput Buffer for the decoded bytes.
+ * @param[in] ulOutputSize Size of the output buffer.
+ * @param[out] pulProduced Bytes decoded into the output.
+ * @return eHeatshrinkSuccess, or eHeatshrinkInvalidParameter.
+ */
+HeatshrinkResult_t Heatshrink_Decode( HeatshrinkDecoder_t * pxDecoder,
+                                      const uint8_t * pucInput,
+                                      uint32_t ulInputLength,
+                                      uint32_t * pulConsumed,
+                                      uint8_t * pucOutput,
+                                      uint32_t ulOutputSize,
+                                      uint32_t * pulProduced );
+
+#endif /* AZURE_SAMPLE_HEATSHRINK_H */
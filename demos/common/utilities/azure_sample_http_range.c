@@ -0,0 +1,522 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_http_range.c
+ * @brief Implements the HTTP/1.1 range download of azure_sample_http_range.h.
+ *
+ * Responses arrive in the order of the requests. The headers are received
+ * into the header buffer, which may then also hold the start of the body and,
+ * for small chunks, the start of the next response. What belongs to the body
+ * is moved to the chunk buffer and the rest is kept for the next read. The
+ * rest of the body is received straight into the chunk buffer.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "azure_sample_http_range.h"
+
+/*-----------------------------------------------------------*/
+
+#define httprangeREQUEST_FORMAT            \
+    "GET %.*s HTTP/1.1\r\n"                \
+    "Host: %.*s\r\n"                       \
+    "Range: bytes=%lu-%lu\r\n"             \
+    "Connection: keep-alive\r\n"           \
+    "\r\n"
+
+#define httprangeHEADER_END                "\r\n\r\n"
+#define httprangeSTATUS_PARTIAL_CONTENT    ( 206U )
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvMin( uint32_t ulA,
+                        uint32_t ulB )
+{
+    return ( ulA < ulB ) ? ulA : ulB;
+}
+/*-----------------------------------------------------------*/
+
+static bool prvStartsWithIgnoreCase( const char * pcText,
+                                     uint32_t ulTextLength,
+                                     const char * pcPrefix )
+{
+    uint32_t ulIndex;
+    char cText;
+    char cPrefix;
+
+    for( ulIndex = 0; pcPrefix[ ulIndex ] != '\0'; ulIndex++ )
+    {
+        if( ulIndex >= ulTextLength )
+        {
+            return false;
+        }
+
+        cText = pcText[ ulIndex ];
+        cPrefix = pcPrefix[ ulIndex ];
+
+        if( ( cText >= 'A' ) && ( cText <= 'Z' ) )
+        {
+            cText = ( char ) ( cText - 'A' + 'a' );
+        }
+
+        if( ( cPrefix >= 'A' ) && ( cPrefix <= 'Z' ) )
+        {
+            cPrefix = ( char ) ( cPrefix - 'A' + 'a' );
+        }
+
+        if( cText != cPrefix )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+/*-----------------------------------------------------------*/
+
+/* Index of the word in the text, or the text length if it is not found. */
+static uint32_t prvFindIgnoreCase( const char * pcText,
+                                   uint32_t ulTextLength,
+                                   const char * pcWord )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulTextLength; ulIndex++ )
+    {
+        if( prvStartsWithIgnoreCase( &pcText[ ulIndex ], ulTextLength - ulIndex, pcWord ) )
+        {
+            break;
+        }
+    }
+
+    return ulIndex;
+}
+/*-----------------------------------------------------------*/
+
+/* Parses the decimal number at the start of the text, after any spaces. */
+static bool prvParseNumber( const char * pcText,
+                            uint32_t ulTextLength,
+                            uint32_t * pulValue,
+                            uint32_t * pulParsedLength )
+{
+    uint32_t ulIndex = 0;
+    uint32_t ulDigits = 0;
+    uint64_t ullValue = 0;
+
+    while( ( ulIndex < ulTextLength ) && ( pcText[ ulIndex ] == ' ' ) )
+    {
+        ulIndex++;
+    }
+
+    while( ( ulIndex < ulTextLength ) && ( pcText[ ulIndex ] >= '0' ) && ( pcText[ ulIndex ] <= '9' ) )
+    {
+        ullValue = ( ullValue * 10U ) + ( uint64_t ) ( pcText[ ulIndex ] - '0' );
+
+        if( ullValue > UINT32_MAX )
+        {
+            return false;
+        }
+
+        ulIndex++;
+        ulDigits++;
+    }
+
+    *pulValue = ( uint32_t ) ullValue;
+    *pulParsedLength = ulIndex;
+
+    return ulDigits > 0U;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvFormatRequest( HTTPRangeClient_t * pxClient,
+                                 uint32_t ulStart,
+                                 uint32_t ulEnd )
+{
+    return ( int32_t ) snprintf( pxClient->cRequest, sizeof( pxClient->cRequest ), httprangeREQUEST_FORMAT,
+                                 ( int ) pxClient->ulPathLength, pxClient->pcPath,
+                                 ( int ) pxClient->ulHostLength, pxClient->pcHost,
+                                 ( unsigned long ) ulStart, ( unsigned long ) ulEnd );
+}
+/*-----------------------------------------------------------*/
+
+static HTTPRangeResult_t prvSendAll( HTTPRangeClient_t * pxClient,
+                                     const char * pcData,
+                                     uint32_t ulLength )
+{
+    int32_t lSent;
+
+    while( ulLength > 0U )
+    {
+        lSent = pxClient->pxTransport->xSend( pxClient->pxTransport->pxNetworkContext, pcData, ulLength );
+
+        if( lSent <= 0 )
+        {
+            return eHTTPRangeNetworkError;
+        }
+
+        pcData += lSent;
+        ulLength -= ( uint32_t ) lSent;
+    }
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* Receives at least one byte, retrying on timeouts. */
+static HTTPRangeResult_t prvRecv( HTTPRangeClient_t * pxClient,
+                                  uint8_t * pucBuffer,
+                                  uint32_t ulLength,
+                                  uint32_t * pulReceived )
+{
+    int32_t lReceived = 0;
+    uint32_t ulRetries;
+
+    for( ulRetries = 0; ( lReceived == 0 ) && ( ulRetries < httprangeRECV_RETRIES ); ulRetries++ )
+    {
+        lReceived = pxClient->pxTransport->xRecv( pxClient->pxTransport->pxNetworkContext, pucBuffer, ulLength );
+    }
+
+    if( lReceived <= 0 )
+    {
+        return eHTTPRangeNetworkError;
+    }
+
+    *pulReceived = ( uint32_t ) lReceived;
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* Sends requests until the pipeline is full or the whole file is requested. */
+static HTTPRangeResult_t prvFillPipeline( HTTPRangeClient_t * pxClient )
+{
+    HTTPRangeResult_t xResult;
+    uint32_t ulEnd;
+    int32_t lLength;
+
+    while( ( pxClient->ulRequestsInFlight < pxClient->ulPipelineDepth ) &&
+           ( pxClient->ulNextRequestOffset < pxClient->ulFileSize ) )
+    {
+        ulEnd = pxClient->ulNextRequestOffset + prvMin( pxClient->ulChunkSize,
+                                                        pxClient->ulFileSize - pxClient->ulNextRequestOffset ) - 1U;
+
+        /* Init checked the longest request fits. */
+        lLength = prvFormatRequest( pxClient, pxClient->ulNextRequestOffset, ulEnd );
+
+        if( ( xResult = prvSendAll( pxClient, pxClient->cRequest, ( uint32_t ) lLength ) ) != eHTTPRangeSuccess )
+        {
+            return xResult;
+        }
+
+        pxClient->ulRequestTimesMs[ pxClient->ulRequestsInFlight ] = httprangeGET_TIME_MS();
+        pxClient->ulRequestLengths[ pxClient->ulRequestsInFlight ] = ulEnd + 1U - pxClient->ulNextRequestOffset;
+        pxClient->ulRequestsInFlight++;
+        pxClient->ulNextRequestOffset = ulEnd + 1U;
+        pxClient->xStats.ulRequests++;
+    }
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* Receives into the header buffer until it holds the end of the headers. */
+static HTTPRangeResult_t prvReadHeaders( HTTPRangeClient_t * pxClient,
+                                         uint32_t * pulHeadersLength )
+{
+    HTTPRangeResult_t xResult;
+    uint32_t ulReceived;
+    uint32_t ulIndex;
+    const uint32_t ulEndLength = sizeof( httprangeHEADER_END ) - 1U;
+
+    for( ; ; )
+    {
+        for( ulIndex = 0; ( ulIndex + ulEndLength ) <= pxClient->ulHeaderBufferUsed; ulIndex++ )
+        {
+            if( memcmp( &pxClient->pucHeaderBuffer[ ulIndex ], httprangeHEADER_END, ulEndLength ) == 0 )
+            {
+                *pulHeadersLength = ulIndex + ulEndLength;
+                return eHTTPRangeSuccess;
+            }
+        }
+
+        if( pxClient->ulHeaderBufferUsed == pxClient->ulHeaderBufferSize )
+        {
+            return eHTTPRangeBufferTooSmall;
+        }
+
+        xResult = prvRecv( pxClient, &pxClient->pucHeaderBuffer[ pxClient->ulHeaderBufferUsed ],
+                           pxClient->ulHeaderBufferSize - pxClient->ulHeaderBufferUsed, &ulReceived );
+
+        if( xResult != eHTTPRangeSuccess )
+        {
+            return xResult;
+        }
+
+        pxClient->ulHeaderBufferUsed += ulReceived;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Checks the status and the range of the response, and finds its length. */
+static HTTPRangeResult_t prvParseHeaders( HTTPRangeClient_t * pxClient,
+                                          uint32_t ulHeadersLength,
+                                          uint32_t ulRangeLength,
+                                          uint32_t * pulContentLength )
+{
+    const char * pcLine = ( const char * ) pxClient->pucHeaderBuffer;
+    const char * pcHeadersEnd = pcLine + ulHeadersLength;
+    const char * pcLineEnd;
+    uint32_t ulLineLength;
+    uint32_t ulIndex;
+    uint32_t ulValue;
+    uint32_t ulParsed;
+    bool xHasLength = false;
+    bool xHasRange = false;
+
+    /* "HTTP/1.1 206 Partial Content" */
+    if( !prvStartsWithIgnoreCase( pcLine, ulHeadersLength, "HTTP/1." ) ||
+        !prvParseNumber( pcLine + 8, ulHeadersLength - 8U, &ulValue, &ulParsed ) ||
+        ( ulValue != httprangeSTATUS_PARTIAL_CONTENT ) )
+    {
+        return eHTTPRangeResponseError;
+    }
+
+    while( pcLine < pcHeadersEnd )
+    {
+        for( pcLineEnd = pcLine; ( pcLineEnd < pcHeadersEnd ) && ( *pcLineEnd != '\r' ); pcLineEnd++ )
+        {
+        }
+
+        ulLineLength = ( uint32_t ) ( pcLineEnd - pcLine );
+
+        if( prvStartsWithIgnoreCase( pcLine, ulLineLength, "Content-Length:" ) )
+        {
+            xHasLength = prvParseNumber( pcLine + 15, ulLineLength - 15U, pulContentLength, &ulParsed );
+        }
+        else if( prvStartsWithIgnoreCase( pcLine, ulLineLength, "Content-Range:" ) )
+        {
+            /* "Content-Range: bytes 0-4095/65536" */
+            ulIndex = prvFindIgnoreCase( pcLine, ulLineLength, "bytes" ) + 5U;
+            xHasRange = ( ulIndex <= ulLineLength ) &&
+                        prvParseNumber( pcLine + ulIndex, ulLineLength - ulIndex, &ulValue, &ulParsed ) &&
+                        ( ulValue == pxClient->ulNextResponseOffset );
+        }
+        else if( prvStartsWithIgnoreCase( pcLine, ulLineLength, "Connection:" ) )
+        {
+            if( prvFindIgnoreCase( pcLine, ulLineLength, "close" ) < ulLineLength )
+            {
+                pxClient->xServerClosing = true;
+                pxClient->xStats.ulServerCloses++;
+            }
+        }
+        else if( prvStartsWithIgnoreCase( pcLine, ulLineLength, "Transfer-Encoding:" ) )
+        {
+            return eHTTPRangeResponseError;
+        }
+
+        /* Skip "\r\n". */
+        pcLine = pcLineEnd + 2;
+    }
+
+    if( !xHasLength || !xHasRange ||
+        ( *pulContentLength != ulRangeLength ) )
+    {
+        return eHTTPRangeResponseError;
+    }
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* Removes the oldest request from the pipeline, and returns the length of its
+ * range. */
+static uint32_t prvRecordRoundTrip( HTTPRangeClient_t * pxClient )
+{
+    HTTPRangeStats_t * pxStats = &pxClient->xStats;
+    uint32_t ulRttMs = httprangeGET_TIME_MS() - pxClient->ulRequestTimesMs[ 0 ];
+    uint32_t ulRangeLength = pxClient->ulRequestLengths[ 0 ];
+
+    pxClient->ulRequestsInFlight--;
+    ( void ) memmove( &pxClient->ulRequestTimesMs[ 0 ], &pxClient->ulRequestTimesMs[ 1 ],
+                      pxClient->ulRequestsInFlight * sizeof( pxClient->ulRequestTimesMs[ 0 ] ) );
+    ( void ) memmove( &pxClient->ulRequestLengths[ 0 ], &pxClient->ulRequestLengths[ 1 ],
+                      pxClient->ulRequestsInFlight * sizeof( pxClient->ulRequestLengths[ 0 ] ) );
+
+    pxStats->ulLastRttMs = ulRttMs;
+    pxStats->ulMinRttMs = ( pxStats->ulResponses == 0U ) ? ulRttMs : prvMin( pxStats->ulMinRttMs, ulRttMs );
+    pxStats->ulMaxRttMs = ( ulRttMs > pxStats->ulMaxRttMs ) ? ulRttMs : pxStats->ulMaxRttMs;
+    pxStats->ulTotalRttMs += ulRttMs;
+    pxStats->ulResponses++;
+
+    return ulRangeLength;
+}
+/*-----------------------------------------------------------*/
+
+HTTPRangeResult_t HTTPRange_Init( HTTPRangeClient_t * pxClient,
+                                  AzureIoTTransportInterface_t * pxTransport,
+                                  const char * pcHost,
+                                  uint32_t ulHostLength,
+                                  const char * pcPath,
+                                  uint32_t ulPathLength,
+                                  uint8_t * pucHeaderBuffer,
+                                  uint32_t ulHeaderBufferSize,
+                                  uint32_t ulFileSize,
+                                  uint32_t ulChunkSize,
+                                  uint32_t ulPipelineDepth )
+{
+    int32_t lLength;
+
+    if( ( pxClient == NULL ) || ( pxTransport == NULL ) ||
+        ( pcHost == NULL ) || ( pcPath == NULL ) ||
+        ( pucHeaderBuffer == NULL ) || ( ulHeaderBufferSize == 0U ) || ( ulChunkSize == 0U ) ||
+        ( ulPipelineDepth == 0U ) || ( ulPipelineDepth > httprangeMAX_PIPELINE_DEPTH ) )
+    {
+        return eHTTPRangeInvalidParameter;
+    }
+
+    ( void ) memset( pxClient, 0, sizeof( *pxClient ) );
+    pxClient->pxTransport = pxTransport;
+    pxClient->pcHost = pcHost;
+    pxClient->ulHostLength = ulHostLength;
+    pxClient->pcPath = pcPath;
+    pxClient->ulPathLength = ulPathLength;
+    pxClient->pucHeaderBuffer = pucHeaderBuffer;
+    pxClient->ulHeaderBufferSize = ulHeaderBufferSize;
+    pxClient->ulFileSize = ulFileSize;
+    pxClient->ulChunkSize = ulChunkSize;
+    pxClient->ulPipelineDepth = ulPipelineDepth;
+    pxClient->xStats.ulConnections = 1;
+
+    /* The request with the longest range must fit. */
+    lLength = prvFormatRequest( pxClient, UINT32_MAX, UINT32_MAX );
+
+    if( ( lLength < 0 ) || ( ( uint32_t ) lLength >= sizeof( pxClient->cRequest ) ) )
+    {
+        return eHTTPRangeInvalidParameter;
+    }
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+void HTTPRange_Reset( HTTPRangeClient_t * pxClient )
+{
+    pxClient->ulNextRequestOffset = pxClient->ulNextResponseOffset;
+    pxClient->ulRequestsInFlight = 0;
+    pxClient->ulHeaderBufferUsed = 0;
+    pxClient->xServerClosing = false;
+    pxClient->xStats.ulConnections++;
+}
+/*-----------------------------------------------------------*/
+
+HTTPRangeResult_t HTTPRange_Seek( HTTPRangeClient_t * pxClient,
+                                  uint32_t ulOffset )
+{
+    if( ( pxClient == NULL ) || ( pxClient->ulRequestsInFlight != 0U ) || ( ulOffset > pxClient->ulFileSize ) )
+    {
+        return eHTTPRangeInvalidParameter;
+    }
+
+    pxClient->ulNextRequestOffset = ulOffset;
+    pxClient->ulNextResponseOffset = ulOffset;
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+HTTPRangeResult_t HTTPRange_SetChunkSize( HTTPRangeClient_t * pxClient,
+                                          uint32_t ulChunkSize )
+{
+    if( ( pxClient == NULL ) || ( ulChunkSize == 0U ) )
+    {
+        return eHTTPRangeInvalidParameter;
+    }
+
+    pxClient->ulChunkSize = ulChunkSize;
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+HTTPRangeResult_t HTTPRange_ReadChunk( HTTPRangeClient_t * pxClient,
+                                       uint8_t * pucBuffer,
+                                       uint32_t ulBufferSize,
+                                       uint32_t * pulOffset,
+                                       uint32_t * pulLength )
+{
+    HTTPRangeResult_t xResult;
+    uint32_t ulHeadersLength;
+    uint32_t ulContentLength;
+    uint32_t ulRangeLength;
+    uint32_t ulBodyLength;
+    uint32_t ulReceived;
+
+    if( ( pxClient == NULL ) || ( pucBuffer == NULL ) || ( pulOffset == NULL ) || ( pulLength == NULL ) )
+    {
+        return eHTTPRangeInvalidParameter;
+    }
+
+    if( pxClient->ulNextResponseOffset >= pxClient->ulFileSize )
+    {
+        return eHTTPRangeComplete;
+    }
+
+    /* The requests sent after the one answered with "Connection: close" are
+     * lost, they are sent again on the next connection. */
+    if( pxClient->xServerClosing )
+    {
+        return eHTTPRangeConnectionClosed;
+    }
+
+    if( ( ( xResult = prvFillPipeline( pxClient ) ) != eHTTPRangeSuccess ) ||
+        ( ( xResult = prvReadHeaders( pxClient, &ulHeadersLength ) ) != eHTTPRangeSuccess ) )
+    {
+        return xResult;
+    }
+
+    ulRangeLength = prvRecordRoundTrip( pxClient );
+
+    if( ( xResult = prvParseHeaders( pxClient, ulHeadersLength, ulRangeLength, &ulContentLength ) ) != eHTTPRangeSuccess )
+    {
+        return xResult;
+    }
+
+    if( ulContentLength > ulBufferSize )
+    {
+        return eHTTPRangeBufferTooSmall;
+    }
+
+    /* Move the start of the body out of the header buffer, and what follows
+     * it to the front of the header buffer. */
+    ulBodyLength = prvMin( pxClient->ulHeaderBufferUsed - ulHeadersLength, ulContentLength );
+    ( void ) memcpy( pucBuffer, &pxClient->pucHeaderBuffer[ ulHeadersLength ], ulBodyLength );
+    pxClient->ulHeaderBufferUsed -= ulHeadersLength + ulBodyLength;
+    ( void ) memmove( pxClient->pucHeaderBuffer, &pxClient->pucHeaderBuffer[ ulHeadersLength + ulBodyLength ],
+                      pxClient->ulHeaderBufferUsed );
+
+    while( ulBodyLength < ulContentLength )
+    {
+        if( ( xResult = prvRecv( pxClient, &pucBuffer[ ulBodyLength ], ulContentLength - ulBodyLength,
+                                 &ulReceived ) ) != eHTTPRangeSuccess )
+        {
+            return xResult;
+        }
+
+        ulBodyLength += ulReceived;
+    }
+
+    *pulOffset = pxClient->ulNextResponseOffset;
+    *pulLength = ulContentLength;
+    pxClient->ulNextResponseOffset += ulContentLength;
+
+    return eHTTPRangeSuccess;
+}
+/*-----------------------------------------------------------*/
+
+const HTTPRangeStats_t * HTTPRange_GetStats( const HTTPRangeClient_t * pxClient )
+{
+    return &pxClient->xStats;
+}
+/*-----------------------------------------------------------*/
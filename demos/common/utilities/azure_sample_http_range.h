@@ -0,0 +1,204 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_http_range.h
+ * @brief HTTP/1.1 range download over a single keep-alive connection.
+ *
+ * The file is requested in chunks with range requests, and up to a configured
+ * number of requests are sent ahead of the response being read, so the server
+ * never waits for the next request. The chunk size can change during the
+ * download. When a response
+ * carries "Connection: close", or the connection fails, the requests that
+ * were not answered are sent again once the caller has reconnected.
+ *
+ * Responses must have a Content-Length, chunked transfer encoding is not
+ * supported.
+ */
+
+#ifndef AZURE_SAMPLE_HTTP_RANGE_H
+#define AZURE_SAMPLE_HTTP_RANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Transport interface. */
+#include "azure_iot_transport_interface.h"
+
+/**
+ * @brief Maximum number of requests in flight on the connection.
+ */
+#ifndef httprangeMAX_PIPELINE_DEPTH
+    #define httprangeMAX_PIPELINE_DEPTH    ( 4U )
+#endif
+
+/**
+ * @brief Size of the buffer a request is formatted into, it bounds the
+ * length of the host and the path.
+ */
+#ifndef httprangeREQUEST_BUFFER_SIZE
+    #define httprangeREQUEST_BUFFER_SIZE    ( 512U )
+#endif
+
+/**
+ * @brief Number of consecutive receive timeouts after which the connection is
+ * considered lost.
+ */
+#ifndef httprangeRECV_RETRIES
+    #define httprangeRECV_RETRIES    ( 3U )
+#endif
+
+/**
+ * @brief Time in milliseconds used to measure the round trips, the tick count
+ * by default.
+ */
+#ifndef httprangeGET_TIME_MS
+    #define httprangeGET_TIME_MS()    ( ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ) )
+#endif
+
+/**
+ * @brief Range download return status.
+ */
+typedef enum HTTPRangeResult
+{
+    eHTTPRangeSuccess = 0,       /**< Function successfully completed. */
+    eHTTPRangeInvalidParameter,  /**< At least one parameter was invalid. */
+    eHTTPRangeConnectionClosed,  /**< The server closed the connection, reconnect and call HTTPRange_Reset(). */
+    eHTTPRangeNetworkError,      /**< A send or a receive failed, reconnect and call HTTPRange_Reset(). */
+    eHTTPRangeBufferTooSmall,    /**< The headers or the body of a response do not fit in their buffer. */
+    eHTTPRangeResponseError,     /**< The response is malformed, not a 206 or not the range requested. */
+    eHTTPRangeComplete           /**< The whole file has been read. */
+} HTTPRangeResult_t;
+
+/**
+ * @brief Counters of a download.
+ */
+typedef struct HTTPRangeStats
+{
+    uint32_t ulRequests;     /**< Range requests sent, including the ones sent again. */
+    uint32_t ulResponses;    /**< Responses read. */
+    uint32_t ulConnections;  /**< Connections used, one plus the reconnections. */
+    uint32_t ulServerCloses; /**< Responses with "Connection: close". */
+    uint32_t ulLastRttMs;    /**< Time from the last request to its response headers. */
+    uint32_t ulMinRttMs;
+    uint32_t ulMaxRttMs;
+    uint32_t ulTotalRttMs;   /**< Sum of the round trips, divide by ulResponses for the mean. */
+} HTTPRangeStats_t;
+
+/**
+ * @brief State of a download. Its fields are private.
+ */
+typedef struct HTTPRangeClient
+{
+    AzureIoTTransportInterface_t * pxTransport;
+    const char * pcHost;
+    uint32_t ulHostLength;
+    const char * pcPath;
+    uint32_t ulPathLength;
+    uint8_t * pucHeaderBuffer;
+    uint32_t ulHeaderBufferSize;
+    uint32_t ulHeaderBufferUsed;                           /**< Bytes received past the last response. */
+    uint32_t ulChunkSize;
+    uint32_t ulPipelineDepth;
+    uint32_t ulFileSize;
+    uint32_t ulNextRequestOffset;                          /**< Start of the next range to request. */
+    uint32_t ulNextResponseOffset;                         /**< Start of the range of the next response. */
+    uint32_t ulRequestTimesMs[ httprangeMAX_PIPELINE_DEPTH ]; /**< Send times of the requests in flight, oldest first. */
+    uint32_t ulRequestLengths[ httprangeMAX_PIPELINE_DEPTH ]; /**< Lengths of the ranges in flight, oldest first. */
+    uint32_t ulRequestsInFlight;
+    bool xServerClosing;                                   /**< The server announced it closes the connection. */
+    char cRequest[ httprangeREQUEST_BUFFER_SIZE ];
+    HTTPRangeStats_t xStats;
+} HTTPRangeClient_t;
+
+/**
+ * @brief Initialize a download.
+ *
+ * @param[out] pxClient The download.
+ * @param[in] pxTransport Transport of a connected socket to the host.
+ * @param[in] pcHost Host of the file, must stay valid during the download.
+ * @param[in] ulHostLength Length of the host.
+ * @param[in] pcPath Path of the file, must stay valid during the download.
+ * @param[in] ulPathLength Length of the path.
+ * @param[in] pucHeaderBuffer Buffer for the headers of the responses.
+ * @param[in] ulHeaderBufferSize Size of the header buffer.
+ * @param[in] ulFileSize Size of the file.
+ * @param[in] ulChunkSize Size of the ranges requested.
+ * @param[in] ulPipelineDepth Number of requests in flight, from 1 to #httprangeMAX_PIPELINE_DEPTH.
+ * @return eHTTPRangeSuccess, or eHTTPRangeInvalidParameter.
+ */
+HTTPRangeResult_t HTTPRange_Init( HTTPRangeClient_t * pxClient,
+                                  AzureIoTTransportInterface_t * pxTransport,
+                                  const char * pcHost,
+                                  uint32_t ulHostLength,
+                                  const char * pcPath,
+                                  uint32_t ulPathLength,
+                                  uint8_t * pucHeaderBuffer,
+                                  uint32_t ulHeaderBufferSize,
+                                  uint32_t ulFileSize,
+                                  uint32_t ulChunkSize,
+                                  uint32_t ulPipelineDepth );
+
+/**
+ * @brief Restart the download on a new connection, from the first range not
+ * read yet.
+ *
+ * @param[in] pxClient The download.
+ */
+void HTTPRange_Reset( HTTPRangeClient_t * pxClient );
+
+/**
+ * @brief Start the download at an offset, to resume it. Only valid when no
+ * request is in flight, after HTTPRange_Init() or HTTPRange_Reset().
+ *
+ * @param[in] pxClient The download.
+ * @param[in] ulOffset Offset of the first chunk.
+ * @return eHTTPRangeSuccess, or eHTTPRangeInvalidParameter.
+ */
+HTTPRangeResult_t HTTPRange_Seek( HTTPRangeClient_t * pxClient,
+                                  uint32_t ulOffset );
+
+/**
+ * @brief Change the size of the ranges requested. The requests already in
+ * flight keep their size.
+ *
+ * @param[in] pxClient The download.
+ * @param[in] ulChunkSize Size of the next ranges.
+ * @return eHTTPRangeSuccess, or eHTTPRangeInvalidParameter.
+ */
+HTTPRangeResult_t HTTPRange_SetChunkSize( HTTPRangeClient_t * pxClient,
+                                          uint32_t ulChunkSize );
+
+/**
+ * @brief Read the next chunk of the file.
+ *
+ * Sends the requests needed to keep the pipeline full, then reads the body of
+ * the oldest response into the buffer.
+ *
+ * @param[in] pxClient The download.
+ * @param[out] pucBuffer Buffer for the chunk, of at least the chunk size.
+ * @param[in] ulBufferSize Size of the buffer.
+ * @param[out] pulOffset Offset of the chunk in the file.
+ * @param[out] pulLength Length of the chunk.
+ * @return eHTTPRangeSuccess with a chunk, eHTTPRangeComplete at the end of the
+ * file, or an error.
+ */
+HTTPRangeResult_t HTTPRange_ReadChunk( HTTPRangeClient_t * pxClient,
+                                       uint8_t * pucBuffer,
+                                       uint32_t ulBufferSize,
+                                       uint32_t * pulOffset,
+                                       uint32_t * pulLength );
+
+/**
+ * @brief Counters of the download.
+ *
+ * @param[in] pxClient The download.
+ * @return The counters.
+ */
+const HTTPRangeStats_t * HTTPRange_GetStats( const HTTPRangeClient_t * pxClient );
+
+#endif /* AZURE_SAMPLE_HTTP_RANGE_H */
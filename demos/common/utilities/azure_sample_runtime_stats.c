@@ -0,0 +1,433 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_runtime_stats.c
+ * @brief Implements the runtime statistics of the device.
+ *
+ * The CPU shares are computed from the run time counters of the tasks, as the
+ * difference with the values of the previous snapshot or report so they do not
+ * suffer from the wrap around of the counters.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "azure_sample_runtime_stats.h"
+
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TRACE_FACILITY != 1 ) || ( configGENERATE_RUN_TIME_STATS != 1 )
+    #error "The runtime statistics need configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS set to 1"
+#endif
+
+/* The total run time is the wall clock time, shared by the idle tasks of
+ * every core. */
+#if defined( configNUMBER_OF_CORES )
+    #define runtimestatsNUM_CORES    ( configNUMBER_OF_CORES )
+#elif defined( portNUM_PROCESSORS )
+    #define runtimestatsNUM_CORES    ( portNUM_PROCESSORS )
+#else
+    #define runtimestatsNUM_CORES    ( 1 )
+#endif
+
+#ifdef configIDLE_TASK_NAME
+    #define runtimestatsIDLE_TASK_NAME    configIDLE_TASK_NAME
+#else
+    #define runtimestatsIDLE_TASK_NAME    "IDLE"
+#endif
+
+#define runtimestatsLENGTH( x )    ( sizeof( x ) - 1 )
+
+/*-----------------------------------------------------------*/
+
+/* Run time counter type, which became configurable in FreeRTOS 10.4.4. */
+#ifdef configRUN_TIME_COUNTER_TYPE
+    typedef configRUN_TIME_COUNTER_TYPE RuntimeStatsRunTime_t;
+#else
+    typedef uint32_t RuntimeStatsRunTime_t;
+#endif
+
+/**
+ * @brief Run time of a task at the time of the previous report.
+ */
+typedef struct RuntimeStatsTaskRunTime
+{
+    TaskHandle_t xHandle;
+    RuntimeStatsRunTime_t xRunTime;
+} RuntimeStatsTaskRunTime_t;
+
+/**
+ * @brief Integer property of the health JSON object.
+ */
+typedef struct RuntimeStatsProperty
+{
+    const char * pcName;
+    uint32_t ulNameLength;
+    uint32_t ulValue;
+} RuntimeStatsProperty_t;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t ulCounters[ eRuntimeStatsCounterMax ];
+static uint32_t ulHandshakes;
+static uint32_t ulLastHandshakeMs;
+static uint32_t ulMaxHandshakeMs;
+
+/* Filled by uxTaskGetSystemState(), shared by the snapshots and the reports. */
+static TaskStatus_t xTaskStatus[ runtimestatsMAX_TASKS ];
+
+static RuntimeStatsRunTime_t xHealthPreviousTotal;
+static RuntimeStatsRunTime_t xHealthPreviousIdle;
+
+static RuntimeStatsTaskRunTime_t xReportPrevious[ runtimestatsMAX_TASKS ];
+static UBaseType_t uxReportPreviousCount;
+static RuntimeStatsRunTime_t xReportPreviousTotal;
+
+static const char * const pcCounterNames[ eRuntimeStatsCounterMax ] =
+{
+    "i2cTransactions",
+    "i2cErrors",
+    "publishes",
+    "reconnects"
+};
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsIdleTask( const TaskStatus_t * pxStatus )
+{
+    return ( strncmp( pxStatus->pcTaskName, runtimestatsIDLE_TASK_NAME,
+                      runtimestatsLENGTH( runtimestatsIDLE_TASK_NAME ) ) == 0 ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+/* Share of xPart in xTotal, for every core, in permille. */
+static uint32_t prvPermille( RuntimeStatsRunTime_t xPart,
+                             RuntimeStatsRunTime_t xTotal )
+{
+    uint64_t ullTotal = ( uint64_t ) xTotal * runtimestatsNUM_CORES;
+    uint64_t ullPermille;
+
+    if( ullTotal == 0U )
+    {
+        return 0U;
+    }
+
+    ullPermille = ( ( uint64_t ) xPart * 1000U ) / ullTotal;
+
+    return ( ullPermille > 1000U ) ? 1000U : ( uint32_t ) ullPermille;
+}
+/*-----------------------------------------------------------*/
+
+static char prvStateToChar( eTaskState eState )
+{
+    switch( eState )
+    {
+        case eRunning:
+            return 'X';
+
+        case eReady:
+            return 'R';
+
+        case eBlocked:
+            return 'B';
+
+        case eSuspended:
+            return 'S';
+
+        case eDeleted:
+            return 'D';
+
+        default:
+            return '?';
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* Run time of a task at the previous report, 0 if it did not exist then. */
+static RuntimeStatsRunTime_t prvGetPreviousRunTime( TaskHandle_t xHandle )
+{
+    UBaseType_t uxIndex;
+
+    for( uxIndex = 0; uxIndex < uxReportPreviousCount; uxIndex++ )
+    {
+        if( xReportPrevious[ uxIndex ].xHandle == xHandle )
+        {
+            return xReportPrevious[ uxIndex ].xRunTime;
+        }
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+void RuntimeStats_Increment( RuntimeStatsCounter_t xCounter )
+{
+    configASSERT( xCounter < eRuntimeStatsCounterMax );
+
+    ( void ) __atomic_fetch_add( &ulCounters[ xCounter ], 1U, __ATOMIC_RELAXED );
+}
+/*-----------------------------------------------------------*/
+
+void RuntimeStats_SetCounter( RuntimeStatsCounter_t xCounter,
+                              uint32_t ulValue )
+{
+    configASSERT( xCounter < eRuntimeStatsCounterMax );
+
+    __atomic_store_n( &ulCounters[ xCounter ], ulValue, __ATOMIC_RELAXED );
+}
+/*-----------------------------------------------------------*/
+
+void RuntimeStats_RecordHandshake( uint32_t ulDurationMs )
+{
+    ( void ) __atomic_fetch_add( &ulHandshakes, 1U, __ATOMIC_RELAXED );
+    __atomic_store_n( &ulLastHandshakeMs, ulDurationMs, __ATOMIC_RELAXED );
+
+    if( ulDurationMs > __atomic_load_n( &ulMaxHandshakeMs, __ATOMIC_RELAXED ) )
+    {
+        __atomic_store_n( &ulMaxHandshakeMs, ulDurationMs, __ATOMIC_RELAXED );
+    }
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t RuntimeStats_TakeHealthSnapshot( RuntimeStatsHealth_t * pxHealth )
+{
+    RuntimeStatsRunTime_t xTotal = 0;
+    RuntimeStatsRunTime_t xIdle = 0;
+    UBaseType_t uxCount;
+    UBaseType_t uxIndex;
+    uint32_t ulCounter;
+    const TaskStatus_t * pxMinimumStack = NULL;
+
+    configASSERT( pxHealth != NULL );
+
+    uxCount = uxTaskGetSystemState( xTaskStatus, runtimestatsMAX_TASKS, &xTotal );
+
+    if( uxCount == 0U )
+    {
+        return pdFAIL;
+    }
+
+    for( uxIndex = 0; uxIndex < uxCount; uxIndex++ )
+    {
+        if( prvIsIdleTask( &xTaskStatus[ uxIndex ] ) == pdTRUE )
+        {
+            xIdle += xTaskStatus[ uxIndex ].ulRunTimeCounter;
+        }
+
+        if( ( pxMinimumStack == NULL ) ||
+            ( xTaskStatus[ uxIndex ].usStackHighWaterMark < pxMinimumStack->usStackHighWaterMark ) )
+        {
+            pxMinimumStack = &xTaskStatus[ uxIndex ];
+        }
+    }
+
+    pxHealth->ulUptimeSeconds = ( uint32_t ) ( xTaskGetTickCount() / configTICK_RATE_HZ );
+    pxHealth->ulCpuLoadPermille = 1000U - prvPermille( xIdle - xHealthPreviousIdle,
+                                                       xTotal - xHealthPreviousTotal );
+    pxHealth->ulFreeHeap = ( uint32_t ) xPortGetFreeHeapSize();
+    pxHealth->ulMinimumEverFreeHeap = ( uint32_t ) xPortGetMinimumEverFreeHeapSize();
+    pxHealth->ulMinimumStackHighWaterMark = ( uint32_t ) pxMinimumStack->usStackHighWaterMark;
+    ( void ) strncpy( pxHealth->cMinimumStackTaskName, pxMinimumStack->pcTaskName,
+                      sizeof( pxHealth->cMinimumStackTaskName ) - 1 );
+    pxHealth->cMinimumStackTaskName[ sizeof( pxHealth->cMinimumStackTaskName ) - 1 ] = '\0';
+
+    for( ulCounter = 0; ulCounter < eRuntimeStatsCounterMax; ulCounter++ )
+    {
+        pxHealth->ulCounters[ ulCounter ] = __atomic_load_n( &ulCounters[ ulCounter ], __ATOMIC_RELAXED );
+    }
+
+    pxHealth->ulHandshakes = __atomic_load_n( &ulHandshakes, __ATOMIC_RELAXED );
+    pxHealth->ulLastHandshakeMs = __atomic_load_n( &ulLastHandshakeMs, __ATOMIC_RELAXED );
+    pxHealth->ulMaxHandshakeMs = __atomic_load_n( &ulMaxHandshakeMs, __ATOMIC_RELAXED );
+
+    xHealthPreviousTotal = xTotal;
+    xHealthPreviousIdle = xIdle;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t RuntimeStats_AppendHealth( AzureIoTJSONWriter_t * pxWriter,
+                                            const RuntimeStatsHealth_t * pxHealth )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulIndex;
+    const RuntimeStatsProperty_t xProperties[] =
+    {
+        { "uptimeSecs",     runtimestatsLENGTH( "uptimeSecs" ),     pxHealth->ulUptimeSeconds             },
+        { "freeHeap",       runtimestatsLENGTH( "freeHeap" ),       pxHealth->ulFreeHeap                  },
+        { "minFreeHeap",    runtimestatsLENGTH( "minFreeHeap" ),    pxHealth->ulMinimumEverFreeHeap       },
+        { "minStack",       runtimestatsLENGTH( "minStack" ),       pxHealth->ulMinimumStackHighWaterMark },
+        { "handshakes",     runtimestatsLENGTH( "handshakes" ),     pxHealth->ulHandshakes                },
+        { "handshakeMs",    runtimestatsLENGTH( "handshakeMs" ),    pxHealth->ulLastHandshakeMs           },
+        { "maxHandshakeMs", runtimestatsLENGTH( "maxHandshakeMs" ), pxHealth->ulMaxHandshakeMs            }
+    };
+
+    xResult = AzureIoTJSONWriter_AppendPropertyWithDoubleValue( pxWriter,
+                                                                ( const uint8_t * ) "cpuLoad", runtimestatsLENGTH( "cpuLoad" ),
+                                                                ( double ) pxHealth->ulCpuLoadPermille / 10.0, 1 );
+
+    for( ulIndex = 0; ( xResult == eAzureIoTSuccess ) && ( ulIndex < sizeof( xProperties ) / sizeof( xProperties[ 0 ] ) ); ulIndex++ )
+    {
+        xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( pxWriter,
+                                                                   ( const uint8_t * ) xProperties[ ulIndex ].pcName,
+                                                                   xProperties[ ulIndex ].ulNameLength,
+                                                                   ( int32_t ) xProperties[ ulIndex ].ulValue );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendPropertyWithStringValue( pxWriter,
+                                                                    ( const uint8_t * ) "minStackTask", runtimestatsLENGTH( "minStackTask" ),
+                                                                    ( const uint8_t * ) pxHealth->cMinimumStackTaskName,
+                                                                    strlen( pxHealth->cMinimumStackTaskName ) );
+    }
+
+    for( ulIndex = 0; ( xResult == eAzureIoTSuccess ) && ( ulIndex < eRuntimeStatsCounterMax ); ulIndex++ )
+    {
+        xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( pxWriter,
+                                                                   ( const uint8_t * ) pcCounterNames[ ulIndex ],
+                                                                   strlen( pcCounterNames[ ulIndex ] ),
+                                                                   ( int32_t ) pxHealth->ulCounters[ ulIndex ] );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t RuntimeStats_CreateTaskReport( uint8_t * pucBuffer,
+                                        uint32_t ulBufferSize )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTJSONWriter_t xWriter;
+    RuntimeStatsRunTime_t xTotal = 0;
+    RuntimeStatsRunTime_t xElapsed;
+    UBaseType_t uxCount;
+    UBaseType_t uxIndex;
+    int32_t lBytesWritten;
+    char cState[ 2 ] = { 0 };
+
+    uxCount = uxTaskGetSystemState( xTaskStatus, runtimestatsMAX_TASKS, &xTotal );
+
+    if( uxCount == 0U )
+    {
+        return 0;
+    }
+
+    xElapsed = xTotal - xReportPreviousTotal;
+
+    xResult = AzureIoTJSONWriter_Init( &xWriter, pucBuffer, ulBufferSize );
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendBeginObject( &xWriter );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                   ( const uint8_t * ) "uptimeSecs", runtimestatsLENGTH( "uptimeSecs" ),
+                                                                   ( int32_t ) ( xTaskGetTickCount() / configTICK_RATE_HZ ) );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendPropertyName( &xWriter, ( const uint8_t * ) "tasks", runtimestatsLENGTH( "tasks" ) );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendBeginArray( &xWriter );
+    }
+
+    for( uxIndex = 0; ( xResult == eAzureIoTSuccess ) && ( uxIndex < uxCount ); uxIndex++ )
+    {
+        const TaskStatus_t * pxStatus = &xTaskStatus[ uxIndex ];
+        RuntimeStatsRunTime_t xRunTime = pxStatus->ulRunTimeCounter - prvGetPreviousRunTime( pxStatus->xHandle );
+
+        cState[ 0 ] = prvStateToChar( pxStatus->eCurrentState );
+
+        xResult = AzureIoTJSONWriter_AppendBeginObject( &xWriter );
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendPropertyWithStringValue( &xWriter,
+                                                                        ( const uint8_t * ) "name", runtimestatsLENGTH( "name" ),
+                                                                        ( const uint8_t * ) pxStatus->pcTaskName,
+                                                                        strlen( pxStatus->pcTaskName ) );
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                       ( const uint8_t * ) "prio", runtimestatsLENGTH( "prio" ),
+                                                                       ( int32_t ) pxStatus->uxCurrentPriority );
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendPropertyWithStringValue( &xWriter,
+                                                                        ( const uint8_t * ) "state", runtimestatsLENGTH( "state" ),
+                                                                        ( const uint8_t * ) cState, 1 );
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                       ( const uint8_t * ) "stack", runtimestatsLENGTH( "stack" ),
+                                                                       ( int32_t ) pxStatus->usStackHighWaterMark );
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendPropertyWithDoubleValue( &xWriter,
+                                                                        ( const uint8_t * ) "cpu", runtimestatsLENGTH( "cpu" ),
+                                                                        ( double ) prvPermille( xRunTime, xElapsed ) / 10.0, 1 );
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendEndObject( &xWriter );
+        }
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendEndArray( &xWriter );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTJSONWriter_AppendEndObject( &xWriter );
+    }
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        return 0;
+    }
+
+    lBytesWritten = AzureIoTJSONWriter_GetBytesUsed( &xWriter );
+
+    if( lBytesWritten <= 0 )
+    {
+        return 0;
+    }
+
+    /* The next report measures from here. */
+    for( uxIndex = 0; uxIndex < uxCount; uxIndex++ )
+    {
+        xReportPrevious[ uxIndex ].xHandle = xTaskStatus[ uxIndex ].xHandle;
+        xReportPrevious[ uxIndex ].xRunTime = xTaskStatus[ uxIndex ].ulRunTimeCounter;
+    }
+
+    uxReportPreviousCount = uxCount;
+    xReportPreviousTotal = xTotal;
+
+    return ( uint32_t ) lBytesWritten;
+}
+/*-----------------------------------------------------------*/
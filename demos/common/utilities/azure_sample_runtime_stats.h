@@ -0,0 +1,128 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_runtime_stats.h
+ * @brief Runtime statistics of the device: CPU load, heap and stack usage of
+ * the FreeRTOS tasks and counters of the sample operations.
+ *
+ * The counters can be updated from any task. The snapshot and report
+ * functions must be called from a single task, the one running the sample.
+ *
+ * @note Requires configUSE_TRACE_FACILITY and configGENERATE_RUN_TIME_STATS.
+ */
+
+#ifndef AZURE_SAMPLE_RUNTIME_STATS_H
+#define AZURE_SAMPLE_RUNTIME_STATS_H
+
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Azure JSON includes */
+#include "azure_iot_json_writer.h"
+
+/**
+ * @brief Maximum number of tasks in a report, the others are not listed.
+ */
+#ifndef runtimestatsMAX_TASKS
+    #define runtimestatsMAX_TASKS    ( 24U )
+#endif
+
+/**
+ * @brief Time in milliseconds used to measure durations, the tick count by
+ * default. Ports with a finer clock can override it.
+ */
+#ifndef runtimestatsGET_TIME_MS
+    #define runtimestatsGET_TIME_MS()    ( ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ) )
+#endif
+
+/**
+ * @brief Counted sample operations.
+ */
+typedef enum RuntimeStatsCounter
+{
+    eRuntimeStatsI2CTransactions = 0, /**< Transactions with the sensors. */
+    eRuntimeStatsI2CErrors,           /**< Failed transactions with the sensors. */
+    eRuntimeStatsPublishes,           /**< Telemetry messages and reported properties sent. */
+    eRuntimeStatsReconnects,          /**< Connections attempted after a failure or a disconnection. */
+    eRuntimeStatsCounterMax
+} RuntimeStatsCounter_t;
+
+/**
+ * @brief State of the device at the time of a snapshot.
+ */
+typedef struct RuntimeStatsHealth
+{
+    uint32_t ulUptimeSeconds;                               /**< Time since boot. */
+    uint32_t ulCpuLoadPermille;                             /**< Time not spent in the idle tasks since the previous snapshot. */
+    uint32_t ulFreeHeap;                                    /**< Free heap in bytes. */
+    uint32_t ulMinimumEverFreeHeap;                         /**< Lowest free heap since boot, in bytes. */
+    uint32_t ulMinimumStackHighWaterMark;                   /**< Lowest stack high water mark of the tasks. */
+    char cMinimumStackTaskName[ configMAX_TASK_NAME_LEN ];  /**< Task with the lowest stack high water mark. */
+    uint32_t ulCounters[ eRuntimeStatsCounterMax ];         /**< Values of the counters. */
+    uint32_t ulHandshakes;                                  /**< Successful TLS handshakes. */
+    uint32_t ulLastHandshakeMs;                             /**< Duration of the last TLS handshake. */
+    uint32_t ulMaxHandshakeMs;                              /**< Duration of the longest TLS handshake. */
+} RuntimeStatsHealth_t;
+
+/**
+ * @brief Increment a counter.
+ *
+ * @param[in] xCounter The counter to increment.
+ */
+void RuntimeStats_Increment( RuntimeStatsCounter_t xCounter );
+
+/**
+ * @brief Set a counter kept elsewhere, such as the transactions counted by a
+ * bus driver.
+ *
+ * @param[in] xCounter The counter to set.
+ * @param[in] ulValue The value of the counter.
+ */
+void RuntimeStats_SetCounter( RuntimeStatsCounter_t xCounter,
+                              uint32_t ulValue );
+
+/**
+ * @brief Record the duration of a successful TLS handshake.
+ *
+ * @param[in] ulDurationMs Duration of the handshake in milliseconds.
+ */
+void RuntimeStats_RecordHandshake( uint32_t ulDurationMs );
+
+/**
+ * @brief Take a snapshot of the state of the device.
+ *
+ * The CPU load is measured over the time elapsed since the previous snapshot,
+ * or since boot for the first one.
+ *
+ * @param[out] pxHealth The snapshot.
+ * @return pdPASS on success, pdFAIL if there are more than #runtimestatsMAX_TASKS tasks.
+ */
+BaseType_t RuntimeStats_TakeHealthSnapshot( RuntimeStatsHealth_t * pxHealth );
+
+/**
+ * @brief Append the properties of a snapshot to a JSON object.
+ *
+ * @param[in] pxWriter Writer positioned inside a JSON object.
+ * @param[in] pxHealth The snapshot.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t RuntimeStats_AppendHealth( AzureIoTJSONWriter_t * pxWriter,
+                                            const RuntimeStatsHealth_t * pxHealth );
+
+/**
+ * @brief Write the report of the tasks as a JSON object: for each task its
+ * name, priority, state, stack high water mark and share of CPU time since
+ * the previous report, or since boot for the first one.
+ *
+ * @param[out] pucBuffer Buffer to write the report into.
+ * @param[in] ulBufferSize Size of the buffer.
+ * @return Number of bytes written, 0 if the report does not fit.
+ */
+uint32_t RuntimeStats_CreateTaskReport( uint8_t * pucBuffer,
+                                        uint32_t ulBufferSize );
+
+#endif /* AZURE_SAMPLE_RUNTIME_STATS_H */
@@ -0,0 +1,27 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_trace_span.h
+ * @brief Spans of the samples, recorded by the trace export of the Linux
+ * port and empty elsewhere.
+ *
+ * A port records the spans by defining traceSAMPLE_SPAN_BEGIN and
+ * traceSAMPLE_SPAN_END in its FreeRTOSConfig.h, as the Linux port does in
+ * azure_sample_trace.h.
+ */
+
+#ifndef AZURE_SAMPLE_TRACE_SPAN_H
+#define AZURE_SAMPLE_TRACE_SPAN_H
+
+#include "FreeRTOS.h"
+
+#ifndef traceSAMPLE_SPAN_BEGIN
+    #define traceSAMPLE_SPAN_BEGIN( pcName )
+#endif
+
+#ifndef traceSAMPLE_SPAN_END
+    #define traceSAMPLE_SPAN_END( pcName )
+#endif
+
+#endif /* AZURE_SAMPLE_TRACE_SPAN_H */
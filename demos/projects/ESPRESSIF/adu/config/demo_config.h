@@ -225,6 +225,20 @@
 
 #define democonfigCHUNK_DOWNLOAD_SIZE        4096
 
+/* Persist the download progress, the chunk size is a multiple of the flash sector. */
+#define democonfigADU_RESUME_DOWNLOAD        1
+
+/* Accept payloads packed by the adu_compress tool of the Linux port. */
+#define democonfigADU_COMPRESSED_IMAGES      1
+
+/* Accept payloads created by the adu_delta tool of the Linux port against the
+ * running partition. */
+#define democonfigADU_DELTA_IMAGES           1
+
+/* Write the chunks of a raw image by whole flash sectors, erased ahead
+ * rather than with the whole partition before the download. */
+#define democonfigADU_COALESCE_WRITES        1
+
 #define democonfigADU_DEVICE_MANUFACTURER    "ESPRESSIF"
 #define democonfigADU_DEVICE_MODEL           "ESP32-Azure-IoT-Kit"
 #define democonfigADU_UPDATE_PROVIDER        "Contoso"
@@ -19,6 +19,9 @@
 #include "freertos/semphr.h"
 #include "nvs_flash.h"
 
+/* Crypto helper used by the samples. */
+#include "azure_sample_crypto.h"
+
 /* Azure Provisioning/IoT Hub library includes */
 #include "azure_iot_hub_client.h"
 #include "azure_iot_hub_client_properties.h"
@@ -321,6 +324,12 @@ void app_main( void )
     /*Allow other core to finish initialization */
     vTaskDelay( pdMS_TO_TICKS( 100 ) );
 
+    if( Crypto_Init() != 0 )
+    {
+        ESP_LOGE( TAG, "HMAC SHA256 self test failed" );
+        return;
+    }
+
     ( void ) prvConnectNetwork();
 
     prvInitializeTime();
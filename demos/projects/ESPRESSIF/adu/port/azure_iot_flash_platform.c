@@ -4,6 +4,9 @@
 #include <string.h>
 
 #include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_resume.h"
+#include "azure_iot_flash_platform_delta.h"
+#include "azure_iot_flash_platform_sector.h"
 
 #include "azure_iot_flash_platform_port.h"
 /* Logging */
@@ -11,15 +14,38 @@
 
 #include "azure/core/az_base64.h"
 
+#include "sdkconfig.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
+#include "nvs.h"
 #include "mbedtls/md.h"
 
-#define azureiotflashSHA_256_SIZE    32
+#define azureiotflashSHA_256_SIZE           32
+
+/* The program unit of the SPI flash. */
+#define azureiotflashPAGE_SIZE    256
+
+#define azureiotflashCHECKPOINT_NAMESPACE    "adu"
+#define azureiotflashCHECKPOINT_KEY          "checkpoint"
+
+/**
+ * @brief Set to 1 to read the partition back in VerifyImage and check it
+ * against the hash computed while the blocks were written.
+ */
+#ifndef azureiotflashVERIFY_READ_BACK
+    #ifdef CONFIG_AZURE_ADU_VERIFY_READ_BACK
+        #define azureiotflashVERIFY_READ_BACK    1
+    #else
+        #define azureiotflashVERIFY_READ_BACK    0
+    #endif
+#endif
 
 static uint8_t ucPartitionReadBuffer[ 32 ];
 static uint8_t ucDecodedManifestHash[ azureiotflashSHA_256_SIZE ];
 static uint8_t ucCalculatedHash[ azureiotflashSHA_256_SIZE ];
+#if ( azureiotflashVERIFY_READ_BACK == 1 )
+    static uint8_t ucReadBackHash[ azureiotflashSHA_256_SIZE ];
+#endif
 
 static AzureIoTResult_t prvBase64Decode( uint8_t * base64Encoded,
                                          size_t ulBase64EncodedLength,
@@ -44,6 +70,149 @@ static AzureIoTResult_t prvBase64Decode( uint8_t * base64Encoded,
     return eAzureIoTSuccess;
 }
 
+static void prvHashPartitionRegion( AzureADUImage_t * const pxAduImage,
+                                    mbedtls_md_context_t * pxContext,
+                                    uint32_t ulLength )
+{
+    esp_err_t espErr;
+    uint32_t ulReadSize;
+
+    for( size_t ulOffset = 0; ulOffset < ulLength; ulOffset += sizeof( ucPartitionReadBuffer ) )
+    {
+        ulReadSize = ulLength - ulOffset < sizeof( ucPartitionReadBuffer ) ? ulLength - ulOffset : sizeof( ucPartitionReadBuffer );
+
+        espErr = esp_partition_read_raw( pxAduImage->xUpdatePartition,
+                                         ulOffset,
+                                         ucPartitionReadBuffer,
+                                         ulReadSize );
+        ( void ) espErr;
+
+        mbedtls_md_update( pxContext, ( const unsigned char * ) ucPartitionReadBuffer, ulReadSize );
+    }
+}
+
+static void prvHashPartition( AzureADUImage_t * const pxAduImage,
+                              uint8_t * pucHash )
+{
+    mbedtls_md_context_t ctx;
+    mbedtls_md_type_t md_type = MBEDTLS_MD_SHA256;
+
+    mbedtls_md_init( &ctx );
+    mbedtls_md_setup( &ctx, mbedtls_md_info_from_type( md_type ), 0 );
+    mbedtls_md_starts( &ctx );
+
+    AZLogInfo( ( "Starting the mbedtls calculation: image size %u\r\n", ( uint16_t ) pxAduImage->ulImageFileSize ) );
+
+    prvHashPartitionRegion( pxAduImage, &ctx, pxAduImage->ulImageFileSize );
+
+    AZLogInfo( ( "mbedtls calculation completed\r\n" ) );
+
+    mbedtls_md_finish( &ctx, pucHash );
+    mbedtls_md_free( &ctx );
+}
+
+static AzureIoTResult_t prvStartHash( AzureADUImage_t * const pxAduImage )
+{
+    mbedtls_md_free( &pxAduImage->xSHA256Context );
+    mbedtls_md_init( &pxAduImage->xSHA256Context );
+
+    pxAduImage->ulHashedLength = 0;
+    pxAduImage->xHashInOrder = true;
+
+    if( ( mbedtls_md_setup( &pxAduImage->xSHA256Context, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 ) != 0 ) ||
+        ( mbedtls_md_starts( &pxAduImage->xSHA256Context ) != 0 ) )
+    {
+        AZLogError( ( "Unable to start the image hash" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/* Hash of the image written so far, the running hash carries on. */
+static AzureIoTResult_t prvGetWrittenHash( AzureADUImage_t * const pxAduImage,
+                                           uint8_t * pucHash )
+{
+    mbedtls_md_context_t ctx;
+    int ret;
+
+    mbedtls_md_init( &ctx );
+
+    ret = mbedtls_md_setup( &ctx, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 );
+
+    if( ret == 0 )
+    {
+        ret = mbedtls_md_clone( &ctx, &pxAduImage->xSHA256Context );
+    }
+
+    if( ret == 0 )
+    {
+        ret = mbedtls_md_finish( &ctx, pucHash );
+    }
+
+    mbedtls_md_free( &ctx );
+
+    return ( ret == 0 ) ? eAzureIoTSuccess : eAzureIoTErrorFailed;
+}
+
+static AzureIoTResult_t prvLoadCheckpoint( AzureADUCheckpoint_t * pxCheckpoint )
+{
+    nvs_handle_t xHandle;
+    size_t xLength = sizeof( *pxCheckpoint );
+    esp_err_t espErr;
+
+    if( nvs_open( azureiotflashCHECKPOINT_NAMESPACE, NVS_READONLY, &xHandle ) != ESP_OK )
+    {
+        return eAzureIoTErrorItemNotFound;
+    }
+
+    espErr = nvs_get_blob( xHandle, azureiotflashCHECKPOINT_KEY, pxCheckpoint, &xLength );
+    nvs_close( xHandle );
+
+    if( ( espErr != ESP_OK ) || ( xLength != sizeof( *pxCheckpoint ) ) ||
+        ( pxCheckpoint->ulMagic != azureiotflashCHECKPOINT_MAGIC ) )
+    {
+        return eAzureIoTErrorItemNotFound;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/* Erases the sectors of the partition up to ulEnd, rounded up to a sector. */
+static AzureIoTResult_t prvErase( AzureADUImage_t * const pxAduImage,
+                                  uint32_t ulEnd )
+{
+    uint32_t ulStart = pxAduImage->ulErasedLength;
+
+    ulEnd = ( ( ulEnd + SPI_FLASH_SEC_SIZE - 1 ) / SPI_FLASH_SEC_SIZE ) * SPI_FLASH_SEC_SIZE;
+
+    if( ulEnd <= ulStart )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    if( ( ulEnd > pxAduImage->xUpdatePartition->size ) ||
+        ( esp_partition_erase_range( pxAduImage->xUpdatePartition, ulStart, ulEnd - ulStart ) != ESP_OK ) )
+    {
+        AZLogError( ( "Unable to erase the partition up to offset %u", ( unsigned int ) ulEnd ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxAduImage->ulErasedLength = ulEnd;
+    pxAduImage->ulSectorEraseCount += ( ulEnd - ulStart ) / SPI_FLASH_SEC_SIZE;
+
+    return eAzureIoTSuccess;
+}
+
+static void prvResetCounters( AzureADUImage_t * const pxAduImage )
+{
+    pxAduImage->ulWriteCount = 0;
+    pxAduImage->ulUnalignedWriteCount = 0;
+    pxAduImage->ulPageProgramCount = 0;
+    pxAduImage->ulPartialPageProgramCount = 0;
+    pxAduImage->ulSectorEraseCount = 0;
+}
+
 AzureIoTResult_t AzureIoTPlatform_Init( AzureADUImage_t * const pxAduImage )
 {
     const esp_partition_t * pxCurrentPartition = esp_ota_get_running_partition();
@@ -66,7 +235,171 @@ AzureIoTResult_t AzureIoTPlatform_Init( AzureADUImage_t * const pxAduImage )
         return eAzureIoTErrorFailed;
     }
 
-    esp_partition_erase_range( pxAduImage->xUpdatePartition, 0, pxAduImage->xUpdatePartition->size );
+    /* The sectors are erased as the image reaches them, rather than the
+     * whole partition before the download starts. */
+    pxAduImage->ulErasedLength = 0;
+    prvResetCounters( pxAduImage );
+
+    /* The image is hashed as its blocks are written, so it does not have to
+     * be read back from the partition to be verified. */
+    return prvStartHash( pxAduImage );
+}
+
+AzureIoTResult_t AzureIoTPlatform_InitResumable( AzureADUImage_t * const pxAduImage,
+                                                 const uint8_t * pucUpdateId,
+                                                 uint32_t ulUpdateIdLength,
+                                                 const uint8_t * pucFileUrl,
+                                                 uint32_t ulFileUrlLength,
+                                                 uint32_t ulImageFileSize )
+{
+    AzureADUCheckpoint_t xCheckpoint;
+    const esp_partition_t * pxCurrentPartition;
+    const mbedtls_md_info_t * pxInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+    bool xResume;
+
+    mbedtls_md( pxInfo, pucUpdateId, ulUpdateIdLength, pxAduImage->ucUpdateIdHash );
+    mbedtls_md( pxInfo, pucFileUrl, ulFileUrlLength, pxAduImage->ucFileUrlHash );
+
+    xResume = ( prvLoadCheckpoint( &xCheckpoint ) == eAzureIoTSuccess ) &&
+              ( memcmp( xCheckpoint.ucUpdateIdHash, pxAduImage->ucUpdateIdHash, azureiotflashSHA_256_SIZE ) == 0 ) &&
+              ( memcmp( xCheckpoint.ucFileUrlHash, pxAduImage->ucFileUrlHash, azureiotflashSHA_256_SIZE ) == 0 ) &&
+              ( xCheckpoint.ulImageFileSize == ulImageFileSize ) &&
+              ( xCheckpoint.ulWrittenLength <= ulImageFileSize ) &&
+              ( ( xCheckpoint.ulWrittenLength % SPI_FLASH_SEC_SIZE ) == 0 );
+
+    if( xResume )
+    {
+        pxCurrentPartition = esp_ota_get_running_partition();
+        pxAduImage->xUpdatePartition = ( pxCurrentPartition != NULL ) ? esp_ota_get_next_update_partition( pxCurrentPartition ) : NULL;
+
+        /* The region written must still hold what was hashed. */
+        xResume = ( pxAduImage->xUpdatePartition != NULL ) &&
+                  ( xCheckpoint.ulWrittenLength <= pxAduImage->xUpdatePartition->size ) &&
+                  ( prvStartHash( pxAduImage ) == eAzureIoTSuccess );
+
+        if( xResume )
+        {
+            prvHashPartitionRegion( pxAduImage, &pxAduImage->xSHA256Context, xCheckpoint.ulWrittenLength );
+            pxAduImage->ulHashedLength = xCheckpoint.ulWrittenLength;
+
+            xResume = ( prvGetWrittenHash( pxAduImage, ucCalculatedHash ) == eAzureIoTSuccess ) &&
+                      ( memcmp( ucCalculatedHash, xCheckpoint.ucWrittenHash, azureiotflashSHA_256_SIZE ) == 0 );
+        }
+
+        if( !xResume )
+        {
+            AZLogWarn( ( "The partition does not match the checkpoint, restarting the download" ) );
+        }
+    }
+
+    if( !xResume )
+    {
+        ( void ) AzureIoTPlatform_ClearCheckpoint( pxAduImage );
+
+        if( AzureIoTPlatform_Init( pxAduImage ) != eAzureIoTSuccess )
+        {
+            return eAzureIoTErrorFailed;
+        }
+    }
+    else
+    {
+        AZLogInfo( ( "Resuming the download at offset %u", ( unsigned int ) xCheckpoint.ulWrittenLength ) );
+
+        /* Only the part of the partition past the checkpoint is erased, as
+         * the image reaches it. */
+        pxAduImage->ulErasedLength = xCheckpoint.ulWrittenLength;
+        prvResetCounters( pxAduImage );
+
+        pxAduImage->pucBufferToWrite = NULL;
+        pxAduImage->ulBytesToWriteLength = 0;
+        pxAduImage->ulCurrentOffset = xCheckpoint.ulWrittenLength;
+    }
+
+    pxAduImage->ulImageFileSize = ulImageFileSize;
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_SaveCheckpoint( AzureADUImage_t * const pxAduImage,
+                                                  uint32_t * pulSavedLength )
+{
+    AzureADUCheckpoint_t xCheckpoint;
+    nvs_handle_t xHandle;
+    esp_err_t espErr;
+
+    *pulSavedLength = 0;
+
+    if( !pxAduImage->xHashInOrder || ( ( pxAduImage->ulHashedLength % SPI_FLASH_SEC_SIZE ) != 0 ) )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    memset( &xCheckpoint, 0, sizeof( xCheckpoint ) );
+    xCheckpoint.ulMagic = azureiotflashCHECKPOINT_MAGIC;
+    memcpy( xCheckpoint.ucUpdateIdHash, pxAduImage->ucUpdateIdHash, azureiotflashSHA_256_SIZE );
+    memcpy( xCheckpoint.ucFileUrlHash, pxAduImage->ucFileUrlHash, azureiotflashSHA_256_SIZE );
+    xCheckpoint.ulImageFileSize = pxAduImage->ulImageFileSize;
+    xCheckpoint.ulWrittenLength = pxAduImage->ulHashedLength;
+
+    if( prvGetWrittenHash( pxAduImage, xCheckpoint.ucWrittenHash ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    if( nvs_open( azureiotflashCHECKPOINT_NAMESPACE, NVS_READWRITE, &xHandle ) != ESP_OK )
+    {
+        AZLogError( ( "nvs_open failed" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    /* NVS replaces the blob atomically. */
+    espErr = nvs_set_blob( xHandle, azureiotflashCHECKPOINT_KEY, &xCheckpoint, sizeof( xCheckpoint ) );
+
+    if( espErr == ESP_OK )
+    {
+        espErr = nvs_commit( xHandle );
+    }
+
+    nvs_close( xHandle );
+
+    if( espErr != ESP_OK )
+    {
+        AZLogError( ( "Unable to save the checkpoint: 0x%x", espErr ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    *pulSavedLength = xCheckpoint.ulWrittenLength;
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ClearCheckpoint( AzureADUImage_t * const pxAduImage )
+{
+    nvs_handle_t xHandle;
+    esp_err_t espErr;
+
+    ( void ) pxAduImage;
+
+    if( nvs_open( azureiotflashCHECKPOINT_NAMESPACE, NVS_READWRITE, &xHandle ) != ESP_OK )
+    {
+        AZLogError( ( "nvs_open failed" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    espErr = nvs_erase_key( xHandle, azureiotflashCHECKPOINT_KEY );
+
+    if( espErr == ESP_OK )
+    {
+        espErr = nvs_commit( xHandle );
+    }
+
+    nvs_close( xHandle );
+
+    if( ( espErr != ESP_OK ) && ( espErr != ESP_ERR_NVS_NOT_FOUND ) )
+    {
+        AZLogError( ( "Unable to remove the checkpoint: 0x%x", espErr ) );
+        return eAzureIoTErrorFailed;
+    }
 
     return eAzureIoTSuccess;
 }
@@ -98,8 +431,20 @@ AzureIoTResult_t AzureIoTPlatform_WriteBlock( AzureADUImage_t * const pxAduImage
                                               uint8_t * const pData,
                                               uint32_t ulBlockSize )
 {
+    uint32_t ulEnd = ulOffset + ulBlockSize;
+    uint32_t ulPage;
     int ret;
 
+    if( ulBlockSize == 0U )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    if( prvErase( pxAduImage, ulEnd ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
     ret = esp_partition_write( pxAduImage->xUpdatePartition, ulOffset, pData, ulBlockSize );
 
     if( ret != ESP_OK )
@@ -107,6 +452,90 @@ AzureIoTResult_t AzureIoTPlatform_WriteBlock( AzureADUImage_t * const pxAduImage
         return ret;
     }
 
+    pxAduImage->ulWriteCount++;
+
+    if( ( ( ulOffset % SPI_FLASH_SEC_SIZE ) != 0U ) || ( ( ulEnd % SPI_FLASH_SEC_SIZE ) != 0U ) )
+    {
+        pxAduImage->ulUnalignedWriteCount++;
+    }
+
+    for( ulPage = ulOffset / azureiotflashPAGE_SIZE; ulPage <= ( ulEnd - 1U ) / azureiotflashPAGE_SIZE; ulPage++ )
+    {
+        pxAduImage->ulPageProgramCount++;
+
+        if( ( ulOffset > ulPage * azureiotflashPAGE_SIZE ) || ( ulEnd < ( ulPage + 1U ) * azureiotflashPAGE_SIZE ) )
+        {
+            pxAduImage->ulPartialPageProgramCount++;
+        }
+    }
+
+    if( pxAduImage->xHashInOrder && ( ulOffset == pxAduImage->ulHashedLength ) )
+    {
+        mbedtls_md_update( &pxAduImage->xSHA256Context, ( const unsigned char * ) pData, ulBlockSize );
+        pxAduImage->ulHashedLength += ulBlockSize;
+    }
+    else if( pxAduImage->xHashInOrder )
+    {
+        AZLogWarn( ( "Block at offset %u written out of order, the image will be read back",
+                     ( unsigned int ) ulOffset ) );
+        pxAduImage->xHashInOrder = false;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+uint32_t AzureIoTPlatform_GetSectorSize( AzureADUImage_t * const pxAduImage )
+{
+    ( void ) pxAduImage;
+
+    return SPI_FLASH_SEC_SIZE;
+}
+
+AzureIoTResult_t AzureIoTPlatform_EraseSector( AzureADUImage_t * const pxAduImage,
+                                               uint32_t ulOffset )
+{
+    if( ( ulOffset % SPI_FLASH_SEC_SIZE ) != 0U )
+    {
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    /* The sectors below the erased length were erased or written by the
+     * update. */
+    return prvErase( pxAduImage, ulOffset + SPI_FLASH_SEC_SIZE );
+}
+
+void AzureIoTPlatform_GetFlashCounters( AzureADUImage_t * const pxAduImage,
+                                        AzureADUFlashCounters_t * pxCounters )
+{
+    pxCounters->ulWrites = pxAduImage->ulWriteCount;
+    pxCounters->ulUnalignedWrites = pxAduImage->ulUnalignedWriteCount;
+    pxCounters->ulPagePrograms = pxAduImage->ulPageProgramCount;
+    pxCounters->ulPartialPagePrograms = pxAduImage->ulPartialPageProgramCount;
+    pxCounters->ulSectorErases = pxAduImage->ulSectorEraseCount;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ReadRunningImage( AzureADUImage_t * const pxAduImage,
+                                                    uint32_t ulOffset,
+                                                    uint8_t * pucData,
+                                                    uint32_t ulLength )
+{
+    const esp_partition_t * pxCurrentPartition = esp_ota_get_running_partition();
+
+    ( void ) pxAduImage;
+
+    if( ( pxCurrentPartition == NULL ) || ( ulOffset > pxCurrentPartition->size ) ||
+        ( ulLength > pxCurrentPartition->size - ulOffset ) )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    /* Decrypted like the image was written, when the flash is encrypted. */
+    if( esp_partition_read( pxCurrentPartition, ulOffset, pucData, ulLength ) != ESP_OK )
+    {
+        AZLogError( ( "Unable to read the running partition at offset %u", ( unsigned int ) ulOffset ) );
+        return eAzureIoTErrorFailed;
+    }
+
     return eAzureIoTSuccess;
 }
 
@@ -115,10 +544,8 @@ AzureIoTResult_t AzureIoTPlatform_VerifyImage( AzureADUImage_t * const pxAduImag
                                                uint32_t ulSHA256HashLength )
 {
     int xResult;
-    esp_err_t espErr;
 
     uint32_t ulOutputSize;
-    uint32_t ulReadSize;
 
     AZLogInfo( ( "Base64 Encoded Hash from ADU: %.*s", ( int16_t ) ulSHA256HashLength, pucSHA256Hash ) );
     xResult = prvBase64Decode( pucSHA256Hash, ulSHA256HashLength, ucDecodedManifestHash, azureiotflashSHA_256_SIZE, ( size_t * ) &ulOutputSize );
@@ -129,32 +556,26 @@ AzureIoTResult_t AzureIoTPlatform_VerifyImage( AzureADUImage_t * const pxAduImag
         return eAzureIoTErrorFailed;
     }
 
-    mbedtls_md_context_t ctx;
-    mbedtls_md_type_t md_type = MBEDTLS_MD_SHA256;
-
-    mbedtls_md_init( &ctx );
-    mbedtls_md_setup( &ctx, mbedtls_md_info_from_type( md_type ), 0 );
-    mbedtls_md_starts( &ctx );
-
-    AZLogInfo( ( "Starting the mbedtls calculation: image size %u\r\n", ( uint16_t ) pxAduImage->ulImageFileSize ) );
-
-    for( size_t ulOffset = 0; ulOffset < pxAduImage->ulImageFileSize; ulOffset += sizeof( ucPartitionReadBuffer ) )
+    if( pxAduImage->xHashInOrder && ( pxAduImage->ulHashedLength == pxAduImage->ulImageFileSize ) )
     {
-        ulReadSize = pxAduImage->ulImageFileSize - ulOffset < sizeof( ucPartitionReadBuffer ) ? pxAduImage->ulImageFileSize - ulOffset : sizeof( ucPartitionReadBuffer );
+        mbedtls_md_finish( &pxAduImage->xSHA256Context, ucCalculatedHash );
 
-        espErr = esp_partition_read_raw( pxAduImage->xUpdatePartition,
-                                         ulOffset,
-                                         ucPartitionReadBuffer,
-                                         ulReadSize );
-        ( void ) espErr;
+        #if ( azureiotflashVERIFY_READ_BACK == 1 )
+            prvHashPartition( pxAduImage, ucReadBackHash );
 
-        mbedtls_md_update( &ctx, ( const unsigned char * ) ucPartitionReadBuffer, ulReadSize );
+            if( memcmp( ucReadBackHash, ucCalculatedHash, azureiotflashSHA_256_SIZE ) != 0 )
+            {
+                AZLogError( ( "The partition does not hold the blocks written\r\n" ) );
+                ( void ) memcpy( ucCalculatedHash, ucReadBackHash, azureiotflashSHA_256_SIZE );
+            }
+        #endif
+    }
+    else
+    {
+        prvHashPartition( pxAduImage, ucCalculatedHash );
     }
 
-    AZLogInfo( ( "mbedtls calculation completed\r\n" ) );
-
-    mbedtls_md_finish( &ctx, ucCalculatedHash );
-    mbedtls_md_free( &ctx );
+    mbedtls_md_free( &pxAduImage->xSHA256Context );
 
     if( memcmp( ucDecodedManifestHash, ucCalculatedHash, azureiotflashSHA_256_SIZE ) == 0 )
     {
@@ -11,8 +11,11 @@
 #ifndef AZURE_IOT_FLASH_PLATFORM_PORT_H
 #define AZURE_IOT_FLASH_PLATFORM_PORT_H
 
+#include <stdbool.h>
+
 #include "esp_partition.h"
 #include "esp_spi_flash.h"
+#include "mbedtls/md.h"
 
 typedef struct AzureADUImageContext
 {
@@ -21,6 +24,17 @@ typedef struct AzureADUImageContext
     uint32_t ulBytesToWriteLength;            /**< The length of the buffer from which to write the bytes. */
     uint32_t ulCurrentOffset;                 /**< The offset for the partition to write the bytes. */
     uint32_t ulImageFileSize;                 /**< The total size of the file to write. */
+    uint32_t ulErasedLength;                  /**< The length of the partition erased by the update. */
+    uint32_t ulWriteCount;                    /**< Blocks written by the update. */
+    uint32_t ulUnalignedWriteCount;           /**< Blocks starting or ending inside a sector. */
+    uint32_t ulPageProgramCount;              /**< Pages programmed by the update. */
+    uint32_t ulPartialPageProgramCount;       /**< Pages programmed without their whole content. */
+    uint32_t ulSectorEraseCount;              /**< Sectors erased by the update. */
+    mbedtls_md_context_t xSHA256Context;      /**< SHA-256 of the blocks written so far. */
+    uint32_t ulHashedLength;                  /**< The length of the image hashed so far. */
+    bool xHashInOrder;                        /**< False once a block was written out of order, the image is then read back. */
+    uint8_t ucUpdateIdHash[ 32 ];             /**< SHA-256 of the update id of a resumable download. */
+    uint8_t ucFileUrlHash[ 32 ];              /**< SHA-256 of the file URL of a resumable download. */
 } AzureADUImageContext_t;
 
 typedef AzureADUImageContext_t AzureADUImage_t;
@@ -38,6 +38,11 @@
 
 /* TLS includes. */
 #include "esp_transport_ssl.h"
+#include "mbedtls/ssl.h"
+#include "sdkconfig.h"
+
+/* Trust bundle of DER certificates. */
+#include "transport_tls_trust_bundle.h"
 
 #include "demo_config.h"
 
@@ -261,6 +266,50 @@ struct NetworkContext
 
 /*-----------------------------------------------------------*/
 
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+
+/* The trust bundle set as the root CA, loaded by esp-tls through its
+ * certificate bundle hook. */
+    static const uint8_t * pucTrustBundle;
+    static size_t xTrustBundleSize;
+
+    #if !defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+        static mbedtls_x509_crt xTrustBundleChain;
+    #endif
+
+    static esp_err_t prvAttachTrustBundle( void * pvConfig )
+    {
+        #if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+            static TlsTrustBundle_t xTrustBundle;
+
+            /* The CAs are looked up in the index while the chain of the
+             * server is verified. */
+            xTrustBundle.pucBundle = pucTrustBundle;
+            xTrustBundle.ulCount = TLS_TrustBundle_GetCount( pucTrustBundle, xTrustBundleSize );
+            mbedtls_ssl_conf_ca_cb( ( mbedtls_ssl_config * ) pvConfig, TLS_TrustBundle_CaCallback, &xTrustBundle );
+        #else
+            int32_t lMbedtlsError;
+
+            mbedtls_x509_crt_free( &xTrustBundleChain );
+            mbedtls_x509_crt_init( &xTrustBundleChain );
+
+            lMbedtlsError = TLS_TrustBundle_Parse( &xTrustBundleChain, pucTrustBundle, xTrustBundleSize );
+
+            if( lMbedtlsError != 0 )
+            {
+                ESP_LOGE( TAG, "Failed to parse the trust bundle: -0x%x", ( unsigned int ) -lMbedtlsError );
+                return ESP_FAIL;
+            }
+
+            mbedtls_ssl_conf_ca_chain( ( mbedtls_ssl_config * ) pvConfig, &xTrustBundleChain, NULL );
+        #endif /* if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK ) */
+
+        return ESP_OK;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* CONFIG_MBEDTLS_CERTIFICATE_BUNDLE */
+
 TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pNetworkContext,
                                          const char * pHostName,
                                          uint16_t usPort,
@@ -313,7 +362,23 @@ TlsTransportStatus_t TLS_Socket_Connect( NetworkContext_t * pNetworkContext,
         esp_transport_ssl_skip_common_name_check( pxEspTlsTransport->xTransport );
     }
 
-    if( pNetworkCredentials->pucRootCa )
+    if( pNetworkCredentials->pucRootCa &&
+        ( TLS_TrustBundle_GetCount( pNetworkCredentials->pucRootCa, pNetworkCredentials->xRootCaSize ) > 0U ) )
+    {
+        #ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+            /* esp-tls takes one PEM or DER certificate as the root CA, the
+             * certificates of a trust bundle are set by the bundle hook. */
+            pucTrustBundle = pNetworkCredentials->pucRootCa;
+            xTrustBundleSize = pNetworkCredentials->xRootCaSize;
+            esp_transport_ssl_crt_bundle_attach( pxEspTlsTransport->xTransport, prvAttachTrustBundle );
+        #else
+            ESP_LOGE( TAG, "A trust bundle root CA needs CONFIG_MBEDTLS_CERTIFICATE_BUNDLE" );
+            esp_transport_destroy( pxEspTlsTransport->xTransport );
+            vPortFree( pxEspTlsTransport );
+            return eTLSTransportInvalidParameter;
+        #endif
+    }
+    else if( pNetworkCredentials->pucRootCa )
     {
         esp_transport_ssl_set_cert_data( pxEspTlsTransport->xTransport, ( const char * ) pNetworkCredentials->pucRootCa, pNetworkCredentials->xRootCaSize );
     }
@@ -18,6 +18,10 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "nvs_flash.h"
+
+/* Crypto helper used by the samples. */
+#include "azure_sample_crypto.h"
+
 /*-----------------------------------------------------------*/
 
 #define NR_OF_IP_ADDRESSES_TO_WAIT_FOR     1
@@ -296,6 +300,12 @@ void app_main( void )
     /*Allow other core to finish initialization */
     vTaskDelay( pdMS_TO_TICKS( 100 ) );
 
+    if( Crypto_Init() != 0 )
+    {
+        ESP_LOGE( TAG, "HMAC SHA256 self test failed" );
+        return;
+    }
+
     ( void ) example_connect();
 
     initialize_time();
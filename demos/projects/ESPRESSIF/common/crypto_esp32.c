@@ -0,0 +1,278 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "azure_sample_crypto.h"
+
+#include <string.h>
+
+/* mbed TLS includes. */
+#include "mbedtls/md.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/threading.h"
+
+#define cryptoHMAC_SIZE          32   /**< Size of an HMAC SHA256. */
+#define cryptoHMAC_BLOCK_SIZE    64   /**< Size of a SHA256 block, and of the padded key. */
+#define cryptoHMAC_IPAD          0x36
+#define cryptoHMAC_OPAD          0x5C
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Known answer of HMAC SHA256, from RFC 4231.
+ *
+ * The keys of these vectors repeat a single byte.
+ */
+typedef struct CryptoHMACVector
+{
+    uint8_t ucKeyByte;
+    uint32_t ulKeyLength;
+    const char * pcData;
+    uint8_t ucHMAC[ cryptoHMAC_SIZE ];
+} CryptoHMACVector_t;
+
+static const CryptoHMACVector_t xHMACVectors[] =
+{
+    /* Test case 1. */
+    {
+        0x0B, 20,
+        "Hi There",
+        {
+            0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53, 0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+            0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7, 0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7
+        }
+    },
+    /* Test case 6, the key is longer than a block and hashed first. */
+    {
+        0xAA, 131,
+        "Test Using Larger Than Block-Size Key - Hash Key First",
+        {
+            0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+            0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54
+        }
+    }
+};
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check Crypto_HMAC() and the key handle against the RFC 4231 vectors.
+ *
+ * The key handle hashes its key blocks around the SHA engine, see
+ * prvHashKeyBlock(), so it is checked on the target before a SAS token is
+ * signed with it.
+ */
+static uint32_t prvHMACSelfTest( void )
+{
+    const CryptoHMACVector_t * pxVector;
+    CryptoHMACKey_t xKey;
+    uint8_t ucKey[ 131 ];
+    uint8_t ucHMAC[ cryptoHMAC_SIZE ];
+    uint8_t ucKeyHMAC[ cryptoHMAC_SIZE ];
+    uint32_t ulHMACLength;
+    uint32_t ulIndex;
+    uint32_t ulRet = 0;
+
+    for( ulIndex = 0; ( ulRet == 0 ) && ( ulIndex < sizeof( xHMACVectors ) / sizeof( xHMACVectors[ 0 ] ) ); ulIndex++ )
+    {
+        pxVector = &xHMACVectors[ ulIndex ];
+        memset( ucKey, pxVector->ucKeyByte, pxVector->ulKeyLength );
+
+        ulRet = Crypto_HMAC( ucKey, pxVector->ulKeyLength,
+                             ( const uint8_t * ) pxVector->pcData, strlen( pxVector->pcData ),
+                             ucHMAC, sizeof( ucHMAC ), &ulHMACLength );
+
+        if( ulRet == 0 )
+        {
+            ulRet = Crypto_HMACKeyInit( &xKey, ucKey, pxVector->ulKeyLength );
+
+            if( ulRet == 0 )
+            {
+                ulRet = Crypto_HMACKeySign( &xKey, ( const uint8_t * ) pxVector->pcData, strlen( pxVector->pcData ),
+                                            ucKeyHMAC, sizeof( ucKeyHMAC ), &ulHMACLength );
+            }
+
+            Crypto_HMACKeyFree( &xKey );
+        }
+
+        if( ( ulRet == 0 ) &&
+            ( ( memcmp( ucHMAC, pxVector->ucHMAC, sizeof( ucHMAC ) ) != 0 ) ||
+              ( memcmp( ucKeyHMAC, pxVector->ucHMAC, sizeof( ucKeyHMAC ) ) != 0 ) ) )
+        {
+            ulRet = 1;
+        }
+    }
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_Init()
+{
+    return prvHMACSelfTest();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Hash a padded key block into a SHA256 state.
+ *
+ * The SHA engine stays locked by a context it hashes in until the context is
+ * finished, so the block is hashed in the work context, copied out in
+ * software, and the work context finished to release the engine.
+ */
+static uint32_t prvHashKeyBlock( CryptoHMACKey_t * pxKey,
+                                 mbedtls_md_context_t * pxState,
+                                 const uint8_t * pucBlock )
+{
+    uint8_t ucDiscarded[ cryptoHMAC_SIZE ];
+    uint32_t ulRet;
+
+    ulRet = ( mbedtls_md_starts( &pxKey->xWork ) ||
+              mbedtls_md_update( &pxKey->xWork, pucBlock, cryptoHMAC_BLOCK_SIZE ) ||
+              mbedtls_md_clone( pxState, &pxKey->xWork ) ) ? 1 : 0;
+
+    ( void ) mbedtls_md_finish( &pxKey->xWork, ucDiscarded );
+    mbedtls_platform_zeroize( ucDiscarded, sizeof( ucDiscarded ) );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_HMACKeyInit( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucKey,
+                             uint32_t ulKeyLength )
+{
+    uint32_t ulRet;
+    uint32_t ulIndex;
+    uint8_t ucBlock[ cryptoHMAC_BLOCK_SIZE ];
+    uint8_t ucKeyHash[ cryptoHMAC_SIZE ];
+    const mbedtls_md_info_t * pxMDInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+
+    mbedtls_md_init( &pxKey->xInner );
+    mbedtls_md_init( &pxKey->xOuter );
+    mbedtls_md_init( &pxKey->xWork );
+
+    if( mbedtls_md_setup( &pxKey->xInner, pxMDInfo, 0 ) ||
+        mbedtls_md_setup( &pxKey->xOuter, pxMDInfo, 0 ) ||
+        mbedtls_md_setup( &pxKey->xWork, pxMDInfo, 0 ) )
+    {
+        return 1;
+    }
+
+    /* Keys longer than a block are replaced by their hash. */
+    if( ulKeyLength > sizeof( ucBlock ) )
+    {
+        if( mbedtls_md( pxMDInfo, pucKey, ulKeyLength, ucKeyHash ) )
+        {
+            return 1;
+        }
+
+        pucKey = ucKeyHash;
+        ulKeyLength = sizeof( ucKeyHash );
+    }
+
+    memset( ucBlock, cryptoHMAC_IPAD, sizeof( ucBlock ) );
+
+    for( ulIndex = 0; ulIndex < ulKeyLength; ulIndex++ )
+    {
+        ucBlock[ ulIndex ] ^= pucKey[ ulIndex ];
+    }
+
+    ulRet = prvHashKeyBlock( pxKey, &pxKey->xInner, ucBlock );
+
+    for( ulIndex = 0; ulIndex < sizeof( ucBlock ); ulIndex++ )
+    {
+        ucBlock[ ulIndex ] ^= cryptoHMAC_IPAD ^ cryptoHMAC_OPAD;
+    }
+
+    if( ulRet == 0 )
+    {
+        ulRet = prvHashKeyBlock( pxKey, &pxKey->xOuter, ucBlock );
+    }
+
+    mbedtls_platform_zeroize( ucBlock, sizeof( ucBlock ) );
+    mbedtls_platform_zeroize( ucKeyHash, sizeof( ucKeyHash ) );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_HMACKeySign( CryptoHMACKey_t * pxKey,
+                             const uint8_t * pucData,
+                             uint32_t ulDataLength,
+                             uint8_t * pucOutput,
+                             uint32_t ulOutputLength,
+                             uint32_t * pulBytesCopied )
+{
+    uint32_t ulRet;
+    uint8_t ucInnerHash[ cryptoHMAC_SIZE ];
+
+    if( ulOutputLength < cryptoHMAC_SIZE )
+    {
+        return 1;
+    }
+
+    if( mbedtls_md_clone( &pxKey->xWork, &pxKey->xInner ) ||
+        mbedtls_md_update( &pxKey->xWork, pucData, ulDataLength ) ||
+        mbedtls_md_finish( &pxKey->xWork, ucInnerHash ) ||
+        mbedtls_md_clone( &pxKey->xWork, &pxKey->xOuter ) ||
+        mbedtls_md_update( &pxKey->xWork, ucInnerHash, sizeof( ucInnerHash ) ) ||
+        mbedtls_md_finish( &pxKey->xWork, pucOutput ) )
+    {
+        ulRet = 1;
+    }
+    else
+    {
+        ulRet = 0;
+        *pulBytesCopied = cryptoHMAC_SIZE;
+    }
+
+    mbedtls_platform_zeroize( ucInnerHash, sizeof( ucInnerHash ) );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
+
+void Crypto_HMACKeyFree( CryptoHMACKey_t * pxKey )
+{
+    mbedtls_md_free( &pxKey->xInner );
+    mbedtls_md_free( &pxKey->xOuter );
+    mbedtls_md_free( &pxKey->xWork );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t Crypto_HMAC( const uint8_t * pucKey,
+                      uint32_t ulKeyLength,
+                      const uint8_t * pucData,
+                      uint32_t ulDataLength,
+                      uint8_t * pucOutput,
+                      uint32_t ulOutputLength,
+                      uint32_t * pulBytesCopied )
+{
+    uint32_t ulRet;
+    mbedtls_md_context_t xCtx;
+    mbedtls_md_type_t xMDType = MBEDTLS_MD_SHA256;
+
+    if( ulOutputLength < cryptoHMAC_SIZE )
+    {
+        return 1;
+    }
+
+    mbedtls_md_init( &xCtx );
+
+    if( mbedtls_md_setup( &xCtx, mbedtls_md_info_from_type( xMDType ), 1 ) ||
+        mbedtls_md_hmac_starts( &xCtx, pucKey, ulKeyLength ) ||
+        mbedtls_md_hmac_update( &xCtx, pucData, ulDataLength ) ||
+        mbedtls_md_hmac_finish( &xCtx, pucOutput ) )
+    {
+        ulRet = 1;
+    }
+    else
+    {
+        ulRet = 0;
+        *pulBytesCopied = cryptoHMAC_SIZE;
+    }
+
+    mbedtls_md_free( &xCtx );
+
+    return ulRet;
+}
+/*-----------------------------------------------------------*/
@@ -57,18 +57,12 @@ esp_err_t iot_fbm320_delete(fbm320_handle_t sensor, bool del_bus)
 esp_err_t fbm320_select_register(fbm320_handle_t sensor, uint8_t register_address)
 {
 	fbm320_dev_t *sens = (fbm320_dev_t *)sensor;
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-	i2c_master_write_byte(cmd, register_address, 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-	return ret;
+	return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, NULL, 0, 1000 / portTICK_PERIOD_MS);
 }
 
 /*
- * @brief Read multiple bytes from 8-bit registers.
+ * @brief Read multiple bytes from 8-bit registers, selecting the first one in
+ *        the same transaction.
  *
  * @param sensor object handle of fbm320.
  * @param register_address: Address of the first register to read from.
@@ -82,21 +76,7 @@ esp_err_t fbm320_select_register(fbm320_handle_t sensor, uint8_t register_addres
 esp_err_t fbm320_esp32_i2c_read_bytes(fbm320_handle_t sensor, uint8_t register_address, uint8_t size, uint8_t *data)
 {
 	fbm320_dev_t *sens = (fbm320_dev_t *)sensor;
-	fbm320_select_register(sensor, register_address);
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_READ, 1);
-	if (size > 1)
-	{
-		i2c_master_read(cmd, data, size - 1, 0);
-	}
-
-	i2c_master_read_byte(cmd, data + size - 1, 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-
-	return ret;
+	return iot_i2c_bus_read_reg(sens->bus, sens->dev_addr, register_address, data, size, 1000 / portTICK_PERIOD_MS);
 }
 
 /*
@@ -114,17 +94,7 @@ esp_err_t fbm320_esp32_i2c_read_bytes(fbm320_handle_t sensor, uint8_t register_a
 esp_err_t fbm320_esp32_i2c_write_bytes(fbm320_handle_t sensor, uint8_t register_address, uint8_t size, uint8_t *data)
 {
 	fbm320_dev_t *sens = (fbm320_dev_t *)sensor;
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-	i2c_master_write_byte(cmd, register_address, 1);
-	i2c_master_write(cmd, data, size - 1, 0);
-	i2c_master_write_byte(cmd, data[size - 1], 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-
-	return ret;
+	return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, data, size, 1000 / portTICK_PERIOD_MS);
 }
 
 esp_err_t fbm320_i2c_writeblock(fbm320_handle_t sensor, uint8_t reg_addr, uint8_t cnt, uint8_t *reg_data)
@@ -226,26 +196,28 @@ esp_err_t fbm320_set_oversampling_rate(fbm320_handle_t sensor, enum fbm320_osr o
 esp_err_t fbm320_read_store_otp_data(fbm320_handle_t sensor)
 {
 	esp_err_t ret;
+	fbm320_dev_t *sens = (fbm320_dev_t *)sensor;
+	uint8_t otp[18];
 	uint8_t tmp[2];
 	uint16_t R[10];
 
 	struct fbm320_calibration_data *cali = &(barom->calibration);
 
+	/* The registers 0xaa to 0xbb hold R[0] to R[8], MSB first, the last one
+	 * is split in 0xa4 and 0xf1. All are read with one bus acquisition. */
+	i2c_bus_read_t reads[] = {
+		{ sens->dev_addr, FBM320_CALIBRATION_DATA_START0, otp, sizeof(otp) },
+		{ sens->dev_addr, FBM320_CALIBRATION_DATA_START2, &tmp[0], 1 },
+		{ sens->dev_addr, FBM320_CALIBRATION_DATA_START3, &tmp[1], 1 },
+	};
+	ret = iot_i2c_bus_read_batch(sens->bus, reads, sizeof(reads) / sizeof(reads[0]), 1000 / portTICK_PERIOD_MS);
+	if (ret != ESP_OK)
+		goto exit;
+
 	for (uint8_t i = 0; i < 9; i++)
 	{
-		ret = fbm320_i2c_readblock(sensor, FBM320_CALIBRATION_DATA_START0 + (i * 2), 1, &tmp[0]);
-		if (ret < 0)
-			goto exit;
-		ret = fbm320_i2c_readblock(sensor, FBM320_CALIBRATION_DATA_START1 + (i * 2), 1, &tmp[1]);
-		if (ret < 0)
-			goto exit;
-
-		R[i] = ((uint8_t)tmp[0] << 8 | tmp[1]);
+		R[i] = ((uint8_t)otp[i * 2] << 8 | otp[i * 2 + 1]);
 	}
-	ret = fbm320_i2c_readblock(sensor, FBM320_CALIBRATION_DATA_START2, 1, &tmp[0]);
-	if (ret < 0)
-		goto exit;
-	ret = fbm320_i2c_readblock(sensor, FBM320_CALIBRATION_DATA_START3, 1, &tmp[1]);
 
 	R[9] = ((uint8_t)tmp[0] << 8) | tmp[1];
 
@@ -21,6 +21,7 @@
 #define ACK_CHECK_DIS  0x0               /*!< I2C master will not check ack from slave */
 #define ACK_VAL        0x0               /*!< I2C ack value */
 #define NACK_VAL       0x1               /*!< I2C nack value */
+#define AUTO_INCREMENT 0x80              /*!< Register address bit to access several registers */
 
 typedef struct {
     i2c_bus_handle_t bus;
@@ -30,28 +31,15 @@ typedef struct {
 esp_err_t iot_hts221_write_byte(hts221_handle_t sensor, uint8_t reg_addr, uint8_t data)
 {
     hts221_dev_t* sens = (hts221_dev_t*) sensor;
-	esp_err_t  ret;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | WRITE_BIT, ACK_CHECK_EN);
-    i2c_master_write_byte(cmd, reg_addr, ACK_CHECK_EN);
-    i2c_master_write_byte(cmd, data, ACK_CHECK_EN);
-    ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
-        return ret;
-    }
-	return ESP_OK;
+    return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, reg_addr, &data, 1, 1000 / portTICK_RATE_MS);
 }
 
 esp_err_t iot_hts221_write(hts221_handle_t sensor, uint8_t reg_start_addr, uint8_t reg_num, uint8_t *data_buf)
 {
-    uint32_t i = 0;
+    hts221_dev_t* sens = (hts221_dev_t*) sensor;
     if (data_buf != NULL) {
-        for(i=0; i<reg_num; i++) {
-            iot_hts221_write_byte(sensor, reg_start_addr+i, data_buf[i]);
-        }
-        return ESP_OK;
+        return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, reg_start_addr | AUTO_INCREMENT, data_buf, reg_num,
+                                     1000 / portTICK_RATE_MS);
     }
     return ESP_FAIL;
 }
@@ -59,40 +47,17 @@ esp_err_t iot_hts221_write(hts221_handle_t sensor, uint8_t reg_start_addr, uint8
 esp_err_t iot_hts221_read_byte(hts221_handle_t sensor, uint8_t reg, uint8_t *data)
 {
     hts221_dev_t* sens = (hts221_dev_t*) sensor;
-    esp_err_t ret;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | WRITE_BIT, ACK_CHECK_EN);
-    i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
-    i2c_master_stop(cmd);
-    ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
-        return ret;
-    }
-
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | READ_BIT, ACK_CHECK_EN);
-    i2c_master_read_byte(cmd, data, NACK_VAL);
-    i2c_master_stop(cmd);
-    ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_RATE_MS);
-    i2c_cmd_link_delete(cmd);
-    return ret;
+    return iot_i2c_bus_read_reg(sens->bus, sens->dev_addr, reg, data, 1, 1000 / portTICK_RATE_MS);
 }
 
 esp_err_t iot_hts221_read(hts221_handle_t sensor, uint8_t reg_start_addr, uint8_t reg_num, uint8_t *data_buf)
 {
-    uint32_t i = 0;
-    uint8_t data_t = 0;
+    hts221_dev_t* sens = (hts221_dev_t*) sensor;
     if (data_buf != NULL) {
-        for(i=0; i<reg_num; i++){
-            iot_hts221_read_byte(sensor, reg_start_addr+i, &data_t);
-            data_buf[i] = data_t;
-        }
-        return ESP_OK;
-    } 
-    return ESP_FAIL;  
+        return iot_i2c_bus_read_reg(sens->bus, sens->dev_addr, reg_start_addr | AUTO_INCREMENT, data_buf, reg_num,
+                                    1000 / portTICK_RATE_MS);
+    }
+    return ESP_FAIL;
 }
 
 esp_err_t iot_hts221_get_deviceid(hts221_handle_t sensor, uint8_t* deviceid)
@@ -319,23 +284,30 @@ esp_err_t iot_hts221_get_raw_humidity(hts221_handle_t sensor, int16_t *humidity)
 
 esp_err_t iot_hts221_get_humidity(hts221_handle_t sensor, int16_t *humidity)
 {
+    hts221_dev_t* sens = (hts221_dev_t*) sensor;
     int16_t h0_t0_out, h1_t0_out, h_t_out;
     int16_t h0_rh, h1_rh;
-    uint8_t buffer[2];
+    uint8_t rh_x2[2], h0_out[2], h1_out[2], h_out[2];
     int32_t tmp_32;
-    
-    iot_hts221_read(sensor, HTS221_H0_RH_X2, 2, buffer);
-    h0_rh = buffer[0] >> 1;
-    h1_rh = buffer[1] >> 1;
-    
-    iot_hts221_read(sensor, HTS221_H0_T0_OUT_L, 2, buffer);
-    h0_t0_out = (int16_t)(((uint16_t)buffer[1]) << 8) | (uint16_t)buffer[0];
+    esp_err_t ret;
 
-    iot_hts221_read(sensor, HTS221_H1_T0_OUT_L, 2, buffer);
-    h1_t0_out = (int16_t)(((uint16_t)buffer[1]) << 8) | (uint16_t)buffer[0];
-    
-    iot_hts221_read(sensor, HTS221_HR_OUT_L_REG, 2, buffer);
-    h_t_out = (int16_t)(((uint16_t)buffer[1]) << 8) | (uint16_t)buffer[0];
+    /* The calibration and the output are read with one bus acquisition. */
+    i2c_bus_read_t reads[] = {
+        { sens->dev_addr, HTS221_H0_RH_X2 | AUTO_INCREMENT, rh_x2, 2 },
+        { sens->dev_addr, HTS221_H0_T0_OUT_L | AUTO_INCREMENT, h0_out, 2 },
+        { sens->dev_addr, HTS221_H1_T0_OUT_L | AUTO_INCREMENT, h1_out, 2 },
+        { sens->dev_addr, HTS221_HR_OUT_L_REG | AUTO_INCREMENT, h_out, 2 },
+    };
+    ret = iot_i2c_bus_read_batch(sens->bus, reads, sizeof(reads) / sizeof(reads[0]), 1000 / portTICK_RATE_MS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    h0_rh = rh_x2[0] >> 1;
+    h1_rh = rh_x2[1] >> 1;
+    h0_t0_out = (int16_t)(((uint16_t)h0_out[1]) << 8) | (uint16_t)h0_out[0];
+    h1_t0_out = (int16_t)(((uint16_t)h1_out[1]) << 8) | (uint16_t)h1_out[0];
+    h_t_out = (int16_t)(((uint16_t)h_out[1]) << 8) | (uint16_t)h_out[0];
     
     tmp_32 = ((int32_t)(h_t_out - h0_t0_out)) * ((int32_t)(h1_rh - h0_rh) * 10);
     if (h1_t0_out - h0_t0_out == 0) {
@@ -359,23 +331,33 @@ esp_err_t iot_hts221_get_raw_temperature(hts221_handle_t sensor, int16_t *temper
 
 esp_err_t iot_hts221_get_temperature(hts221_handle_t sensor, int16_t *temperature)
 {
+    hts221_dev_t* sens = (hts221_dev_t*) sensor;
     int16_t t0_out, t1_out, t_out, t0_degc_x8_u16, t1_degc_x8_u16;
     int16_t t0_degc, t1_degc;
-    uint8_t buffer[4], tmp_8;
+    uint8_t degc_x8[2], tmp_8, t01_out[4], temp_out[2];
     uint32_t tmp_32;
-    iot_hts221_read(sensor, HTS221_T0_DEGC_X8, 2, buffer);
-    iot_hts221_read(sensor, HTS221_T0_T1_DEGC_H2, 1, &tmp_8);
-    t0_degc_x8_u16 = (((uint16_t)(tmp_8 & 0x03)) << 8) | ((uint16_t)buffer[0]);  
-    t1_degc_x8_u16 = (((uint16_t)(tmp_8 & 0x0C)) << 6) | ((uint16_t)buffer[1]);
+    esp_err_t ret;
+
+    /* The calibration and the output are read with one bus acquisition. */
+    i2c_bus_read_t reads[] = {
+        { sens->dev_addr, HTS221_T0_DEGC_X8 | AUTO_INCREMENT, degc_x8, 2 },
+        { sens->dev_addr, HTS221_T0_T1_DEGC_H2, &tmp_8, 1 },
+        { sens->dev_addr, HTS221_T0_OUT_L | AUTO_INCREMENT, t01_out, 4 },
+        { sens->dev_addr, HTS221_TEMP_OUT_L_REG | AUTO_INCREMENT, temp_out, 2 },
+    };
+    ret = iot_i2c_bus_read_batch(sens->bus, reads, sizeof(reads) / sizeof(reads[0]), 1000 / portTICK_RATE_MS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    t0_degc_x8_u16 = (((uint16_t)(tmp_8 & 0x03)) << 8) | ((uint16_t)degc_x8[0]);
+    t1_degc_x8_u16 = (((uint16_t)(tmp_8 & 0x0C)) << 6) | ((uint16_t)degc_x8[1]);
     t0_degc = t0_degc_x8_u16 >> 3;
     t1_degc = t1_degc_x8_u16 >> 3;
 
-    iot_hts221_read(sensor, HTS221_T0_OUT_L, 4, buffer);
-    t0_out = (((uint16_t)buffer[1]) << 8) | (uint16_t)buffer[0];  
-    t1_out = (((uint16_t)buffer[3]) << 8) | (uint16_t)buffer[2];
-
-    iot_hts221_read(sensor, HTS221_TEMP_OUT_L_REG, 2, buffer);
-    t_out = (((uint16_t)buffer[1]) << 8) | (uint16_t)buffer[0]; 
+    t0_out = (((uint16_t)t01_out[1]) << 8) | (uint16_t)t01_out[0];
+    t1_out = (((uint16_t)t01_out[3]) << 8) | (uint16_t)t01_out[2];
+    t_out = (((uint16_t)temp_out[1]) << 8) | (uint16_t)temp_out[0];
 
     tmp_32 = ((uint32_t)(t_out - t0_out)) * ((uint32_t)(t1_degc - t0_degc) * 10);
     if ((t1_out - t0_out) == 0) {
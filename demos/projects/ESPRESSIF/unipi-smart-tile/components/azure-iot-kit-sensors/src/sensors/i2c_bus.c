@@ -12,13 +12,30 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <stdio.h>
+#include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "driver/i2c.h"
 #include "iot_i2c_bus.h"
 
+/* A register read takes a write and a read transaction of the command link. */
+#define I2C_BUS_LINK_SIZE  I2C_LINK_RECOMMENDED_SIZE(2 * I2C_BUS_BATCH_MAX_READS)
+
+typedef struct {
+    bool used;                       /*!<The entry counts a device */
+    uint16_t dev_addr;               /*!<I2C 7bit address of the device */
+    i2c_bus_device_stats_t stats;    /*!<Counters of the device */
+} i2c_bus_device_t;
+
 typedef struct {
     i2c_config_t i2c_conf;   /*!<I2C bus parameters*/
     i2c_port_t i2c_port;     /*!<I2C port number */
+    SemaphoreHandle_t lock;  /*!<Held for a transaction or a batch */
+    uint8_t link_buf[I2C_BUS_LINK_SIZE];  /*!<Command link reused by every transaction, under the lock */
+    i2c_bus_device_t devices[I2C_BUS_MAX_DEVICES];  /*!<Counters by device */
+    i2c_bus_device_stats_t total;  /*!<Counters of every device */
 } i2c_bus_t;
 
 static const char* I2C_BUS_TAG = "i2c_bus";
@@ -26,6 +43,9 @@ static const char* I2C_BUS_TAG = "i2c_bus";
     ESP_LOGE(I2C_BUS_TAG,"%s:%d (%s):%s", __FILE__, __LINE__, __FUNCTION__, str);      \
     return (ret);                                                                   \
     }
+#define I2C_BUS_QUEUE(ret, cmd)  if((ret) == ESP_OK) {                                     \
+    (ret) = (cmd);                                                                  \
+    }
 #define ESP_INTR_FLG_DEFAULT  (0)
 #define ESP_I2C_MASTER_BUF_LEN  (0)
 
@@ -34,8 +54,13 @@ i2c_bus_handle_t iot_i2c_bus_create(i2c_port_t port, i2c_config_t* conf)
     I2C_BUS_CHECK(port < I2C_NUM_MAX, "I2C port error", NULL);
     I2C_BUS_CHECK(conf != NULL, "Pointer error", NULL);
     i2c_bus_t* bus = (i2c_bus_t*) calloc(1, sizeof(i2c_bus_t));
+    I2C_BUS_CHECK(bus != NULL, "Memory error", NULL);
     bus->i2c_conf = *conf;
     bus->i2c_port = port;
+    bus->lock = xSemaphoreCreateMutex();
+    if(bus->lock == NULL) {
+        goto error;
+    }
     esp_err_t ret = i2c_param_config(bus->i2c_port, &bus->i2c_conf);
     if(ret != ESP_OK) {
         goto error;
@@ -48,6 +73,9 @@ i2c_bus_handle_t iot_i2c_bus_create(i2c_port_t port, i2c_config_t* conf)
 
     error:
     if(bus) {
+        if(bus->lock) {
+            vSemaphoreDelete(bus->lock);
+        }
         free(bus);
     }
     return NULL;
@@ -58,6 +86,7 @@ esp_err_t iot_i2c_bus_delete(i2c_bus_handle_t bus)
     I2C_BUS_CHECK(bus != NULL, "Handle error", ESP_FAIL);
     i2c_bus_t* i2c_bus = (i2c_bus_t*) bus;
     i2c_driver_delete(i2c_bus->i2c_port);
+    vSemaphoreDelete(i2c_bus->lock);
     free(bus);
     return ESP_OK;
 }
@@ -67,5 +96,157 @@ esp_err_t iot_i2c_bus_cmd_begin(i2c_bus_handle_t bus, i2c_cmd_handle_t cmd, port
     I2C_BUS_CHECK(bus != NULL, "Handle error", ESP_FAIL);
     I2C_BUS_CHECK(cmd != NULL, "I2C cmd error", ESP_FAIL);
     i2c_bus_t* i2c_bus = (i2c_bus_t*) bus;
-    return i2c_master_cmd_begin(i2c_bus->i2c_port, cmd, ticks_to_wait);
-}
\ No newline at end of file
+    if(xSemaphoreTake(i2c_bus->lock, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t ret = i2c_master_cmd_begin(i2c_bus->i2c_port, cmd, ticks_to_wait);
+    xSemaphoreGive(i2c_bus->lock);
+    return ret;
+}
+
+/* Find the counters of a device, taking a free entry for a new one. Called
+ * with the lock held. */
+static i2c_bus_device_t* i2c_bus_find_device(i2c_bus_t* i2c_bus, uint16_t dev_addr, bool add)
+{
+    i2c_bus_device_t* free_entry = NULL;
+    for(int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if(!i2c_bus->devices[i].used) {
+            if(free_entry == NULL) {
+                free_entry = &i2c_bus->devices[i];
+            }
+        } else if(i2c_bus->devices[i].dev_addr == dev_addr) {
+            return &i2c_bus->devices[i];
+        }
+    }
+    if(add && free_entry != NULL) {
+        free_entry->used = true;
+        free_entry->dev_addr = dev_addr;
+        return free_entry;
+    }
+    return NULL;
+}
+
+static void i2c_bus_add(i2c_bus_device_stats_t* stats, esp_err_t ret, uint32_t elapsed_us)
+{
+    stats->transactions++;
+    if(ret != ESP_OK) {
+        stats->errors++;
+    }
+    stats->last_us = elapsed_us;
+    stats->total_us += elapsed_us;
+    if(elapsed_us > stats->max_us) {
+        stats->max_us = elapsed_us;
+    }
+}
+
+static void i2c_bus_count(i2c_bus_t* i2c_bus, uint16_t dev_addr, esp_err_t ret, uint32_t elapsed_us)
+{
+    i2c_bus_add(&i2c_bus->total, ret, elapsed_us);
+    i2c_bus_device_t* dev = i2c_bus_find_device(i2c_bus, dev_addr, true);
+    if(dev != NULL) {
+        i2c_bus_add(&dev->stats, ret, elapsed_us);
+    }
+}
+
+/* Run the command link built in the buffer of the bus, and release the lock. */
+static esp_err_t i2c_bus_run(i2c_bus_t* i2c_bus, i2c_cmd_handle_t cmd, esp_err_t ret,
+                             const i2c_bus_read_t* reads, size_t count, uint16_t dev_addr,
+                             portBASE_TYPE ticks_to_wait)
+{
+    I2C_BUS_QUEUE(ret, i2c_master_stop(cmd));
+    int64_t start = esp_timer_get_time();
+    I2C_BUS_QUEUE(ret, i2c_master_cmd_begin(i2c_bus->i2c_port, cmd, ticks_to_wait));
+    uint32_t elapsed_us = (uint32_t) (esp_timer_get_time() - start);
+    i2c_cmd_link_delete_static(cmd);
+
+    if(reads == NULL) {
+        i2c_bus_count(i2c_bus, dev_addr, ret, elapsed_us);
+    } else {
+        for(size_t i = 0; i < count; i++) {
+            i2c_bus_count(i2c_bus, reads[i].dev_addr, ret, elapsed_us / count);
+        }
+    }
+    xSemaphoreGive(i2c_bus->lock);
+    return ret;
+}
+
+esp_err_t iot_i2c_bus_write_reg(i2c_bus_handle_t bus, uint16_t dev_addr, uint8_t reg_addr,
+                                const uint8_t* data, size_t size, portBASE_TYPE ticks_to_wait)
+{
+    I2C_BUS_CHECK(bus != NULL, "Handle error", ESP_FAIL);
+    I2C_BUS_CHECK(data != NULL || size == 0, "Pointer error", ESP_FAIL);
+    i2c_bus_t* i2c_bus = (i2c_bus_t*) bus;
+    if(xSemaphoreTake(i2c_bus->lock, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(i2c_bus->link_buf, sizeof(i2c_bus->link_buf));
+    esp_err_t ret = i2c_master_start(cmd);
+    I2C_BUS_QUEUE(ret, i2c_master_write_byte(cmd, (dev_addr << 1) | I2C_MASTER_WRITE, true));
+    I2C_BUS_QUEUE(ret, i2c_master_write_byte(cmd, reg_addr, true));
+    if(size > 0) {
+        I2C_BUS_QUEUE(ret, i2c_master_write(cmd, data, size, true));
+    }
+    return i2c_bus_run(i2c_bus, cmd, ret, NULL, 0, dev_addr, ticks_to_wait);
+}
+
+esp_err_t iot_i2c_bus_read_reg(i2c_bus_handle_t bus, uint16_t dev_addr, uint8_t reg_addr,
+                               uint8_t* data, size_t size, portBASE_TYPE ticks_to_wait)
+{
+    i2c_bus_read_t read = {
+        .dev_addr = dev_addr,
+        .reg_addr = reg_addr,
+        .data = data,
+        .size = size,
+    };
+    return iot_i2c_bus_read_batch(bus, &read, 1, ticks_to_wait);
+}
+
+esp_err_t iot_i2c_bus_read_batch(i2c_bus_handle_t bus, const i2c_bus_read_t* reads, size_t count,
+                                 portBASE_TYPE ticks_to_wait)
+{
+    I2C_BUS_CHECK(bus != NULL, "Handle error", ESP_FAIL);
+    I2C_BUS_CHECK(reads != NULL && count > 0 && count <= I2C_BUS_BATCH_MAX_READS, "Batch error", ESP_FAIL);
+    for(size_t i = 0; i < count; i++) {
+        I2C_BUS_CHECK(reads[i].data != NULL && reads[i].size > 0, "Pointer error", ESP_FAIL);
+    }
+    i2c_bus_t* i2c_bus = (i2c_bus_t*) bus;
+    if(xSemaphoreTake(i2c_bus->lock, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(i2c_bus->link_buf, sizeof(i2c_bus->link_buf));
+    esp_err_t ret = ESP_OK;
+    for(size_t i = 0; i < count; i++) {
+        /* The start of the next read is a repeated start, the stop comes last. */
+        I2C_BUS_QUEUE(ret, i2c_master_start(cmd));
+        I2C_BUS_QUEUE(ret, i2c_master_write_byte(cmd, (reads[i].dev_addr << 1) | I2C_MASTER_WRITE, true));
+        I2C_BUS_QUEUE(ret, i2c_master_write_byte(cmd, reads[i].reg_addr, true));
+        I2C_BUS_QUEUE(ret, i2c_master_start(cmd));
+        I2C_BUS_QUEUE(ret, i2c_master_write_byte(cmd, (reads[i].dev_addr << 1) | I2C_MASTER_READ, true));
+        I2C_BUS_QUEUE(ret, i2c_master_read(cmd, reads[i].data, reads[i].size, I2C_MASTER_LAST_NACK));
+    }
+    return i2c_bus_run(i2c_bus, cmd, ret, reads, count, 0, ticks_to_wait);
+}
+
+esp_err_t iot_i2c_bus_get_device_stats(i2c_bus_handle_t bus, uint16_t dev_addr, i2c_bus_device_stats_t* stats)
+{
+    I2C_BUS_CHECK(bus != NULL, "Handle error", ESP_FAIL);
+    I2C_BUS_CHECK(stats != NULL, "Pointer error", ESP_FAIL);
+    i2c_bus_t* i2c_bus = (i2c_bus_t*) bus;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(i2c_bus->lock, portMAX_DELAY);
+    if(dev_addr == I2C_BUS_ALL_DEVICES) {
+        if(i2c_bus->total.transactions > 0) {
+            *stats = i2c_bus->total;
+            ret = ESP_OK;
+        }
+        xSemaphoreGive(i2c_bus->lock);
+        return ret;
+    }
+    i2c_bus_device_t* dev = i2c_bus_find_device(i2c_bus, dev_addr, false);
+    if(dev != NULL) {
+        *stats = dev->stats;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(i2c_bus->lock);
+    return ret;
+}
@@ -22,6 +22,31 @@ extern "C"
 
 typedef void* i2c_bus_handle_t;
 
+#define I2C_BUS_BATCH_MAX_READS  (4)  /*!< Reads queued at most in one iot_i2c_bus_read_batch */
+#define I2C_BUS_MAX_DEVICES      (8)  /*!< Devices whose transactions are counted one by one */
+#define I2C_BUS_ALL_DEVICES      (0xffff)  /*!< Address of the counters of every device of the bus */
+
+/**
+ * @brief Transaction counters of one device of the bus
+ */
+typedef struct {
+    uint32_t transactions;   /*!< Reads and writes run with the device */
+    uint32_t errors;         /*!< Those which failed */
+    uint32_t last_us;        /*!< Duration of the last one */
+    uint32_t max_us;         /*!< Longest one */
+    uint64_t total_us;       /*!< Sum of the durations, for the mean */
+} i2c_bus_device_stats_t;
+
+/**
+ * @brief Registers of a device to read in a batch
+ */
+typedef struct {
+    uint16_t dev_addr;       /*!< I2C 7bit address of the device */
+    uint8_t reg_addr;        /*!< First register to read */
+    uint8_t* data;           /*!< Buffer receiving the registers */
+    size_t size;             /*!< Number of registers to read */
+} i2c_bus_read_t;
+
 /**
  * @brief Create and init I2C bus and return a I2C bus handle
  *
@@ -57,6 +82,79 @@ esp_err_t iot_i2c_bus_delete(i2c_bus_handle_t bus);
  */
 esp_err_t iot_i2c_bus_cmd_begin(i2c_bus_handle_t bus, i2c_cmd_handle_t cmd,
 portBASE_TYPE ticks_to_wait);
+
+/**
+ * @brief Write registers of a device in one transaction
+ *
+ * @param bus I2C bus handle
+ * @param dev_addr I2C 7bit address of the device
+ * @param reg_addr First register to write
+ * @param data Bytes to write
+ * @param size Number of bytes to write
+ * @param ticks_to_wait Maximum blocking time
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail, the device did not ACK
+ *     - ESP_ERR_TIMEOUT The bus is busy
+ */
+esp_err_t iot_i2c_bus_write_reg(i2c_bus_handle_t bus, uint16_t dev_addr, uint8_t reg_addr,
+                                const uint8_t* data, size_t size, portBASE_TYPE ticks_to_wait);
+
+/**
+ * @brief Select the first register of a device and read it, with a repeated
+ *        start in between, in one transaction
+ *
+ * @param bus I2C bus handle
+ * @param dev_addr I2C 7bit address of the device
+ * @param reg_addr First register to read
+ * @param data Buffer receiving the registers
+ * @param size Number of registers to read
+ * @param ticks_to_wait Maximum blocking time
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail, the device did not ACK
+ *     - ESP_ERR_TIMEOUT The bus is busy
+ */
+esp_err_t iot_i2c_bus_read_reg(i2c_bus_handle_t bus, uint16_t dev_addr, uint8_t reg_addr,
+                               uint8_t* data, size_t size, portBASE_TYPE ticks_to_wait);
+
+/**
+ * @brief Run several register reads, of one or more devices, as a single
+ *        command link, holding the bus once
+ *
+ * @note The reads are chained with repeated starts, a NACK of any device fails
+ *       them all. The duration of the batch is shared evenly in the counters
+ *       of its reads.
+ *
+ * @param bus I2C bus handle
+ * @param reads The reads, run in order
+ * @param count Number of reads, I2C_BUS_BATCH_MAX_READS at most
+ * @param ticks_to_wait Maximum blocking time
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail, a device did not ACK
+ *     - ESP_ERR_TIMEOUT The bus is busy
+ */
+esp_err_t iot_i2c_bus_read_batch(i2c_bus_handle_t bus, const i2c_bus_read_t* reads, size_t count,
+                                 portBASE_TYPE ticks_to_wait);
+
+/**
+ * @brief Get the counters of the transactions run with a device by
+ *        iot_i2c_bus_write_reg, iot_i2c_bus_read_reg and iot_i2c_bus_read_batch
+ *
+ * @param bus I2C bus handle
+ * @param dev_addr I2C 7bit address of the device, or I2C_BUS_ALL_DEVICES for
+ *        the counters of every device, including those past I2C_BUS_MAX_DEVICES
+ * @param stats Counters of the device
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_NOT_FOUND No transaction was counted for the device
+ */
+esp_err_t iot_i2c_bus_get_device_stats(i2c_bus_handle_t bus, uint16_t dev_addr, i2c_bus_device_stats_t* stats);
 #ifdef __cplusplus
 }
 #endif
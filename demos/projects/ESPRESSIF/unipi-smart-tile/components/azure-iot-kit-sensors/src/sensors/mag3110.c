@@ -62,18 +62,12 @@ esp_err_t iot_mag3110_delete(mag3110_handle_t sensor, bool del_bus)
 esp_err_t mag3110_select_register(mag3110_handle_t sensor, uint8_t register_address)
 {
 	mag3110_dev_t *sens = (mag3110_dev_t *)sensor;
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-	i2c_master_write_byte(cmd, register_address, 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-	return ret;
+	return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, NULL, 0, 1000 / portTICK_PERIOD_MS);
 }
 
 /*
- * @brief Read multiple bytes from 8-bit registers.
+ * @brief Read multiple bytes from 8-bit registers, selecting the first one in
+ *        the same transaction.
  *
  * @param sensor object handle of mag3110.
  * @param register_address: Address of the first register to read from.
@@ -87,21 +81,7 @@ esp_err_t mag3110_select_register(mag3110_handle_t sensor, uint8_t register_addr
 esp_err_t mag3110_esp32_i2c_read_bytes(mag3110_handle_t sensor, uint8_t register_address, uint8_t size, uint8_t *data)
 {
 	mag3110_dev_t *sens = (mag3110_dev_t *)sensor;
-	mag3110_select_register(sensor, register_address);
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_READ, 1);
-	if (size > 1)
-	{
-		i2c_master_read(cmd, data, size - 1, 0);
-	}
-
-	i2c_master_read_byte(cmd, data + size - 1, 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-
-	return ret;
+	return iot_i2c_bus_read_reg(sens->bus, sens->dev_addr, register_address, data, size, 1000 / portTICK_PERIOD_MS);
 }
 
 /*
@@ -135,16 +115,7 @@ esp_err_t mag3110_esp32_i2c_read_byte(mag3110_handle_t sensor, uint8_t register_
 esp_err_t mag3110_esp32_i2c_write_byte(mag3110_handle_t sensor, uint8_t register_address, uint8_t data)
 {
 	mag3110_dev_t *sens = (mag3110_dev_t *)sensor;
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-	i2c_master_write_byte(cmd, register_address, 1);
-	i2c_master_write_byte(cmd, data, 1);
-	i2c_master_stop(cmd);
-	int ret = iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
-
-	return ret;
+	return iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, &data, 1, 1000 / portTICK_PERIOD_MS);
 }
 
 // This is private because you must read each axis for the data ready bit to be cleared
@@ -152,40 +123,29 @@ esp_err_t mag3110_esp32_i2c_write_byte(mag3110_handle_t sensor, uint8_t register
 esp_err_t mag3110_read_axis(mag3110_handle_t sensor, uint8_t axis, uint16_t *value)
 {
 	esp_err_t ret;
-	uint8_t lsbAddress, msbAddress;
-	uint8_t lsb, msb;
-
-	msbAddress = axis;
-	lsbAddress = axis + 1;
+	uint8_t data[2];
 
-	ret = mag3110_esp32_i2c_read_byte(sensor, msbAddress, &msb);
-	if (ret == ESP_FAIL)
-		return ret;
-
-	vTaskDelay(10 / portTICK_RATE_MS); //needs at least 1.3us free time between start and stop
-
-	ret = mag3110_esp32_i2c_read_byte(sensor, lsbAddress, &lsb);
-	if (ret == ESP_FAIL)
+	//The address increments from the MSB to the LSB within the read
+	ret = mag3110_esp32_i2c_read_bytes(sensor, axis, sizeof(data), data);
+	if (ret != ESP_OK)
 		return ret;
 
-	*value = (lsb | (msb << 8)); //concatenate the MSB and LSB
+	*value = (data[1] | (data[0] << 8)); //concatenate the MSB and LSB
 	return ret;
 }
 
 esp_err_t mag3110_read_mag(mag3110_handle_t sensor, uint16_t *x, uint16_t *y, uint16_t *z)
 {
-	//Read each axis
+	//Read the three axes at once, they come from the same sample and clear the data ready bit
 	esp_err_t ret;
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_X_MSB, x);
-	if (ret == ESP_FAIL)
-		goto exit;
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_Y_MSB, y);
-	if (ret == ESP_FAIL)
-		goto exit;
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_Z_MSB, z);
-	if (ret == ESP_FAIL)
-		goto exit;
-exit:
+	uint8_t data[6];
+	ret = mag3110_esp32_i2c_read_bytes(sensor, MAG3110_OUT_X_MSB, sizeof(data), data);
+	if (ret != ESP_OK)
+		return ret;
+
+	*x = (data[1] | (data[0] << 8));
+	*y = (data[3] | (data[2] << 8));
+	*z = (data[5] | (data[4] << 8));
 	return ret;
 }
 
@@ -243,23 +203,14 @@ esp_err_t mag3110_read_micro_teslas(mag3110_handle_t sensor, float *x, float *y,
 {
 	esp_err_t ret;
 	uint16_t int_x, int_y, int_z;
-	//Read each axis and scale to Teslas
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_X_MSB, &int_x);
-	if (ret == ESP_FAIL)
-		goto exit;
-	*x = (float)int_x * 0.1f;
+	//Read the axes and scale to Teslas
+	ret = mag3110_read_mag(sensor, &int_x, &int_y, &int_z);
+	if (ret != ESP_OK)
+		return ret;
 
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_Y_MSB, &int_y);
-	if (ret == ESP_FAIL)
-		goto exit;
+	*x = (float)int_x * 0.1f;
 	*y = (float)int_y * 0.1f;
-
-	ret = mag3110_read_axis(sensor, MAG3110_OUT_Z_MSB, &int_z);
-	if (ret == ESP_FAIL)
-		goto exit;
 	*z = (float)int_z * 0.1f;
-
-exit:
 	return ret;
 }
 
@@ -291,34 +291,17 @@ esp_err_t iot_mpu6050_delete(mpu6050_handle_t sensor, bool del_bus)
 void select_register(mpu6050_handle_t sensor, uint8_t register_address)
 {
     mpu6050_dev_t *sens = (mpu6050_dev_t *)sensor;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(cmd, register_address, 1);
-    i2c_master_stop(cmd);
-    iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, NULL, 0, 1000 / portTICK_PERIOD_MS);
 }
 
 int8_t mpu6050_i2c_read_bytes(mpu6050_handle_t sensor, uint8_t register_address,
                             uint8_t size, uint8_t *data)
 {
     mpu6050_dev_t *sens = (mpu6050_dev_t *)sensor;
-    select_register(sensor, register_address);
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_READ, 1);
+    esp_err_t ret = iot_i2c_bus_read_reg(sens->bus, sens->dev_addr, register_address, data, size,
+                                         1000 / portTICK_PERIOD_MS);
 
-    if (size > 1)
-    {
-        i2c_master_read(cmd, data, size - 1, 0);
-    }
-    i2c_master_read_byte(cmd, data + size - 1, 1);
-    i2c_master_stop(cmd);
-    iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    return size;
+    return (ret == ESP_OK) ? size : ESP_FAIL;
 }
 
 int8_t mpu6050_i2c_read_byte(mpu6050_handle_t sensor, uint8_t register_address, uint8_t *data)
@@ -331,9 +314,9 @@ int8_t mpu6050_i2c_read_bits(mpu6050_handle_t sensor, uint8_t register_address,
                            uint8_t bit_start, uint8_t size, uint8_t *data)
 {
     uint8_t bit;
-    uint8_t count;
+    int8_t count;
 
-    if ((count = mpu6050_i2c_read_byte(sensor, register_address, &bit)) != 0)
+    if ((count = mpu6050_i2c_read_byte(sensor, register_address, &bit)) > 0)
     {
         uint8_t mask = ((1 << size) - 1) << (bit_start - size + 1);
 
@@ -349,7 +332,7 @@ int8_t mpu6050_i2c_read_bit(mpu6050_handle_t sensor, uint8_t register_address,
                           uint8_t bit_number, uint8_t *data)
 {
     uint8_t bit;
-    uint8_t count = mpu6050_i2c_read_byte(sensor, register_address,
+    int8_t count = mpu6050_i2c_read_byte(sensor, register_address,
                                         &bit);
 
     *data = bit & (1 << bit_number);
@@ -361,40 +344,23 @@ bool mpu6050_i2c_write_bytes(mpu6050_handle_t sensor, uint8_t register_address,
                            uint8_t size, uint8_t *data)
 {
     mpu6050_dev_t *sens = (mpu6050_dev_t *)sensor;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(cmd, register_address, 1);
-    i2c_master_write(cmd, data, size - 1, 0);
-    i2c_master_write_byte(cmd, data[size - 1], 1);
-    i2c_master_stop(cmd);
-    iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    return (true);
+    esp_err_t ret = iot_i2c_bus_write_reg(sens->bus, sens->dev_addr, register_address, data, size,
+                                          1000 / portTICK_PERIOD_MS);
+
+    return (ret == ESP_OK);
 }
 
 bool mpu6050_i2c_write_byte(mpu6050_handle_t sensor, uint8_t register_address,
                           uint8_t data)
 {
-    mpu6050_dev_t *sens = (mpu6050_dev_t *)sensor;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (sens->dev_addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(cmd, register_address, 1);
-    i2c_master_write_byte(cmd, data, 1);
-    i2c_master_stop(cmd);
-    iot_i2c_bus_cmd_begin(sens->bus, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    return (true);
+    return (mpu6050_i2c_write_bytes(sensor, register_address, 1, &data));
 }
 
 bool mpu6050_i2c_write_bits(mpu6050_handle_t sensor, uint8_t register_address,
                           uint8_t bit_start, uint8_t size, uint8_t data)
 {
     uint8_t bit = 0;
-    if (mpu6050_i2c_read_byte(sensor, register_address, &bit) != 0)
+    if (mpu6050_i2c_read_byte(sensor, register_address, &bit) > 0)
     {
         uint8_t mask = ((1 << size) - 1) << (bit_start - size + 1);
         data <<= (bit_start - size + 1); // Shift data into correct position.
@@ -415,7 +381,10 @@ bool mpu6050_i2c_write_bit(mpu6050_handle_t sensor, uint8_t register_address,
 {
     uint8_t bit;
 
-    mpu6050_i2c_read_byte(sensor, register_address, &bit);
+    if (mpu6050_i2c_read_byte(sensor, register_address, &bit) <= 0)
+    {
+        return (false);
+    }
 
     if (data != 0)
     {
@@ -227,6 +227,28 @@
  */
 #define democonfigNETWORK_BUFFER_SIZE    CONFIG_NETWORK_BUFFER_SIZE
 
+/**
+ * @brief Enable the runtime statistics: health telemetry and reported
+ * properties, GetRuntimeStats command.
+ */
+#ifdef CONFIG_AZURE_RUNTIME_STATS
+    #include "esp_timer.h"
+
+    #define democonfigENABLE_RUNTIME_STATS
+
+/**
+ * @brief Size of the buffer for the command responses, the GetRuntimeStats
+ * report lists every task.
+ */
+    #define democonfigCOMMAND_RESPONSE_BUFFER_SIZE    2048
+
+/**
+ * @brief Measure the TLS handshakes with the microsecond timer, the tick is
+ * too coarse.
+ */
+    #define runtimestatsGET_TIME_MS()                 ( ( uint32_t ) ( esp_timer_get_time() / 1000 ) )
+#endif /* CONFIG_AZURE_RUNTIME_STATS */
+
 /**
  * @brief IoTHub endpoint port.
  */
@@ -21,6 +21,9 @@
 #include "freertos/semphr.h"
 #include "nvs_flash.h"
 
+/* Crypto helper used by the samples. */
+#include "azure_sample_crypto.h"
+
 /* Azure Provisioning/IoT Hub library includes */
 #include "azure_iot_hub_client.h"
 #include "azure_iot_hub_client_properties.h"
@@ -29,6 +32,10 @@
 #include "led.h"
 #include "sensor_manager.h"
 #include "azure_iot_freertos_esp32_sensors_data.h"
+
+#if CONFIG_AZURE_DEFERRED_LOGGING
+    #include "azure_sample_deferred_log.h"
+#endif
 /*-----------------------------------------------------------*/
 
 #define NR_OF_IP_ADDRESSES_TO_WAIT_FOR     1
@@ -71,6 +78,9 @@
 
 #define OLED_SPLASH_MESSAGE                             "Espressif ESP32 Azure IoT Kit"
 
+/* The logs are formatted when nothing else has to run. */
+#define DEFERRED_LOGGING_TASK_PRIORITY                  ( tskIDLE_PRIORITY + 1 )
+
 /*-----------------------------------------------------------*/
 
 static const char * TAG = "sample_azureiotkit";
@@ -79,11 +89,58 @@ static bool xTimeInitialized = false;
 
 static xSemaphoreHandle xSemphGetIpAddrs;
 static esp_ip4_addr_t xIpAddress;
+
+#if CONFIG_AZURE_DEFERRED_LOGGING
+    static vprintf_like_t xUartVprintf;
+#endif
 /*-----------------------------------------------------------*/
 
 extern void vStartDemoTask( void );
 /*-----------------------------------------------------------*/
 
+#if CONFIG_AZURE_DEFERRED_LOGGING
+
+    static int prvUartPrintf( const char * pcFormat,
+                              ... )
+    {
+        va_list xArgs;
+        int lResult;
+
+        va_start( xArgs, pcFormat );
+        lResult = xUartVprintf( pcFormat, xArgs );
+        va_end( xArgs );
+
+        return lResult;
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvDeferredLogWrite( const char * pcText,
+                                     size_t xLength )
+    {
+        ( void ) prvUartPrintf( "%.*s", ( int ) xLength, pcText );
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Record the ESP_LOGx logs and format them in a low priority task.
+ *
+ * If the task cannot be started the logs are printed from the calling task
+ * again.
+ */
+    static void prvInitializeDeferredLogging( void )
+    {
+        xUartVprintf = esp_log_set_vprintf( DeferredLog_VPrintf );
+
+        if( DeferredLog_Init( prvDeferredLogWrite, DEFERRED_LOGGING_TASK_PRIORITY ) != eDeferredLogSuccess )
+        {
+            ( void ) esp_log_set_vprintf( xUartVprintf );
+            ESP_LOGE( TAG, "Failed to start deferred logging" );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* CONFIG_AZURE_DEFERRED_LOGGING */
+
 /**
  * @brief Checks the netif description if it contains specified prefix.
  * All netifs created within common connect component are prefixed with the module TAG,
@@ -327,6 +384,14 @@ uint32_t ulCreateTelemetry( uint8_t * pucTelemetryData,
 {
     *ulTelemetryDataLength = ulSampleCreateTelemetry( pucTelemetryData, ulTelemetryDataSize );
 
+    #if CONFIG_AZURE_RUNTIME_STATS
+        /* The health telemetry is sent in the iterations without step event. */
+        if( *ulTelemetryDataLength == 0 )
+        {
+            *ulTelemetryDataLength = ulSampleCreateHealthTelemetry( pucTelemetryData, ulTelemetryDataSize );
+        }
+    #endif
+
     return 0;     // Returns zero if there could be data to send (also *ulTelemetryDataLength must be > 0)
 }
 /*-----------------------------------------------------------*/
@@ -346,6 +411,10 @@ uint64_t ullGetUnixTime( void )
 
 void app_main( void )
 {
+    #if CONFIG_AZURE_DEFERRED_LOGGING
+        prvInitializeDeferredLogging();
+    #endif
+
     ESP_ERROR_CHECK( nvs_flash_init() );
     ESP_ERROR_CHECK( esp_netif_init() );
     ESP_ERROR_CHECK( esp_event_loop_create_default() );
@@ -354,6 +423,12 @@ void app_main( void )
     /*Allow other core to finish initialization */
     vTaskDelay( pdMS_TO_TICKS( 100 ) );
 
+    if( Crypto_Init() != 0 )
+    {
+        ESP_LOGE( TAG, "HMAC SHA256 self test failed" );
+        return;
+    }
+
     ( void ) prvConnectNetwork();
 
     prvInitializeTime();
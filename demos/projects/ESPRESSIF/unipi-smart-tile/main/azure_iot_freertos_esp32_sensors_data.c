@@ -14,6 +14,10 @@
 
 #include "sample_azure_iot_pnp_data_if.h"
 #include "sensor_manager.h"
+
+#ifdef democonfigENABLE_RUNTIME_STATS
+    #include "azure_sample_runtime_stats.h"
+#endif
 /*-----------------------------------------------------------*/
 
 #define INDEFINITE_TIME    ( ( time_t ) -1 )
@@ -77,6 +81,22 @@ static const char sampleazureiotCOMMAND_RESET_STEPS_COUNTER[] = "ResetStepsCount
 #define sampleazureiotkitDEFAULT_TELEMETRY_FREQUENCY  20
 
 static int lTelemetryFrequencySecs = sampleazureiotkitDEFAULT_TELEMETRY_FREQUENCY;
+
+#ifdef democonfigENABLE_RUNTIME_STATS
+
+/**
+ * @brief Runtime statistics Values
+ */
+    #define sampleazureiotkitRUNTIME_STATS_PROPERTY_NAME    ( "runtimeStats" )
+    #define sampleazureiotkitRUNTIME_STATS_PERIOD_TICKS     pdMS_TO_TICKS( CONFIG_AZURE_RUNTIME_STATS_PERIOD_SECS * 1000U )
+
+    static const char sampleazureiotCOMMAND_GET_RUNTIME_STATS[] = "GetRuntimeStats";
+
+    static RuntimeStatsHealth_t xHealth;
+    static TickType_t xLastHealthTime;
+    static bool xHealthTaken = false;
+    static bool xUpdateRuntimeStatsProperty = false; // the last snapshot is reported once after its telemetry
+#endif /* democonfigENABLE_RUNTIME_STATS */
 /*-----------------------------------------------------------*/
 
 int32_t lGenerateDeviceInfo( uint8_t * pucPropertiesData,
@@ -146,6 +166,18 @@ int32_t lGenerateDeviceInfo( uint8_t * pucPropertiesData,
 }
 /*-----------------------------------------------------------*/
 
+/**
+ * @brief Tells whether a command has a name, which it must match whole.
+ */
+static bool prvIsCommand( const AzureIoTHubClientCommandRequest_t * pxMessage,
+                          const char * pcCommandName,
+                          size_t xCommandNameLength )
+{
+    return ( pxMessage->usCommandNameLength == xCommandNameLength ) &&
+           ( memcmp( pxMessage->pucCommandName, pcCommandName, xCommandNameLength ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Command message callback handler
  */
@@ -160,7 +192,7 @@ uint32_t ulSampleHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
               ( int16_t ) pxMessage->ulPayloadLength,
               ( const char * ) pxMessage->pvMessagePayload );
 
-    if( strncmp( ( const char * ) pxMessage->pucCommandName, sampleazureiotCOMMAND_RESET_STEPS_COUNTER, pxMessage->usCommandNameLength ) == 0 )
+    if( prvIsCommand( pxMessage, sampleazureiotCOMMAND_RESET_STEPS_COUNTER, lengthof( sampleazureiotCOMMAND_RESET_STEPS_COUNTER ) ) )
     {
         steps_counter_reset_steps();
 
@@ -168,6 +200,25 @@ uint32_t ulSampleHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
         ulCommandResponsePayloadLength = lengthof( sampleazureiotCOMMAND_EMPTY_PAYLOAD );
         ( void ) memcpy( pucCommandResponsePayloadBuffer, sampleazureiotCOMMAND_EMPTY_PAYLOAD, ulCommandResponsePayloadLength );
     }
+    #ifdef democonfigENABLE_RUNTIME_STATS
+        else if( prvIsCommand( pxMessage, sampleazureiotCOMMAND_GET_RUNTIME_STATS, lengthof( sampleazureiotCOMMAND_GET_RUNTIME_STATS ) ) )
+        {
+            ulCommandResponsePayloadLength = RuntimeStats_CreateTaskReport( pucCommandResponsePayloadBuffer, ulCommandResponsePayloadBufferSize );
+
+            if( ulCommandResponsePayloadLength > 0 )
+            {
+                *pulResponseStatus = AZ_IOT_STATUS_OK;
+            }
+            else
+            {
+                ESP_LOGE( TAG, "Failed creating the runtime statistics report.\r\n" );
+
+                *pulResponseStatus = AZ_IOT_STATUS_SERVER_ERROR;
+                ulCommandResponsePayloadLength = lengthof( sampleazureiotCOMMAND_EMPTY_PAYLOAD );
+                ( void ) memcpy( pucCommandResponsePayloadBuffer, sampleazureiotCOMMAND_EMPTY_PAYLOAD, ulCommandResponsePayloadLength );
+            }
+        }
+    #endif /* democonfigENABLE_RUNTIME_STATS */
     else
     {
         *pulResponseStatus = AZ_IOT_STATUS_NOT_FOUND;
@@ -243,6 +294,105 @@ uint32_t ulSampleCreateTelemetry( uint8_t * pucTelemetryData,
 }
 /*-----------------------------------------------------------*/
 
+#ifdef democonfigENABLE_RUNTIME_STATS
+
+/**
+ * @brief Writes the last runtime statistics snapshot, as a telemetry message
+ * or nested in the runtimeStats reported property.
+ */
+    static uint32_t prvGenerateRuntimeStats( uint8_t * pucData,
+                                             uint32_t ulDataSize,
+                                             bool xAsProperty )
+    {
+        AzureIoTResult_t xAzIoTResult;
+        AzureIoTJSONWriter_t xWriter;
+        int32_t lBytesWritten;
+
+        xAzIoTResult = AzureIoTJSONWriter_Init( &xWriter, pucData, ulDataSize );
+        configASSERT( xAzIoTResult == eAzureIoTSuccess );
+
+        xAzIoTResult = AzureIoTJSONWriter_AppendBeginObject( &xWriter );
+        configASSERT( xAzIoTResult == eAzureIoTSuccess );
+
+        if( xAsProperty )
+        {
+            xAzIoTResult = AzureIoTJSONWriter_AppendPropertyName( &xWriter, ( const uint8_t * ) sampleazureiotkitRUNTIME_STATS_PROPERTY_NAME,
+                                                                  lengthof( sampleazureiotkitRUNTIME_STATS_PROPERTY_NAME ) );
+            configASSERT( xAzIoTResult == eAzureIoTSuccess );
+
+            xAzIoTResult = AzureIoTJSONWriter_AppendBeginObject( &xWriter );
+            configASSERT( xAzIoTResult == eAzureIoTSuccess );
+        }
+
+        /* The counters grow with the uptime, the buffer may not hold them. */
+        xAzIoTResult = RuntimeStats_AppendHealth( &xWriter, &xHealth );
+
+        if( ( xAzIoTResult == eAzureIoTSuccess ) && xAsProperty )
+        {
+            xAzIoTResult = AzureIoTJSONWriter_AppendEndObject( &xWriter );
+        }
+
+        if( xAzIoTResult == eAzureIoTSuccess )
+        {
+            xAzIoTResult = AzureIoTJSONWriter_AppendEndObject( &xWriter );
+        }
+
+        if( xAzIoTResult != eAzureIoTSuccess )
+        {
+            ESP_LOGE( TAG, "Runtime statistics do not fit in %u bytes.\r\n", ( unsigned ) ulDataSize );
+            return 0;
+        }
+
+        lBytesWritten = AzureIoTJSONWriter_GetBytesUsed( &xWriter );
+        configASSERT( lBytesWritten > 0 );
+
+        return ( uint32_t ) lBytesWritten;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Copies the I2C counters of the bus driver in the runtime statistics.
+ */
+    static void prvUpdateI2CStats( void )
+    {
+        i2c_bus_device_stats_t xI2CStats;
+
+        if( steps_counter_get_i2c_stats( &xI2CStats ) == ESP_OK )
+        {
+            RuntimeStats_SetCounter( eRuntimeStatsI2CTransactions, xI2CStats.transactions );
+            RuntimeStats_SetCounter( eRuntimeStatsI2CErrors, xI2CStats.errors );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    uint32_t ulSampleCreateHealthTelemetry( uint8_t * pucTelemetryData,
+                                            uint32_t ulTelemetryDataLength )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        if( xHealthTaken && ( ( xNow - xLastHealthTime ) < sampleazureiotkitRUNTIME_STATS_PERIOD_TICKS ) )
+        {
+            return 0;
+        }
+
+        xLastHealthTime = xNow;
+        xHealthTaken = true;
+
+        prvUpdateI2CStats();
+
+        if( RuntimeStats_TakeHealthSnapshot( &xHealth ) != pdPASS )
+        {
+            ESP_LOGE( TAG, "Failed taking the runtime statistics snapshot.\r\n" );
+            return 0;
+        }
+
+        xUpdateRuntimeStatsProperty = true;
+
+        return prvGenerateRuntimeStats( pucTelemetryData, ulTelemetryDataLength, false );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* democonfigENABLE_RUNTIME_STATS */
 
 /**
  * @brief Acknowledges the update of Telemetry Frequency property.
@@ -387,6 +537,14 @@ uint32_t ulSampleCreateReportedPropertiesUpdate( uint8_t * pucPropertiesData,
         xUpdateDeviceProperties = false;
     } // if false the buffer remains unchanged
 
+    #ifdef democonfigENABLE_RUNTIME_STATS
+        if( ( lBytesWritten == 0 ) && xUpdateRuntimeStatsProperty )
+        {
+            lBytesWritten = prvGenerateRuntimeStats( pucPropertiesData, ulPropertiesDataSize, true );
+            xUpdateRuntimeStatsProperty = false;
+        }
+    #endif
+
     return lBytesWritten;
 }
 /*-----------------------------------------------------------*/
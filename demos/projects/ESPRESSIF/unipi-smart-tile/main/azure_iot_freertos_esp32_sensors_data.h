@@ -45,6 +45,19 @@ uint32_t ulSampleHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
 uint32_t ulSampleCreateTelemetry( uint8_t * pucTelemetryData,
                                   uint32_t ulTelemetryDataLength );
 
+/**
+ * @brief Generates the health telemetry once per runtime statistics period,
+ * when the runtime statistics are enabled.
+ *
+ * @param pucTelemetryData Buffer to write telemetry into.
+ * @param ulTelemetryDataLength Size of the buffer.
+ *
+ * @return uint32_t Number of bytes written into the buffer, zero if the period
+ * has not elapsed.
+ */
+uint32_t ulSampleCreateHealthTelemetry( uint8_t * pucTelemetryData,
+                                        uint32_t ulTelemetryDataLength );
+
 /**
  * @brief Handler for writable properties updates.
  *
@@ -9,6 +9,7 @@
 
 #include "driver/gptimer.h"
 #include "driver/i2c.h"
+#include "iot_i2c_bus.h"
 
 #define ABS(x)  ( ((x) > 0) ? (x) : -(x) )
 #define CLAMP_HIGH(x, max)   ( ( (x) < (max) ) ? (x) : (max) )
@@ -74,19 +75,17 @@ static int32_t step_duration_ms;
 static volatile int32_t step_duration_ms_exp;
 static volatile int fresh_data = 0;
 
+static i2c_bus_handle_t i2c_bus;
+
 static esp_err_t mpu6050_register_read(uint8_t reg_addr, uint8_t *data, size_t len){
-    return i2c_master_write_read_device(I2C_MASTER_NUM, MPU6050_SENSOR_ADDR, &reg_addr, 1, data, len, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    return iot_i2c_bus_read_reg(i2c_bus, MPU6050_SENSOR_ADDR, reg_addr, data, len, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
 }
 
 static esp_err_t mpu6050_register_write_byte(uint8_t reg_addr, uint8_t data){
-    int ret;
-    uint8_t write_buf[2] = {reg_addr, data};
-    ret = i2c_master_write_to_device(I2C_MASTER_NUM, MPU6050_SENSOR_ADDR, write_buf, sizeof(write_buf), I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    return ret;
+    return iot_i2c_bus_write_reg(i2c_bus, MPU6050_SENSOR_ADDR, reg_addr, &data, 1, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
 }
 
 static esp_err_t i2c_master_init(void){
-    int i2c_master_port = I2C_MASTER_NUM;
     i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
         .sda_io_num = I2C_MASTER_SDA_IO,
@@ -95,8 +94,8 @@ static esp_err_t i2c_master_init(void){
         .scl_pullup_en = GPIO_PULLUP_ENABLE,
         .master.clk_speed = I2C_MASTER_FREQ_HZ,
     };
-    i2c_param_config(i2c_master_port, &conf);
-    return i2c_driver_install(i2c_master_port, conf.mode, 0, 0, 0);
+    i2c_bus = iot_i2c_bus_create(I2C_MASTER_NUM, &conf);
+    return (i2c_bus != NULL) ? ESP_OK : ESP_FAIL;
 }
 
 /* Returns time in millis for algorithm evaluation */
@@ -197,6 +196,10 @@ void steps_counter_reset_steps(){
     }
 }
 
+esp_err_t steps_counter_get_i2c_stats(i2c_bus_device_stats_t *stats){
+    return iot_i2c_bus_get_device_stats(i2c_bus, I2C_BUS_ALL_DEVICES, stats);
+}
+
 void accel_init(){
     ESP_ERROR_CHECK(i2c_master_init());
     ESP_ERROR_CHECK(mpu6050_register_write_byte(MPU6050_PWR_MGMT_1_REG_ADDR, MPU6050_PWR_MGMT_1_VALUE));
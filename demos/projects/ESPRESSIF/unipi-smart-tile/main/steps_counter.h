@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "esp_err.h"
+#include "iot_i2c_bus.h"
 
 /*
  * Initialize the library and the accelerometer
@@ -33,4 +34,10 @@ void steps_counter_reset_steps();
  **/
 int steps_counter_get_data(int32_t *steps, float *accel_peak, int32_t *step_duration_ms, float *step_energy);
 
+/**
+ * Get the counters of the transactions with every device of the I2C bus of
+ * the accelerometer. Returns ESP_ERR_NOT_FOUND before the first one.
+ **/
+esp_err_t steps_counter_get_i2c_stats(i2c_bus_device_stats_t *stats);
+
 #endif /* STEPS_COUNTER_H_INCLUDED */
@@ -0,0 +1,392 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Benchmarks of an ADU update written to the file-backed flash, from a raw
+ * image, from a compressed payload and from a delta payload against the
+ * previous image. The raw image is also written in chunks of a TCP segment,
+ * straight to the flash and gathered into sectors. The measured time is the one of the device side, writing,
+ * decompressing and patching; the time to update adds the transfer of the
+ * payload over a link of benchmarkADU_LINK_BYTES_PER_SECOND.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+
+/* ADU includes. */
+#include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_sector.h"
+#include "sample_azure_iot_adu_coalesce.h"
+#include "sample_azure_iot_adu_compressed.h"
+#include "sample_azure_iot_adu_delta.h"
+#include "adu_image_compress.h"
+#include "adu_image_delta.h"
+
+#define benchmarkADU_IMAGE_SIZE              ( 256U * 1024U )
+#define benchmarkADU_CHUNK_SIZE              ( 4096U )
+
+/* The payload of an Ethernet TCP segment. */
+#define benchmarkADU_SEGMENT_SIZE            ( 1460U )
+
+/* About 1 Mbit/s, a cellular link. */
+#define benchmarkADU_LINK_BYTES_PER_SECOND    ( 128U * 1024U )
+
+/*-----------------------------------------------------------*/
+
+static uint8_t ucImage[ benchmarkADU_IMAGE_SIZE ];
+static uint8_t ucPayload[ aduimagecompressMAX_PAYLOAD_SIZE( benchmarkADU_IMAGE_SIZE ) ];
+static size_t xPayloadLength;
+static char cPayloadHash[ 45 ];
+static uint8_t ucSource[ benchmarkADU_IMAGE_SIZE ];
+static uint8_t * pucDelta;
+static size_t xDeltaLength;
+static char cDeltaHash[ 45 ];
+static char cFlashPath[ 64 ];
+static char cSourcePath[ 64 ];
+static AzureADUImage_t xImage;
+static SampleADUCompressed_t xCompressed;
+static SampleADUDelta_t xDelta;
+static SampleADUCoalesce_t xCoalesce;
+static uint64_t ullUpdateNs;
+static uint32_t ulUpdates;
+
+/*-----------------------------------------------------------*/
+
+/* Code-like data with runs of zeros and text, see test_adu_compressed.c. */
+static void prvFillImage( void )
+{
+    static const uint32_t ulWords[] = { 0x4770b510, 0x68004b03, 0xf7ff2100, 0x46c0bd10, 0x20004a02, 0x60184b01 };
+    static const char cText[] = "Azure IoT middleware for FreeRTOS, ADU agent ready. ";
+    uint32_t ulSeed = 12345;
+    uint32_t ulOffset;
+    uint32_t ulWord;
+
+    for( ulOffset = 0; ulOffset < benchmarkADU_IMAGE_SIZE; ulOffset += 4U )
+    {
+        ulSeed = ulSeed * 1103515245U + 12345U;
+
+        switch( ( ulSeed >> 16 ) % 8U )
+        {
+            case 0:
+                ulWord = 0;
+                break;
+
+            case 1:
+                ulWord = ( uint32_t ) cText[ ( ulOffset / 4U ) % ( sizeof( cText ) - 1U ) ] * 0x01010101U;
+                break;
+
+            case 2:
+                ulWord = ulSeed;
+                break;
+
+            default:
+                ulWord = ulWords[ ( ulSeed >> 20 ) % 6U ] ^ ( ( ulSeed >> 28 ) << 8 );
+                break;
+        }
+
+        ( void ) memcpy( &ucImage[ ulOffset ], &ulWord, sizeof( ulWord ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSetup( void )
+{
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "/tmp/benchmark_adu_%ld.bin", ( long ) getpid() );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+
+    prvFillImage();
+
+    if( ( ADUImageCompress_Pack( ucImage, benchmarkADU_IMAGE_SIZE,
+                                 aduimagecompressDEFAULT_WINDOW_BITS, aduimagecompressDEFAULT_LOOKAHEAD_BITS,
+                                 ucPayload, sizeof( ucPayload ), &xPayloadLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( ucPayload, xPayloadLength, cPayloadHash ) != 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    ullUpdateNs = 0;
+    ulUpdates = 0;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* The previous image misses a function of the new one, and calls addresses
+ * which moved. */
+static BaseType_t prvDeltaSetup( void )
+{
+    FILE * pxFile;
+    uint32_t ulOffset;
+
+    if( prvSetup() != pdPASS )
+    {
+        return pdFAIL;
+    }
+
+    ( void ) memcpy( ucSource, ucImage, benchmarkADU_IMAGE_SIZE / 2U );
+    ( void ) memcpy( &ucSource[ benchmarkADU_IMAGE_SIZE / 2U ], &ucImage[ benchmarkADU_IMAGE_SIZE / 2U + 2048U ],
+                     benchmarkADU_IMAGE_SIZE / 2U - 2048U );
+
+    for( ulOffset = benchmarkADU_IMAGE_SIZE / 2U; ulOffset < benchmarkADU_IMAGE_SIZE - 2048U; ulOffset += 1024U )
+    {
+        ucSource[ ulOffset ] -= 8U;
+    }
+
+    ( void ) snprintf( cSourcePath, sizeof( cSourcePath ), "/tmp/benchmark_adu_source_%ld.bin", ( long ) getpid() );
+    ( void ) setenv( "AZURE_IOT_FLASH_SOURCE_FILE", cSourcePath, 1 );
+
+    if( ( ( pxFile = fopen( cSourcePath, "wb" ) ) == NULL ) ||
+        ( fwrite( ucSource, 1, benchmarkADU_IMAGE_SIZE - 2048U, pxFile ) != benchmarkADU_IMAGE_SIZE - 2048U ) ||
+        ( fclose( pxFile ) != 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    if( ( ADUImageDelta_Create( ucSource, benchmarkADU_IMAGE_SIZE - 2048U, ucImage, benchmarkADU_IMAGE_SIZE,
+                                aduimagecompressDEFAULT_WINDOW_BITS, aduimagedeltaDEFAULT_LOOKAHEAD_BITS,
+                                &pucDelta, &xDeltaLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( pucDelta, xDeltaLength, cDeltaHash ) != 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvRawRun( void )
+{
+    uint64_t ullStartNs = ullBenchmarkNowNs();
+    uint32_t ulOffset;
+
+    if( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess )
+    {
+        return pdFAIL;
+    }
+
+    for( ulOffset = 0; ulOffset < benchmarkADU_IMAGE_SIZE; ulOffset += benchmarkADU_CHUNK_SIZE )
+    {
+        if( AzureIoTPlatform_WriteBlock( &xImage, ulOffset, &ucImage[ ulOffset ], benchmarkADU_CHUNK_SIZE ) != eAzureIoTSuccess )
+        {
+            return pdFAIL;
+        }
+    }
+
+    ullUpdateNs += ullBenchmarkNowNs() - ullStartNs;
+    ulUpdates++;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSegmentsRun( BaseType_t xCoalesced )
+{
+    uint64_t ullStartNs = ullBenchmarkNowNs();
+    AzureIoTResult_t xResult;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Init( &xCoalesce, &xImage, 0, benchmarkADU_IMAGE_SIZE ) != eAzureIoTSuccess ) )
+    {
+        return pdFAIL;
+    }
+
+    for( ulOffset = 0; ulOffset < benchmarkADU_IMAGE_SIZE; ulOffset += ulLength )
+    {
+        ulLength = ( benchmarkADU_IMAGE_SIZE - ulOffset < benchmarkADU_SEGMENT_SIZE ) ?
+                   benchmarkADU_IMAGE_SIZE - ulOffset : benchmarkADU_SEGMENT_SIZE;
+
+        if( xCoalesced == pdTRUE )
+        {
+            xResult = SampleADUCoalesce_Write( &xCoalesce, ulOffset, &ucImage[ ulOffset ], ulLength );
+        }
+        else
+        {
+            xResult = AzureIoTPlatform_WriteBlock( &xImage, ulOffset, &ucImage[ ulOffset ], ulLength );
+        }
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            return pdFAIL;
+        }
+    }
+
+    ullUpdateNs += ullBenchmarkNowNs() - ullStartNs;
+    ulUpdates++;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvUnalignedRun( void )
+{
+    return prvSegmentsRun( pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCoalescedRun( void )
+{
+    return prvSegmentsRun( pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCompressedRun( void )
+{
+    uint64_t ullStartNs = ullBenchmarkNowNs();
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUCompressed_Init( &xCompressed, &xImage ) != eAzureIoTSuccess ) )
+    {
+        return pdFAIL;
+    }
+
+    for( ulOffset = 0; ulOffset < xPayloadLength; ulOffset += ulLength )
+    {
+        ulLength = ( xPayloadLength - ulOffset < benchmarkADU_CHUNK_SIZE ) ?
+                   ( uint32_t ) ( xPayloadLength - ulOffset ) : benchmarkADU_CHUNK_SIZE;
+
+        if( SampleADUCompressed_Write( &xCompressed, &ucPayload[ ulOffset ], ulLength ) != eAzureIoTSuccess )
+        {
+            return pdFAIL;
+        }
+    }
+
+    if( SampleADUCompressed_Finish( &xCompressed, ( const uint8_t * ) cPayloadHash, strlen( cPayloadHash ) ) != eAzureIoTSuccess )
+    {
+        return pdFAIL;
+    }
+
+    ullUpdateNs += ullBenchmarkNowNs() - ullStartNs;
+    ulUpdates++;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvDeltaRun( void )
+{
+    uint64_t ullStartNs = ullBenchmarkNowNs();
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUDelta_Init( &xDelta, &xImage ) != eAzureIoTSuccess ) )
+    {
+        return pdFAIL;
+    }
+
+    for( ulOffset = 0; ulOffset < xDeltaLength; ulOffset += ulLength )
+    {
+        ulLength = ( xDeltaLength - ulOffset < benchmarkADU_CHUNK_SIZE ) ?
+                   ( uint32_t ) ( xDeltaLength - ulOffset ) : benchmarkADU_CHUNK_SIZE;
+
+        if( SampleADUDelta_Write( &xDelta, &pucDelta[ ulOffset ], ulLength ) != eAzureIoTSuccess )
+        {
+            return pdFAIL;
+        }
+    }
+
+    if( SampleADUDelta_Finish( &xDelta, ( const uint8_t * ) cDeltaHash, strlen( cDeltaHash ) ) != eAzureIoTSuccess )
+    {
+        return pdFAIL;
+    }
+
+    ullUpdateNs += ullBenchmarkNowNs() - ullStartNs;
+    ulUpdates++;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* Bytes transferred, time to update and flash operations of the last update,
+ * next to the result of the harness. */
+static void prvReport( const char * pcName,
+                       size_t xTransferredBytes )
+{
+    double xTransferMs = ( 1000.0 * ( double ) xTransferredBytes ) / ( double ) benchmarkADU_LINK_BYTES_PER_SECOND;
+    double xWriteMs = ( ulUpdates > 0U ) ? ( double ) ullUpdateNs / ( 1000000.0 * ( double ) ulUpdates ) : 0.0;
+    AzureADUFlashCounters_t xCounters;
+
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xCounters );
+
+    printf( "{\"benchmark\":\"%s\",\"image_bytes\":%u,\"transferred_bytes\":%u,"
+            "\"link_bytes_per_s\":%u,\"write_ms\":%.2f,\"time_to_update_ms\":%.1f,"
+            "\"flash_writes\":%u,\"page_programs\":%u,\"partial_page_programs\":%u,\"sector_erases\":%u}\n",
+            pcName,
+            ( unsigned ) benchmarkADU_IMAGE_SIZE,
+            ( unsigned ) xTransferredBytes,
+            ( unsigned ) benchmarkADU_LINK_BYTES_PER_SECOND,
+            xWriteMs,
+            xTransferMs + xWriteMs,
+            ( unsigned ) xCounters.ulWrites,
+            ( unsigned ) xCounters.ulPagePrograms,
+            ( unsigned ) xCounters.ulPartialPagePrograms,
+            ( unsigned ) xCounters.ulSectorErases );
+    fflush( stdout );
+
+    ( void ) close( xImage.lFileDescriptor );
+    xImage.lFileDescriptor = 0;
+    ( void ) unlink( cFlashPath );
+}
+/*-----------------------------------------------------------*/
+
+static void prvRawTeardown( void )
+{
+    prvReport( "adu_update_raw", benchmarkADU_IMAGE_SIZE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUnalignedTeardown( void )
+{
+    prvReport( "adu_update_unaligned", benchmarkADU_IMAGE_SIZE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCoalescedTeardown( void )
+{
+    prvReport( "adu_update_coalesced", benchmarkADU_IMAGE_SIZE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCompressedTeardown( void )
+{
+    prvReport( "adu_update_heatshrink", xPayloadLength );
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeltaTeardown( void )
+{
+    prvReport( "adu_update_delta", xDeltaLength );
+
+    if( xImage.lSourceFileDescriptor > 0 )
+    {
+        ( void ) close( xImage.lSourceFileDescriptor );
+        xImage.lSourceFileDescriptor = 0;
+    }
+
+    ( void ) unlink( cSourcePath );
+    free( pucDelta );
+    pucDelta = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static const BenchmarkCase_t xADUUpdateCases[] =
+{
+    { "adu_update_raw",        2, 20, prvSetup,      NULL, prvRawRun,        prvRawTeardown        },
+    { "adu_update_unaligned",  2, 20, prvSetup,      NULL, prvUnalignedRun,  prvUnalignedTeardown  },
+    { "adu_update_coalesced",  2, 20, prvSetup,      NULL, prvCoalescedRun,  prvCoalescedTeardown  },
+    { "adu_update_heatshrink", 2, 20, prvSetup,      NULL, prvCompressedRun, prvCompressedTeardown },
+    { "adu_update_delta",      2, 20, prvDeltaSetup, NULL, prvDeltaRun,      prvDeltaTeardown      },
+};
+
+const BenchmarkSuite_t xADUUpdateBenchmarks = { xADUUpdateCases, sizeof( xADUUpdateCases ) / sizeof( xADUUpdateCases[ 0 ] ) };
+/*-----------------------------------------------------------*/
@@ -0,0 +1,446 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Benchmarks of the CA recovery path: parsing the recovery payload, verifying
+ * the RS256 signature of its trust bundle, converting the bundle to DER, and
+ * loading the root CAs at the TLS setup from PEM and from the DER bundle.
+ *
+ * The stream parser is fed the payload in pieces of a network read, hashing
+ * the signed text and writing the certificates as it goes, and the signature
+ * is verified over that hash.
+ *
+ * RS256 verification is measured with 2048- and 3072-bit keys, imported for
+ * every signature and once by a verifier, alone and in batches.
+ *
+ * A large bundle, the roots of the vector repeated and the certificate of the
+ * TLS server last, compares the verification of the server certificate with
+ * the whole bundle parsed as the CA chain, and with the CAs looked up in the
+ * index by the trusted CA callback.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+#include "benchmark_vectors.h"
+
+/* CA recovery includes. */
+#include "azure_ca_recovery_parse.h"
+#include "azure_ca_recovery_rsa_verify.h"
+#include "azure_ca_recovery_stream.h"
+#include "azure_ca_recovery_trust_bundle.h"
+
+/* TLS transport includes. */
+#include "transport_tls_trust_bundle.h"
+
+#include "mbedtls/x509_crt.h"
+
+/*-----------------------------------------------------------*/
+
+static uint8_t ucPayloadBuffer[ sizeof( benchmarkRECOVERY_PAYLOAD ) ];
+static uint8_t ucSignatureValidateScratchBuffer[ azureiotrsaverifySHA_CALCULATION_SCRATCH_SIZE ];
+static uint8_t ucTrustBundleBuffer[ sizeof( benchmarkTRUST_BUNDLE_PEM ) ];
+static uint32_t ulTrustBundleLength;
+
+/* Signatures checked by a batch of the verifier. */
+#define benchmarkVERIFY_BATCH_SIZE      8U
+
+static AzureIoTSample_RS256Verifier xVerifier;
+static AzureIoTSample_RS256VerifyItem xVerifyItems[ benchmarkVERIFY_BATCH_SIZE ];
+
+/* Size of the pieces the payload is streamed in. */
+#define benchmarkSTREAM_PIECE_SIZE      256U
+
+static AzureIoTCARecovery_StreamParser xStreamParser;
+static uint8_t ucCertificatesBuffer[ sizeof( benchmarkRECOVERY_PAYLOAD ) ];
+
+/* Copies of the roots of the vector in the large bundle. */
+#define benchmarkLARGE_BUNDLE_COPIES    16U
+
+static uint8_t ucLargeBundleBuffer[ benchmarkLARGE_BUNDLE_COPIES * ( sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1 ) +
+                                    sizeof( benchmarkTLS_SERVER_CERTIFICATE ) ];
+static uint32_t ulLargeBundleLength;
+static mbedtls_x509_crt xServerCertificate;
+
+/*-----------------------------------------------------------*/
+
+/* The parser unescapes the payload in place, start every iteration from a
+ * fresh copy. */
+static void prvParsePrepare( void )
+{
+    memcpy( ucPayloadBuffer, benchmarkRECOVERY_PAYLOAD, sizeof( benchmarkRECOVERY_PAYLOAD ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParseRun( void )
+{
+    AzureIoTJSONReader_t xReader;
+    AzureIoTCARecovery_RecoveryPayload xPayload;
+
+    if( ( AzureIoTJSONReader_Init( &xReader, ucPayloadBuffer, sizeof( benchmarkRECOVERY_PAYLOAD ) - 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTCARecovery_ParseRecoveryPayload( &xReader, &xPayload ) != eAzureIoTSuccess ) ||
+        ( xPayload.ulTrustBundleJSONObjectTextLength != sizeof( benchmarkRECOVERY_TRUST_BUNDLE ) - 1 ) )
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifyRun( void )
+{
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTSample_RS256Verify( ( uint8_t * ) benchmarkRECOVERY_TRUST_BUNDLE,
+                                          sizeof( benchmarkRECOVERY_TRUST_BUNDLE ) - 1,
+                                          ( uint8_t * ) benchmarkRECOVERY_SIGNATURE,
+                                          sizeof( benchmarkRECOVERY_SIGNATURE ) - 1,
+                                          ( uint8_t * ) ucBenchmarkRecoveryKeyN,
+                                          sizeof( ucBenchmarkRecoveryKeyN ),
+                                          ( uint8_t * ) ucBenchmarkRecoveryKeyE,
+                                          sizeof( ucBenchmarkRecoveryKeyE ),
+                                          ucSignatureValidateScratchBuffer,
+                                          sizeof( ucSignatureValidateScratchBuffer ) );
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerify2048Run( void )
+{
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTSample_RS256Verify( ( uint8_t * ) benchmarkRECOVERY_TRUST_BUNDLE,
+                                          sizeof( benchmarkRECOVERY_TRUST_BUNDLE ) - 1,
+                                          ( uint8_t * ) benchmarkRECOVERY_SIGNATURE_2048,
+                                          sizeof( benchmarkRECOVERY_SIGNATURE_2048 ) - 1,
+                                          ( uint8_t * ) ucBenchmarkRecoveryKey2048N,
+                                          sizeof( ucBenchmarkRecoveryKey2048N ),
+                                          ( uint8_t * ) ucBenchmarkRecoveryKeyE,
+                                          sizeof( ucBenchmarkRecoveryKeyE ),
+                                          ucSignatureValidateScratchBuffer,
+                                          sizeof( ucSignatureValidateScratchBuffer ) );
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifierSetup( const uint8_t * pucN,
+                                    uint32_t ulNLength,
+                                    const char * pcSignature,
+                                    uint32_t ulSignatureLength )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < benchmarkVERIFY_BATCH_SIZE; ulIndex++ )
+    {
+        xVerifyItems[ ulIndex ].pucInput = ( const uint8_t * ) benchmarkRECOVERY_TRUST_BUNDLE;
+        xVerifyItems[ ulIndex ].ulInputLength = sizeof( benchmarkRECOVERY_TRUST_BUNDLE ) - 1;
+        xVerifyItems[ ulIndex ].pucHash = NULL;
+        xVerifyItems[ ulIndex ].pucSignature = ( uint8_t * ) pcSignature;
+        xVerifyItems[ ulIndex ].ulSignatureLength = ulSignatureLength;
+    }
+
+    if( AzureIoTSample_RS256VerifierInit( &xVerifier, ( uint8_t * ) pucN, ulNLength,
+                                          ( uint8_t * ) ucBenchmarkRecoveryKeyE,
+                                          sizeof( ucBenchmarkRecoveryKeyE ) ) != eAzureIoTSuccess )
+    {
+        AzureIoTSample_RS256VerifierDeinit( &xVerifier );
+
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifier2048Setup( void )
+{
+    return prvVerifierSetup( ucBenchmarkRecoveryKey2048N, sizeof( ucBenchmarkRecoveryKey2048N ),
+                             benchmarkRECOVERY_SIGNATURE_2048, sizeof( benchmarkRECOVERY_SIGNATURE_2048 ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifier3072Setup( void )
+{
+    return prvVerifierSetup( ucBenchmarkRecoveryKeyN, sizeof( ucBenchmarkRecoveryKeyN ),
+                             benchmarkRECOVERY_SIGNATURE, sizeof( benchmarkRECOVERY_SIGNATURE ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifierRun( void )
+{
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTSample_RS256VerifierVerify( &xVerifier,
+                                                  xVerifyItems[ 0 ].pucInput,
+                                                  xVerifyItems[ 0 ].ulInputLength,
+                                                  xVerifyItems[ 0 ].pucSignature,
+                                                  xVerifyItems[ 0 ].ulSignatureLength,
+                                                  ucSignatureValidateScratchBuffer,
+                                                  sizeof( ucSignatureValidateScratchBuffer ) );
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvVerifierBatchRun( void )
+{
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTSample_RS256VerifierVerifyBatch( &xVerifier,
+                                                       xVerifyItems,
+                                                       benchmarkVERIFY_BATCH_SIZE,
+                                                       ucSignatureValidateScratchBuffer,
+                                                       sizeof( ucSignatureValidateScratchBuffer ) );
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+/* The counters of the verifier, over the warmup and the iterations. */
+static void prvVerifierTeardown( void )
+{
+    printf( "{\"benchmark\":\"ca_recovery_rs256_verifier_counters\",\"key_bits\":%u,\"setup_us\":%u,"
+            "\"verifications\":%u,\"failures\":%u,\"verify_us\":%llu}\n",
+            ( unsigned ) ( mbedtls_rsa_get_len( &xVerifier.xRSAContext ) * 8U ),
+            ( unsigned ) xVerifier.ulSetupTimeUs,
+            ( unsigned ) xVerifier.ulVerifications,
+            ( unsigned ) xVerifier.ulFailures,
+            ( unsigned long long ) xVerifier.ullVerifyTimeUs );
+    fflush( stdout );
+
+    AzureIoTSample_RS256VerifierDeinit( &xVerifier );
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvCertificatesWrite( void * pvContext,
+                                              uint32_t ulOffset,
+                                              const uint8_t * pucData,
+                                              uint32_t ulLength )
+{
+    ( void ) pvContext;
+
+    if( ulLength > sizeof( ucCertificatesBuffer ) - ulOffset )
+    {
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    memcpy( ucCertificatesBuffer + ulOffset, pucData, ulLength );
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvStreamVerifyRun( void )
+{
+    const uint8_t * pucPayload = ( const uint8_t * ) benchmarkRECOVERY_PAYLOAD;
+    uint32_t ulPayloadLength = sizeof( benchmarkRECOVERY_PAYLOAD ) - 1;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTCARecovery_StreamInit( &xStreamParser, prvCertificatesWrite, NULL );
+
+    for( ulOffset = 0; ( xResult == eAzureIoTSuccess ) && ( ulOffset < ulPayloadLength ); ulOffset += ulLength )
+    {
+        ulLength = ulPayloadLength - ulOffset;
+        ulLength = ulLength < benchmarkSTREAM_PIECE_SIZE ? ulLength : benchmarkSTREAM_PIECE_SIZE;
+        xResult = AzureIoTCARecovery_StreamFeed( &xStreamParser, pucPayload + ulOffset, ulLength );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTCARecovery_StreamFinish( &xStreamParser );
+    }
+
+    AzureIoTCARecovery_StreamDeinit( &xStreamParser );
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTSample_RS256VerifyHash( xStreamParser.ucTrustBundleHash,
+                                                  xStreamParser.ucSignature,
+                                                  xStreamParser.ulSignatureLength,
+                                                  ( uint8_t * ) ucBenchmarkRecoveryKeyN,
+                                                  sizeof( ucBenchmarkRecoveryKeyN ),
+                                                  ( uint8_t * ) ucBenchmarkRecoveryKeyE,
+                                                  sizeof( ucBenchmarkRecoveryKeyE ),
+                                                  ucSignatureValidateScratchBuffer,
+                                                  sizeof( ucSignatureValidateScratchBuffer ) );
+    }
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+/* The conversion is in place, start every iteration from the PEM. */
+static void prvConvertPrepare( void )
+{
+    memcpy( ucTrustBundleBuffer, benchmarkTRUST_BUNDLE_PEM, sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvConvertRun( void )
+{
+    AzureIoTResult_t xResult;
+
+    xResult = AzureIoTCARecovery_ConvertTrustBundle( ucTrustBundleBuffer,
+                                                     sizeof( ucTrustBundleBuffer ),
+                                                     sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1,
+                                                     &ulTrustBundleLength );
+
+    return ( xResult == eAzureIoTSuccess ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParsePemRun( void )
+{
+    mbedtls_x509_crt xChain;
+    int32_t lMbedtlsError;
+
+    mbedtls_x509_crt_init( &xChain );
+    lMbedtlsError = mbedtls_x509_crt_parse( &xChain,
+                                            ( const unsigned char * ) benchmarkTRUST_BUNDLE_PEM,
+                                            sizeof( benchmarkTRUST_BUNDLE_PEM ) );
+    mbedtls_x509_crt_free( &xChain );
+
+    return ( lMbedtlsError == 0 ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParseBundleSetup( void )
+{
+    prvConvertPrepare();
+
+    return prvConvertRun();
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParseBundleRun( void )
+{
+    mbedtls_x509_crt xChain;
+    int32_t lMbedtlsError;
+
+    mbedtls_x509_crt_init( &xChain );
+    lMbedtlsError = TLS_TrustBundle_Parse( &xChain, ucTrustBundleBuffer, ulTrustBundleLength );
+    mbedtls_x509_crt_free( &xChain );
+
+    return ( lMbedtlsError == 0 ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+/* The flash taken by each form of the root CAs. */
+static void prvParseBundleTeardown( void )
+{
+    printf( "{\"benchmark\":\"ca_recovery_trust_bundle_size\",\"certificates\":%u,\"pem_bytes\":%u,\"bundle_bytes\":%u}\n",
+            ( unsigned ) TLS_TrustBundle_GetCount( ucTrustBundleBuffer, ulTrustBundleLength ),
+            ( unsigned ) ( sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1 ),
+            ( unsigned ) ulTrustBundleLength );
+    fflush( stdout );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvLargeBundleSetup( void )
+{
+    uint32_t ulPemLength = 0;
+    uint32_t ulCopy;
+
+    for( ulCopy = 0; ulCopy < benchmarkLARGE_BUNDLE_COPIES; ulCopy++ )
+    {
+        memcpy( ucLargeBundleBuffer + ulPemLength, benchmarkTRUST_BUNDLE_PEM, sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1 );
+        ulPemLength += sizeof( benchmarkTRUST_BUNDLE_PEM ) - 1;
+    }
+
+    memcpy( ucLargeBundleBuffer + ulPemLength, benchmarkTLS_SERVER_CERTIFICATE, sizeof( benchmarkTLS_SERVER_CERTIFICATE ) - 1 );
+    ulPemLength += sizeof( benchmarkTLS_SERVER_CERTIFICATE ) - 1;
+
+    mbedtls_x509_crt_init( &xServerCertificate );
+
+    if( ( AzureIoTCARecovery_ConvertTrustBundle( ucLargeBundleBuffer, sizeof( ucLargeBundleBuffer ),
+                                                 ulPemLength, &ulLargeBundleLength ) != eAzureIoTSuccess ) ||
+        ( mbedtls_x509_crt_parse( &xServerCertificate, ( const unsigned char * ) benchmarkTLS_SERVER_CERTIFICATE,
+                                  sizeof( benchmarkTLS_SERVER_CERTIFICATE ) ) != 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvLargeBundleTeardown( void )
+{
+    mbedtls_x509_crt_free( &xServerCertificate );
+}
+/*-----------------------------------------------------------*/
+
+/* What a connection costs with the bundle as the CA chain: all of it parsed
+ * and kept until the end of the connection. */
+static BaseType_t prvVerifyChainRun( void )
+{
+    mbedtls_x509_crt xChain;
+    uint32_t ulFlags = 0;
+    int32_t lMbedtlsError;
+
+    mbedtls_x509_crt_init( &xChain );
+    lMbedtlsError = TLS_TrustBundle_Parse( &xChain, ucLargeBundleBuffer, ulLargeBundleLength );
+
+    if( lMbedtlsError == 0 )
+    {
+        lMbedtlsError = mbedtls_x509_crt_verify( &xServerCertificate, &xChain, NULL,
+                                                 "localhost", &ulFlags, NULL, NULL );
+    }
+
+    mbedtls_x509_crt_free( &xChain );
+
+    return ( lMbedtlsError == 0 ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+#if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+
+    static BaseType_t prvVerifyCallbackRun( void )
+    {
+        TlsTrustBundle_t xTrustBundle;
+        uint32_t ulFlags = 0;
+        int32_t lMbedtlsError;
+
+        xTrustBundle.pucBundle = ucLargeBundleBuffer;
+        xTrustBundle.ulCount = TLS_TrustBundle_GetCount( ucLargeBundleBuffer, ulLargeBundleLength );
+
+        lMbedtlsError = mbedtls_x509_crt_verify_with_ca_cb( &xServerCertificate,
+                                                            TLS_TrustBundle_CaCallback, &xTrustBundle,
+                                                            &mbedtls_x509_crt_profile_default,
+                                                            "localhost", &ulFlags, NULL, NULL );
+
+        return ( lMbedtlsError == 0 ) ? pdPASS : pdFAIL;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+
+static const BenchmarkCase_t xCARecoveryCases[] =
+{
+    { "ca_recovery_parse_payload",             100, 20000, NULL,                 prvParsePrepare,   prvParseRun,          NULL                   },
+    { "ca_recovery_rs256_verify",              10,  500,   NULL,                 NULL,              prvVerifyRun,         NULL                   },
+    { "ca_recovery_rs256_verify_2048",         10,  500,   NULL,                 NULL,              prvVerify2048Run,     NULL                   },
+    { "ca_recovery_rs256_verifier_2048",       10,  500,   prvVerifier2048Setup, NULL,              prvVerifierRun,       prvVerifierTeardown    },
+    { "ca_recovery_rs256_verifier_3072",       10,  500,   prvVerifier3072Setup, NULL,              prvVerifierRun,       prvVerifierTeardown    },
+    { "ca_recovery_rs256_verifier_batch_2048", 2,   100,   prvVerifier2048Setup, NULL,              prvVerifierBatchRun,  prvVerifierTeardown    },
+    { "ca_recovery_rs256_verifier_batch_3072", 2,   100,   prvVerifier3072Setup, NULL,              prvVerifierBatchRun,  prvVerifierTeardown    },
+    { "ca_recovery_stream_verify",             10,  500,   NULL,                 NULL,              prvStreamVerifyRun,   NULL                   },
+    { "ca_recovery_bundle_convert",            10,  2000,  NULL,                 prvConvertPrepare, prvConvertRun,        NULL                   },
+    { "tls_root_ca_parse_pem",                 10,  2000,  NULL,                 NULL,              prvParsePemRun,       NULL                   },
+    { "tls_root_ca_parse_bundle",              10,  2000,  prvParseBundleSetup,  NULL,              prvParseBundleRun,    prvParseBundleTeardown },
+    { "tls_verify_large_bundle_ca_chain",      2,   200,   prvLargeBundleSetup,  NULL,              prvVerifyChainRun,    prvLargeBundleTeardown },
+#if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+    { "tls_verify_large_bundle_ca_callback",   2,   200,   prvLargeBundleSetup,  NULL,              prvVerifyCallbackRun, prvLargeBundleTeardown },
+#endif
+};
+
+const BenchmarkSuite_t xCARecoveryBenchmarks = { xCARecoveryCases, sizeof( xCARecoveryCases ) / sizeof( xCARecoveryCases[ 0 ] ) };
+/*-----------------------------------------------------------*/
@@ -0,0 +1,182 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "benchmark_harness.h"
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*-----------------------------------------------------------*/
+
+/* Allocation counters, updated by the pvPortMalloc wrapper. */
+static uint64_t ullAllocations = 0;
+static uint64_t ullAllocatedBytes = 0;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The benchmark executable is linked with --wrap=pvPortMalloc, so every call to
+ * pvPortMalloc outside of the heap implementation lands here first.
+ */
+extern void * __real_pvPortMalloc( size_t xWantedSize );
+
+void * __wrap_pvPortMalloc( size_t xWantedSize )
+{
+    ullAllocations++;
+    ullAllocatedBytes += xWantedSize;
+
+    return __real_pvPortMalloc( xWantedSize );
+}
+/*-----------------------------------------------------------*/
+
+void vBenchmarkGetAllocations( uint64_t * pullAllocations,
+                               uint64_t * pullAllocatedBytes )
+{
+    *pullAllocations = ullAllocations;
+    *pullAllocatedBytes = ullAllocatedBytes;
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullBenchmarkNowNs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000ULL ) + ( uint64_t ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintResult( const BenchmarkCase_t * pxCase,
+                            const BenchmarkResult_t * pxResult )
+{
+    double xIterations = ( pxResult->ulIterations > 0 ) ? ( double ) pxResult->ulIterations : 1.0;
+
+    printf( "{\"benchmark\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,"
+            "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f,\"status\":\"%s\"}\n",
+            pxCase->pcName,
+            ( unsigned ) pxResult->ulIterations,
+            ( double ) pxResult->ullTotalNs / xIterations,
+            ( double ) pxResult->ullAllocations / xIterations,
+            ( double ) pxResult->ullAllocatedBytes / xIterations,
+            ( pxResult->xPassed == pdPASS ) ? "ok" : "failed" );
+    fflush( stdout );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xBenchmarkRun( const BenchmarkCase_t * pxCase,
+                          BenchmarkResult_t * pxResult )
+{
+    BenchmarkResult_t xResult;
+    uint64_t ullStartNs;
+    uint64_t ullStartAllocations;
+    uint64_t ullStartBytes;
+    uint64_t ullAllocationsNow;
+    uint64_t ullBytesNow;
+    uint32_t ulIndex;
+
+    memset( &xResult, 0, sizeof( xResult ) );
+    xResult.xPassed = pdPASS;
+
+    if( ( pxCase->xSetup != NULL ) && ( pxCase->xSetup() != pdPASS ) )
+    {
+        xResult.xPassed = pdFAIL;
+    }
+
+    for( ulIndex = 0; ( xResult.xPassed == pdPASS ) && ( ulIndex < pxCase->ulWarmupIterations ); ulIndex++ )
+    {
+        if( pxCase->vPrepare != NULL )
+        {
+            pxCase->vPrepare();
+        }
+
+        xResult.xPassed = pxCase->xRun();
+    }
+
+    if( xResult.xPassed == pdPASS )
+    {
+        if( pxCase->vPrepare == NULL )
+        {
+            vBenchmarkGetAllocations( &ullStartAllocations, &ullStartBytes );
+            ullStartNs = ullBenchmarkNowNs();
+
+            for( ulIndex = 0; ( xResult.xPassed == pdPASS ) && ( ulIndex < pxCase->ulIterations ); ulIndex++ )
+            {
+                xResult.xPassed = pxCase->xRun();
+            }
+
+            xResult.ullTotalNs = ullBenchmarkNowNs() - ullStartNs;
+            vBenchmarkGetAllocations( &ullAllocationsNow, &ullBytesNow );
+            xResult.ullAllocations = ullAllocationsNow - ullStartAllocations;
+            xResult.ullAllocatedBytes = ullBytesNow - ullStartBytes;
+        }
+        else
+        {
+            /* Time every iteration on its own so the preparation is left out. */
+            for( ulIndex = 0; ( xResult.xPassed == pdPASS ) && ( ulIndex < pxCase->ulIterations ); ulIndex++ )
+            {
+                pxCase->vPrepare();
+
+                vBenchmarkGetAllocations( &ullStartAllocations, &ullStartBytes );
+                ullStartNs = ullBenchmarkNowNs();
+
+                xResult.xPassed = pxCase->xRun();
+
+                xResult.ullTotalNs += ullBenchmarkNowNs() - ullStartNs;
+                vBenchmarkGetAllocations( &ullAllocationsNow, &ullBytesNow );
+                xResult.ullAllocations += ullAllocationsNow - ullStartAllocations;
+                xResult.ullAllocatedBytes += ullBytesNow - ullStartBytes;
+            }
+        }
+
+        xResult.ulIterations = ulIndex;
+    }
+
+    if( pxCase->vTeardown != NULL )
+    {
+        pxCase->vTeardown();
+    }
+
+    prvPrintResult( pxCase, &xResult );
+
+    if( pxResult != NULL )
+    {
+        *pxResult = xResult;
+    }
+
+    return xResult.xPassed;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulBenchmarkRunSuites( const BenchmarkSuite_t * pxSuites,
+                               uint32_t ulSuiteCount,
+                               const char * pcFilter )
+{
+    uint32_t ulSuite;
+    uint32_t ulCase;
+    uint32_t ulFailures = 0;
+    const BenchmarkCase_t * pxCase;
+
+    for( ulSuite = 0; ulSuite < ulSuiteCount; ulSuite++ )
+    {
+        for( ulCase = 0; ulCase < pxSuites[ ulSuite ].ulCaseCount; ulCase++ )
+        {
+            pxCase = &pxSuites[ ulSuite ].pxCases[ ulCase ];
+
+            if( ( pcFilter != NULL ) && ( strstr( pxCase->pcName, pcFilter ) == NULL ) )
+            {
+                continue;
+            }
+
+            if( xBenchmarkRun( pxCase, NULL ) != pdPASS )
+            {
+                ulFailures++;
+            }
+        }
+    }
+
+    return ulFailures;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,96 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file benchmark_harness.h
+ * @brief Minimal microbenchmark harness for the Linux port.
+ *
+ * A benchmark is a function run for a number of iterations after a warmup.
+ * The harness reports the wall time per iteration and the heap allocations
+ * done through pvPortMalloc per iteration, one JSON object per line on stdout.
+ */
+
+#ifndef BENCHMARK_HARNESS_H
+#define BENCHMARK_HARNESS_H
+
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief A benchmark case.
+ *
+ * All hooks but xRun are optional and never timed. When xPrepare is set, it is
+ * called before every iteration and each iteration is timed on its own, which
+ * adds the cost of reading the clock to the result.
+ */
+typedef struct BenchmarkCase
+{
+    const char * pcName;                       /**< Name reported in the results. */
+    uint32_t ulWarmupIterations;               /**< Iterations run before measuring. */
+    uint32_t ulIterations;                     /**< Iterations measured. */
+    BaseType_t ( * xSetup )( void );           /**< Called once before the warmup, returns pdPASS on success. */
+    void ( * vPrepare )( void );               /**< Called before every iteration. */
+    BaseType_t ( * xRun )( void );             /**< The measured operation, returns pdPASS on success. */
+    void ( * vTeardown )( void );              /**< Called once after the last iteration. */
+} BenchmarkCase_t;
+
+/**
+ * @brief A group of benchmarks, usually one per source file.
+ */
+typedef struct BenchmarkSuite
+{
+    const BenchmarkCase_t * pxCases;
+    uint32_t ulCaseCount;
+} BenchmarkSuite_t;
+
+/**
+ * @brief Result of a benchmark case.
+ */
+typedef struct BenchmarkResult
+{
+    uint32_t ulIterations;
+    uint64_t ullTotalNs;
+    uint64_t ullAllocations;
+    uint64_t ullAllocatedBytes;
+    BaseType_t xPassed;
+} BenchmarkResult_t;
+
+/**
+ * @brief Run one benchmark case and print its result.
+ *
+ * @param[in] pxCase Case to run.
+ * @param[out] pxResult Result of the case, can be NULL.
+ *
+ * @return pdPASS if setup and all iterations succeeded, pdFAIL otherwise.
+ */
+BaseType_t xBenchmarkRun( const BenchmarkCase_t * pxCase,
+                          BenchmarkResult_t * pxResult );
+
+/**
+ * @brief Run every case of the suites whose name contains @p pcFilter.
+ *
+ * @param[in] pxSuites Suites to run.
+ * @param[in] ulSuiteCount Number of suites.
+ * @param[in] pcFilter Substring the case names must contain, NULL runs all.
+ *
+ * @return Number of cases which failed.
+ */
+uint32_t ulBenchmarkRunSuites( const BenchmarkSuite_t * pxSuites,
+                               uint32_t ulSuiteCount,
+                               const char * pcFilter );
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ */
+uint64_t ullBenchmarkNowNs( void );
+
+/**
+ * @brief Allocations done through pvPortMalloc since start, counted by the
+ * pvPortMalloc wrapper of the benchmark executable.
+ */
+void vBenchmarkGetAllocations( uint64_t * pullAllocations,
+                               uint64_t * pullAllocatedBytes );
+
+#endif /* BENCHMARK_HARNESS_H */
@@ -0,0 +1,157 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Benchmarks of the logs of the sample hot loop: formatted in the calling task
+ * as vLoggingPrintf does without deferred logging, and recorded by the
+ * deferred logging backend. The formatting left to the logging task is
+ * measured on its own.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+
+/* Deferred logging backend. */
+#include "azure_sample_deferred_log.h"
+
+/*-----------------------------------------------------------*/
+
+#define benchmarkLOG_NAME         "AzureIoTDemo"
+
+/* Number of log calls of benchmarkHOT_LOOP_LOGS. */
+#define benchmarkHOT_LOOP_CALLS    ( 6U )
+
+/* One operation is one turn of the sample loop: its two LogInfo, each of them
+ * being three calls once expanded by logging_stack.h. */
+#define benchmarkHOT_LOOP_LOGS( xPrint )                                         \
+    do {                                                                         \
+        xPrint( "[INFO] [%s] [%s:%d] ", benchmarkLOG_NAME, __FILE__, __LINE__ ); \
+        xPrint( "Attempt to receive publish message from IoT Hub.\r\n" );        \
+        xPrint( "\r\n" );                                                        \
+        xPrint( "[INFO] [%s] [%s:%d] ", benchmarkLOG_NAME, __FILE__, __LINE__ ); \
+        xPrint( "Keeping Connection Idle...\r\n\r\n" );                          \
+        xPrint( "\r\n" );                                                        \
+    } while( 0 )
+
+/*-----------------------------------------------------------*/
+
+/* The logs are written to /dev/null, line buffered like a console so the
+ * system calls of the writes are measured but not the terminal. */
+static FILE * pxDevNull = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvSyncPrintf( const char * pcFormat,
+                           ... )
+{
+    va_list xArgs;
+
+    va_start( xArgs, pcFormat );
+    ( void ) vfprintf( pxDevNull, pcFormat, xArgs );
+    va_end( xArgs );
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeferredPrintf( const char * pcFormat,
+                               ... )
+{
+    va_list xArgs;
+
+    va_start( xArgs, pcFormat );
+    ( void ) DeferredLog_VPrintf( pcFormat, xArgs );
+    va_end( xArgs );
+}
+/*-----------------------------------------------------------*/
+
+static void prvDevNullWrite( const char * pcText,
+                             size_t xLength )
+{
+    ( void ) fwrite( pcText, 1, xLength, pxDevNull );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvLoggingSetup( void )
+{
+    DeferredLogStatus_t xStatus;
+
+    if( pxDevNull == NULL )
+    {
+        pxDevNull = fopen( "/dev/null", "w" );
+
+        if( ( pxDevNull == NULL ) ||
+            ( setvbuf( pxDevNull, NULL, _IOLBF, BUFSIZ ) != 0 ) )
+        {
+            return pdFAIL;
+        }
+    }
+
+    /* The logging task only runs when the benchmark task blocks, the
+     * preparation steps drain the ring instead. */
+    xStatus = DeferredLog_Init( prvDevNullWrite, tskIDLE_PRIORITY );
+
+    if( ( xStatus != eDeferredLogSuccess ) && ( xStatus != eDeferredLogAlreadyInitialized ) )
+    {
+        return pdFAIL;
+    }
+
+    ( void ) DeferredLog_Flush();
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+/* Both hot loop cases have a preparation step so they are timed the same way. */
+static void prvSyncPrepare( void )
+{
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSyncRun( void )
+{
+    benchmarkHOT_LOOP_LOGS( prvSyncPrintf );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDeferredPrepare( void )
+{
+    ( void ) DeferredLog_Flush();
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvDeferredRun( void )
+{
+    uint32_t ulDropped = DeferredLog_GetDroppedCount();
+
+    benchmarkHOT_LOOP_LOGS( prvDeferredPrintf );
+
+    /* A dropped log would make the iteration look cheaper than it is. */
+    return ( DeferredLog_GetDroppedCount() == ulDropped ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvDrainPrepare( void )
+{
+    benchmarkHOT_LOOP_LOGS( prvDeferredPrintf );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvDrainRun( void )
+{
+    return ( DeferredLog_Flush() == benchmarkHOT_LOOP_CALLS ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static const BenchmarkCase_t xLoggingCases[] =
+{
+    { "log_hot_loop_sync",     1000, 100000, prvLoggingSetup, prvSyncPrepare,     prvSyncRun,     NULL },
+    { "log_hot_loop_deferred", 1000, 100000, prvLoggingSetup, prvDeferredPrepare, prvDeferredRun, NULL },
+    { "log_hot_loop_drain",    1000, 100000, prvLoggingSetup, prvDrainPrepare,    prvDrainRun,    NULL },
+};
+
+const BenchmarkSuite_t xLoggingBenchmarks = { xLoggingCases, sizeof( xLoggingCases ) / sizeof( xLoggingCases[ 0 ] ) };
+/*-----------------------------------------------------------*/
@@ -0,0 +1,133 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * THESE FUNCTIONS AND VALUES ARE NEEDED FOR COMPILATION OF THE BENCHMARKS
+ */
+
+/* Standard includes. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include <assert.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+
+/*-----------------------------------------------------------*/
+
+/* Logs of the code under test are dropped unless -v is given, printing them
+ * would be measured too. stdout is kept for the results. */
+BaseType_t xBenchmarkVerbose = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list arg;
+
+    if( xBenchmarkVerbose == pdTRUE )
+    {
+        va_start( arg, pcFormat );
+        vfprintf( stderr, pcFormat, arg );
+        va_end( arg );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vAssertCalled( const char * pcFile,
+                    uint32_t ulLine )
+{
+    fprintf( stderr, "vAssertCalled( %s, %u\n", pcFile, ulLine );
+    assert( false );
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
+                                    StackType_t ** ppxIdleTaskStackBuffer,
+                                    uint32_t * pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
+                                     StackType_t ** ppxTimerTaskStackBuffer,
+                                     uint32_t * pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullGetUnixTime( void )
+{
+    return ( uint64_t ) time( NULL );
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullGetMonotonicTimeUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+int iMainRand32( void )
+{
+    static UBaseType_t uxlNextRand;
+    const uint32_t ulMultiplier = 0x015a4e35UL, ulIncrement = 1UL;
+
+    uxlNextRand = ( ulMultiplier * uxlNextRand ) + ulIncrement;
+
+    return( ( int ) ( uxlNextRand >> 16UL ) & 0x7fffUL );
+}
+/*-----------------------------------------------------------*/
+
+int mbedtls_platform_entropy_poll( void * data,
+                                   unsigned char * output,
+                                   size_t len,
+                                   size_t * olen )
+{
+    FILE * file;
+    size_t read_len;
+
+    ( ( void ) data );
+
+    *olen = 0;
+
+    file = fopen( "/dev/urandom", "rb" );
+
+    if( file == NULL )
+    {
+        return( -1 );
+    }
+
+    read_len = fread( output, 1, len, file );
+    fclose( file );
+
+    if( read_len != len )
+    {
+        return( -1 );
+    }
+
+    *olen = len;
+
+    return( 0 );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,165 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Benchmarks of the payloads built and parsed on every message: the step
+ * telemetry of the tile and the writable property handler of the PnP sample.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+
+/* Azure Provisioning/IoT Hub library includes */
+#include "azure_iot_hub_client.h"
+#include "azure_iot_hub_client_properties.h"
+
+/* Fleet generator, builds the same telemetry as the tile. */
+#include "sample_azure_iot_fleet_generator.h"
+
+/* PnP sample callbacks. */
+#include "sample_azure_iot_pnp_data_if.h"
+
+/*-----------------------------------------------------------*/
+
+#define benchmarkTELEMETRY_BUFFER_SIZE    ( 256 )
+#define benchmarkPROPERTY_BUFFER_SIZE     ( 256 )
+#define benchmarkMQTT_BUFFER_SIZE         ( 1024 )
+#define benchmarkSTEP_PERIOD_MS           ( 1000U )
+
+#define benchmarkHUB_HOSTNAME             "localhost"
+#define benchmarkDEVICE_ID                "benchmark"
+
+/**
+ * @brief Writable property update as sent by the hub to the thermostat.
+ */
+#define benchmarkWRITABLE_PROPERTIES      "{\"targetTemperature\":42.5,\"$version\":3}"
+
+/*-----------------------------------------------------------*/
+
+uint64_t ullGetUnixTime( void );
+
+/* The PnP sample callbacks use the hub client of the sample. */
+AzureIoTHubClient_t xAzureIoTHubClient;
+
+/* A single step per trace period, so every call produces one message. */
+static const FleetStepSample_t xStepSample = { 0, 1, 480, 1.312f, 1.377f };
+static const FleetStepTrace_t xStepTrace = { ( FleetStepSample_t * ) &xStepSample, 1, benchmarkSTEP_PERIOD_MS };
+
+static FleetGenerator_t xGenerator;
+static uint32_t ulNowMs;
+static uint8_t ucTelemetryBuffer[ benchmarkTELEMETRY_BUFFER_SIZE ];
+
+static uint8_t ucMQTTMessageBuffer[ benchmarkMQTT_BUFFER_SIZE ];
+static uint8_t ucPropertyResponse[ benchmarkPROPERTY_BUFFER_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+/* The hub client is never connected, any I/O is a failure. */
+static int32_t prvNoSend( NetworkContext_t * pxNetworkContext,
+                          const void * pvBuffer,
+                          size_t xBytesToSend )
+{
+    ( void ) pxNetworkContext;
+    ( void ) pvBuffer;
+    ( void ) xBytesToSend;
+
+    return -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvNoRecv( NetworkContext_t * pxNetworkContext,
+                          void * pvBuffer,
+                          size_t xBytesToRecv )
+{
+    ( void ) pxNetworkContext;
+    ( void ) pvBuffer;
+    ( void ) xBytesToRecv;
+
+    return -1;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTelemetrySetup( void )
+{
+    vFleetGeneratorInit( &xGenerator, eFleetProfileTrace, &xStepTrace, 1, 0 );
+    ulNowMs = 0;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTelemetryRun( void )
+{
+    uint32_t ulLength;
+
+    ulNowMs += benchmarkSTEP_PERIOD_MS;
+
+    if( ( ulFleetGeneratorCreateTelemetry( &xGenerator, ulNowMs, ucTelemetryBuffer,
+                                           sizeof( ucTelemetryBuffer ), &ulLength ) != 0 ) ||
+        ( ulLength == 0 ) )
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPropertiesSetup( void )
+{
+    static AzureIoTTransportInterface_t xTransport;
+    AzureIoTHubClientOptions_t xHubOptions;
+
+    xTransport.pxNetworkContext = NULL;
+    xTransport.xSend = prvNoSend;
+    xTransport.xRecv = prvNoRecv;
+
+    if( ( AzureIoTHubClient_OptionsInit( &xHubOptions ) != eAzureIoTSuccess ) ||
+        ( AzureIoTHubClient_Init( &xAzureIoTHubClient,
+                                  ( const uint8_t * ) benchmarkHUB_HOSTNAME, sizeof( benchmarkHUB_HOSTNAME ) - 1,
+                                  ( const uint8_t * ) benchmarkDEVICE_ID, sizeof( benchmarkDEVICE_ID ) - 1,
+                                  &xHubOptions,
+                                  ucMQTTMessageBuffer, sizeof( ucMQTTMessageBuffer ),
+                                  ullGetUnixTime,
+                                  &xTransport ) != eAzureIoTSuccess ) )
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPropertiesRun( void )
+{
+    AzureIoTHubClientPropertiesResponse_t xMessage;
+    uint32_t ulResponseLength = 0;
+
+    memset( &xMessage, 0, sizeof( xMessage ) );
+    xMessage.pvMessagePayload = benchmarkWRITABLE_PROPERTIES;
+    xMessage.ulPayloadLength = sizeof( benchmarkWRITABLE_PROPERTIES ) - 1;
+    xMessage.xMessageType = eAzureIoTHubPropertiesWritablePropertyMessage;
+
+    vHandleWritableProperties( &xMessage, ucPropertyResponse, sizeof( ucPropertyResponse ), &ulResponseLength );
+
+    return ( ulResponseLength > 0 ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPropertiesTeardown( void )
+{
+    AzureIoTHubClient_Deinit( &xAzureIoTHubClient );
+}
+/*-----------------------------------------------------------*/
+
+static const BenchmarkCase_t xTelemetryCases[] =
+{
+    { "telemetry_create_step_json", 1000, 100000, prvTelemetrySetup, NULL, prvTelemetryRun, NULL },
+    { "properties_handle_writable", 1000, 100000, prvPropertiesSetup, NULL, prvPropertiesRun, prvPropertiesTeardown },
+};
+
+const BenchmarkSuite_t xTelemetryBenchmarks = { xTelemetryCases, sizeof( xTelemetryCases ) / sizeof( xTelemetryCases[ 0 ] ) };
+/*-----------------------------------------------------------*/
@@ -0,0 +1,781 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Benchmarks of TLS record encryption and decryption through the sample
+ * transport, TLS_Socket_Send and TLS_Socket_Recv, and of the handshake of
+ * TLS_Socket_Connect with an RSA-2048 and a P-256 device certificate, and
+ * with a resumed session. The P-256 handshake is also run with its ECC
+ * operations sliced, and the longest slice of the client reported. The 4096
+ * bytes round trip is also run with a maximum fragment length of 1024, and the
+ * record buffers of the client are reported for both.
+ *
+ * This file provides the sockets wrapper of the benchmark executable: a single
+ * in-memory connection to an mbedTLS server living in the same task. The
+ * server runs whenever the client waits for data, it completes the handshake
+ * and then echoes every byte it receives. A send and receive round trip
+ * encrypts and decrypts each record twice, once on each side.
+ *
+ * The handshake cases time the server as well, its share is reported apart
+ * since it depends on the device key too: it verifies the signature of the
+ * device.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Demo Specific configs, for logging. */
+#include "demo_config.h"
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+#include "benchmark_vectors.h"
+
+/* Transport under test. */
+#include "transport_tls_socket.h"
+#include "sockets_wrapper.h"
+
+/* mbedTLS includes. */
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/threading.h"
+#include "mbedtls/version.h"
+#include "mbedtls/x509_crt.h"
+
+#if !defined( MBEDTLS_SSL_SRV_C )
+    #error "The TLS benchmarks need MBEDTLS_SSL_SRV_C for the loopback server."
+#endif
+
+/*-----------------------------------------------------------*/
+
+#define benchmarkTLS_HOSTNAME       "localhost"
+#define benchmarkTLS_PORT           ( 8883 )
+#define benchmarkTLS_TIMEOUT_MS     ( 1000U )
+#define benchmarkTLS_PIPE_SIZE      ( 32 * 1024 )
+#define benchmarkTLS_RECORD_SIZE    ( 4096 )
+
+/* Send and receive attempts per iteration before giving up, a round trip
+ * takes one per record. */
+#define benchmarkTLS_RECV_ATTEMPTS  ( 8 )
+
+/* Slice budget of the sliced handshake, the default of the Linux demo. */
+#define benchmarkTLS_SLICE_MAX_OPS  ( 1000U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief One direction of the loopback connection.
+ */
+typedef struct LoopbackPipe
+{
+    uint8_t ucData[ benchmarkTLS_PIPE_SIZE ];
+    size_t xHead;
+    size_t xTail;
+} LoopbackPipe_t;
+
+/**
+ * @brief The loopback server.
+ */
+typedef struct LoopbackServer
+{
+    mbedtls_ssl_config xConfig;
+    mbedtls_ssl_context xContext;
+    mbedtls_x509_crt xCertificate;
+    mbedtls_x509_crt xDeviceCa;
+    mbedtls_pk_context xKey;
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+    BaseType_t xHandshakeDone;
+    BaseType_t xFailed;
+} LoopbackServer_t;
+
+/*-----------------------------------------------------------*/
+
+static LoopbackPipe_t xToServer;
+static LoopbackPipe_t xToClient;
+static LoopbackServer_t xServer;
+static BaseType_t xSocketOpen = pdFALSE;
+
+static NetworkContext_t xNetworkContext;
+static TlsTransportParams_t xTlsTransportParams;
+static uint8_t ucServerBuffer[ benchmarkTLS_RECORD_SIZE ];
+static uint8_t ucSendBuffer[ benchmarkTLS_RECORD_SIZE ];
+static uint8_t ucRecvBuffer[ benchmarkTLS_RECORD_SIZE ];
+
+/* Device credentials of the handshake cases, NULL for a server only
+ * authentication. */
+static const char * pcDeviceName;
+static const char * pcDeviceCertificate;
+static size_t xDeviceCertificateSize;
+static const char * pcDeviceKey;
+static size_t xDeviceKeySize;
+static uint32_t ulHandshakes;
+static uint64_t ullServerHandshakeNs;
+static uint32_t ulSliceMaxOps;
+static uint32_t ulFragmentLength;
+
+/* Connection options of the session cases. The ticket keys of the server
+ * outlive the loopback server, which is set up again for every connection. */
+static const char * pcSessionCase;
+static BaseType_t xUseResumption = pdFALSE;
+#if defined( MBEDTLS_SSL_TICKET_C )
+    static mbedtls_ssl_ticket_context xTicket;
+    static mbedtls_entropy_context xTicketEntropy;
+    static mbedtls_ctr_drbg_context xTicketCtrDrbg;
+    static BaseType_t xTicketReady = pdFALSE;
+#endif
+
+/* The transport defines the NetworkContext. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/*-----------------------------------------------------------*/
+
+static size_t prvPipeWrite( LoopbackPipe_t * pxPipe,
+                            const uint8_t * pucData,
+                            size_t xLength )
+{
+    if( pxPipe->xHead == pxPipe->xTail )
+    {
+        pxPipe->xHead = 0;
+        pxPipe->xTail = 0;
+    }
+
+    if( xLength > sizeof( pxPipe->ucData ) - pxPipe->xTail )
+    {
+        xLength = sizeof( pxPipe->ucData ) - pxPipe->xTail;
+    }
+
+    memcpy( &pxPipe->ucData[ pxPipe->xTail ], pucData, xLength );
+    pxPipe->xTail += xLength;
+
+    return xLength;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvPipeRead( LoopbackPipe_t * pxPipe,
+                           uint8_t * pucData,
+                           size_t xLength )
+{
+    if( xLength > pxPipe->xTail - pxPipe->xHead )
+    {
+        xLength = pxPipe->xTail - pxPipe->xHead;
+    }
+
+    memcpy( pucData, &pxPipe->ucData[ pxPipe->xHead ], xLength );
+    pxPipe->xHead += xLength;
+
+    return xLength;
+}
+/*-----------------------------------------------------------*/
+
+static int prvServerSend( void * pvContext,
+                          const unsigned char * pucData,
+                          size_t xLength )
+{
+    size_t xWritten = prvPipeWrite( &xToClient, pucData, xLength );
+
+    ( void ) pvContext;
+
+    return ( xWritten == 0 ) ? MBEDTLS_ERR_SSL_WANT_WRITE : ( int ) xWritten;
+}
+/*-----------------------------------------------------------*/
+
+static int prvServerRecv( void * pvContext,
+                          unsigned char * pucData,
+                          size_t xLength )
+{
+    size_t xRead = prvPipeRead( &xToServer, pucData, xLength );
+
+    ( void ) pvContext;
+
+    return ( xRead == 0 ) ? MBEDTLS_ERR_SSL_WANT_READ : ( int ) xRead;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Let the server process what the client sent so far.
+ */
+static void prvServerRun( void )
+{
+    int lRet;
+    int lWritten;
+
+    if( xServer.xFailed == pdTRUE )
+    {
+        return;
+    }
+
+    if( xServer.xHandshakeDone == pdFALSE )
+    {
+        uint64_t ullStart = ullBenchmarkNowNs();
+
+        lRet = mbedtls_ssl_handshake( &xServer.xContext );
+        ullServerHandshakeNs += ullBenchmarkNowNs() - ullStart;
+
+        if( lRet == 0 )
+        {
+            xServer.xHandshakeDone = pdTRUE;
+        }
+        else if( lRet != MBEDTLS_ERR_SSL_WANT_READ )
+        {
+            LogError( ( "Loopback server handshake failed: %d", lRet ) );
+            xServer.xFailed = pdTRUE;
+        }
+
+        return;
+    }
+
+    while( ( lRet = mbedtls_ssl_read( &xServer.xContext, ucServerBuffer, sizeof( ucServerBuffer ) ) ) > 0 )
+    {
+        for( lWritten = 0; lWritten < lRet; )
+        {
+            int lSent = mbedtls_ssl_write( &xServer.xContext, &ucServerBuffer[ lWritten ], ( size_t ) ( lRet - lWritten ) );
+
+            if( lSent <= 0 )
+            {
+                LogError( ( "Loopback server write failed: %d", lSent ) );
+                xServer.xFailed = pdTRUE;
+                return;
+            }
+
+            lWritten += lSent;
+        }
+    }
+
+    if( lRet != MBEDTLS_ERR_SSL_WANT_READ )
+    {
+        LogError( ( "Loopback server read failed: %d", lRet ) );
+        xServer.xFailed = pdTRUE;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvServerInit( void )
+{
+    int lRet;
+
+    memset( &xServer, 0, sizeof( xServer ) );
+
+    /* The transport installs the same functions when it connects, the server
+     * needs them first. */
+    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                               mbedtls_platform_mutex_free,
+                               mbedtls_platform_mutex_lock,
+                               mbedtls_platform_mutex_unlock );
+
+    mbedtls_ssl_config_init( &xServer.xConfig );
+    mbedtls_ssl_init( &xServer.xContext );
+    mbedtls_x509_crt_init( &xServer.xCertificate );
+    mbedtls_x509_crt_init( &xServer.xDeviceCa );
+    mbedtls_pk_init( &xServer.xKey );
+    mbedtls_entropy_init( &xServer.xEntropy );
+    mbedtls_ctr_drbg_init( &xServer.xCtrDrbg );
+
+    if( ( ( lRet = mbedtls_entropy_add_source( &xServer.xEntropy, mbedtls_platform_entropy_poll, NULL,
+                                               32, MBEDTLS_ENTROPY_SOURCE_STRONG ) ) != 0 ) ||
+        ( ( lRet = mbedtls_ctr_drbg_seed( &xServer.xCtrDrbg, mbedtls_entropy_func, &xServer.xEntropy, NULL, 0 ) ) != 0 ) ||
+        ( ( lRet = mbedtls_x509_crt_parse( &xServer.xCertificate,
+                                           ( const unsigned char * ) benchmarkTLS_SERVER_CERTIFICATE,
+                                           sizeof( benchmarkTLS_SERVER_CERTIFICATE ) ) ) != 0 ) ||
+        ( ( lRet = mbedtls_pk_parse_key( &xServer.xKey,
+                                         ( const unsigned char * ) benchmarkTLS_SERVER_KEY,
+                                         sizeof( benchmarkTLS_SERVER_KEY ), NULL, 0 ) ) != 0 ) ||
+        ( ( lRet = mbedtls_ssl_config_defaults( &xServer.xConfig, MBEDTLS_SSL_IS_SERVER,
+                                                MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 ) )
+    {
+        LogError( ( "Loopback server setup failed: %d", lRet ) );
+        return pdFAIL;
+    }
+
+    mbedtls_ssl_conf_rng( &xServer.xConfig, mbedtls_ctr_drbg_random, &xServer.xCtrDrbg );
+
+    #if defined( MBEDTLS_SSL_TICKET_C )
+        if( xTicketReady == pdTRUE )
+        {
+            mbedtls_ssl_conf_session_tickets_cb( &xServer.xConfig, mbedtls_ssl_ticket_write,
+                                                 mbedtls_ssl_ticket_parse, &xTicket );
+        }
+    #endif
+
+    /* The device certificates are self-signed, each is its own CA. */
+    if( pcDeviceCertificate != NULL )
+    {
+        if( ( lRet = mbedtls_x509_crt_parse( &xServer.xDeviceCa,
+                                             ( const unsigned char * ) pcDeviceCertificate,
+                                             xDeviceCertificateSize ) ) != 0 )
+        {
+            LogError( ( "Loopback server device CA parsing failed: %d", lRet ) );
+            return pdFAIL;
+        }
+
+        mbedtls_ssl_conf_ca_chain( &xServer.xConfig, &xServer.xDeviceCa, NULL );
+        mbedtls_ssl_conf_authmode( &xServer.xConfig, MBEDTLS_SSL_VERIFY_REQUIRED );
+    }
+
+    if( ( ( lRet = mbedtls_ssl_conf_own_cert( &xServer.xConfig, &xServer.xCertificate, &xServer.xKey ) ) != 0 ) ||
+        ( ( lRet = mbedtls_ssl_setup( &xServer.xContext, &xServer.xConfig ) ) != 0 ) )
+    {
+        LogError( ( "Loopback server setup failed: %d", lRet ) );
+        return pdFAIL;
+    }
+
+    mbedtls_ssl_set_bio( &xServer.xContext, NULL, prvServerSend, prvServerRecv, NULL );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServerFree( void )
+{
+    mbedtls_ssl_free( &xServer.xContext );
+    mbedtls_ssl_config_free( &xServer.xConfig );
+    mbedtls_x509_crt_free( &xServer.xCertificate );
+    mbedtls_x509_crt_free( &xServer.xDeviceCa );
+    mbedtls_pk_free( &xServer.xKey );
+    mbedtls_ctr_drbg_free( &xServer.xCtrDrbg );
+    mbedtls_entropy_free( &xServer.xEntropy );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Init()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_DeInit()
+{
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+SocketHandle Sockets_Open()
+{
+    if( xSocketOpen == pdTRUE )
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    xSocketOpen = pdTRUE;
+
+    return ( SocketHandle ) &xToServer;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Close( SocketHandle xSocket )
+{
+    ( void ) xSocket;
+
+    xSocketOpen = pdFALSE;
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( SocketHandle xSocket,
+                            const char * pcHostName,
+                            uint16_t usPort )
+{
+    ( void ) xSocket;
+    ( void ) pcHostName;
+    ( void ) usPort;
+
+    memset( &xToServer, 0, sizeof( xToServer ) );
+    memset( &xToClient, 0, sizeof( xToClient ) );
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( SocketHandle xSocket )
+{
+    ( void ) xSocket;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Recv( SocketHandle xSocket,
+                         uint8_t * pucReceiveBuffer,
+                         size_t xReceiveBufferLength )
+{
+    ( void ) xSocket;
+
+    if( xToClient.xHead == xToClient.xTail )
+    {
+        prvServerRun();
+    }
+
+    if( xToClient.xHead == xToClient.xTail )
+    {
+        return SOCKETS_EWOULDBLOCK;
+    }
+
+    return ( BaseType_t ) prvPipeRead( &xToClient, pucReceiveBuffer, xReceiveBufferLength );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Send( SocketHandle xSocket,
+                         const uint8_t * pucData,
+                         size_t xDataLength )
+{
+    ( void ) xSocket;
+
+    return ( BaseType_t ) prvPipeWrite( &xToServer, pucData, xDataLength );
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetSockOpt( SocketHandle xSocket,
+                               int32_t lOptionName,
+                               const void * pvOptionValue,
+                               size_t xOptionLength )
+{
+    ( void ) xSocket;
+    ( void ) lOptionName;
+    ( void ) pvOptionValue;
+    ( void ) xOptionLength;
+
+    return SOCKETS_ERROR_NONE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsConnect( void )
+{
+    NetworkCredentials_t xNetworkCredentials;
+
+    if( prvServerInit() != pdPASS )
+    {
+        prvServerFree();
+        return pdFAIL;
+    }
+
+    memset( &xNetworkCredentials, 0, sizeof( xNetworkCredentials ) );
+    xNetworkCredentials.xDisableSni = pdFALSE;
+    xNetworkCredentials.pucRootCa = ( const uint8_t * ) benchmarkTLS_SERVER_CERTIFICATE;
+    xNetworkCredentials.xRootCaSize = sizeof( benchmarkTLS_SERVER_CERTIFICATE );
+    xNetworkCredentials.pucClientCert = ( const uint8_t * ) pcDeviceCertificate;
+    xNetworkCredentials.xClientCertSize = xDeviceCertificateSize;
+    xNetworkCredentials.pucPrivateKey = ( const uint8_t * ) pcDeviceKey;
+    xNetworkCredentials.xPrivateKeySize = xDeviceKeySize;
+    xNetworkCredentials.xEnableSessionResumption = xUseResumption;
+    xNetworkCredentials.ulCryptoSliceMaxOps = ulSliceMaxOps;
+    xNetworkCredentials.ulMaxFragmentLength = ulFragmentLength;
+
+    xNetworkContext.pParams = &xTlsTransportParams;
+
+    if( TLS_Socket_Connect( &xNetworkContext, benchmarkTLS_HOSTNAME, benchmarkTLS_PORT, &xNetworkCredentials,
+                            benchmarkTLS_TIMEOUT_MS, benchmarkTLS_TIMEOUT_MS ) != eTLSTransportSuccess )
+    {
+        prvServerFree();
+        return pdFAIL;
+    }
+
+    /* The client sends the last message of a resumed handshake, and does not
+     * wait for the server to read it. */
+    if( xServer.xHandshakeDone == pdFALSE )
+    {
+        prvServerRun();
+    }
+
+    return ( xServer.xHandshakeDone == pdTRUE ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTlsDisconnect( void )
+{
+    /* Free the server first, the transport removes the mbedTLS mutex functions. */
+    prvServerFree();
+
+    if( xTlsTransportParams.xSSLContext != NULL )
+    {
+        TLS_Socket_Disconnect( &xNetworkContext );
+        xTlsTransportParams.xSSLContext = NULL;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsEcho( size_t xLength )
+{
+    int32_t lSent;
+    int32_t lReceived;
+    size_t xTotalSent = 0;
+    size_t xTotalReceived = 0;
+    uint32_t ulAttempt;
+
+    /* A write stops at the end of a record, which a fragment length shortens. */
+    for( ulAttempt = 0; ( xTotalSent < xLength ) && ( ulAttempt < benchmarkTLS_RECV_ATTEMPTS ); ulAttempt++ )
+    {
+        lSent = TLS_Socket_Send( &xNetworkContext, &ucSendBuffer[ xTotalSent ], xLength - xTotalSent );
+
+        if( lSent < 0 )
+        {
+            return pdFAIL;
+        }
+
+        xTotalSent += ( size_t ) lSent;
+    }
+
+    if( xTotalSent != xLength )
+    {
+        return pdFAIL;
+    }
+
+    for( ulAttempt = 0; ( xTotalReceived < xLength ) && ( ulAttempt < benchmarkTLS_RECV_ATTEMPTS ); ulAttempt++ )
+    {
+        lReceived = TLS_Socket_Recv( &xNetworkContext, &ucRecvBuffer[ xTotalReceived ], xLength - xTotalReceived );
+
+        if( lReceived < 0 )
+        {
+            return pdFAIL;
+        }
+
+        xTotalReceived += ( size_t ) lReceived;
+    }
+
+    return ( xTotalReceived == xLength ) ? pdPASS : pdFAIL;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsEcho256Run( void )
+{
+    return prvTlsEcho( 256 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsEcho1024Run( void )
+{
+    return prvTlsEcho( 1024 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsEcho4096Run( void )
+{
+    return prvTlsEcho( 4096 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTlsConnectMfl1024( void )
+{
+    ulFragmentLength = 1024;
+
+    return prvTlsConnect();
+}
+/*-----------------------------------------------------------*/
+
+static void prvTlsEchoTeardown( void )
+{
+    const TlsTransportStats_t * pxStats = &xTlsTransportParams.xStats;
+
+    printf( "{\"benchmark\":\"tls_record_buffers\",\"fragment_length\":%u,\"in_bytes\":%u,\"out_bytes\":%u}\n",
+            ( unsigned ) ulFragmentLength,
+            ( unsigned ) pxStats->ulInBufferBytes,
+            ( unsigned ) pxStats->ulOutBufferBytes );
+    fflush( stdout );
+
+    prvTlsDisconnect();
+    ulFragmentLength = 0;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeRsa2048Setup( void )
+{
+    pcDeviceName = "rsa2048";
+    pcDeviceCertificate = benchmarkTLS_DEVICE_RSA_CERTIFICATE;
+    xDeviceCertificateSize = sizeof( benchmarkTLS_DEVICE_RSA_CERTIFICATE );
+    pcDeviceKey = benchmarkTLS_DEVICE_RSA_KEY;
+    xDeviceKeySize = sizeof( benchmarkTLS_DEVICE_RSA_KEY );
+    ulHandshakes = 0;
+    ullServerHandshakeNs = 0;
+    memset( &xTlsTransportParams.xStats, 0, sizeof( xTlsTransportParams.xStats ) );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeP256Setup( void )
+{
+    pcDeviceName = "p256";
+    pcDeviceCertificate = benchmarkTLS_DEVICE_P256_CERTIFICATE;
+    xDeviceCertificateSize = sizeof( benchmarkTLS_DEVICE_P256_CERTIFICATE );
+    pcDeviceKey = benchmarkTLS_DEVICE_P256_KEY;
+    xDeviceKeySize = sizeof( benchmarkTLS_DEVICE_P256_KEY );
+    ulHandshakes = 0;
+    ullServerHandshakeNs = 0;
+    memset( &xTlsTransportParams.xStats, 0, sizeof( xTlsTransportParams.xStats ) );
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeP256SlicedSetup( void )
+{
+    ( void ) prvHandshakeP256Setup();
+    pcDeviceName = "p256_sliced";
+    ulSliceMaxOps = benchmarkTLS_SLICE_MAX_OPS;
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeRun( void )
+{
+    BaseType_t xResult = prvTlsConnect();
+
+    prvTlsDisconnect();
+    ulHandshakes++;
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandshakeTeardown( void )
+{
+    const TlsTransportStats_t * pxStats = &xTlsTransportParams.xStats;
+
+    printf( "{\"benchmark\":\"tls_handshake_mutual_server\",\"device_key\":\"%s\",\"handshakes\":%u,"
+            "\"server_us_per_handshake\":%llu,\"slice_max_ops\":%u,\"client_slices_per_handshake\":%u,"
+            "\"client_max_slice_us\":%u}\n",
+            pcDeviceName,
+            ( unsigned ) ulHandshakes,
+            ( unsigned long long ) ( ( ulHandshakes > 0U ) ? ullServerHandshakeNs / ulHandshakes / 1000U : 0U ),
+            ( unsigned ) ulSliceMaxOps,
+            ( unsigned ) ( ( pxStats->ulHandshakes > 0U ) ? pxStats->ulCryptoSlices / pxStats->ulHandshakes : 0U ),
+            ( unsigned ) pxStats->ulMaxSliceUs );
+    fflush( stdout );
+
+    ulSliceMaxOps = 0;
+
+    pcDeviceName = NULL;
+    pcDeviceCertificate = NULL;
+    xDeviceCertificateSize = 0;
+    pcDeviceKey = NULL;
+    xDeviceKeySize = 0;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSessionRun( void )
+{
+    BaseType_t xResult = prvTlsConnect();
+
+    prvTlsDisconnect();
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvSessionSetup( const char * pcCase,
+                                   BaseType_t xResumption )
+{
+    int lRet = 0;
+
+    pcSessionCase = pcCase;
+    xUseResumption = xResumption;
+    memset( &xTlsTransportParams.xStats, 0, sizeof( xTlsTransportParams.xStats ) );
+
+    if( xResumption == pdTRUE )
+    {
+        #if defined( MBEDTLS_SSL_TICKET_C )
+            mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                                       mbedtls_platform_mutex_free,
+                                       mbedtls_platform_mutex_lock,
+                                       mbedtls_platform_mutex_unlock );
+
+            mbedtls_ssl_ticket_init( &xTicket );
+            mbedtls_entropy_init( &xTicketEntropy );
+            mbedtls_ctr_drbg_init( &xTicketCtrDrbg );
+            xTicketReady = pdTRUE;
+
+            if( ( ( lRet = mbedtls_entropy_add_source( &xTicketEntropy, mbedtls_platform_entropy_poll, NULL,
+                                                       32, MBEDTLS_ENTROPY_SOURCE_STRONG ) ) != 0 ) ||
+                ( ( lRet = mbedtls_ctr_drbg_seed( &xTicketCtrDrbg, mbedtls_entropy_func, &xTicketEntropy, NULL, 0 ) ) != 0 ) ||
+                ( ( lRet = mbedtls_ssl_ticket_setup( &xTicket, mbedtls_ctr_drbg_random, &xTicketCtrDrbg,
+                                                     MBEDTLS_CIPHER_AES_256_GCM, 86400 ) ) != 0 ) )
+            {
+                LogError( ( "Loopback server ticket setup failed: %d", lRet ) );
+                return pdFAIL;
+            }
+        #else
+            LogError( ( "The resumed handshakes need MBEDTLS_SSL_TICKET_C for the loopback server." ) );
+            return pdFAIL;
+        #endif /* MBEDTLS_SSL_TICKET_C */
+
+        /* The first connection gets the session the iterations resume. */
+        if( prvSessionRun() != pdPASS )
+        {
+            return pdFAIL;
+        }
+    }
+
+    return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSessionTeardown( void )
+{
+    const TlsTransportStats_t * pxStats = &xTlsTransportParams.xStats;
+
+    printf( "{\"benchmark\":\"tls_handshake_stats\",\"case\":\"%s\",\"handshakes\":%u,\"failed\":%u,"
+            "\"resumptions_offered\":%u,\"mean_ms\":%u,\"max_ms\":%u}\n",
+            pcSessionCase,
+            ( unsigned ) pxStats->ulHandshakes,
+            ( unsigned ) pxStats->ulFailedHandshakes,
+            ( unsigned ) pxStats->ulResumptionsOffered,
+            ( unsigned ) ( ( pxStats->ulHandshakes > 0U ) ? pxStats->ulTotalHandshakeMs / pxStats->ulHandshakes : 0U ),
+            ( unsigned ) pxStats->ulMaxHandshakeMs );
+    fflush( stdout );
+
+    TLS_Socket_ForgetSession( &xNetworkContext );
+
+    #if defined( MBEDTLS_SSL_TICKET_C )
+        if( xTicketReady == pdTRUE )
+        {
+            /* The transport removed the mutex functions when it disconnected. */
+            mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                                       mbedtls_platform_mutex_free,
+                                       mbedtls_platform_mutex_lock,
+                                       mbedtls_platform_mutex_unlock );
+
+            mbedtls_ssl_ticket_free( &xTicket );
+            mbedtls_ctr_drbg_free( &xTicketCtrDrbg );
+            mbedtls_entropy_free( &xTicketEntropy );
+            mbedtls_threading_free_alt();
+            xTicketReady = pdFALSE;
+        }
+    #endif
+
+    xUseResumption = pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeFullSetup( void )
+{
+    return prvSessionSetup( "tls_handshake_full", pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandshakeResumedSetup( void )
+{
+    return prvSessionSetup( "tls_handshake_resumed", pdTRUE );
+}
+/*-----------------------------------------------------------*/
+
+static const BenchmarkCase_t xTlsCases[] =
+{
+    { "tls_send_recv_256",            100, 20000, prvTlsConnect,               NULL, prvTlsEcho256Run,  prvTlsDisconnect     },
+    { "tls_send_recv_1024",           100, 20000, prvTlsConnect,               NULL, prvTlsEcho1024Run, prvTlsDisconnect     },
+    { "tls_send_recv_4096",           100, 5000,  prvTlsConnect,               NULL, prvTlsEcho4096Run, prvTlsEchoTeardown   },
+    { "tls_send_recv_4096_mfl1024",   100, 5000,  prvTlsConnectMfl1024,        NULL, prvTlsEcho4096Run, prvTlsEchoTeardown   },
+    { "tls_handshake_mutual_rsa2048", 5,   100,   prvHandshakeRsa2048Setup,    NULL, prvHandshakeRun,   prvHandshakeTeardown },
+    { "tls_handshake_mutual_p256",    5,   100,   prvHandshakeP256Setup,       NULL, prvHandshakeRun,   prvHandshakeTeardown },
+    { "tls_handshake_sliced_p256",    5,   100,   prvHandshakeP256SlicedSetup, NULL, prvHandshakeRun,   prvHandshakeTeardown },
+    { "tls_handshake_full",           5,   100,   prvHandshakeFullSetup,       NULL, prvSessionRun,     prvSessionTeardown   },
+    { "tls_handshake_resumed",        5,   100,   prvHandshakeResumedSetup,    NULL, prvSessionRun,     prvSessionTeardown   },
+};
+
+const BenchmarkSuite_t xTlsBenchmarks = { xTlsCases, sizeof( xTlsCases ) / sizeof( xTlsCases[ 0 ] ) };
+/*-----------------------------------------------------------*/
@@ -0,0 +1,95 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Microbenchmarks of the sample hot paths.
+ *
+ * Usage: benchmarks [-v] [filter]
+ *   -v      print the logs of the code under test on stderr.
+ *   filter  only run the benchmarks whose name contains this string.
+ *
+ * Results are printed on stdout, one JSON object per benchmark. The exit code
+ * is the number of benchmarks which failed.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+
+/* Benchmark harness. */
+#include "benchmark_harness.h"
+
+/* Functions needed for compilation have been placed in benchmark_platform.c. */
+
+#define benchmarkTASK_STACK_SIZE    ( 16 * 1024U )
+#define benchmarkTASK_PRIORITY      ( tskIDLE_PRIORITY + 1 )
+
+/*-----------------------------------------------------------*/
+
+extern const BenchmarkSuite_t xTelemetryBenchmarks;
+extern const BenchmarkSuite_t xCARecoveryBenchmarks;
+extern const BenchmarkSuite_t xCryptoBenchmarks;
+extern const BenchmarkSuite_t xTlsBenchmarks;
+extern const BenchmarkSuite_t xLoggingBenchmarks;
+extern const BenchmarkSuite_t xADUUpdateBenchmarks;
+
+/* Set by -v, read by vLoggingPrintf. */
+extern BaseType_t xBenchmarkVerbose;
+
+static const char * pcFilter = NULL;
+
+/*-----------------------------------------------------------*/
+
+static void prvBenchmarkTask( void * pvParameters )
+{
+    BenchmarkSuite_t xSuites[ 6 ];
+    uint32_t ulFailures;
+
+    ( void ) pvParameters;
+
+    xSuites[ 0 ] = xTelemetryBenchmarks;
+    xSuites[ 1 ] = xCARecoveryBenchmarks;
+    xSuites[ 2 ] = xCryptoBenchmarks;
+    xSuites[ 3 ] = xTlsBenchmarks;
+    xSuites[ 4 ] = xLoggingBenchmarks;
+    xSuites[ 5 ] = xADUUpdateBenchmarks;
+
+    ulFailures = ulBenchmarkRunSuites( xSuites, sizeof( xSuites ) / sizeof( xSuites[ 0 ] ), pcFilter );
+
+    exit( ( int ) ulFailures );
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int lArg;
+
+    for( lArg = 1; lArg < argc; lArg++ )
+    {
+        if( strcmp( argv[ lArg ], "-v" ) == 0 )
+        {
+            xBenchmarkVerbose = pdTRUE;
+        }
+        else
+        {
+            pcFilter = argv[ lArg ];
+        }
+    }
+
+    /* Run from a task, like the samples do, so the code under test can use
+     * the FreeRTOS APIs it needs. */
+    xTaskCreate( prvBenchmarkTask, "Benchmarks", benchmarkTASK_STACK_SIZE,
+                 NULL, benchmarkTASK_PRIORITY, NULL );
+
+    vTaskStartScheduler();
+
+    /* Only reached if the scheduler could not start. */
+    return 1;
+}
+/*-----------------------------------------------------------*/
@@ -185,4 +185,20 @@ extern void vLoggingPrintf( const char * pcFormatString,
 extern int iMainRand32( void );
 #define configRAND32()    iMainRand32()
 
+/* Microsecond clock of the slices of the TLS handshake and of the RS256
+ * verifications, the tick is too coarse for them. */
+extern uint64_t ullGetMonotonicTimeUs( void );
+#define transporttlsGET_TIME_US()         ullGetMonotonicTimeUs()
+#define azureiotrsaverifyGET_TIME_US()    ullGetMonotonicTimeUs()
+
+/* Set to 1, with the AZURE_SAMPLE_TRACE CMake option, to export a Chrome trace
+ * event file of the scheduler, the queues and the spans of the samples. */
+#ifndef configSAMPLE_TRACE_EXPORT
+    #define configSAMPLE_TRACE_EXPORT    0
+#endif
+
+#if ( configSAMPLE_TRACE_EXPORT == 1 )
+    #include "azure_sample_trace.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
@@ -52,6 +52,15 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 /************ End of logging configuration ****************/
 
+/**
+ * @brief Record the logs in a ring buffer and format them in a low priority
+ * task, instead of formatting and printing them in the calling task.
+ *
+ * @note To print the logs synchronously undef this macro
+ *
+ */
+#define democonfigENABLE_DEFERRED_LOGGING
+
 /**
  * @brief Enable Device Provisioning
  *
@@ -123,6 +132,9 @@ extern void vLoggingPrintf( const char * pcFormatString,
 /**
  * @brief Client's private key.
  *
+ * With an EC key the transport offers the ECDHE suites only, ECDSA first,
+ * and the P-256 curve first for the key exchange. IoT Hub serves an RSA
+ * certificate, so an ECDHE-RSA suite is selected.
  */
 /* #define democonfigCLIENT_PRIVATE_KEY_PEM    "<YOUR DEVICE PRIVATE KEY HERE>" */
 
@@ -232,9 +244,57 @@ extern void vLoggingPrintf( const char * pcFormatString,
  */
 #define democonfigIOTHUB_PORT                ( 8883 )
 
+/**
+ * @brief Keep the TLS session and offer it when reconnecting.
+ */
+/* #define democonfigENABLE_TLS_SESSION_RESUMPTION */
+
+/**
+ * @brief Budget of the slices of the ECC operations of the TLS handshake, the
+ * sample task yields between two slices so the other tasks keep running.
+ *
+ * @note Smaller budgets give shorter slices and more yields, mbed TLS keeps a
+ * minimum for some steps. Needs MBEDTLS_ECP_RESTARTABLE.
+ */
+#define democonfigTLS_CRYPTO_SLICE_MAX_OPS    ( 1000 )
+
+/**
+ * @brief Longest TLS record asked to IoT Hub, 512, 1024, 2048 or 4096 bytes,
+ * which sizes the record buffers after the handshake. Not asked when
+ * undefined.
+ *
+ * @note The MQTT packets of the sample are a few hundred bytes, the larger
+ * twin documents take several records. If the ServerHello does not agree to
+ * the length asked, the record buffers stay full size.
+ */
+/* #define democonfigTLS_MAX_FRAGMENT_LENGTH    ( 1024 ) */
+
 /* 2^16 */
 #define democonfigCHUNK_DOWNLOAD_SIZE        65536
 
+/* The chunks start at one flash sector and grow with the throughput. */
+#define democonfigADU_MIN_CHUNK_DOWNLOAD_SIZE    4096
+
+/* Download the next chunk while the flash writer programs the previous one,
+ * at the cost of a second chunk buffer. MCU ports keep the default of one. */
+#define democonfigADU_DOWNLOAD_BUFFER_COUNT      2
+
+/* FreeRTOS::Heap::3 forwards to malloc and keeps no statistics. */
+#define democonfigADU_GET_FREE_HEAP_SIZE()       ( 0xFFFFFFFFUL )
+
+/* Persist the download progress, the chunk size is a multiple of the flash sector. */
+#define democonfigADU_RESUME_DOWNLOAD        1
+
+/* Accept payloads packed by the adu_compress tool. */
+#define democonfigADU_COMPRESSED_IMAGES      1
+
+/* Accept payloads created by the adu_delta tool against the running slot, or
+ * the executable before the first update. */
+#define democonfigADU_DELTA_IMAGES           1
+
+/* Write the chunks of a raw image by whole flash sectors, erased ahead. */
+#define democonfigADU_COALESCE_WRITES        1
+
 #define democonfigADU_DEVICE_MANUFACTURER    "PC"
 #define democonfigADU_DEVICE_MODEL           "Linux"
 #define democonfigADU_UPDATE_PROVIDER        "Contoso"
@@ -242,4 +302,27 @@ extern void vLoggingPrintf( const char * pcFormatString,
 #define democonfigADU_UPDATE_VERSION         "1.0"
 #define democonfigADU_UPDATE_NEW_VERSION     "1.1"
 
+/**
+ * @brief Fleet simulator settings, used by the -fleet executable only.
+ *
+ * Every simulated device connects as democonfigFLEET_DEVICE_ID_FORMAT formatted
+ * with its index and authenticates with democonfigDEVICE_SYMMETRIC_KEY, which
+ * suits a local hub emulator. DPS is not used by the fleet.
+ */
+#define democonfigFLEET_DEVICE_COUNT                ( 16U )
+#define democonfigFLEET_WORKER_COUNT                ( 4U )
+#define democonfigFLEET_DEVICE_ID_FORMAT            "tile-%04u"
+#define democonfigFLEET_TELEMETRY_PERIOD_MS         ( 5000U )
+#define democonfigFLEET_REPORT_PERIOD_MS            ( 10000U )
+
+/* Drop every connection at this period to observe reconnect storms, 0 disables it. */
+#define democonfigFLEET_RECONNECT_STORM_PERIOD_MS   ( 0U )
+
+/* Recorded step trace replayed by a quarter of the devices, the others use synthetic profiles. */
+/* #define democonfigFLEET_STEP_TRACE_PATH          "demos/sample_azure_iot_fleet/step_trace_sample.csv" */
+
+/* Hub to connect the fleet to, defaults to democonfigHOSTNAME and democonfigIOTHUB_PORT. */
+/* #define democonfigFLEET_HOSTNAME                 "localhost" */
+/* #define democonfigFLEET_IOTHUB_PORT              ( 8883 ) */
+
 #endif /* DEMO_CONFIG_H */
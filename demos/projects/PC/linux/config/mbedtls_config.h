@@ -33,6 +33,14 @@
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
 
+/* Keep the comb table of the generator once computed, so the multiplications
+ * of the P-256 signatures and key exchanges skip the precomputation. Let the
+ * ECC operations return before they are done, to be resumed, which needs the
+ * legacy ECDH context on mbed TLS 2. */
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM    1
+#define MBEDTLS_ECP_RESTARTABLE
+#define MBEDTLS_ECDH_LEGACY_CONTEXT
+
 /* Enable all SSL alert messages. */
 #define MBEDTLS_SSL_ALL_ALERT_MESSAGES
 
@@ -43,11 +51,19 @@
 #define MBEDTLS_SSL_PROTO_TLS1_2
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+/* Shrink the record buffers to the maximum fragment length the server agreed
+ * to once the handshake is over, they are full size otherwise. */
+#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
 
 /* Check certificate key usage. */
 #define MBEDTLS_X509_CHECK_KEY_USAGE
 #define MBEDTLS_X509_CHECK_EXTENDED_KEY_USAGE
 
+/* Look the trusted CAs of a trust bundle up by a callback. */
+#define MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK
+
 /* Disable platform entropy functions. */
 #define MBEDTLS_NO_PLATFORM_ENTROPY
 
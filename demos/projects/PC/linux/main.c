@@ -9,6 +9,7 @@
 #include <strings.h>
 #include <unistd.h>
 #include <assert.h>
+#include <malloc.h>
 
 /* FreeRTOS includes. */
 #include <FreeRTOS.h>
@@ -24,9 +25,16 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+#ifdef democonfigENABLE_DEFERRED_LOGGING
+    #include "azure_sample_deferred_log.h"
+#endif
+
 #define mainHOST_NAME           "RTOSDemo"
 #define mainDEVICE_NICK_NAME    "linux_demo"
 
+/* The logs are formatted when nothing else has to run. */
+#define mainLOGGING_TASK_PRIORITY    tskIDLE_PRIORITY
+
 /*
  * Prototypes for the demos that can be started from this project.  Note the
  * MQTT demo is not actually started until the network is already, which is
@@ -79,6 +87,16 @@ const uint8_t ucMACAddress[ 6 ] = { configMAC_ADDR0, configMAC_ADDR1, configMAC_
 static UBaseType_t ulNextRand;
 /*-----------------------------------------------------------*/
 
+#ifdef democonfigENABLE_DEFERRED_LOGGING
+    static void prvLoggingWrite( const char * pcText,
+                                 size_t xLength )
+    {
+        ( void ) fwrite( pcText, 1, xLength, stdout );
+        ( void ) fflush( stdout );
+    }
+#endif
+/*-----------------------------------------------------------*/
+
 void vLoggingInit( BaseType_t xLogToStdout,
                    BaseType_t xLogToFile,
                    BaseType_t xLogToUDP,
@@ -95,6 +113,13 @@ void vLoggingInit( BaseType_t xLogToStdout,
     ( void ) xLogToUDP;
     ( void ) usRemotePort;
     ( void ) ulRemoteIPAddress;
+
+    #ifdef democonfigENABLE_DEFERRED_LOGGING
+        if( DeferredLog_Init( prvLoggingWrite, mainLOGGING_TASK_PRIORITY ) != eDeferredLogSuccess )
+        {
+            configASSERT( pdFALSE );
+        }
+    #endif
 }
 
 void vLoggingPrintf( const char * pcFormat,
@@ -103,7 +128,11 @@ void vLoggingPrintf( const char * pcFormat,
     va_list arg;
 
     va_start( arg, pcFormat );
-    vprintf( pcFormat, arg );
+    #ifdef democonfigENABLE_DEFERRED_LOGGING
+        ( void ) DeferredLog_VPrintf( pcFormat, arg );
+    #else
+        vprintf( pcFormat, arg );
+    #endif
     va_end( arg );
 }
 
@@ -126,6 +155,14 @@ int main( void )
      * but a DHCP server cannot be contacted. */
     FreeRTOS_IPInit( ucIPAddress, ucNetMask, ucGatewayAddress, ucDNSServerAddress, ucMACAddress );
 
+    #if ( configSAMPLE_TRACE_EXPORT == 1 )
+        /* Started before the scheduler so the trace covers the whole run. */
+        if( TraceExport_Start( NULL ) != 0 )
+        {
+            configASSERT( pdFALSE );
+        }
+    #endif
+
     /* Start the RTOS scheduler. */
     vTaskStartScheduler();
 
@@ -192,6 +229,15 @@ void vAssertCalled( const char * pcFile,
     ( void ) pcFileName;
     ( void ) ulLineNumber;
 
+    #ifdef democonfigENABLE_DEFERRED_LOGGING
+        /* Write the logs leading to the assert before halting. */
+        ( void ) DeferredLog_Flush();
+    #endif
+
+    #if ( configSAMPLE_TRACE_EXPORT == 1 )
+        TraceExport_Flush();
+    #endif
+
     printf( "vAssertCalled( %s, %u\n", pcFile, ulLine );
 
     /* Setting ulBlockVariable to a non-zero value in the debugger will allow
@@ -383,6 +429,28 @@ uint64_t ullGetUnixTime( void )
 }
 /*-----------------------------------------------------------*/
 
+uint64_t ullGetMonotonicTimeUs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+/* FreeRTOS::Heap::3 forwards to malloc and keeps no statistics, ask the C
+ * library how much of its heap is in use instead. */
+size_t xGetHeapBytesInUse( void )
+{
+    #if defined( __GLIBC__ ) && ( ( __GLIBC__ > 2 ) || ( ( __GLIBC__ == 2 ) && ( __GLIBC_MINOR__ >= 33 ) ) )
+        return mallinfo2().uordblks;
+    #else
+        return ( size_t ) mallinfo().uordblks;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Function to generate a random number.
  *
@@ -1,48 +1,760 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_flash_platform.c
+ *
+ * @brief Flash abstraction of the Linux port, emulating an A/B flash in a
+ * file.
+ *
+ * The flash is azureiotflashFILE_PATH, or the file named by the
+ * AZURE_IOT_FLASH_FILE environment variable, mapped in memory. It holds two
+ * slots of azureiotflashSLOT_SIZE bytes, slot 0 at its start. Like a NOR
+ * flash, the sectors of the update slot are erased to 0xFF before they are
+ * programmed, and programming only clears bits. The erase of a sector and the
+ * program of a page take the durations of the AZURE_IOT_FLASH_ERASE_US and
+ * AZURE_IOT_FLASH_PROGRAM_US environment variables, in microseconds, so the
+ * download and write throughput of the ADU sample can be measured on the host.
+ * Each block is synced to the disk before the write returns, and the writes,
+ * page programs and sector erases are counted.
+ *
+ * The slot the device boots is kept next to the flash, in a file with the
+ * ".boot" suffix which AzureIoTPlatform_EnableImage() replaces atomically.
+ * Until an image is enabled the device runs its factory image: the
+ * executable itself, or the file named by the AZURE_IOT_FLASH_SOURCE_FILE
+ * environment variable, and the updates are written to slot 0. Afterwards
+ * the updates are written to the slot the device does not run. The running
+ * image is the one delta updates are applied to.
+ *
+ * The checkpoints of resumable downloads are kept next to it, in a file with
+ * the ".checkpoint" suffix which is replaced atomically.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mbedtls/base64.h"
+
 #include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_resume.h"
+#include "azure_iot_flash_platform_delta.h"
+#include "azure_iot_flash_platform_sector.h"
+
+/* Logging */
+#include "azure_iot.h"
+
+#ifndef azureiotflashFILE_PATH
+    #define azureiotflashFILE_PATH    "azure_iot_flash.bin"
+#endif
+
+/**
+ * @brief Set to 0 to let the page cache absorb the writes.
+ */
+#ifndef azureiotflashSYNC_WRITES
+    #define azureiotflashSYNC_WRITES    1
+#endif
+
+/**
+ * @brief Size of the erase unit, the checkpoints are aligned to it.
+ */
+#ifndef azureiotflashSECTOR_SIZE
+    #define azureiotflashSECTOR_SIZE    ( 4096U )
+#endif
+
+/**
+ * @brief Size of the program unit.
+ */
+#ifndef azureiotflashPAGE_SIZE
+    #define azureiotflashPAGE_SIZE    ( 256U )
+#endif
+
+/**
+ * @brief Size of a slot, a multiple of the sector size.
+ */
+#ifndef azureiotflashSLOT_SIZE
+    #define azureiotflashSLOT_SIZE    ( 16U * 1024U * 1024U )
+#endif
+
+#define azureiotflashSLOT_COUNT                   ( 2U )
+#define azureiotflashFILE_ENVIRONMENT             "AZURE_IOT_FLASH_FILE"
+#define azureiotflashSOURCE_ENVIRONMENT           "AZURE_IOT_FLASH_SOURCE_FILE"
+#define azureiotflashERASE_LATENCY_ENVIRONMENT    "AZURE_IOT_FLASH_ERASE_US"
+#define azureiotflashPROGRAM_LATENCY_ENVIRONMENT  "AZURE_IOT_FLASH_PROGRAM_US"
+#define azureiotflashSOURCE_PATH                  "/proc/self/exe"
+#define azureiotflashCHECKPOINT_SUFFIX            ".checkpoint"
+#define azureiotflashBOOT_SUFFIX                  ".boot"
+#define azureiotflashBOOT_MAGIC                   ( 0x544F4F42U )
+#define azureiotflashSHA_256_SIZE                 32
+
+/* The slot the device boots. */
+typedef struct AzureADUBootRecord
+{
+    uint32_t ulMagic;
+    uint32_t ulSlot;
+    uint32_t ulImageSize;
+} AzureADUBootRecord_t;
+
+static const char * prvGetFlashPath( void )
+{
+    const char * pcPath = getenv( azureiotflashFILE_ENVIRONMENT );
+
+    return ( pcPath != NULL ) ? pcPath : azureiotflashFILE_PATH;
+}
+
+static void prvGetMetadataPath( char * pcPath,
+                                size_t xPathSize,
+                                const char * pcExtension,
+                                const char * pcSuffix )
+{
+    ( void ) snprintf( pcPath, xPathSize, "%s%s%s", prvGetFlashPath(), pcExtension, pcSuffix );
+}
+
+static uint32_t prvGetLatency( const char * pcEnvironment )
+{
+    const char * pcValue = getenv( pcEnvironment );
+
+    return ( pcValue != NULL ) ? ( uint32_t ) strtoul( pcValue, NULL, 10 ) : 0U;
+}
+
+static void prvDelay( uint32_t ulMicroseconds )
+{
+    struct timespec xDelay;
+
+    if( ulMicroseconds > 0U )
+    {
+        xDelay.tv_sec = ( time_t ) ( ulMicroseconds / 1000000U );
+        xDelay.tv_nsec = ( long ) ( ulMicroseconds % 1000000U ) * 1000L;
+
+        while( ( nanosleep( &xDelay, &xDelay ) != 0 ) && ( errno == EINTR ) )
+        {
+        }
+    }
+}
+
+static uint8_t * prvGetSlot( AzureADUImage_t * const pxAduImage,
+                             uint32_t ulSlot )
+{
+    return pxAduImage->pucFlash + ( size_t ) ulSlot * azureiotflashSLOT_SIZE;
+}
+
+/* Writes the region of the flash to the disk, like a program does. */
+static AzureIoTResult_t prvSyncRegion( AzureADUImage_t * const pxAduImage,
+                                       uint32_t ulOffset,
+                                       uint32_t ulLength )
+{
+    #if ( azureiotflashSYNC_WRITES == 1 )
+        size_t xPageSize = ( size_t ) sysconf( _SC_PAGESIZE );
+        size_t xStart = ( size_t ) pxAduImage->ulUpdateSlot * azureiotflashSLOT_SIZE + ulOffset;
+        size_t xEnd = xStart + ulLength;
+
+        xStart -= xStart % xPageSize;
+
+        if( msync( pxAduImage->pucFlash + xStart, xEnd - xStart, MS_SYNC ) != 0 )
+        {
+            AZLogError( ( "Unable to sync the flash file" ) );
+            return eAzureIoTErrorFailed;
+        }
+    #else /* azureiotflashSYNC_WRITES == 1 */
+        ( void ) pxAduImage;
+        ( void ) ulOffset;
+        ( void ) ulLength;
+    #endif /* azureiotflashSYNC_WRITES == 1 */
+
+    return eAzureIoTSuccess;
+}
+
+/* Erases the sectors of the update slot up to ulEnd, rounded up to a sector. */
+static AzureIoTResult_t prvErase( AzureADUImage_t * const pxAduImage,
+                                  uint32_t ulEnd )
+{
+    uint8_t * pucSlot = prvGetSlot( pxAduImage, pxAduImage->ulUpdateSlot );
+    uint32_t ulStart = pxAduImage->ulErasedLength;
+
+    while( pxAduImage->ulErasedLength < ulEnd )
+    {
+        ( void ) memset( &pucSlot[ pxAduImage->ulErasedLength ], 0xFF, azureiotflashSECTOR_SIZE );
+        prvDelay( pxAduImage->ulEraseLatencyUs );
+        pxAduImage->ulErasedLength += azureiotflashSECTOR_SIZE;
+        pxAduImage->ulSectorEraseCount++;
+    }
+
+    return ( pxAduImage->ulErasedLength > ulStart ) ?
+           prvSyncRegion( pxAduImage, ulStart, pxAduImage->ulErasedLength - ulStart ) : eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t prvReadBootRecord( AzureADUBootRecord_t * pxBootRecord )
+{
+    char cPath[ 256 ];
+    int lFileDescriptor;
+    ssize_t xRead;
+
+    prvGetMetadataPath( cPath, sizeof( cPath ), azureiotflashBOOT_SUFFIX, "" );
+
+    lFileDescriptor = open( cPath, O_RDONLY );
+
+    if( lFileDescriptor < 0 )
+    {
+        return eAzureIoTErrorItemNotFound;
+    }
+
+    xRead = read( lFileDescriptor, pxBootRecord, sizeof( *pxBootRecord ) );
+    ( void ) close( lFileDescriptor );
+
+    if( ( xRead != ( ssize_t ) sizeof( *pxBootRecord ) ) ||
+        ( pxBootRecord->ulMagic != azureiotflashBOOT_MAGIC ) ||
+        ( pxBootRecord->ulSlot >= azureiotflashSLOT_COUNT ) ||
+        ( pxBootRecord->ulImageSize > azureiotflashSLOT_SIZE ) )
+    {
+        AZLogWarn( ( "Ignoring the malformed boot record %s", cPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/* A crash leaves either the previous file or this one. */
+static AzureIoTResult_t prvReplaceFile( const char * pcExtension,
+                                        const void * pvData,
+                                        size_t xLength )
+{
+    char cPath[ 256 ];
+    char cTemporaryPath[ 256 ];
+    int lFileDescriptor;
+    bool xSaved;
+
+    prvGetMetadataPath( cPath, sizeof( cPath ), pcExtension, "" );
+    prvGetMetadataPath( cTemporaryPath, sizeof( cTemporaryPath ), pcExtension, ".tmp" );
+
+    lFileDescriptor = open( cTemporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+    if( lFileDescriptor < 0 )
+    {
+        AZLogError( ( "Unable to open %s", cTemporaryPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    xSaved = ( write( lFileDescriptor, pvData, xLength ) == ( ssize_t ) xLength ) &&
+             ( fdatasync( lFileDescriptor ) == 0 );
+    xSaved = ( close( lFileDescriptor ) == 0 ) && xSaved;
+    xSaved = xSaved && ( rename( cTemporaryPath, cPath ) == 0 );
+
+    if( !xSaved )
+    {
+        AZLogError( ( "Unable to save %s", cPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/* Closes the flash of the previous download and maps it again. */
+static AzureIoTResult_t prvOpenFlash( AzureADUImage_t * const pxAduImage )
+{
+    const char * pcPath = prvGetFlashPath();
+    const off_t xFlashSize = ( off_t ) azureiotflashSLOT_COUNT * azureiotflashSLOT_SIZE;
+    AzureADUBootRecord_t xBootRecord;
+    struct stat xStat;
+    void * pvFlash;
+
+    if( pxAduImage->pucFlash != NULL )
+    {
+        ( void ) munmap( pxAduImage->pucFlash, ( size_t ) xFlashSize );
+        pxAduImage->pucFlash = NULL;
+    }
+
+    /* Zero before the first download, stdin is never the flash file. */
+    if( pxAduImage->lFileDescriptor > 0 )
+    {
+        ( void ) close( pxAduImage->lFileDescriptor );
+    }
+
+    /* The running image is opened again by the next delta update. */
+    if( pxAduImage->lSourceFileDescriptor > 0 )
+    {
+        ( void ) close( pxAduImage->lSourceFileDescriptor );
+        pxAduImage->lSourceFileDescriptor = 0;
+    }
+
+    pxAduImage->pucBufferToWrite = NULL;
+    pxAduImage->ulBytesToWriteLength = 0;
+    pxAduImage->ulCurrentOffset = 0;
+    pxAduImage->ulImageFileSize = 0;
+    pxAduImage->ulErasedLength = 0;
+    pxAduImage->ulEraseLatencyUs = prvGetLatency( azureiotflashERASE_LATENCY_ENVIRONMENT );
+    pxAduImage->ulProgramLatencyUs = prvGetLatency( azureiotflashPROGRAM_LATENCY_ENVIRONMENT );
+    pxAduImage->ulWriteCount = 0;
+    pxAduImage->ulUnalignedWriteCount = 0;
+    pxAduImage->ulPageProgramCount = 0;
+    pxAduImage->ulPartialPageProgramCount = 0;
+    pxAduImage->ulSectorEraseCount = 0;
+
+    if( prvReadBootRecord( &xBootRecord ) == eAzureIoTSuccess )
+    {
+        pxAduImage->lRunningSlot = ( int32_t ) xBootRecord.ulSlot;
+        pxAduImage->ulRunningImageSize = xBootRecord.ulImageSize;
+        pxAduImage->ulUpdateSlot = ( xBootRecord.ulSlot + 1U ) % azureiotflashSLOT_COUNT;
+    }
+    else
+    {
+        pxAduImage->lRunningSlot = -1;
+        pxAduImage->ulRunningImageSize = 0;
+        pxAduImage->ulUpdateSlot = 0;
+    }
+
+    pxAduImage->lFileDescriptor = open( pcPath, O_RDWR | O_CREAT, 0644 );
+
+    if( ( pxAduImage->lFileDescriptor < 0 ) ||
+        ( fstat( pxAduImage->lFileDescriptor, &xStat ) != 0 ) ||
+        ( ( xStat.st_size < xFlashSize ) && ( ftruncate( pxAduImage->lFileDescriptor, xFlashSize ) != 0 ) ) )
+    {
+        AZLogError( ( "Unable to open the flash file %s", pcPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pvFlash = mmap( NULL, ( size_t ) xFlashSize, PROT_READ | PROT_WRITE, MAP_SHARED, pxAduImage->lFileDescriptor, 0 );
+
+    if( pvFlash == MAP_FAILED )
+    {
+        AZLogError( ( "Unable to map the flash file %s", pcPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxAduImage->pucFlash = ( uint8_t * ) pvFlash;
+
+    AZLogInfo( ( "Writing the update image to slot %u of %s", ( unsigned int ) pxAduImage->ulUpdateSlot, pcPath ) );
+
+    return eAzureIoTSuccess;
+}
+
+/* The image is hashed as its blocks are written. */
+static AzureIoTResult_t prvStartHash( AzureADUImage_t * const pxAduImage )
+{
+    mbedtls_md_free( &pxAduImage->xSHA256Context );
+    mbedtls_md_init( &pxAduImage->xSHA256Context );
+
+    pxAduImage->ulHashedLength = 0;
+    pxAduImage->xHashInOrder = true;
+
+    if( ( mbedtls_md_setup( &pxAduImage->xSHA256Context, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 ) != 0 ) ||
+        ( mbedtls_md_starts( &pxAduImage->xSHA256Context ) != 0 ) )
+    {
+        AZLogError( ( "Unable to start the image hash" ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+/* Hash of the image written so far, the running hash carries on. */
+static AzureIoTResult_t prvGetWrittenHash( AzureADUImage_t * const pxAduImage,
+                                           uint8_t * pucHash )
+{
+    mbedtls_md_context_t xContext;
+    int lResult;
+
+    mbedtls_md_init( &xContext );
+
+    lResult = mbedtls_md_setup( &xContext, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 );
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_md_clone( &xContext, &pxAduImage->xSHA256Context );
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = mbedtls_md_finish( &xContext, pucHash );
+    }
+
+    mbedtls_md_free( &xContext );
+
+    return ( lResult == 0 ) ? eAzureIoTSuccess : eAzureIoTErrorFailed;
+}
+
+/* Feeds the region of the update slot already written to the running hash. */
+static AzureIoTResult_t prvHashWrittenRegion( AzureADUImage_t * const pxAduImage,
+                                              uint32_t ulLength )
+{
+    if( mbedtls_md_update( &pxAduImage->xSHA256Context, prvGetSlot( pxAduImage, pxAduImage->ulUpdateSlot ), ulLength ) != 0 )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    pxAduImage->ulHashedLength = ulLength;
+
+    return eAzureIoTSuccess;
+}
+
+static AzureIoTResult_t prvLoadCheckpoint( AzureADUCheckpoint_t * pxCheckpoint )
+{
+    char cPath[ 256 ];
+    int lFileDescriptor;
+    ssize_t xRead;
+
+    prvGetMetadataPath( cPath, sizeof( cPath ), azureiotflashCHECKPOINT_SUFFIX, "" );
+
+    lFileDescriptor = open( cPath, O_RDONLY );
+
+    if( lFileDescriptor < 0 )
+    {
+        return eAzureIoTErrorItemNotFound;
+    }
+
+    xRead = read( lFileDescriptor, pxCheckpoint, sizeof( *pxCheckpoint ) );
+    ( void ) close( lFileDescriptor );
+
+    if( ( xRead != ( ssize_t ) sizeof( *pxCheckpoint ) ) ||
+        ( pxCheckpoint->ulMagic != azureiotflashCHECKPOINT_MAGIC ) )
+    {
+        AZLogWarn( ( "Ignoring the malformed checkpoint %s", cPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
 
 AzureIoTResult_t AzureIoTPlatform_Init( AzureADUImage_t * const pxAduImage )
 {
+    /* The sectors are erased as the image reaches them. */
+    if( prvOpenFlash( pxAduImage ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    return prvStartHash( pxAduImage );
+}
+
+AzureIoTResult_t AzureIoTPlatform_InitResumable( AzureADUImage_t * const pxAduImage,
+                                                 const uint8_t * pucUpdateId,
+                                                 uint32_t ulUpdateIdLength,
+                                                 const uint8_t * pucFileUrl,
+                                                 uint32_t ulFileUrlLength,
+                                                 uint32_t ulImageFileSize )
+{
+    AzureADUCheckpoint_t xCheckpoint;
+    uint8_t ucWrittenHash[ azureiotflashSHA_256_SIZE ];
+    const mbedtls_md_info_t * pxInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+    bool xResume;
+
+    ( void ) mbedtls_md( pxInfo, pucUpdateId, ulUpdateIdLength, pxAduImage->ucUpdateIdHash );
+    ( void ) mbedtls_md( pxInfo, pucFileUrl, ulFileUrlLength, pxAduImage->ucFileUrlHash );
+
+    xResume = ( prvLoadCheckpoint( &xCheckpoint ) == eAzureIoTSuccess ) &&
+              ( memcmp( xCheckpoint.ucUpdateIdHash, pxAduImage->ucUpdateIdHash, azureiotflashSHA_256_SIZE ) == 0 ) &&
+              ( memcmp( xCheckpoint.ucFileUrlHash, pxAduImage->ucFileUrlHash, azureiotflashSHA_256_SIZE ) == 0 ) &&
+              ( xCheckpoint.ulImageFileSize == ulImageFileSize ) &&
+              ( xCheckpoint.ulWrittenLength <= ulImageFileSize ) &&
+              ( xCheckpoint.ulWrittenLength <= azureiotflashSLOT_SIZE ) &&
+              ( ( xCheckpoint.ulWrittenLength % azureiotflashSECTOR_SIZE ) == 0 );
+
+    if( xResume )
+    {
+        /* The region written must still hold what was hashed, the sectors
+         * after it are erased again. */
+        xResume = ( prvOpenFlash( pxAduImage ) == eAzureIoTSuccess ) &&
+                  ( prvStartHash( pxAduImage ) == eAzureIoTSuccess ) &&
+                  ( prvHashWrittenRegion( pxAduImage, xCheckpoint.ulWrittenLength ) == eAzureIoTSuccess ) &&
+                  ( prvGetWrittenHash( pxAduImage, ucWrittenHash ) == eAzureIoTSuccess ) &&
+                  ( memcmp( ucWrittenHash, xCheckpoint.ucWrittenHash, azureiotflashSHA_256_SIZE ) == 0 );
+
+        if( !xResume )
+        {
+            AZLogWarn( ( "The flash file does not match the checkpoint, restarting the download" ) );
+        }
+    }
+
+    if( !xResume )
+    {
+        ( void ) AzureIoTPlatform_ClearCheckpoint( pxAduImage );
+
+        if( AzureIoTPlatform_Init( pxAduImage ) != eAzureIoTSuccess )
+        {
+            return eAzureIoTErrorFailed;
+        }
+    }
+    else
+    {
+        AZLogInfo( ( "Resuming the download at offset %u", ( unsigned int ) xCheckpoint.ulWrittenLength ) );
+        pxAduImage->ulCurrentOffset = ( int32_t ) xCheckpoint.ulWrittenLength;
+        pxAduImage->ulErasedLength = xCheckpoint.ulWrittenLength;
+    }
+
+    pxAduImage->ulImageFileSize = ( int32_t ) ulImageFileSize;
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_SaveCheckpoint( AzureADUImage_t * const pxAduImage,
+                                                  uint32_t * pulSavedLength )
+{
+    AzureADUCheckpoint_t xCheckpoint;
+
+    *pulSavedLength = 0;
+
+    if( !pxAduImage->xHashInOrder || ( ( pxAduImage->ulHashedLength % azureiotflashSECTOR_SIZE ) != 0 ) )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    ( void ) memset( &xCheckpoint, 0, sizeof( xCheckpoint ) );
+    xCheckpoint.ulMagic = azureiotflashCHECKPOINT_MAGIC;
+    ( void ) memcpy( xCheckpoint.ucUpdateIdHash, pxAduImage->ucUpdateIdHash, azureiotflashSHA_256_SIZE );
+    ( void ) memcpy( xCheckpoint.ucFileUrlHash, pxAduImage->ucFileUrlHash, azureiotflashSHA_256_SIZE );
+    xCheckpoint.ulImageFileSize = ( uint32_t ) pxAduImage->ulImageFileSize;
+    xCheckpoint.ulWrittenLength = pxAduImage->ulHashedLength;
+
+    if( prvGetWrittenHash( pxAduImage, xCheckpoint.ucWrittenHash ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    if( prvReplaceFile( azureiotflashCHECKPOINT_SUFFIX, &xCheckpoint, sizeof( xCheckpoint ) ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    *pulSavedLength = xCheckpoint.ulWrittenLength;
+
+    return eAzureIoTSuccess;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ClearCheckpoint( AzureADUImage_t * const pxAduImage )
+{
+    char cPath[ 256 ];
+
     ( void ) pxAduImage;
 
+    prvGetMetadataPath( cPath, sizeof( cPath ), azureiotflashCHECKPOINT_SUFFIX, "" );
+
+    if( ( unlink( cPath ) != 0 ) && ( errno != ENOENT ) )
+    {
+        AZLogError( ( "Unable to remove the checkpoint %s", cPath ) );
+        return eAzureIoTErrorFailed;
+    }
+
     return eAzureIoTSuccess;
 }
 
 int64_t AzureIoTPlatform_GetSingleFlashBootBankSize()
 {
-    return INT64_MAX;
+    return azureiotflashSLOT_SIZE;
 }
 
-AzureIoTResult_t AzureIoTPlatform_WriteBlock( AzureADUImage_t * const pxFileContext,
+AzureIoTResult_t AzureIoTPlatform_WriteBlock( AzureADUImage_t * const pxAduImage,
                                               uint32_t ulOffset,
                                               uint8_t * const pData,
                                               uint32_t ulBlockSize )
 {
-    ( void ) pxFileContext;
-    ( void ) ulOffset;
-    ( void ) pData;
-    ( void ) ulBlockSize;
+    uint8_t * pucSlot = prvGetSlot( pxAduImage, pxAduImage->ulUpdateSlot );
+    uint32_t ulEnd = ulOffset + ulBlockSize;
+    uint32_t ulPage;
+    uint32_t ulIndex;
+
+    if( ( ulOffset > azureiotflashSLOT_SIZE ) || ( ulBlockSize > azureiotflashSLOT_SIZE - ulOffset ) )
+    {
+        AZLogError( ( "Unable to write %u bytes at offset %u, past the end of the slot",
+                      ( unsigned int ) ulBlockSize, ( unsigned int ) ulOffset ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( ulBlockSize == 0U )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    if( prvErase( pxAduImage, ulEnd ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    /* Programming clears bits, a region written twice holds the AND of the
+     * writes. */
+    for( ulIndex = 0; ulIndex < ulBlockSize; ulIndex++ )
+    {
+        pucSlot[ ulOffset + ulIndex ] &= pData[ ulIndex ];
+    }
+
+    pxAduImage->ulWriteCount++;
+
+    if( ( ( ulOffset % azureiotflashSECTOR_SIZE ) != 0U ) || ( ( ulEnd % azureiotflashSECTOR_SIZE ) != 0U ) )
+    {
+        pxAduImage->ulUnalignedWriteCount++;
+    }
+
+    for( ulPage = ulOffset / azureiotflashPAGE_SIZE; ulPage <= ( ulEnd - 1U ) / azureiotflashPAGE_SIZE; ulPage++ )
+    {
+        prvDelay( pxAduImage->ulProgramLatencyUs );
+        pxAduImage->ulPageProgramCount++;
+
+        if( ( ulOffset > ulPage * azureiotflashPAGE_SIZE ) || ( ulEnd < ( ulPage + 1U ) * azureiotflashPAGE_SIZE ) )
+        {
+            pxAduImage->ulPartialPageProgramCount++;
+        }
+    }
+
+    if( prvSyncRegion( pxAduImage, ulOffset, ulBlockSize ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    if( pxAduImage->xHashInOrder && ( ulOffset == pxAduImage->ulHashedLength ) )
+    {
+        ( void ) mbedtls_md_update( &pxAduImage->xSHA256Context, pData, ulBlockSize );
+        pxAduImage->ulHashedLength += ulBlockSize;
+    }
+    else
+    {
+        pxAduImage->xHashInOrder = false;
+    }
+
+    return eAzureIoTSuccess;
+}
+
+uint32_t AzureIoTPlatform_GetSectorSize( AzureADUImage_t * const pxAduImage )
+{
+    ( void ) pxAduImage;
+
+    return azureiotflashSECTOR_SIZE;
+}
+
+AzureIoTResult_t AzureIoTPlatform_EraseSector( AzureADUImage_t * const pxAduImage,
+                                               uint32_t ulOffset )
+{
+    if( ( ( ulOffset % azureiotflashSECTOR_SIZE ) != 0U ) || ( ulOffset >= azureiotflashSLOT_SIZE ) )
+    {
+        AZLogError( ( "Unable to erase the sector at offset %u", ( unsigned int ) ulOffset ) );
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    /* The sectors below the erased length were erased or written by the
+     * update. */
+    return prvErase( pxAduImage, ulOffset + azureiotflashSECTOR_SIZE );
+}
+
+void AzureIoTPlatform_GetFlashCounters( AzureADUImage_t * const pxAduImage,
+                                        AzureADUFlashCounters_t * pxCounters )
+{
+    pxCounters->ulWrites = pxAduImage->ulWriteCount;
+    pxCounters->ulUnalignedWrites = pxAduImage->ulUnalignedWriteCount;
+    pxCounters->ulPagePrograms = pxAduImage->ulPageProgramCount;
+    pxCounters->ulPartialPagePrograms = pxAduImage->ulPartialPageProgramCount;
+    pxCounters->ulSectorErases = pxAduImage->ulSectorEraseCount;
+}
+
+AzureIoTResult_t AzureIoTPlatform_ReadRunningImage( AzureADUImage_t * const pxAduImage,
+                                                    uint32_t ulOffset,
+                                                    uint8_t * pucData,
+                                                    uint32_t ulLength )
+{
+    const char * pcPath;
+
+    if( pxAduImage->lRunningSlot >= 0 )
+    {
+        if( ( ulOffset > pxAduImage->ulRunningImageSize ) || ( ulLength > pxAduImage->ulRunningImageSize - ulOffset ) )
+        {
+            AZLogError( ( "Unable to read %u bytes at offset %u of the running image of %u bytes",
+                          ( unsigned int ) ulLength, ( unsigned int ) ulOffset,
+                          ( unsigned int ) pxAduImage->ulRunningImageSize ) );
+            return eAzureIoTErrorFailed;
+        }
+
+        ( void ) memcpy( pucData, &prvGetSlot( pxAduImage, ( uint32_t ) pxAduImage->lRunningSlot )[ ulOffset ], ulLength );
+
+        return eAzureIoTSuccess;
+    }
+
+    if( pxAduImage->lSourceFileDescriptor <= 0 )
+    {
+        pcPath = getenv( azureiotflashSOURCE_ENVIRONMENT );
+        pcPath = ( pcPath != NULL ) ? pcPath : azureiotflashSOURCE_PATH;
+
+        pxAduImage->lSourceFileDescriptor = open( pcPath, O_RDONLY );
+
+        if( pxAduImage->lSourceFileDescriptor < 0 )
+        {
+            AZLogError( ( "Unable to open the running image %s", pcPath ) );
+            pxAduImage->lSourceFileDescriptor = 0;
+            return eAzureIoTErrorFailed;
+        }
+    }
+
+    if( pread( pxAduImage->lSourceFileDescriptor, pucData, ulLength, ( off_t ) ulOffset ) != ( ssize_t ) ulLength )
+    {
+        AZLogError( ( "Unable to read %u bytes at offset %u of the running image",
+                      ( unsigned int ) ulLength, ( unsigned int ) ulOffset ) );
+        return eAzureIoTErrorFailed;
+    }
 
     return eAzureIoTSuccess;
 }
 
+/* The image is hashed from the slot, which catches writes the flash did not
+ * keep as well as a wrong download. */
 AzureIoTResult_t AzureIoTPlatform_VerifyImage( AzureADUImage_t * const pxAduImage,
                                                uint8_t * pucSHA256Hash,
                                                uint32_t ulSHA256HashLength )
 {
-    ( void ) pxAduImage;
-    ( void ) pucSHA256Hash;
-    ( void ) ulSHA256HashLength;
+    uint8_t ucExpectedHash[ azureiotflashSHA_256_SIZE ];
+    uint8_t ucCalculatedHash[ azureiotflashSHA_256_SIZE ];
+    size_t xHashLength;
+
+    if( ( mbedtls_base64_decode( ucExpectedHash, sizeof( ucExpectedHash ), &xHashLength,
+                                 pucSHA256Hash, ulSHA256HashLength ) != 0 ) ||
+        ( xHashLength != sizeof( ucExpectedHash ) ) )
+    {
+        AZLogError( ( "Unable to decode the base64 SHA-256 %.*s", ( int ) ulSHA256HashLength, pucSHA256Hash ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( ( pxAduImage->pucFlash == NULL ) || ( pxAduImage->ulImageFileSize < 0 ) ||
+        ( ( uint32_t ) pxAduImage->ulImageFileSize > azureiotflashSLOT_SIZE ) ||
+        ( mbedtls_md( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
+                      prvGetSlot( pxAduImage, pxAduImage->ulUpdateSlot ),
+                      ( size_t ) pxAduImage->ulImageFileSize, ucCalculatedHash ) != 0 ) )
+    {
+        AZLogError( ( "Unable to hash the image of slot %u", ( unsigned int ) pxAduImage->ulUpdateSlot ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( memcmp( ucExpectedHash, ucCalculatedHash, sizeof( ucCalculatedHash ) ) != 0 )
+    {
+        AZLogError( ( "The image of slot %u does not match its SHA-256", ( unsigned int ) pxAduImage->ulUpdateSlot ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    AZLogInfo( ( "The image of slot %u matches its SHA-256", ( unsigned int ) pxAduImage->ulUpdateSlot ) );
 
     return eAzureIoTSuccess;
 }
 
 AzureIoTResult_t AzureIoTPlatform_EnableImage( AzureADUImage_t * const pxAduImage )
 {
-    ( void ) pxAduImage;
+    AzureADUBootRecord_t xBootRecord;
+
+    ( void ) memset( &xBootRecord, 0, sizeof( xBootRecord ) );
+    xBootRecord.ulMagic = azureiotflashBOOT_MAGIC;
+    xBootRecord.ulSlot = pxAduImage->ulUpdateSlot;
+    xBootRecord.ulImageSize = ( uint32_t ) pxAduImage->ulImageFileSize;
+
+    if( prvReplaceFile( azureiotflashBOOT_SUFFIX, &xBootRecord, sizeof( xBootRecord ) ) != eAzureIoTSuccess )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    AZLogInfo( ( "The device boots slot %u", ( unsigned int ) pxAduImage->ulUpdateSlot ) );
 
     return eAzureIoTSuccess;
 }
 
+/* The process keeps running, the next download takes the enabled slot as the
+ * running one. */
 AzureIoTResult_t AzureIoTPlatform_ResetDevice( AzureADUImage_t * const pxAduImage )
 {
     ( void ) pxAduImage;
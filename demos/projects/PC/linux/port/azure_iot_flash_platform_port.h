@@ -11,12 +11,36 @@
 #ifndef AZURE_IOT_FLASH_PLATFORM_PORT_H
 #define AZURE_IOT_FLASH_PLATFORM_PORT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mbedtls/md.h"
+
 typedef struct AzureADUImageContext
 {
-    uint8_t * pucBufferToWrite;   /**< The buffer containing the bytes to write to the flash. */
-    int32_t ulBytesToWriteLength; /**< The length of the buffer from which to write the bytes. */
-    int32_t ulCurrentOffset;      /**< The offset for the partition to write the bytes. */
-    int32_t ulImageFileSize;      /**< The total size of the file to write. */
+    uint8_t * pucBufferToWrite;          /**< The buffer containing the bytes to write to the flash. */
+    int32_t ulBytesToWriteLength;        /**< The length of the buffer from which to write the bytes. */
+    int32_t ulCurrentOffset;             /**< The offset for the partition to write the bytes. */
+    int32_t ulImageFileSize;             /**< The total size of the file to write. */
+    int lFileDescriptor;                 /**< The file backing the flash. */
+    uint8_t * pucFlash;                  /**< The file backing the flash, mapped. */
+    uint32_t ulUpdateSlot;               /**< The slot the update is written to. */
+    int32_t lRunningSlot;                /**< The slot the device runs, -1 for the factory image. */
+    uint32_t ulRunningImageSize;         /**< The size of the image in the running slot. */
+    uint32_t ulErasedLength;             /**< The length of the update slot erased and not programmed since. */
+    uint32_t ulEraseLatencyUs;           /**< Simulated duration of a sector erase. */
+    uint32_t ulProgramLatencyUs;         /**< Simulated duration of a page program. */
+    uint32_t ulWriteCount;               /**< Blocks written by the update. */
+    uint32_t ulUnalignedWriteCount;      /**< Blocks starting or ending inside a sector. */
+    uint32_t ulPageProgramCount;         /**< Pages programmed by the update. */
+    uint32_t ulPartialPageProgramCount;  /**< Pages programmed without their whole content. */
+    uint32_t ulSectorEraseCount;         /**< Sectors erased by the update. */
+    int lSourceFileDescriptor;           /**< The factory image, source of the delta updates. */
+    mbedtls_md_context_t xSHA256Context; /**< SHA-256 of the blocks written so far. */
+    uint32_t ulHashedLength;             /**< The length of the image hashed so far. */
+    bool xHashInOrder;                   /**< False once a block was written out of order. */
+    uint8_t ucUpdateIdHash[ 32 ];        /**< SHA-256 of the update id of a resumable download. */
+    uint8_t ucFileUrlHash[ 32 ];         /**< SHA-256 of the file URL of a resumable download. */
 } AzureADUImageContext_t;
 
 typedef AzureADUImageContext_t AzureADUImage_t;
@@ -0,0 +1,406 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_trace.c
+ * @brief Implements the Chrome trace event export of the Linux port.
+ *
+ * The kernel hooks run inside the scheduler and the critical sections, and on
+ * this port from the signal handler of the tick, so recording an event only
+ * reads the monotonic clock and fills a slot of the ring buffer. Slots are
+ * reserved by moving the head with a compare and swap and published by
+ * setting their sequence number. The writer task, or a flush, is the only
+ * consumer.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if ( configSAMPLE_TRACE_EXPORT == 1 )
+
+    #include "azure_sample_trace.h"
+
+/*-----------------------------------------------------------*/
+
+    #if ( ( sampletraceRING_EVENTS & ( sampletraceRING_EVENTS - 1U ) ) != 0U )
+        #error "sampletraceRING_EVENTS must be a power of two"
+    #endif
+
+    #define sampletraceRING_MASK             ( sampletraceRING_EVENTS - 1U )
+
+    #define sampletraceTASK_STACK_SIZE       ( configMINIMAL_STACK_SIZE * 4 )
+    #define sampletraceTASK_PRIORITY         ( tskIDLE_PRIORITY )
+
+/* Process and thread ids of the tracks. */
+    #define sampletraceCPU_PID               1
+    #define sampletraceCPU_TID               1
+    #define sampletraceTASKS_PID             2
+
+    #define sampletraceFILE_ENVIRONMENT      "AZURE_IOT_TRACE_FILE"
+
+/*-----------------------------------------------------------*/
+
+typedef enum TraceExportEventType
+{
+    eTraceExportEventTaskCreate = 0, /**< Names the track of a task. */
+    eTraceExportEventTaskRun,        /**< A task ran on the CPU, from a switch in to a switch out. */
+    eTraceExportEventSpanBegin,
+    eTraceExportEventSpanEnd,
+    eTraceExportEventQueue
+} TraceExportEventType_t;
+
+typedef struct TraceExportEvent
+{
+    uint32_t ulSequence;                          /**< Index of the event plus one, once written. */
+    uint8_t ucType;                               /**< One of #TraceExportEventType_t. */
+    uint8_t ucQueueEvent;                         /**< One of #TraceExportQueueEvent_t. */
+    uint64_t ullTimestampNs;
+    uint64_t ullDurationNs;
+    uintptr_t uxTask;                             /**< Task the event belongs to, its id in the trace. */
+    uintptr_t uxQueue;
+    const char * pcName;                          /**< Name of a span. */
+    char cTaskName[ configMAX_TASK_NAME_LEN + 1 ]; /**< Copy of the task name, the task may be deleted before the write. */
+} TraceExportEvent_t;
+
+/*-----------------------------------------------------------*/
+
+static TraceExportEvent_t xRing[ sampletraceRING_EVENTS ];
+
+/* Free running indexes, the producers move the head and the writer the tail. */
+static uint32_t ulHead = 0;
+static uint32_t ulTail = 0;
+
+static uint32_t ulDroppedCount = 0;
+static uint32_t ulReportedDroppedCount = 0;
+
+/* Only written by the switch hooks, which the scheduler serializes. */
+static uintptr_t uxCurrentTask = 0;
+static uint64_t ullRunningSinceNs = 0;
+
+static FILE * pxTraceFile = NULL;
+static uint32_t ulWriterBusy = 0;
+
+static const char * const pcQueueEventNames[] =
+{
+    "queue send",
+    "queue receive",
+    "blocked on queue send",
+    "blocked on queue receive",
+    "semaphore give",
+    "semaphore take",
+    "blocked on semaphore take"
+};
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetTimeNs( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000ULL ) + ( uint64_t ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+/* Reserves the slot of the next event, NULL when the ring buffer is full. */
+static TraceExportEvent_t * prvReserve( uint32_t * pulIndex )
+{
+    uint32_t ulIndex = __atomic_load_n( &ulHead, __ATOMIC_RELAXED );
+
+    do
+    {
+        if( ( ulIndex - __atomic_load_n( &ulTail, __ATOMIC_ACQUIRE ) ) >= sampletraceRING_EVENTS )
+        {
+            ( void ) __atomic_fetch_add( &ulDroppedCount, 1U, __ATOMIC_RELAXED );
+            return NULL;
+        }
+    } while( !__atomic_compare_exchange_n( &ulHead, &ulIndex, ulIndex + 1U, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+
+    *pulIndex = ulIndex;
+
+    return &xRing[ ulIndex & sampletraceRING_MASK ];
+}
+/*-----------------------------------------------------------*/
+
+static void prvCommit( TraceExportEvent_t * pxEvent,
+                       uint32_t ulIndex )
+{
+    __atomic_store_n( &pxEvent->ulSequence, ulIndex + 1U, __ATOMIC_RELEASE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCopyTaskName( TraceExportEvent_t * pxEvent,
+                             const char * pcName )
+{
+    size_t xIndex;
+
+    /* Quotes and backslashes would break the JSON strings. */
+    for( xIndex = 0; ( xIndex < configMAX_TASK_NAME_LEN ) && ( pcName[ xIndex ] != '\0' ); xIndex++ )
+    {
+        pxEvent->cTaskName[ xIndex ] = ( ( pcName[ xIndex ] == '"' ) || ( pcName[ xIndex ] == '\\' ) ) ? '_' : pcName[ xIndex ];
+    }
+
+    pxEvent->cTaskName[ xIndex ] = '\0';
+}
+/*-----------------------------------------------------------*/
+
+static void prvRecord( TraceExportEventType_t xType,
+                       uintptr_t uxTask,
+                       const char * pcName )
+{
+    TraceExportEvent_t * pxEvent;
+    uint32_t ulIndex;
+
+    if( ( pxEvent = prvReserve( &ulIndex ) ) != NULL )
+    {
+        pxEvent->ucType = ( uint8_t ) xType;
+        pxEvent->ullTimestampNs = prvGetTimeNs();
+        pxEvent->uxTask = uxTask;
+        pxEvent->pcName = pcName;
+        prvCommit( pxEvent, ulIndex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteTimestamp( uint64_t ullNs )
+{
+    ( void ) fprintf( pxTraceFile, "%llu.%03u",
+                      ( unsigned long long ) ( ullNs / 1000U ), ( unsigned ) ( ullNs % 1000U ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteEvent( const TraceExportEvent_t * pxEvent )
+{
+    switch( pxEvent->ucType )
+    {
+        case eTraceExportEventTaskCreate:
+            ( void ) fprintf( pxTraceFile,
+                              ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                              sampletraceTASKS_PID, ( unsigned long ) pxEvent->uxTask, pxEvent->cTaskName );
+            break;
+
+        case eTraceExportEventTaskRun:
+            ( void ) fprintf( pxTraceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":",
+                              pxEvent->cTaskName, sampletraceCPU_PID, sampletraceCPU_TID );
+            prvWriteTimestamp( pxEvent->ullTimestampNs );
+            ( void ) fputs( ",\"dur\":", pxTraceFile );
+            prvWriteTimestamp( pxEvent->ullDurationNs );
+            ( void ) fputc( '}', pxTraceFile );
+            break;
+
+        case eTraceExportEventSpanBegin:
+        case eTraceExportEventSpanEnd:
+            ( void ) fprintf( pxTraceFile, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%lu,\"ts\":",
+                              pxEvent->pcName, ( pxEvent->ucType == eTraceExportEventSpanBegin ) ? 'B' : 'E',
+                              sampletraceTASKS_PID, ( unsigned long ) pxEvent->uxTask );
+            prvWriteTimestamp( pxEvent->ullTimestampNs );
+            ( void ) fputc( '}', pxTraceFile );
+            break;
+
+        case eTraceExportEventQueue:
+            ( void ) fprintf( pxTraceFile, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%lu,\"ts\":",
+                              pcQueueEventNames[ pxEvent->ucQueueEvent ], sampletraceTASKS_PID,
+                              ( unsigned long ) pxEvent->uxTask );
+            prvWriteTimestamp( pxEvent->ullTimestampNs );
+            ( void ) fprintf( pxTraceFile, ",\"args\":{\"queue\":\"0x%lx\"}}", ( unsigned long ) pxEvent->uxQueue );
+            break;
+
+        default:
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriterTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        TraceExport_Flush();
+        vTaskDelay( pdMS_TO_TICKS( sampletraceFLUSH_PERIOD_MS ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+int TraceExport_Start( const char * pcPath )
+{
+    if( pxTraceFile != NULL )
+    {
+        return 0;
+    }
+
+    if( pcPath == NULL )
+    {
+        pcPath = getenv( sampletraceFILE_ENVIRONMENT );
+    }
+
+    if( pcPath == NULL )
+    {
+        pcPath = sampletraceDEFAULT_FILE;
+    }
+
+    pxTraceFile = fopen( pcPath, "w" );
+
+    if( pxTraceFile == NULL )
+    {
+        return -1;
+    }
+
+    /* Every event after these starts with a comma, so the file stays valid
+     * without its closing bracket whenever the application is stopped. */
+    ( void ) fprintf( pxTraceFile,
+                      "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"CPU\"}},\n"
+                      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"FreeRTOS scheduler\"}},\n"
+                      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"Tasks\"}}",
+                      sampletraceCPU_PID, sampletraceCPU_PID, sampletraceCPU_TID, sampletraceTASKS_PID );
+
+    if( xTaskCreate( prvWriterTask, "TraceExport", sampletraceTASK_STACK_SIZE,
+                     NULL, sampletraceTASK_PRIORITY, NULL ) != pdPASS )
+    {
+        ( void ) fclose( pxTraceFile );
+        pxTraceFile = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_Flush( void )
+{
+    uint32_t ulIndex;
+    uint32_t ulDropped;
+    TraceExportEvent_t xEvent;
+    TraceExportEvent_t * pxSlot;
+
+    if( pxTraceFile == NULL )
+    {
+        return;
+    }
+
+    /* An assert may flush while the writer task is writing. */
+    if( __atomic_exchange_n( &ulWriterBusy, 1U, __ATOMIC_ACQUIRE ) != 0U )
+    {
+        return;
+    }
+
+    ulIndex = __atomic_load_n( &ulTail, __ATOMIC_RELAXED );
+
+    for( ; ; )
+    {
+        pxSlot = &xRing[ ulIndex & sampletraceRING_MASK ];
+
+        if( __atomic_load_n( &pxSlot->ulSequence, __ATOMIC_ACQUIRE ) != ( ulIndex + 1U ) )
+        {
+            break;
+        }
+
+        /* Copied so the slot can be given back before the write. */
+        xEvent = *pxSlot;
+        ulIndex++;
+        __atomic_store_n( &ulTail, ulIndex, __ATOMIC_RELEASE );
+
+        prvWriteEvent( &xEvent );
+    }
+
+    ulDropped = __atomic_load_n( &ulDroppedCount, __ATOMIC_RELAXED );
+
+    if( ulDropped != ulReportedDroppedCount )
+    {
+        ( void ) fprintf( pxTraceFile, ",\n{\"name\":\"%u events dropped\",\"ph\":\"i\",\"s\":\"g\",\"pid\":%d,\"tid\":%d,\"ts\":",
+                          ( unsigned ) ( ulDropped - ulReportedDroppedCount ), sampletraceCPU_PID, sampletraceCPU_TID );
+        prvWriteTimestamp( prvGetTimeNs() );
+        ( void ) fputc( '}', pxTraceFile );
+        ulReportedDroppedCount = ulDropped;
+    }
+
+    ( void ) fflush( pxTraceFile );
+
+    __atomic_store_n( &ulWriterBusy, 0U, __ATOMIC_RELEASE );
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_SpanBegin( const char * pcName )
+{
+    prvRecord( eTraceExportEventSpanBegin, __atomic_load_n( &uxCurrentTask, __ATOMIC_RELAXED ), pcName );
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_SpanEnd( const char * pcName )
+{
+    prvRecord( eTraceExportEventSpanEnd, __atomic_load_n( &uxCurrentTask, __ATOMIC_RELAXED ), pcName );
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_TaskCreate( const void * pvTask,
+                             const char * pcName )
+{
+    TraceExportEvent_t * pxEvent;
+    uint32_t ulIndex;
+
+    if( ( pxEvent = prvReserve( &ulIndex ) ) != NULL )
+    {
+        pxEvent->ucType = eTraceExportEventTaskCreate;
+        pxEvent->uxTask = ( uintptr_t ) pvTask;
+        prvCopyTaskName( pxEvent, pcName );
+        prvCommit( pxEvent, ulIndex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_TaskSwitchedIn( const void * pvTask )
+{
+    __atomic_store_n( &uxCurrentTask, ( uintptr_t ) pvTask, __ATOMIC_RELAXED );
+    ullRunningSinceNs = prvGetTimeNs();
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_TaskSwitchedOut( const void * pvTask,
+                                  const char * pcName )
+{
+    TraceExportEvent_t * pxEvent;
+    uint32_t ulIndex;
+    uint64_t ullNow;
+
+    if( ( ullRunningSinceNs != 0U ) && ( ( pxEvent = prvReserve( &ulIndex ) ) != NULL ) )
+    {
+        ullNow = prvGetTimeNs();
+        pxEvent->ucType = eTraceExportEventTaskRun;
+        pxEvent->ullTimestampNs = ullRunningSinceNs;
+        pxEvent->ullDurationNs = ullNow - ullRunningSinceNs;
+        pxEvent->uxTask = ( uintptr_t ) pvTask;
+        prvCopyTaskName( pxEvent, pcName );
+        prvCommit( pxEvent, ulIndex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void TraceExport_QueueEvent( const void * pvQueue,
+                             TraceExportQueueEvent_t xEvent )
+{
+    TraceExportEvent_t * pxEvent;
+    uint32_t ulIndex;
+
+    if( ( pxEvent = prvReserve( &ulIndex ) ) != NULL )
+    {
+        pxEvent->ucType = eTraceExportEventQueue;
+        pxEvent->ucQueueEvent = ( uint8_t ) xEvent;
+        pxEvent->ullTimestampNs = prvGetTimeNs();
+        pxEvent->uxTask = __atomic_load_n( &uxCurrentTask, __ATOMIC_RELAXED );
+        pxEvent->uxQueue = ( uintptr_t ) pvQueue;
+        prvCommit( pxEvent, ulIndex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configSAMPLE_TRACE_EXPORT == 1 */
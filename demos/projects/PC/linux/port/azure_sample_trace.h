@@ -0,0 +1,126 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_sample_trace.h
+ * @brief Chrome trace event export of the Linux port.
+ *
+ * The FreeRTOS trace macros and the spans of the samples record events into a
+ * lock-free ring buffer. A low priority task writes them to a file in the
+ * Chrome trace event JSON format, which Perfetto (https://ui.perfetto.dev)
+ * and chrome://tracing can open:
+ * - the "CPU" process shows which task runs, one slice per switch;
+ * - the "Tasks" process has one track per task with the spans of the
+ *   samples and the queue and semaphore operations.
+ *
+ * The file is written as it goes and is never closed, the format allows the
+ * closing bracket of the event array to be missing.
+ *
+ * @note Included by FreeRTOSConfig.h when configSAMPLE_TRACE_EXPORT is 1, so
+ * it cannot depend on the FreeRTOS headers.
+ */
+
+#ifndef AZURE_SAMPLE_TRACE_H
+#define AZURE_SAMPLE_TRACE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Number of events of the ring buffer, must be a power of two.
+ * Events are dropped, and counted in the trace, when it is full.
+ */
+#ifndef sampletraceRING_EVENTS
+    #define sampletraceRING_EVENTS    ( 16384U )
+#endif
+
+/**
+ * @brief Period at which the writer task writes the recorded events.
+ */
+#ifndef sampletraceFLUSH_PERIOD_MS
+    #define sampletraceFLUSH_PERIOD_MS    ( 50U )
+#endif
+
+/**
+ * @brief File written when the AZURE_IOT_TRACE_FILE environment variable is
+ * not set.
+ */
+#ifndef sampletraceDEFAULT_FILE
+    #define sampletraceDEFAULT_FILE    "azure_iot_trace.json"
+#endif
+
+/**
+ * @brief Queue operations recorded by the kernel trace macros.
+ */
+typedef enum TraceExportQueueEvent
+{
+    eTraceExportQueueSend = 0,
+    eTraceExportQueueReceive,
+    eTraceExportQueueBlockedOnSend,
+    eTraceExportQueueBlockedOnReceive,
+    eTraceExportSemaphoreGive,
+    eTraceExportSemaphoreTake,
+    eTraceExportSemaphoreBlockedOnTake
+} TraceExportQueueEvent_t;
+
+/**
+ * @brief Open the trace file and start the writer task.
+ *
+ * Events recorded before this call are kept, as long as the ring buffer can
+ * hold them.
+ *
+ * @param[in] pcPath Path of the trace file, NULL for the AZURE_IOT_TRACE_FILE
+ * environment variable or #sampletraceDEFAULT_FILE.
+ * @return 0 on success, -1 if the file could not be opened or the task created.
+ */
+int TraceExport_Start( const char * pcPath );
+
+/**
+ * @brief Write the recorded events from the calling task, e.g. before halting.
+ */
+void TraceExport_Flush( void );
+
+/**
+ * @brief Begin a span on the track of the calling task.
+ *
+ * @param[in] pcName Name of the span, must stay valid for the lifetime of the application.
+ */
+void TraceExport_SpanBegin( const char * pcName );
+
+/**
+ * @brief End the last span begun by the calling task.
+ *
+ * @param[in] pcName Name of the span.
+ */
+void TraceExport_SpanEnd( const char * pcName );
+
+/* Kernel hooks, see the trace macros below. */
+void TraceExport_TaskCreate( const void * pvTask,
+                             const char * pcName );
+void TraceExport_TaskSwitchedIn( const void * pvTask );
+void TraceExport_TaskSwitchedOut( const void * pvTask,
+                                  const char * pcName );
+void TraceExport_QueueEvent( const void * pvQueue,
+                             TraceExportQueueEvent_t xEvent );
+
+/*-----------------------------------------------------------*/
+
+/* Semaphores and mutexes are queues of items of size zero. */
+#define sampletraceQUEUE_EVENT( pxQueue, xQueueEvent, xSemaphoreEvent ) \
+    TraceExport_QueueEvent( ( pxQueue ), ( ( pxQueue )->uxItemSize == 0U ) ? ( xSemaphoreEvent ) : ( xQueueEvent ) )
+
+#define traceTASK_CREATE( pxNewTCB )                  TraceExport_TaskCreate( ( pxNewTCB ), ( pxNewTCB )->pcTaskName )
+#define traceTASK_SWITCHED_IN()                       TraceExport_TaskSwitchedIn( pxCurrentTCB )
+#define traceTASK_SWITCHED_OUT()                      TraceExport_TaskSwitchedOut( pxCurrentTCB, pxCurrentTCB->pcTaskName )
+
+#define traceQUEUE_SEND( pxQueue )                    sampletraceQUEUE_EVENT( pxQueue, eTraceExportQueueSend, eTraceExportSemaphoreGive )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )           sampletraceQUEUE_EVENT( pxQueue, eTraceExportQueueSend, eTraceExportSemaphoreGive )
+#define traceQUEUE_RECEIVE( pxQueue )                 sampletraceQUEUE_EVENT( pxQueue, eTraceExportQueueReceive, eTraceExportSemaphoreTake )
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )        sampletraceQUEUE_EVENT( pxQueue, eTraceExportQueueReceive, eTraceExportSemaphoreTake )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue )        TraceExport_QueueEvent( ( pxQueue ), eTraceExportQueueBlockedOnSend )
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )     sampletraceQUEUE_EVENT( pxQueue, eTraceExportQueueBlockedOnReceive, eTraceExportSemaphoreBlockedOnTake )
+
+/* Spans of the samples, empty unless defined here, see azure_sample_trace_span.h. */
+#define traceSAMPLE_SPAN_BEGIN( pcName )              TraceExport_SpanBegin( pcName )
+#define traceSAMPLE_SPAN_END( pcName )                TraceExport_SpanEnd( pcName )
+
+#endif /* AZURE_SAMPLE_TRACE_H */
@@ -0,0 +1,199 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the chunk size controller, fed with the times of a simulated
+ * link with a fixed round trip and bandwidth.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "azure_sample_adaptive_chunk.h"
+
+#define TEST_ADAPTIVE_CHUNK_SUCCESS    0
+#define TEST_ADAPTIVE_CHUNK_FAIL       1
+
+#define TEST_MIN_SIZE                  ( 4096U )
+#define TEST_MAX_SIZE                  ( 65536U )
+#define TEST_TARGET_TIME_MS            ( 2000U )
+#define TEST_LARGE_HEAP                ( 1024U * 1024U )
+
+static AdaptiveChunk_t xChunk;
+
+/*-----------------------------------------------------------*/
+
+/* Reads chunks over the link, checking the sizes stay aligned and bounded. */
+static int prvRun( uint32_t ulRttMs,
+                   uint32_t ulBytesPerSecond,
+                   uint32_t ulFreeHeap,
+                   uint32_t ulChunkCount )
+{
+    uint32_t ulSize;
+    uint32_t ulElapsedMs;
+
+    while( ulChunkCount-- > 0U )
+    {
+        ulSize = AdaptiveChunk_GetSize( &xChunk );
+        ulElapsedMs = ulRttMs + ( uint32_t ) ( ( ( uint64_t ) ulSize * 1000U ) / ulBytesPerSecond );
+        ulSize = AdaptiveChunk_OnSuccess( &xChunk, ulSize, ulElapsedMs, ulRttMs, ulFreeHeap );
+
+        if( ( ulSize < xChunk.ulMinSize ) || ( ulSize > xChunk.ulMaxSize ) || ( ( ulSize % xChunk.ulMinSize ) != 0U ) )
+        {
+            printf( "\tUnexpected chunk size %u\n", ( unsigned ) ulSize );
+            return TEST_ADAPTIVE_CHUNK_FAIL;
+        }
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestGrowOnLatency( void )
+{
+    printf( "Growing the chunks over a link with a long round trip\n" );
+    AdaptiveChunk_Init( &xChunk, TEST_MIN_SIZE, TEST_MAX_SIZE, TEST_TARGET_TIME_MS );
+
+    /* 200 ms round trip, 1 MB/s: every doubling nearly doubles the goodput. */
+    if( prvRun( 200, 1000000, TEST_LARGE_HEAP, 64 ) != TEST_ADAPTIVE_CHUNK_SUCCESS )
+    {
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    if( ( AdaptiveChunk_GetSize( &xChunk ) != TEST_MAX_SIZE ) || ( xChunk.ulShrinks != 0U ) )
+    {
+        printf( "\tSize %u after %u growths and %u shrinks\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ),
+                ( unsigned ) xChunk.ulGrowths, ( unsigned ) xChunk.ulShrinks );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRevertWithoutGain( void )
+{
+    printf( "Keeping the chunks small when larger ones bring no gain\n" );
+    AdaptiveChunk_Init( &xChunk, TEST_MIN_SIZE, TEST_MAX_SIZE, TEST_TARGET_TIME_MS );
+
+    /* No round trip: the goodput does not depend on the size. */
+    if( prvRun( 0, 100000, TEST_LARGE_HEAP, 100 ) != TEST_ADAPTIVE_CHUNK_SUCCESS )
+    {
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    /* One probe, then one more after each hold. */
+    if( ( AdaptiveChunk_GetSize( &xChunk ) != TEST_MIN_SIZE ) ||
+        ( xChunk.ulGrowths > ( 100U / adaptivechunkHOLD_AFTER_REVERT ) + 1U ) )
+    {
+        printf( "\tSize %u after %u growths\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ),
+                ( unsigned ) xChunk.ulGrowths );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestShrinkOnSlowLink( void )
+{
+    uint32_t ulSize;
+
+    printf( "Shrinking the chunks when the link slows down\n" );
+    AdaptiveChunk_Init( &xChunk, TEST_MIN_SIZE, TEST_MAX_SIZE, TEST_TARGET_TIME_MS );
+
+    if( ( prvRun( 200, 1000000, TEST_LARGE_HEAP, 64 ) != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( AdaptiveChunk_GetSize( &xChunk ) != TEST_MAX_SIZE ) )
+    {
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    /* 64 KB now take 3.4 s, the chunks must shrink back under 2 s. */
+    if( prvRun( 200, 20000, TEST_LARGE_HEAP, 8 ) != TEST_ADAPTIVE_CHUNK_SUCCESS )
+    {
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    ulSize = AdaptiveChunk_GetSize( &xChunk );
+
+    if( ( ulSize >= TEST_MAX_SIZE ) || ( ( 200U + ( ulSize * 1000U ) / 20000U ) > TEST_TARGET_TIME_MS ) )
+    {
+        printf( "\tSize %u on the slow link\n", ( unsigned ) ulSize );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestFailuresAndHeap( void )
+{
+    printf( "Shrinking on failures and growing within the free heap\n" );
+    AdaptiveChunk_Init( &xChunk, TEST_MIN_SIZE, TEST_MAX_SIZE, TEST_TARGET_TIME_MS );
+
+    /* Growth stops at the free heap. */
+    if( ( prvRun( 200, 1000000, 20000, 64 ) != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( AdaptiveChunk_GetSize( &xChunk ) != 16384U ) )
+    {
+        printf( "\tSize %u with 20000 bytes of heap\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ) );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    if( ( AdaptiveChunk_OnFailure( &xChunk ) != 8192U ) ||
+        ( AdaptiveChunk_OnFailure( &xChunk ) != TEST_MIN_SIZE ) ||
+        ( AdaptiveChunk_OnFailure( &xChunk ) != TEST_MIN_SIZE ) ||
+        ( xChunk.ulFailures != 3U ) )
+    {
+        printf( "\tSize %u after failures\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ) );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    /* No growth while holding. */
+    if( ( prvRun( 200, 1000000, TEST_LARGE_HEAP, adaptivechunkHOLD_AFTER_SHRINK ) != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( AdaptiveChunk_GetSize( &xChunk ) != TEST_MIN_SIZE ) )
+    {
+        printf( "\tThe chunks grew right after a failure\n" );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestUnalignedMaximum( void )
+{
+    printf( "Keeping the chunks aligned with a maximum not multiple of the minimum\n" );
+    AdaptiveChunk_Init( &xChunk, TEST_MIN_SIZE, 3U * TEST_MIN_SIZE + 100U, TEST_TARGET_TIME_MS );
+
+    if( ( prvRun( 200, 1000000, TEST_LARGE_HEAP, 64 ) != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( AdaptiveChunk_GetSize( &xChunk ) != 3U * TEST_MIN_SIZE ) )
+    {
+        printf( "\tSize %u\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ) );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    /* Half of 3 sectors is rounded down to 1. */
+    if( AdaptiveChunk_OnFailure( &xChunk ) != TEST_MIN_SIZE )
+    {
+        printf( "\tSize %u after a failure\n", ( unsigned ) AdaptiveChunk_GetSize( &xChunk ) );
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestGrowOnLatency() != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( prvTestRevertWithoutGain() != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( prvTestShrinkOnSlowLink() != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( prvTestFailuresAndHeap() != TEST_ADAPTIVE_CHUNK_SUCCESS ) ||
+        ( prvTestUnalignedMaximum() != TEST_ADAPTIVE_CHUNK_SUCCESS ) )
+    {
+        return TEST_ADAPTIVE_CHUNK_FAIL;
+    }
+
+    return TEST_ADAPTIVE_CHUNK_SUCCESS;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,297 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the coalescing of the ADU writes: chunks not aligned to the
+ * flash sectors written by whole sectors, and the sectors erased ahead, on
+ * the flash of the Linux port.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_sector.h"
+#include "sample_azure_iot_adu_coalesce.h"
+#include "adu_image_compress.h"
+
+#define TEST_ADU_COALESCE_SUCCESS    0
+#define TEST_ADU_COALESCE_FAIL       1
+
+#define TEST_IMAGE_SIZE              ( 50000U )
+#define TEST_SECTOR_SIZE             ( 4096U )
+#define TEST_PAGE_SIZE               ( 256U )
+#define TEST_SECTOR_COUNT            ( ( TEST_IMAGE_SIZE + TEST_SECTOR_SIZE - 1U ) / TEST_SECTOR_SIZE )
+#define TEST_PAGE_COUNT              ( ( TEST_IMAGE_SIZE + TEST_PAGE_SIZE - 1U ) / TEST_PAGE_SIZE )
+
+static uint8_t ucImage[ TEST_IMAGE_SIZE ];
+static uint8_t ucRead[ TEST_IMAGE_SIZE ];
+static char cImageHash[ 45 ];
+static char cFlashPath[ 128 ];
+static AzureADUImage_t xImage;
+static SampleADUCoalesce_t xCoalesce;
+
+/*-----------------------------------------------------------*/
+
+/* Writes the image from ulOffset in chunks of ulChunkSize bytes, through the
+ * coalescing or straight to the port. */
+static int prvWriteImage( uint32_t ulStartOffset,
+                          uint32_t ulChunkSize,
+                          bool xCoalesced )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    for( ulOffset = ulStartOffset; ulOffset < TEST_IMAGE_SIZE; ulOffset += ulLength )
+    {
+        ulLength = ( TEST_IMAGE_SIZE - ulOffset < ulChunkSize ) ? TEST_IMAGE_SIZE - ulOffset : ulChunkSize;
+
+        if( xCoalesced )
+        {
+            xResult = SampleADUCoalesce_Write( &xCoalesce, ulOffset, &ucImage[ ulOffset ], ulLength );
+        }
+        else
+        {
+            xResult = AzureIoTPlatform_WriteBlock( &xImage, ulOffset, &ucImage[ ulOffset ], ulLength );
+        }
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            printf( "\tWriting the chunk at offset %u failed!\n", ( unsigned ) ulOffset );
+            return TEST_ADU_COALESCE_FAIL;
+        }
+    }
+
+    xImage.ulImageFileSize = ( int32_t ) TEST_IMAGE_SIZE;
+
+    if( AzureIoTPlatform_VerifyImage( &xImage, ( uint8_t * ) cImageHash, strlen( cImageHash ) ) != eAzureIoTSuccess )
+    {
+        printf( "\tThe flash does not hold the image!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    return TEST_ADU_COALESCE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* Reads the update slot from the flash file, where the port does not look. */
+static int prvReadSlot( void )
+{
+    int lFileDescriptor = open( cFlashPath, O_RDONLY );
+    ssize_t xRead;
+
+    if( lFileDescriptor < 0 )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    xRead = pread( lFileDescriptor, ucRead, sizeof( ucRead ),
+                   ( off_t ) xImage.ulUpdateSlot * ( off_t ) AzureIoTPlatform_GetSingleFlashBootBankSize() );
+    ( void ) close( lFileDescriptor );
+
+    return ( xRead == ( ssize_t ) sizeof( ucRead ) ) ? TEST_ADU_COALESCE_SUCCESS : TEST_ADU_COALESCE_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintCounters( const char * pcName,
+                              const AzureADUFlashCounters_t * pxCounters )
+{
+    printf( "\t%s: %u writes, %u unaligned, %u page programs, %u partial, %u sector erases\n",
+            pcName,
+            ( unsigned ) pxCounters->ulWrites,
+            ( unsigned ) pxCounters->ulUnalignedWrites,
+            ( unsigned ) pxCounters->ulPagePrograms,
+            ( unsigned ) pxCounters->ulPartialPagePrograms,
+            ( unsigned ) pxCounters->ulSectorErases );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestChunkSize( uint32_t ulChunkSize )
+{
+    AzureADUFlashCounters_t xDirect;
+    AzureADUFlashCounters_t xCoalesced;
+
+    printf( "Writing chunks of %u bytes\n", ( unsigned ) ulChunkSize );
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( prvWriteImage( 0, ulChunkSize, false ) != TEST_ADU_COALESCE_SUCCESS ) )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xDirect );
+    prvPrintCounters( "Direct", &xDirect );
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Init( &xCoalesce, &xImage, 0, TEST_IMAGE_SIZE ) != eAzureIoTSuccess ) ||
+        ( prvWriteImage( 0, ulChunkSize, true ) != TEST_ADU_COALESCE_SUCCESS ) )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xCoalesced );
+    prvPrintCounters( "Coalesced", &xCoalesced );
+
+    /* Only the end of the image is written in part, and every page and
+     * sector is written once. */
+    if( ( xCoalesced.ulPagePrograms > xDirect.ulPagePrograms ) ||
+        ( xCoalesced.ulWrites > TEST_SECTOR_COUNT ) ||
+        ( xCoalesced.ulUnalignedWrites != 1U ) ||
+        ( xCoalesced.ulPartialPagePrograms != 1U ) ||
+        ( xCoalesced.ulPagePrograms != TEST_PAGE_COUNT ) ||
+        ( xCoalesced.ulSectorErases != TEST_SECTOR_COUNT ) ||
+        ( xCoalesce.ulChunks != ( TEST_IMAGE_SIZE + ulChunkSize - 1U ) / ulChunkSize ) ||
+        ( xCoalesce.ulBlocks != xCoalesced.ulWrites ) )
+    {
+        printf( "\tThe writes were not coalesced!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    return TEST_ADU_COALESCE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestEraseAhead( void )
+{
+    AzureADUFlashCounters_t xCounters;
+
+    printf( "Erasing the sectors ahead of the writes\n" );
+
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Init( &xCoalesce, &xImage, 0, TEST_IMAGE_SIZE ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Write( &xCoalesce, 0, ucImage, 1000 ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_EraseAhead( &xCoalesce ) != eAzureIoTSuccess ) )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    /* The sector of the block kept, and the ones up to the distance ahead. */
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xCounters );
+
+    if( ( xCounters.ulWrites != 0U ) ||
+        ( xCounters.ulSectorErases != ( 1000U + sampleaduCOALESCE_ERASE_AHEAD_SIZE + TEST_SECTOR_SIZE - 1U ) / TEST_SECTOR_SIZE ) ||
+        ( xCoalesce.ulErasesAhead != xCounters.ulSectorErases ) )
+    {
+        printf( "\tThe sectors ahead were not erased!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    /* The writes erase nothing again, and the erases stop at the image. */
+    if( ( prvWriteImage( 1000, 1000, true ) != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( SampleADUCoalesce_EraseAhead( &xCoalesce ) != eAzureIoTSuccess ) )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xCounters );
+
+    if( xCounters.ulSectorErases != TEST_SECTOR_COUNT )
+    {
+        printf( "\t%u sectors erased for %u!\n", ( unsigned ) xCounters.ulSectorErases, ( unsigned ) TEST_SECTOR_COUNT );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    if( AzureIoTPlatform_EraseSector( &xImage, TEST_SECTOR_SIZE / 2U ) == eAzureIoTSuccess )
+    {
+        printf( "\tA sector was erased from its middle!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    return TEST_ADU_COALESCE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestGapAndFlush( void )
+{
+    AzureADUFlashCounters_t xCounters;
+
+    printf( "Writing the data kept before a gap and at the end\n" );
+
+    /* A download resumed past the first two sectors. */
+    if( ( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Init( &xCoalesce, &xImage, 2U * TEST_SECTOR_SIZE, TEST_IMAGE_SIZE ) != eAzureIoTSuccess ) ||
+        ( SampleADUCoalesce_Write( &xCoalesce, 2U * TEST_SECTOR_SIZE, &ucImage[ 2U * TEST_SECTOR_SIZE ], 1000 ) != eAzureIoTSuccess ) ||
+        ( xCoalesce.ulBlocks != 0U ) )
+    {
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    /* The chunk after a gap writes the block kept, and starts one in the
+     * middle of a sector which ends at the next boundary. */
+    if( ( SampleADUCoalesce_Write( &xCoalesce, 12000, &ucImage[ 12000 ], 1000 ) != eAzureIoTSuccess ) ||
+        ( xCoalesce.ulBlocks != 2U ) ||
+        ( SampleADUCoalesce_Write( &xCoalesce, 13000, &ucImage[ 13000 ], 5000 ) != eAzureIoTSuccess ) ||
+        ( xCoalesce.ulBlocks != 3U ) ||
+        ( SampleADUCoalesce_Flush( &xCoalesce ) != eAzureIoTSuccess ) ||
+        ( xCoalesce.ulBlocks != 4U ) ||
+        ( SampleADUCoalesce_Flush( &xCoalesce ) != eAzureIoTSuccess ) ||
+        ( xCoalesce.ulBlocks != 4U ) )
+    {
+        printf( "\tThe blocks around the gap were not written!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    AzureIoTPlatform_GetFlashCounters( &xImage, &xCounters );
+
+    if( ( prvReadSlot() != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( memcmp( &ucRead[ 2U * TEST_SECTOR_SIZE ], &ucImage[ 2U * TEST_SECTOR_SIZE ], 1000 ) != 0 ) ||
+        ( memcmp( &ucRead[ 12000 ], &ucImage[ 12000 ], 6000 ) != 0 ) ||
+        ( xCounters.ulWrites != 4U ) )
+    {
+        printf( "\tThe flash does not hold the chunks!\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    return TEST_ADU_COALESCE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    char cDirectory[] = "/tmp/test_adu_coalesceXXXXXX";
+    uint32_t ulIndex;
+    int lResult;
+
+    if( mkdtemp( cDirectory ) == NULL )
+    {
+        printf( "Unable to create the flash directory\n" );
+        return TEST_ADU_COALESCE_FAIL;
+    }
+
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "%s/flash.bin", cDirectory );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+
+    for( ulIndex = 0; ulIndex < TEST_IMAGE_SIZE; ulIndex++ )
+    {
+        ucImage[ ulIndex ] = ( uint8_t ) ( ( ulIndex * 13U ) ^ ( ulIndex >> 9 ) );
+    }
+
+    /* Smaller than a page, the MSS of an Ethernet TCP segment, and larger
+     * than a block. */
+    if( ( ADUImageCompress_HashBase64( ucImage, TEST_IMAGE_SIZE, cImageHash ) != 0 ) ||
+        ( prvTestChunkSize( 100 ) != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( prvTestChunkSize( 1460 ) != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( prvTestChunkSize( 10000 ) != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( prvTestEraseAhead() != TEST_ADU_COALESCE_SUCCESS ) ||
+        ( prvTestGapAndFlush() != TEST_ADU_COALESCE_SUCCESS ) )
+    {
+        lResult = TEST_ADU_COALESCE_FAIL;
+    }
+    else
+    {
+        lResult = TEST_ADU_COALESCE_SUCCESS;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    ( void ) unlink( cFlashPath );
+    ( void ) rmdir( cDirectory );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,335 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the compressed ADU payloads. Images are packed with the host
+ * tool library, then decompressed chunk by chunk into the file-backed flash
+ * and read back.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "azure_iot_flash_platform.h"
+#include "azure_sample_heatshrink.h"
+#include "sample_azure_iot_adu_compressed.h"
+#include "adu_image_compress.h"
+
+#define TEST_ADU_COMPRESSED_SUCCESS    0
+#define TEST_ADU_COMPRESSED_FAIL       1
+
+#define TEST_IMAGE_SIZE                ( 100000U )
+
+static uint8_t ucImage[ TEST_IMAGE_SIZE ];
+static uint8_t ucFlash[ TEST_IMAGE_SIZE ];
+static uint8_t ucPayload[ aduimagecompressMAX_PAYLOAD_SIZE( TEST_IMAGE_SIZE ) ];
+static size_t xPayloadLength;
+static char cPayloadHash[ 45 ];
+static char cFlashPath[ 128 ];
+static AzureADUImage_t xImage;
+static SampleADUCompressed_t xCompressed;
+static HeatshrinkDecoder_t xDecoder;
+
+/*-----------------------------------------------------------*/
+
+/* Code-like data: a few instruction words with varying operands, and runs of
+ * zeros and of text, so it compresses like a firmware image. */
+static void prvFillImage( uint8_t * pucImage,
+                          uint32_t ulSize )
+{
+    static const uint32_t ulWords[] = { 0x4770b510, 0x68004b03, 0xf7ff2100, 0x46c0bd10, 0x20004a02, 0x60184b01 };
+    static const char cText[] = "Azure IoT middleware for FreeRTOS, ADU agent ready. ";
+    uint32_t ulSeed = 12345;
+    uint32_t ulOffset = 0;
+    uint32_t ulWord;
+
+    while( ulOffset < ulSize )
+    {
+        ulSeed = ulSeed * 1103515245U + 12345U;
+
+        switch( ( ulSeed >> 16 ) % 8U )
+        {
+            case 0:
+                ulWord = 0;
+                break;
+
+            case 1:
+                ulWord = ( uint32_t ) cText[ ( ulOffset / 4U ) % ( sizeof( cText ) - 1U ) ] * 0x01010101U;
+                break;
+
+            case 2:
+                ulWord = ulSeed;
+                break;
+
+            default:
+                ulWord = ulWords[ ( ulSeed >> 20 ) % 6U ] ^ ( ( ulSeed >> 28 ) << 8 );
+                break;
+        }
+
+        ( void ) memcpy( &pucImage[ ulOffset ], &ulWord, ( ulSize - ulOffset < 4U ) ? ulSize - ulOffset : 4U );
+        ulOffset += 4U;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static int prvPack( uint8_t ucWindowBits,
+                    uint8_t ucLookaheadBits )
+{
+    if( ( ADUImageCompress_Pack( ucImage, TEST_IMAGE_SIZE, ucWindowBits, ucLookaheadBits,
+                                 ucPayload, sizeof( ucPayload ), &xPayloadLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( ucPayload, xPayloadLength, cPayloadHash ) != 0 ) )
+    {
+        printf( "\tUnable to pack the image!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    return TEST_ADU_COMPRESSED_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* Writes the payload in chunks of ulChunkSize bytes, like the flash writer
+ * task of the sample. */
+static AzureIoTResult_t prvWritePayload( uint32_t ulChunkSize,
+                                         const char * pcPayloadHash )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( ( xResult = AzureIoTPlatform_Init( &xImage ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = SampleADUCompressed_Init( &xCompressed, &xImage ) ) != eAzureIoTSuccess ) )
+    {
+        return xResult;
+    }
+
+    for( ulOffset = 0; ulOffset < xPayloadLength; ulOffset += ulLength )
+    {
+        ulLength = ( xPayloadLength - ulOffset < ulChunkSize ) ? ( uint32_t ) ( xPayloadLength - ulOffset ) : ulChunkSize;
+
+        if( ( xResult = SampleADUCompressed_Write( &xCompressed, &ucPayload[ ulOffset ], ulLength ) ) != eAzureIoTSuccess )
+        {
+            return xResult;
+        }
+    }
+
+    return SampleADUCompressed_Finish( &xCompressed, ( const uint8_t * ) pcPayloadHash, strlen( pcPayloadHash ) );
+}
+/*-----------------------------------------------------------*/
+
+static int prvCheckFlash( void )
+{
+    int lFileDescriptor = open( cFlashPath, O_RDONLY );
+    char cImageHash[ 45 ];
+    ssize_t xRead;
+
+    if( lFileDescriptor < 0 )
+    {
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    xRead = read( lFileDescriptor, ucFlash, sizeof( ucFlash ) );
+    ( void ) close( lFileDescriptor );
+
+    if( ( xRead != ( ssize_t ) TEST_IMAGE_SIZE ) || ( memcmp( ucFlash, ucImage, TEST_IMAGE_SIZE ) != 0 ) )
+    {
+        printf( "\tThe flash does not hold the image!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    if( ( xImage.ulImageFileSize != ( int32_t ) TEST_IMAGE_SIZE ) ||
+        ( ADUImageCompress_HashBase64( ucImage, TEST_IMAGE_SIZE, cImageHash ) != 0 ) ||
+        ( memcmp( SampleADUCompressed_GetImageHash( &xCompressed ), cImageHash, sampleaduCOMPRESSED_IMAGE_HASH_SIZE ) != 0 ) )
+    {
+        printf( "\tThe image to verify is not the one compressed!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    return TEST_ADU_COMPRESSED_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestDecoderBoundaries( void )
+{
+    static uint8_t ucStream[ 4096 ];
+    static uint8_t ucOutput[ 4096 ];
+    size_t xStreamLength;
+    uint32_t ulIn = 0;
+    uint32_t ulOut = 0;
+    uint32_t ulConsumed;
+    uint32_t ulProduced;
+
+    printf( "Decoding a stream one byte in and at most 3 bytes out at a time\n" );
+
+    if( ( ADUImageCompress_Encode( ucImage, sizeof( ucOutput ), 8, 4, ucStream, sizeof( ucStream ), &xStreamLength ) != 0 ) ||
+        ( Heatshrink_Init( &xDecoder, 8, 4 ) != eHeatshrinkSuccess ) )
+    {
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    /* Every field is cut by the end of the input or of the output, the last
+     * reference is flushed without input. */
+    do
+    {
+        if( Heatshrink_Decode( &xDecoder, &ucStream[ ulIn ], ( ulIn < xStreamLength ) ? 1U : 0U, &ulConsumed,
+                               &ucOutput[ ulOut ], ( sizeof( ucOutput ) - ulOut < 3U ) ? sizeof( ucOutput ) - ulOut : 3U,
+                               &ulProduced ) != eHeatshrinkSuccess )
+        {
+            return TEST_ADU_COMPRESSED_FAIL;
+        }
+
+        ulIn += ulConsumed;
+        ulOut += ulProduced;
+    } while( ( ulOut < sizeof( ucOutput ) ) && ( ( ulIn < xStreamLength ) || ( ulProduced > 0U ) ) );
+
+    if( ( ulOut != sizeof( ucOutput ) ) || ( memcmp( ucOutput, ucImage, sizeof( ucOutput ) ) != 0 ) )
+    {
+        printf( "\tDecoded %u bytes which differ from the input!\n", ( unsigned ) ulOut );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    if( ( Heatshrink_Init( &xDecoder, 12, 4 ) != eHeatshrinkInvalidParameter ) ||
+        ( Heatshrink_Init( &xDecoder, 8, 8 ) != eHeatshrinkInvalidParameter ) )
+    {
+        printf( "\tAn unsupported window was accepted!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    return TEST_ADU_COMPRESSED_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestDecompressIntoFlash( void )
+{
+    static const uint32_t ulChunkSizes[] = { 7, 56, 1000, 4096, 65536 };
+    uint32_t ulIndex;
+
+    printf( "Decompressing a payload into the flash in chunks of 7 to 65536 bytes\n" );
+
+    if( prvPack( aduimagecompressDEFAULT_WINDOW_BITS, aduimagecompressDEFAULT_LOOKAHEAD_BITS ) != TEST_ADU_COMPRESSED_SUCCESS )
+    {
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    if( !SampleADUCompressed_IsCompressed( ucPayload, ( uint32_t ) xPayloadLength ) ||
+        SampleADUCompressed_IsCompressed( ucImage, TEST_IMAGE_SIZE ) )
+    {
+        printf( "\tThe payload was not told from the image!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    printf( "\t%u bytes compressed into %u bytes\n", ( unsigned ) TEST_IMAGE_SIZE, ( unsigned ) xPayloadLength );
+
+    for( ulIndex = 0; ulIndex < sizeof( ulChunkSizes ) / sizeof( ulChunkSizes[ 0 ] ); ulIndex++ )
+    {
+        ( void ) unlink( cFlashPath );
+
+        if( ( prvWritePayload( ulChunkSizes[ ulIndex ], cPayloadHash ) != eAzureIoTSuccess ) ||
+            ( prvCheckFlash() != TEST_ADU_COMPRESSED_SUCCESS ) )
+        {
+            printf( "\tFailed with chunks of %u bytes\n", ( unsigned ) ulChunkSizes[ ulIndex ] );
+            return TEST_ADU_COMPRESSED_FAIL;
+        }
+
+        ( void ) close( xImage.lFileDescriptor );
+    }
+
+    return TEST_ADU_COMPRESSED_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRejectedPayloads( void )
+{
+    printf( "Rejecting payloads which do not match the manifest or their header\n" );
+
+    if( prvPack( 10, 4 ) != TEST_ADU_COMPRESSED_SUCCESS )
+    {
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    /* Hash of another file. */
+    if( prvWritePayload( 4096, "47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=" ) == eAzureIoTSuccess )
+    {
+        printf( "\tA payload not matching the manifest was accepted!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+
+    /* Truncated. */
+    xPayloadLength -= 100U;
+    ( void ) ADUImageCompress_HashBase64( ucPayload, xPayloadLength, cPayloadHash );
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA truncated payload was accepted!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    xPayloadLength += 100U;
+
+    /* The image decodes past the size of the header, 256 bytes smaller. */
+    ucPayload[ 9 ]--;
+    ( void ) ADUImageCompress_HashBase64( ucPayload, xPayloadLength, cPayloadHash );
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA payload larger than its image was accepted!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    ucPayload[ 9 ]++;
+
+    /* A window larger than the decoder. */
+    ucPayload[ 5 ] = heatshrinkMAX_WINDOW_BITS + 1U;
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA payload with a window too large was accepted!\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+
+    return TEST_ADU_COMPRESSED_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    char cDirectory[] = "/tmp/test_adu_compressedXXXXXX";
+    int lResult;
+
+    if( mkdtemp( cDirectory ) == NULL )
+    {
+        printf( "Unable to create the flash directory\n" );
+        return TEST_ADU_COMPRESSED_FAIL;
+    }
+
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "%s/flash.bin", cDirectory );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+
+    prvFillImage( ucImage, TEST_IMAGE_SIZE );
+
+    if( ( prvTestDecoderBoundaries() != TEST_ADU_COMPRESSED_SUCCESS ) ||
+        ( prvTestDecompressIntoFlash() != TEST_ADU_COMPRESSED_SUCCESS ) ||
+        ( prvTestRejectedPayloads() != TEST_ADU_COMPRESSED_SUCCESS ) )
+    {
+        lResult = TEST_ADU_COMPRESSED_FAIL;
+    }
+    else
+    {
+        lResult = TEST_ADU_COMPRESSED_SUCCESS;
+    }
+
+    ( void ) unlink( cFlashPath );
+    ( void ) rmdir( cDirectory );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
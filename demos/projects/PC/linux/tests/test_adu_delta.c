@@ -0,0 +1,354 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the delta ADU payloads. Patches are created with the host
+ * tool library between two images, then applied chunk by chunk from the
+ * running image file into the file-backed flash and read back.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "azure_iot_flash_platform.h"
+#include "sample_azure_iot_adu_delta.h"
+#include "adu_image_compress.h"
+#include "adu_image_delta.h"
+
+#define TEST_ADU_DELTA_SUCCESS    0
+#define TEST_ADU_DELTA_FAIL       1
+
+#define TEST_SOURCE_SIZE          ( 100000U )
+#define TEST_IMAGE_SIZE           ( 104000U )
+
+static uint8_t ucSource[ TEST_SOURCE_SIZE ];
+static uint8_t ucImage[ TEST_IMAGE_SIZE ];
+static uint8_t ucFlash[ TEST_IMAGE_SIZE ];
+static uint8_t * pucPayload;
+static size_t xPayloadLength;
+static char cPayloadHash[ 45 ];
+static char cFlashPath[ 128 ];
+static char cSourcePath[ 128 ];
+static AzureADUImage_t xImage;
+static SampleADUDelta_t xDelta;
+
+/*-----------------------------------------------------------*/
+
+/* Code-like data: a few instruction words with varying operands, and runs of
+ * zeros and of text, so it compresses like a firmware image. */
+static void prvFillImage( uint8_t * pucImage,
+                          uint32_t ulSize,
+                          uint32_t ulSeed )
+{
+    static const uint32_t ulWords[] = { 0x4770b510, 0x68004b03, 0xf7ff2100, 0x46c0bd10, 0x20004a02, 0x60184b01 };
+    static const char cText[] = "Azure IoT middleware for FreeRTOS, ADU agent ready. ";
+    uint32_t ulOffset = 0;
+    uint32_t ulWord;
+
+    while( ulOffset < ulSize )
+    {
+        ulSeed = ulSeed * 1103515245U + 12345U;
+
+        switch( ( ulSeed >> 16 ) % 8U )
+        {
+            case 0:
+                ulWord = 0;
+                break;
+
+            case 1:
+                ulWord = ( uint32_t ) cText[ ( ulOffset / 4U ) % ( sizeof( cText ) - 1U ) ] * 0x01010101U;
+                break;
+
+            case 2:
+                ulWord = ulSeed;
+                break;
+
+            default:
+                ulWord = ulWords[ ( ulSeed >> 20 ) % 6U ] ^ ( ( ulSeed >> 28 ) << 8 );
+                break;
+        }
+
+        ( void ) memcpy( &pucImage[ ulOffset ], &ulWord, ( ulSize - ulOffset < 4U ) ? ulSize - ulOffset : 4U );
+        ulOffset += 4U;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/* The new image is the running image with a function inserted, the
+ * addresses of a few calls changed, and a section appended. */
+static void prvFillImages( void )
+{
+    uint32_t ulOffset;
+
+    prvFillImage( ucSource, TEST_SOURCE_SIZE, 12345 );
+
+    ( void ) memcpy( ucImage, ucSource, 30000 );
+    prvFillImage( &ucImage[ 30000 ], 1000, 777 );
+    ( void ) memcpy( &ucImage[ 31000 ], &ucSource[ 30000 ], TEST_SOURCE_SIZE - 30000 );
+
+    for( ulOffset = 31000; ulOffset < 31000 + TEST_SOURCE_SIZE - 30000; ulOffset += 2048 )
+    {
+        ucImage[ ulOffset ] += 4;
+    }
+
+    prvFillImage( &ucImage[ TEST_SOURCE_SIZE + 1000 ], TEST_IMAGE_SIZE - TEST_SOURCE_SIZE - 1000, 999 );
+}
+/*-----------------------------------------------------------*/
+
+static int prvWriteFile( const char * pcPath,
+                         const uint8_t * pucData,
+                         size_t xLength )
+{
+    FILE * pxFile = fopen( pcPath, "wb" );
+
+    if( ( pxFile == NULL ) ||
+        ( fwrite( pucData, 1, xLength, pxFile ) != xLength ) ||
+        ( fclose( pxFile ) != 0 ) )
+    {
+        printf( "\tUnable to write %s!\n", pcPath );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    return TEST_ADU_DELTA_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCreate( uint8_t ucWindowBits,
+                      uint8_t ucLookaheadBits )
+{
+    free( pucPayload );
+    pucPayload = NULL;
+
+    if( ( ADUImageDelta_Create( ucSource, TEST_SOURCE_SIZE, ucImage, TEST_IMAGE_SIZE, ucWindowBits, ucLookaheadBits,
+                                &pucPayload, &xPayloadLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( pucPayload, xPayloadLength, cPayloadHash ) != 0 ) )
+    {
+        printf( "\tUnable to create the delta!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    return TEST_ADU_DELTA_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* Writes the payload in chunks of ulChunkSize bytes, like the flash writer
+ * task of the sample. */
+static AzureIoTResult_t prvWritePayload( uint32_t ulChunkSize,
+                                         const char * pcPayloadHash )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( ( ( xResult = AzureIoTPlatform_Init( &xImage ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = SampleADUDelta_Init( &xDelta, &xImage ) ) != eAzureIoTSuccess ) )
+    {
+        return xResult;
+    }
+
+    for( ulOffset = 0; ulOffset < xPayloadLength; ulOffset += ulLength )
+    {
+        ulLength = ( xPayloadLength - ulOffset < ulChunkSize ) ? ( uint32_t ) ( xPayloadLength - ulOffset ) : ulChunkSize;
+
+        if( ( xResult = SampleADUDelta_Write( &xDelta, &pucPayload[ ulOffset ], ulLength ) ) != eAzureIoTSuccess )
+        {
+            return xResult;
+        }
+    }
+
+    return SampleADUDelta_Finish( &xDelta, ( const uint8_t * ) pcPayloadHash, strlen( pcPayloadHash ) );
+}
+/*-----------------------------------------------------------*/
+
+static int prvCheckFlash( void )
+{
+    int lFileDescriptor = open( cFlashPath, O_RDONLY );
+    char cImageHash[ 45 ];
+    ssize_t xRead;
+
+    if( lFileDescriptor < 0 )
+    {
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    xRead = read( lFileDescriptor, ucFlash, sizeof( ucFlash ) );
+    ( void ) close( lFileDescriptor );
+
+    if( ( xRead != ( ssize_t ) TEST_IMAGE_SIZE ) || ( memcmp( ucFlash, ucImage, TEST_IMAGE_SIZE ) != 0 ) )
+    {
+        printf( "\tThe flash does not hold the new image!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    if( ( xImage.ulImageFileSize != ( int32_t ) TEST_IMAGE_SIZE ) ||
+        ( ADUImageCompress_HashBase64( ucImage, TEST_IMAGE_SIZE, cImageHash ) != 0 ) ||
+        ( memcmp( SampleADUDelta_GetImageHash( &xDelta ), cImageHash, sampleaduDELTA_IMAGE_HASH_SIZE ) != 0 ) )
+    {
+        printf( "\tThe image to verify is not the new image!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    return TEST_ADU_DELTA_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestApplyIntoFlash( void )
+{
+    static const uint8_t ucWindows[] = { aduimagecompressDEFAULT_WINDOW_BITS, 0 };
+    static const uint32_t ulChunkSizes[] = { 7, 104, 4096, 65536 };
+    uint32_t ulWindow;
+    uint32_t ulIndex;
+
+    printf( "Applying compressed and raw patches in chunks of 7 to 65536 bytes\n" );
+
+    for( ulWindow = 0; ulWindow < sizeof( ucWindows ); ulWindow++ )
+    {
+        if( prvCreate( ucWindows[ ulWindow ], aduimagedeltaDEFAULT_LOOKAHEAD_BITS ) != TEST_ADU_DELTA_SUCCESS )
+        {
+            return TEST_ADU_DELTA_FAIL;
+        }
+
+        if( !SampleADUDelta_IsDelta( pucPayload, ( uint32_t ) xPayloadLength ) ||
+            SampleADUDelta_IsDelta( ucImage, TEST_IMAGE_SIZE ) )
+        {
+            printf( "\tThe payload was not told from the image!\n" );
+            return TEST_ADU_DELTA_FAIL;
+        }
+
+        printf( "\t%u bytes updated with a patch of %u bytes, window of %u bits\n",
+                ( unsigned ) TEST_IMAGE_SIZE, ( unsigned ) xPayloadLength, ( unsigned ) ucWindows[ ulWindow ] );
+
+        for( ulIndex = 0; ulIndex < sizeof( ulChunkSizes ) / sizeof( ulChunkSizes[ 0 ] ); ulIndex++ )
+        {
+            ( void ) unlink( cFlashPath );
+
+            if( ( prvWritePayload( ulChunkSizes[ ulIndex ], cPayloadHash ) != eAzureIoTSuccess ) ||
+                ( prvCheckFlash() != TEST_ADU_DELTA_SUCCESS ) )
+            {
+                printf( "\tFailed with chunks of %u bytes\n", ( unsigned ) ulChunkSizes[ ulIndex ] );
+                return TEST_ADU_DELTA_FAIL;
+            }
+
+            ( void ) close( xImage.lFileDescriptor );
+        }
+    }
+
+    return TEST_ADU_DELTA_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRejectedPayloads( void )
+{
+    printf( "Rejecting payloads which do not match the running image, the manifest or their patch\n" );
+
+    if( prvCreate( 0, 0 ) != TEST_ADU_DELTA_SUCCESS )
+    {
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    /* Hash of another file. */
+    if( prvWritePayload( 4096, "47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU=" ) == eAzureIoTSuccess )
+    {
+        printf( "\tA payload not matching the manifest was accepted!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+
+    /* Truncated. */
+    xPayloadLength -= 100U;
+    ( void ) ADUImageCompress_HashBase64( pucPayload, xPayloadLength, cPayloadHash );
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA truncated payload was accepted!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    xPayloadLength += 100U;
+
+    /* A first record longer than the new image. */
+    pucPayload[ sampleaduDELTA_HEADER_SIZE + 3U ] = 0x7F;
+    ( void ) ADUImageCompress_HashBase64( pucPayload, xPayloadLength, cPayloadHash );
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA malformed patch was accepted!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+
+    /* Another running image. */
+    if( prvCreate( 0, 0 ) != TEST_ADU_DELTA_SUCCESS )
+    {
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ucSource[ 5000 ]++;
+
+    if( prvWriteFile( cSourcePath, ucSource, TEST_SOURCE_SIZE ) != TEST_ADU_DELTA_SUCCESS )
+    {
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    if( prvWritePayload( 4096, cPayloadHash ) == eAzureIoTSuccess )
+    {
+        printf( "\tA payload for another running image was accepted!\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    ucSource[ 5000 ]--;
+
+    return TEST_ADU_DELTA_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    char cDirectory[] = "/tmp/test_adu_deltaXXXXXX";
+    int lResult;
+
+    if( mkdtemp( cDirectory ) == NULL )
+    {
+        printf( "Unable to create the flash directory\n" );
+        return TEST_ADU_DELTA_FAIL;
+    }
+
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "%s/flash.bin", cDirectory );
+    ( void ) snprintf( cSourcePath, sizeof( cSourcePath ), "%s/running.bin", cDirectory );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+    ( void ) setenv( "AZURE_IOT_FLASH_SOURCE_FILE", cSourcePath, 1 );
+
+    prvFillImages();
+
+    if( ( prvWriteFile( cSourcePath, ucSource, TEST_SOURCE_SIZE ) != TEST_ADU_DELTA_SUCCESS ) ||
+        ( prvTestApplyIntoFlash() != TEST_ADU_DELTA_SUCCESS ) ||
+        ( prvTestRejectedPayloads() != TEST_ADU_DELTA_SUCCESS ) )
+    {
+        lResult = TEST_ADU_DELTA_FAIL;
+    }
+    else
+    {
+        lResult = TEST_ADU_DELTA_SUCCESS;
+    }
+
+    if( xImage.lSourceFileDescriptor > 0 )
+    {
+        ( void ) close( xImage.lSourceFileDescriptor );
+    }
+
+    free( pucPayload );
+    ( void ) unlink( cFlashPath );
+    ( void ) unlink( cSourcePath );
+    ( void ) rmdir( cDirectory );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
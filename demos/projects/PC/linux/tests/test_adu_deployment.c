@@ -0,0 +1,199 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the deployment identity of the ADU sample: a deployment which
+ * replaces the one being downloaded, a retry of the same deployment, and a
+ * cancellation.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_azure_iot_adu_deployment.h"
+
+#define TEST_ADU_DEPLOYMENT_SUCCESS    0
+#define TEST_ADU_DEPLOYMENT_FAIL       1
+
+static AzureIoTADUUpdateRequest_t xRequest;
+static SampleADUDeployment_t xDeployment;
+
+/*-----------------------------------------------------------*/
+
+/* Parses a request into the same structure, as the sample does each time the
+ * service writes the property. */
+static void prvReceiveRequest( AzureIoTADUWorkflowAction_t xAction,
+                               const char * pcWorkflowId,
+                               const char * pcVersion )
+{
+    ( void ) memset( &xRequest, 0, sizeof( xRequest ) );
+
+    xRequest.xWorkflow.xAction = xAction;
+    xRequest.xWorkflow.pucID = ( const uint8_t * ) pcWorkflowId;
+    xRequest.xWorkflow.ulIDLength = ( uint32_t ) strlen( pcWorkflowId );
+    xRequest.xUpdateManifest.xUpdateId.pucProvider = ( const uint8_t * ) "Contoso";
+    xRequest.xUpdateManifest.xUpdateId.ulProviderLength = sizeof( "Contoso" ) - 1;
+    xRequest.xUpdateManifest.xUpdateId.pucName = ( const uint8_t * ) "Linux";
+    xRequest.xUpdateManifest.xUpdateId.ulNameLength = sizeof( "Linux" ) - 1;
+    xRequest.xUpdateManifest.xUpdateId.pucVersion = ( const uint8_t * ) pcVersion;
+    xRequest.xUpdateManifest.xUpdateId.ulVersionLength = ( uint32_t ) strlen( pcVersion );
+}
+/*-----------------------------------------------------------*/
+
+static int prvStartDownload( const char * pcWorkflowId,
+                             const char * pcVersion )
+{
+    char cUpdateId[ 32 ];
+
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, pcWorkflowId, pcVersion );
+
+    if( SampleADUDeployment_Save( &xDeployment, &xRequest ) != eAzureIoTSuccess )
+    {
+        printf( "\tSaving the deployment failed!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    ( void ) snprintf( cUpdateId, sizeof( cUpdateId ), "Contoso:Linux:%s", pcVersion );
+
+    if( strcmp( xDeployment.cUpdateId, cUpdateId ) != 0 )
+    {
+        printf( "\tUnexpected update id %s!\n", xDeployment.cUpdateId );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* The request of the download is not a replacement of itself. */
+static int prvTestSameDeployment( void )
+{
+    if( ( prvStartDownload( "7f4e1c2a-0001", "1.1" ) != TEST_ADU_DEPLOYMENT_SUCCESS ) ||
+        SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tThe deployment of the download is replaced by itself!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    /* The service writes the same request again, on a reconnection. */
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, "7f4e1c2a-0001", "1.1" );
+
+    if( SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tA retry of the deployment replaces it!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* A new deployment arrives while the download of the first one runs, the
+ * downloaded image must not be enabled nor reported on its request. */
+static int prvTestReplacedMidDownload( void )
+{
+    if( prvStartDownload( "7f4e1c2a-0001", "1.1" ) != TEST_ADU_DEPLOYMENT_SUCCESS )
+    {
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, "7f4e1c2a-0002", "1.2" );
+
+    if( !SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tThe new deployment does not replace the download!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    /* The same workflow id with another update. */
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, "7f4e1c2a-0001", "1.2" );
+
+    if( !SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tAnother update of the workflow does not replace the download!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    /* Another workflow id with the same update. */
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, "7f4e1c2a-0002", "1.1" );
+
+    if( !SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tAnother workflow of the update does not replace the download!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    /* The new deployment is downloaded next, and is not replaced. */
+    if( ( prvStartDownload( "7f4e1c2a-0002", "1.2" ) != TEST_ADU_DEPLOYMENT_SUCCESS ) ||
+        SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tThe download of the new deployment is replaced!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* A cancellation is handled as such, not as a new deployment. */
+static int prvTestCancel( void )
+{
+    if( prvStartDownload( "7f4e1c2a-0001", "1.1" ) != TEST_ADU_DEPLOYMENT_SUCCESS )
+    {
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    prvReceiveRequest( eAzureIoTADUActionCancel, "7f4e1c2a-0003", "1.1" );
+
+    if( SampleADUDeployment_IsReplacedBy( &xDeployment, &xRequest ) )
+    {
+        printf( "\tThe cancellation replaces the download!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+/* Ids which do not fit are refused instead of truncated. */
+static int prvTestIdTooLong( void )
+{
+    static char cWorkflowId[ sampleaduDEPLOYMENT_WORKFLOW_ID_SIZE + 2 ];
+    static char cVersion[ sampleaduDEPLOYMENT_UPDATE_ID_SIZE ];
+
+    ( void ) memset( cWorkflowId, 'w', sizeof( cWorkflowId ) - 1 );
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, cWorkflowId, "1.1" );
+
+    if( SampleADUDeployment_Save( &xDeployment, &xRequest ) != eAzureIoTErrorOutOfMemory )
+    {
+        printf( "\tA workflow id too long is saved!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    ( void ) memset( cVersion, '9', sizeof( cVersion ) - 1 );
+    prvReceiveRequest( eAzureIoTADUActionApplyDownload, "7f4e1c2a-0001", cVersion );
+
+    if( SampleADUDeployment_Save( &xDeployment, &xRequest ) != eAzureIoTErrorOutOfMemory )
+    {
+        printf( "\tAn update id too long is saved!\n" );
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestSameDeployment() != TEST_ADU_DEPLOYMENT_SUCCESS ) ||
+        ( prvTestReplacedMidDownload() != TEST_ADU_DEPLOYMENT_SUCCESS ) ||
+        ( prvTestCancel() != TEST_ADU_DEPLOYMENT_SUCCESS ) ||
+        ( prvTestIdTooLong() != TEST_ADU_DEPLOYMENT_SUCCESS ) )
+    {
+        return TEST_ADU_DEPLOYMENT_FAIL;
+    }
+
+    return TEST_ADU_DEPLOYMENT_SUCCESS;
+}
+/*-----------------------------------------------------------*/
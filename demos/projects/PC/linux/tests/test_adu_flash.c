@@ -0,0 +1,280 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the A/B flash emulated by the Linux port: images written to
+ * a slot, verified against their hash, enabled, then read back as the running
+ * image of the next update.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_delta.h"
+#include "adu_image_compress.h"
+
+#define TEST_ADU_FLASH_SUCCESS    0
+#define TEST_ADU_FLASH_FAIL       1
+
+#define TEST_IMAGE_SIZE           ( 50000U )
+#define TEST_CHUNK_SIZE           ( 1000U )
+#define TEST_SECTOR_SIZE          ( 4096U )
+
+static uint8_t ucImages[ 2 ][ TEST_IMAGE_SIZE ];
+static uint8_t ucRead[ TEST_IMAGE_SIZE ];
+static char cImageHashes[ 2 ][ 45 ];
+static char cFlashPath[ 128 ];
+static char cBootPath[ 128 ];
+static AzureADUImage_t xImage;
+
+/*-----------------------------------------------------------*/
+
+/* Writes the image in chunks not aligned to the sectors, like the sample. */
+static int prvWriteImage( const uint8_t * pucImage )
+{
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    if( AzureIoTPlatform_Init( &xImage ) != eAzureIoTSuccess )
+    {
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    for( ulOffset = 0; ulOffset < TEST_IMAGE_SIZE; ulOffset += ulLength )
+    {
+        ulLength = ( TEST_IMAGE_SIZE - ulOffset < TEST_CHUNK_SIZE ) ? TEST_IMAGE_SIZE - ulOffset : TEST_CHUNK_SIZE;
+
+        if( AzureIoTPlatform_WriteBlock( &xImage, ulOffset, ( uint8_t * ) &pucImage[ ulOffset ], ulLength ) != eAzureIoTSuccess )
+        {
+            printf( "\tWriting the chunk at offset %u failed!\n", ( unsigned ) ulOffset );
+            return TEST_ADU_FLASH_FAIL;
+        }
+    }
+
+    xImage.ulImageFileSize = ( int32_t ) TEST_IMAGE_SIZE;
+
+    return TEST_ADU_FLASH_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvVerify( const char * pcHash )
+{
+    return AzureIoTPlatform_VerifyImage( &xImage, ( uint8_t * ) pcHash, strlen( pcHash ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Reads the slot from the flash file, where the port does not look. */
+static int prvReadSlot( uint32_t ulSlot )
+{
+    int lFileDescriptor = open( cFlashPath, O_RDONLY );
+    ssize_t xRead;
+
+    if( lFileDescriptor < 0 )
+    {
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    xRead = pread( lFileDescriptor, ucRead, sizeof( ucRead ),
+                   ( off_t ) ulSlot * ( off_t ) AzureIoTPlatform_GetSingleFlashBootBankSize() );
+    ( void ) close( lFileDescriptor );
+
+    return ( xRead == ( ssize_t ) sizeof( ucRead ) ) ? TEST_ADU_FLASH_SUCCESS : TEST_ADU_FLASH_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestVerify( void )
+{
+    int lFileDescriptor;
+    uint8_t ucByte;
+
+    printf( "Verifying an image against its SHA-256\n" );
+
+    if( ( prvWriteImage( ucImages[ 0 ] ) != TEST_ADU_FLASH_SUCCESS ) ||
+        ( xImage.ulUpdateSlot != 0U ) ||
+        ( prvReadSlot( 0 ) != TEST_ADU_FLASH_SUCCESS ) ||
+        ( memcmp( ucRead, ucImages[ 0 ], TEST_IMAGE_SIZE ) != 0 ) )
+    {
+        printf( "\tSlot 0 does not hold the image!\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    if( ( prvVerify( cImageHashes[ 0 ] ) != eAzureIoTSuccess ) ||
+        ( prvVerify( cImageHashes[ 1 ] ) == eAzureIoTSuccess ) ||
+        ( prvVerify( "not base64" ) == eAzureIoTSuccess ) )
+    {
+        printf( "\tThe image was not told from another one!\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    /* A bit the flash lost. */
+    ucByte = ( uint8_t ) ( ucImages[ 0 ][ 12345 ] ^ 0x10U );
+    lFileDescriptor = open( cFlashPath, O_WRONLY );
+
+    if( ( lFileDescriptor < 0 ) || ( pwrite( lFileDescriptor, &ucByte, 1, 12345 ) != 1 ) )
+    {
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    ( void ) close( lFileDescriptor );
+
+    if( prvVerify( cImageHashes[ 0 ] ) == eAzureIoTSuccess )
+    {
+        printf( "\tAn image modified in the flash was verified!\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    /* Programming without an erase only clears bits. */
+    if( ( prvWriteImage( ucImages[ 0 ] ) != TEST_ADU_FLASH_SUCCESS ) ||
+        ( prvVerify( cImageHashes[ 0 ] ) != eAzureIoTSuccess ) ||
+        ( AzureIoTPlatform_WriteBlock( &xImage, 0, ucImages[ 1 ], TEST_CHUNK_SIZE ) != eAzureIoTSuccess ) ||
+        ( prvVerify( cImageHashes[ 0 ] ) == eAzureIoTSuccess ) )
+    {
+        printf( "\tA region programmed twice was not the AND of the writes!\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    if( AzureIoTPlatform_WriteBlock( &xImage, ( uint32_t ) AzureIoTPlatform_GetSingleFlashBootBankSize() - 10U,
+                                     ucImages[ 0 ], 20 ) == eAzureIoTSuccess )
+    {
+        printf( "\tA write past the end of the slot was accepted!\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    return TEST_ADU_FLASH_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSwitchSlots( void )
+{
+    uint32_t ulIndex;
+
+    printf( "Switching between the slots\n" );
+
+    /* The factory image runs until an image is enabled. */
+    if( ( prvWriteImage( ucImages[ 0 ] ) != TEST_ADU_FLASH_SUCCESS ) ||
+        ( xImage.lRunningSlot != -1 ) ||
+        ( prvVerify( cImageHashes[ 0 ] ) != eAzureIoTSuccess ) ||
+        ( AzureIoTPlatform_EnableImage( &xImage ) != eAzureIoTSuccess ) ||
+        ( AzureIoTPlatform_ResetDevice( &xImage ) != eAzureIoTSuccess ) )
+    {
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    for( ulIndex = 1; ulIndex <= 2U; ulIndex++ )
+    {
+        if( ( prvWriteImage( ucImages[ ulIndex % 2U ] ) != TEST_ADU_FLASH_SUCCESS ) ||
+            ( xImage.ulUpdateSlot != ulIndex % 2U ) ||
+            ( xImage.lRunningSlot != ( int32_t ) ( ( ulIndex + 1U ) % 2U ) ) )
+        {
+            printf( "\tThe update was not written to slot %u!\n", ( unsigned ) ( ulIndex % 2U ) );
+            return TEST_ADU_FLASH_FAIL;
+        }
+
+        /* The running slot is the source of the delta updates, the update
+         * slot is the other one in the file. */
+        if( ( AzureIoTPlatform_ReadRunningImage( &xImage, 0, ucRead, TEST_IMAGE_SIZE ) != eAzureIoTSuccess ) ||
+            ( memcmp( ucRead, ucImages[ ( ulIndex + 1U ) % 2U ], TEST_IMAGE_SIZE ) != 0 ) ||
+            ( AzureIoTPlatform_ReadRunningImage( &xImage, 1, ucRead, TEST_IMAGE_SIZE ) == eAzureIoTSuccess ) ||
+            ( prvReadSlot( ulIndex % 2U ) != TEST_ADU_FLASH_SUCCESS ) ||
+            ( memcmp( ucRead, ucImages[ ulIndex % 2U ], TEST_IMAGE_SIZE ) != 0 ) )
+        {
+            printf( "\tThe running image is not the one enabled!\n" );
+            return TEST_ADU_FLASH_FAIL;
+        }
+
+        if( ( prvVerify( cImageHashes[ ulIndex % 2U ] ) != eAzureIoTSuccess ) ||
+            ( AzureIoTPlatform_EnableImage( &xImage ) != eAzureIoTSuccess ) )
+        {
+            return TEST_ADU_FLASH_FAIL;
+        }
+    }
+
+    return TEST_ADU_FLASH_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestLatency( void )
+{
+    struct timespec xStart;
+    struct timespec xEnd;
+    uint64_t ullElapsedUs;
+    uint64_t ullExpectedUs;
+
+    printf( "Simulating the erase and program latencies\n" );
+
+    ( void ) setenv( "AZURE_IOT_FLASH_ERASE_US", "2000", 1 );
+    ( void ) setenv( "AZURE_IOT_FLASH_PROGRAM_US", "20", 1 );
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xStart );
+
+    if( prvWriteImage( ucImages[ 0 ] ) != TEST_ADU_FLASH_SUCCESS )
+    {
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xEnd );
+    ( void ) unsetenv( "AZURE_IOT_FLASH_ERASE_US" );
+    ( void ) unsetenv( "AZURE_IOT_FLASH_PROGRAM_US" );
+
+    /* Every sector erased once, every page programmed at least once. */
+    ullElapsedUs = ( uint64_t ) ( xEnd.tv_sec - xStart.tv_sec ) * 1000000U +
+                   ( uint64_t ) ( ( xEnd.tv_nsec - xStart.tv_nsec ) / 1000 );
+    ullExpectedUs = ( ( TEST_IMAGE_SIZE + TEST_SECTOR_SIZE - 1U ) / TEST_SECTOR_SIZE ) * 2000U +
+                    ( TEST_IMAGE_SIZE / 256U ) * 20U;
+
+    printf( "\t%u bytes written in %u us, at least %u us expected\n",
+            ( unsigned ) TEST_IMAGE_SIZE, ( unsigned ) ullElapsedUs, ( unsigned ) ullExpectedUs );
+
+    return ( ullElapsedUs >= ullExpectedUs ) ? TEST_ADU_FLASH_SUCCESS : TEST_ADU_FLASH_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    char cDirectory[] = "/tmp/test_adu_flashXXXXXX";
+    uint32_t ulIndex;
+    int lResult;
+
+    if( mkdtemp( cDirectory ) == NULL )
+    {
+        printf( "Unable to create the flash directory\n" );
+        return TEST_ADU_FLASH_FAIL;
+    }
+
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "%s/flash.bin", cDirectory );
+    ( void ) snprintf( cBootPath, sizeof( cBootPath ), "%s/flash.bin.boot", cDirectory );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+
+    for( ulIndex = 0; ulIndex < TEST_IMAGE_SIZE; ulIndex++ )
+    {
+        ucImages[ 0 ][ ulIndex ] = ( uint8_t ) ( ( ulIndex * 13U ) ^ ( ulIndex >> 9 ) );
+        ucImages[ 1 ][ ulIndex ] = ( uint8_t ) ( ( ulIndex * 7U ) ^ ( ulIndex >> 7 ) );
+    }
+
+    if( ( ADUImageCompress_HashBase64( ucImages[ 0 ], TEST_IMAGE_SIZE, cImageHashes[ 0 ] ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( ucImages[ 1 ], TEST_IMAGE_SIZE, cImageHashes[ 1 ] ) != 0 ) ||
+        ( prvTestVerify() != TEST_ADU_FLASH_SUCCESS ) ||
+        ( prvTestSwitchSlots() != TEST_ADU_FLASH_SUCCESS ) ||
+        ( prvTestLatency() != TEST_ADU_FLASH_SUCCESS ) )
+    {
+        lResult = TEST_ADU_FLASH_FAIL;
+    }
+    else
+    {
+        lResult = TEST_ADU_FLASH_SUCCESS;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    ( void ) unlink( cFlashPath );
+    ( void ) unlink( cBootPath );
+    ( void ) rmdir( cDirectory );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
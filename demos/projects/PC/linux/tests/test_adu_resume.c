@@ -0,0 +1,256 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the resumable downloads of the file-backed flash. A child
+ * process writes part of the image and is killed, then the download is
+ * resumed from its last checkpoint.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "azure_iot_flash_platform.h"
+#include "azure_iot_flash_platform_resume.h"
+
+#define TEST_ADU_RESUME_SUCCESS    0
+#define TEST_ADU_RESUME_FAIL       1
+
+#define TEST_UPDATE_ID             "{\"provider\":\"Contoso\",\"name\":\"Linux\",\"version\":\"1.1\"}"
+#define TEST_OTHER_UPDATE_ID       "{\"provider\":\"Contoso\",\"name\":\"Linux\",\"version\":\"1.2\"}"
+#define TEST_FILE_URL              "http://adu.example.com/firmware/image.bin"
+#define TEST_CHUNK_SIZE            ( 4096U )
+#define TEST_IMAGE_SIZE            ( 10U * TEST_CHUNK_SIZE + 1000U )
+
+static uint8_t ucImage[ TEST_IMAGE_SIZE ];
+static uint8_t ucFlash[ TEST_IMAGE_SIZE ];
+static char cFlashPath[ 128 ];
+static AzureADUImage_t xImage;
+
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvInit( const char * pcUpdateId )
+{
+    return AzureIoTPlatform_InitResumable( &xImage,
+                                           ( const uint8_t * ) pcUpdateId, strlen( pcUpdateId ),
+                                           ( const uint8_t * ) TEST_FILE_URL, sizeof( TEST_FILE_URL ) - 1,
+                                           TEST_IMAGE_SIZE );
+}
+/*-----------------------------------------------------------*/
+
+/* Writes the chunks of the image from the current offset, like the sample. */
+static int prvWriteChunks( uint32_t ulChunkCount )
+{
+    uint32_t ulOffset = ( uint32_t ) xImage.ulCurrentOffset;
+    uint32_t ulLength;
+    uint32_t ulSavedLength;
+
+    while( ( ulChunkCount-- > 0U ) && ( ulOffset < TEST_IMAGE_SIZE ) )
+    {
+        ulLength = ( TEST_IMAGE_SIZE - ulOffset < TEST_CHUNK_SIZE ) ? TEST_IMAGE_SIZE - ulOffset : TEST_CHUNK_SIZE;
+
+        if( ( AzureIoTPlatform_WriteBlock( &xImage, ulOffset, &ucImage[ ulOffset ], ulLength ) != eAzureIoTSuccess ) ||
+            ( AzureIoTPlatform_SaveCheckpoint( &xImage, &ulSavedLength ) != eAzureIoTSuccess ) )
+        {
+            printf( "\tWriting the chunk at offset %u failed!\n", ( unsigned ) ulOffset );
+            return TEST_ADU_RESUME_FAIL;
+        }
+
+        /* The last chunk is not sector aligned and is not saved. */
+        if( ulSavedLength != ( ( ulLength == TEST_CHUNK_SIZE ) ? ulOffset + ulLength : 0U ) )
+        {
+            printf( "\tThe checkpoint at offset %u covers %u bytes!\n", ( unsigned ) ulOffset, ( unsigned ) ulSavedLength );
+            return TEST_ADU_RESUME_FAIL;
+        }
+
+        ulOffset += ulLength;
+        xImage.ulCurrentOffset = ( int32_t ) ulOffset;
+    }
+
+    return TEST_ADU_RESUME_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCheckFlash( void )
+{
+    int lFileDescriptor = open( cFlashPath, O_RDONLY );
+    ssize_t xRead;
+
+    if( lFileDescriptor < 0 )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    xRead = read( lFileDescriptor, ucFlash, sizeof( ucFlash ) );
+    ( void ) close( lFileDescriptor );
+
+    if( ( xRead != ( ssize_t ) TEST_IMAGE_SIZE ) || ( memcmp( ucFlash, ucImage, TEST_IMAGE_SIZE ) != 0 ) )
+    {
+        printf( "\tThe flash does not hold the image!\n" );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    return TEST_ADU_RESUME_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestResumeAfterKill( void )
+{
+    pid_t xChild;
+    int lStatus;
+    uint32_t ulSavedLength;
+
+    printf( "Resuming a download killed in the middle of a chunk\n" );
+
+    xChild = fork();
+
+    if( xChild == 0 )
+    {
+        /* 5 chunks checkpointed, then half of the sixth. */
+        if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) || ( xImage.ulCurrentOffset != 0 ) ||
+            ( prvWriteChunks( 5 ) != TEST_ADU_RESUME_SUCCESS ) ||
+            ( AzureIoTPlatform_WriteBlock( &xImage, 5U * TEST_CHUNK_SIZE,
+                                           &ucImage[ 5U * TEST_CHUNK_SIZE ], TEST_CHUNK_SIZE / 2U ) != eAzureIoTSuccess ) ||
+            ( AzureIoTPlatform_SaveCheckpoint( &xImage, &ulSavedLength ) != eAzureIoTSuccess ) ||
+            ( ulSavedLength != 0U ) )
+        {
+            _exit( TEST_ADU_RESUME_FAIL );
+        }
+
+        ( void ) kill( getpid(), SIGKILL );
+    }
+
+    if( ( xChild < 0 ) || ( waitpid( xChild, &lStatus, 0 ) != xChild ) ||
+        !WIFSIGNALED( lStatus ) || ( WTERMSIG( lStatus ) != SIGKILL ) )
+    {
+        printf( "\tThe download was not killed!\n" );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) ||
+        ( xImage.ulCurrentOffset != ( int32_t ) ( 5U * TEST_CHUNK_SIZE ) ) )
+    {
+        printf( "\tResumed at offset %d!\n", ( int ) xImage.ulCurrentOffset );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    if( ( prvWriteChunks( UINT32_MAX ) != TEST_ADU_RESUME_SUCCESS ) ||
+        ( prvCheckFlash() != TEST_ADU_RESUME_SUCCESS ) )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    return ( AzureIoTPlatform_ClearCheckpoint( &xImage ) == eAzureIoTSuccess ) ? TEST_ADU_RESUME_SUCCESS : TEST_ADU_RESUME_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestOtherUpdate( void )
+{
+    printf( "Restarting the download of another update\n" );
+
+    if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) ||
+        ( prvWriteChunks( 3 ) != TEST_ADU_RESUME_SUCCESS ) ||
+        ( prvInit( TEST_OTHER_UPDATE_ID ) != eAzureIoTSuccess ) )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    if( xImage.ulCurrentOffset != 0 )
+    {
+        printf( "\tResumed at offset %d!\n", ( int ) xImage.ulCurrentOffset );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    /* The checkpoint of the first update is gone. */
+    if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) || ( xImage.ulCurrentOffset != 0 ) )
+    {
+        printf( "\tResumed the first update at offset %d!\n", ( int ) xImage.ulCurrentOffset );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    return TEST_ADU_RESUME_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestCorruptedFlash( void )
+{
+    int lFileDescriptor;
+    uint8_t ucByte = ( uint8_t ) ~ucImage[ TEST_CHUNK_SIZE ];
+
+    printf( "Restarting the download when the flash was modified\n" );
+
+    if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) ||
+        ( prvWriteChunks( 3 ) != TEST_ADU_RESUME_SUCCESS ) )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    lFileDescriptor = open( cFlashPath, O_WRONLY );
+
+    if( ( lFileDescriptor < 0 ) || ( pwrite( lFileDescriptor, &ucByte, 1, TEST_CHUNK_SIZE ) != 1 ) )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    ( void ) close( lFileDescriptor );
+
+    if( ( prvInit( TEST_UPDATE_ID ) != eAzureIoTSuccess ) || ( xImage.ulCurrentOffset != 0 ) )
+    {
+        printf( "\tResumed at offset %d!\n", ( int ) xImage.ulCurrentOffset );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    if( ( prvWriteChunks( UINT32_MAX ) != TEST_ADU_RESUME_SUCCESS ) ||
+        ( prvCheckFlash() != TEST_ADU_RESUME_SUCCESS ) )
+    {
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    return ( AzureIoTPlatform_ClearCheckpoint( &xImage ) == eAzureIoTSuccess ) ? TEST_ADU_RESUME_SUCCESS : TEST_ADU_RESUME_FAIL;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    char cDirectory[] = "/tmp/test_adu_resumeXXXXXX";
+    uint32_t ulIndex;
+    int lResult;
+
+    if( mkdtemp( cDirectory ) == NULL )
+    {
+        printf( "Unable to create the flash directory\n" );
+        return TEST_ADU_RESUME_FAIL;
+    }
+
+    ( void ) snprintf( cFlashPath, sizeof( cFlashPath ), "%s/flash.bin", cDirectory );
+    ( void ) setenv( "AZURE_IOT_FLASH_FILE", cFlashPath, 1 );
+
+    for( ulIndex = 0; ulIndex < TEST_IMAGE_SIZE; ulIndex++ )
+    {
+        ucImage[ ulIndex ] = ( uint8_t ) ( ( ulIndex * 13U ) ^ ( ulIndex >> 9 ) );
+    }
+
+    if( ( prvTestResumeAfterKill() != TEST_ADU_RESUME_SUCCESS ) ||
+        ( prvTestOtherUpdate() != TEST_ADU_RESUME_SUCCESS ) ||
+        ( prvTestCorruptedFlash() != TEST_ADU_RESUME_SUCCESS ) )
+    {
+        lResult = TEST_ADU_RESUME_FAIL;
+    }
+    else
+    {
+        lResult = TEST_ADU_RESUME_SUCCESS;
+    }
+
+    ( void ) close( xImage.lFileDescriptor );
+    ( void ) unlink( cFlashPath );
+    ( void ) rmdir( cDirectory );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,164 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the bandwidth shaper, fed with the times of a simulated
+ * download which reads its chunks instantly and waits the delays returned.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "azure_sample_bandwidth_shaper.h"
+
+#define TEST_BANDWIDTH_SHAPER_SUCCESS    0
+#define TEST_BANDWIDTH_SHAPER_FAIL       1
+
+#define TEST_CHUNK_SIZE                  ( 4096U )
+
+static BandwidthShaper_t xShaper;
+
+/*-----------------------------------------------------------*/
+
+/* Reads the chunks, starting at ulStartMs, and returns the time the last one
+ * may be followed at. */
+static uint32_t prvRun( uint32_t ulStartMs,
+                        uint32_t ulChunkCount )
+{
+    uint32_t ulNowMs = ulStartMs;
+
+    while( ulChunkCount-- > 0U )
+    {
+        ulNowMs += BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, ulNowMs );
+    }
+
+    return ulNowMs;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestUnlimited( void )
+{
+    printf( "Reading without a limit\n" );
+    BandwidthShaper_Init( &xShaper, 0, TEST_CHUNK_SIZE, 0 );
+
+    if( ( prvRun( 0, 1000 ) != 0U ) || ( xShaper.ulDelays != 0U ) )
+    {
+        printf( "\tDelayed %u times without a limit\n", ( unsigned ) xShaper.ulDelays );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    return TEST_BANDWIDTH_SHAPER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRate( void )
+{
+    uint32_t ulElapsedMs;
+    uint32_t ulRate;
+
+    printf( "Holding a download to the rate\n" );
+    BandwidthShaper_Init( &xShaper, 40960, 2U * TEST_CHUNK_SIZE, 0 );
+
+    /* 400 KB at 40 KB/s take 10 s, less the burst. */
+    ulElapsedMs = prvRun( 0, 100 );
+    ulRate = ( uint32_t ) ( ( ( uint64_t ) 100U * TEST_CHUNK_SIZE * 1000U ) / ulElapsedMs );
+
+    if( ( ulElapsedMs < 9700U ) || ( ulElapsedMs > 10000U ) || ( ulRate > 42000U ) )
+    {
+        printf( "\t%u ms for the download, %u bytes per second\n", ( unsigned ) ulElapsedMs, ( unsigned ) ulRate );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    /* The burst is read without a delay. */
+    if( xShaper.ulDelays != 98U )
+    {
+        printf( "\t%u chunks delayed\n", ( unsigned ) xShaper.ulDelays );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    return TEST_BANDWIDTH_SHAPER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSlowLink( void )
+{
+    uint32_t ulNowMs = 0;
+    uint32_t ulIndex;
+
+    printf( "Leaving a download slower than the rate alone\n" );
+    BandwidthShaper_Init( &xShaper, 40960, TEST_CHUNK_SIZE, 0 );
+
+    /* A chunk every 200 ms is 20 KB/s. */
+    for( ulIndex = 0; ulIndex < 50U; ulIndex++ )
+    {
+        ulNowMs += 200U;
+
+        if( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, ulNowMs ) != 0U )
+        {
+            printf( "\tChunk %u delayed\n", ( unsigned ) ulIndex );
+            return TEST_BANDWIDTH_SHAPER_FAIL;
+        }
+    }
+
+    /* A long pause fills the bucket up to the burst only. */
+    ulNowMs += 60000U;
+
+    if( ( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, ulNowMs ) != 0U ) ||
+        ( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, ulNowMs ) != 100U ) )
+    {
+        printf( "\tThe bucket grew past the burst\n" );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    return TEST_BANDWIDTH_SHAPER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestWrapAndLongDelay( void )
+{
+    uint32_t ulDelayMs;
+
+    printf( "Shaping across a wrap of the clock and capping the delays\n" );
+    BandwidthShaper_Init( &xShaper, 4096, TEST_CHUNK_SIZE, 0xFFFFFF00U );
+
+    /* 0xFFFFFF00 + 1000 ms wraps around. */
+    if( ( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, 0xFFFFFF00U ) != 0U ) ||
+        ( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, 0xFFFFFF00U + 1000U ) != 0U ) )
+    {
+        printf( "\tDelayed across the wrap\n" );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    /* 1 MB at 4 KB/s would take 256 s. */
+    ulDelayMs = BandwidthShaper_GetDelayMs( &xShaper, 1024U * 1024U, 1000U );
+
+    if( ulDelayMs != bandwidthshaperMAX_DELAY_MS )
+    {
+        printf( "\tDelay of %u ms\n", ( unsigned ) ulDelayMs );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    /* The rest of the debt is not carried over. */
+    if( BandwidthShaper_GetDelayMs( &xShaper, TEST_CHUNK_SIZE, 1000U + ulDelayMs ) != 1000U )
+    {
+        printf( "\tThe debt of the capped delay was carried over\n" );
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    return TEST_BANDWIDTH_SHAPER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestUnlimited() != TEST_BANDWIDTH_SHAPER_SUCCESS ) ||
+        ( prvTestRate() != TEST_BANDWIDTH_SHAPER_SUCCESS ) ||
+        ( prvTestSlowLink() != TEST_BANDWIDTH_SHAPER_SUCCESS ) ||
+        ( prvTestWrapAndLongDelay() != TEST_BANDWIDTH_SHAPER_SUCCESS ) )
+    {
+        return TEST_BANDWIDTH_SHAPER_FAIL;
+    }
+
+    return TEST_BANDWIDTH_SHAPER_SUCCESS;
+}
+/*-----------------------------------------------------------*/
@@ -3,12 +3,20 @@
 
 /*
  *  TEMPORARY UNIT TESTS FOR THE PARSING API
+ *
+ *  The stream parser is fed the same payload in pieces of several sizes, and
+ *  must find what the parser finds, with the certificates unescaped and the
+ *  SHA256 of the signed text.
  */
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "azure_ca_recovery_parse.h"
+#include "azure_ca_recovery_stream.h"
+
+#include "mbedtls/md.h"
 
 #define TEST_CA_RECOVERY_SUCCESS        0
 #define TEST_CA_RECOVERY_FAIL           1
@@ -22,13 +30,15 @@
 static char * ucTestPayload = "{\"signature\":\"LpJ1ROhCUvn2qaKeDODzD2hbcgJdJHA1uygyxC5ywUBtOzKB3e+kT0B+Z/VjENbPMrBZJSncHBfuW+95yVoHpBib2kH3YOD3ZvsdTtYpIPG2HbBPtrxlzaBlek54gD9uZw+Fp3nImdUfMs/L8Hx8NDNr0HLKZVLMqnk/Vh91U1skUYLcWGQDzPpWHlKx2JakNk3BEBBR5pGCu8IVMmfo3le1ztZUcSfiOrgXndmCgngVwmWj0EiLc6MvtUVCjVJvpsOR59mXkxn3tN3ijjWEeDkOBGg4oofWXeD1vSolHYNMQ7aLHJFJ5yDU2t+bQqi87qcSAJ7jtJz7COPXIxS3MQ==\",\"certTrustBundle\":\"{\\\"version\\\":1,\\\"expiryTime\\\":1673629796,\\\"certs\\\":\\\"-----BEGIN CERTIFICATE-----\\\\r\\\\nMIIDdzCCAl+gAwIBAgIEAgAAuTANBgkqhkiG9w0BAQUFADBaMQswCQYDVQQGEwJJ\\\\r\\\\nRTESMBAGA1UEChMJQmFsdGltb3JlMRMwEQYDVQQLEwpDeWJlclRydXN0MSIwIAYD\\\\r\\\\nVQQDExlCYWx0aW1vcmUgQ3liZXJUcnVzdCBSb290MB4XDTAwMDUxMjE4NDYwMFoX\\\\r\\\\nDTI1MDUxMjIzNTkwMFowWjELMAkGA1UEBhMCSUUxEjAQBgNVBAoTCUJhbHRpbW9y\\\\r\\\\nZTETMBEGA1UECxMKQ3liZXJUcnVzdDEiMCAGA1UEAxMZQmFsdGltb3JlIEN5YmVy\\\\r\\\\nVHJ1c3QgUm9vdDCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAKMEuyKr\\\\r\\\\nmD1X6CZymrV51Cni4eiVgLGw41uOKymaZN+hXe2wCQVt2yguzmKiYv60iNoS6zjr\\\\r\\\\nIZ3AQSsBUnuId9Mcj8e6uYi1agnnc+gRQKfRzMpijS3ljwumUNKoUMMo6vWrJYeK\\\\r\\\\nmpYcqWe4PwzV9/lSEy/CG9VwcPCPwBLKBsua4dnKM3p31vjsufFoREJIE9LAwqSu\\\\r\\\\nXmD+tqYF/LTdB1kC1FkYmGP1pWPgkAx9XbIGevOF6uvUA65ehD5f/xXtabz5OTZy\\\\r\\\\ndc93Uk3zyZAsuT3lySNTPx8kmCFcB5kpvcY67Oduhjprl3RjM71oGDHweI12v/ye\\\\r\\\\njl0qhqdNkNwnGjkCAwEAAaNFMEMwHQYDVR0OBBYEFOWdWTCCR1jMrPoIVDaGezq1\\\\r\\\\nBE3wMBIGA1UdEwEB/wQIMAYBAf8CAQMwDgYDVR0PAQH/BAQDAgEGMA0GCSqGSIb3\\\\r\\\\nDQEBBQUAA4IBAQCFDF2O5G9RaEIFoN27TyclhAO992T9Ldcw46QQF+vaKSm2eT92\\\\r\\\\n9hkTI7gQCvlYpNRhcL0EYWoSihfVCr3FvDB81ukMJY2GQE/szKN+OMY3EU/t3Wgx\\\\r\\\\njkzSswF07r51XgdIGn9w/xZchMB5hbgF/X++ZRGjD8ACtPhSNzkE1akxehi/oCr0\\\\r\\\\nEpn3o0WC4zxe9Z2etciefC7IpJ5OCBRLbf1wbWsaY71k5h+3zvDyny67G7fyUIhz\\\\r\\\\nksLi4xaNmjICq44Y3ekQEe5+NauQrz4wlHrQMz2nZQ/1/I6eYs9HRCwBXbsdtTLS\\\\r\\\\nR9I4LtD+gdwyah617jzV/OeBHRnDJELqYzmp\\\\r\\\\n-----END CERTIFICATE-----\\\\r\\\\n\\\"}\"}";
 
 static char ucPayloadBuffer[ 2048 ];
+static uint8_t ucCertificates[ 2048 ];
+static uint32_t ulCertificatesWritten;
 
 void prvCopyBuffer()
 {
     memcpy( ucPayloadBuffer, ucTestPayload, strlen( ucTestPayload ) );
 }
 
-int vStartTestTask( void )
+static int prvTestParse( void )
 {
     AzureIoTResult_t xResult;
     AzureIoTJSONReader_t xReader;
@@ -78,3 +88,181 @@ int vStartTestTask( void )
 
     return TEST_CA_RECOVERY_SUCCESS;
 }
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvCertificatesWrite( void * pvContext,
+                                              uint32_t ulOffset,
+                                              const uint8_t * pucData,
+                                              uint32_t ulLength )
+{
+    ( void ) pvContext;
+
+    if( ( ulOffset != ulCertificatesWritten ) || ( ulLength > sizeof( ucCertificates ) - ulOffset ) )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    memcpy( ucCertificates + ulOffset, pucData, ulLength );
+    ulCertificatesWritten += ulLength;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* Compares the certificates with TEST_BUNDLE_CERT, whose line breaks are still
+ * escaped. */
+static int prvCertificatesMatch( void )
+{
+    const char * pcExpected = TEST_BUNDLE_CERT;
+    uint32_t ulIndex = 0;
+    char cExpected;
+
+    while( *pcExpected != '\0' )
+    {
+        cExpected = *pcExpected++;
+
+        if( cExpected == '\\' )
+        {
+            cExpected = ( *pcExpected++ == 'r' ) ? '\r' : '\n';
+        }
+
+        if( ( ulIndex >= ulCertificatesWritten ) || ( ucCertificates[ ulIndex++ ] != ( uint8_t ) cExpected ) )
+        {
+            return 0;
+        }
+    }
+
+    return ulIndex == ulCertificatesWritten;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvStreamPayload( AzureIoTCARecovery_StreamParser * pxParser,
+                                          const char * pcPayload,
+                                          uint32_t ulPieceLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulPayloadLength = ( uint32_t ) strlen( pcPayload );
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    ulCertificatesWritten = 0;
+
+    xResult = AzureIoTCARecovery_StreamInit( pxParser, prvCertificatesWrite, NULL );
+
+    for( ulOffset = 0; ( xResult == eAzureIoTSuccess ) && ( ulOffset < ulPayloadLength ); ulOffset += ulLength )
+    {
+        ulLength = ulPayloadLength - ulOffset < ulPieceLength ? ulPayloadLength - ulOffset : ulPieceLength;
+        xResult = AzureIoTCARecovery_StreamFeed( pxParser, ( const uint8_t * ) pcPayload + ulOffset, ulLength );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = AzureIoTCARecovery_StreamFinish( pxParser );
+    }
+
+    AzureIoTCARecovery_StreamDeinit( pxParser );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestStream( uint32_t ulPieceLength )
+{
+    AzureIoTCARecovery_StreamParser xParser;
+    uint8_t ucHash[ azureiotcarecoverySTREAM_HASH_SIZE ];
+
+    printf( "Streaming Recovery Payload in pieces of %u bytes\n", ( unsigned ) ulPieceLength );
+
+    if( prvStreamPayload( &xParser, ucTestPayload, ulPieceLength ) != eAzureIoTSuccess )
+    {
+        printf( "\tFailed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+
+    mbedtls_md( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
+                ( const uint8_t * ) TEST_BUNDLE_JSON_OBJECT_TEXT, sizeof( TEST_BUNDLE_JSON_OBJECT_TEXT ) - 1,
+                ucHash );
+
+    if( ( xParser.ulSignatureLength != sizeof( TEST_SIGNATURE ) - 1 ) ||
+        ( memcmp( xParser.ucSignature, TEST_SIGNATURE, sizeof( TEST_SIGNATURE ) - 1 ) != 0 ) )
+    {
+        printf( "\tSignature Failed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( memcmp( xParser.ucTrustBundleHash, ucHash, sizeof( ucHash ) ) != 0 )
+    {
+        printf( "\tTrust Bundle Hash Failed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( ( xParser.ulVersion != TEST_BUNDLE_VERSION ) || ( xParser.ullExpiryTimeSecs != TEST_BUNDLE_EXPIRY ) )
+    {
+        printf( "\tBundle Version or Expiry Failed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( ( xParser.ulCertificatesLength != ulCertificatesWritten ) || !prvCertificatesMatch() )
+    {
+        printf( "\tBundle Certs Failed!\n" );
+        printf( "\tReceived: %.*s", ( int ) ulCertificatesWritten, ucCertificates );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+
+    return TEST_CA_RECOVERY_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestStreamInvalid( void )
+{
+    AzureIoTCARecovery_StreamParser xParser;
+    static char cTruncated[ 64 ];
+
+    printf( "Streaming invalid Recovery Payloads\n" );
+
+    memcpy( cTruncated, ucTestPayload, sizeof( cTruncated ) - 1 );
+
+    /* Members not read are skipped, whatever their value. */
+    if( prvStreamPayload( &xParser, "{\"a\":[1,{\"b\":\"}\"}],\"signature\":\"AA==\",\"n\":null,"
+                                    "\"certTrustBundle\":\"{\\\"x\\\":-1.5e3,\\\"certs\\\":\\\"\\\\u0041\\\"}\"}", 5 ) != eAzureIoTSuccess )
+    {
+        printf( "\tOther members Failed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( ( ulCertificatesWritten != 1U ) || ( ucCertificates[ 0 ] != 'A' ) || ( xParser.ulVersion != 0U ) )
+    {
+        printf( "\tOther members Certs Failed!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( prvStreamPayload( &xParser, cTruncated, 7 ) == eAzureIoTSuccess )
+    {
+        printf( "\tTruncated payload accepted!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( prvStreamPayload( &xParser, "{\"signature\":\"AA==\",\"signature\":\"AA==\"}", 64 ) == eAzureIoTSuccess )
+    {
+        printf( "\tDuplicate member accepted!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+    else if( prvStreamPayload( &xParser, "{\"signature\":\"AA==\",\"certTrustBundle\":\"{\\\"version\\\":\\\"1.0\\\"}\"}", 64 ) == eAzureIoTSuccess )
+    {
+        printf( "\tVersion string accepted!\n" );
+        return TEST_CA_RECOVERY_FAIL;
+    }
+
+    return TEST_CA_RECOVERY_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestParse() != TEST_CA_RECOVERY_SUCCESS ) ||
+        ( prvTestStream( 1 ) != TEST_CA_RECOVERY_SUCCESS ) ||
+        ( prvTestStream( 7 ) != TEST_CA_RECOVERY_SUCCESS ) ||
+        ( prvTestStream( 64 ) != TEST_CA_RECOVERY_SUCCESS ) ||
+        ( prvTestStream( sizeof( ucPayloadBuffer ) ) != TEST_CA_RECOVERY_SUCCESS ) ||
+        ( prvTestStreamInvalid() != TEST_CA_RECOVERY_SUCCESS ) )
+    {
+        return TEST_CA_RECOVERY_FAIL;
+    }
+
+    return TEST_CA_RECOVERY_SUCCESS;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,442 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the HTTP range download, against an in-memory stand-in of a
+ * range capable HTTP/1.1 server. The server answers the requests in order,
+ * hands its responses to the client in fragments of a configured size and
+ * can close the connection after a number of responses.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "azure_sample_http_range.h"
+
+#define TEST_HTTP_RANGE_SUCCESS      0
+#define TEST_HTTP_RANGE_FAIL         1
+
+#define TEST_HOST                    "adu.example.com"
+#define TEST_PATH                    "/firmware/image.bin"
+#define TEST_MAX_FILE_SIZE           ( 16384U )
+#define TEST_SERVER_BUFFER_SIZE      ( 65536U )
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+/* Stand-in of the server. */
+typedef struct TestServer
+{
+    uint32_t ulFileSize;
+    uint32_t ulFragmentSize;          /* Most bytes returned by a receive. */
+    uint32_t ulResponsesPerConnection; /* The last one has "Connection: close", 0 for no limit. */
+    uint32_t ulStatus;                /* Status of the responses. */
+    char cRequests[ 1024 ];           /* Request bytes not parsed yet. */
+    uint32_t ulRequestsLength;
+    uint8_t ucResponses[ TEST_SERVER_BUFFER_SIZE ];
+    uint32_t ulResponsesLength;
+    uint32_t ulResponsesRead;
+    uint32_t ulResponsesOnConnection;
+    uint32_t ulResponseStarts[ 64 ];  /* Offsets of the responses of the connection. */
+    uint32_t ulMaxPendingRequests;    /* Most responses queued before the client read them. */
+    bool xClosed;
+} TestServer_t;
+
+static TestServer_t xServer;
+static uint8_t ucFile[ TEST_MAX_FILE_SIZE ];
+static uint8_t ucDownloaded[ TEST_MAX_FILE_SIZE ];
+static uint8_t ucChunkBuffer[ 4096 ];
+static uint8_t ucHeaderBuffer[ 512 ];
+
+static HTTPRangeClient_t xClient;
+static uint32_t ulGrowToChunkSize; /* When not 0, the chunk size doubles after each chunk up to it. */
+static NetworkContext_t xNetworkContext;
+static AzureIoTTransportInterface_t xTransport;
+
+/*-----------------------------------------------------------*/
+
+static void prvServerReset( uint32_t ulFileSize,
+                            uint32_t ulFragmentSize,
+                            uint32_t ulResponsesPerConnection,
+                            uint32_t ulStatus )
+{
+    uint32_t ulIndex;
+
+    ( void ) memset( &xServer, 0, sizeof( xServer ) );
+    xServer.ulFileSize = ulFileSize;
+    xServer.ulFragmentSize = ulFragmentSize;
+    xServer.ulResponsesPerConnection = ulResponsesPerConnection;
+    xServer.ulStatus = ulStatus;
+
+    for( ulIndex = 0; ulIndex < ulFileSize; ulIndex++ )
+    {
+        ucFile[ ulIndex ] = ( uint8_t ) ( ( ulIndex * 31U ) + ( ulIndex >> 8 ) + 7U );
+    }
+
+    ( void ) memset( ucDownloaded, 0, sizeof( ucDownloaded ) );
+}
+/*-----------------------------------------------------------*/
+
+/* Accepts a new connection, what was in flight on the old one is lost. */
+static void prvServerReconnect( void )
+{
+    xServer.ulRequestsLength = 0;
+    xServer.ulResponsesLength = 0;
+    xServer.ulResponsesRead = 0;
+    xServer.ulResponsesOnConnection = 0;
+    xServer.xClosed = false;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServerAppend( const void * pvData,
+                             uint32_t ulLength )
+{
+    if( ( xServer.ulResponsesLength + ulLength ) <= sizeof( xServer.ucResponses ) )
+    {
+        ( void ) memcpy( &xServer.ucResponses[ xServer.ulResponsesLength ], pvData, ulLength );
+        xServer.ulResponsesLength += ulLength;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvServerRespond( const char * pcRequest )
+{
+    const char * pcRange = strstr( pcRequest, "Range: bytes=" );
+    unsigned long ulStart;
+    unsigned long ulEnd;
+    char cHeaders[ 256 ];
+    int lLength;
+    bool xClose;
+    uint32_t ulIndex;
+    uint32_t ulPending = 0;
+
+    if( ( pcRange == NULL ) ||
+        ( sscanf( pcRange, "Range: bytes=%lu-%lu", &ulStart, &ulEnd ) != 2 ) ||
+        ( ulEnd >= xServer.ulFileSize ) || ( ulStart > ulEnd ) )
+    {
+        return;
+    }
+
+    if( xServer.ulResponsesOnConnection >= ( sizeof( xServer.ulResponseStarts ) / sizeof( uint32_t ) ) )
+    {
+        return;
+    }
+
+    xServer.ulResponseStarts[ xServer.ulResponsesOnConnection++ ] = xServer.ulResponsesLength;
+    xClose = ( xServer.ulResponsesPerConnection != 0U ) &&
+             ( xServer.ulResponsesOnConnection == xServer.ulResponsesPerConnection );
+
+    lLength = snprintf( cHeaders, sizeof( cHeaders ),
+                        "HTTP/1.1 %u Partial Content\r\n"
+                        "content-type: application/octet-stream\r\n"
+                        "Content-Range: bytes %lu-%lu/%u\r\n"
+                        "Content-Length: %lu\r\n"
+                        "Connection: %s\r\n"
+                        "\r\n",
+                        ( unsigned ) xServer.ulStatus, ulStart, ulEnd, ( unsigned ) xServer.ulFileSize,
+                        ulEnd - ulStart + 1U, xClose ? "close" : "keep-alive" );
+
+    prvServerAppend( cHeaders, ( uint32_t ) lLength );
+    prvServerAppend( &ucFile[ ulStart ], ( uint32_t ) ( ulEnd - ulStart + 1U ) );
+
+    for( ulIndex = 0; ulIndex < xServer.ulResponsesOnConnection; ulIndex++ )
+    {
+        if( xServer.ulResponseStarts[ ulIndex ] >= xServer.ulResponsesRead )
+        {
+            ulPending++;
+        }
+    }
+
+    if( ulPending > xServer.ulMaxPendingRequests )
+    {
+        xServer.ulMaxPendingRequests = ulPending;
+    }
+
+    /* Later requests on this connection are not answered. */
+    xServer.xClosed = xClose;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvServerSend( NetworkContext_t * pxNetworkContext,
+                              const void * pvBuffer,
+                              size_t xBytesToSend )
+{
+    char * pcEnd;
+    uint32_t ulRequestLength;
+
+    ( void ) pxNetworkContext;
+
+    if( ( xServer.ulRequestsLength + xBytesToSend ) >= sizeof( xServer.cRequests ) )
+    {
+        return -1;
+    }
+
+    ( void ) memcpy( &xServer.cRequests[ xServer.ulRequestsLength ], pvBuffer, xBytesToSend );
+    xServer.ulRequestsLength += ( uint32_t ) xBytesToSend;
+    xServer.cRequests[ xServer.ulRequestsLength ] = '\0';
+
+    while( ( pcEnd = strstr( xServer.cRequests, "\r\n\r\n" ) ) != NULL )
+    {
+        *pcEnd = '\0';
+
+        if( !xServer.xClosed )
+        {
+            prvServerRespond( xServer.cRequests );
+        }
+
+        ulRequestLength = ( uint32_t ) ( pcEnd - xServer.cRequests ) + 4U;
+        xServer.ulRequestsLength -= ulRequestLength;
+        ( void ) memmove( xServer.cRequests, &xServer.cRequests[ ulRequestLength ], xServer.ulRequestsLength + 1U );
+    }
+
+    return ( int32_t ) xBytesToSend;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvServerRecv( NetworkContext_t * pxNetworkContext,
+                              void * pvBuffer,
+                              size_t xBytesToRecv )
+{
+    uint32_t ulLength = xServer.ulResponsesLength - xServer.ulResponsesRead;
+
+    ( void ) pxNetworkContext;
+
+    if( ulLength == 0U )
+    {
+        /* A closed connection fails, an open one times out. */
+        return xServer.xClosed ? -1 : 0;
+    }
+
+    ulLength = ( ulLength < xServer.ulFragmentSize ) ? ulLength : xServer.ulFragmentSize;
+    ulLength = ( ulLength < xBytesToRecv ) ? ulLength : ( uint32_t ) xBytesToRecv;
+    ( void ) memcpy( pvBuffer, &xServer.ucResponses[ xServer.ulResponsesRead ], ulLength );
+    xServer.ulResponsesRead += ulLength;
+
+    return ( int32_t ) ulLength;
+}
+/*-----------------------------------------------------------*/
+
+/* Downloads the file from an offset, reconnecting when the client asks for it. */
+static HTTPRangeResult_t prvDownload( uint32_t ulStartOffset,
+                                      uint32_t ulChunkSize,
+                                      uint32_t ulPipelineDepth )
+{
+    HTTPRangeResult_t xResult;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+
+    xNetworkContext.pParams = NULL;
+    xTransport.pxNetworkContext = &xNetworkContext;
+    xTransport.xSend = prvServerSend;
+    xTransport.xRecv = prvServerRecv;
+
+    xResult = HTTPRange_Init( &xClient, &xTransport,
+                              TEST_HOST, sizeof( TEST_HOST ) - 1,
+                              TEST_PATH, sizeof( TEST_PATH ) - 1,
+                              ucHeaderBuffer, sizeof( ucHeaderBuffer ),
+                              xServer.ulFileSize, ulChunkSize, ulPipelineDepth );
+
+    if( xResult == eHTTPRangeSuccess )
+    {
+        xResult = HTTPRange_Seek( &xClient, ulStartOffset );
+    }
+
+    while( xResult == eHTTPRangeSuccess )
+    {
+        xResult = HTTPRange_ReadChunk( &xClient, ucChunkBuffer, sizeof( ucChunkBuffer ), &ulOffset, &ulLength );
+
+        if( xResult == eHTTPRangeSuccess )
+        {
+            ( void ) memcpy( &ucDownloaded[ ulOffset ], ucChunkBuffer, ulLength );
+
+            if( ( ulGrowToChunkSize != 0U ) && ( xClient.ulChunkSize < ulGrowToChunkSize ) )
+            {
+                xResult = HTTPRange_SetChunkSize( &xClient, xClient.ulChunkSize * 2U );
+            }
+        }
+        else if( ( xResult == eHTTPRangeConnectionClosed ) || ( xResult == eHTTPRangeNetworkError ) )
+        {
+            prvServerReconnect();
+            HTTPRange_Reset( &xClient );
+            xResult = eHTTPRangeSuccess;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvCheckDownload( HTTPRangeResult_t xResult )
+{
+    if( xResult != eHTTPRangeComplete )
+    {
+        printf( "\tDownload failed: %d\n", ( int ) xResult );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    if( memcmp( ucDownloaded, ucFile, xServer.ulFileSize ) != 0 )
+    {
+        printf( "\tDownloaded file differs!\n" );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestKeepAlivePipeline( void )
+{
+    const HTTPRangeStats_t * pxStats;
+
+    printf( "Downloading over one connection with 3 requests in flight\n" );
+    prvServerReset( 10000, 700, 0, 206 );
+
+    if( prvCheckDownload( prvDownload( 0, 1024, 3 ) ) != TEST_HTTP_RANGE_SUCCESS )
+    {
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    pxStats = HTTPRange_GetStats( &xClient );
+
+    if( ( pxStats->ulConnections != 1U ) || ( pxStats->ulRequests != 10U ) ||
+        ( pxStats->ulResponses != 10U ) || ( pxStats->ulServerCloses != 0U ) )
+    {
+        printf( "\tUnexpected counters: %u connections, %u requests, %u responses\n",
+                ( unsigned ) pxStats->ulConnections, ( unsigned ) pxStats->ulRequests,
+                ( unsigned ) pxStats->ulResponses );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    if( xServer.ulMaxPendingRequests != 3U )
+    {
+        printf( "\tRequests were not pipelined: %u in flight\n", ( unsigned ) xServer.ulMaxPendingRequests );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConnectionClose( void )
+{
+    const HTTPRangeStats_t * pxStats;
+
+    printf( "Downloading from a server closing the connection every 4 responses\n" );
+    prvServerReset( 10000, 4096, 4, 206 );
+
+    if( prvCheckDownload( prvDownload( 0, 1024, 3 ) ) != TEST_HTTP_RANGE_SUCCESS )
+    {
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    pxStats = HTTPRange_GetStats( &xClient );
+
+    /* 10 chunks: 4 on each of the first two connections, 2 on the last one. */
+    if( ( pxStats->ulConnections != 3U ) || ( pxStats->ulServerCloses != 2U ) ||
+        ( pxStats->ulResponses != 10U ) || ( pxStats->ulRequests <= pxStats->ulResponses ) )
+    {
+        printf( "\tUnexpected counters: %u connections, %u closes, %u requests, %u responses\n",
+                ( unsigned ) pxStats->ulConnections, ( unsigned ) pxStats->ulServerCloses,
+                ( unsigned ) pxStats->ulRequests, ( unsigned ) pxStats->ulResponses );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSmallChunks( void )
+{
+    printf( "Downloading chunks smaller than the receives\n" );
+
+    /* Several responses arrive in the header buffer at once. */
+    prvServerReset( 3001, 4096, 0, 206 );
+
+    return prvCheckDownload( prvDownload( 0, 16, 4 ) );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestResume( void )
+{
+    printf( "Resuming a download from an offset\n" );
+    prvServerReset( 10000, 4096, 0, 206 );
+
+    /* The first chunks were downloaded before. */
+    ( void ) memcpy( ucDownloaded, ucFile, 3072 );
+
+    if( prvCheckDownload( prvDownload( 3072, 1024, 2 ) ) != TEST_HTTP_RANGE_SUCCESS )
+    {
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    if( HTTPRange_GetStats( &xClient )->ulResponses != 7U )
+    {
+        printf( "\tThe chunks downloaded before were requested again!\n" );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestChangingChunkSize( void )
+{
+    int lResult;
+
+    printf( "Downloading with a chunk size growing while requests are in flight\n" );
+
+    /* The requests lost when the server closes are sent again at the new size. */
+    prvServerReset( 16000, 1500, 3, 206 );
+    ulGrowToChunkSize = 4096;
+    lResult = prvCheckDownload( prvDownload( 0, 256, 3 ) );
+    ulGrowToChunkSize = 0;
+
+    if( lResult != TEST_HTTP_RANGE_SUCCESS )
+    {
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    if( HTTPRange_SetChunkSize( &xClient, 0 ) != eHTTPRangeInvalidParameter )
+    {
+        printf( "\tA chunk size of 0 was accepted!\n" );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestRangeNotSupported( void )
+{
+    printf( "Rejecting a response which is not partial content\n" );
+    prvServerReset( 4096, 4096, 0, 200 );
+
+    if( prvDownload( 0, 1024, 2 ) != eHTTPRangeResponseError )
+    {
+        printf( "\tThe response was accepted!\n" );
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestKeepAlivePipeline() != TEST_HTTP_RANGE_SUCCESS ) ||
+        ( prvTestConnectionClose() != TEST_HTTP_RANGE_SUCCESS ) ||
+        ( prvTestSmallChunks() != TEST_HTTP_RANGE_SUCCESS ) ||
+        ( prvTestResume() != TEST_HTTP_RANGE_SUCCESS ) ||
+        ( prvTestChangingChunkSize() != TEST_HTTP_RANGE_SUCCESS ) ||
+        ( prvTestRangeNotSupported() != TEST_HTTP_RANGE_SUCCESS ) )
+    {
+        return TEST_HTTP_RANGE_FAIL;
+    }
+
+    return TEST_HTTP_RANGE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,431 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Unit tests of the trust bundle: the PEM certificates of a recovered bundle
+ * converted to DER behind an index, loaded back by the TLS transport, and
+ * looked up by subject for the trusted CA callback.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "azure_ca_recovery_trust_bundle.h"
+#include "transport_tls_trust_bundle.h"
+
+#include "mbedtls/platform.h"
+#include "mbedtls/x509_crt.h"
+
+#define TEST_TRUST_BUNDLE_SUCCESS    0
+#define TEST_TRUST_BUNDLE_FAIL       1
+
+#define TEST_CERTIFICATE_COUNT       3U
+
+/* Baltimore CyberTrust Root, with the line breaks of the recovery payload,
+ * DigiCert Global Root G2 and Microsoft RSA Root Certificate Authority 2017. */
+#define TEST_TRUST_BUNDLE_PEM \
+    "-----BEGIN CERTIFICATE-----\r\n" \
+    "MIIDdzCCAl+gAwIBAgIEAgAAuTANBgkqhkiG9w0BAQUFADBaMQswCQYDVQQGEwJJ\r\n" \
+    "RTESMBAGA1UEChMJQmFsdGltb3JlMRMwEQYDVQQLEwpDeWJlclRydXN0MSIwIAYD\r\n" \
+    "VQQDExlCYWx0aW1vcmUgQ3liZXJUcnVzdCBSb290MB4XDTAwMDUxMjE4NDYwMFoX\r\n" \
+    "DTI1MDUxMjIzNTkwMFowWjELMAkGA1UEBhMCSUUxEjAQBgNVBAoTCUJhbHRpbW9y\r\n" \
+    "ZTETMBEGA1UECxMKQ3liZXJUcnVzdDEiMCAGA1UEAxMZQmFsdGltb3JlIEN5YmVy\r\n" \
+    "VHJ1c3QgUm9vdDCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAKMEuyKr\r\n" \
+    "mD1X6CZymrV51Cni4eiVgLGw41uOKymaZN+hXe2wCQVt2yguzmKiYv60iNoS6zjr\r\n" \
+    "IZ3AQSsBUnuId9Mcj8e6uYi1agnnc+gRQKfRzMpijS3ljwumUNKoUMMo6vWrJYeK\r\n" \
+    "mpYcqWe4PwzV9/lSEy/CG9VwcPCPwBLKBsua4dnKM3p31vjsufFoREJIE9LAwqSu\r\n" \
+    "XmD+tqYF/LTdB1kC1FkYmGP1pWPgkAx9XbIGevOF6uvUA65ehD5f/xXtabz5OTZy\r\n" \
+    "dc93Uk3zyZAsuT3lySNTPx8kmCFcB5kpvcY67Oduhjprl3RjM71oGDHweI12v/ye\r\n" \
+    "jl0qhqdNkNwnGjkCAwEAAaNFMEMwHQYDVR0OBBYEFOWdWTCCR1jMrPoIVDaGezq1\r\n" \
+    "BE3wMBIGA1UdEwEB/wQIMAYBAf8CAQMwDgYDVR0PAQH/BAQDAgEGMA0GCSqGSIb3\r\n" \
+    "DQEBBQUAA4IBAQCFDF2O5G9RaEIFoN27TyclhAO992T9Ldcw46QQF+vaKSm2eT92\r\n" \
+    "9hkTI7gQCvlYpNRhcL0EYWoSihfVCr3FvDB81ukMJY2GQE/szKN+OMY3EU/t3Wgx\r\n" \
+    "jkzSswF07r51XgdIGn9w/xZchMB5hbgF/X++ZRGjD8ACtPhSNzkE1akxehi/oCr0\r\n" \
+    "Epn3o0WC4zxe9Z2etciefC7IpJ5OCBRLbf1wbWsaY71k5h+3zvDyny67G7fyUIhz\r\n" \
+    "ksLi4xaNmjICq44Y3ekQEe5+NauQrz4wlHrQMz2nZQ/1/I6eYs9HRCwBXbsdtTLS\r\n" \
+    "R9I4LtD+gdwyah617jzV/OeBHRnDJELqYzmp\r\n" \
+    "-----END CERTIFICATE-----\r\n" \
+    "-----BEGIN CERTIFICATE-----\n" \
+    "MIIDjjCCAnagAwIBAgIQAzrx5qcRqaC7KGSxHQn65TANBgkqhkiG9w0BAQsFADBh\n" \
+    "MQswCQYDVQQGEwJVUzEVMBMGA1UEChMMRGlnaUNlcnQgSW5jMRkwFwYDVQQLExB3\n" \
+    "d3cuZGlnaWNlcnQuY29tMSAwHgYDVQQDExdEaWdpQ2VydCBHbG9iYWwgUm9vdCBH\n" \
+    "MjAeFw0xMzA4MDExMjAwMDBaFw0zODAxMTUxMjAwMDBaMGExCzAJBgNVBAYTAlVT\n" \
+    "MRUwEwYDVQQKEwxEaWdpQ2VydCBJbmMxGTAXBgNVBAsTEHd3dy5kaWdpY2VydC5j\n" \
+    "b20xIDAeBgNVBAMTF0RpZ2lDZXJ0IEdsb2JhbCBSb290IEcyMIIBIjANBgkqhkiG\n" \
+    "9w0BAQEFAAOCAQ8AMIIBCgKCAQEAuzfNNNx7a8myaJCtSnX/RrohCgiN9RlUyfuI\n" \
+    "2/Ou8jqJkTx65qsGGmvPrC3oXgkkRLpimn7Wo6h+4FR1IAWsULecYxpsMNzaHxmx\n" \
+    "1x7e/dfgy5SDN67sH0NO3Xss0r0upS/kqbitOtSZpLYl6ZtrAGCSYP9PIUkY92eQ\n" \
+    "q2EGnI/yuum06ZIya7XzV+hdG82MHauVBJVJ8zUtluNJbd134/tJS7SsVQepj5Wz\n" \
+    "tCO7TG1F8PapspUwtP1MVYwnSlcUfIKdzXOS0xZKBgyMUNGPHgm+F6HmIcr9g+UQ\n" \
+    "vIOlCsRnKPZzFBQ9RnbDhxSJITRNrw9FDKZJobq7nMWxM4MphQIDAQABo0IwQDAP\n" \
+    "BgNVHRMBAf8EBTADAQH/MA4GA1UdDwEB/wQEAwIBhjAdBgNVHQ4EFgQUTiJUIBiV\n" \
+    "5uNu5g/6+rkS7QYXjzkwDQYJKoZIhvcNAQELBQADggEBAGBnKJRvDkhj6zHd6mcY\n" \
+    "1Yl9PMWLSn/pvtsrF9+wX3N3KjITOYFnQoQj8kVnNeyIv/iPsGEMNKSuIEyExtv4\n" \
+    "NeF22d+mQrvHRAiGfzZ0JFrabA0UWTW98kndth/Jsw1HKj2ZL7tcu7XUIOGZX1NG\n" \
+    "Fdtom/DzMNU+MeKNhJ7jitralj41E6Vf8PlwUHBHQRFXGU7Aj64GxJUTFy8bJZ91\n" \
+    "8rGOmaFvE7FBcf6IKshPECBV1/MUReXgRPTqh5Uykw7+U0b6LJ3/iyK5S9kJRaTe\n" \
+    "pLiaWN0bfVKfjllDiIGknibVb63dDcY3fe0Dkhvld1927jyNxF1WW6LZZm6zNTfl\n" \
+    "MrY=\n" \
+    "-----END CERTIFICATE-----\n" \
+    "-----BEGIN CERTIFICATE-----\n" \
+    "MIIFqDCCA5CgAwIBAgIQHtOXCV/YtLNHcB6qvn9FszANBgkqhkiG9w0BAQwFADBl\n" \
+    "MQswCQYDVQQGEwJVUzEeMBwGA1UEChMVTWljcm9zb2Z0IENvcnBvcmF0aW9uMTYw\n" \
+    "NAYDVQQDEy1NaWNyb3NvZnQgUlNBIFJvb3QgQ2VydGlmaWNhdGUgQXV0aG9yaXR5\n" \
+    "IDIwMTcwHhcNMTkxMjE4MjI1MTIyWhcNNDIwNzE4MjMwMDIzWjBlMQswCQYDVQQG\n" \
+    "EwJVUzEeMBwGA1UEChMVTWljcm9zb2Z0IENvcnBvcmF0aW9uMTYwNAYDVQQDEy1N\n" \
+    "aWNyb3NvZnQgUlNBIFJvb3QgQ2VydGlmaWNhdGUgQXV0aG9yaXR5IDIwMTcwggIi\n" \
+    "MA0GCSqGSIb3DQEBAQUAA4ICDwAwggIKAoICAQDKW76UM4wplZEWCpW9R2LBifOZ\n" \
+    "Nt9GkMml7Xhqb0eRaPgnZ1AzHaGm++DlQ6OEAlcBXZxIQIJTELy/xztokLaCLeX0\n" \
+    "ZdDMbRnMlfl7rEqUrQ7eS0MdhweSE5CAg2Q1OQT85elss7YfUJQ4ZVBcF0a5toW1\n" \
+    "HLUX6NZFndiyJrDKxHBKrmCk3bPZ7Pw71VdyvD/IybLeS2v4I2wDwAW9lcfNcztm\n" \
+    "gGTjGqwu+UcF8ga2m3P1eDNbx6H7JyqhtJqRjJHTOoI+dkC0zVJhUXAoP8XFWvLJ\n" \
+    "jEm7FFtNyP9nTUwSlq31/niol4fX/V4ggNyhSyL71Imtus5Hl0dVe49FyGcohJUc\n" \
+    "aDDv70ngNXtk55iwlNpNhTs+VcQor1fznhPbRiefHqJeRIOkpcrVE7NLP8TjwuaG\n" \
+    "YaRSMLl6IE9vDzhTyzMMEyuP1pq9KsgtsRx9S1HKR9FIJ3Jdh+vVReZIZZ2vUpC6\n" \
+    "W6IYZVcSn2i51BVrlMRpIpj0M+Dt+VGOQVDJNE92kKz8OMHY4Xu54+OU4UZpyw4K\n" \
+    "UGsTuqwPN1q3ErWQgR5WrlcihtnJ0tHXUeOrO8ZV/R4O03QK0dqq6mm4lyiPSMQH\n" \
+    "+FJDOvTKVTUssKZqwJz58oHhEmrARdlns87/I6KJClTUFLkqqNfs+avNJVgyeY+Q\n" \
+    "W5g5xAgGwax/Dj0ApQIDAQABo1QwUjAOBgNVHQ8BAf8EBAMCAYYwDwYDVR0TAQH/\n" \
+    "BAUwAwEB/zAdBgNVHQ4EFgQUCctZf4aycI8awznjwNnpv7tNsiMwEAYJKwYBBAGC\n" \
+    "NxUBBAMCAQAwDQYJKoZIhvcNAQEMBQADggIBAKyvPl3CEZaJjqPnktaXFbgToqZC\n" \
+    "LgLNFgVZJ8og6Lq46BrsTaiXVq5lQ7GPAJtSzVXNUzltYkyLDVt8LkS/gxCP81OC\n" \
+    "gMNPOsduET/m4xaRhPtthH80dK2Jp86519efhGSSvpWhrQlTM93uCupKUY5vVau6\n" \
+    "tZRGrox/2KJQJWVggEbbMwSubLWYdFQl3JPk+ONVFT24bcMKpBLBaYVu32TxU5nh\n" \
+    "SnUgnZUP5NbcA/FZGOhHibJXWpS2qdgXKxdJ5XbLwVaZOjex/2kskZGT4d9Mozd2\n" \
+    "TaGf+G0eHdP67Pv0RR0Tbc/3WeUiJ3IrhvNXuzDtJE3cfVa7o7P4NHmJweDyAmH3\n" \
+    "pvwPuxwXC65B2Xy9J6P9LjrRk5Sxcx0ki69bIImtt2dmefU6xqaWM/5TkshGsRGR\n" \
+    "xpl/j8nWZjEgQRCHLQzWwa80mMpkg/sTV9HB8Dx6jKXB/ZUhoHHBk2dxEuqPiApp\n" \
+    "GWSZI1b7rCoucL5mxAyE7+WL85MB+GqQk2dLsmijtWKP6T+MejteD+eMuMZ87zf9\n" \
+    "dOLITzNy4ZQ5bb0Sr74MTnB8G2+NszKTc0QWbej09+CVgI+WXTik9KveCjCHk9hN\n" \
+    "AHFiRSdLOkKEW39lt2c0Ui2cFmuqqNh7o0JMcccMyj6D5KbvtwEwXlGjefVwaaZB\n" \
+    "RA+GsCyRxj3qrg+E\n" \
+    "-----END CERTIFICATE-----\n"
+
+#define TEST_INVALID_CERTIFICATE_PEM \
+    "-----BEGIN CERTIFICATE-----\n" \
+    "MIIBAAAA\n"                    \
+    "-----END CERTIFICATE-----\n"
+
+static const uint32_t ulTestCertificateLengths[ TEST_CERTIFICATE_COUNT ] = { 891, 914, 1452 };
+
+static uint8_t ucBuffer[ sizeof( TEST_TRUST_BUNDLE_PEM ) ];
+static uint32_t ulBundleLength;
+
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvConvert( const char * pcPem,
+                                    uint32_t ulPemLength )
+{
+    memcpy( ucBuffer, pcPem, ulPemLength );
+
+    return AzureIoTCARecovery_ConvertTrustBundle( ucBuffer, sizeof( ucBuffer ), ulPemLength, &ulBundleLength );
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestConvert( void )
+{
+    TlsTrustBundleEntry_t xEntry;
+    uint32_t ulDerLength = 0;
+    uint32_t ulIndex;
+
+    printf( "Converting a PEM trust bundle\n" );
+
+    if( prvConvert( TEST_TRUST_BUNDLE_PEM, sizeof( TEST_TRUST_BUNDLE_PEM ) - 1 ) != eAzureIoTSuccess )
+    {
+        printf( "\tFailed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    printf( "\t%u bytes of PEM, %u bytes of bundle\n",
+            ( unsigned ) ( sizeof( TEST_TRUST_BUNDLE_PEM ) - 1 ), ( unsigned ) ulBundleLength );
+
+    if( TLS_TrustBundle_GetCount( ucBuffer, ulBundleLength ) != TEST_CERTIFICATE_COUNT )
+    {
+        printf( "\tCount Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    for( ulIndex = 0; ulIndex < TEST_CERTIFICATE_COUNT; ulIndex++ )
+    {
+        TLS_TrustBundle_GetEntry( ucBuffer, ulIndex, &xEntry );
+
+        if( ( xEntry.ulCertificateLength != ulTestCertificateLengths[ ulIndex ] ) ||
+            ( xEntry.pucCertificate != ucBuffer + transporttlsTRUST_BUNDLE_INDEX_SIZE( TEST_CERTIFICATE_COUNT ) + ulDerLength ) ||
+            ( xEntry.pucCertificate[ 0 ] != 0x30 ) )
+        {
+            printf( "\tEntry %u Failed!\n", ( unsigned ) ulIndex );
+            return TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        ulDerLength += xEntry.ulCertificateLength;
+    }
+
+    /* The index costs less than the base64 saves. */
+    if( ( ulBundleLength != transporttlsTRUST_BUNDLE_INDEX_SIZE( TEST_CERTIFICATE_COUNT ) + ulDerLength ) ||
+        ( ulBundleLength > ( ( sizeof( TEST_TRUST_BUNDLE_PEM ) - 1 ) * 3U ) / 4U ) )
+    {
+        printf( "\tLength Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    return TEST_TRUST_BUNDLE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestSubjectHash( void )
+{
+    TlsTrustBundleEntry_t xEntry;
+    TlsTrustBundleEntry_t xPreviousEntry;
+    mbedtls_x509_crt xCertificate;
+    uint8_t ucHash[ transporttlsTRUST_BUNDLE_HASH_SIZE ];
+    uint32_t ulIndex;
+    int lResult = TEST_TRUST_BUNDLE_SUCCESS;
+
+    printf( "Checking the subject hashes\n" );
+
+    for( ulIndex = 0; ( ulIndex < TEST_CERTIFICATE_COUNT ) && ( lResult == TEST_TRUST_BUNDLE_SUCCESS ); ulIndex++ )
+    {
+        TLS_TrustBundle_GetEntry( ucBuffer, ulIndex, &xEntry );
+        mbedtls_x509_crt_init( &xCertificate );
+
+        if( ( mbedtls_x509_crt_parse_der( &xCertificate, xEntry.pucCertificate, xEntry.ulCertificateLength ) != 0 ) ||
+            ( TLS_TrustBundle_HashSubject( xCertificate.subject_raw.p, xCertificate.subject_raw.len, ucHash ) != 0 ) ||
+            ( memcmp( ucHash, xEntry.pucSubjectHash, sizeof( ucHash ) ) != 0 ) ||
+            ( ( ulIndex > 0U ) && ( memcmp( xPreviousEntry.pucSubjectHash, xEntry.pucSubjectHash, sizeof( ucHash ) ) == 0 ) ) )
+        {
+            printf( "\tHash %u Failed!\n", ( unsigned ) ulIndex );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        mbedtls_x509_crt_free( &xCertificate );
+        xPreviousEntry = xEntry;
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestLoad( void )
+{
+    mbedtls_x509_crt xPemChain;
+    mbedtls_x509_crt xBundleChain;
+    mbedtls_x509_crt * pxPem;
+    mbedtls_x509_crt * pxBundle;
+    uint32_t ulCount = 0;
+    int lResult = TEST_TRUST_BUNDLE_SUCCESS;
+
+    printf( "Loading the bundle as the PEM loads\n" );
+
+    mbedtls_x509_crt_init( &xPemChain );
+    mbedtls_x509_crt_init( &xBundleChain );
+
+    if( ( mbedtls_x509_crt_parse( &xPemChain, ( const unsigned char * ) TEST_TRUST_BUNDLE_PEM, sizeof( TEST_TRUST_BUNDLE_PEM ) ) != 0 ) ||
+        ( TLS_TrustBundle_Parse( &xBundleChain, ucBuffer, ulBundleLength ) != 0 ) )
+    {
+        printf( "\tParse Failed!\n" );
+        lResult = TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    for( pxPem = &xPemChain, pxBundle = &xBundleChain;
+         ( lResult == TEST_TRUST_BUNDLE_SUCCESS ) && ( pxPem != NULL ) && ( pxBundle != NULL );
+         pxPem = pxPem->next, pxBundle = pxBundle->next )
+    {
+        if( ( pxPem->raw.len != pxBundle->raw.len ) ||
+            ( memcmp( pxPem->raw.p, pxBundle->raw.p, pxPem->raw.len ) != 0 ) )
+        {
+            printf( "\tCertificate %u Failed!\n", ( unsigned ) ulCount );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        ulCount++;
+    }
+
+    if( ( lResult == TEST_TRUST_BUNDLE_SUCCESS ) &&
+        ( ( pxPem != NULL ) || ( pxBundle != NULL ) || ( ulCount != TEST_CERTIFICATE_COUNT ) ) )
+    {
+        printf( "\tChain Length Failed!\n" );
+        lResult = TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    mbedtls_x509_crt_free( &xPemChain );
+    mbedtls_x509_crt_free( &xBundleChain );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+static int prvTestFind( void )
+{
+    static const uint8_t ucUnknownSubject[] = { 0x30, 0x02, 0x31, 0x00 };
+    TlsTrustBundle_t xTrustBundle;
+    TlsTrustBundleEntry_t xEntry;
+    mbedtls_x509_crt xCertificate;
+    mbedtls_x509_crt xFound;
+    uint32_t ulFound;
+    uint32_t ulIndex;
+    int lResult = TEST_TRUST_BUNDLE_SUCCESS;
+
+    printf( "Looking the certificates up by subject\n" );
+
+    xTrustBundle.pucBundle = ucBuffer;
+    xTrustBundle.ulCount = TLS_TrustBundle_GetCount( ucBuffer, ulBundleLength );
+
+    for( ulIndex = 0; ( ulIndex < TEST_CERTIFICATE_COUNT ) && ( lResult == TEST_TRUST_BUNDLE_SUCCESS ); ulIndex++ )
+    {
+        TLS_TrustBundle_GetEntry( ucBuffer, ulIndex, &xEntry );
+        mbedtls_x509_crt_init( &xCertificate );
+        mbedtls_x509_crt_init( &xFound );
+
+        if( ( mbedtls_x509_crt_parse_der( &xCertificate, xEntry.pucCertificate, xEntry.ulCertificateLength ) != 0 ) ||
+            ( TLS_TrustBundle_Find( &xFound, &xTrustBundle, xCertificate.subject_raw.p, xCertificate.subject_raw.len, &ulFound ) != 0 ) ||
+            ( ulFound != 1U ) ||
+            ( xFound.raw.len != xEntry.ulCertificateLength ) ||
+            ( memcmp( xFound.raw.p, xEntry.pucCertificate, xEntry.ulCertificateLength ) != 0 ) )
+        {
+            printf( "\tFind %u Failed!\n", ( unsigned ) ulIndex );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        mbedtls_x509_crt_free( &xCertificate );
+        mbedtls_x509_crt_free( &xFound );
+    }
+
+    if( lResult == TEST_TRUST_BUNDLE_SUCCESS )
+    {
+        mbedtls_x509_crt_init( &xFound );
+
+        if( ( TLS_TrustBundle_Find( &xFound, &xTrustBundle, ucUnknownSubject, sizeof( ucUnknownSubject ), &ulFound ) != 0 ) ||
+            ( ulFound != 0U ) )
+        {
+            printf( "\tUnknown Subject Failed!\n" );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        mbedtls_x509_crt_free( &xFound );
+    }
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+#if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+
+    static int prvTestCaCallback( void )
+    {
+        TlsTrustBundle_t xTrustBundle;
+        TlsTrustBundleEntry_t xEntry;
+        mbedtls_x509_crt xCertificate;
+        mbedtls_x509_crt * pxCandidates = NULL;
+        int lResult = TEST_TRUST_BUNDLE_SUCCESS;
+
+        printf( "Looking the issuer of a certificate up by the CA callback\n" );
+
+        xTrustBundle.pucBundle = ucBuffer;
+        xTrustBundle.ulCount = TLS_TrustBundle_GetCount( ucBuffer, ulBundleLength );
+
+        /* The roots are self signed, each is its own issuer. */
+        TLS_TrustBundle_GetEntry( ucBuffer, TEST_CERTIFICATE_COUNT - 1U, &xEntry );
+        mbedtls_x509_crt_init( &xCertificate );
+
+        if( ( mbedtls_x509_crt_parse_der( &xCertificate, xEntry.pucCertificate, xEntry.ulCertificateLength ) != 0 ) ||
+            ( TLS_TrustBundle_CaCallback( &xTrustBundle, &xCertificate, &pxCandidates ) != 0 ) ||
+            ( pxCandidates == NULL ) ||
+            ( pxCandidates->next != NULL ) ||
+            ( pxCandidates->raw.len != xEntry.ulCertificateLength ) )
+        {
+            printf( "\tCandidates Failed!\n" );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        if( pxCandidates != NULL )
+        {
+            mbedtls_x509_crt_free( pxCandidates );
+            mbedtls_free( pxCandidates );
+            pxCandidates = NULL;
+        }
+
+        /* A bundle without the issuer has no candidate. */
+        xTrustBundle.ulCount = TEST_CERTIFICATE_COUNT - 1U;
+
+        if( ( lResult == TEST_TRUST_BUNDLE_SUCCESS ) &&
+            ( ( TLS_TrustBundle_CaCallback( &xTrustBundle, &xCertificate, &pxCandidates ) != 0 ) ||
+              ( pxCandidates != NULL ) ) )
+        {
+            printf( "\tNo Candidate Failed!\n" );
+            lResult = TEST_TRUST_BUNDLE_FAIL;
+        }
+
+        mbedtls_x509_crt_free( &xCertificate );
+
+        return lResult;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+
+static int prvTestInvalid( void )
+{
+    char cPem[ sizeof( TEST_TRUST_BUNDLE_PEM ) ];
+
+    printf( "Rejecting invalid bundles\n" );
+
+    /* A PEM or a truncated bundle is not taken for a bundle. */
+    if( ( TLS_TrustBundle_GetCount( ( const uint8_t * ) TEST_TRUST_BUNDLE_PEM, sizeof( TEST_TRUST_BUNDLE_PEM ) - 1 ) != 0U ) ||
+        ( TLS_TrustBundle_GetCount( ucBuffer, ulBundleLength - 1U ) != 0U ) ||
+        ( TLS_TrustBundle_GetCount( ucBuffer, transporttlsTRUST_BUNDLE_INDEX_SIZE( TEST_CERTIFICATE_COUNT ) - 1U ) != 0U ) )
+    {
+        printf( "\tCount Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    /* The last certificate is not terminated. */
+    if( prvConvert( TEST_TRUST_BUNDLE_PEM, sizeof( TEST_TRUST_BUNDLE_PEM ) - 10 ) == eAzureIoTSuccess )
+    {
+        printf( "\tTruncated PEM Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    memcpy( cPem, TEST_TRUST_BUNDLE_PEM, sizeof( cPem ) );
+    cPem[ 100 ] = '*';
+
+    if( prvConvert( cPem, sizeof( cPem ) - 1 ) == eAzureIoTSuccess )
+    {
+        printf( "\tInvalid Base64 Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    if( ( prvConvert( TEST_INVALID_CERTIFICATE_PEM, sizeof( TEST_INVALID_CERTIFICATE_PEM ) - 1 ) == eAzureIoTSuccess ) ||
+        ( prvConvert( "no certificate", sizeof( "no certificate" ) - 1 ) == eAzureIoTSuccess ) )
+    {
+        printf( "\tInvalid Certificate Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    if( AzureIoTCARecovery_ConvertTrustBundle( ucBuffer, 10, 20, &ulBundleLength ) != eAzureIoTErrorInvalidArgument )
+    {
+        printf( "\tBuffer Length Failed!\n" );
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    return TEST_TRUST_BUNDLE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
+
+int vStartTestTask( void )
+{
+    if( ( prvTestConvert() != TEST_TRUST_BUNDLE_SUCCESS ) ||
+        ( prvTestSubjectHash() != TEST_TRUST_BUNDLE_SUCCESS ) ||
+        ( prvTestLoad() != TEST_TRUST_BUNDLE_SUCCESS ) ||
+        ( prvTestFind() != TEST_TRUST_BUNDLE_SUCCESS ) ||
+        #if defined( MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK )
+            ( prvTestCaCallback() != TEST_TRUST_BUNDLE_SUCCESS ) ||
+        #endif
+        ( prvTestInvalid() != TEST_TRUST_BUNDLE_SUCCESS ) )
+    {
+        return TEST_TRUST_BUNDLE_FAIL;
+    }
+
+    return TEST_TRUST_BUNDLE_SUCCESS;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,129 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Packs a firmware image into a compressed ADU payload.
+ *
+ * Usage: adu_compress [-w window_bits] [-l lookahead_bits] <image> <payload>
+ *
+ * The window of the payload must not be larger than the heatshrinkMAX_WINDOW_BITS
+ * of the device. The payload is imported into ADU in place of the image, the
+ * device writes the image it decompresses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adu_image_compress.h"
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvReadFile( const char * pcPath,
+                              size_t * pxLength )
+{
+    FILE * pxFile = fopen( pcPath, "rb" );
+    uint8_t * pucData = NULL;
+    long lLength;
+
+    if( pxFile == NULL )
+    {
+        return NULL;
+    }
+
+    if( ( fseek( pxFile, 0, SEEK_END ) == 0 ) && ( ( lLength = ftell( pxFile ) ) >= 0 ) &&
+        ( fseek( pxFile, 0, SEEK_SET ) == 0 ) &&
+        ( ( pucData = malloc( ( size_t ) lLength + 1U ) ) != NULL ) &&
+        ( fread( pucData, 1, ( size_t ) lLength, pxFile ) == ( size_t ) lLength ) )
+    {
+        *pxLength = ( size_t ) lLength;
+    }
+    else
+    {
+        free( pucData );
+        pucData = NULL;
+    }
+
+    ( void ) fclose( pxFile );
+
+    return pucData;
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    unsigned long ulWindowBits = aduimagecompressDEFAULT_WINDOW_BITS;
+    unsigned long ulLookaheadBits = aduimagecompressDEFAULT_LOOKAHEAD_BITS;
+    const char * pcImagePath = NULL;
+    const char * pcPayloadPath = NULL;
+    uint8_t * pucImage;
+    uint8_t * pucPayload;
+    size_t xImageLength = 0;
+    size_t xPayloadLength = 0;
+    char cHash[ 45 ];
+    FILE * pxFile;
+    int lArg;
+
+    for( lArg = 1; lArg < argc; lArg++ )
+    {
+        if( ( strcmp( argv[ lArg ], "-w" ) == 0 ) && ( lArg + 1 < argc ) )
+        {
+            ulWindowBits = strtoul( argv[ ++lArg ], NULL, 10 );
+        }
+        else if( ( strcmp( argv[ lArg ], "-l" ) == 0 ) && ( lArg + 1 < argc ) )
+        {
+            ulLookaheadBits = strtoul( argv[ ++lArg ], NULL, 10 );
+        }
+        else if( pcImagePath == NULL )
+        {
+            pcImagePath = argv[ lArg ];
+        }
+        else
+        {
+            pcPayloadPath = argv[ lArg ];
+        }
+    }
+
+    if( ( pcImagePath == NULL ) || ( pcPayloadPath == NULL ) || ( ulWindowBits > 15U ) || ( ulLookaheadBits > 15U ) )
+    {
+        fprintf( stderr, "Usage: %s [-w window_bits] [-l lookahead_bits] <image> <payload>\n", argv[ 0 ] );
+        return 1;
+    }
+
+    if( ( pucImage = prvReadFile( pcImagePath, &xImageLength ) ) == NULL )
+    {
+        fprintf( stderr, "Unable to read %s\n", pcImagePath );
+        return 1;
+    }
+
+    pucPayload = malloc( aduimagecompressMAX_PAYLOAD_SIZE( xImageLength ) );
+
+    if( ( pucPayload == NULL ) ||
+        ( ADUImageCompress_Pack( pucImage, xImageLength, ( uint8_t ) ulWindowBits, ( uint8_t ) ulLookaheadBits,
+                                 pucPayload, aduimagecompressMAX_PAYLOAD_SIZE( xImageLength ), &xPayloadLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( pucPayload, xPayloadLength, cHash ) != 0 ) )
+    {
+        fprintf( stderr, "Unable to compress %s with a window of %lu bits and a lookahead of %lu bits\n",
+                 pcImagePath, ulWindowBits, ulLookaheadBits );
+        return 1;
+    }
+
+    if( ( ( pxFile = fopen( pcPayloadPath, "wb" ) ) == NULL ) ||
+        ( fwrite( pucPayload, 1, xPayloadLength, pxFile ) != xPayloadLength ) ||
+        ( fclose( pxFile ) != 0 ) )
+    {
+        fprintf( stderr, "Unable to write %s\n", pcPayloadPath );
+        return 1;
+    }
+
+    printf( "%s: %zu bytes, %s: %zu bytes (%.1f%%), SHA-256 %s\n",
+            pcImagePath, xImageLength, pcPayloadPath, xPayloadLength,
+            xImageLength == 0 ? 0.0 : ( 100.0 * ( double ) xPayloadLength ) / ( double ) xImageLength, cHash );
+
+    free( pucImage );
+    free( pucPayload );
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,134 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Creates the delta ADU payload updating the image a device runs to a new
+ * image.
+ *
+ * Usage: adu_delta [-w window_bits] [-l lookahead_bits] <running image> <new image> <payload>
+ *
+ * A window of 0 bits leaves the patch uncompressed. The payload only applies
+ * to the running image it was created from, the device rebuilds the new image
+ * and verifies it against its hash from the payload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adu_image_compress.h"
+#include "adu_image_delta.h"
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvReadFile( const char * pcPath,
+                              size_t * pxLength )
+{
+    FILE * pxFile = fopen( pcPath, "rb" );
+    uint8_t * pucData = NULL;
+    long lLength;
+
+    if( pxFile == NULL )
+    {
+        return NULL;
+    }
+
+    if( ( fseek( pxFile, 0, SEEK_END ) == 0 ) && ( ( lLength = ftell( pxFile ) ) >= 0 ) &&
+        ( fseek( pxFile, 0, SEEK_SET ) == 0 ) &&
+        ( ( pucData = malloc( ( size_t ) lLength + 1U ) ) != NULL ) &&
+        ( fread( pucData, 1, ( size_t ) lLength, pxFile ) == ( size_t ) lLength ) )
+    {
+        *pxLength = ( size_t ) lLength;
+    }
+    else
+    {
+        free( pucData );
+        pucData = NULL;
+    }
+
+    ( void ) fclose( pxFile );
+
+    return pucData;
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    unsigned long ulWindowBits = aduimagecompressDEFAULT_WINDOW_BITS;
+    unsigned long ulLookaheadBits = aduimagedeltaDEFAULT_LOOKAHEAD_BITS;
+    const char * pcPaths[ 3 ] = { NULL, NULL, NULL };
+    uint8_t * pucSource;
+    uint8_t * pucImage;
+    uint8_t * pucPayload = NULL;
+    size_t xSourceLength = 0;
+    size_t xImageLength = 0;
+    size_t xPayloadLength = 0;
+    char cHash[ 45 ];
+    FILE * pxFile;
+    int lArg;
+    int lPath = 0;
+
+    for( lArg = 1; lArg < argc; lArg++ )
+    {
+        if( ( strcmp( argv[ lArg ], "-w" ) == 0 ) && ( lArg + 1 < argc ) )
+        {
+            ulWindowBits = strtoul( argv[ ++lArg ], NULL, 10 );
+        }
+        else if( ( strcmp( argv[ lArg ], "-l" ) == 0 ) && ( lArg + 1 < argc ) )
+        {
+            ulLookaheadBits = strtoul( argv[ ++lArg ], NULL, 10 );
+        }
+        else if( lPath < 3 )
+        {
+            pcPaths[ lPath++ ] = argv[ lArg ];
+        }
+    }
+
+    if( ( lPath != 3 ) || ( ulWindowBits > 15U ) || ( ulLookaheadBits > 15U ) )
+    {
+        fprintf( stderr, "Usage: %s [-w window_bits] [-l lookahead_bits] <running image> <new image> <payload>\n", argv[ 0 ] );
+        return 1;
+    }
+
+    if( ( pucSource = prvReadFile( pcPaths[ 0 ], &xSourceLength ) ) == NULL )
+    {
+        fprintf( stderr, "Unable to read %s\n", pcPaths[ 0 ] );
+        return 1;
+    }
+
+    if( ( pucImage = prvReadFile( pcPaths[ 1 ], &xImageLength ) ) == NULL )
+    {
+        fprintf( stderr, "Unable to read %s\n", pcPaths[ 1 ] );
+        return 1;
+    }
+
+    if( ( ADUImageDelta_Create( pucSource, xSourceLength, pucImage, xImageLength,
+                                ( uint8_t ) ulWindowBits, ( uint8_t ) ulLookaheadBits,
+                                &pucPayload, &xPayloadLength ) != 0 ) ||
+        ( ADUImageCompress_HashBase64( pucPayload, xPayloadLength, cHash ) != 0 ) )
+    {
+        fprintf( stderr, "Unable to create the delta from %s to %s with a window of %lu bits and a lookahead of %lu bits\n",
+                 pcPaths[ 0 ], pcPaths[ 1 ], ulWindowBits, ulLookaheadBits );
+        return 1;
+    }
+
+    if( ( ( pxFile = fopen( pcPaths[ 2 ], "wb" ) ) == NULL ) ||
+        ( fwrite( pucPayload, 1, xPayloadLength, pxFile ) != xPayloadLength ) ||
+        ( fclose( pxFile ) != 0 ) )
+    {
+        fprintf( stderr, "Unable to write %s\n", pcPaths[ 2 ] );
+        return 1;
+    }
+
+    printf( "%s: %zu bytes, %s: %zu bytes (%.1f%%), SHA-256 %s\n",
+            pcPaths[ 1 ], xImageLength, pcPaths[ 2 ], xPayloadLength,
+            xImageLength == 0 ? 0.0 : ( 100.0 * ( double ) xPayloadLength ) / ( double ) xImageLength, cHash );
+
+    free( pucSource );
+    free( pucImage );
+    free( pucPayload );
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,252 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file adu_image_compress.c
+ * @brief Implements the host side of the compressed ADU payloads.
+ *
+ * The encoder is greedy: at each position it takes the longest match of the
+ * window found through hash chains of 3 bytes, when the reference is shorter
+ * than the literals it replaces.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbedtls/base64.h"
+#include "mbedtls/md.h"
+
+#include "adu_image_compress.h"
+
+#define aduimagecompressHASH_BITS       ( 15U )
+#define aduimagecompressMAX_CHAIN       ( 256U )
+#define aduimagecompressMIN_MATCH       ( 3U )
+
+/**
+ * @brief Header of a payload, see sample_azure_iot_adu_compressed.h.
+ */
+#define aduimagecompressMAGIC           "AZHS"
+#define aduimagecompressVERSION         ( 1U )
+#define aduimagecompressHEADER_SIZE     ( 56U )
+
+/**
+ * @brief Bits written to the output of the encoder.
+ */
+typedef struct BitWriter
+{
+    uint8_t * pucOutput;
+    size_t xSize;
+    size_t xLength;
+    uint8_t ucBits; /**< Bits used in the last byte, 0 when it is full. */
+    int lOverflow;
+} BitWriter_t;
+
+/*-----------------------------------------------------------*/
+
+static void prvWriteBits( BitWriter_t * pxWriter,
+                          uint32_t ulValue,
+                          uint8_t ucCount )
+{
+    while( ucCount-- > 0U )
+    {
+        if( pxWriter->ucBits == 0U )
+        {
+            if( pxWriter->xLength == pxWriter->xSize )
+            {
+                pxWriter->lOverflow = 1;
+                return;
+            }
+
+            pxWriter->pucOutput[ pxWriter->xLength++ ] = 0;
+        }
+
+        if( ( ulValue >> ucCount ) & 1U )
+        {
+            pxWriter->pucOutput[ pxWriter->xLength - 1U ] |= ( uint8_t ) ( 0x80U >> pxWriter->ucBits );
+        }
+
+        pxWriter->ucBits = ( uint8_t ) ( ( pxWriter->ucBits + 1U ) & 7U );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHash( const uint8_t * pucData )
+{
+    uint32_t ulValue = ( ( uint32_t ) pucData[ 0 ] << 16 ) | ( ( uint32_t ) pucData[ 1 ] << 8 ) | pucData[ 2 ];
+
+    return ( ulValue * 2654435761U ) >> ( 32U - aduimagecompressHASH_BITS );
+}
+/*-----------------------------------------------------------*/
+
+int ADUImageCompress_Encode( const uint8_t * pucInput,
+                             size_t xInputLength,
+                             uint8_t ucWindowBits,
+                             uint8_t ucLookaheadBits,
+                             uint8_t * pucOutput,
+                             size_t xOutputSize,
+                             size_t * pxOutputLength )
+{
+    BitWriter_t xWriter = { pucOutput, xOutputSize, 0, 0, 0 };
+    const size_t xWindowSize = ( size_t ) 1 << ucWindowBits;
+    const size_t xMaxMatch = ( size_t ) 1 << ucLookaheadBits;
+    int32_t * plHeads;
+    int32_t * plPrevious;
+    size_t xPosition = 0;
+    size_t xBestLength;
+    size_t xBestDistance;
+    size_t xLength;
+    size_t xLimit;
+    int32_t lCandidate;
+    uint32_t ulChain;
+    size_t xIndex;
+
+    if( ( pucInput == NULL ) || ( pucOutput == NULL ) || ( pxOutputLength == NULL ) ||
+        ( ucWindowBits < 4U ) || ( ucWindowBits > 15U ) ||
+        ( ucLookaheadBits < 3U ) || ( ucLookaheadBits >= ucWindowBits ) )
+    {
+        return -1;
+    }
+
+    plHeads = malloc( sizeof( int32_t ) << aduimagecompressHASH_BITS );
+    plPrevious = malloc( sizeof( int32_t ) * ( xInputLength + 1U ) );
+
+    if( ( plHeads == NULL ) || ( plPrevious == NULL ) )
+    {
+        free( plHeads );
+        free( plPrevious );
+        return -1;
+    }
+
+    for( xIndex = 0; xIndex < ( ( size_t ) 1 << aduimagecompressHASH_BITS ); xIndex++ )
+    {
+        plHeads[ xIndex ] = -1;
+    }
+
+    while( xPosition < xInputLength )
+    {
+        xBestLength = 0;
+        xBestDistance = 0;
+        xLimit = ( xInputLength - xPosition < xMaxMatch ) ? xInputLength - xPosition : xMaxMatch;
+
+        if( xLimit >= aduimagecompressMIN_MATCH )
+        {
+            lCandidate = plHeads[ prvHash( &pucInput[ xPosition ] ) ];
+
+            for( ulChain = 0;
+                 ( lCandidate >= 0 ) && ( ulChain < aduimagecompressMAX_CHAIN ) &&
+                 ( xPosition - ( size_t ) lCandidate <= xWindowSize );
+                 ulChain++, lCandidate = plPrevious[ lCandidate ] )
+            {
+                for( xLength = 0;
+                     ( xLength < xLimit ) && ( pucInput[ ( size_t ) lCandidate + xLength ] == pucInput[ xPosition + xLength ] );
+                     xLength++ )
+                {
+                }
+
+                if( xLength > xBestLength )
+                {
+                    xBestLength = xLength;
+                    xBestDistance = xPosition - ( size_t ) lCandidate;
+
+                    if( xLength == xLimit )
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+
+        /* A reference costs 1 + window + lookahead bits, a literal 9. */
+        if( ( xBestLength * 9U ) > ( 1U + ucWindowBits + ucLookaheadBits ) )
+        {
+            prvWriteBits( &xWriter, 0, 1 );
+            prvWriteBits( &xWriter, ( uint32_t ) ( xBestDistance - 1U ), ucWindowBits );
+            prvWriteBits( &xWriter, ( uint32_t ) ( xBestLength - 1U ), ucLookaheadBits );
+        }
+        else
+        {
+            xBestLength = 1;
+            prvWriteBits( &xWriter, 1, 1 );
+            prvWriteBits( &xWriter, pucInput[ xPosition ], 8 );
+        }
+
+        /* Index every position covered. */
+        for( xIndex = 0; xIndex < xBestLength; xIndex++, xPosition++ )
+        {
+            if( xInputLength - xPosition >= aduimagecompressMIN_MATCH )
+            {
+                uint32_t ulHash = prvHash( &pucInput[ xPosition ] );
+
+                plPrevious[ xPosition ] = plHeads[ ulHash ];
+                plHeads[ ulHash ] = ( int32_t ) xPosition;
+            }
+        }
+    }
+
+    free( plHeads );
+    free( plPrevious );
+
+    *pxOutputLength = xWriter.xLength;
+
+    return xWriter.lOverflow ? -1 : 0;
+}
+/*-----------------------------------------------------------*/
+
+int ADUImageCompress_HashBase64( const uint8_t * pucData,
+                                 size_t xLength,
+                                 char pcHash[ 45 ] )
+{
+    uint8_t ucHash[ 32 ];
+    size_t xHashLength;
+
+    if( ( mbedtls_md( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), pucData, xLength, ucHash ) != 0 ) ||
+        ( mbedtls_base64_encode( ( unsigned char * ) pcHash, 45, &xHashLength, ucHash, sizeof( ucHash ) ) != 0 ) )
+    {
+        return -1;
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+int ADUImageCompress_Pack( const uint8_t * pucImage,
+                           size_t xImageLength,
+                           uint8_t ucWindowBits,
+                           uint8_t ucLookaheadBits,
+                           uint8_t * pucPayload,
+                           size_t xPayloadSize,
+                           size_t * pxPayloadLength )
+{
+    char cImageHash[ 45 ];
+    size_t xStreamLength;
+
+    if( ( pucPayload == NULL ) || ( pxPayloadLength == NULL ) ||
+        ( xPayloadSize < aduimagecompressHEADER_SIZE ) || ( xImageLength > UINT32_MAX ) ||
+        ( ADUImageCompress_HashBase64( pucImage, xImageLength, cImageHash ) != 0 ) )
+    {
+        return -1;
+    }
+
+    ( void ) memcpy( pucPayload, aduimagecompressMAGIC, 4 );
+    pucPayload[ 4 ] = aduimagecompressVERSION;
+    pucPayload[ 5 ] = ucWindowBits;
+    pucPayload[ 6 ] = ucLookaheadBits;
+    pucPayload[ 7 ] = 0;
+    pucPayload[ 8 ] = ( uint8_t ) xImageLength;
+    pucPayload[ 9 ] = ( uint8_t ) ( xImageLength >> 8 );
+    pucPayload[ 10 ] = ( uint8_t ) ( xImageLength >> 16 );
+    pucPayload[ 11 ] = ( uint8_t ) ( xImageLength >> 24 );
+    ( void ) memcpy( &pucPayload[ 12 ], cImageHash, 44 );
+
+    if( ADUImageCompress_Encode( pucImage, xImageLength, ucWindowBits, ucLookaheadBits,
+                                 &pucPayload[ aduimagecompressHEADER_SIZE ],
+                                 xPayloadSize - aduimagecompressHEADER_SIZE, &xStreamLength ) != 0 )
+    {
+        return -1;
+    }
+
+    *pxPayloadLength = aduimagecompressHEADER_SIZE + xStreamLength;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,86 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file adu_image_compress.h
+ * @brief Host side of the compressed ADU payloads: a heatshrink encoder and
+ * the packing of an image into the payload of
+ * sample_azure_iot_adu_compressed.h.
+ */
+
+#ifndef ADU_IMAGE_COMPRESS_H
+#define ADU_IMAGE_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Window of the payloads, in bits, when not given.
+ */
+#define aduimagecompressDEFAULT_WINDOW_BITS       ( 11U )
+
+/**
+ * @brief Lookahead of the payloads, in bits, when not given.
+ */
+#define aduimagecompressDEFAULT_LOOKAHEAD_BITS    ( 4U )
+
+/**
+ * @brief Largest payload of an image, for the sizing of the output buffer.
+ */
+#define aduimagecompressMAX_PAYLOAD_SIZE( ulImageSize )    ( 56U + ( ( ulImageSize ) * 9U + 7U ) / 8U + 1U )
+
+/**
+ * @brief Compress data in the heatshrink format.
+ *
+ * @param[in] pucInput Data to compress.
+ * @param[in] xInputLength Length of the data.
+ * @param[in] ucWindowBits Window, from 4 to 15 bits.
+ * @param[in] ucLookaheadBits Lookahead, from 3 to ucWindowBits - 1 bits.
+ * @param[out] pucOutput Buffer for the stream.
+ * @param[in] xOutputSize Size of the buffer.
+ * @param[out] pxOutputLength Length of the stream.
+ * @return 0 on success, -1 on invalid parameters or a buffer too small.
+ */
+int ADUImageCompress_Encode( const uint8_t * pucInput,
+                             size_t xInputLength,
+                             uint8_t ucWindowBits,
+                             uint8_t ucLookaheadBits,
+                             uint8_t * pucOutput,
+                             size_t xOutputSize,
+                             size_t * pxOutputLength );
+
+/**
+ * @brief Pack an image into a compressed ADU payload: the header, with the
+ * size and the hash of the image, then the compressed image.
+ *
+ * @param[in] pucImage The image.
+ * @param[in] xImageLength Length of the image.
+ * @param[in] ucWindowBits Window, from 4 to 15 bits.
+ * @param[in] ucLookaheadBits Lookahead, from 3 to ucWindowBits - 1 bits.
+ * @param[out] pucPayload Buffer for the payload, of at least
+ * aduimagecompressMAX_PAYLOAD_SIZE( xImageLength ) bytes.
+ * @param[in] xPayloadSize Size of the buffer.
+ * @param[out] pxPayloadLength Length of the payload.
+ * @return 0 on success, -1 otherwise.
+ */
+int ADUImageCompress_Pack( const uint8_t * pucImage,
+                           size_t xImageLength,
+                           uint8_t ucWindowBits,
+                           uint8_t ucLookaheadBits,
+                           uint8_t * pucPayload,
+                           size_t xPayloadSize,
+                           size_t * pxPayloadLength );
+
+/**
+ * @brief Base64 encoded SHA-256 of data, as the ADU manifests carry it.
+ *
+ * @param[in] pucData The data.
+ * @param[in] xLength Length of the data.
+ * @param[out] pcHash Buffer for the hash and its terminator, 45 bytes.
+ * @return 0 on success, -1 otherwise.
+ */
+int ADUImageCompress_HashBase64( const uint8_t * pucData,
+                                 size_t xLength,
+                                 char pcHash[ 45 ] );
+
+#endif /* ADU_IMAGE_COMPRESS_H */
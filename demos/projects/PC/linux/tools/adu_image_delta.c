@@ -0,0 +1,351 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file adu_image_delta.c
+ * @brief Implements the host side of the delta ADU payloads.
+ *
+ * The new image is scanned for exact matches of at least
+ * aduimagedeltaMIN_MATCH bytes in the running image, found through hash
+ * chains. Each match is extended forward while most bytes still match, as
+ * relocated code differs from the running image in a few bytes of each
+ * instruction, and becomes the diff of a record; the bytes up to the next
+ * match are its extra bytes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "adu_image_compress.h"
+#include "adu_image_delta.h"
+
+#define aduimagedeltaHASH_BITS          ( 18U )
+#define aduimagedeltaMAX_CHAIN          ( 64U )
+#define aduimagedeltaMIN_MATCH          ( 8U )
+
+/* A diff is extended while at least aduimagedeltaEXTEND_MATCHES of the last
+ * aduimagedeltaEXTEND_WINDOW bytes match. */
+#define aduimagedeltaEXTEND_WINDOW      ( 16U )
+#define aduimagedeltaEXTEND_MATCHES     ( 8U )
+
+/**
+ * @brief Header of a payload, see sample_azure_iot_adu_delta.h.
+ */
+#define aduimagedeltaMAGIC              "AZDP"
+#define aduimagedeltaVERSION            ( 1U )
+#define aduimagedeltaHEADER_SIZE        ( 104U )
+#define aduimagedeltaCONTROL_SIZE       ( 12U )
+
+/**
+ * @brief Patch being built.
+ */
+typedef struct Patch
+{
+    uint8_t * pucData;
+    size_t xLength;
+    size_t xSize;
+} Patch_t;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHash( const uint8_t * pucData )
+{
+    uint64_t ullValue;
+
+    ( void ) memcpy( &ullValue, pucData, sizeof( ullValue ) );
+
+    return ( uint32_t ) ( ( ullValue * 0x9E3779B97F4A7C15ULL ) >> ( 64U - aduimagedeltaHASH_BITS ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteLittleEndian32( uint8_t * pucData,
+                                    uint32_t ulValue )
+{
+    pucData[ 0 ] = ( uint8_t ) ulValue;
+    pucData[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucData[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucData[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+/*-----------------------------------------------------------*/
+
+/* Appends a record: the diff of the new image against the running image at
+ * xSourceOffset, then the extra bytes. */
+static int prvAppendRecord( Patch_t * pxPatch,
+                            const uint8_t * pucSource,
+                            size_t xSourceOffset,
+                            const uint8_t * pucImage,
+                            size_t xDiffLength,
+                            size_t xExtraLength,
+                            int64_t llAdjustment )
+{
+    size_t xIndex;
+    uint8_t * pucRecord;
+
+    if( pxPatch->xSize - pxPatch->xLength < aduimagedeltaCONTROL_SIZE + xDiffLength + xExtraLength )
+    {
+        return -1;
+    }
+
+    pucRecord = &pxPatch->pucData[ pxPatch->xLength ];
+    prvWriteLittleEndian32( &pucRecord[ 0 ], ( uint32_t ) xDiffLength );
+    prvWriteLittleEndian32( &pucRecord[ 4 ], ( uint32_t ) xExtraLength );
+    prvWriteLittleEndian32( &pucRecord[ 8 ], ( uint32_t ) ( int32_t ) llAdjustment );
+    pucRecord += aduimagedeltaCONTROL_SIZE;
+
+    for( xIndex = 0; xIndex < xDiffLength; xIndex++ )
+    {
+        pucRecord[ xIndex ] = ( uint8_t ) ( pucImage[ xIndex ] - pucSource[ xSourceOffset + xIndex ] );
+    }
+
+    ( void ) memcpy( &pucRecord[ xDiffLength ], &pucImage[ xDiffLength ], xExtraLength );
+    pxPatch->xLength += aduimagedeltaCONTROL_SIZE + xDiffLength + xExtraLength;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+/* Length of the diff starting with an exact match of xMatch bytes. */
+static size_t prvExtendMatch( const uint8_t * pucSource,
+                              size_t xSourceLength,
+                              const uint8_t * pucImage,
+                              size_t xImageLength,
+                              size_t xMatch )
+{
+    size_t xLimit = ( xSourceLength < xImageLength ) ? xSourceLength : xImageLength;
+    size_t xEnd = xMatch;
+    size_t xIndex;
+    uint32_t ulRecentMatches = aduimagedeltaEXTEND_WINDOW;
+    uint32_t ulHistory = 0xFFFFFFFFU;
+
+    for( xIndex = xMatch; xIndex < xLimit; xIndex++ )
+    {
+        uint32_t ulMatch = ( pucSource[ xIndex ] == pucImage[ xIndex ] ) ? 1U : 0U;
+
+        /* Bit i of ulHistory is whether the byte i positions back matched. */
+        ulRecentMatches += ulMatch - ( ( ulHistory >> ( aduimagedeltaEXTEND_WINDOW - 1U ) ) & 1U );
+        ulHistory = ( ulHistory << 1 ) | ulMatch;
+
+        if( ulRecentMatches < aduimagedeltaEXTEND_MATCHES )
+        {
+            break;
+        }
+
+        if( ulMatch != 0U )
+        {
+            xEnd = xIndex + 1U;
+        }
+    }
+
+    return xEnd;
+}
+/*-----------------------------------------------------------*/
+
+static int prvDiff( const uint8_t * pucSource,
+                    size_t xSourceLength,
+                    const uint8_t * pucImage,
+                    size_t xImageLength,
+                    Patch_t * pxPatch )
+{
+    int32_t * plHeads = malloc( sizeof( int32_t ) << aduimagedeltaHASH_BITS );
+    int32_t * plPrevious = malloc( sizeof( int32_t ) * ( xSourceLength + 1U ) );
+    size_t xDiffImageOffset = 0; /* Current record. */
+    size_t xDiffSourceOffset = 0;
+    size_t xDiffLength = 0;
+    size_t xScan = 0;
+    size_t xBestLength;
+    size_t xBestSource = 0;
+    size_t xLength;
+    size_t xLimit;
+    int32_t lCandidate;
+    uint32_t ulChain;
+    size_t xIndex;
+    int lResult = 0;
+
+    if( ( plHeads == NULL ) || ( plPrevious == NULL ) )
+    {
+        free( plHeads );
+        free( plPrevious );
+        return -1;
+    }
+
+    for( xIndex = 0; xIndex < ( ( size_t ) 1 << aduimagedeltaHASH_BITS ); xIndex++ )
+    {
+        plHeads[ xIndex ] = -1;
+    }
+
+    /* The chains start with the first occurrences, so the matches prefer
+     * the lowest offsets. */
+    for( xIndex = xSourceLength; xIndex-- > 0U; )
+    {
+        if( xSourceLength - xIndex >= aduimagedeltaMIN_MATCH )
+        {
+            uint32_t ulHash = prvHash( &pucSource[ xIndex ] );
+
+            plPrevious[ xIndex ] = plHeads[ ulHash ];
+            plHeads[ ulHash ] = ( int32_t ) xIndex;
+        }
+    }
+
+    while( ( lResult == 0 ) && ( xScan + aduimagedeltaMIN_MATCH <= xImageLength ) )
+    {
+        xBestLength = 0;
+
+        /* The alignment of the current record first, most code does not
+         * move. */
+        xIndex = xDiffSourceOffset + ( xScan - xDiffImageOffset );
+
+        if( ( xIndex + aduimagedeltaMIN_MATCH <= xSourceLength ) &&
+            ( memcmp( &pucSource[ xIndex ], &pucImage[ xScan ], aduimagedeltaMIN_MATCH ) == 0 ) )
+        {
+            xBestLength = aduimagedeltaMIN_MATCH;
+            xBestSource = xIndex;
+        }
+
+        /* Otherwise the longest match found in the running image. */
+        if( xBestLength == 0U )
+        {
+            for( lCandidate = plHeads[ prvHash( &pucImage[ xScan ] ) ], ulChain = 0;
+                 ( lCandidate >= 0 ) && ( ulChain < aduimagedeltaMAX_CHAIN );
+                 lCandidate = plPrevious[ lCandidate ], ulChain++ )
+            {
+                xLimit = xSourceLength - ( size_t ) lCandidate;
+                xLimit = ( xImageLength - xScan < xLimit ) ? xImageLength - xScan : xLimit;
+
+                for( xLength = 0;
+                     ( xLength < xLimit ) && ( pucSource[ ( size_t ) lCandidate + xLength ] == pucImage[ xScan + xLength ] );
+                     xLength++ )
+                {
+                }
+
+                if( ( xLength >= aduimagedeltaMIN_MATCH ) && ( xLength > xBestLength ) )
+                {
+                    xBestLength = xLength;
+                    xBestSource = ( size_t ) lCandidate;
+                }
+            }
+        }
+
+        if( xBestLength == 0U )
+        {
+            xScan++;
+            continue;
+        }
+
+        /* The current record ends with the extra bytes before the match. */
+        lResult = prvAppendRecord( pxPatch, pucSource, xDiffSourceOffset, &pucImage[ xDiffImageOffset ],
+                                   xDiffLength, xScan - xDiffImageOffset - xDiffLength,
+                                   ( int64_t ) xBestSource - ( int64_t ) ( xDiffSourceOffset + xDiffLength ) );
+
+        xDiffImageOffset = xScan;
+        xDiffSourceOffset = xBestSource;
+        xDiffLength = prvExtendMatch( &pucSource[ xBestSource ], xSourceLength - xBestSource,
+                                      &pucImage[ xScan ], xImageLength - xScan, xBestLength );
+        xScan += xDiffLength;
+    }
+
+    if( lResult == 0 )
+    {
+        lResult = prvAppendRecord( pxPatch, pucSource, xDiffSourceOffset, &pucImage[ xDiffImageOffset ],
+                                   xDiffLength, xImageLength - xDiffImageOffset - xDiffLength, 0 );
+    }
+
+    free( plHeads );
+    free( plPrevious );
+
+    return lResult;
+}
+/*-----------------------------------------------------------*/
+
+int ADUImageDelta_Create( const uint8_t * pucSource,
+                          size_t xSourceLength,
+                          const uint8_t * pucImage,
+                          size_t xImageLength,
+                          uint8_t ucWindowBits,
+                          uint8_t ucLookaheadBits,
+                          uint8_t ** ppucPayload,
+                          size_t * pxPayloadLength )
+{
+    Patch_t xPatch;
+    uint8_t * pucPayload;
+    size_t xPayloadSize;
+    size_t xBodyLength;
+    char cHash[ 45 ];
+
+    if( ( pucSource == NULL ) || ( pucImage == NULL ) || ( ppucPayload == NULL ) || ( pxPayloadLength == NULL ) ||
+        ( xSourceLength > INT32_MAX ) || ( xImageLength > INT32_MAX ) )
+    {
+        return -1;
+    }
+
+    /* Every record but the last covers at least aduimagedeltaMIN_MATCH
+     * bytes of the new image. */
+    xPatch.xSize = xImageLength + aduimagedeltaCONTROL_SIZE * ( xImageLength / aduimagedeltaMIN_MATCH + 2U );
+    xPatch.xLength = 0;
+    xPatch.pucData = malloc( xPatch.xSize );
+    xPayloadSize = aduimagedeltaHEADER_SIZE + ( xPatch.xSize * 9U + 7U ) / 8U + 1U;
+    pucPayload = malloc( xPayloadSize );
+
+    if( ( xPatch.pucData == NULL ) || ( pucPayload == NULL ) ||
+        ( prvDiff( pucSource, xSourceLength, pucImage, xImageLength, &xPatch ) != 0 ) )
+    {
+        free( xPatch.pucData );
+        free( pucPayload );
+        return -1;
+    }
+
+    ( void ) memcpy( pucPayload, aduimagedeltaMAGIC, 4 );
+    pucPayload[ 4 ] = aduimagedeltaVERSION;
+    pucPayload[ 5 ] = ucWindowBits;
+    pucPayload[ 6 ] = ( ucWindowBits == 0U ) ? 0U : ucLookaheadBits;
+    pucPayload[ 7 ] = 0;
+    prvWriteLittleEndian32( &pucPayload[ 8 ], ( uint32_t ) xSourceLength );
+    prvWriteLittleEndian32( &pucPayload[ 12 ], ( uint32_t ) xImageLength );
+
+    if( ADUImageCompress_HashBase64( pucSource, xSourceLength, cHash ) == 0 )
+    {
+        ( void ) memcpy( &pucPayload[ 16 ], cHash, 44 );
+    }
+    else
+    {
+        xPatch.xLength = 0;
+    }
+
+    if( ADUImageCompress_HashBase64( pucImage, xImageLength, cHash ) == 0 )
+    {
+        ( void ) memcpy( &pucPayload[ 60 ], cHash, 44 );
+    }
+    else
+    {
+        xPatch.xLength = 0;
+    }
+
+    /* The patch holds at least the last record. */
+    if( xPatch.xLength == 0U )
+    {
+        free( xPatch.pucData );
+        free( pucPayload );
+        return -1;
+    }
+
+    if( ucWindowBits == 0U )
+    {
+        ( void ) memcpy( &pucPayload[ aduimagedeltaHEADER_SIZE ], xPatch.pucData, xPatch.xLength );
+        xBodyLength = xPatch.xLength;
+    }
+    else if( ADUImageCompress_Encode( xPatch.pucData, xPatch.xLength, ucWindowBits, ucLookaheadBits,
+                                      &pucPayload[ aduimagedeltaHEADER_SIZE ],
+                                      xPayloadSize - aduimagedeltaHEADER_SIZE, &xBodyLength ) != 0 )
+    {
+        free( xPatch.pucData );
+        free( pucPayload );
+        return -1;
+    }
+
+    free( xPatch.pucData );
+
+    *ppucPayload = pucPayload;
+    *pxPayloadLength = aduimagedeltaHEADER_SIZE + xBodyLength;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,47 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file adu_image_delta.h
+ * @brief Host side of the delta ADU payloads: the diff of two images into the
+ * payload of sample_azure_iot_adu_delta.h.
+ */
+
+#ifndef ADU_IMAGE_DELTA_H
+#define ADU_IMAGE_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Lookahead of the patches, longer than the one of the images: the
+ * diff bytes of a patch are mostly runs of zeros.
+ */
+#define aduimagedeltaDEFAULT_LOOKAHEAD_BITS    ( 8U )
+
+/**
+ * @brief Create the delta payload updating an image to another.
+ *
+ * The patch is compressed with the encoder of adu_image_compress.h unless
+ * ucWindowBits is 0.
+ *
+ * @param[in] pucSource The image the device runs.
+ * @param[in] xSourceLength Length of the running image.
+ * @param[in] pucImage The new image.
+ * @param[in] xImageLength Length of the new image.
+ * @param[in] ucWindowBits Window, 0 or from 4 to 15 bits.
+ * @param[in] ucLookaheadBits Lookahead, from 3 to ucWindowBits - 1 bits.
+ * @param[out] ppucPayload The payload, to release with free().
+ * @param[out] pxPayloadLength Length of the payload.
+ * @return 0 on success, -1 otherwise.
+ */
+int ADUImageDelta_Create( const uint8_t * pucSource,
+                          size_t xSourceLength,
+                          const uint8_t * pucImage,
+                          size_t xImageLength,
+                          uint8_t ucWindowBits,
+                          uint8_t ucLookaheadBits,
+                          uint8_t ** ppucPayload,
+                          size_t * pxPayloadLength );
+
+#endif /* ADU_IMAGE_DELTA_H */
@@ -294,6 +294,15 @@ static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCred
         pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
         pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
     #endif
+    #ifdef democonfigENABLE_TLS_SESSION_RESUMPTION
+        pxNetworkCredentials->xEnableSessionResumption = pdTRUE;
+    #endif
+    #ifdef democonfigTLS_CRYPTO_SLICE_MAX_OPS
+        pxNetworkCredentials->ulCryptoSliceMaxOps = democonfigTLS_CRYPTO_SLICE_MAX_OPS;
+    #endif
+    #ifdef democonfigTLS_MAX_FRAGMENT_LENGTH
+        pxNetworkCredentials->ulMaxFragmentLength = democonfigTLS_MAX_FRAGMENT_LENGTH;
+    #endif
 
     return 0;
 }
@@ -586,6 +595,9 @@ static void prvAzureDemoTask( void * pvParameters )
         /* Close the network connection.  */
         TLS_Socket_Disconnect( &xNetworkContext );
 
+        /* The provisioning connection is not made again, drop its session. */
+        TLS_Socket_ForgetSession( &xNetworkContext );
+
         *ppucIothubHostname = ucSampleIotHubHostname;
         *pulIothubHostnameLength = ucSamplepIothubHostnameLength;
         *ppucIothubDeviceId = ucSampleIotHubDeviceId;
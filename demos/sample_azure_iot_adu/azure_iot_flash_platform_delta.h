@@ -0,0 +1,37 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_flash_platform_delta.h
+ *
+ * @brief Delta updates for the flash abstraction.
+ *
+ * A delta update rebuilds the new image from the image the device runs and a
+ * patch. The ports implementing this function give read access to the running
+ * image, which is never written during the update.
+ */
+
+#ifndef AZURE_IOT_FLASH_PLATFORM_DELTA_H
+#define AZURE_IOT_FLASH_PLATFORM_DELTA_H
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+/**
+ * @brief Read a region of the running image.
+ *
+ * @param[in] pxAduImage The image being updated.
+ * @param[in] ulOffset Offset of the region in the running image.
+ * @param[out] pucData Buffer for the region.
+ * @param[in] ulLength Length of the region.
+ * @return An #AzureIoTResult_t with the result of the operation, a failure
+ * when the region is not in the running partition.
+ */
+AzureIoTResult_t AzureIoTPlatform_ReadRunningImage( AzureADUImage_t * const pxAduImage,
+                                                    uint32_t ulOffset,
+                                                    uint8_t * pucData,
+                                                    uint32_t ulLength );
+
+#endif /* AZURE_IOT_FLASH_PLATFORM_DELTA_H */
@@ -0,0 +1,91 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_flash_platform_resume.h
+ *
+ * @brief Resumable downloads for the flash abstraction.
+ *
+ * The ports implementing these functions persist a checkpoint of the download
+ * which holds the hash of the update id, the hash of the file URL, the size
+ * of the image and the length of the image written with its hash. The next
+ * download of the same file continues after the checkpoint, once the region
+ * already written has been read back and matched against its hash.
+ *
+ * Checkpoints are only taken at offsets aligned to the flash sectors, so the
+ * download chunk size should be a multiple of the sector size.
+ */
+
+#ifndef AZURE_IOT_FLASH_PLATFORM_RESUME_H
+#define AZURE_IOT_FLASH_PLATFORM_RESUME_H
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+/**
+ * @brief Value of the first word of a checkpoint.
+ */
+#define azureiotflashCHECKPOINT_MAGIC    ( 0x41445531UL ) /* "ADU1" */
+
+/**
+ * @brief Persisted progress of a download.
+ */
+typedef struct AzureADUCheckpoint
+{
+    uint32_t ulMagic;                 /**< azureiotflashCHECKPOINT_MAGIC. */
+    uint8_t ucUpdateIdHash[ 32 ];     /**< SHA-256 of the update id. */
+    uint8_t ucFileUrlHash[ 32 ];      /**< SHA-256 of the file URL. */
+    uint32_t ulImageFileSize;         /**< Size of the image. */
+    uint32_t ulWrittenLength;         /**< Length of the image written, sector aligned. */
+    uint8_t ucWrittenHash[ 32 ];      /**< SHA-256 of the image written. */
+} AzureADUCheckpoint_t;
+
+/**
+ * @brief Initialize the flash for a download, resuming it when a checkpoint
+ * of the same file is found.
+ *
+ * Behaves like AzureIoTPlatform_Init() when there is no checkpoint, when it is
+ * of another update or file, or when the region it covers does not match its
+ * hash. Otherwise the flash past the checkpoint is erased and the download
+ * continues at pxAduImage->ulCurrentOffset.
+ *
+ * @param[out] pxAduImage The image.
+ * @param[in] pucUpdateId The update id.
+ * @param[in] ulUpdateIdLength Length of the update id.
+ * @param[in] pucFileUrl The URL of the image.
+ * @param[in] ulFileUrlLength Length of the URL.
+ * @param[in] ulImageFileSize Size of the image.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTPlatform_InitResumable( AzureADUImage_t * const pxAduImage,
+                                                 const uint8_t * pucUpdateId,
+                                                 uint32_t ulUpdateIdLength,
+                                                 const uint8_t * pucFileUrl,
+                                                 uint32_t ulFileUrlLength,
+                                                 uint32_t ulImageFileSize );
+
+/**
+ * @brief Persist the progress of the download.
+ *
+ * Only the image written in order is covered, and nothing is saved while its
+ * length is not sector aligned.
+ *
+ * @param[in] pxAduImage The image.
+ * @param[out] pulSavedLength Length of the image covered by the checkpoint
+ * saved, 0 when nothing was saved.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTPlatform_SaveCheckpoint( AzureADUImage_t * const pxAduImage,
+                                                  uint32_t * pulSavedLength );
+
+/**
+ * @brief Remove the checkpoint, once the image is complete or cannot be used.
+ *
+ * @param[in] pxAduImage The image.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTPlatform_ClearCheckpoint( AzureADUImage_t * const pxAduImage );
+
+#endif /* AZURE_IOT_FLASH_PLATFORM_RESUME_H */
@@ -0,0 +1,66 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_flash_platform_sector.h
+ *
+ * @brief Sector geometry of the flash abstraction.
+ *
+ * A flash is erased by sectors and programmed by pages. The ports
+ * implementing these functions let the writes be gathered into whole sectors
+ * and the sectors be erased before the data reaches them, and count the
+ * operations the writes cost.
+ */
+
+#ifndef AZURE_IOT_FLASH_PLATFORM_SECTOR_H
+#define AZURE_IOT_FLASH_PLATFORM_SECTOR_H
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+/**
+ * @brief Flash operations of the update since the port was initialized.
+ */
+typedef struct AzureADUFlashCounters
+{
+    uint32_t ulWrites;              /**< Calls to AzureIoTPlatform_WriteBlock(). */
+    uint32_t ulUnalignedWrites;     /**< Writes starting or ending inside a sector. */
+    uint32_t ulPagePrograms;        /**< Pages programmed, once for each write reaching them. */
+    uint32_t ulPartialPagePrograms; /**< Pages programmed without their whole content. */
+    uint32_t ulSectorErases;        /**< Sectors erased. */
+} AzureADUFlashCounters_t;
+
+/**
+ * @brief Size of the erase unit of the update partition.
+ *
+ * @param[in] pxAduImage The image being updated.
+ * @return The size of a sector, a power of two.
+ */
+uint32_t AzureIoTPlatform_GetSectorSize( AzureADUImage_t * const pxAduImage );
+
+/**
+ * @brief Erase a sector of the update partition before it is written.
+ *
+ * A sector the update already erased or wrote is left as it is, so the
+ * sectors can be erased ahead of the writes at any time.
+ *
+ * @param[in] pxAduImage The image being updated.
+ * @param[in] ulOffset Offset of the sector in the partition, a multiple of the
+ * sector size.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTPlatform_EraseSector( AzureADUImage_t * const pxAduImage,
+                                               uint32_t ulOffset );
+
+/**
+ * @brief Flash operations of the update so far.
+ *
+ * @param[in] pxAduImage The image being updated.
+ * @param[out] pxCounters The operations.
+ */
+void AzureIoTPlatform_GetFlashCounters( AzureADUImage_t * const pxAduImage,
+                                        AzureADUFlashCounters_t * pxCounters );
+
+#endif /* AZURE_IOT_FLASH_PLATFORM_SECTOR_H */
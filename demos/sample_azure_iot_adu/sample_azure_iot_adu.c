@@ -8,6 +8,7 @@
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 
 /* Azure Provisioning/IoT Hub library includes */
 #include "azure_iot_hub_client.h"
@@ -16,6 +17,8 @@
 #include "azure_iot_adu_client.h"
 #include "azure_iot_flash_platform.h"
 #include "azure_iot_http.h"
+#include "azure_iot_flash_platform_resume.h"
+#include "azure_iot_flash_platform_sector.h"
 
 /* Azure JSON includes */
 #include "azure_iot_json_reader.h"
@@ -28,6 +31,15 @@
 #include "transport_tls_socket.h"
 #include "transport_socket.h"
 
+/* Range download */
+#include "azure_sample_http_range.h"
+#include "azure_sample_adaptive_chunk.h"
+#include "azure_sample_bandwidth_shaper.h"
+#include "sample_azure_iot_adu_compressed.h"
+#include "sample_azure_iot_adu_delta.h"
+#include "sample_azure_iot_adu_coalesce.h"
+#include "sample_azure_iot_adu_deployment.h"
+
 /* Crypto helper header. */
 #include "azure_sample_crypto.h"
 
@@ -123,10 +135,10 @@
 #define sampleazureiotSUBSCRIBE_TIMEOUT                       ( 10 * 1000U )
 
 /**
- * @brief Timeout for downloading the update image and calling the
- * AzureIoTHubClient_ProcessLoop() function (in seconds)
+ * @brief Interval between the reports of the progress of a download, in
+ * ticks.
  */
-#define sampleazureiotADU_DOWNLOAD_TIMEOUT_SEC                ( 10 )
+#define sampleaduDOWNLOAD_PROGRESS_INTERVAL_TICKS             ( pdMS_TO_TICKS( 10000U ) )
 
 /**
  * @brief Buffer size for ADU HTTP download headers
@@ -134,6 +146,140 @@
  */
 #define ADU_HEADER_BUFFER_SIZE                                512
 
+/**
+ * @brief Number of download buffers. With two or more, the download fills one
+ * while the flash writer task programs the chunks of the others. With one,
+ * the default, the download waits for each chunk to be written, and the port
+ * saves the static RAM of a second buffer.
+ */
+#ifndef democonfigADU_DOWNLOAD_BUFFER_COUNT
+    #define democonfigADU_DOWNLOAD_BUFFER_COUNT               1
+#endif
+
+#define sampleaduDOWNLOAD_BUFFER_COUNT                        ( ( uint32_t ) democonfigADU_DOWNLOAD_BUFFER_COUNT )
+
+/**
+ * @brief Size of a download buffer, a chunk and the headers of its response.
+ */
+#define sampleaduDOWNLOAD_BUFFER_SIZE                         ( democonfigCHUNK_DOWNLOAD_SIZE + 1024 )
+
+/**
+ * @brief Number of range requests sent ahead on the download connection.
+ */
+#ifndef democonfigADU_HTTP_PIPELINE_DEPTH
+    #define democonfigADU_HTTP_PIPELINE_DEPTH                 ( 2U )
+#endif
+
+/**
+ * @brief Smallest chunk size of the download. The chunk size starts there and
+ * adapts to the throughput, up to democonfigCHUNK_DOWNLOAD_SIZE. The chunk
+ * size is fixed when both are equal.
+ */
+#ifndef democonfigADU_MIN_CHUNK_DOWNLOAD_SIZE
+    #define democonfigADU_MIN_CHUNK_DOWNLOAD_SIZE             democonfigCHUNK_DOWNLOAD_SIZE
+#endif
+
+/**
+ * @brief Longest time a chunk should take to download, larger chunks are
+ * only used while they arrive within it.
+ */
+#ifndef democonfigADU_CHUNK_TARGET_TIME_MS
+    #define democonfigADU_CHUNK_TARGET_TIME_MS                ( 2000U )
+#endif
+
+/**
+ * @brief Free heap in bytes, the chunks do not grow past it.
+ */
+#ifndef democonfigADU_GET_FREE_HEAP_SIZE
+    #define democonfigADU_GET_FREE_HEAP_SIZE()                ( ( uint32_t ) xPortGetFreeHeapSize() )
+#endif
+
+/**
+ * @brief Telemetry with the progress of the download, sent at each report of
+ * the progress.
+ */
+#define sampleaduDOWNLOAD_PROGRESS_MESSAGE                    "{\"aduDownload\":{\"offset\":%u,\"size\":%u,\"chunkSize\":%u,\"goodputBps\":%u,\"throughputBps\":%u}}"
+
+/**
+ * @brief Result details of the agent state reporting the progress of the
+ * download, with the result code of the ADU agent for a download in progress.
+ */
+#define sampleaduDOWNLOAD_PROGRESS_DETAILS                    "Downloaded %u of %u bytes at %u bytes/s"
+#define sampleaduDOWNLOAD_IN_PROGRESS_RESULT_CODE             ( 501 )
+
+/**
+ * @brief Largest rate of the download in bytes per second, 0 for no limit. A
+ * limited download leaves the rest of the link to the telemetry and the
+ * commands.
+ */
+#ifndef democonfigADU_DOWNLOAD_MAX_BYTES_PER_SECOND
+    #define democonfigADU_DOWNLOAD_MAX_BYTES_PER_SECOND       ( 0U )
+#endif
+
+/**
+ * @brief Set to 1 to persist the progress of the download, so a download
+ * interrupted by a reboot or a cancellation continues where it stopped. The
+ * flash port must implement azure_iot_flash_platform_resume.h.
+ */
+#ifndef democonfigADU_RESUME_DOWNLOAD
+    #define democonfigADU_RESUME_DOWNLOAD                     0
+#endif
+
+/**
+ * @brief Bytes written between two checkpoints of a resumable download.
+ */
+#ifndef democonfigADU_CHECKPOINT_INTERVAL
+    #define democonfigADU_CHECKPOINT_INTERVAL                 ( 65536U )
+#endif
+
+/**
+ * @brief Set to 1 to accept compressed payloads, see
+ * sample_azure_iot_adu_compressed.h. They are decompressed into the flash as
+ * they download, and their downloads are not resumable.
+ */
+#ifndef democonfigADU_COMPRESSED_IMAGES
+    #define democonfigADU_COMPRESSED_IMAGES                   0
+#endif
+
+/**
+ * @brief Set to 1 to accept delta payloads, see sample_azure_iot_adu_delta.h.
+ * The new image is rebuilt from the running image as they download, and their
+ * downloads are not resumable. The flash port implements
+ * AzureIoTPlatform_ReadRunningImage().
+ */
+#ifndef democonfigADU_DELTA_IMAGES
+    #define democonfigADU_DELTA_IMAGES                        0
+#endif
+
+/**
+ * @brief Set to 1 to write the image by whole flash sectors, see
+ * sample_azure_iot_adu_coalesce.h, and erase the sectors ahead of the
+ * download. The flash port implements azure_iot_flash_platform_sector.h.
+ */
+#ifndef democonfigADU_COALESCE_WRITES
+    #define democonfigADU_COALESCE_WRITES                     0
+#endif
+
+/**
+ * @brief Priority of the demo task. It is above the download, so the hub
+ * connection is serviced whenever the demo task is ready.
+ */
+#define sampleaduDEMO_TASK_PRIORITY                           ( tskIDLE_PRIORITY + 1 )
+
+/**
+ * @brief Stack size and priority of the download task, which downloads the
+ * image while the demo task keeps the hub connection.
+ */
+#define sampleaduDOWNLOAD_TASK_STACK_SIZE                     ( democonfigDEMO_STACKSIZE )
+#define sampleaduDOWNLOAD_TASK_PRIORITY                       ( tskIDLE_PRIORITY )
+
+/**
+ * @brief Stack size and priority of the flash writer task. It has the
+ * priority of the download task so they share the CPU.
+ */
+#define sampleaduFLASH_WRITER_TASK_STACK_SIZE                 ( democonfigDEMO_STACKSIZE )
+#define sampleaduFLASH_WRITER_TASK_PRIORITY                   ( sampleaduDOWNLOAD_TASK_PRIORITY )
+
 #define democonfigADU_UPDATE_ID                               "{\"provider\":\"" democonfigADU_UPDATE_PROVIDER "\",\"name\":\"" democonfigADU_UPDATE_NAME "\",\"version\":\"" democonfigADU_UPDATE_VERSION "\"}"
 
 #ifdef democonfigADU_UPDATE_NEW_VERSION
@@ -192,8 +338,112 @@ static uint8_t ucCommandResponsePayloadBuffer[ 128 ];
 static uint8_t ucReportedPropertiesUpdate[ 1500 ];
 static uint32_t ulReportedPropertiesUpdateLength;
 
-static uint8_t ucAduDownloadBuffer[ democonfigCHUNK_DOWNLOAD_SIZE + 1024 ];
+static uint8_t ucAduDownloadBuffers[ sampleaduDOWNLOAD_BUFFER_COUNT ][ sampleaduDOWNLOAD_BUFFER_SIZE ];
 static uint8_t ucAduDownloadHeaderBuffer[ ADU_HEADER_BUFFER_SIZE ];
+static HTTPRangeClient_t xHTTPRange;
+static AdaptiveChunk_t xAdaptiveChunk;
+static BandwidthShaper_t xBandwidthShaper;
+static uint8_t ucAduProgressBuffer[ 160 ];
+static uint8_t ucAduProgressDetails[ 96 ];
+
+/* Url of the image and hash of the payload, copied from the update request
+ * when the download starts, as the hub messages received during the download
+ * reuse the buffers of the request. */
+static uint8_t ucAduFileUrl[ 512 ];
+static uint32_t ulAduFileUrlLength;
+static uint8_t ucAduPayloadHash[ 64 ];
+static uint32_t ulAduPayloadHashLength;
+
+/* Host and path of the url, parsed by the download task. */
+static uint8_t ucAduFileUrlBuffer[ 512 ];
+
+/**
+ * @brief State of the download task, as seen by the demo task.
+ */
+typedef enum SampleADUDownloadState
+{
+    eSampleADUDownloadIdle = 0, /**< No download, one can be started. */
+    eSampleADUDownloadRunning,  /**< The download task is downloading. */
+    eSampleADUDownloadDone      /**< The download is over, its result is set. */
+} SampleADUDownloadState_t;
+
+/**
+ * @brief Progress of the download, updated by the download task after each
+ * chunk.
+ */
+typedef struct SampleADUProgress
+{
+    uint32_t ulOffset;        /**< Length of the image downloaded. */
+    uint32_t ulSize;          /**< Size of the image. */
+    uint32_t ulChunkSize;     /**< Size of the next chunks. */
+    uint32_t ulGoodputBps;    /**< Goodput at that size. */
+    uint32_t ulThroughputBps; /**< Average rate since the download started. */
+} SampleADUProgress_t;
+
+static TaskHandle_t xDownloadTask = NULL;
+static volatile SampleADUDownloadState_t xDownloadState = eSampleADUDownloadIdle;
+static volatile AzureIoTResult_t xDownloadResult = eAzureIoTSuccess;
+
+/* Set by the demo task when the deployment is cancelled or replaced, the
+ * download task stops at the next chunk. */
+static volatile bool xDownloadCancelled = false;
+
+/* Deployment of the download, the update request is overwritten when the
+ * service sends another one. Its update id identifies the checkpoints. */
+static SampleADUDeployment_t xAduDeployment;
+
+/* Written by the download task in a critical section. */
+static SampleADUProgress_t xDownloadProgress;
+
+/**
+ * @brief Downloaded chunk handed to the flash writer task.
+ */
+typedef struct SampleADUChunk
+{
+    uint8_t * pucData;      /**< Data of the chunk, in its download buffer. */
+    uint32_t ulOffset;      /**< Offset of the chunk in the image. */
+    uint32_t ulLength;      /**< Length of the chunk. */
+    uint32_t ulBufferIndex; /**< Download buffer to give back once the chunk is written. */
+} SampleADUChunk_t;
+
+/* Chunks to write, in the order of the image. */
+static QueueHandle_t xFilledChunkQueue = NULL;
+
+/* Indexes of the download buffers not in use. */
+static QueueHandle_t xFreeBufferQueue = NULL;
+
+/* First flash write error of the current download. */
+static volatile AzureIoTResult_t xFlashWriteResult = eAzureIoTSuccess;
+
+/* Whether the payload of the current download is compressed, set by the
+ * flash writer task from the first chunk. The offsets of a compressed payload
+ * are not the ones of the flash, so it has no checkpoints. */
+static bool xAduPayloadCompressed = false;
+
+/* Whether the payload of the current download is a delta of the running
+ * image, set like xAduPayloadCompressed. */
+static bool xAduPayloadDelta = false;
+
+#if ( democonfigADU_COMPRESSED_IMAGES == 1 )
+    /* Decompression of the current payload. */
+    static SampleADUCompressed_t xAduCompressed;
+#endif
+
+#if ( democonfigADU_DELTA_IMAGES == 1 )
+    /* Application of the current delta payload. */
+    static SampleADUDelta_t xAduDelta;
+#endif
+
+#if ( democonfigADU_COALESCE_WRITES == 1 )
+    /* Writes of the current image, unless the payload is compressed or a
+     * delta, whose blocks are already whole sectors. */
+    static SampleADUCoalesce_t xAduCoalesce;
+#endif
+
+#if ( democonfigADU_RESUME_DOWNLOAD == 1 )
+    /* Length of the image covered by the last checkpoint. */
+    static uint32_t ulCheckpointOffset;
+#endif
 
 const uint8_t sampleaduDEFAULT_RESULT_DETAILS[] = "Ok";
 
@@ -418,19 +668,312 @@ static void prvParseAduFileUrl( AzureIoTADUUpdateManifestFileUrl_t xFileUrl,
     ( void ) memcpy( *pucPath, pcPathStart, *pulPathLength );
 }
 
-static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec )
+/**
+ * @brief Writes a chunk of the payload to the flash, decompressing it when
+ * the payload is compressed and patching the running image when it is a
+ * delta.
+ */
+static AzureIoTResult_t prvWriteChunk( const SampleADUChunk_t * pxChunk )
+{
+    #if ( democonfigADU_COMPRESSED_IMAGES == 1 ) || ( democonfigADU_DELTA_IMAGES == 1 )
+        AzureIoTResult_t xResult;
+    #endif
+
+    #if ( democonfigADU_DELTA_IMAGES == 1 )
+        if( pxChunk->ulOffset == 0U )
+        {
+            xAduPayloadDelta = SampleADUDelta_IsDelta( pxChunk->pucData, pxChunk->ulLength );
+
+            if( xAduPayloadDelta &&
+                ( ( xResult = SampleADUDelta_Init( &xAduDelta, &xImage ) ) != eAzureIoTSuccess ) )
+            {
+                return xResult;
+            }
+        }
+
+        if( xAduPayloadDelta )
+        {
+            return SampleADUDelta_Write( &xAduDelta, pxChunk->pucData, pxChunk->ulLength );
+        }
+    #endif /* democonfigADU_DELTA_IMAGES == 1 */
+
+    #if ( democonfigADU_COMPRESSED_IMAGES == 1 )
+
+        if( pxChunk->ulOffset == 0U )
+        {
+            xAduPayloadCompressed = SampleADUCompressed_IsCompressed( pxChunk->pucData, pxChunk->ulLength );
+
+            if( xAduPayloadCompressed &&
+                ( ( xResult = SampleADUCompressed_Init( &xAduCompressed, &xImage ) ) != eAzureIoTSuccess ) )
+            {
+                return xResult;
+            }
+        }
+
+        if( xAduPayloadCompressed )
+        {
+            return SampleADUCompressed_Write( &xAduCompressed, pxChunk->pucData, pxChunk->ulLength );
+        }
+    #endif /* democonfigADU_COMPRESSED_IMAGES == 1 */
+
+    #if ( democonfigADU_COALESCE_WRITES == 1 )
+        return SampleADUCoalesce_Write( &xAduCoalesce,
+                                        pxChunk->ulOffset,
+                                        pxChunk->pucData,
+                                        pxChunk->ulLength );
+    #else
+        return AzureIoTPlatform_WriteBlock( &xImage,
+                                            pxChunk->ulOffset,
+                                            pxChunk->pucData,
+                                            pxChunk->ulLength );
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Writes the downloaded chunks to the flash, then gives their buffers
+ * back to the download.
+ */
+static void prvFlashWriterTask( void * pvParameters )
+{
+    SampleADUChunk_t xChunk;
+    AzureIoTResult_t xResult;
+
+    #if ( democonfigADU_RESUME_DOWNLOAD == 1 )
+        uint32_t ulSavedLength;
+    #endif
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        if( xQueueReceive( xFilledChunkQueue, &xChunk, portMAX_DELAY ) != pdPASS )
+        {
+            continue;
+        }
+
+        /* After a failure the remaining chunks of the download are dropped. */
+        if( xFlashWriteResult == eAzureIoTSuccess )
+        {
+            xResult = prvWriteChunk( &xChunk );
+
+            if( xResult != eAzureIoTSuccess )
+            {
+                LogError( ( "[ADU] Error writing to flash at offset %u.", ( unsigned int ) xChunk.ulOffset ) );
+                xFlashWriteResult = xResult;
+            }
+
+            #if ( democonfigADU_RESUME_DOWNLOAD == 1 )
+                else if( !xAduPayloadCompressed && !xAduPayloadDelta &&
+                         ( ( xChunk.ulOffset + xChunk.ulLength - ulCheckpointOffset ) >= democonfigADU_CHECKPOINT_INTERVAL ) )
+                {
+                    /* A missed checkpoint only makes the next attempt longer. The
+                     * port saves nothing while the image written is not sector
+                     * aligned, so the next chunk tries again. */
+                    if( AzureIoTPlatform_SaveCheckpoint( &xImage, &ulSavedLength ) == eAzureIoTSuccess )
+                    {
+                        if( ulSavedLength > ulCheckpointOffset )
+                        {
+                            ulCheckpointOffset = ulSavedLength;
+                        }
+                    }
+                    else
+                    {
+                        LogWarn( ( "[ADU] Unable to save the download progress." ) );
+                    }
+                }
+            #endif
+
+            /* Caught up with the download, the next sectors are erased while
+             * the next chunk is received. The buffer is kept until then, so
+             * the end of the download waits for the erases. */
+            #if ( democonfigADU_COALESCE_WRITES == 1 )
+                if( ( xFlashWriteResult == eAzureIoTSuccess ) &&
+                    !xAduPayloadCompressed && !xAduPayloadDelta &&
+                    ( uxQueueMessagesWaiting( xFilledChunkQueue ) == 0U ) )
+                {
+                    ( void ) SampleADUCoalesce_EraseAhead( &xAduCoalesce );
+                }
+            #endif
+        }
+
+        ( void ) xQueueSend( xFreeBufferQueue, &xChunk.ulBufferIndex, portMAX_DELAY );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Creates the flash writer task and its queues on the first download.
+ */
+static void prvFlashWriterInit( void )
+{
+    uint32_t ulBufferIndex;
+    BaseType_t xStatus;
+
+    if( xFilledChunkQueue == NULL )
+    {
+        xFilledChunkQueue = xQueueCreate( sampleaduDOWNLOAD_BUFFER_COUNT, sizeof( SampleADUChunk_t ) );
+        configASSERT( xFilledChunkQueue != NULL );
+
+        xFreeBufferQueue = xQueueCreate( sampleaduDOWNLOAD_BUFFER_COUNT, sizeof( uint32_t ) );
+        configASSERT( xFreeBufferQueue != NULL );
+
+        for( ulBufferIndex = 0; ulBufferIndex < sampleaduDOWNLOAD_BUFFER_COUNT; ulBufferIndex++ )
+        {
+            ( void ) xQueueSend( xFreeBufferQueue, &ulBufferIndex, 0 );
+        }
+
+        xStatus = xTaskCreate( prvFlashWriterTask, "ADUFlashWriter",
+                               sampleaduFLASH_WRITER_TASK_STACK_SIZE, NULL,
+                               sampleaduFLASH_WRITER_TASK_PRIORITY, NULL );
+        configASSERT( xStatus == pdPASS );
+    }
+
+    xFlashWriteResult = eAzureIoTSuccess;
+    xAduPayloadCompressed = false;
+    xAduPayloadDelta = false;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Waits until the flash writer task has written all the chunks handed
+ * to it, which is when it has given back all the download buffers.
+ *
+ * @return The result of the flash writes of the download.
+ */
+static AzureIoTResult_t prvFlashWriterWait( void )
+{
+    uint32_t ulBufferIndexes[ sampleaduDOWNLOAD_BUFFER_COUNT ];
+    uint32_t ulCount;
+
+    for( ulCount = 0; ulCount < sampleaduDOWNLOAD_BUFFER_COUNT; ulCount++ )
+    {
+        ( void ) xQueueReceive( xFreeBufferQueue, &ulBufferIndexes[ ulCount ], portMAX_DELAY );
+    }
+
+    for( ulCount = 0; ulCount < sampleaduDOWNLOAD_BUFFER_COUNT; ulCount++ )
+    {
+        ( void ) xQueueSend( xFreeBufferQueue, &ulBufferIndexes[ ulCount ], 0 );
+    }
+
+    return xFlashWriteResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Publishes the progress of the download to the demo task.
+ */
+static void prvSetDownloadProgress( uint32_t ulDownloadedLength,
+                                    TickType_t xElapsedTicks )
+{
+    uint32_t ulElapsedMs = ( uint32_t ) ( xElapsedTicks * portTICK_PERIOD_MS );
+    SampleADUProgress_t xProgress;
+
+    xProgress.ulOffset = ( uint32_t ) xImage.ulCurrentOffset;
+    xProgress.ulSize = ( uint32_t ) xImage.ulImageFileSize;
+    xProgress.ulChunkSize = AdaptiveChunk_GetSize( &xAdaptiveChunk );
+    xProgress.ulGoodputBps = AdaptiveChunk_GetGoodput( &xAdaptiveChunk );
+    xProgress.ulThroughputBps = ( uint32_t ) ( ( ( uint64_t ) ulDownloadedLength * 1000U ) / ( ulElapsedMs == 0U ? 1U : ulElapsedMs ) );
+
+    taskENTER_CRITICAL();
+    xDownloadProgress = xProgress;
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reports the progress of the download as telemetry, and as the state
+ * of the ADU agent, whose last install result carries it.
+ */
+static void prvSendDownloadProgress( void )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTADUClientInstallResult_t xInstallResult;
+    SampleADUProgress_t xProgress;
+    int lLength;
+
+    taskENTER_CRITICAL();
+    xProgress = xDownloadProgress;
+    taskEXIT_CRITICAL();
+
+    lLength = snprintf( ( char * ) ucAduProgressBuffer, sizeof( ucAduProgressBuffer ),
+                        sampleaduDOWNLOAD_PROGRESS_MESSAGE,
+                        ( unsigned int ) xProgress.ulOffset,
+                        ( unsigned int ) xProgress.ulSize,
+                        ( unsigned int ) xProgress.ulChunkSize,
+                        ( unsigned int ) xProgress.ulGoodputBps,
+                        ( unsigned int ) xProgress.ulThroughputBps );
+
+    if( ( lLength > 0 ) && ( ( uint32_t ) lLength < sizeof( ucAduProgressBuffer ) ) )
+    {
+        LogInfo( ( "[ADU] Progress: %.*s", lLength, ucAduProgressBuffer ) );
+
+        xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
+                                                   ucAduProgressBuffer, ( uint32_t ) lLength,
+                                                   NULL, eAzureIoTHubMessageQoS1, NULL );
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            LogWarn( ( "[ADU] Failed to send the download progress: result 0x%08x", xResult ) );
+        }
+    }
+
+    lLength = snprintf( ( char * ) ucAduProgressDetails, sizeof( ucAduProgressDetails ),
+                        sampleaduDOWNLOAD_PROGRESS_DETAILS,
+                        ( unsigned int ) xProgress.ulOffset,
+                        ( unsigned int ) xProgress.ulSize,
+                        ( unsigned int ) xProgress.ulThroughputBps );
+
+    if( ( lLength > 0 ) && ( ( uint32_t ) lLength < sizeof( ucAduProgressDetails ) ) )
+    {
+        xInstallResult.lResultCode = sampleaduDOWNLOAD_IN_PROGRESS_RESULT_CODE;
+        xInstallResult.lExtendedResultCode = 0;
+        xInstallResult.pucResultDetails = ucAduProgressDetails;
+        xInstallResult.ulResultDetailsLength = ( uint32_t ) lLength;
+        xInstallResult.ulStepResultsCount = 0;
+
+        xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
+                                                    &xAzureIoTHubClient,
+                                                    &xADUDeviceProperties,
+                                                    &xAzureIoTAduUpdateRequest,
+                                                    eAzureIoTADUAgentStateDeploymentInProgress,
+                                                    &xInstallResult,
+                                                    ucScratchBuffer,
+                                                    sizeof( ucScratchBuffer ),
+                                                    NULL );
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            LogWarn( ( "[ADU] Failed to send the download state: result 0x%08x", xResult ) );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( void )
 {
     AzureIoTResult_t xResult;
     AzureIoTHTTPResult_t xHttpResult;
     AzureIoTHTTP_t xHTTP;
-    char * pucOutDataPtr;
-    uint32_t ulOutHttpDataBufferLength;
+    HTTPRangeResult_t xRangeResult;
+    const HTTPRangeStats_t * pxRangeStats;
     uint8_t * pucFileUrlHost;
     uint32_t ulFileUrlHostLength;
     uint8_t * pucFileUrlPath;
     uint32_t ulFileUrlPathLength;
-    uint64_t ullPreviousTimeout;
-    uint64_t ullCurrentTime;
+    uint32_t ulBufferIndex;
+    uint32_t ulDelayMs;
+    AzureIoTADUUpdateManifestFileUrl_t xFileUrl = { 0 };
+    SampleADUChunk_t xChunk;
+    TickType_t xStartTicks;
+    TickType_t xWaitStartTicks;
+    TickType_t xChunkStartTicks;
+    TickType_t xFlashWaitTicks = 0;
+    uint32_t ulStartOffset;
+
+    #if ( democonfigADU_COALESCE_WRITES == 1 )
+        AzureADUFlashCounters_t xFlashCounters;
+    #endif
 
     /*HTTP Connection */
     AzureIoTTransportInterface_t xHTTPTransport;
@@ -444,33 +987,30 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
 
     xHTTPNetworkContext.pParams = &xHTTPSocketTransportParams;
 
-    xResult = AzureIoTPlatform_Init( &xImage );
+    /* A resumable download initializes the flash once the size of the image
+     * is known. */
+    #if ( democonfigADU_RESUME_DOWNLOAD == 0 )
+        xResult = AzureIoTPlatform_Init( &xImage );
 
-    if( xResult != eAzureIoTSuccess )
-    {
-        LogError( ( "[ADU] Error initializing platform." ) );
-        return xResult;
-    }
-
-    LogInfo( ( "[ADU] Step: eAzureIoTADUUpdateStepFirmwareDownloadStarted" ) );
+        if( xResult != eAzureIoTSuccess )
+        {
+            LogError( ( "[ADU] Error initializing platform." ) );
+            return xResult;
+        }
+    #endif
 
-    LogInfo( ( "[ADU] Send property update." ) );
+    prvFlashWriterInit();
 
-    xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
-                                                &xAzureIoTHubClient,
-                                                &xADUDeviceProperties,
-                                                &xAzureIoTAduUpdateRequest,
-                                                eAzureIoTADUAgentStateDeploymentInProgress,
-                                                NULL,
-                                                ucScratchBuffer,
-                                                sizeof( ucScratchBuffer ),
-                                                NULL );
+    LogInfo( ( "[ADU] Step: eAzureIoTADUUpdateStepFirmwareDownloadStarted" ) );
 
     LogInfo( ( "[ADU] Invoke HTTP Connect Callback." ) );
 
+    xFileUrl.pucUrl = ucAduFileUrl;
+    xFileUrl.ulUrlLength = ulAduFileUrlLength;
+
     prvParseAduFileUrl(
-        xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ],
-        ucScratchBuffer, sizeof( ucScratchBuffer ),
+        xFileUrl,
+        ucAduFileUrlBuffer, sizeof( ucAduFileUrlBuffer ),
         &pucFileUrlHost, &ulFileUrlHostLength,
         &pucFileUrlPath, &ulFileUrlPathLength );
 
@@ -490,8 +1030,9 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
         return eAzureIoTErrorFailed;
     }
 
-    if( ( xImage.ulImageFileSize = AzureIoTHTTP_RequestSize( &xHTTP, ( char * ) ucAduDownloadBuffer,
-                                                             sizeof( ucAduDownloadBuffer ) ) ) != -1 )
+    /* No chunk is being written yet, the first buffer is free. */
+    if( ( xImage.ulImageFileSize = AzureIoTHTTP_RequestSize( &xHTTP, ( char * ) ucAduDownloadBuffers[ 0 ],
+                                                             sizeof( ucAduDownloadBuffers[ 0 ] ) ) ) != -1 )
     {
         LogInfo( ( "[ADU] HTTP Range Request was successful: size %u bytes", ( uint16_t ) xImage.ulImageFileSize ) );
     }
@@ -501,96 +1042,368 @@ static AzureIoTResult_t prvDownloadUpdateImageIntoFlash( int32_t ullTimeoutInSec
         return eAzureIoTErrorFailed;
     }
 
+    #if ( democonfigADU_RESUME_DOWNLOAD == 1 )
+        xResult = AzureIoTPlatform_InitResumable( &xImage,
+                                                  ( const uint8_t * ) xAduDeployment.cUpdateId,
+                                                  strlen( xAduDeployment.cUpdateId ),
+                                                  ucAduFileUrl,
+                                                  ulAduFileUrlLength,
+                                                  ( uint32_t ) xImage.ulImageFileSize );
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            LogError( ( "[ADU] Error initializing platform." ) );
+            return xResult;
+        }
+
+        ulCheckpointOffset = ( uint32_t ) xImage.ulCurrentOffset;
+    #endif
+
+    #if ( democonfigADU_COALESCE_WRITES == 1 )
+        if( SampleADUCoalesce_Init( &xAduCoalesce, &xImage,
+                                    ( uint32_t ) xImage.ulCurrentOffset,
+                                    ( uint32_t ) xImage.ulImageFileSize ) != eAzureIoTSuccess )
+        {
+            return eAzureIoTErrorFailed;
+        }
+    #endif
+
+    /* The chunks are requested on the connection of the size request, which
+     * is kept alive for the whole download. */
+    if( HTTPRange_Init( &xHTTPRange, &xHTTPTransport,
+                        ( const char * ) pucFileUrlHost,
+                        ulFileUrlHostLength - 1, /* minus the null-terminator. */
+                        ( const char * ) pucFileUrlPath,
+                        ulFileUrlPathLength,
+                        ucAduDownloadHeaderBuffer,
+                        sizeof( ucAduDownloadHeaderBuffer ),
+                        ( uint32_t ) xImage.ulImageFileSize,
+                        democonfigADU_MIN_CHUNK_DOWNLOAD_SIZE,
+                        democonfigADU_HTTP_PIPELINE_DEPTH ) != eHTTPRangeSuccess )
+    {
+        LogError( ( "[ADU] Error initializing the range download." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( xImage.ulCurrentOffset != 0 )
+    {
+        LogInfo( ( "[ADU] Resuming the download at offset %u.", ( unsigned int ) xImage.ulCurrentOffset ) );
+        ( void ) HTTPRange_Seek( &xHTTPRange, ( uint32_t ) xImage.ulCurrentOffset );
+    }
+
+    /* The chunk sizes are multiples of the smallest one, which keeps the
+     * checkpoints of a resumable download aligned. */
+    AdaptiveChunk_Init( &xAdaptiveChunk,
+                        democonfigADU_MIN_CHUNK_DOWNLOAD_SIZE,
+                        democonfigCHUNK_DOWNLOAD_SIZE,
+                        democonfigADU_CHUNK_TARGET_TIME_MS );
+
     LogInfo( ( "[ADU] Send HTTP request." ) );
 
-    ullPreviousTimeout = ullGetUnixTime();
+    xStartTicks = xTaskGetTickCount();
+    ulStartOffset = ( uint32_t ) xImage.ulCurrentOffset;
+
+    /* A burst of the largest chunk is not delayed. */
+    BandwidthShaper_Init( &xBandwidthShaper,
+                          democonfigADU_DOWNLOAD_MAX_BYTES_PER_SECOND,
+                          democonfigCHUNK_DOWNLOAD_SIZE,
+                          ( uint32_t ) ( xStartTicks * portTICK_PERIOD_MS ) );
+    prvSetDownloadProgress( 0, 0 );
 
     while( xImage.ulCurrentOffset < xImage.ulImageFileSize )
     {
-        ullCurrentTime = ullGetUnixTime();
+        if( xFlashWriteResult != eAzureIoTSuccess )
+        {
+            break;
+        }
 
-        if( ullCurrentTime - ullPreviousTimeout > ullTimeoutInSec )
+        if( xDownloadCancelled )
         {
-            LogInfo( ( "%u second timeout. Taking a break from downloading image.", ( uint16_t ) ullTimeoutInSec ) );
-            LogInfo( ( "Receiving messages from IoT Hub." ) );
-            xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient,
-                                                     sampleazureiotPROCESS_LOOP_TIMEOUT_MS );
+            LogInfo( ( "Deployment was cancelled" ) );
+            break;
+        }
+
+        /* Blocks while the flash writer task is behind the download. */
+        xWaitStartTicks = xTaskGetTickCount();
+        ( void ) xQueueReceive( xFreeBufferQueue, &ulBufferIndex, portMAX_DELAY );
+        xFlashWaitTicks += xTaskGetTickCount() - xWaitStartTicks;
+        xChunkStartTicks = xTaskGetTickCount();
+
+        if( ( xRangeResult = HTTPRange_ReadChunk( &xHTTPRange,
+                                                  ucAduDownloadBuffers[ ulBufferIndex ],
+                                                  sizeof( ucAduDownloadBuffers[ ulBufferIndex ] ),
+                                                  &xChunk.ulOffset,
+                                                  &xChunk.ulLength ) ) == eHTTPRangeSuccess )
+        {
+            LogDebug( ( "[ADU] Chunk at offset %u of %u bytes, round trip %u ms.",
+                        ( unsigned int ) xChunk.ulOffset,
+                        ( unsigned int ) xChunk.ulLength,
+                        ( unsigned int ) HTTPRange_GetStats( &xHTTPRange )->ulLastRttMs ) );
+
+            /* The chunks are received in static buffers, but the socket layer
+             * buffers them from the heap first. */
+            ( void ) HTTPRange_SetChunkSize( &xHTTPRange,
+                                             AdaptiveChunk_OnSuccess( &xAdaptiveChunk,
+                                                                      xChunk.ulLength,
+                                                                      ( uint32_t ) ( ( xTaskGetTickCount() - xChunkStartTicks ) * portTICK_PERIOD_MS ),
+                                                                      HTTPRange_GetStats( &xHTTPRange )->ulLastRttMs,
+                                                                      democonfigADU_GET_FREE_HEAP_SIZE() ) );
+
+            /* Hand the chunk to the flash writer task and download the next
+             * one while it is written. */
+            xChunk.pucData = ucAduDownloadBuffers[ ulBufferIndex ];
+            xChunk.ulBufferIndex = ulBufferIndex;
+            ( void ) xQueueSend( xFilledChunkQueue, &xChunk, portMAX_DELAY );
+
+            /* Advance the offset */
+            xImage.ulCurrentOffset = ( int32_t ) ( xChunk.ulOffset + xChunk.ulLength );
+
+            prvSetDownloadProgress( ( uint32_t ) xImage.ulCurrentOffset - ulStartOffset,
+                                    xTaskGetTickCount() - xStartTicks );
 
-            ullPreviousTimeout = ullGetUnixTime();
+            ulDelayMs = BandwidthShaper_GetDelayMs( &xBandwidthShaper, xChunk.ulLength,
+                                                    ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS ) );
 
-            if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionCancel )
+            if( ulDelayMs > 0U )
             {
-                LogInfo( ( "Deployment was cancelled" ) );
-                break;
+                vTaskDelay( pdMS_TO_TICKS( ulDelayMs ) );
             }
         }
-
-        AzureIoTHTTP_Init( &xHTTP, &xHTTPTransport,
-                           ( const char * ) pucFileUrlHost,
-                           ulFileUrlHostLength - 1, /* minus the null-terminator. */
-                           ( const char * ) pucFileUrlPath,
-                           ulFileUrlPathLength,
-                           ( char * ) ucAduDownloadHeaderBuffer,
-                           sizeof( ucAduDownloadHeaderBuffer ) );
-
-        if( ( xHttpResult = AzureIoTHTTP_Request( &xHTTP, xImage.ulCurrentOffset,
-                                                  xImage.ulCurrentOffset + democonfigCHUNK_DOWNLOAD_SIZE - 1,
-                                                  ( char * ) ucAduDownloadBuffer,
-                                                  sizeof( ucAduDownloadBuffer ),
-                                                  &pucOutDataPtr,
-                                                  &ulOutHttpDataBufferLength ) ) == eAzureIoTHTTPSuccess )
+        else if( ( xRangeResult == eHTTPRangeConnectionClosed ) || ( xRangeResult == eHTTPRangeNetworkError ) )
         {
-            /* Write bytes to the flash */
-            xResult = AzureIoTPlatform_WriteBlock( &xImage,
-                                                   ( uint32_t ) xImage.ulCurrentOffset,
-                                                   ( uint8_t * ) pucOutDataPtr,
-                                                   ulOutHttpDataBufferLength );
+            ( void ) xQueueSend( xFreeBufferQueue, &ulBufferIndex, 0 );
 
-            if( xResult != eAzureIoTSuccess )
+            /* A closed connection is normal, a failed one calls for smaller
+             * chunks. */
+            if( xRangeResult == eHTTPRangeNetworkError )
             {
-                LogError( ( "[ADU] Error writing to flash." ) );
-                return eAzureIoTErrorFailed;
+                ( void ) HTTPRange_SetChunkSize( &xHTTPRange, AdaptiveChunk_OnFailure( &xAdaptiveChunk ) );
             }
 
-            /* Advance the offset */
-            xImage.ulCurrentOffset += ( int32_t ) ulOutHttpDataBufferLength;
-        }
-        else if( xHttpResult == eAzureIoTHTTPNoResponse )
-        {
             LogInfo( ( "[ADU] Reconnecting..." ) );
             LogInfo( ( "[ADU] Invoke HTTP Connect Callback." ) );
+            Azure_Socket_Close( &xHTTPNetworkContext );
             prvConnectHTTP( &xHTTPTransport, ( const char * ) pucFileUrlHost );
 
             if( xResult != eAzureIoTSuccess )
             {
                 LogError( ( "[ADU] Failed to reconnect to HTTP server!" ) );
+                ( void ) prvFlashWriterWait();
                 return eAzureIoTErrorFailed;
             }
+
+            /* The requests left unanswered are sent again. */
+            HTTPRange_Reset( &xHTTPRange );
         }
         else
         {
+            ( void ) xQueueSend( xFreeBufferQueue, &ulBufferIndex, 0 );
+
+            if( xRangeResult != eHTTPRangeComplete )
+            {
+                LogError( ( "[ADU] Range download failed: %d", ( int ) xRangeResult ) );
+            }
+
             break;
         }
     }
 
+    xResult = prvFlashWriterWait();
+
+    /* The last chunk of the image writes its end, a download stopped before
+     * leaves the end of its last block. */
+    #if ( democonfigADU_COALESCE_WRITES == 1 )
+        if( ( xResult == eAzureIoTSuccess ) && !xAduPayloadCompressed && !xAduPayloadDelta )
+        {
+            xResult = SampleADUCoalesce_Flush( &xAduCoalesce );
+        }
+    #endif
+
     AzureIoTHTTP_Deinit( &xHTTP );
 
+    if( xResult != eAzureIoTSuccess )
+    {
+        LogError( ( "[ADU] Error writing to flash." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    LogInfo( ( "[ADU] Downloaded %u bytes in %u ms, %u ms waiting for the flash writes.",
+               ( unsigned int ) xImage.ulCurrentOffset,
+               ( unsigned int ) ( ( xTaskGetTickCount() - xStartTicks ) * portTICK_PERIOD_MS ),
+               ( unsigned int ) ( xFlashWaitTicks * portTICK_PERIOD_MS ) ) );
+
+    pxRangeStats = HTTPRange_GetStats( &xHTTPRange );
+    LogInfo( ( "[ADU] %u range requests on %u connections, %u closed by the server, round trip min/avg/max %u/%u/%u ms.",
+               ( unsigned int ) pxRangeStats->ulRequests,
+               ( unsigned int ) pxRangeStats->ulConnections,
+               ( unsigned int ) pxRangeStats->ulServerCloses,
+               ( unsigned int ) pxRangeStats->ulMinRttMs,
+               ( unsigned int ) ( pxRangeStats->ulTotalRttMs / ( pxRangeStats->ulResponses == 0U ? 1U : pxRangeStats->ulResponses ) ),
+               ( unsigned int ) pxRangeStats->ulMaxRttMs ) );
+
+    LogInfo( ( "[ADU] Chunk size %u bytes after %u increases and %u decreases, %u failures.",
+               ( unsigned int ) AdaptiveChunk_GetSize( &xAdaptiveChunk ),
+               ( unsigned int ) xAdaptiveChunk.ulGrowths,
+               ( unsigned int ) xAdaptiveChunk.ulShrinks,
+               ( unsigned int ) xAdaptiveChunk.ulFailures ) );
+
+    if( xBandwidthShaper.ulDelays > 0U )
+    {
+        LogInfo( ( "[ADU] Rate limited to %u bytes/s, %u ms of delays over %u chunks.",
+                   ( unsigned int ) democonfigADU_DOWNLOAD_MAX_BYTES_PER_SECOND,
+                   ( unsigned int ) xBandwidthShaper.ulTotalDelayMs,
+                   ( unsigned int ) xBandwidthShaper.ulDelays ) );
+    }
+
+    #if ( democonfigADU_COALESCE_WRITES == 1 )
+        AzureIoTPlatform_GetFlashCounters( &xImage, &xFlashCounters );
+        LogInfo( ( "[ADU] Flash: %u writes, %u unaligned, %u page programs, %u partial, %u sector erases, %u ahead of the writes.",
+                   ( unsigned int ) xFlashCounters.ulWrites,
+                   ( unsigned int ) xFlashCounters.ulUnalignedWrites,
+                   ( unsigned int ) xFlashCounters.ulPagePrograms,
+                   ( unsigned int ) xFlashCounters.ulPartialPagePrograms,
+                   ( unsigned int ) xFlashCounters.ulSectorErases,
+                   ( unsigned int ) xAduCoalesce.ulErasesAhead ) );
+    #endif
+
+    prvSetDownloadProgress( ( uint32_t ) xImage.ulCurrentOffset - ulStartOffset,
+                            xTaskGetTickCount() - xStartTicks );
+
+    /* The manifest hashes the payload, which is checked once decompressed.
+     * The image then takes the size of the decompressed one. */
+    #if ( democonfigADU_COMPRESSED_IMAGES == 1 )
+        if( xAduPayloadCompressed &&
+            ( SampleADUCompressed_Finish( &xAduCompressed,
+                                          ucAduPayloadHash,
+                                          ulAduPayloadHashLength ) != eAzureIoTSuccess ) )
+        {
+            return eAzureIoTErrorFailed;
+        }
+    #endif
+
+    #if ( democonfigADU_DELTA_IMAGES == 1 )
+        if( xAduPayloadDelta &&
+            ( SampleADUDelta_Finish( &xAduDelta,
+                                     ucAduPayloadHash,
+                                     ulAduPayloadHashLength ) != eAzureIoTSuccess ) )
+        {
+            return eAzureIoTErrorFailed;
+        }
+    #endif
+
     return eAzureIoTSuccess;
 }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Downloads the update image each time the demo task starts a download,
+ * then leaves its result to the demo task.
+ */
+static void prvDownloadTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        xDownloadResult = prvDownloadUpdateImageIntoFlash();
+        xDownloadState = eSampleADUDownloadDone;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Copies what the download needs from the update request, reports the
+ * deployment in progress and hands the download to the download task, which
+ * is created on the first download.
+ */
+static void prvStartDownload( void )
+{
+    AzureIoTResult_t xResult;
+    BaseType_t xStatus;
+
+    configASSERT( xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ].ulUrlLength < sizeof( ucAduFileUrl ) );
+    ( void ) memcpy( ucAduFileUrl, xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ].pucUrl,
+                     xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ].ulUrlLength );
+    ucAduFileUrl[ xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ].ulUrlLength ] = 0;
+    ulAduFileUrlLength = xAzureIoTAduUpdateRequest.pxFileUrls[ 0 ].ulUrlLength;
+
+    configASSERT( xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].ulHashLength <= sizeof( ucAduPayloadHash ) );
+    ( void ) memcpy( ucAduPayloadHash, xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].pucHash,
+                     xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].ulHashLength );
+    ulAduPayloadHashLength = xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].ulHashLength;
+
+    xResult = SampleADUDeployment_Save( &xAduDeployment, &xAzureIoTAduUpdateRequest );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    LogInfo( ( "[ADU] Send property update." ) );
+
+    xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
+                                                &xAzureIoTHubClient,
+                                                &xADUDeviceProperties,
+                                                &xAzureIoTAduUpdateRequest,
+                                                eAzureIoTADUAgentStateDeploymentInProgress,
+                                                NULL,
+                                                ucScratchBuffer,
+                                                sizeof( ucScratchBuffer ),
+                                                NULL );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        LogWarn( ( "[ADU] Failed sending agent state." ) );
+    }
+
+    if( xDownloadTask == NULL )
+    {
+        xStatus = xTaskCreate( prvDownloadTask, "ADUDownload",
+                               sampleaduDOWNLOAD_TASK_STACK_SIZE, NULL,
+                               sampleaduDOWNLOAD_TASK_PRIORITY, &xDownloadTask );
+        configASSERT( xStatus == pdPASS );
+    }
+
+    xDownloadCancelled = false;
+    xDownloadState = eSampleADUDownloadRunning;
+    ( void ) xTaskNotifyGive( xDownloadTask );
+}
+/*-----------------------------------------------------------*/
 
 static AzureIoTResult_t prvEnableImageAndResetDevice()
 {
     AzureIoTResult_t xResult;
     AzureIoTADUClientInstallResult_t xUpdateResults;
+    uint8_t * pucImageHash = ucAduPayloadHash;
+    uint32_t ulImageHashLength = ulAduPayloadHashLength;
+
+    /* The image of a compressed payload is verified against the hash of its
+     * header, which the payload hash of the manifest covers. */
+    #if ( democonfigADU_COMPRESSED_IMAGES == 1 )
+        if( xAduPayloadCompressed )
+        {
+            pucImageHash = SampleADUCompressed_GetImageHash( &xAduCompressed );
+            ulImageHashLength = sampleaduCOMPRESSED_IMAGE_HASH_SIZE;
+        }
+    #endif
+
+    #if ( democonfigADU_DELTA_IMAGES == 1 )
+        if( xAduPayloadDelta )
+        {
+            pucImageHash = SampleADUDelta_GetImageHash( &xAduDelta );
+            ulImageHashLength = sampleaduDELTA_IMAGE_HASH_SIZE;
+        }
+    #endif
 
     /* Call into platform specific image verification */
     LogInfo( ( "[ADU] Image validated against hash from ADU" ) );
 
-    if( AzureIoTPlatform_VerifyImage(
-            &xImage,
-            xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].pucHash,
-            xAzureIoTAduUpdateRequest.xUpdateManifest.pxFiles[ 0 ].pxHashes[ 0 ].ulHashLength
-            ) != eAzureIoTSuccess )
+    xResult = AzureIoTPlatform_VerifyImage( &xImage, pucImageHash, ulImageHashLength );
+
+    /* The download is over, a bad image is downloaded again from the start. */
+    #if ( democonfigADU_RESUME_DOWNLOAD == 1 )
+        ( void ) AzureIoTPlatform_ClearCheckpoint( &xImage );
+    #endif
+
+    if( xResult != eAzureIoTSuccess )
     {
         LogError( ( "[ADU] File hash from ADU did not match calculated hash" ) );
         return eAzureIoTErrorFailed;
@@ -716,6 +1529,7 @@ static void prvAzureDemoTask( void * pvParameters )
     AzureIoTHubClientOptions_t xHubOptions = { 0 };
     AzureIoTADUClientOptions_t xADUOptions = { 0 };
     bool xSessionPresent;
+    TickType_t xLastProgressTicks = 0;
 
     #ifdef democonfigENABLE_DPS_SAMPLE
         uint8_t * pucIotHubHostname = NULL;
@@ -867,9 +1681,34 @@ static void prvAzureDemoTask( void * pvParameters )
                                                      sampleazureiotPROCESS_LOOP_TIMEOUT_MS );
             configASSERT( xResult == eAzureIoTSuccess );
 
-            if( xProcessUpdateRequest && !xDidDeviceUpdate )
+            /* The download task reports the end of the download, the image
+             * is enabled unless the deployment was cancelled or replaced
+             * meanwhile. */
+            if( xDownloadState == eSampleADUDownloadDone )
             {
-                if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionCancel )
+                if( SampleADUDeployment_IsReplacedBy( &xAduDeployment, &xAzureIoTAduUpdateRequest ) )
+                {
+                    /* The request is of the new deployment, which is
+                     * downloaded next. */
+                    LogInfo( ( "[ADU] Download of the replaced deployment %s discarded.", xAduDeployment.cUpdateId ) );
+                }
+                else if( xDownloadCancelled )
+                {
+                    LogInfo( ( "[ADU] Cancelled download stopped." ) );
+                }
+                else if( xProcessUpdateRequest && ( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionApplyDownload ) )
+                {
+                    configASSERT( xDownloadResult == eAzureIoTSuccess );
+
+                    prvSendDownloadProgress();
+
+                    xResult = prvEnableImageAndResetDevice();
+                    configASSERT( xResult == eAzureIoTSuccess );
+
+                    xResult = prvSpoofNewVersion();
+                    configASSERT( xResult == eAzureIoTSuccess );
+                }
+                else
                 {
                     xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
                                                                 &xAzureIoTHubClient,
@@ -883,41 +1722,64 @@ static void prvAzureDemoTask( void * pvParameters )
 
                     xProcessUpdateRequest = false;
                 }
-                else if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionApplyDownload )
+
+                xDownloadState = eSampleADUDownloadIdle;
+            }
+            else if( xDownloadState == eSampleADUDownloadRunning )
+            {
+                /* The deployment is idle as soon as it is cancelled, the
+                 * download task stops at its next chunk. */
+                if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionCancel )
                 {
-                    xResult = prvDownloadUpdateImageIntoFlash( sampleazureiotADU_DOWNLOAD_TIMEOUT_SEC );
-                    configASSERT( xResult == eAzureIoTSuccess );
+                    xDownloadCancelled = true;
 
-                    LogInfo( ( "Checking for ADU twin updates one more time before committing to update." ) );
-                    xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient,
-                                                             sampleazureiotPROCESS_LOOP_TIMEOUT_MS );
-                    configASSERT( xResult == eAzureIoTSuccess );
+                    xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
+                                                                &xAzureIoTHubClient,
+                                                                &xADUDeviceProperties,
+                                                                &xAzureIoTAduUpdateRequest,
+                                                                eAzureIoTADUAgentStateIdle,
+                                                                NULL,
+                                                                ucScratchBuffer,
+                                                                sizeof( ucScratchBuffer ),
+                                                                NULL );
 
-                    /* In prvDownloadUpdateImageIntoFlash, we make a call to the _ProcessLoop() function */
-                    /* which could bring in a new or cancelled update. */
-                    /* Check xProcessUpdateRequest and the action again in case a new version came in that was invalid. */
-                    if( xProcessUpdateRequest && ( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionApplyDownload ) )
-                    {
-                        xResult = prvEnableImageAndResetDevice();
-                        configASSERT( xResult == eAzureIoTSuccess );
+                    xProcessUpdateRequest = false;
+                }
+                else if( SampleADUDeployment_IsReplacedBy( &xAduDeployment, &xAzureIoTAduUpdateRequest ) )
+                {
+                    /* Nothing is reported on the request of the new
+                     * deployment until its download starts. */
+                    xDownloadCancelled = true;
+                }
+                else if( ( xTaskGetTickCount() - xLastProgressTicks ) >= sampleaduDOWNLOAD_PROGRESS_INTERVAL_TICKS )
+                {
+                    prvSendDownloadProgress();
+                    xLastProgressTicks = xTaskGetTickCount();
+                }
+            }
+            else if( xProcessUpdateRequest && !xDidDeviceUpdate )
+            {
+                if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionCancel )
+                {
+                    xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
+                                                                &xAzureIoTHubClient,
+                                                                &xADUDeviceProperties,
+                                                                &xAzureIoTAduUpdateRequest,
+                                                                eAzureIoTADUAgentStateIdle,
+                                                                NULL,
+                                                                ucScratchBuffer,
+                                                                sizeof( ucScratchBuffer ),
+                                                                NULL );
 
-                        xResult = prvSpoofNewVersion();
-                        configASSERT( xResult == eAzureIoTSuccess );
-                    }
-                    else
-                    {
-                        xResult = AzureIoTADUClient_SendAgentState( &xAzureIoTADUClient,
-                                                                    &xAzureIoTHubClient,
-                                                                    &xADUDeviceProperties,
-                                                                    &xAzureIoTAduUpdateRequest,
-                                                                    eAzureIoTADUAgentStateIdle,
-                                                                    NULL,
-                                                                    ucScratchBuffer,
-                                                                    sizeof( ucScratchBuffer ),
-                                                                    NULL );
-
-                        xProcessUpdateRequest = false;
-                    }
+                    xProcessUpdateRequest = false;
+                }
+                else if( xAzureIoTAduUpdateRequest.xWorkflow.xAction == eAzureIoTADUActionApplyDownload )
+                {
+                    /* The download runs in its own task, at a lower priority,
+                     * while this task keeps sending the telemetry and serving
+                     * the commands and properties. */
+                    prvStartDownload();
+                    xLastProgressTicks = xTaskGetTickCount();
                 }
                 else
                 {
@@ -1163,12 +2025,13 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
 void vStartDemoTask( void )
 {
     /* This example uses a single application task, which in turn is used to
-     * connect, subscribe, publish, unsubscribe and disconnect from the IoT Hub */
-    xTaskCreate( prvAzureDemoTask,         /* Function that implements the task. */
-                 "AzureDemoTask",          /* Text name for the task - only used for debugging. */
-                 democonfigDEMO_STACKSIZE, /* Size of stack (in words, not bytes) to allocate for the task. */
-                 NULL,                     /* Task parameter - not used in this case. */
-                 tskIDLE_PRIORITY,         /* Task priority, must be between 0 and configMAX_PRIORITIES - 1. */
-                 NULL );                   /* Used to pass out a handle to the created task - not used in this case. */
+     * connect, subscribe, publish, unsubscribe and disconnect from the IoT Hub.
+     * It starts the download and flash writer tasks of the updates. */
+    xTaskCreate( prvAzureDemoTask,            /* Function that implements the task. */
+                 "AzureDemoTask",             /* Text name for the task - only used for debugging. */
+                 democonfigDEMO_STACKSIZE,    /* Size of stack (in words, not bytes) to allocate for the task. */
+                 NULL,                        /* Task parameter - not used in this case. */
+                 sampleaduDEMO_TASK_PRIORITY, /* Task priority, must be between 0 and configMAX_PRIORITIES - 1. */
+                 NULL );                      /* Used to pass out a handle to the created task - not used in this case. */
 }
 /*-----------------------------------------------------------*/
@@ -0,0 +1,188 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_coalesce.c
+ * @brief Implements the writes of sample_azure_iot_adu_coalesce.h.
+ */
+
+#include <string.h>
+
+#include "sample_azure_iot_adu_coalesce.h"
+#include "azure_iot_flash_platform_sector.h"
+
+/* Demo Specific configs, for logging. */
+#include "demo_config.h"
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRoundUp( uint32_t ulValue,
+                            uint32_t ulMultiple )
+{
+    return ( ( ulValue + ulMultiple - 1U ) / ulMultiple ) * ulMultiple;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvWrite( SampleADUCoalesce_t * pxCoalesce,
+                                  uint32_t ulOffset,
+                                  uint8_t * pucData,
+                                  uint32_t ulLength )
+{
+    uint32_t ulWrittenEnd = prvRoundUp( ulOffset + ulLength, pxCoalesce->ulSectorSize );
+
+    pxCoalesce->ulBlocks++;
+
+    /* The port erased the sectors it wrote, they are not erased ahead. */
+    if( pxCoalesce->ulErasedOffset < ulWrittenEnd )
+    {
+        pxCoalesce->ulErasedOffset = ulWrittenEnd;
+    }
+
+    return AzureIoTPlatform_WriteBlock( pxCoalesce->pxImage, ulOffset, pucData, ulLength );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCoalesce_Init( SampleADUCoalesce_t * pxCoalesce,
+                                         AzureADUImage_t * pxImage,
+                                         uint32_t ulOffset,
+                                         uint32_t ulImageSize )
+{
+    uint32_t ulSectorSize;
+
+    if( ( pxCoalesce == NULL ) || ( pxImage == NULL ) )
+    {
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    ulSectorSize = AzureIoTPlatform_GetSectorSize( pxImage );
+
+    if( ( ulSectorSize == 0U ) || ( ( sampleaduCOALESCE_BLOCK_SIZE % ulSectorSize ) != 0U ) )
+    {
+        LogError( ( "[ADU] Blocks of %u bytes are not made of flash sectors of %u bytes.",
+                    ( unsigned int ) sampleaduCOALESCE_BLOCK_SIZE, ( unsigned int ) ulSectorSize ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxCoalesce->pxImage = pxImage;
+    pxCoalesce->ulSectorSize = ulSectorSize;
+    pxCoalesce->ulImageSize = ulImageSize;
+    pxCoalesce->ulBlockOffset = ulOffset;
+    pxCoalesce->ulBlockLength = 0;
+    pxCoalesce->ulErasedOffset = prvRoundUp( ulOffset, ulSectorSize );
+    pxCoalesce->ulChunks = 0;
+    pxCoalesce->ulBlocks = 0;
+    pxCoalesce->ulErasesAhead = 0;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCoalesce_Write( SampleADUCoalesce_t * pxCoalesce,
+                                          uint32_t ulOffset,
+                                          uint8_t * pucData,
+                                          uint32_t ulLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulCopied;
+    uint32_t ulEnd;
+
+    pxCoalesce->ulChunks++;
+
+    if( ulOffset != pxCoalesce->ulBlockOffset + pxCoalesce->ulBlockLength )
+    {
+        if( ( xResult = SampleADUCoalesce_Flush( pxCoalesce ) ) != eAzureIoTSuccess )
+        {
+            return xResult;
+        }
+
+        pxCoalesce->ulBlockOffset = ulOffset;
+    }
+
+    while( ulLength > 0U )
+    {
+        ulEnd = pxCoalesce->ulBlockOffset + pxCoalesce->ulBlockLength;
+
+        if( ( pxCoalesce->ulBlockLength == 0U ) &&
+            ( ( ulEnd % sampleaduCOALESCE_BLOCK_SIZE ) == 0U ) &&
+            ( ulLength >= sampleaduCOALESCE_BLOCK_SIZE ) )
+        {
+            /* The whole blocks are written without a copy. */
+            ulCopied = ulLength - ( ulLength % sampleaduCOALESCE_BLOCK_SIZE );
+
+            if( ( xResult = prvWrite( pxCoalesce, ulEnd, pucData, ulCopied ) ) != eAzureIoTSuccess )
+            {
+                return xResult;
+            }
+
+            pxCoalesce->ulBlockOffset += ulCopied;
+        }
+        else
+        {
+            /* Up to the next block boundary, which a block after a gap
+             * reaches sooner. */
+            ulCopied = sampleaduCOALESCE_BLOCK_SIZE - ( ulEnd % sampleaduCOALESCE_BLOCK_SIZE );
+            ulCopied = ( ulLength < ulCopied ) ? ulLength : ulCopied;
+            ( void ) memcpy( &pxCoalesce->ucBlock[ pxCoalesce->ulBlockLength ], pucData, ulCopied );
+            pxCoalesce->ulBlockLength += ulCopied;
+
+            if( ( ( ( ulEnd + ulCopied ) % sampleaduCOALESCE_BLOCK_SIZE ) == 0U ) &&
+                ( ( xResult = SampleADUCoalesce_Flush( pxCoalesce ) ) != eAzureIoTSuccess ) )
+            {
+                return xResult;
+            }
+        }
+
+        pucData += ulCopied;
+        ulLength -= ulCopied;
+    }
+
+    /* The end of the image completes no block. */
+    if( pxCoalesce->ulBlockOffset + pxCoalesce->ulBlockLength == pxCoalesce->ulImageSize )
+    {
+        return SampleADUCoalesce_Flush( pxCoalesce );
+    }
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCoalesce_EraseAhead( SampleADUCoalesce_t * pxCoalesce )
+{
+    uint32_t ulEnd = pxCoalesce->ulBlockOffset + pxCoalesce->ulBlockLength + sampleaduCOALESCE_ERASE_AHEAD_SIZE;
+    uint32_t ulImageEnd = prvRoundUp( pxCoalesce->ulImageSize, pxCoalesce->ulSectorSize );
+
+    ulEnd = ( ulEnd < ulImageEnd ) ? ulEnd : ulImageEnd;
+
+    while( pxCoalesce->ulErasedOffset < ulEnd )
+    {
+        if( AzureIoTPlatform_EraseSector( pxCoalesce->pxImage, pxCoalesce->ulErasedOffset ) != eAzureIoTSuccess )
+        {
+            LogWarn( ( "[ADU] Unable to erase the sector at offset %u ahead.", ( unsigned int ) pxCoalesce->ulErasedOffset ) );
+            return eAzureIoTErrorFailed;
+        }
+
+        pxCoalesce->ulErasedOffset += pxCoalesce->ulSectorSize;
+        pxCoalesce->ulErasesAhead++;
+    }
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCoalesce_Flush( SampleADUCoalesce_t * pxCoalesce )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxCoalesce->ulBlockLength == 0U )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    xResult = prvWrite( pxCoalesce, pxCoalesce->ulBlockOffset, pxCoalesce->ucBlock, pxCoalesce->ulBlockLength );
+
+    pxCoalesce->ulBlockOffset += pxCoalesce->ulBlockLength;
+    pxCoalesce->ulBlockLength = 0;
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,116 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_coalesce.h
+ *
+ * @brief Gathers the downloaded chunks into whole flash sectors.
+ *
+ * The chunks of a download end wherever the HTTP responses do, so writing
+ * them as they come programs the pages they share twice and leaves writes
+ * across the sectors. The chunks are instead copied into a block of
+ * #sampleaduCOALESCE_BLOCK_SIZE bytes which is written once it reaches a
+ * block boundary, and the parts of a chunk covering whole blocks are written
+ * from the chunk itself. Only the end of the image, or the data before a gap,
+ * is written in part.
+ *
+ * When the writes are ahead of the download, the sectors the next blocks are
+ * written to are erased with AzureIoTPlatform_EraseSector(), so the writes of
+ * the next chunks only program them. The flash port implements
+ * azure_iot_flash_platform_sector.h.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_ADU_COALESCE_H
+#define SAMPLE_AZURE_IOT_ADU_COALESCE_H
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+/**
+ * @brief Size of the blocks written to the flash, a multiple of the sector
+ * size of the port.
+ */
+#ifndef sampleaduCOALESCE_BLOCK_SIZE
+    #define sampleaduCOALESCE_BLOCK_SIZE    ( 4096U )
+#endif
+
+/**
+ * @brief How far past the data written the sectors are erased ahead.
+ */
+#ifndef sampleaduCOALESCE_ERASE_AHEAD_SIZE
+    #define sampleaduCOALESCE_ERASE_AHEAD_SIZE    ( 16384U )
+#endif
+
+/**
+ * @brief Writes of a download into the flash. Its fields are private, but for
+ * the counters.
+ */
+typedef struct SampleADUCoalesce
+{
+    AzureADUImage_t * pxImage;
+    uint32_t ulSectorSize;                         /**< Erase unit of the port. */
+    uint32_t ulImageSize;                          /**< Size of the image, the end of the writes. */
+    uint32_t ulBlockOffset;                        /**< Offset in the image of the block. */
+    uint32_t ulBlockLength;                        /**< Bytes of the block received. */
+    uint32_t ulErasedOffset;                       /**< End of the sectors erased ahead or written. */
+    uint8_t ucBlock[ sampleaduCOALESCE_BLOCK_SIZE ];
+    uint32_t ulChunks;                             /**< Chunks received. */
+    uint32_t ulBlocks;                             /**< Writes to the flash port. */
+    uint32_t ulErasesAhead;                        /**< Sectors erased ahead of their writes. */
+} SampleADUCoalesce_t;
+
+/**
+ * @brief Start gathering the writes of a download.
+ *
+ * @param[out] pxCoalesce The writes.
+ * @param[in] pxImage Image written, initialized with the flash port.
+ * @param[in] ulOffset Offset the download starts at, after the region a
+ * resumed download kept.
+ * @param[in] ulImageSize Size of the image.
+ * @return An #AzureIoTResult_t with the result of the operation, a failure
+ * when the sector size of the port does not divide the block size.
+ */
+AzureIoTResult_t SampleADUCoalesce_Init( SampleADUCoalesce_t * pxCoalesce,
+                                         AzureADUImage_t * pxImage,
+                                         uint32_t ulOffset,
+                                         uint32_t ulImageSize );
+
+/**
+ * @brief Write the next chunk of the image.
+ *
+ * The whole blocks are written, the rest is kept until its block is complete.
+ * The block ending the image is written as soon as it is received.
+ *
+ * @param[in] pxCoalesce The writes.
+ * @param[in] ulOffset Offset of the chunk in the image. A chunk not following
+ * the previous one writes the data kept first.
+ * @param[in] pucData The chunk.
+ * @param[in] ulLength Length of the chunk.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUCoalesce_Write( SampleADUCoalesce_t * pxCoalesce,
+                                          uint32_t ulOffset,
+                                          uint8_t * pucData,
+                                          uint32_t ulLength );
+
+/**
+ * @brief Erase the sectors up to #sampleaduCOALESCE_ERASE_AHEAD_SIZE bytes
+ * past the data received, and not past the image.
+ *
+ * @param[in] pxCoalesce The writes.
+ * @return An #AzureIoTResult_t with the result of the operation. A failure
+ * leaves the sectors to be erased by the writes.
+ */
+AzureIoTResult_t SampleADUCoalesce_EraseAhead( SampleADUCoalesce_t * pxCoalesce );
+
+/**
+ * @brief Write the data kept, at the end of a download.
+ *
+ * @param[in] pxCoalesce The writes.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUCoalesce_Flush( SampleADUCoalesce_t * pxCoalesce );
+
+#endif /* SAMPLE_AZURE_IOT_ADU_COALESCE_H */
@@ -0,0 +1,261 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_compressed.c
+ * @brief Implements the compressed payloads of sample_azure_iot_adu_compressed.h.
+ */
+
+#include <string.h>
+
+#include "mbedtls/base64.h"
+
+#include "sample_azure_iot_adu_compressed.h"
+
+/* Demo Specific configs, for logging. */
+#include "demo_config.h"
+
+#define sampleaduSHA256_SIZE    ( 32U )
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadLittleEndian32( const uint8_t * pucData )
+{
+    return ( uint32_t ) pucData[ 0 ] | ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) | ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvParseHeader( SampleADUCompressed_t * pxCompressed )
+{
+    const uint8_t * pucHeader = pxCompressed->ucHeader;
+
+    if( ( memcmp( pucHeader, sampleaduCOMPRESSED_MAGIC, sizeof( sampleaduCOMPRESSED_MAGIC ) - 1 ) != 0 ) ||
+        ( pucHeader[ 4 ] != sampleaduCOMPRESSED_VERSION ) )
+    {
+        LogError( ( "[ADU] Unsupported compressed payload." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( Heatshrink_Init( &pxCompressed->xDecoder, pucHeader[ 5 ], pucHeader[ 6 ] ) != eHeatshrinkSuccess )
+    {
+        LogError( ( "[ADU] Unsupported compression: window %u bits, lookahead %u bits.",
+                    ( unsigned int ) pucHeader[ 5 ], ( unsigned int ) pucHeader[ 6 ] ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxCompressed->ulImageSize = prvReadLittleEndian32( &pucHeader[ 8 ] );
+
+    LogInfo( ( "[ADU] Compressed payload of an image of %u bytes, window %u bits.",
+               ( unsigned int ) pxCompressed->ulImageSize, ( unsigned int ) pucHeader[ 5 ] ) );
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvWriteBlock( SampleADUCompressed_t * pxCompressed )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxCompressed->ulBlockLength == 0U )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    xResult = AzureIoTPlatform_WriteBlock( pxCompressed->pxImage,
+                                           pxCompressed->ulImageOffset,
+                                           pxCompressed->ucBlock,
+                                           pxCompressed->ulBlockLength );
+
+    pxCompressed->ulImageOffset += pxCompressed->ulBlockLength;
+    pxCompressed->ulBlockLength = 0;
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/* Decodes the data into blocks, and writes the full ones. With no data, the
+ * output left in the decoder is flushed. */
+static AzureIoTResult_t prvDecode( SampleADUCompressed_t * pxCompressed,
+                                   const uint8_t * pucData,
+                                   uint32_t ulLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulConsumed;
+    uint32_t ulProduced;
+
+    do
+    {
+        ( void ) Heatshrink_Decode( &pxCompressed->xDecoder, pucData, ulLength, &ulConsumed,
+                                    &pxCompressed->ucBlock[ pxCompressed->ulBlockLength ],
+                                    sizeof( pxCompressed->ucBlock ) - pxCompressed->ulBlockLength,
+                                    &ulProduced );
+        pucData += ulConsumed;
+        ulLength -= ulConsumed;
+        pxCompressed->ulBlockLength += ulProduced;
+
+        /* A payload decoding past its size is not written. */
+        if( ( pxCompressed->ulImageOffset + pxCompressed->ulBlockLength ) > pxCompressed->ulImageSize )
+        {
+            LogError( ( "[ADU] The compressed payload is larger than its image." ) );
+            return eAzureIoTErrorFailed;
+        }
+
+        if( ( pxCompressed->ulBlockLength == sizeof( pxCompressed->ucBlock ) ) &&
+            ( ( xResult = prvWriteBlock( pxCompressed ) ) != eAzureIoTSuccess ) )
+        {
+            return xResult;
+        }
+    } while( ( ulLength > 0U ) || ( ulProduced > 0U ) );
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+bool SampleADUCompressed_IsCompressed( const uint8_t * pucData,
+                                       uint32_t ulLength )
+{
+    return ( pucData != NULL ) && ( ulLength >= sizeof( sampleaduCOMPRESSED_MAGIC ) - 1 ) &&
+           ( memcmp( pucData, sampleaduCOMPRESSED_MAGIC, sizeof( sampleaduCOMPRESSED_MAGIC ) - 1 ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCompressed_Init( SampleADUCompressed_t * pxCompressed,
+                                           AzureADUImage_t * pxImage )
+{
+    if( ( pxCompressed == NULL ) || ( pxImage == NULL ) )
+    {
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    pxCompressed->pxImage = pxImage;
+    pxCompressed->ulPayloadLength = 0;
+    pxCompressed->ulHeaderLength = 0;
+    pxCompressed->ulImageSize = 0;
+    pxCompressed->ulImageOffset = 0;
+    pxCompressed->ulBlockLength = 0;
+
+    mbedtls_md_init( &pxCompressed->xPayloadSHA256 );
+
+    if( ( mbedtls_md_setup( &pxCompressed->xPayloadSHA256, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 ) != 0 ) ||
+        ( mbedtls_md_starts( &pxCompressed->xPayloadSHA256 ) != 0 ) )
+    {
+        mbedtls_md_free( &pxCompressed->xPayloadSHA256 );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCompressed_Write( SampleADUCompressed_t * pxCompressed,
+                                            const uint8_t * pucData,
+                                            uint32_t ulLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulCopied;
+
+    ( void ) mbedtls_md_update( &pxCompressed->xPayloadSHA256, pucData, ulLength );
+    pxCompressed->ulPayloadLength += ulLength;
+
+    /* The header can be split across chunks. */
+    if( pxCompressed->ulHeaderLength < sampleaduCOMPRESSED_HEADER_SIZE )
+    {
+        ulCopied = sampleaduCOMPRESSED_HEADER_SIZE - pxCompressed->ulHeaderLength;
+        ulCopied = ( ulLength < ulCopied ) ? ulLength : ulCopied;
+        ( void ) memcpy( &pxCompressed->ucHeader[ pxCompressed->ulHeaderLength ], pucData, ulCopied );
+        pxCompressed->ulHeaderLength += ulCopied;
+        pucData += ulCopied;
+        ulLength -= ulCopied;
+
+        if( pxCompressed->ulHeaderLength < sampleaduCOMPRESSED_HEADER_SIZE )
+        {
+            return eAzureIoTSuccess;
+        }
+
+        xResult = prvParseHeader( pxCompressed );
+    }
+    else
+    {
+        xResult = eAzureIoTSuccess;
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = prvDecode( pxCompressed, pucData, ulLength );
+    }
+
+    /* The payload is abandoned. */
+    if( xResult != eAzureIoTSuccess )
+    {
+        mbedtls_md_free( &pxCompressed->xPayloadSHA256 );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUCompressed_Finish( SampleADUCompressed_t * pxCompressed,
+                                             const uint8_t * pucPayloadHash,
+                                             uint32_t ulPayloadHashLength )
+{
+    AzureIoTResult_t xResult;
+    uint8_t ucExpectedHash[ sampleaduSHA256_SIZE ];
+    uint8_t ucPayloadHash[ sampleaduSHA256_SIZE ];
+    size_t xHashLength;
+
+    if( pxCompressed->ulHeaderLength == sampleaduCOMPRESSED_HEADER_SIZE )
+    {
+        xResult = prvDecode( pxCompressed, NULL, 0 );
+    }
+    else
+    {
+        xResult = eAzureIoTSuccess;
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = prvWriteBlock( pxCompressed );
+    }
+
+    ( void ) mbedtls_md_finish( &pxCompressed->xPayloadSHA256, ucPayloadHash );
+    mbedtls_md_free( &pxCompressed->xPayloadSHA256 );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        return xResult;
+    }
+
+    if( ( pxCompressed->ulHeaderLength != sampleaduCOMPRESSED_HEADER_SIZE ) ||
+        ( pxCompressed->ulImageOffset != pxCompressed->ulImageSize ) )
+    {
+        LogError( ( "[ADU] The compressed payload holds %u bytes of an image of %u bytes.",
+                    ( unsigned int ) pxCompressed->ulImageOffset, ( unsigned int ) pxCompressed->ulImageSize ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( ( mbedtls_base64_decode( ucExpectedHash, sizeof( ucExpectedHash ), &xHashLength,
+                                 pucPayloadHash, ulPayloadHashLength ) != 0 ) ||
+        ( xHashLength != sizeof( ucExpectedHash ) ) ||
+        ( memcmp( ucExpectedHash, ucPayloadHash, sizeof( ucPayloadHash ) ) != 0 ) )
+    {
+        LogError( ( "[ADU] The compressed payload does not match the hash of the manifest." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    LogInfo( ( "[ADU] Decompressed %u bytes into an image of %u bytes.",
+               ( unsigned int ) pxCompressed->ulPayloadLength, ( unsigned int ) pxCompressed->ulImageSize ) );
+
+    /* The size type differs between the ports. */
+    pxCompressed->pxImage->ulImageFileSize = pxCompressed->ulImageSize;
+    pxCompressed->pxImage->ulCurrentOffset = pxCompressed->ulImageSize;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+uint8_t * SampleADUCompressed_GetImageHash( SampleADUCompressed_t * pxCompressed )
+{
+    return &pxCompressed->ucHeader[ 12 ];
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,149 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_compressed.h
+ *
+ * @brief Writes a compressed update payload into the flash as it downloads.
+ *
+ * A compressed payload is a header followed by the image compressed in the
+ * heatshrink format:
+ *
+ * | Offset | Size | Field                                          |
+ * |--------|------|------------------------------------------------|
+ * | 0      | 4    | "AZHS"                                         |
+ * | 4      | 1    | Version, 1                                     |
+ * | 5      | 1    | Window bits                                    |
+ * | 6      | 1    | Lookahead bits                                 |
+ * | 7      | 1    | 0                                              |
+ * | 8      | 4    | Size of the image, little endian               |
+ * | 12     | 44   | SHA-256 of the image, base64 encoded           |
+ *
+ * The payload is decompressed into blocks of #sampleaduCOMPRESSED_BLOCK_SIZE
+ * bytes written with AzureIoTPlatform_WriteBlock(), so the flash port hashes
+ * the image itself. The SHA-256 of the payload, which the update manifest
+ * carries, is computed as it is received and checks the header, including the
+ * hash of the image the flash is then verified against.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_ADU_COMPRESSED_H
+#define SAMPLE_AZURE_IOT_ADU_COMPRESSED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mbedtls/md.h"
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+#include "azure_sample_heatshrink.h"
+
+/**
+ * @brief First bytes of a compressed payload.
+ */
+#define sampleaduCOMPRESSED_MAGIC               "AZHS"
+
+/**
+ * @brief Version of the header.
+ */
+#define sampleaduCOMPRESSED_VERSION             ( 1U )
+
+/**
+ * @brief Length of the base64 encoded SHA-256 of the image.
+ */
+#define sampleaduCOMPRESSED_IMAGE_HASH_SIZE     ( 44U )
+
+/**
+ * @brief Size of the header.
+ */
+#define sampleaduCOMPRESSED_HEADER_SIZE         ( 12U + sampleaduCOMPRESSED_IMAGE_HASH_SIZE )
+
+/**
+ * @brief Size of the blocks written to the flash, a multiple of the flash
+ * sector size keeps the writes aligned.
+ */
+#ifndef sampleaduCOMPRESSED_BLOCK_SIZE
+    #define sampleaduCOMPRESSED_BLOCK_SIZE      ( 4096U )
+#endif
+
+/**
+ * @brief State of the decompression of a payload. Its fields are private.
+ */
+typedef struct SampleADUCompressed
+{
+    AzureADUImage_t * pxImage;
+    mbedtls_md_context_t xPayloadSHA256;                      /**< SHA-256 of the payload received. */
+    uint32_t ulPayloadLength;                                 /**< Length of the payload received. */
+    uint8_t ucHeader[ sampleaduCOMPRESSED_HEADER_SIZE ];
+    uint32_t ulHeaderLength;                                  /**< Bytes of the header received. */
+    uint32_t ulImageSize;                                     /**< Size of the image, from the header. */
+    uint32_t ulImageOffset;                                   /**< Bytes of the image written to the flash. */
+    HeatshrinkDecoder_t xDecoder;
+    uint8_t ucBlock[ sampleaduCOMPRESSED_BLOCK_SIZE ];
+    uint32_t ulBlockLength;                                   /**< Bytes of the image decoded in the block. */
+} SampleADUCompressed_t;
+
+/**
+ * @brief Whether the first chunk of a payload starts a compressed payload.
+ *
+ * @param[in] pucData First chunk of the payload.
+ * @param[in] ulLength Length of the chunk.
+ * @return true when the chunk starts with #sampleaduCOMPRESSED_MAGIC.
+ */
+bool SampleADUCompressed_IsCompressed( const uint8_t * pucData,
+                                       uint32_t ulLength );
+
+/**
+ * @brief Start the decompression of a payload.
+ *
+ * @param[out] pxCompressed The decompression.
+ * @param[in] pxImage Image the payload is written to, initialized with the
+ * flash port.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUCompressed_Init( SampleADUCompressed_t * pxCompressed,
+                                           AzureADUImage_t * pxImage );
+
+/**
+ * @brief Decompress the next chunk of the payload into the flash.
+ *
+ * On failure the payload is abandoned, SampleADUCompressed_Finish() must not
+ * be called.
+ *
+ * @param[in] pxCompressed The decompression.
+ * @param[in] pucData Next chunk of the payload, in order.
+ * @param[in] ulLength Length of the chunk.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUCompressed_Write( SampleADUCompressed_t * pxCompressed,
+                                            const uint8_t * pucData,
+                                            uint32_t ulLength );
+
+/**
+ * @brief Write the end of the image and check the payload.
+ *
+ * Once the payload matches its hash from the update manifest, the image has
+ * the size of the header: the flash holds the whole image and is verified
+ * against SampleADUCompressed_GetImageHash(). It also releases a payload
+ * whose download did not complete.
+ *
+ * @param[in] pxCompressed The decompression.
+ * @param[in] pucPayloadHash Base64 encoded SHA-256 of the payload.
+ * @param[in] ulPayloadHashLength Length of the hash.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUCompressed_Finish( SampleADUCompressed_t * pxCompressed,
+                                             const uint8_t * pucPayloadHash,
+                                             uint32_t ulPayloadHashLength );
+
+/**
+ * @brief Base64 encoded SHA-256 of the image, valid after
+ * SampleADUCompressed_Finish() succeeded.
+ *
+ * @param[in] pxCompressed The decompression.
+ * @return The #sampleaduCOMPRESSED_IMAGE_HASH_SIZE characters of the hash.
+ */
+uint8_t * SampleADUCompressed_GetImageHash( SampleADUCompressed_t * pxCompressed );
+
+#endif /* SAMPLE_AZURE_IOT_ADU_COMPRESSED_H */
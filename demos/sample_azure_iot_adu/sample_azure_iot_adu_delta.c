@@ -0,0 +1,468 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_delta.c
+ * @brief Implements the delta payloads of sample_azure_iot_adu_delta.h.
+ */
+
+#include <string.h>
+
+#include "mbedtls/base64.h"
+
+#include "sample_azure_iot_adu_delta.h"
+#include "azure_iot_flash_platform_delta.h"
+
+/* Demo Specific configs, for logging. */
+#include "demo_config.h"
+
+#define sampleaduSHA256_SIZE           ( 32U )
+
+#define sampleaduDELTA_STATE_CONTROL    ( 0U )
+#define sampleaduDELTA_STATE_DIFF       ( 1U )
+#define sampleaduDELTA_STATE_EXTRA      ( 2U )
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadLittleEndian32( const uint8_t * pucData )
+{
+    return ( uint32_t ) pucData[ 0 ] | ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucData[ 2 ] << 16 ) | ( ( uint32_t ) pucData[ 3 ] << 24 );
+}
+/*-----------------------------------------------------------*/
+
+/* A patch only applies to the image it was made from. */
+static AzureIoTResult_t prvCheckRunningImage( SampleADUDelta_t * pxDelta )
+{
+    mbedtls_md_context_t xContext;
+    uint8_t ucExpectedHash[ sampleaduSHA256_SIZE ];
+    uint8_t ucHash[ sampleaduSHA256_SIZE ];
+    size_t xHashLength;
+    uint32_t ulOffset;
+    uint32_t ulLength;
+    int lResult;
+
+    if( ( mbedtls_base64_decode( ucExpectedHash, sizeof( ucExpectedHash ), &xHashLength,
+                                 &pxDelta->ucHeader[ 16 ], sampleaduDELTA_IMAGE_HASH_SIZE ) != 0 ) ||
+        ( xHashLength != sizeof( ucExpectedHash ) ) )
+    {
+        return eAzureIoTErrorFailed;
+    }
+
+    mbedtls_md_init( &xContext );
+    lResult = mbedtls_md_setup( &xContext, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 );
+    lResult = ( lResult == 0 ) ? mbedtls_md_starts( &xContext ) : lResult;
+
+    /* The block is empty until the patch is applied. */
+    for( ulOffset = 0; ( lResult == 0 ) && ( ulOffset < pxDelta->ulSourceSize ); ulOffset += ulLength )
+    {
+        ulLength = pxDelta->ulSourceSize - ulOffset;
+        ulLength = ( ulLength < sizeof( pxDelta->ucBlock ) ) ? ulLength : sizeof( pxDelta->ucBlock );
+
+        if( AzureIoTPlatform_ReadRunningImage( pxDelta->pxImage, ulOffset, pxDelta->ucBlock, ulLength ) != eAzureIoTSuccess )
+        {
+            lResult = -1;
+        }
+        else
+        {
+            lResult = mbedtls_md_update( &xContext, pxDelta->ucBlock, ulLength );
+        }
+    }
+
+    lResult = ( lResult == 0 ) ? mbedtls_md_finish( &xContext, ucHash ) : lResult;
+    mbedtls_md_free( &xContext );
+
+    return ( ( lResult == 0 ) && ( memcmp( ucHash, ucExpectedHash, sizeof( ucHash ) ) == 0 ) ) ?
+           eAzureIoTSuccess : eAzureIoTErrorFailed;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvParseHeader( SampleADUDelta_t * pxDelta )
+{
+    const uint8_t * pucHeader = pxDelta->ucHeader;
+
+    if( ( memcmp( pucHeader, sampleaduDELTA_MAGIC, sizeof( sampleaduDELTA_MAGIC ) - 1 ) != 0 ) ||
+        ( pucHeader[ 4 ] != sampleaduDELTA_VERSION ) )
+    {
+        LogError( ( "[ADU] Unsupported delta payload." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxDelta->xCompressed = ( pucHeader[ 5 ] != 0U );
+
+    if( pxDelta->xCompressed &&
+        ( Heatshrink_Init( &pxDelta->xDecoder, pucHeader[ 5 ], pucHeader[ 6 ] ) != eHeatshrinkSuccess ) )
+    {
+        LogError( ( "[ADU] Unsupported compression: window %u bits, lookahead %u bits.",
+                    ( unsigned int ) pucHeader[ 5 ], ( unsigned int ) pucHeader[ 6 ] ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxDelta->ulSourceSize = prvReadLittleEndian32( &pucHeader[ 8 ] );
+    pxDelta->ulImageSize = prvReadLittleEndian32( &pucHeader[ 12 ] );
+
+    LogInfo( ( "[ADU] Delta payload from an image of %u bytes to an image of %u bytes.",
+               ( unsigned int ) pxDelta->ulSourceSize, ( unsigned int ) pxDelta->ulImageSize ) );
+
+    if( prvCheckRunningImage( pxDelta ) != eAzureIoTSuccess )
+    {
+        LogError( ( "[ADU] The delta payload does not apply to the running image." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvWriteBlock( SampleADUDelta_t * pxDelta )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxDelta->ulBlockLength == 0U )
+    {
+        return eAzureIoTSuccess;
+    }
+
+    xResult = AzureIoTPlatform_WriteBlock( pxDelta->pxImage,
+                                           pxDelta->ulImageOffset,
+                                           pxDelta->ucBlock,
+                                           pxDelta->ulBlockLength );
+
+    pxDelta->ulImageOffset += pxDelta->ulBlockLength;
+    pxDelta->ulBlockLength = 0;
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/* Reads the record header once complete, the lengths must fit the images. */
+static AzureIoTResult_t prvParseControl( SampleADUDelta_t * pxDelta )
+{
+    uint64_t ullImageEnd;
+
+    pxDelta->ulDiffLength = prvReadLittleEndian32( &pxDelta->ucControl[ 0 ] );
+    pxDelta->ulExtraLength = prvReadLittleEndian32( &pxDelta->ucControl[ 4 ] );
+    pxDelta->lSourceAdjustment = ( int32_t ) prvReadLittleEndian32( &pxDelta->ucControl[ 8 ] );
+    pxDelta->ulControlLength = 0;
+
+    ullImageEnd = ( uint64_t ) pxDelta->ulImageOffset + pxDelta->ulBlockLength +
+                  pxDelta->ulDiffLength + pxDelta->ulExtraLength;
+
+    if( ( ullImageEnd > pxDelta->ulImageSize ) ||
+        ( ( ( uint64_t ) pxDelta->ulSourceOffset + pxDelta->ulDiffLength ) > pxDelta->ulSourceSize ) )
+    {
+        LogError( ( "[ADU] The delta payload is malformed." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    pxDelta->ucState = sampleaduDELTA_STATE_DIFF;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+/* The running image around the source offset, at most ulLength bytes. */
+static const uint8_t * prvGetSource( SampleADUDelta_t * pxDelta,
+                                     uint32_t * pulLength )
+{
+    uint32_t ulOffset = pxDelta->ulSourceOffset;
+    uint32_t ulRead;
+
+    if( ( ulOffset < pxDelta->ulSourceBufferOffset ) ||
+        ( ulOffset >= pxDelta->ulSourceBufferOffset + pxDelta->ulSourceBufferLength ) )
+    {
+        ulRead = pxDelta->ulSourceSize - ulOffset;
+        ulRead = ( ulRead < sizeof( pxDelta->ucSource ) ) ? ulRead : sizeof( pxDelta->ucSource );
+
+        if( AzureIoTPlatform_ReadRunningImage( pxDelta->pxImage, ulOffset, pxDelta->ucSource, ulRead ) != eAzureIoTSuccess )
+        {
+            LogError( ( "[ADU] Unable to read the running image at offset %u.", ( unsigned int ) ulOffset ) );
+            return NULL;
+        }
+
+        pxDelta->ulSourceBufferOffset = ulOffset;
+        pxDelta->ulSourceBufferLength = ulRead;
+    }
+
+    ulRead = pxDelta->ulSourceBufferOffset + pxDelta->ulSourceBufferLength - ulOffset;
+    *pulLength = ( *pulLength < ulRead ) ? *pulLength : ulRead;
+
+    return &pxDelta->ucSource[ ulOffset - pxDelta->ulSourceBufferOffset ];
+}
+/*-----------------------------------------------------------*/
+
+/* Applies patch bytes, writing the blocks of the new image as they fill. */
+static AzureIoTResult_t prvApplyPatch( SampleADUDelta_t * pxDelta,
+                                       const uint8_t * pucPatch,
+                                       uint32_t ulLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    const uint8_t * pucSource;
+    uint8_t * pucBlock;
+    uint32_t ulCount;
+    uint32_t ulIndex;
+    int64_t llSourceOffset;
+
+    while( ( xResult == eAzureIoTSuccess ) && ( ulLength > 0U ) )
+    {
+        ulCount = sizeof( pxDelta->ucBlock ) - pxDelta->ulBlockLength;
+        pucBlock = &pxDelta->ucBlock[ pxDelta->ulBlockLength ];
+
+        switch( pxDelta->ucState )
+        {
+            case sampleaduDELTA_STATE_CONTROL:
+                ulCount = sampleaduDELTA_CONTROL_SIZE - pxDelta->ulControlLength;
+                ulCount = ( ulLength < ulCount ) ? ulLength : ulCount;
+                ( void ) memcpy( &pxDelta->ucControl[ pxDelta->ulControlLength ], pucPatch, ulCount );
+                pxDelta->ulControlLength += ulCount;
+
+                if( pxDelta->ulControlLength == sampleaduDELTA_CONTROL_SIZE )
+                {
+                    xResult = prvParseControl( pxDelta );
+                }
+
+                break;
+
+            case sampleaduDELTA_STATE_DIFF:
+
+                if( pxDelta->ulDiffLength == 0U )
+                {
+                    pxDelta->ucState = sampleaduDELTA_STATE_EXTRA;
+                    continue;
+                }
+
+                ulCount = ( ulLength < ulCount ) ? ulLength : ulCount;
+                ulCount = ( pxDelta->ulDiffLength < ulCount ) ? pxDelta->ulDiffLength : ulCount;
+
+                if( ( pucSource = prvGetSource( pxDelta, &ulCount ) ) == NULL )
+                {
+                    xResult = eAzureIoTErrorFailed;
+                    break;
+                }
+
+                for( ulIndex = 0; ulIndex < ulCount; ulIndex++ )
+                {
+                    pucBlock[ ulIndex ] = ( uint8_t ) ( pucSource[ ulIndex ] + pucPatch[ ulIndex ] );
+                }
+
+                pxDelta->ulSourceOffset += ulCount;
+                pxDelta->ulDiffLength -= ulCount;
+                pxDelta->ulBlockLength += ulCount;
+                break;
+
+            default:
+
+                if( pxDelta->ulExtraLength == 0U )
+                {
+                    llSourceOffset = ( int64_t ) pxDelta->ulSourceOffset + pxDelta->lSourceAdjustment;
+
+                    if( ( llSourceOffset < 0 ) || ( llSourceOffset > ( int64_t ) pxDelta->ulSourceSize ) )
+                    {
+                        LogError( ( "[ADU] The delta payload is malformed." ) );
+                        xResult = eAzureIoTErrorFailed;
+                        break;
+                    }
+
+                    pxDelta->ulSourceOffset = ( uint32_t ) llSourceOffset;
+                    pxDelta->ucState = sampleaduDELTA_STATE_CONTROL;
+                    continue;
+                }
+
+                ulCount = ( ulLength < ulCount ) ? ulLength : ulCount;
+                ulCount = ( pxDelta->ulExtraLength < ulCount ) ? pxDelta->ulExtraLength : ulCount;
+                ( void ) memcpy( pucBlock, pucPatch, ulCount );
+                pxDelta->ulExtraLength -= ulCount;
+                pxDelta->ulBlockLength += ulCount;
+                break;
+        }
+
+        pucPatch += ulCount;
+        ulLength -= ulCount;
+
+        if( ( xResult == eAzureIoTSuccess ) && ( pxDelta->ulBlockLength == sizeof( pxDelta->ucBlock ) ) )
+        {
+            xResult = prvWriteBlock( pxDelta );
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/* Decompresses the patch and applies it. With no data, the output left in
+ * the decoder is flushed. */
+static AzureIoTResult_t prvDecode( SampleADUDelta_t * pxDelta,
+                                   const uint8_t * pucData,
+                                   uint32_t ulLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint32_t ulConsumed;
+    uint32_t ulProduced;
+
+    do
+    {
+        ( void ) Heatshrink_Decode( &pxDelta->xDecoder, pucData, ulLength, &ulConsumed,
+                                    pxDelta->ucPatch, sizeof( pxDelta->ucPatch ), &ulProduced );
+        pucData += ulConsumed;
+        ulLength -= ulConsumed;
+
+        xResult = prvApplyPatch( pxDelta, pxDelta->ucPatch, ulProduced );
+    } while( ( xResult == eAzureIoTSuccess ) && ( ( ulLength > 0U ) || ( ulProduced > 0U ) ) );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+bool SampleADUDelta_IsDelta( const uint8_t * pucData,
+                             uint32_t ulLength )
+{
+    return ( pucData != NULL ) && ( ulLength >= sizeof( sampleaduDELTA_MAGIC ) - 1 ) &&
+           ( memcmp( pucData, sampleaduDELTA_MAGIC, sizeof( sampleaduDELTA_MAGIC ) - 1 ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUDelta_Init( SampleADUDelta_t * pxDelta,
+                                      AzureADUImage_t * pxImage )
+{
+    if( ( pxDelta == NULL ) || ( pxImage == NULL ) )
+    {
+        return eAzureIoTErrorInvalidArgument;
+    }
+
+    pxDelta->pxImage = pxImage;
+    pxDelta->ulPayloadLength = 0;
+    pxDelta->ulHeaderLength = 0;
+    pxDelta->ulSourceSize = 0;
+    pxDelta->ulImageSize = 0;
+    pxDelta->ulImageOffset = 0;
+    pxDelta->ucState = sampleaduDELTA_STATE_CONTROL;
+    pxDelta->ulControlLength = 0;
+    pxDelta->ulDiffLength = 0;
+    pxDelta->ulExtraLength = 0;
+    pxDelta->lSourceAdjustment = 0;
+    pxDelta->ulSourceOffset = 0;
+    pxDelta->ulSourceBufferOffset = 0;
+    pxDelta->ulSourceBufferLength = 0;
+    pxDelta->ulBlockLength = 0;
+
+    mbedtls_md_init( &pxDelta->xPayloadSHA256 );
+
+    if( ( mbedtls_md_setup( &pxDelta->xPayloadSHA256, mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ), 0 ) != 0 ) ||
+        ( mbedtls_md_starts( &pxDelta->xPayloadSHA256 ) != 0 ) )
+    {
+        mbedtls_md_free( &pxDelta->xPayloadSHA256 );
+        return eAzureIoTErrorFailed;
+    }
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUDelta_Write( SampleADUDelta_t * pxDelta,
+                                       const uint8_t * pucData,
+                                       uint32_t ulLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulCopied;
+
+    ( void ) mbedtls_md_update( &pxDelta->xPayloadSHA256, pucData, ulLength );
+    pxDelta->ulPayloadLength += ulLength;
+
+    /* The header can be split across chunks. */
+    if( pxDelta->ulHeaderLength < sampleaduDELTA_HEADER_SIZE )
+    {
+        ulCopied = sampleaduDELTA_HEADER_SIZE - pxDelta->ulHeaderLength;
+        ulCopied = ( ulLength < ulCopied ) ? ulLength : ulCopied;
+        ( void ) memcpy( &pxDelta->ucHeader[ pxDelta->ulHeaderLength ], pucData, ulCopied );
+        pxDelta->ulHeaderLength += ulCopied;
+        pucData += ulCopied;
+        ulLength -= ulCopied;
+
+        if( pxDelta->ulHeaderLength < sampleaduDELTA_HEADER_SIZE )
+        {
+            return eAzureIoTSuccess;
+        }
+
+        xResult = prvParseHeader( pxDelta );
+    }
+    else
+    {
+        xResult = eAzureIoTSuccess;
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = pxDelta->xCompressed ? prvDecode( pxDelta, pucData, ulLength ) :
+                  prvApplyPatch( pxDelta, pucData, ulLength );
+    }
+
+    /* The payload is abandoned. */
+    if( xResult != eAzureIoTSuccess )
+    {
+        mbedtls_md_free( &pxDelta->xPayloadSHA256 );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUDelta_Finish( SampleADUDelta_t * pxDelta,
+                                        const uint8_t * pucPayloadHash,
+                                        uint32_t ulPayloadHashLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint8_t ucExpectedHash[ sampleaduSHA256_SIZE ];
+    uint8_t ucPayloadHash[ sampleaduSHA256_SIZE ];
+    size_t xHashLength;
+
+    if( ( pxDelta->ulHeaderLength == sampleaduDELTA_HEADER_SIZE ) && pxDelta->xCompressed )
+    {
+        xResult = prvDecode( pxDelta, NULL, 0 );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        xResult = prvWriteBlock( pxDelta );
+    }
+
+    ( void ) mbedtls_md_finish( &pxDelta->xPayloadSHA256, ucPayloadHash );
+    mbedtls_md_free( &pxDelta->xPayloadSHA256 );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        return xResult;
+    }
+
+    if( ( pxDelta->ulHeaderLength != sampleaduDELTA_HEADER_SIZE ) ||
+        ( pxDelta->ulImageOffset != pxDelta->ulImageSize ) )
+    {
+        LogError( ( "[ADU] The delta payload holds %u bytes of an image of %u bytes.",
+                    ( unsigned int ) pxDelta->ulImageOffset, ( unsigned int ) pxDelta->ulImageSize ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    if( ( mbedtls_base64_decode( ucExpectedHash, sizeof( ucExpectedHash ), &xHashLength,
+                                 pucPayloadHash, ulPayloadHashLength ) != 0 ) ||
+        ( xHashLength != sizeof( ucExpectedHash ) ) ||
+        ( memcmp( ucExpectedHash, ucPayloadHash, sizeof( ucPayloadHash ) ) != 0 ) )
+    {
+        LogError( ( "[ADU] The delta payload does not match the hash of the manifest." ) );
+        return eAzureIoTErrorFailed;
+    }
+
+    LogInfo( ( "[ADU] Rebuilt an image of %u bytes from a delta payload of %u bytes.",
+               ( unsigned int ) pxDelta->ulImageSize, ( unsigned int ) pxDelta->ulPayloadLength ) );
+
+    /* The size type differs between the ports. */
+    pxDelta->pxImage->ulImageFileSize = pxDelta->ulImageSize;
+    pxDelta->pxImage->ulCurrentOffset = pxDelta->ulImageSize;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+uint8_t * SampleADUDelta_GetImageHash( SampleADUDelta_t * pxDelta )
+{
+    return &pxDelta->ucHeader[ 16 + sampleaduDELTA_IMAGE_HASH_SIZE ];
+}
+/*-----------------------------------------------------------*/
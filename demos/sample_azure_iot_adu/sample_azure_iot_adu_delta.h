@@ -0,0 +1,194 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_delta.h
+ *
+ * @brief Rebuilds the new image from the running image and a delta payload,
+ * as it downloads.
+ *
+ * A delta payload is a header followed by a patch, compressed in the
+ * heatshrink format unless its window bits are 0:
+ *
+ * | Offset | Size | Field                                          |
+ * |--------|------|------------------------------------------------|
+ * | 0      | 4    | "AZDP"                                         |
+ * | 4      | 1    | Version, 1                                     |
+ * | 5      | 1    | Window bits, 0 when the patch is not compressed|
+ * | 6      | 1    | Lookahead bits                                 |
+ * | 7      | 1    | 0                                              |
+ * | 8      | 4    | Size of the running image, little endian       |
+ * | 12     | 4    | Size of the new image, little endian           |
+ * | 16     | 44   | SHA-256 of the running image, base64 encoded   |
+ * | 60     | 44   | SHA-256 of the new image, base64 encoded       |
+ *
+ * The patch is a list of records, in the manner of bsdiff:
+ *
+ * | Size | Field                                                         |
+ * |------|---------------------------------------------------------------|
+ * | 4    | Diff length, little endian                                    |
+ * | 4    | Extra length, little endian                                   |
+ * | 4    | Signed adjustment of the source offset after the record       |
+ * | diff | Bytes added to the running image from the source offset       |
+ * | extra| Bytes of the new image                                        |
+ *
+ * The running image is read with AzureIoTPlatform_ReadRunningImage() and
+ * checked against its hash before the patch is applied. The new image is
+ * written in blocks of #sampleaduDELTA_BLOCK_SIZE bytes with
+ * AzureIoTPlatform_WriteBlock(), and verified against its hash from the
+ * header once the payload matches the hash of the update manifest.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_ADU_DELTA_H
+#define SAMPLE_AZURE_IOT_ADU_DELTA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mbedtls/md.h"
+
+#include "azure_iot_result.h"
+#include "azure_iot_flash_platform.h"
+
+#include "azure_sample_heatshrink.h"
+
+/**
+ * @brief First bytes of a delta payload.
+ */
+#define sampleaduDELTA_MAGIC                 "AZDP"
+
+/**
+ * @brief Version of the header.
+ */
+#define sampleaduDELTA_VERSION               ( 1U )
+
+/**
+ * @brief Length of the base64 encoded SHA-256 of an image.
+ */
+#define sampleaduDELTA_IMAGE_HASH_SIZE       ( 44U )
+
+/**
+ * @brief Size of the header.
+ */
+#define sampleaduDELTA_HEADER_SIZE           ( 16U + 2U * sampleaduDELTA_IMAGE_HASH_SIZE )
+
+/**
+ * @brief Size of a record header of the patch.
+ */
+#define sampleaduDELTA_CONTROL_SIZE          ( 12U )
+
+/**
+ * @brief Size of the blocks written to the flash, a multiple of the flash
+ * sector size keeps the writes aligned.
+ */
+#ifndef sampleaduDELTA_BLOCK_SIZE
+    #define sampleaduDELTA_BLOCK_SIZE        ( 4096U )
+#endif
+
+/**
+ * @brief Size of the reads of the running image.
+ */
+#ifndef sampleaduDELTA_SOURCE_BUFFER_SIZE
+    #define sampleaduDELTA_SOURCE_BUFFER_SIZE    ( 1024U )
+#endif
+
+/**
+ * @brief Size of the buffer the patch is decompressed into.
+ */
+#ifndef sampleaduDELTA_PATCH_BUFFER_SIZE
+    #define sampleaduDELTA_PATCH_BUFFER_SIZE     ( 256U )
+#endif
+
+/**
+ * @brief State of the application of a delta payload. Its fields are private.
+ */
+typedef struct SampleADUDelta
+{
+    AzureADUImage_t * pxImage;
+    mbedtls_md_context_t xPayloadSHA256;                          /**< SHA-256 of the payload received. */
+    uint32_t ulPayloadLength;                                     /**< Length of the payload received. */
+    uint8_t ucHeader[ sampleaduDELTA_HEADER_SIZE ];
+    uint32_t ulHeaderLength;                                      /**< Bytes of the header received. */
+    uint32_t ulSourceSize;                                        /**< Size of the running image, from the header. */
+    uint32_t ulImageSize;                                         /**< Size of the new image, from the header. */
+    uint32_t ulImageOffset;                                       /**< Bytes of the new image written to the flash. */
+    bool xCompressed;                                             /**< Whether the patch is compressed. */
+    HeatshrinkDecoder_t xDecoder;
+    uint8_t ucPatch[ sampleaduDELTA_PATCH_BUFFER_SIZE ];          /**< Patch decompressed. */
+    uint8_t ucState;                                              /**< Part of the record being read. */
+    uint8_t ucControl[ sampleaduDELTA_CONTROL_SIZE ];
+    uint32_t ulControlLength;                                     /**< Bytes of the record header received. */
+    uint32_t ulDiffLength;                                        /**< Diff bytes left in the record. */
+    uint32_t ulExtraLength;                                       /**< Extra bytes left in the record. */
+    int32_t lSourceAdjustment;                                    /**< Applied at the end of the record. */
+    uint32_t ulSourceOffset;                                      /**< Offset of the next diff byte in the running image. */
+    uint8_t ucSource[ sampleaduDELTA_SOURCE_BUFFER_SIZE ];
+    uint32_t ulSourceBufferOffset;                                /**< Offset of ucSource in the running image. */
+    uint32_t ulSourceBufferLength;                                /**< Bytes of the running image in ucSource. */
+    uint8_t ucBlock[ sampleaduDELTA_BLOCK_SIZE ];
+    uint32_t ulBlockLength;                                       /**< Bytes of the new image in the block. */
+} SampleADUDelta_t;
+
+/**
+ * @brief Whether the first chunk of a payload starts a delta payload.
+ *
+ * @param[in] pucData First chunk of the payload.
+ * @param[in] ulLength Length of the chunk.
+ * @return true when the chunk starts with #sampleaduDELTA_MAGIC.
+ */
+bool SampleADUDelta_IsDelta( const uint8_t * pucData,
+                             uint32_t ulLength );
+
+/**
+ * @brief Start the application of a delta payload.
+ *
+ * @param[out] pxDelta The application.
+ * @param[in] pxImage Image the new image is written to, initialized with the
+ * flash port.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUDelta_Init( SampleADUDelta_t * pxDelta,
+                                      AzureADUImage_t * pxImage );
+
+/**
+ * @brief Apply the next chunk of the payload.
+ *
+ * The running image is hashed once the header is received. On failure the
+ * payload is abandoned, SampleADUDelta_Finish() must not be called.
+ *
+ * @param[in] pxDelta The application.
+ * @param[in] pucData Next chunk of the payload, in order.
+ * @param[in] ulLength Length of the chunk.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUDelta_Write( SampleADUDelta_t * pxDelta,
+                                       const uint8_t * pucData,
+                                       uint32_t ulLength );
+
+/**
+ * @brief Write the end of the new image and check the payload.
+ *
+ * Once the payload matches its hash from the update manifest, the image has
+ * the size of the new image, which is verified against
+ * SampleADUDelta_GetImageHash(). It also releases a payload whose download
+ * did not complete.
+ *
+ * @param[in] pxDelta The application.
+ * @param[in] pucPayloadHash Base64 encoded SHA-256 of the payload.
+ * @param[in] ulPayloadHashLength Length of the hash.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t SampleADUDelta_Finish( SampleADUDelta_t * pxDelta,
+                                        const uint8_t * pucPayloadHash,
+                                        uint32_t ulPayloadHashLength );
+
+/**
+ * @brief Base64 encoded SHA-256 of the new image, valid after
+ * SampleADUDelta_Finish() succeeded.
+ *
+ * @param[in] pxDelta The application.
+ * @return The #sampleaduDELTA_IMAGE_HASH_SIZE characters of the hash.
+ */
+uint8_t * SampleADUDelta_GetImageHash( SampleADUDelta_t * pxDelta );
+
+#endif /* SAMPLE_AZURE_IOT_ADU_DELTA_H */
@@ -0,0 +1,82 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_deployment.c
+ * @brief Implements the deployment identity of sample_azure_iot_adu_deployment.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_azure_iot_adu_deployment.h"
+
+/*-----------------------------------------------------------*/
+
+/* Writes the update id of a request as "provider:name:version", returns the
+ * length it needs. */
+static int prvFormatUpdateId( const AzureIoTADUUpdateRequest_t * pxRequest,
+                              char * pcBuffer,
+                              size_t xBufferSize )
+{
+    return snprintf( pcBuffer, xBufferSize, "%.*s:%.*s:%.*s",
+                     ( int ) pxRequest->xUpdateManifest.xUpdateId.ulProviderLength,
+                     pxRequest->xUpdateManifest.xUpdateId.pucProvider,
+                     ( int ) pxRequest->xUpdateManifest.xUpdateId.ulNameLength,
+                     pxRequest->xUpdateManifest.xUpdateId.pucName,
+                     ( int ) pxRequest->xUpdateManifest.xUpdateId.ulVersionLength,
+                     pxRequest->xUpdateManifest.xUpdateId.pucVersion );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t SampleADUDeployment_Save( SampleADUDeployment_t * pxDeployment,
+                                           const AzureIoTADUUpdateRequest_t * pxRequest )
+{
+    int lLength;
+
+    ( void ) memset( pxDeployment, 0, sizeof( *pxDeployment ) );
+
+    if( pxRequest->xWorkflow.ulIDLength > sizeof( pxDeployment->ucWorkflowId ) )
+    {
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    lLength = prvFormatUpdateId( pxRequest, pxDeployment->cUpdateId, sizeof( pxDeployment->cUpdateId ) );
+
+    if( ( lLength < 0 ) || ( ( size_t ) lLength >= sizeof( pxDeployment->cUpdateId ) ) )
+    {
+        return eAzureIoTErrorOutOfMemory;
+    }
+
+    ( void ) memcpy( pxDeployment->ucWorkflowId, pxRequest->xWorkflow.pucID, pxRequest->xWorkflow.ulIDLength );
+    pxDeployment->ulWorkflowIdLength = pxRequest->xWorkflow.ulIDLength;
+
+    return eAzureIoTSuccess;
+}
+/*-----------------------------------------------------------*/
+
+bool SampleADUDeployment_IsReplacedBy( const SampleADUDeployment_t * pxDeployment,
+                                       const AzureIoTADUUpdateRequest_t * pxRequest )
+{
+    char cUpdateId[ sampleaduDEPLOYMENT_UPDATE_ID_SIZE ];
+    int lLength;
+
+    /* A cancellation ends the deployment, it does not replace it. */
+    if( pxRequest->xWorkflow.xAction != eAzureIoTADUActionApplyDownload )
+    {
+        return false;
+    }
+
+    if( ( pxRequest->xWorkflow.ulIDLength != pxDeployment->ulWorkflowIdLength ) ||
+        ( memcmp( pxRequest->xWorkflow.pucID, pxDeployment->ucWorkflowId, pxDeployment->ulWorkflowIdLength ) != 0 ) )
+    {
+        return true;
+    }
+
+    /* A retry of the workflow may still carry another update. */
+    lLength = prvFormatUpdateId( pxRequest, cUpdateId, sizeof( cUpdateId ) );
+
+    return ( lLength < 0 ) || ( ( size_t ) lLength >= sizeof( cUpdateId ) ) ||
+           ( strcmp( cUpdateId, pxDeployment->cUpdateId ) != 0 );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,71 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_adu_deployment.h
+ *
+ * @brief Identity of the deployment a download belongs to.
+ *
+ * The update request is parsed into the same structure each time the ADU
+ * service writes the property, so a deployment which replaces the one being
+ * downloaded overwrites its request. The workflow id and the update id of the
+ * request are copied when the download starts, and compared with the request
+ * before the downloaded image is enabled or reported.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_ADU_DEPLOYMENT_H
+#define SAMPLE_AZURE_IOT_ADU_DEPLOYMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_adu_client.h"
+
+/**
+ * @brief Longest workflow id kept, the service sends a GUID.
+ */
+#ifndef sampleaduDEPLOYMENT_WORKFLOW_ID_SIZE
+    #define sampleaduDEPLOYMENT_WORKFLOW_ID_SIZE    ( 64U )
+#endif
+
+/**
+ * @brief Size of the update id kept, as "provider:name:version" with its
+ * terminating zero.
+ */
+#ifndef sampleaduDEPLOYMENT_UPDATE_ID_SIZE
+    #define sampleaduDEPLOYMENT_UPDATE_ID_SIZE    ( 192U )
+#endif
+
+/**
+ * @brief Deployment of a download.
+ */
+typedef struct SampleADUDeployment
+{
+    uint8_t ucWorkflowId[ sampleaduDEPLOYMENT_WORKFLOW_ID_SIZE ];
+    uint32_t ulWorkflowIdLength;
+    char cUpdateId[ sampleaduDEPLOYMENT_UPDATE_ID_SIZE ]; /**< "provider:name:version", also the key of the download checkpoints. */
+} SampleADUDeployment_t;
+
+/**
+ * @brief Keep the identity of the deployment of a request.
+ *
+ * @param[out] pxDeployment The deployment.
+ * @param[in] pxRequest The update request of the deployment.
+ * @return eAzureIoTErrorOutOfMemory if an id does not fit, eAzureIoTSuccess
+ * otherwise.
+ */
+AzureIoTResult_t SampleADUDeployment_Save( SampleADUDeployment_t * pxDeployment,
+                                           const AzureIoTADUUpdateRequest_t * pxRequest );
+
+/**
+ * @brief Tell whether a request is for another deployment than the one kept.
+ *
+ * @param[in] pxDeployment The deployment kept.
+ * @param[in] pxRequest The last update request received.
+ * @return true if the request applies another workflow or another update.
+ */
+bool SampleADUDeployment_IsReplacedBy( const SampleADUDeployment_t * pxDeployment,
+                                       const AzureIoTADUUpdateRequest_t * pxRequest );
+
+#endif /* SAMPLE_AZURE_IOT_ADU_DEPLOYMENT_H */
@@ -26,8 +26,9 @@
 #include "azure_sample_crypto.h"
 
 #include "azure_ca_recovery_rsa_verify.h"
-#include "azure_ca_recovery_parse.h"
+#include "azure_ca_recovery_stream.h"
 #include "azure_ca_recovery_storage.h"
+#include "azure_ca_recovery_trust_bundle.h"
 #include "azure_iot_jws.h"
 
 /*-----------------------------------------------------------*/
@@ -139,6 +140,11 @@ uint64_t ullGetUnixTime( void );
     static uint8_t ucSampleIotHubHostname[ 128 ];
     static uint8_t ucSampleIotHubDeviceId[ 128 ];
     static AzureIoTProvisioningClient_t xAzureIoTProvisioningClient;
+    static AzureIoTCARecovery_StreamParser xRecoveryParser;
+
+    /* Recovery signing key, imported by the first recovery and kept for the next ones. */
+    static AzureIoTSample_RS256Verifier xRecoveryVerifier;
+    static BaseType_t xRecoveryVerifierReady = pdFALSE;
 #endif /* democonfigENABLE_DPS_SAMPLE */
 
 static uint8_t ucPropertyBuffer[ 32 ];
@@ -677,6 +683,31 @@ static void prvAzureDemoTask( void * pvParameters )
         return 0;
     }
 
+/**
+ * @brief Write the certificates of the recovery payload to the root CA buffer.
+ *
+ * The recovery connection does not verify the server, so the buffer is free
+ * until the recovered trust bundle is loaded from storage.
+ */
+    static AzureIoTResult_t prvWriteRecoveredCertificates( void * pvContext,
+                                                           uint32_t ulOffset,
+                                                           const uint8_t * pucData,
+                                                           uint32_t ulLength )
+    {
+        ( void ) pvContext;
+
+        if( ulLength > sizeof( ucRootCABuffer ) - ulOffset )
+        {
+            LogError( ( "Recovered certificates larger than the root CA buffer\r\n" ) );
+            return eAzureIoTErrorOutOfMemory;
+        }
+
+        memcpy( ucRootCABuffer + ulOffset, pucData, ulLength );
+
+        return eAzureIoTSuccess;
+    }
+/*-----------------------------------------------------------*/
+
 /**
  * @brief Run trust bundle recovery.
  */
@@ -748,47 +779,66 @@ static void prvAzureDemoTask( void * pvParameters )
 
         configASSERT( xResult == eAzureIoTSuccess );
 
-        AzureIoTCARecovery_RecoveryPayload xRecoveryPayload;
-        AzureIoTJSONReader_t xJSONReader;
-
         LogInfo( ( "Received trust bundle:\r\n" ) );
         LogInfo( ( "%.*s", az_span_size( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ),
                    az_span_ptr( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ) ) );
-        xResult = AzureIoTJSONReader_Init( &xJSONReader,
-                                           az_span_ptr( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ),
-                                           az_span_size( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ) );
-        configASSERT( xResult == eAzureIoTSuccess );
 
+        /* The payload is parsed as a stream, which hashes the signed text and
+         * unescapes the certificates to the root CA buffer as it goes, and
+         * leaves the payload as it is. The DPS client gives the payload whole,
+         * a transport receiving it in pieces feeds each of them in turn. */
         LogInfo( ( "Parsing Recovery Payload\r\n" ) );
-        xResult = AzureIoTCARecovery_ParseRecoveryPayload( &xJSONReader, &xRecoveryPayload );
+        xResult = AzureIoTCARecovery_StreamInit( &xRecoveryParser, prvWriteRecoveredCertificates, NULL );
+        configASSERT( xResult == eAzureIoTSuccess );
+
+        xResult = AzureIoTCARecovery_StreamFeed( &xRecoveryParser,
+                                                 az_span_ptr( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ),
+                                                 az_span_size( xAzureIoTProvisioningClient._internal.xRegisterResponse.registration_state.payload ) );
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTCARecovery_StreamFinish( &xRecoveryParser );
+        }
+
+        AzureIoTCARecovery_StreamDeinit( &xRecoveryParser );
         configASSERT( xResult == eAzureIoTSuccess );
 
         LogInfo( ( "Parsed Bundle: Version %i | Length %i\r\n",
-                   xRecoveryPayload.xTrustBundle.ulVersion,
-                   xRecoveryPayload.xTrustBundle.ulCertificatesLength ) );
+                   xRecoveryParser.ulVersion,
+                   xRecoveryParser.ulCertificatesLength ) );
 
         LogInfo( ( "Validating trust bundle signature\r\n" ) );
-        xResult = AzureIoTSample_RS256Verify( ( uint8_t * ) xRecoveryPayload.pucTrustBundleJSONObjectText,
-                                              xRecoveryPayload.ulTrustBundleJSONObjectTextLength,
-                                              ( uint8_t * ) xRecoveryPayload.pucPayloadSignature,
-                                              xRecoveryPayload.ulPayloadSignatureLength,
-                                              democonfigRECOVERY_SIGNING_KEY_N,
-                                              sizeof( democonfigRECOVERY_SIGNING_KEY_N ) / sizeof( democonfigRECOVERY_SIGNING_KEY_N[ 0 ] ),
-                                              democonfigRECOVERY_SIGNING_KEY_E,
-                                              sizeof( democonfigRECOVERY_SIGNING_KEY_E ) / sizeof( democonfigRECOVERY_SIGNING_KEY_E[ 0 ] ),
-                                              ucSignatureValidateScratchBuffer,
-                                              sizeof( ucSignatureValidateScratchBuffer ) );
+
+        if( xRecoveryVerifierReady == pdFALSE )
+        {
+            xResult = AzureIoTSample_RS256VerifierInit( &xRecoveryVerifier,
+                                                        democonfigRECOVERY_SIGNING_KEY_N,
+                                                        sizeof( democonfigRECOVERY_SIGNING_KEY_N ) / sizeof( democonfigRECOVERY_SIGNING_KEY_N[ 0 ] ),
+                                                        democonfigRECOVERY_SIGNING_KEY_E,
+                                                        sizeof( democonfigRECOVERY_SIGNING_KEY_E ) / sizeof( democonfigRECOVERY_SIGNING_KEY_E[ 0 ] ) );
+            configASSERT( xResult == eAzureIoTSuccess );
+            xRecoveryVerifierReady = pdTRUE;
+        }
+
+        xResult = AzureIoTSample_RS256VerifierVerifyHash( &xRecoveryVerifier,
+                                                          xRecoveryParser.ucTrustBundleHash,
+                                                          xRecoveryParser.ucSignature,
+                                                          xRecoveryParser.ulSignatureLength,
+                                                          ucSignatureValidateScratchBuffer,
+                                                          sizeof( ucSignatureValidateScratchBuffer ) );
         configASSERT( xResult == eAzureIoTSuccess );
-        LogInfo( ( "Trust bundle signature successfully validated\r\n" ) );
+        LogInfo( ( "Trust bundle signature successfully validated in %u us, signing key set up in %u us\r\n",
+                   ( unsigned ) xRecoveryVerifier.ulLastVerifyTimeUs,
+                   ( unsigned ) xRecoveryVerifier.ulSetupTimeUs ) );
 
         /* Check version */
         uint32_t ulCurrentBundleVersion;
         AzureIoTCAStorage_ReadTrustBundleVersion( &ulCurrentBundleVersion );
 
-        if( xRecoveryPayload.xTrustBundle.ulVersion <= ulCurrentBundleVersion )
+        if( xRecoveryParser.ulVersion <= ulCurrentBundleVersion )
         {
             LogError( ( "Invalid bundle version: current version = %i received version = %i\r\n",
-                        ulCurrentBundleVersion, xRecoveryPayload.xTrustBundle.ulVersion ) );
+                        ulCurrentBundleVersion, xRecoveryParser.ulVersion ) );
             configASSERT( false );
         }
         else
@@ -799,10 +849,10 @@ static void prvAzureDemoTask( void * pvParameters )
         /*Check expiration time */
         uint64_t ullCurrentTime = ullGetUnixTime();
 
-        if( ullCurrentTime > xRecoveryPayload.xTrustBundle.ullExpiryTimeSecs )
+        if( ullCurrentTime > xRecoveryParser.ullExpiryTimeSecs )
         {
             LogError( ( "Trust bundle validity expired | current (%llu) payload (%llu).\r\n",
-                        ullCurrentTime, xRecoveryPayload.xTrustBundle.ullExpiryTimeSecs ) );
+                        ullCurrentTime, xRecoveryParser.ullExpiryTimeSecs ) );
             configASSERT( false );
         }
         else
@@ -810,17 +860,26 @@ static void prvAzureDemoTask( void * pvParameters )
             LogInfo( ( "Trust bundle expiration validated\r\n" ) );
         }
 
-        LogInfo( ( "Unescaping the trust bundle cert\r\n" ) );
-        az_span xUnescapeSpan = az_span_create( xRecoveryPayload.xTrustBundle.pucCertificates,
-                                                xRecoveryPayload.xTrustBundle.ulCertificatesLength );
-        xUnescapeSpan = az_json_string_unescape( xUnescapeSpan, xUnescapeSpan );
+        LogInfo( ( "Unescaped bundle length %i value\r\n%.*s", xRecoveryParser.ulCertificatesLength,
+                   xRecoveryParser.ulCertificatesLength, ucRootCABuffer ) );
+
+        /* The certificates are stored decoded, in place of the text they were
+         * unescaped to. */
+        LogInfo( ( "Converting the trust bundle to DER\r\n" ) );
+        uint32_t ulTrustBundleLength;
+        xResult = AzureIoTCARecovery_ConvertTrustBundle( ucRootCABuffer,
+                                                         sizeof( ucRootCABuffer ),
+                                                         xRecoveryParser.ulCertificatesLength,
+                                                         &ulTrustBundleLength );
+        configASSERT( xResult == eAzureIoTSuccess );
 
-        LogInfo( ( "Unescaped bundle length %i value\r\n%.*s", az_span_size( xUnescapeSpan ), az_span_size( xUnescapeSpan ), az_span_ptr( xUnescapeSpan ) ) );
+        LogInfo( ( "Trust bundle of %u bytes, %i bytes of PEM\r\n",
+                   ( unsigned ) ulTrustBundleLength, xRecoveryParser.ulCertificatesLength ) );
 
         LogInfo( ( "Writing trust bundle to NVS\r\n" ) );
-        xResult = AzureIoTCAStorage_WriteTrustBundle( az_span_ptr( xUnescapeSpan ),
-                                                      az_span_size( xUnescapeSpan ),
-                                                      xRecoveryPayload.xTrustBundle.ulVersion );
+        xResult = AzureIoTCAStorage_WriteTrustBundle( ucRootCABuffer,
+                                                      ulTrustBundleLength,
+                                                      xRecoveryParser.ulVersion );
         configASSERT( xResult == eAzureIoTSuccess );
 
         AzureIoTProvisioningClient_Deinit( &xAzureIoTProvisioningClient );
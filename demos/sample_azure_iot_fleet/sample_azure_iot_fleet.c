@@ -0,0 +1,942 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_fleet.c
+ * @brief Fleet simulator: many independent IoT Hub clients in one process.
+ *
+ * Each simulated tile owns its hub client, network context, MQTT buffer and
+ * step generator. A small pool of worker tasks round-robins over the devices:
+ * a worker connects the devices it owns, publishes their telemetry with QoS1
+ * and runs their process loop. A reporter task periodically prints aggregate
+ * throughput, PUBACK and connect latency percentiles, memory per device and,
+ * when enabled, forces reconnect storms to observe how the fleet recovers.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdio.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Azure IoT Hub library includes */
+#include "azure_iot_hub_client.h"
+
+/* Exponential backoff retry include. */
+#include "backoff_algorithm.h"
+
+/* Transport interface implementation include header for TLS. */
+#include "transport_tls_socket.h"
+#include "sockets_wrapper.h"
+
+/* Crypto helper header. */
+#include "azure_sample_crypto.h"
+#include "mbedtls/platform_util.h"
+
+#include "azure/core/az_base64.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+#include "sample_azure_iot_fleet_generator.h"
+#include "sample_azure_iot_fleet_stats.h"
+
+/*-----------------------------------------------------------*/
+
+/* Compile time error for undefined configs. */
+#ifndef democonfigHOSTNAME
+    #error "Define the config democonfigHOSTNAME by following the instructions in file demo_config.h."
+#endif
+
+#ifndef democonfigROOT_CA_PEM
+    #error "Please define Root CA certificate of the IoT Hub(democonfigROOT_CA_PEM) in demo_config.h."
+#endif
+
+#if defined( democonfigDEVICE_SYMMETRIC_KEY ) && defined( democonfigCLIENT_CERTIFICATE_PEM )
+    #error "Please define only one auth democonfigDEVICE_SYMMETRIC_KEY or democonfigCLIENT_CERTIFICATE_PEM in demo_config.h."
+#endif
+
+/* Fleet defaults, override them in demo_config.h. */
+#ifndef democonfigFLEET_DEVICE_COUNT
+    #define democonfigFLEET_DEVICE_COUNT              ( 16U )
+#endif
+
+#ifndef democonfigFLEET_WORKER_COUNT
+    #define democonfigFLEET_WORKER_COUNT              ( 4U )
+#endif
+
+#ifndef democonfigFLEET_DEVICE_ID_FORMAT
+    #define democonfigFLEET_DEVICE_ID_FORMAT          "tile-%04u"
+#endif
+
+#ifndef democonfigFLEET_HOSTNAME
+    #define democonfigFLEET_HOSTNAME                  democonfigHOSTNAME
+#endif
+
+#ifndef democonfigFLEET_IOTHUB_PORT
+    #define democonfigFLEET_IOTHUB_PORT               democonfigIOTHUB_PORT
+#endif
+
+#ifndef democonfigFLEET_NETWORK_BUFFER_SIZE
+    #define democonfigFLEET_NETWORK_BUFFER_SIZE       ( 1024U )
+#endif
+
+#ifndef democonfigFLEET_TELEMETRY_PERIOD_MS
+    #define democonfigFLEET_TELEMETRY_PERIOD_MS       ( 5000U )
+#endif
+
+#ifndef democonfigFLEET_REPORT_PERIOD_MS
+    #define democonfigFLEET_REPORT_PERIOD_MS          ( 10000U )
+#endif
+
+#ifndef democonfigFLEET_RECONNECT_STORM_PERIOD_MS
+    #define democonfigFLEET_RECONNECT_STORM_PERIOD_MS ( 0U )
+#endif
+
+#ifndef democonfigFLEET_REPORT_PER_DEVICE
+    #define democonfigFLEET_REPORT_PER_DEVICE         ( 1 )
+#endif
+
+#if ( democonfigFLEET_WORKER_COUNT == 0 ) || ( democonfigFLEET_WORKER_COUNT > democonfigFLEET_DEVICE_COUNT )
+    #error "democonfigFLEET_WORKER_COUNT must be between 1 and democonfigFLEET_DEVICE_COUNT."
+#endif
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The maximum number of connect attempts a device makes in a row
+ * before waiting for the maximum back-off delay and starting over.
+ */
+#define sampleazureiotfleetRETRY_MAX_ATTEMPTS                 ( 8U )
+
+/**
+ * @brief The maximum back-off delay (in milliseconds) between connect attempts.
+ */
+#define sampleazureiotfleetRETRY_MAX_BACKOFF_DELAY_MS         ( 30000U )
+
+/**
+ * @brief The base back-off delay (in milliseconds) between connect attempts.
+ */
+#define sampleazureiotfleetRETRY_BACKOFF_BASE_MS              ( 500U )
+
+/**
+ * @brief Timeout for receiving CONNACK packet in milliseconds.
+ */
+#define sampleazureiotfleetCONNACK_RECV_TIMEOUT_MS            ( 10 * 1000U )
+
+/**
+ * @brief Wait timeout for subscribe to finish.
+ */
+#define sampleazureiotfleetSUBSCRIBE_TIMEOUT                  ( 10 * 1000U )
+
+/**
+ * @brief Transport timeout in milliseconds while the TLS session is set up.
+ */
+#define sampleazureiotfleetTRANSPORT_CONNECT_TIMEOUT_MS       ( 2000U )
+
+/**
+ * @brief Transport receive timeout in milliseconds once connected.
+ *
+ * Kept short so a worker polling an idle device does not hold up the others.
+ */
+#define sampleazureiotfleetTRANSPORT_RECV_TIMEOUT_MS          ( 5U )
+
+/**
+ * @brief Timeout for AzureIoTHubClient_ProcessLoop in milliseconds.
+ */
+#define sampleazureiotfleetPROCESS_LOOP_TIMEOUT_MS            ( 10U )
+
+/**
+ * @brief A QoS1 telemetry message not acknowledged within this time is counted
+ * as lost and no longer blocks the next publish.
+ */
+#define sampleazureiotfleetPUBACK_TIMEOUT_MS                  ( 30 * 1000U )
+
+/**
+ * @brief Stack size of the worker and reporter tasks.
+ */
+#define sampleazureiotfleetTASK_STACKSIZE                     democonfigDEMO_STACKSIZE
+
+#define sampleazureiotfleetDEVICE_ID_MAX_LENGTH               ( 64U )
+
+#define sampleazureiotfleetTICKS_TO_MS( xTicks )              ( ( uint32_t ) ( ( xTicks ) * portTICK_PERIOD_MS ) )
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Unix time.
+ *
+ * @return Time in seconds.
+ */
+uint64_t ullGetUnixTime( void );
+
+/**
+ * @brief Bytes currently allocated from the heap, provided by the platform.
+ */
+size_t xGetHeapBytesInUse( void );
+/*-----------------------------------------------------------*/
+
+/* Each compilation unit must define the NetworkContext struct. */
+struct NetworkContext
+{
+    void * pParams;
+};
+
+typedef enum FleetDeviceState
+{
+    eFleetDeviceDisconnected = 0,
+    eFleetDeviceConnected
+} FleetDeviceState_t;
+
+/**
+ * @brief Everything one simulated tile owns.
+ */
+typedef struct FleetDevice
+{
+    AzureIoTHubClient_t xHubClient;
+    AzureIoTTransportInterface_t xTransport;
+    NetworkContext_t xNetworkContext;
+    TlsTransportParams_t xTlsTransportParams;
+    BackoffAlgorithmContext_t xReconnectParams;
+    FleetGenerator_t xGenerator;
+    FleetDeviceState_t xState;
+    char cDeviceId[ sampleazureiotfleetDEVICE_ID_MAX_LENGTH ];
+    uint32_t ulDeviceIdLength;
+    TickType_t xNextConnectTick;
+    TickType_t xNextTelemetryTick;
+    TickType_t xPublishTick;
+    uint16_t usPendingPacketId;
+    uint32_t ulStormGeneration;
+
+    /* Statistics, written by the owning worker and read by the reporter. */
+    FleetHistogram_t xPubAckLatency;
+    FleetHistogram_t xConnectLatency;
+    uint32_t ulTelemetrySent;
+    uint32_t ulTelemetryAcked;
+    uint32_t ulTelemetryLost;
+    uint32_t ulBytesSent;
+    uint32_t ulConnects;
+    uint32_t ulConnectFailures;
+    uint32_t ulDisconnects;
+    uint32_t ulCommands;
+
+    uint8_t ucScratchBuffer[ 256 ];
+    uint8_t ucCommandResponsePayloadBuffer[ 32 ];
+    uint8_t ucMQTTMessageBuffer[ democonfigFLEET_NETWORK_BUFFER_SIZE ];
+} FleetDevice_t;
+
+/**
+ * @brief A worker task and the device it is currently servicing.
+ *
+ * The telemetry PUBACK callback has no context, the device is found from the
+ * worker running the process loop.
+ */
+typedef struct FleetWorker
+{
+    TaskHandle_t xTaskHandle;
+    uint32_t ulIndex;
+    FleetDevice_t * pxActiveDevice;
+    #ifdef democonfigDEVICE_SYMMETRIC_KEY
+        CryptoHMACKey_t xDeviceKey; /* Decoded device key, signs the SAS tokens of the worker's devices. */
+        uint32_t ulDeviceKeyLength;
+    #endif
+} FleetWorker_t;
+
+/**
+ * @brief Fleet wide state of the current reconnect storm.
+ */
+typedef struct FleetStorm
+{
+    uint32_t ulGeneration;
+    TickType_t xStartTick;
+    uint32_t ulRecoveryMs;
+    uint32_t ulConnectFailuresAtStart;
+    FleetHistogram_t xReconnectLatency;
+} FleetStorm_t;
+/*-----------------------------------------------------------*/
+
+/* All tasks of the FreeRTOS simulator run one at a time, so the statistics
+ * below are shared between workers and reporter without locking. */
+static FleetDevice_t xFleetDevices[ democonfigFLEET_DEVICE_COUNT ];
+static FleetWorker_t xFleetWorkers[ democonfigFLEET_WORKER_COUNT ];
+static FleetStorm_t xFleetStorm;
+static FleetStepTrace_t xFleetStepTrace;
+static NetworkCredentials_t xFleetNetworkCredentials;
+
+/* Profile of each device, cycled over the fleet. Trace entries fall back to
+ * walking when no trace is configured. */
+static const FleetProfile_t xFleetProfileMix[] =
+{
+    eFleetProfileTrace,
+    eFleetProfileWalking,
+    eFleetProfileIdle,
+    eFleetProfileRushHour
+};
+
+static const char sampleazureiotfleetCOMMAND_RESET_STEPS_COUNTER[] = "ResetStepsCounter";
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Worker currently running, NULL when called from another task.
+ */
+static FleetWorker_t * prvCurrentWorker( void )
+{
+    TaskHandle_t xCurrent = xTaskGetCurrentTaskHandle();
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < democonfigFLEET_WORKER_COUNT; ulIndex++ )
+    {
+        if( xFleetWorkers[ ulIndex ].xTaskHandle == xCurrent )
+        {
+            return &xFleetWorkers[ ulIndex ];
+        }
+    }
+
+    return NULL;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Telemetry PUBACK callback, records the publish to ack latency.
+ */
+static void prvTelemetryPubAckCallback( uint16_t usPacketID )
+{
+    FleetWorker_t * pxWorker = prvCurrentWorker();
+    FleetDevice_t * pxDevice;
+
+    if( ( pxWorker == NULL ) || ( ( pxDevice = pxWorker->pxActiveDevice ) == NULL ) )
+    {
+        return;
+    }
+
+    if( ( pxDevice->usPendingPacketId != 0 ) && ( pxDevice->usPendingPacketId == usPacketID ) )
+    {
+        vFleetHistogramRecord( &pxDevice->xPubAckLatency,
+                               sampleazureiotfleetTICKS_TO_MS( xTaskGetTickCount() - pxDevice->xPublishTick ) );
+        pxDevice->ulTelemetryAcked++;
+        pxDevice->usPendingPacketId = 0;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Command callback, the fleet supports the tile ResetStepsCounter command.
+ */
+static void prvHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
+                              void * pvContext )
+{
+    FleetDevice_t * pxDevice = ( FleetDevice_t * ) pvContext;
+    uint32_t ulResponseStatus;
+    uint32_t ulResponseLength;
+    AzureIoTResult_t xResult;
+
+    pxDevice->ulCommands++;
+
+    if( ( pxMessage->usCommandNameLength == sizeof( sampleazureiotfleetCOMMAND_RESET_STEPS_COUNTER ) - 1 ) &&
+        ( strncmp( sampleazureiotfleetCOMMAND_RESET_STEPS_COUNTER, ( const char * ) pxMessage->pucCommandName,
+                   pxMessage->usCommandNameLength ) == 0 ) )
+    {
+        vFleetGeneratorResetSteps( &pxDevice->xGenerator );
+        ulResponseStatus = 200;
+    }
+    else
+    {
+        ulResponseStatus = 404;
+    }
+
+    ulResponseLength = ( uint32_t ) snprintf( ( char * ) pxDevice->ucCommandResponsePayloadBuffer,
+                                              sizeof( pxDevice->ucCommandResponsePayloadBuffer ), "{}" );
+
+    if( ( xResult = AzureIoTHubClient_SendCommandResponse( &pxDevice->xHubClient, pxMessage, ulResponseStatus,
+                                                           pxDevice->ucCommandResponsePayloadBuffer,
+                                                           ulResponseLength ) ) != eAzureIoTSuccess )
+    {
+        LogError( ( "%s: error sending command response: result 0x%08x", pxDevice->cDeviceId, ( uint16_t ) xResult ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Setup transport credentials, shared by all devices.
+ */
+static uint32_t prvSetupNetworkCredentials( NetworkCredentials_t * pxNetworkCredentials )
+{
+    pxNetworkCredentials->xDisableSni = pdFALSE;
+    /* Set the credentials for establishing a TLS connection. */
+    pxNetworkCredentials->pucRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
+    pxNetworkCredentials->xRootCaSize = sizeof( democonfigROOT_CA_PEM );
+    #ifdef democonfigCLIENT_CERTIFICATE_PEM
+        pxNetworkCredentials->pucClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+        pxNetworkCredentials->xClientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+        pxNetworkCredentials->pucPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+        pxNetworkCredentials->xPrivateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+    #endif
+    #ifdef democonfigENABLE_TLS_SESSION_RESUMPTION
+        /* Each device keeps its session in its TlsTransportParams_t, the
+         * reconnects of a storm then resume it. */
+        pxNetworkCredentials->xEnableSessionResumption = pdTRUE;
+    #endif
+    #ifdef democonfigTLS_CRYPTO_SLICE_MAX_OPS
+        pxNetworkCredentials->ulCryptoSliceMaxOps = democonfigTLS_CRYPTO_SLICE_MAX_OPS;
+    #endif
+    #ifdef democonfigTLS_MAX_FRAGMENT_LENGTH
+        pxNetworkCredentials->ulMaxFragmentLength = democonfigTLS_MAX_FRAGMENT_LENGTH;
+    #endif
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+#ifdef democonfigDEVICE_SYMMETRIC_KEY
+
+/**
+ * @brief Hash the key blocks of the device key once for each worker.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+    static uint32_t prvSetupDeviceKeys( void )
+    {
+        uint8_t ucKey[ ( ( sizeof( democonfigDEVICE_SYMMETRIC_KEY ) - 1 ) / 4 ) * 3 ];
+        int32_t lKeyLength = 0;
+        uint32_t ulIndex;
+        uint32_t ulRet = 0;
+
+        if( az_result_failed( az_base64_decode( az_span_create( ucKey, sizeof( ucKey ) ),
+                                                az_span_create( ( uint8_t * ) democonfigDEVICE_SYMMETRIC_KEY,
+                                                                sizeof( democonfigDEVICE_SYMMETRIC_KEY ) - 1 ),
+                                                &lKeyLength ) ) )
+        {
+            return 1;
+        }
+
+        for( ulIndex = 0; ulIndex < democonfigFLEET_WORKER_COUNT; ulIndex++ )
+        {
+            if( Crypto_HMACKeyInit( &xFleetWorkers[ ulIndex ].xDeviceKey, ucKey, ( uint32_t ) lKeyLength ) != 0 )
+            {
+                ulRet = 1;
+            }
+
+            xFleetWorkers[ ulIndex ].ulDeviceKeyLength = ( uint32_t ) lKeyLength;
+        }
+
+        mbedtls_platform_zeroize( ucKey, sizeof( ucKey ) );
+
+        return ulRet;
+    }
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief HMAC callback of the devices.
+ *
+ * Every device is given democonfigDEVICE_SYMMETRIC_KEY, which the middleware
+ * decodes before each signature, so a worker signs with the key it holds and
+ * a reconnect storm only hashes the SAS tokens.
+ */
+    static uint32_t prvFleetHMAC( const uint8_t * pucKey,
+                                  uint32_t ulKeyLength,
+                                  const uint8_t * pucData,
+                                  uint32_t ulDataLength,
+                                  uint8_t * pucOutput,
+                                  uint32_t ulOutputLength,
+                                  uint32_t * pulBytesCopied )
+    {
+        FleetWorker_t * pxWorker = prvCurrentWorker();
+
+        if( ( pxWorker == NULL ) || ( ulKeyLength != pxWorker->ulDeviceKeyLength ) )
+        {
+            return Crypto_HMAC( pucKey, ulKeyLength, pucData, ulDataLength,
+                                pucOutput, ulOutputLength, pulBytesCopied );
+        }
+
+        return Crypto_HMACKeySign( &pxWorker->xDeviceKey, pucData, ulDataLength,
+                                   pucOutput, ulOutputLength, pulBytesCopied );
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* democonfigDEVICE_SYMMETRIC_KEY */
+
+/**
+ * @brief Drop the connection of a device and schedule the next connect attempt.
+ *
+ * @param[in] pxDevice Device to disconnect.
+ * @param[in] xGraceful Send an MQTT disconnect first. Storms and failures drop the socket only.
+ */
+static void prvFleetDeviceDisconnect( FleetDevice_t * pxDevice,
+                                      BaseType_t xGraceful )
+{
+    uint16_t usNextRetryBackOff = 0U;
+
+    if( pxDevice->xState == eFleetDeviceConnected )
+    {
+        if( xGraceful == pdTRUE )
+        {
+            ( void ) AzureIoTHubClient_Disconnect( &pxDevice->xHubClient );
+        }
+
+        TLS_Socket_Disconnect( &pxDevice->xNetworkContext );
+        AzureIoTHubClient_Deinit( &pxDevice->xHubClient );
+        pxDevice->ulDisconnects++;
+    }
+
+    pxDevice->xState = eFleetDeviceDisconnected;
+    pxDevice->usPendingPacketId = 0;
+
+    /* Jitter spreads the reconnects of a fleet which lost its connection at once. */
+    if( BackoffAlgorithm_GetNextBackoff( &pxDevice->xReconnectParams, configRAND32(),
+                                         &usNextRetryBackOff ) == BackoffAlgorithmRetriesExhausted )
+    {
+        BackoffAlgorithm_InitializeParams( &pxDevice->xReconnectParams,
+                                           sampleazureiotfleetRETRY_BACKOFF_BASE_MS,
+                                           sampleazureiotfleetRETRY_MAX_BACKOFF_DELAY_MS,
+                                           sampleazureiotfleetRETRY_MAX_ATTEMPTS );
+        usNextRetryBackOff = sampleazureiotfleetRETRY_MAX_BACKOFF_DELAY_MS;
+    }
+
+    pxDevice->xNextConnectTick = xTaskGetTickCount() + pdMS_TO_TICKS( usNextRetryBackOff );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect one device: TLS session, MQTT connect and command subscription.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+static uint32_t prvFleetDeviceConnect( FleetDevice_t * pxDevice )
+{
+    AzureIoTHubClientOptions_t xHubOptions = { 0 };
+    AzureIoTResult_t xResult;
+    TlsTransportStatus_t xNetworkStatus;
+    TickType_t xStartTick = xTaskGetTickCount();
+    TickType_t xRecvTimeout = pdMS_TO_TICKS( sampleazureiotfleetTRANSPORT_RECV_TIMEOUT_MS );
+    uint32_t ulLatencyMs;
+    bool xSessionPresent;
+
+    pxDevice->xNetworkContext.pParams = &pxDevice->xTlsTransportParams;
+
+    xNetworkStatus = TLS_Socket_Connect( &pxDevice->xNetworkContext,
+                                         democonfigFLEET_HOSTNAME, democonfigFLEET_IOTHUB_PORT,
+                                         &xFleetNetworkCredentials,
+                                         sampleazureiotfleetTRANSPORT_CONNECT_TIMEOUT_MS,
+                                         sampleazureiotfleetTRANSPORT_CONNECT_TIMEOUT_MS );
+
+    if( xNetworkStatus != eTLSTransportSuccess )
+    {
+        LogWarn( ( "%s: TLS connection failed [%d]", pxDevice->cDeviceId, xNetworkStatus ) );
+        return 1;
+    }
+
+    /* The handshake is done, from now on a worker must not block on an idle device. */
+    ( void ) Sockets_SetSockOpt( pxDevice->xTlsTransportParams.xTCPSocket, SOCKETS_SO_RCVTIMEO,
+                                 &xRecvTimeout, sizeof( xRecvTimeout ) );
+
+    pxDevice->xTransport.pxNetworkContext = &pxDevice->xNetworkContext;
+    pxDevice->xTransport.xSend = TLS_Socket_Send;
+    pxDevice->xTransport.xRecv = TLS_Socket_Recv;
+
+    xResult = AzureIoTHubClient_OptionsInit( &xHubOptions );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    xHubOptions.pucModelID = ( const uint8_t * ) sampleazureiotMODEL_ID;
+    xHubOptions.ulModelIDLength = sizeof( sampleazureiotMODEL_ID ) - 1;
+    xHubOptions.xTelemetryCallback = prvTelemetryPubAckCallback;
+
+    xResult = AzureIoTHubClient_Init( &pxDevice->xHubClient,
+                                      ( const uint8_t * ) democonfigFLEET_HOSTNAME, sizeof( democonfigFLEET_HOSTNAME ) - 1,
+                                      ( const uint8_t * ) pxDevice->cDeviceId, pxDevice->ulDeviceIdLength,
+                                      &xHubOptions,
+                                      pxDevice->ucMQTTMessageBuffer, sizeof( pxDevice->ucMQTTMessageBuffer ),
+                                      ullGetUnixTime,
+                                      &pxDevice->xTransport );
+    configASSERT( xResult == eAzureIoTSuccess );
+
+    #ifdef democonfigDEVICE_SYMMETRIC_KEY
+        xResult = AzureIoTHubClient_SetSymmetricKey( &pxDevice->xHubClient,
+                                                     ( const uint8_t * ) democonfigDEVICE_SYMMETRIC_KEY,
+                                                     sizeof( democonfigDEVICE_SYMMETRIC_KEY ) - 1,
+                                                     prvFleetHMAC );
+        configASSERT( xResult == eAzureIoTSuccess );
+    #endif /* democonfigDEVICE_SYMMETRIC_KEY */
+
+    if( ( ( xResult = AzureIoTHubClient_Connect( &pxDevice->xHubClient, false, &xSessionPresent,
+                                                 sampleazureiotfleetCONNACK_RECV_TIMEOUT_MS ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTHubClient_SubscribeCommand( &pxDevice->xHubClient, prvHandleCommand, pxDevice,
+                                                          sampleazureiotfleetSUBSCRIBE_TIMEOUT ) ) != eAzureIoTSuccess ) )
+    {
+        LogWarn( ( "%s: MQTT connection failed: result 0x%08x", pxDevice->cDeviceId, ( uint16_t ) xResult ) );
+        TLS_Socket_Disconnect( &pxDevice->xNetworkContext );
+        AzureIoTHubClient_Deinit( &pxDevice->xHubClient );
+        return 1;
+    }
+
+    ulLatencyMs = sampleazureiotfleetTICKS_TO_MS( xTaskGetTickCount() - xStartTick );
+    vFleetHistogramRecord( &pxDevice->xConnectLatency, ulLatencyMs );
+
+    if( pxDevice->ulStormGeneration != 0 )
+    {
+        vFleetHistogramRecord( &xFleetStorm.xReconnectLatency, ulLatencyMs );
+        pxDevice->ulStormGeneration = 0;
+    }
+
+    BackoffAlgorithm_InitializeParams( &pxDevice->xReconnectParams,
+                                       sampleazureiotfleetRETRY_BACKOFF_BASE_MS,
+                                       sampleazureiotfleetRETRY_MAX_BACKOFF_DELAY_MS,
+                                       sampleazureiotfleetRETRY_MAX_ATTEMPTS );
+
+    pxDevice->xState = eFleetDeviceConnected;
+    pxDevice->ulConnects++;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Give a connected device one slice of work: publish if due, then process.
+ */
+static void prvFleetDeviceService( FleetDevice_t * pxDevice,
+                                   TickType_t xNow )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulTelemetryLength = 0;
+
+    /* An ack which never came does not block the device forever. */
+    if( ( pxDevice->usPendingPacketId != 0 ) &&
+        ( sampleazureiotfleetTICKS_TO_MS( xNow - pxDevice->xPublishTick ) > sampleazureiotfleetPUBACK_TIMEOUT_MS ) )
+    {
+        pxDevice->usPendingPacketId = 0;
+        pxDevice->ulTelemetryLost++;
+    }
+
+    if( ( pxDevice->usPendingPacketId == 0 ) &&
+        ( ( int32_t ) ( xNow - pxDevice->xNextTelemetryTick ) >= 0 ) )
+    {
+        pxDevice->xNextTelemetryTick = xNow + pdMS_TO_TICKS( democonfigFLEET_TELEMETRY_PERIOD_MS );
+
+        if( ( ulFleetGeneratorCreateTelemetry( &pxDevice->xGenerator, sampleazureiotfleetTICKS_TO_MS( xNow ),
+                                               pxDevice->ucScratchBuffer, sizeof( pxDevice->ucScratchBuffer ),
+                                               &ulTelemetryLength ) == 0 ) &&
+            ( ulTelemetryLength > 0 ) )
+        {
+            pxDevice->xPublishTick = xTaskGetTickCount();
+            xResult = AzureIoTHubClient_SendTelemetry( &pxDevice->xHubClient,
+                                                       pxDevice->ucScratchBuffer, ulTelemetryLength,
+                                                       NULL, eAzureIoTHubMessageQoS1, &pxDevice->usPendingPacketId );
+
+            if( xResult != eAzureIoTSuccess )
+            {
+                LogWarn( ( "%s: telemetry send failed: result 0x%08x", pxDevice->cDeviceId, ( uint16_t ) xResult ) );
+                prvFleetDeviceDisconnect( pxDevice, pdFALSE );
+                return;
+            }
+
+            pxDevice->ulTelemetrySent++;
+            pxDevice->ulBytesSent += ulTelemetryLength;
+        }
+    }
+
+    if( ( xResult = AzureIoTHubClient_ProcessLoop( &pxDevice->xHubClient,
+                                                   sampleazureiotfleetPROCESS_LOOP_TIMEOUT_MS ) ) != eAzureIoTSuccess )
+    {
+        LogWarn( ( "%s: process loop failed: result 0x%08x", pxDevice->cDeviceId, ( uint16_t ) xResult ) );
+        prvFleetDeviceDisconnect( pxDevice, pdFALSE );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Worker task, owns devices ulIndex, ulIndex + W, ulIndex + 2W, ...
+ */
+static void prvFleetWorkerTask( void * pvParameters )
+{
+    FleetWorker_t * pxWorker = ( FleetWorker_t * ) pvParameters;
+    FleetDevice_t * pxDevice;
+    uint32_t ulStormGeneration = 0;
+    uint32_t ulIndex;
+    TickType_t xNow;
+
+    for( ; ; )
+    {
+        /* A storm drops every connection at once, as a site wide network outage would. */
+        if( ulStormGeneration != xFleetStorm.ulGeneration )
+        {
+            ulStormGeneration = xFleetStorm.ulGeneration;
+
+            for( ulIndex = pxWorker->ulIndex; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex += democonfigFLEET_WORKER_COUNT )
+            {
+                pxDevice = &xFleetDevices[ ulIndex ];
+
+                if( pxDevice->xState == eFleetDeviceConnected )
+                {
+                    prvFleetDeviceDisconnect( pxDevice, pdFALSE );
+                    pxDevice->ulStormGeneration = ulStormGeneration;
+                }
+            }
+        }
+
+        for( ulIndex = pxWorker->ulIndex; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex += democonfigFLEET_WORKER_COUNT )
+        {
+            pxDevice = &xFleetDevices[ ulIndex ];
+            pxWorker->pxActiveDevice = pxDevice;
+            xNow = xTaskGetTickCount();
+
+            if( pxDevice->xState == eFleetDeviceConnected )
+            {
+                prvFleetDeviceService( pxDevice, xNow );
+            }
+            else if( ( int32_t ) ( xNow - pxDevice->xNextConnectTick ) >= 0 )
+            {
+                if( prvFleetDeviceConnect( pxDevice ) != 0 )
+                {
+                    pxDevice->ulConnectFailures++;
+                    prvFleetDeviceDisconnect( pxDevice, pdFALSE );
+                }
+            }
+        }
+
+        pxWorker->pxActiveDevice = NULL;
+
+        /* Let the other workers and the IP task run. */
+        vTaskDelay( 1 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Print the fleet statistics accumulated so far.
+ */
+static void prvFleetReport( uint32_t ulElapsedMs,
+                            uint32_t * pulLastAcked,
+                            uint32_t * pulLastBytes,
+                            size_t xHeapBaseline )
+{
+    static FleetHistogram_t xPubAckLatency;
+    static FleetHistogram_t xConnectLatency;
+    FleetDevice_t * pxDevice;
+    uint32_t ulConnected = 0, ulSent = 0, ulAcked = 0, ulLost = 0, ulBytes = 0;
+    uint32_t ulConnects = 0, ulConnectFailures = 0, ulDisconnects = 0;
+    uint32_t ulIndex;
+    size_t xHeapInUse = xGetHeapBytesInUse();
+
+    vFleetHistogramReset( &xPubAckLatency );
+    vFleetHistogramReset( &xConnectLatency );
+
+    for( ulIndex = 0; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex++ )
+    {
+        pxDevice = &xFleetDevices[ ulIndex ];
+        ulConnected += ( pxDevice->xState == eFleetDeviceConnected ) ? 1 : 0;
+        ulSent += pxDevice->ulTelemetrySent;
+        ulAcked += pxDevice->ulTelemetryAcked;
+        ulLost += pxDevice->ulTelemetryLost;
+        ulBytes += pxDevice->ulBytesSent;
+        ulConnects += pxDevice->ulConnects;
+        ulConnectFailures += pxDevice->ulConnectFailures;
+        ulDisconnects += pxDevice->ulDisconnects;
+        vFleetHistogramMerge( &xPubAckLatency, &pxDevice->xPubAckLatency );
+        vFleetHistogramMerge( &xConnectLatency, &pxDevice->xConnectLatency );
+    }
+
+    LogInfo( ( "Fleet: devices=%u connected=%u workers=%u sent=%u acked=%u lost=%u",
+               ( unsigned ) democonfigFLEET_DEVICE_COUNT, ( unsigned ) ulConnected, ( unsigned ) democonfigFLEET_WORKER_COUNT,
+               ( unsigned ) ulSent, ( unsigned ) ulAcked, ( unsigned ) ulLost ) );
+    LogInfo( ( "Fleet throughput: %u msg/s %u B/s over the last %u ms",
+               ( unsigned ) ( ( ( ulAcked - *pulLastAcked ) * 1000ULL ) / ( ulElapsedMs ? ulElapsedMs : 1 ) ),
+               ( unsigned ) ( ( ( ulBytes - *pulLastBytes ) * 1000ULL ) / ( ulElapsedMs ? ulElapsedMs : 1 ) ),
+               ( unsigned ) ulElapsedMs ) );
+    LogInfo( ( "Fleet PUBACK latency ms: p50=%u p90=%u p99=%u max=%u",
+               ( unsigned ) ulFleetHistogramPercentile( &xPubAckLatency, 50 ),
+               ( unsigned ) ulFleetHistogramPercentile( &xPubAckLatency, 90 ),
+               ( unsigned ) ulFleetHistogramPercentile( &xPubAckLatency, 99 ),
+               ( unsigned ) xPubAckLatency.ulMaxMs ) );
+    LogInfo( ( "Fleet connect latency ms: p50=%u p90=%u p99=%u max=%u connects=%u failures=%u disconnects=%u",
+               ( unsigned ) ulFleetHistogramPercentile( &xConnectLatency, 50 ),
+               ( unsigned ) ulFleetHistogramPercentile( &xConnectLatency, 90 ),
+               ( unsigned ) ulFleetHistogramPercentile( &xConnectLatency, 99 ),
+               ( unsigned ) xConnectLatency.ulMaxMs,
+               ( unsigned ) ulConnects, ( unsigned ) ulConnectFailures, ( unsigned ) ulDisconnects ) );
+    LogInfo( ( "Fleet memory per device: static=%u B heap=%u B",
+               ( unsigned ) sizeof( FleetDevice_t ),
+               ( unsigned ) ( ( ulConnected > 0 ) && ( xHeapInUse > xHeapBaseline ) ?
+                              ( xHeapInUse - xHeapBaseline ) / ulConnected : 0 ) ) );
+
+    if( xFleetStorm.ulGeneration != 0 )
+    {
+        LogInfo( ( "Fleet storm #%u: reconnected=%u/%u recovery=%u ms reconnect p50=%u p99=%u failures=%u",
+                   ( unsigned ) xFleetStorm.ulGeneration,
+                   ( unsigned ) xFleetStorm.xReconnectLatency.ulCount, ( unsigned ) democonfigFLEET_DEVICE_COUNT,
+                   ( unsigned ) xFleetStorm.ulRecoveryMs,
+                   ( unsigned ) ulFleetHistogramPercentile( &xFleetStorm.xReconnectLatency, 50 ),
+                   ( unsigned ) ulFleetHistogramPercentile( &xFleetStorm.xReconnectLatency, 99 ),
+                   ( unsigned ) ( ulConnectFailures - xFleetStorm.ulConnectFailuresAtStart ) ) );
+    }
+
+    #if democonfigFLEET_REPORT_PER_DEVICE
+        for( ulIndex = 0; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex++ )
+        {
+            pxDevice = &xFleetDevices[ ulIndex ];
+            LogInfo( ( "  %s: %s sent=%u acked=%u puback p50=%u p90=%u p99=%u connects=%u failures=%u",
+                       pxDevice->cDeviceId,
+                       ( pxDevice->xState == eFleetDeviceConnected ) ? "up" : "down",
+                       ( unsigned ) pxDevice->ulTelemetrySent, ( unsigned ) pxDevice->ulTelemetryAcked,
+                       ( unsigned ) ulFleetHistogramPercentile( &pxDevice->xPubAckLatency, 50 ),
+                       ( unsigned ) ulFleetHistogramPercentile( &pxDevice->xPubAckLatency, 90 ),
+                       ( unsigned ) ulFleetHistogramPercentile( &pxDevice->xPubAckLatency, 99 ),
+                       ( unsigned ) pxDevice->ulConnects, ( unsigned ) pxDevice->ulConnectFailures ) );
+        }
+    #endif /* democonfigFLEET_REPORT_PER_DEVICE */
+
+    *pulLastAcked = ulAcked;
+    *pulLastBytes = ulBytes;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Reporter task: periodic report, storm trigger and storm recovery tracking.
+ */
+static void prvFleetReporterTask( void * pvParameters )
+{
+    size_t xHeapBaseline = ( size_t ) pvParameters;
+    TickType_t xLastReportTick = xTaskGetTickCount();
+    TickType_t xLastStormTick = xLastReportTick;
+    uint32_t ulLastAcked = 0, ulLastBytes = 0;
+    uint32_t ulConnected, ulConnectFailures, ulIndex;
+    TickType_t xNow;
+
+    for( ; ; )
+    {
+        vTaskDelay( pdMS_TO_TICKS( 100U ) );
+        xNow = xTaskGetTickCount();
+
+        for( ulIndex = 0, ulConnected = 0, ulConnectFailures = 0; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex++ )
+        {
+            ulConnected += ( xFleetDevices[ ulIndex ].xState == eFleetDeviceConnected ) ? 1 : 0;
+            ulConnectFailures += xFleetDevices[ ulIndex ].ulConnectFailures;
+        }
+
+        if( ( xFleetStorm.ulGeneration != 0 ) && ( xFleetStorm.ulRecoveryMs == 0 ) &&
+            ( ulConnected == democonfigFLEET_DEVICE_COUNT ) )
+        {
+            xFleetStorm.ulRecoveryMs = sampleazureiotfleetTICKS_TO_MS( xNow - xFleetStorm.xStartTick );
+            LogInfo( ( "Fleet storm #%u: all devices reconnected in %u ms",
+                       ( unsigned ) xFleetStorm.ulGeneration, ( unsigned ) xFleetStorm.ulRecoveryMs ) );
+        }
+
+        #if democonfigFLEET_RECONNECT_STORM_PERIOD_MS > 0
+            if( sampleazureiotfleetTICKS_TO_MS( xNow - xLastStormTick ) >= democonfigFLEET_RECONNECT_STORM_PERIOD_MS )
+            {
+                xLastStormTick = xNow;
+                vFleetHistogramReset( &xFleetStorm.xReconnectLatency );
+                xFleetStorm.xStartTick = xNow;
+                xFleetStorm.ulRecoveryMs = 0;
+                xFleetStorm.ulConnectFailuresAtStart = ulConnectFailures;
+                xFleetStorm.ulGeneration++;
+                LogInfo( ( "Fleet storm #%u: dropping %u connections", ( unsigned ) xFleetStorm.ulGeneration,
+                           ( unsigned ) ulConnected ) );
+            }
+        #else
+            ( void ) xLastStormTick;
+        #endif /* democonfigFLEET_RECONNECT_STORM_PERIOD_MS > 0 */
+
+        if( sampleazureiotfleetTICKS_TO_MS( xNow - xLastReportTick ) >= democonfigFLEET_REPORT_PERIOD_MS )
+        {
+            prvFleetReport( sampleazureiotfleetTICKS_TO_MS( xNow - xLastReportTick ),
+                            &ulLastAcked, &ulLastBytes, xHeapBaseline );
+            xLastReportTick = xNow;
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Setup task, prepares the devices then hands over to the workers.
+ */
+static void prvFleetSetupTask( void * pvParameters )
+{
+    FleetDevice_t * pxDevice;
+    FleetProfile_t xProfile;
+    uint32_t ulIndex;
+    uint32_t ulStatus;
+    size_t xHeapBaseline;
+    BaseType_t xCreated;
+
+    ( void ) pvParameters;
+
+    /* Initialize Azure IoT Middleware.  */
+    configASSERT( AzureIoT_Init() == eAzureIoTSuccess );
+    ulStatus = prvSetupNetworkCredentials( &xFleetNetworkCredentials );
+    configASSERT( ulStatus == 0 );
+
+    #ifdef democonfigDEVICE_SYMMETRIC_KEY
+        ulStatus = prvSetupDeviceKeys();
+        configASSERT( ulStatus == 0 );
+    #endif
+
+    #ifdef democonfigFLEET_STEP_TRACE_PATH
+        if( ulFleetTraceLoad( democonfigFLEET_STEP_TRACE_PATH, &xFleetStepTrace ) != 0 )
+        {
+            LogWarn( ( "Step trace unavailable, trace devices fall back to the walking profile." ) );
+        }
+    #endif /* democonfigFLEET_STEP_TRACE_PATH */
+
+    for( ulIndex = 0; ulIndex < democonfigFLEET_DEVICE_COUNT; ulIndex++ )
+    {
+        pxDevice = &xFleetDevices[ ulIndex ];
+        memset( pxDevice, 0, sizeof( *pxDevice ) );
+
+        pxDevice->ulDeviceIdLength = ( uint32_t ) snprintf( pxDevice->cDeviceId, sizeof( pxDevice->cDeviceId ),
+                                                            democonfigFLEET_DEVICE_ID_FORMAT, ( unsigned ) ulIndex );
+        configASSERT( pxDevice->ulDeviceIdLength < sizeof( pxDevice->cDeviceId ) );
+
+        xProfile = xFleetProfileMix[ ulIndex % ( sizeof( xFleetProfileMix ) / sizeof( xFleetProfileMix[ 0 ] ) ) ];
+
+        if( ( xProfile == eFleetProfileTrace ) && ( xFleetStepTrace.ulSampleCount == 0 ) )
+        {
+            xProfile = eFleetProfileWalking;
+        }
+
+        /* Phase spreads devices over the trace and over the first telemetry period. */
+        vFleetGeneratorInit( &pxDevice->xGenerator, xProfile, &xFleetStepTrace,
+                             ( uint32_t ) configRAND32() ^ ( ulIndex * 2654435761UL ),
+                             ( uint32_t ) configRAND32() % ( xFleetStepTrace.ulDurationMs + democonfigFLEET_TELEMETRY_PERIOD_MS ) );
+
+        BackoffAlgorithm_InitializeParams( &pxDevice->xReconnectParams,
+                                           sampleazureiotfleetRETRY_BACKOFF_BASE_MS,
+                                           sampleazureiotfleetRETRY_MAX_BACKOFF_DELAY_MS,
+                                           sampleazureiotfleetRETRY_MAX_ATTEMPTS );
+        pxDevice->xNextTelemetryTick = xTaskGetTickCount() +
+                                       pdMS_TO_TICKS( ( uint32_t ) configRAND32() % democonfigFLEET_TELEMETRY_PERIOD_MS );
+    }
+
+    xHeapBaseline = xGetHeapBytesInUse();
+
+    LogInfo( ( "Starting fleet of %u devices on %u workers against %s:%u, %u B static per device",
+               ( unsigned ) democonfigFLEET_DEVICE_COUNT, ( unsigned ) democonfigFLEET_WORKER_COUNT,
+               democonfigFLEET_HOSTNAME, ( unsigned ) democonfigFLEET_IOTHUB_PORT, ( unsigned ) sizeof( FleetDevice_t ) ) );
+
+    for( ulIndex = 0; ulIndex < democonfigFLEET_WORKER_COUNT; ulIndex++ )
+    {
+        xFleetWorkers[ ulIndex ].ulIndex = ulIndex;
+        xCreated = xTaskCreate( prvFleetWorkerTask, "FleetWorker", sampleazureiotfleetTASK_STACKSIZE,
+                                &xFleetWorkers[ ulIndex ], tskIDLE_PRIORITY, &xFleetWorkers[ ulIndex ].xTaskHandle );
+        configASSERT( xCreated == pdPASS );
+    }
+
+    xCreated = xTaskCreate( prvFleetReporterTask, "FleetReporter", sampleazureiotfleetTASK_STACKSIZE,
+                            ( void * ) xHeapBaseline, tskIDLE_PRIORITY + 1, NULL );
+    configASSERT( xCreated == pdPASS );
+
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Create the task that starts the fleet simulator.
+ */
+void vStartDemoTask( void )
+{
+    xTaskCreate( prvFleetSetupTask,        /* Function that implements the task. */
+                 "FleetSetupTask",         /* Text name for the task - only used for debugging. */
+                 democonfigDEMO_STACKSIZE, /* Size of stack (in words, not bytes) to allocate for the task. */
+                 NULL,                     /* Task parameter - not used in this case. */
+                 tskIDLE_PRIORITY,         /* Task priority, must be between 0 and configMAX_PRIORITIES - 1. */
+                 NULL );                   /* Used to pass out a handle to the created task - not used in this case. */
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,355 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Azure JSON includes */
+#include "azure_iot_json_writer.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+#include "sample_azure_iot_fleet_generator.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Telemetry names, the same the tile sends.
+ */
+#define fleetTELEMETRY_STEPS                  ( "step_count" )
+#define fleetTELEMETRY_STEP_DURATION_MS       ( "StepDuration_ms" )
+#define fleetTELEMETRY_STEP_ACCEL_PEAK        ( "StepAccelerationPeak" )
+#define fleetTELEMETRY_HARVESTED_ENERGY       ( "HarvestedEnergy" )
+#define fleetTELEMETRY_EVENT_TIME             ( "EventTimeUnixTime" )
+
+/**
+ * @brief Synthetic profile parameters, all in milliseconds.
+ */
+#define fleetWALKING_CADENCE_MS               ( 520U )
+#define fleetWALKING_JITTER_MS                ( 160U )
+#define fleetIDLE_MEAN_GAP_MS                 ( 20000U )
+#define fleetRUSH_HOUR_CADENCE_MS             ( 180U )
+#define fleetRUSH_HOUR_BURST_MS               ( 30000U )
+#define fleetRUSH_HOUR_PERIOD_MS              ( 90000U )
+
+/**
+ * @brief Maximum length of a trace file line.
+ */
+#define fleetTRACE_LINE_MAX_LENGTH            ( 128U )
+
+#define fleetLENGTH( x )                      ( sizeof( x ) - 1 )
+/*-----------------------------------------------------------*/
+
+uint64_t ullGetUnixTime( void );
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Per-device pseudo random number generator (xorshift32).
+ */
+static uint32_t prvNextRandom( FleetGenerator_t * pxGenerator )
+{
+    uint32_t ulValue = pxGenerator->ulSeed;
+
+    ulValue ^= ulValue << 13;
+    ulValue ^= ulValue >> 17;
+    ulValue ^= ulValue << 5;
+    pxGenerator->ulSeed = ulValue;
+
+    return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Random value in [ulMin, ulMin + ulSpan).
+ */
+static uint32_t prvRandomInRange( FleetGenerator_t * pxGenerator,
+                                  uint32_t ulMin,
+                                  uint32_t ulSpan )
+{
+    return ( ulSpan == 0 ) ? ulMin : ulMin + ( prvNextRandom( pxGenerator ) % ulSpan );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time until the next synthetic step, from the device time of the current one.
+ */
+static uint32_t prvSyntheticStepGap( FleetGenerator_t * pxGenerator,
+                                     uint32_t ulStepMs )
+{
+    uint32_t ulGap;
+
+    switch( pxGenerator->xProfile )
+    {
+        case eFleetProfileIdle:
+            ulGap = prvRandomInRange( pxGenerator, fleetIDLE_MEAN_GAP_MS / 2, fleetIDLE_MEAN_GAP_MS );
+            break;
+
+        case eFleetProfileRushHour:
+
+            if( ( ulStepMs % fleetRUSH_HOUR_PERIOD_MS ) < fleetRUSH_HOUR_BURST_MS )
+            {
+                ulGap = prvRandomInRange( pxGenerator, fleetRUSH_HOUR_CADENCE_MS / 2, fleetRUSH_HOUR_CADENCE_MS );
+            }
+            else
+            {
+                /* Jump to the start of the next burst. */
+                ulGap = fleetRUSH_HOUR_PERIOD_MS - ( ulStepMs % fleetRUSH_HOUR_PERIOD_MS );
+            }
+
+            break;
+
+        case eFleetProfileWalking:
+        default:
+            ulGap = prvRandomInRange( pxGenerator, fleetWALKING_CADENCE_MS - ( fleetWALKING_JITTER_MS / 2 ),
+                                      fleetWALKING_JITTER_MS );
+            break;
+    }
+
+    return ulGap;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Produce the synthetic steps which happened up to ulDeviceMs.
+ */
+static uint32_t prvAdvanceSynthetic( FleetGenerator_t * pxGenerator,
+                                     uint32_t ulDeviceMs )
+{
+    uint32_t ulNewSteps = 0;
+    uint32_t ulGap;
+
+    while( ( int32_t ) ( ulDeviceMs - pxGenerator->ulNextStepMs ) >= 0 )
+    {
+        ulGap = prvSyntheticStepGap( pxGenerator, pxGenerator->ulNextStepMs );
+
+        pxGenerator->xLastSample.ulOffsetMs = pxGenerator->ulNextStepMs;
+        pxGenerator->xLastSample.lSteps = 1;
+        pxGenerator->xLastSample.lStepDurationMs = ( int32_t ) ( ulGap < 1000U ? ulGap : prvRandomInRange( pxGenerator, 450U, 150U ) );
+        pxGenerator->xLastSample.fAccelerationPeak = 1.1f + ( float ) prvRandomInRange( pxGenerator, 0U, 500U ) / 1000.0f;
+        pxGenerator->xLastSample.fHarvestedEnergy = 0.8f * pxGenerator->xLastSample.fAccelerationPeak *
+                                                    pxGenerator->xLastSample.fAccelerationPeak;
+
+        pxGenerator->lStepCount++;
+        pxGenerator->ulNextStepMs += ulGap;
+        ulNewSteps++;
+    }
+
+    return ulNewSteps;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Replay the trace samples which happened up to ulDeviceMs, looping over the trace.
+ */
+static uint32_t prvAdvanceTrace( FleetGenerator_t * pxGenerator,
+                                 uint32_t ulDeviceMs )
+{
+    const FleetStepTrace_t * pxTrace = pxGenerator->pxTrace;
+    const FleetStepSample_t * pxSample;
+    uint32_t ulNewSteps = 0;
+
+    for( ; ; )
+    {
+        pxSample = &pxTrace->pxSamples[ pxGenerator->ulTraceIndex ];
+
+        if( ( int32_t ) ( ulDeviceMs - ( pxGenerator->ulTraceLoopOffsetMs + pxSample->ulOffsetMs ) ) < 0 )
+        {
+            break;
+        }
+
+        pxGenerator->xLastSample = *pxSample;
+        pxGenerator->lStepCount += pxSample->lSteps;
+        ulNewSteps += ( uint32_t ) pxSample->lSteps;
+
+        if( ++pxGenerator->ulTraceIndex == pxTrace->ulSampleCount )
+        {
+            pxGenerator->ulTraceIndex = 0;
+            pxGenerator->ulTraceLoopOffsetMs += pxTrace->ulDurationMs;
+        }
+    }
+
+    return ulNewSteps;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulFleetTraceLoad( const char * pcPath,
+                           FleetStepTrace_t * pxTrace )
+{
+    FILE * pxFile;
+    char cLine[ fleetTRACE_LINE_MAX_LENGTH ];
+    FleetStepSample_t xSample;
+    uint32_t ulCount = 0;
+    uint32_t ulStatus = 0;
+
+    if( ( pcPath == NULL ) || ( pxTrace == NULL ) )
+    {
+        return 1;
+    }
+
+    memset( pxTrace, 0, sizeof( *pxTrace ) );
+
+    if( ( pxFile = fopen( pcPath, "r" ) ) == NULL )
+    {
+        LogError( ( "Failed to open step trace %s", pcPath ) );
+        return 1;
+    }
+
+    /* First pass counts the samples, second pass stores them. */
+    while( fgets( cLine, sizeof( cLine ), pxFile ) != NULL )
+    {
+        if( ( cLine[ 0 ] != '#' ) &&
+            ( sscanf( cLine, "%u,%d,%d,%f,%f", &xSample.ulOffsetMs, &xSample.lSteps, &xSample.lStepDurationMs,
+                      &xSample.fAccelerationPeak, &xSample.fHarvestedEnergy ) == 5 ) )
+        {
+            ulCount++;
+        }
+    }
+
+    if( ulCount == 0 )
+    {
+        LogError( ( "Step trace %s has no samples", pcPath ) );
+        ulStatus = 1;
+    }
+    else if( ( pxTrace->pxSamples = pvPortMalloc( ulCount * sizeof( FleetStepSample_t ) ) ) == NULL )
+    {
+        LogError( ( "Failed to allocate %u trace samples", ( unsigned ) ulCount ) );
+        ulStatus = 1;
+    }
+    else
+    {
+        rewind( pxFile );
+
+        while( ( pxTrace->ulSampleCount < ulCount ) && ( fgets( cLine, sizeof( cLine ), pxFile ) != NULL ) )
+        {
+            if( ( cLine[ 0 ] != '#' ) &&
+                ( sscanf( cLine, "%u,%d,%d,%f,%f", &xSample.ulOffsetMs, &xSample.lSteps, &xSample.lStepDurationMs,
+                          &xSample.fAccelerationPeak, &xSample.fHarvestedEnergy ) == 5 ) )
+            {
+                if( ( pxTrace->ulSampleCount > 0 ) &&
+                    ( xSample.ulOffsetMs < pxTrace->pxSamples[ pxTrace->ulSampleCount - 1 ].ulOffsetMs ) )
+                {
+                    LogError( ( "Step trace %s offsets are not increasing", pcPath ) );
+                    ulStatus = 1;
+                    break;
+                }
+
+                pxTrace->pxSamples[ pxTrace->ulSampleCount++ ] = xSample;
+            }
+        }
+
+        if( ulStatus == 0 )
+        {
+            /* A trace looping on itself needs a non zero length. */
+            pxTrace->ulDurationMs = pxTrace->pxSamples[ pxTrace->ulSampleCount - 1 ].ulOffsetMs + 1;
+            LogInfo( ( "Loaded %u samples (%u ms) from step trace %s",
+                       ( unsigned ) pxTrace->ulSampleCount, ( unsigned ) pxTrace->ulDurationMs, pcPath ) );
+        }
+        else
+        {
+            vPortFree( pxTrace->pxSamples );
+            memset( pxTrace, 0, sizeof( *pxTrace ) );
+        }
+    }
+
+    fclose( pxFile );
+
+    return ulStatus;
+}
+/*-----------------------------------------------------------*/
+
+void vFleetGeneratorInit( FleetGenerator_t * pxGenerator,
+                          FleetProfile_t xProfile,
+                          const FleetStepTrace_t * pxTrace,
+                          uint32_t ulSeed,
+                          uint32_t ulPhaseMs )
+{
+    configASSERT( pxGenerator != NULL );
+    configASSERT( ( xProfile != eFleetProfileTrace ) ||
+                  ( ( pxTrace != NULL ) && ( pxTrace->ulSampleCount > 0 ) ) );
+
+    memset( pxGenerator, 0, sizeof( *pxGenerator ) );
+    pxGenerator->xProfile = xProfile;
+    pxGenerator->pxTrace = pxTrace;
+    pxGenerator->ulPhaseMs = ulPhaseMs;
+    /* xorshift must never be seeded with zero. */
+    pxGenerator->ulSeed = ( ulSeed != 0 ) ? ulSeed : 0x2545F491UL;
+    pxGenerator->ulNextStepMs = ulPhaseMs;
+}
+/*-----------------------------------------------------------*/
+
+void vFleetGeneratorResetSteps( FleetGenerator_t * pxGenerator )
+{
+    pxGenerator->lStepCount = 0;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulFleetGeneratorCreateTelemetry( FleetGenerator_t * pxGenerator,
+                                          uint32_t ulNowMs,
+                                          uint8_t * pucTelemetryData,
+                                          uint32_t ulTelemetryDataSize,
+                                          uint32_t * pulTelemetryDataLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTJSONWriter_t xWriter;
+    uint32_t ulDeviceMs = ulNowMs + pxGenerator->ulPhaseMs;
+    uint32_t ulNewSteps;
+    int32_t lBytesWritten;
+
+    *pulTelemetryDataLength = 0;
+
+    if( pxGenerator->xProfile == eFleetProfileTrace )
+    {
+        ulNewSteps = prvAdvanceTrace( pxGenerator, ulDeviceMs );
+    }
+    else
+    {
+        ulNewSteps = prvAdvanceSynthetic( pxGenerator, ulDeviceMs );
+    }
+
+    /* Like the tile, only send when the step counter moved. */
+    if( ulNewSteps == 0 )
+    {
+        return 0;
+    }
+
+    if( ( ( xResult = AzureIoTJSONWriter_Init( &xWriter, pucTelemetryData, ulTelemetryDataSize ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendBeginObject( &xWriter ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                       ( const uint8_t * ) fleetTELEMETRY_STEPS,
+                                                                       fleetLENGTH( fleetTELEMETRY_STEPS ),
+                                                                       pxGenerator->lStepCount ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                       ( const uint8_t * ) fleetTELEMETRY_STEP_DURATION_MS,
+                                                                       fleetLENGTH( fleetTELEMETRY_STEP_DURATION_MS ),
+                                                                       pxGenerator->xLastSample.lStepDurationMs ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithDoubleValue( &xWriter,
+                                                                        ( const uint8_t * ) fleetTELEMETRY_STEP_ACCEL_PEAK,
+                                                                        fleetLENGTH( fleetTELEMETRY_STEP_ACCEL_PEAK ),
+                                                                        pxGenerator->xLastSample.fAccelerationPeak, 3 ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithDoubleValue( &xWriter,
+                                                                        ( const uint8_t * ) fleetTELEMETRY_HARVESTED_ENERGY,
+                                                                        fleetLENGTH( fleetTELEMETRY_HARVESTED_ENERGY ),
+                                                                        pxGenerator->xLastSample.fHarvestedEnergy, 3 ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter,
+                                                                       ( const uint8_t * ) fleetTELEMETRY_EVENT_TIME,
+                                                                       fleetLENGTH( fleetTELEMETRY_EVENT_TIME ),
+                                                                       ( int32_t ) ullGetUnixTime() ) ) != eAzureIoTSuccess ) ||
+        ( ( xResult = AzureIoTJSONWriter_AppendEndObject( &xWriter ) ) != eAzureIoTSuccess ) )
+    {
+        LogError( ( "Failed to build fleet telemetry: result 0x%08x", ( uint16_t ) xResult ) );
+        return 1;
+    }
+
+    lBytesWritten = AzureIoTJSONWriter_GetBytesUsed( &xWriter );
+    configASSERT( lBytesWritten > 0 );
+
+    *pulTelemetryDataLength = ( uint32_t ) lBytesWritten;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
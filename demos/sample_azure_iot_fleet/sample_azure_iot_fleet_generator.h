@@ -0,0 +1,118 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_fleet_generator.h
+ * @brief Step telemetry generators used by the fleet simulator.
+ *
+ * Each simulated tile owns one generator. A generator either replays a
+ * recorded step trace (shared read-only between devices, each device keeping
+ * its own cursor and phase) or synthesizes steps from a simple profile.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_FLEET_GENERATOR_H
+#define SAMPLE_AZURE_IOT_FLEET_GENERATOR_H
+
+#include <stdint.h>
+
+/**
+ * @brief One step event, with the same fields the tile reports.
+ */
+typedef struct FleetStepSample
+{
+    uint32_t ulOffsetMs;      /**< Time of the event relative to the start of the trace. */
+    int32_t lSteps;           /**< Steps counted by this event. */
+    int32_t lStepDurationMs;  /**< Duration of the last step. */
+    float fAccelerationPeak;  /**< Acceleration peak of the last step, in g. */
+    float fHarvestedEnergy;   /**< Energy harvested by the last step. */
+} FleetStepSample_t;
+
+/**
+ * @brief Recorded step trace.
+ */
+typedef struct FleetStepTrace
+{
+    FleetStepSample_t * pxSamples;
+    uint32_t ulSampleCount;
+    uint32_t ulDurationMs; /**< Trace loop length, the offset of the last sample. */
+} FleetStepTrace_t;
+
+/**
+ * @brief Traffic profiles a generator can simulate.
+ */
+typedef enum FleetProfile
+{
+    eFleetProfileTrace = 0, /**< Replay a recorded trace. */
+    eFleetProfileWalking,   /**< Steady walking cadence with jitter. */
+    eFleetProfileIdle,      /**< Sparse, isolated steps. */
+    eFleetProfileRushHour   /**< Dense bursts of steps followed by quiet periods. */
+} FleetProfile_t;
+
+/**
+ * @brief Per-device generator state.
+ */
+typedef struct FleetGenerator
+{
+    FleetProfile_t xProfile;
+    const FleetStepTrace_t * pxTrace;
+    uint32_t ulTraceIndex;
+    uint32_t ulTraceLoopOffsetMs;
+    uint32_t ulPhaseMs;
+    uint32_t ulSeed;
+    uint32_t ulNextStepMs;
+    int32_t lStepCount;
+    FleetStepSample_t xLastSample;
+} FleetGenerator_t;
+
+/**
+ * @brief Load a step trace from a CSV file.
+ *
+ * Each non comment line is `offset_ms,steps,step_duration_ms,acceleration_peak,harvested_energy`,
+ * with increasing offsets. Lines starting with '#' are ignored.
+ *
+ * @param[in] pcPath Path of the trace file.
+ * @param[out] pxTrace Trace to fill, samples are allocated with pvPortMalloc.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+uint32_t ulFleetTraceLoad( const char * pcPath,
+                           FleetStepTrace_t * pxTrace );
+
+/**
+ * @brief Initialize a generator.
+ *
+ * @param[out] pxGenerator Generator to initialize.
+ * @param[in] xProfile Profile to simulate. eFleetProfileTrace requires @p pxTrace.
+ * @param[in] pxTrace Trace to replay, may be NULL for synthetic profiles.
+ * @param[in] ulSeed Seed of the per-device pseudo random sequence.
+ * @param[in] ulPhaseMs Offset applied to the device clock, so devices sharing a trace do not step in lockstep.
+ */
+void vFleetGeneratorInit( FleetGenerator_t * pxGenerator,
+                          FleetProfile_t xProfile,
+                          const FleetStepTrace_t * pxTrace,
+                          uint32_t ulSeed,
+                          uint32_t ulPhaseMs );
+
+/**
+ * @brief Reset the step counter, as the ResetStepsCounter command does on the tile.
+ */
+void vFleetGeneratorResetSteps( FleetGenerator_t * pxGenerator );
+
+/**
+ * @brief Create a telemetry payload if new steps were produced since the last call.
+ *
+ * @param[in,out] pxGenerator Generator of the device.
+ * @param[in] ulNowMs Current device time in milliseconds.
+ * @param[out] pucTelemetryData Buffer to write the JSON payload into.
+ * @param[in] ulTelemetryDataSize Size of @p pucTelemetryData.
+ * @param[out] pulTelemetryDataLength Length of the payload, 0 if there was nothing new to send.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+uint32_t ulFleetGeneratorCreateTelemetry( FleetGenerator_t * pxGenerator,
+                                          uint32_t ulNowMs,
+                                          uint8_t * pucTelemetryData,
+                                          uint32_t ulTelemetryDataSize,
+                                          uint32_t * pulTelemetryDataLength );
+
+#endif /* SAMPLE_AZURE_IOT_FLEET_GENERATOR_H */
@@ -0,0 +1,126 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include <string.h>
+
+#include "sample_azure_iot_fleet_stats.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Bucket of a value: values below 4 map to themselves, larger values
+ * map to four buckets per power of two.
+ */
+static uint32_t prvBucketIndex( uint32_t ulValue )
+{
+    uint32_t ulMsb = 0;
+    uint32_t ulIndex;
+
+    if( ulValue < 4U )
+    {
+        return ulValue;
+    }
+
+    while( ( ulValue >> ( ulMsb + 1 ) ) != 0 )
+    {
+        ulMsb++;
+    }
+
+    ulIndex = ( 4U * ( ulMsb - 1U ) ) + ( ( ulValue >> ( ulMsb - 2U ) ) & 3U );
+
+    return ( ulIndex < fleetstatsHISTOGRAM_BUCKETS ) ? ulIndex : ( fleetstatsHISTOGRAM_BUCKETS - 1U );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Smallest value mapped to a bucket.
+ */
+static uint32_t prvBucketLowerBound( uint32_t ulIndex )
+{
+    uint32_t ulMsb;
+
+    if( ulIndex < 4U )
+    {
+        return ulIndex;
+    }
+
+    ulMsb = ( ulIndex / 4U ) + 1U;
+
+    return ( 1UL << ulMsb ) + ( ( ulIndex % 4U ) << ( ulMsb - 2U ) );
+}
+/*-----------------------------------------------------------*/
+
+void vFleetHistogramReset( FleetHistogram_t * pxHistogram )
+{
+    memset( pxHistogram, 0, sizeof( *pxHistogram ) );
+}
+/*-----------------------------------------------------------*/
+
+void vFleetHistogramRecord( FleetHistogram_t * pxHistogram,
+                            uint32_t ulValueMs )
+{
+    pxHistogram->ulBuckets[ prvBucketIndex( ulValueMs ) ]++;
+    pxHistogram->ulCount++;
+    pxHistogram->ullSumMs += ulValueMs;
+
+    if( ulValueMs > pxHistogram->ulMaxMs )
+    {
+        pxHistogram->ulMaxMs = ulValueMs;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vFleetHistogramMerge( FleetHistogram_t * pxDestination,
+                           const FleetHistogram_t * pxSource )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < fleetstatsHISTOGRAM_BUCKETS; ulIndex++ )
+    {
+        pxDestination->ulBuckets[ ulIndex ] += pxSource->ulBuckets[ ulIndex ];
+    }
+
+    pxDestination->ulCount += pxSource->ulCount;
+    pxDestination->ullSumMs += pxSource->ullSumMs;
+
+    if( pxSource->ulMaxMs > pxDestination->ulMaxMs )
+    {
+        pxDestination->ulMaxMs = pxSource->ulMaxMs;
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulFleetHistogramPercentile( const FleetHistogram_t * pxHistogram,
+                                     uint32_t ulPercentile )
+{
+    uint64_t ullRank;
+    uint64_t ullSeen = 0;
+    uint32_t ulIndex;
+    uint32_t ulUpperBound;
+
+    if( pxHistogram->ulCount == 0 )
+    {
+        return 0;
+    }
+
+    /* Rank of the percentile, rounded up and at least one. */
+    ullRank = ( ( ( uint64_t ) pxHistogram->ulCount * ulPercentile ) + 99U ) / 100U;
+    ullRank = ( ullRank == 0 ) ? 1 : ullRank;
+
+    for( ulIndex = 0; ulIndex < fleetstatsHISTOGRAM_BUCKETS; ulIndex++ )
+    {
+        ullSeen += pxHistogram->ulBuckets[ ulIndex ];
+
+        if( ullSeen >= ullRank )
+        {
+            break;
+        }
+    }
+
+    ulUpperBound = ( ulIndex + 1U < fleetstatsHISTOGRAM_BUCKETS ) ?
+                   prvBucketLowerBound( ulIndex + 1U ) - 1U : pxHistogram->ulMaxMs;
+
+    /* Never report more than what was actually seen. */
+    return ( ulUpperBound < pxHistogram->ulMaxMs ) ? ulUpperBound : pxHistogram->ulMaxMs;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,62 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file sample_azure_iot_fleet_stats.h
+ * @brief Fixed size latency histograms used by the fleet simulator.
+ *
+ * Buckets are log-linear: four buckets per power of two, so a percentile is
+ * reported with at most 25% error while a histogram stays a few hundred bytes
+ * and can be kept per device.
+ */
+
+#ifndef SAMPLE_AZURE_IOT_FLEET_STATS_H
+#define SAMPLE_AZURE_IOT_FLEET_STATS_H
+
+#include <stdint.h>
+
+/**
+ * @brief Number of histogram buckets, enough for values up to 2^24 ms.
+ */
+#define fleetstatsHISTOGRAM_BUCKETS    ( 96U )
+
+/**
+ * @brief Latency histogram, values are in milliseconds.
+ */
+typedef struct FleetHistogram
+{
+    uint32_t ulCount;
+    uint32_t ulMaxMs;
+    uint64_t ullSumMs;
+    uint32_t ulBuckets[ fleetstatsHISTOGRAM_BUCKETS ];
+} FleetHistogram_t;
+
+/**
+ * @brief Clear a histogram.
+ */
+void vFleetHistogramReset( FleetHistogram_t * pxHistogram );
+
+/**
+ * @brief Record one value.
+ */
+void vFleetHistogramRecord( FleetHistogram_t * pxHistogram,
+                            uint32_t ulValueMs );
+
+/**
+ * @brief Add all values of @p pxSource into @p pxDestination.
+ */
+void vFleetHistogramMerge( FleetHistogram_t * pxDestination,
+                           const FleetHistogram_t * pxSource );
+
+/**
+ * @brief Get a percentile.
+ *
+ * @param[in] pxHistogram Histogram to query.
+ * @param[in] ulPercentile Percentile, 0 to 100.
+ *
+ * @return Upper bound of the bucket holding the percentile, 0 if the histogram is empty.
+ */
+uint32_t ulFleetHistogramPercentile( const FleetHistogram_t * pxHistogram,
+                                     uint32_t ulPercentile );
+
+#endif /* SAMPLE_AZURE_IOT_FLEET_STATS_H */
@@ -33,6 +33,16 @@
 /* Data Interface Definition */
 #include "sample_azure_iot_pnp_data_if.h"
 
+#ifdef democonfigENABLE_RUNTIME_STATS
+    #include "azure_sample_runtime_stats.h"
+    #define sampleazureiotCOUNT( xCounter )    RuntimeStats_Increment( xCounter )
+#else
+    #define sampleazureiotCOUNT( xCounter )
+#endif
+
+/* Spans of the trace export of the Linux port, empty elsewhere. */
+#include "azure_sample_trace_span.h"
+
 /*-----------------------------------------------------------*/
 
 /* Compile time error for undefined configs. */
@@ -118,6 +128,13 @@
  * @brief Wait timeout for subscribe to finish.
  */
 #define sampleazureiotSUBSCRIBE_TIMEOUT                       ( 10 * 1000U )
+
+/**
+ * @brief Size of the buffer for the command responses.
+ */
+#ifndef democonfigCOMMAND_RESPONSE_BUFFER_SIZE
+    #define democonfigCOMMAND_RESPONSE_BUFFER_SIZE            ( 256U )
+#endif
 /*-----------------------------------------------------------*/
 
 /**
@@ -147,7 +164,7 @@ AzureIoTHubClient_t xAzureIoTHubClient;
 static uint8_t ucScratchBuffer[ 512 ];
 
 /* Command buffers */
-static uint8_t ucCommandResponsePayloadBuffer[ 256 ];
+static uint8_t ucCommandResponsePayloadBuffer[ democonfigCOMMAND_RESPONSE_BUFFER_SIZE ];
 
 /* Reported Properties buffers */
 static uint8_t ucReportedPropertiesUpdate[ 380 ];
@@ -254,6 +271,7 @@ static void prvDispatchPropertiesUpdate( AzureIoTHubClientPropertiesResponse_t *
                                                                              ulReportedPropertiesUpdateLength,
                                                                              NULL );
         configASSERT( xResult == eAzureIoTSuccess );
+        sampleazureiotCOUNT( eRuntimeStatsPublishes );
     }
 }
 /*-----------------------------------------------------------*/
@@ -441,27 +459,38 @@ static void prvAzureDemoTask( void * pvParameters )
         for( ; ; )
         {
             /* Hook for sending Telemetry */
-            if( ( ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ), &ulScratchBufferLength ) == 0 ) &&
-                ( ulScratchBufferLength > 0 ) )
+            traceSAMPLE_SPAN_BEGIN( "ulCreateTelemetry" );
+            ulStatus = ulCreateTelemetry( ucScratchBuffer, sizeof( ucScratchBuffer ), &ulScratchBufferLength );
+            traceSAMPLE_SPAN_END( "ulCreateTelemetry" );
+
+            if( ( ulStatus == 0 ) && ( ulScratchBufferLength > 0 ) )
             {
+                traceSAMPLE_SPAN_BEGIN( "AzureIoTHubClient_SendTelemetry" );
                 xResult = AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient,
                                                            ucScratchBuffer, ulScratchBufferLength,
                                                            NULL, eAzureIoTHubMessageQoS1, NULL );
+                traceSAMPLE_SPAN_END( "AzureIoTHubClient_SendTelemetry" );
                 configASSERT( xResult == eAzureIoTSuccess );
+                sampleazureiotCOUNT( eRuntimeStatsPublishes );
             }
 
             /* Hook for sending update to reported properties */
+            traceSAMPLE_SPAN_BEGIN( "ulCreateReportedPropertiesUpdate" );
             ulReportedPropertiesUpdateLength = ulCreateReportedPropertiesUpdate( ucReportedPropertiesUpdate, sizeof( ucReportedPropertiesUpdate ) );
+            traceSAMPLE_SPAN_END( "ulCreateReportedPropertiesUpdate" );
 
             if( ulReportedPropertiesUpdateLength > 0 )
             {
                 xResult = AzureIoTHubClient_SendPropertiesReported( &xAzureIoTHubClient, ucReportedPropertiesUpdate, ulReportedPropertiesUpdateLength, NULL );
                 configASSERT( xResult == eAzureIoTSuccess );
+                sampleazureiotCOUNT( eRuntimeStatsPublishes );
             }
 
             LogInfo( ( "Attempt to receive publish message from IoT Hub.\r\n" ) );
+            traceSAMPLE_SPAN_BEGIN( "AzureIoTHubClient_ProcessLoop" );
             xResult = AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient,
                                                      sampleazureiotPROCESS_LOOP_TIMEOUT_MS );
+            traceSAMPLE_SPAN_END( "AzureIoTHubClient_ProcessLoop" );
             configASSERT( xResult == eAzureIoTSuccess );
 
             /* Leave Connection Idle for some time. */
@@ -490,6 +519,7 @@ static void prvAzureDemoTask( void * pvParameters )
         LogInfo( ( "Demo completed successfully.\r\n" ) );
         LogInfo( ( "Short delay before starting the next iteration.... \r\n\r\n" ) );
         vTaskDelay( sampleazureiotDELAY_BETWEEN_DEMO_ITERATIONS_TICKS );
+        sampleazureiotCOUNT( eRuntimeStatsReconnects );
     }
 }
 /*-----------------------------------------------------------*/
@@ -620,6 +650,10 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
     BackoffAlgorithmContext_t xReconnectParams;
     uint16_t usNextRetryBackOff = 0U;
 
+    #ifdef democonfigENABLE_RUNTIME_STATS
+        uint32_t ulHandshakeStartMs;
+    #endif
+
     /* Initialize reconnect attempts and interval. */
     BackoffAlgorithm_InitializeParams( &xReconnectParams,
                                        sampleazureiotRETRY_BACKOFF_BASE_MS,
@@ -633,6 +667,10 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
     do
     {
         LogInfo( ( "Creating a TLS connection to %s:%u.\r\n", pcHostName, ( uint16_t ) port ) );
+        #ifdef democonfigENABLE_RUNTIME_STATS
+            ulHandshakeStartMs = runtimestatsGET_TIME_MS();
+        #endif
+
         /* Attempt to create a mutually authenticated TLS connection. */
         xNetworkStatus = TLS_Socket_Connect( pxNetworkContext,
                                              pcHostName, port,
@@ -640,6 +678,13 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
                                              sampleazureiotTRANSPORT_SEND_RECV_TIMEOUT_MS,
                                              sampleazureiotTRANSPORT_SEND_RECV_TIMEOUT_MS );
 
+        #ifdef democonfigENABLE_RUNTIME_STATS
+            if( xNetworkStatus == eTLSTransportSuccess )
+            {
+                RuntimeStats_RecordHandshake( runtimestatsGET_TIME_MS() - ulHandshakeStartMs );
+            }
+        #endif
+
         if( xNetworkStatus != eTLSTransportSuccess )
         {
             /* Generate a random number and calculate backoff value (in milliseconds) for
@@ -659,6 +704,7 @@ static uint32_t prvConnectToServerWithBackoffRetries( const char * pcHostName,
                            "Retrying connection with backoff and jitter [%d]ms.",
                            xNetworkStatus, usNextRetryBackOff ) );
                 vTaskDelay( pdMS_TO_TICKS( usNextRetryBackOff ) );
+                sampleazureiotCOUNT( eRuntimeStatsReconnects );
             }
         }
     } while( ( xNetworkStatus != eTLSTransportSuccess ) && ( xBackoffAlgStatus == BackoffAlgorithmSuccess ) );